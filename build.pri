@@ -41,7 +41,9 @@ HEADERS += $${VAULT_BASE}/source/vtypes/_mac/vtypes_platform.h
 SOURCES += $${VAULT_BASE}/source/vtypes/_mac/vtypes_platform.cpp
 OBJECTIVE_SOURCES += $${VAULT_BASE}/source/vtypes/_mac/vtypes_platform_objc.mm
 SOURCES += $${VAULT_BASE}/source/containers/_unix/vinstant_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_unix/vasyncfilestream_platform.cpp
 SOURCES += $${VAULT_BASE}/source/files/_unix/vfsnode_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_unix/vmappedfilestream_platform.cpp
 HEADERS += $${VAULT_BASE}/source/threads/_unix/vthread_platform.h
 SOURCES += $${VAULT_BASE}/source/threads/_unix/vthread_platform.cpp
 HEADERS += $${VAULT_BASE}/source/sockets/_unix/vsocket_platform.h
@@ -63,7 +65,9 @@ HEADERS += $${VAULT_BASE}/source/vtypes/_unix/vtypes_internal_platform.h
 HEADERS += $${VAULT_BASE}/source/vtypes/_unix/vtypes_platform.h
 SOURCES += $${VAULT_BASE}/source/vtypes/_unix/vtypes_platform.cpp
 SOURCES += $${VAULT_BASE}/source/containers/_unix/vinstant_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_unix/vasyncfilestream_platform.cpp
 SOURCES += $${VAULT_BASE}/source/files/_unix/vfsnode_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_unix/vmappedfilestream_platform.cpp
 HEADERS += $${VAULT_BASE}/source/threads/_unix/vthread_platform.h
 SOURCES += $${VAULT_BASE}/source/threads/_unix/vthread_platform.cpp
 HEADERS += $${VAULT_BASE}/source/sockets/_unix/vsocket_platform.h
@@ -85,7 +89,9 @@ HEADERS += $${VAULT_BASE}/source/vtypes/_win/vtypes_internal_platform.h
 HEADERS += $${VAULT_BASE}/source/vtypes/_win/vtypes_platform.h
 SOURCES += $${VAULT_BASE}/source/vtypes/_win/vtypes_platform.cpp
 SOURCES += $${VAULT_BASE}/source/containers/_win/vinstant_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_win/vasyncfilestream_platform.cpp
 SOURCES += $${VAULT_BASE}/source/files/_win/vfsnode_platform.cpp
+SOURCES += $${VAULT_BASE}/source/files/_win/vmappedfilestream_platform.cpp
 HEADERS += $${VAULT_BASE}/source/threads/_win/vthread_platform.h
 SOURCES += $${VAULT_BASE}/source/threads/_win/vthread_platform.cpp
 HEADERS += $${VAULT_BASE}/source/sockets/_win/vsocket_platform.h
@@ -141,6 +147,8 @@ HEADERS += $${VAULT_BASE}/source/containers/vstringiterator.h
 SOURCES += $${VAULT_BASE}/source/containers/vstringiterator.cpp
 HEADERS += $${VAULT_BASE}/source/files/vabstractfilestream.h
 SOURCES += $${VAULT_BASE}/source/files/vabstractfilestream.cpp
+HEADERS += $${VAULT_BASE}/source/files/vasyncfilestream.h
+SOURCES += $${VAULT_BASE}/source/files/vasyncfilestream.cpp
 HEADERS += $${VAULT_BASE}/source/files/vbufferedfilestream.h
 SOURCES += $${VAULT_BASE}/source/files/vbufferedfilestream.cpp
 HEADERS += $${VAULT_BASE}/source/files/vdirectiofilestream.h
@@ -149,6 +157,8 @@ HEADERS += $${VAULT_BASE}/source/files/vfilewriter.h
 SOURCES += $${VAULT_BASE}/source/files/vfilewriter.cpp
 HEADERS += $${VAULT_BASE}/source/files/vfsnode.h
 SOURCES += $${VAULT_BASE}/source/files/vfsnode.cpp
+HEADERS += $${VAULT_BASE}/source/files/vmappedfilestream.h
+SOURCES += $${VAULT_BASE}/source/files/vmappedfilestream.cpp
 HEADERS += $${VAULT_BASE}/source/server/vclientsession.h
 SOURCES += $${VAULT_BASE}/source/server/vclientsession.cpp
 HEADERS += $${VAULT_BASE}/source/server/vlistenersocket.h
@@ -183,6 +193,8 @@ HEADERS += $${VAULT_BASE}/source/streams/viostream.h
 SOURCES += $${VAULT_BASE}/source/streams/viostream.cpp
 HEADERS += $${VAULT_BASE}/source/streams/vmemorystream.h
 SOURCES += $${VAULT_BASE}/source/streams/vmemorystream.cpp
+HEADERS += $${VAULT_BASE}/source/streams/vreadbufferedstream.h
+SOURCES += $${VAULT_BASE}/source/streams/vreadbufferedstream.cpp
 HEADERS += $${VAULT_BASE}/source/streams/vstream.h
 SOURCES += $${VAULT_BASE}/source/streams/vstream.cpp
 HEADERS += $${VAULT_BASE}/source/streams/vstreamcopier.h
@@ -191,16 +203,29 @@ HEADERS += $${VAULT_BASE}/source/streams/vtextiostream.h
 SOURCES += $${VAULT_BASE}/source/streams/vtextiostream.cpp
 HEADERS += $${VAULT_BASE}/source/streams/vwritebufferedstream.h
 SOURCES += $${VAULT_BASE}/source/streams/vwritebufferedstream.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vcoarseclock.h
+SOURCES += $${VAULT_BASE}/source/threads/vcoarseclock.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vcountingsemaphore.h
+SOURCES += $${VAULT_BASE}/source/threads/vcountingsemaphore.cpp
 HEADERS += $${VAULT_BASE}/source/threads/vmutex.h
 SOURCES += $${VAULT_BASE}/source/threads/vmutex.cpp
 HEADERS += $${VAULT_BASE}/source/threads/vmutexlocker.h
 SOURCES += $${VAULT_BASE}/source/threads/vmutexlocker.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vreadwritelock.h
+SOURCES += $${VAULT_BASE}/source/threads/vreadwritelock.cpp
 HEADERS += $${VAULT_BASE}/source/threads/vsemaphore.h
 SOURCES += $${VAULT_BASE}/source/threads/vsemaphore.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vshardedmutex.h
 HEADERS += $${VAULT_BASE}/source/threads/vthread.h
 SOURCES += $${VAULT_BASE}/source/threads/vthread.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vthreadpool.h
+SOURCES += $${VAULT_BASE}/source/threads/vthreadpool.cpp
+HEADERS += $${VAULT_BASE}/source/threads/vtimerwheel.h
+SOURCES += $${VAULT_BASE}/source/threads/vtimerwheel.cpp
 HEADERS += $${VAULT_BASE}/source/toolbox/vassert.h
 SOURCES += $${VAULT_BASE}/source/toolbox/vassert.cpp
+HEADERS += $${VAULT_BASE}/source/toolbox/vbinarylog.h
+SOURCES += $${VAULT_BASE}/source/toolbox/vbinarylog.cpp
 HEADERS += $${VAULT_BASE}/source/toolbox/vclassregistry.h
 SOURCES += $${VAULT_BASE}/source/toolbox/vclassregistry.cpp
 HEADERS += $${VAULT_BASE}/source/toolbox/vhex.h
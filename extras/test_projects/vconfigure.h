@@ -46,6 +46,14 @@ clear by reading which ones you are not using.
 /* This flag enables VMutex checking and logging of lock delays. */
 #define VAULT_MUTEX_LOCK_DELAY_CHECK
 
+/* This flag lets VTicks read the x86 time stamp counter with rdtsc, calibrated against the monotonic clock, */
+/* instead of calling clock_gettime() or QueryPerformanceCounter(). It only takes effect on an invariant TSC. */
+//#define VAULT_TICKS_USE_TSC
+
+/* This flag lets VRollingFileLogAppender gzip the log files it rolls over. */
+/* It requires linking with zlib. */
+//#define VAULT_ZLIB_SUPPORT
+
 /* This flag enables the memory allocation tracking feature, useful for finding leaks. */
 #define VAULT_MEMORY_ALLOCATION_TRACKING_SUPPORT
 
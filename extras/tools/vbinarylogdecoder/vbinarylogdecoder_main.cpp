@@ -0,0 +1,135 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/*
+vbinarylogdecoder prints the messages in binary log files written by VBinaryLogAppender
+as text, optionally only those within a time range, for a logger, or at a level. Segments
+of the file that cannot contain a matching message are skipped without being read.
+
+Usage: vbinarylogdecoder [options] file...
+  --from TIME       only messages logged at or after TIME ("y-MM-dd HH:mm:ss.SSS", local time unless --utc)
+  --to TIME         only messages logged at or before TIME
+  --logger NAME     only messages logged to NAME or to a logger beneath it, such as NAME.child
+  --level LEVEL     only messages at LEVEL or more severe; a name such as WARN or a number
+  --utc             show times, and interpret --from and --to, in UTC rather than local time
+  --stats           after each file, print the number of segments read and skipped
+*/
+
+#include "vault.h"
+
+static void _printUsage() {
+    std::cout << "Usage: vbinarylogdecoder [--from TIME] [--to TIME] [--logger NAME] [--level LEVEL] [--utc] [--stats] file..." << std::endl;
+}
+
+static VInstant _parseTime(const VString& s, bool utc) {
+    VInstant when;
+    if (utc) {
+        when.setUTCString(s + " UTC");
+    } else {
+        when.setLocalString(s);
+    }
+
+    return when;
+}
+
+static int _decodeFiles(const VStringVector& args) {
+    VString fromString;
+    VString toString;
+    VString loggerName;
+    int maxLevel = VLoggerLevel::ALL;
+    bool utc = false;
+    bool printStats = false;
+    VStringVector filePaths;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const VString& arg = args[i];
+        const bool hasValue = (i + 1 < args.size());
+
+        if ((arg == "--from") && hasValue) {
+            fromString = args[++i];
+        } else if ((arg == "--to") && hasValue) {
+            toString = args[++i];
+        } else if ((arg == "--logger") && hasValue) {
+            loggerName = args[++i];
+        } else if ((arg == "--level") && hasValue) {
+            maxLevel = VLoggerLevel::fromString(args[++i]);
+        } else if (arg == "--utc") {
+            utc = true;
+        } else if (arg == "--stats") {
+            printStats = true;
+        } else if (arg.startsWith("--")) {
+            _printUsage();
+            return -1;
+        } else {
+            filePaths.push_back(arg);
+        }
+    }
+
+    if (filePaths.empty()) {
+        _printUsage();
+        return -1;
+    }
+
+    // The times are interpreted after all the options are seen, so that --utc can come last.
+    const VInstant fromTime = fromString.isEmpty() ? VInstant::INFINITE_PAST() : _parseTime(fromString, utc);
+    const VInstant toTime = toString.isEmpty() ? VInstant::INFINITE_FUTURE() : _parseTime(toString, utc);
+
+    for (VStringVector::const_iterator i = filePaths.begin(); i != filePaths.end(); ++i) {
+        VBinaryLogReader reader((VFSNode(*i)));
+        reader.setTimeRange(fromTime, toTime);
+        reader.setLoggerName(loggerName);
+        reader.setMaxLevel(maxLevel);
+
+        VBinaryLogRecord record;
+        while (reader.readNext(record)) {
+            std::cout << record.format(utc) << '\n';
+        }
+
+        std::cout.flush();
+
+        if (printStats) {
+            std::cerr << (*i) << ": " << reader.getNumSegmentsRead() << " segments read, " << reader.getNumSegmentsSkipped() << " skipped";
+            if (reader.getNumResyncs() != 0) {
+                std::cerr << ", " << reader.getNumResyncs() << " damaged";
+            }
+
+            if (reader.isTruncated()) {
+                std::cerr << ", truncated";
+            }
+
+            std::cerr << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+// static
+int VThread::userMain(int argc, char** argv) {
+    VStringVector args;
+    for (int i = 1; i < argc; ++i) { // Omit argv[0] which is just the application name.
+        args.push_back(argv[i]);
+    }
+
+    int result = -1;
+    try {
+        result = _decodeFiles(args);
+    } catch (const VException& ex) {
+        std::cerr << "ERROR: " << ex.what() << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "ERROR: " << ex.what() << std::endl;
+    }
+
+    VShutdownRegistry::shutdown();
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    VMainThread mainThread;
+    return mainThread.execute(argc, argv);
+}
@@ -10,6 +10,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vexception.h"
 
 #include <sys/time.h>
+#include <time.h>
 
 /*
 These are the platform-specific implementations of these required
@@ -117,3 +118,10 @@ Vs64 VInstant::_platform_snapshot() {
     return (((Vs64)(tv.tv_sec)) * CONST_S64(1000)) + (Vs64)(tv.tv_usec / 1000);
 }
 
+// static
+Vs64 VTicks::_platform_ticks() {
+    struct timespec ts;
+    (void) ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (static_cast<Vs64>(ts.tv_sec) * VTicks::kNanosecondsPerSecond) + static_cast<Vs64>(ts.tv_nsec);
+}
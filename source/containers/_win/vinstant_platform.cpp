@@ -113,3 +113,19 @@ Vs64 VInstant::_platform_snapshot() {
 
 #endif
 
+
+// static
+Vs64 VTicks::_platform_ticks() {
+    static LARGE_INTEGER gFrequency = { 0 }; // counts per second; fixed at boot, so a benign race to initialize
+    if (gFrequency.QuadPart == 0) {
+        (void) ::QueryPerformanceFrequency(&gFrequency);
+    }
+
+    LARGE_INTEGER counter;
+    (void) ::QueryPerformanceCounter(&counter);
+
+    // Split the conversion so that counter * 1e9 cannot overflow.
+    const Vs64 seconds = counter.QuadPart / gFrequency.QuadPart;
+    const Vs64 remainder = counter.QuadPart % gFrequency.QuadPart;
+    return (seconds * VTicks::kNanosecondsPerSecond) + ((remainder * VTicks::kNanosecondsPerSecond) / gFrequency.QuadPart);
+}
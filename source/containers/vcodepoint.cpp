@@ -118,23 +118,25 @@ VCodePoint::VCodePoint(const Vu8* buffer, int startOffset)
 }
 
 VCodePoint::VCodePoint(VBinaryIOStream& stream) {
-    Vu8 source0 = stream.readU8();
-    int numBytesToRead = VCodePoint::getUTF8LengthFromUTF8StartByte(source0);
-    
-    this->_initFromUTF8Bytes(numBytesToRead, source0,
-        (numBytesToRead > 1) ? stream.readU8() : 0,
-        (numBytesToRead > 2) ? stream.readU8() : 0,
-        (numBytesToRead > 3) ? stream.readU8() : 0);
+    // Read the bytes in separate statements; the order of evaluation of function arguments is unspecified.
+    Vu8 source[4] = { stream.readU8(), 0, 0, 0 };
+    int numBytesToRead = VCodePoint::getUTF8LengthFromUTF8StartByte(source[0]);
+    for (int i = 1; i < numBytesToRead; ++i) {
+        source[i] = stream.readU8();
+    }
+
+    this->_initFromUTF8Bytes(numBytesToRead, source[0], source[1], source[2], source[3]);
 }
 
 VCodePoint::VCodePoint(VTextIOStream& utf8Stream) {
-    Vu8 source0 = utf8Stream.readGuaranteedByte();
-    int numBytesToRead = VCodePoint::getUTF8LengthFromUTF8StartByte(source0);
-    
-    this->_initFromUTF8Bytes(numBytesToRead, source0,
-        (numBytesToRead > 1) ? utf8Stream.readGuaranteedByte() : 0,
-        (numBytesToRead > 2) ? utf8Stream.readGuaranteedByte() : 0,
-        (numBytesToRead > 3) ? utf8Stream.readGuaranteedByte() : 0);
+    // Read the bytes in separate statements; the order of evaluation of function arguments is unspecified.
+    Vu8 source[4] = { utf8Stream.readGuaranteedByte(), 0, 0, 0 };
+    int numBytesToRead = VCodePoint::getUTF8LengthFromUTF8StartByte(source[0]);
+    for (int i = 1; i < numBytesToRead; ++i) {
+        source[i] = utf8Stream.readGuaranteedByte();
+    }
+
+    this->_initFromUTF8Bytes(numBytesToRead, source[0], source[1], source[2], source[3]);
 }
 
 VCodePoint::VCodePoint(const std::wstring& utf16WideString, int atIndex) {
@@ -14,6 +14,18 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vstring.h"
 #include "vexception.h"
 
+#include <atomic>
+
+#if defined(VAULT_TICKS_USE_TSC) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+    #define V_TICKS_TSC_AVAILABLE
+    #ifdef VCOMPILER_MSVC
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+        #include <cpuid.h>
+    #endif
+#endif
+
 #undef sscanf
 
 // VDuration -----------------------------------------------------------------
@@ -562,6 +574,10 @@ const VString& VInstant::LOCAL_TIME_ZONE_ID() {
 Vs64 VInstant::gSimulatedClockOffset(0);
 Vs64 VInstant::gFrozenClockValue(0);
 
+// The platform time as of the last VInstant::updateCoarseClock() call, or 0 if the coarse clock is disabled.
+// Only the value itself is shared, so relaxed loads and stores are sufficient.
+static std::atomic<Vs64> gCoarseClockValue(0);
+
 IVRemoteTimeZoneConverter* VInstant::gRemoteTimeZoneConverter = NULL;
 
 // static
@@ -623,6 +639,32 @@ void VInstant::setTrueNow() {
     mValue = VInstant::_platform_now();
 }
 
+void VInstant::setNowCoarse() {
+    const Vs64 coarseValue = gCoarseClockValue.load(std::memory_order_relaxed);
+    if (coarseValue == 0) {
+        this->setNow();
+    } else if (gFrozenClockValue == 0) {
+        mValue = coarseValue + gSimulatedClockOffset;
+    } else {
+        mValue = gFrozenClockValue;
+    }
+}
+
+// static
+void VInstant::updateCoarseClock() {
+    gCoarseClockValue.store(VInstant::_platform_now(), std::memory_order_relaxed);
+}
+
+// static
+void VInstant::disableCoarseClock() {
+    gCoarseClockValue.store(0, std::memory_order_relaxed);
+}
+
+// static
+bool VInstant::isCoarseClockEnabled() {
+    return gCoarseClockValue.load(std::memory_order_relaxed) != 0;
+}
+
 VInstantStruct VInstant::getUTCInstantFields() const {
     VInstantStruct when;
     when.setUTCStructFromOffset(mValue);
@@ -1044,6 +1086,130 @@ bool VInstant::isTimeFrozen() {
     return gFrozenClockValue != 0;
 }
 
+// VTicks --------------------------------------------------------------------
+
+#ifdef V_TICKS_TSC_AVAILABLE
+
+/**
+The conversion from time stamp counter to nanoseconds, measured once against the
+platform monotonic clock. The TSC is only usable if the processor says it is
+invariant, that is, it runs at a constant rate regardless of power state and is
+synchronized across cores.
+*/
+class VTicksTSCCalibration {
+    public:
+
+        VTicksTSCCalibration(Vs64 (*platformTicks)());
+        ~VTicksTSCCalibration() {}
+
+        bool isUsable() const { return mUsable; }
+        Vs64 ticksToNanoseconds(Vu64 tsc) const { return mBaseNanoseconds + static_cast<Vs64>(static_cast<double>(static_cast<Vs64>(tsc - mBaseTSC)) * mNanosecondsPerTick); }
+
+    private:
+
+        static bool _isInvariantTSC();
+
+        bool    mUsable;
+        Vu64    mBaseTSC;
+        Vs64    mBaseNanoseconds;
+        double  mNanosecondsPerTick;
+};
+
+VTicksTSCCalibration::VTicksTSCCalibration(Vs64 (*platformTicks)())
+    : mUsable(false)
+    , mBaseTSC(0)
+    , mBaseNanoseconds(0)
+    , mNanosecondsPerTick(0.0)
+    {
+
+    if (! VTicksTSCCalibration::_isInvariantTSC()) {
+        return;
+    }
+
+    // Count TSC ticks across 10ms of the platform clock. The error in the rate is roughly the skew
+    // between each clock read and its TSC read, tens of nanoseconds, divided by the interval: a few
+    // parts per million, or a few milliseconds of drift from the platform clock per thousand seconds.
+    const Vs64 startNanoseconds = platformTicks();
+    const Vu64 startTSC = __rdtsc();
+    Vs64 endNanoseconds;
+    do {
+        endNanoseconds = platformTicks();
+    } while (endNanoseconds - startNanoseconds < 10 * VTicks::kNanosecondsPerMillisecond);
+    const Vu64 endTSC = __rdtsc();
+
+    if (endTSC > startTSC) {
+        mNanosecondsPerTick = static_cast<double>(endNanoseconds - startNanoseconds) / static_cast<double>(endTSC - startTSC);
+        mBaseTSC = endTSC;
+        mBaseNanoseconds = endNanoseconds;
+        mUsable = true;
+    }
+}
+
+// static
+bool VTicksTSCCalibration::_isInvariantTSC() {
+    // CPUID leaf 0x80000007 reports the invariant TSC in bit 8 of EDX.
+#ifdef VCOMPILER_MSVC
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if (static_cast<unsigned int>(registers[0]) < 0x80000007U) {
+        return false;
+    }
+
+    __cpuid(registers, 0x80000007);
+    return (registers[3] & (1 << 8)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+
+    return (edx & (1U << 8)) != 0;
+#endif
+}
+
+static const VTicksTSCCalibration& _getTSCCalibration(Vs64 (*platformTicks)()) {
+    static const VTicksTSCCalibration gCalibration(platformTicks); // thread-safe initialization on first use
+    return gCalibration;
+}
+
+#endif /* V_TICKS_TSC_AVAILABLE */
+
+// static
+Vs64 VTicks::snapshot() {
+#ifdef V_TICKS_TSC_AVAILABLE
+    const VTicksTSCCalibration& calibration = _getTSCCalibration(VTicks::_platform_ticks);
+    if (calibration.isUsable()) {
+        return calibration.ticksToNanoseconds(__rdtsc());
+    }
+#endif
+
+    return VTicks::_platform_ticks();
+}
+
+// static
+bool VTicks::isUsingTSC() {
+#ifdef V_TICKS_TSC_AVAILABLE
+    return _getTSCCalibration(VTicks::_platform_ticks).isUsable();
+#else
+    return false;
+#endif
+}
+
+// static
+VString VTicks::getDurationString(Vs64 nanoseconds) {
+    const Vs64 magnitude = (nanoseconds < 0) ? -nanoseconds : nanoseconds;
+
+    if (magnitude < kNanosecondsPerMicrosecond) {
+        return VSTRING_FORMAT(VSTRING_FORMATTER_S64 "ns", nanoseconds);
+    } else if (magnitude < kNanosecondsPerMillisecond) {
+        return VSTRING_FORMAT("%.3lfus", static_cast<double>(nanoseconds) / static_cast<double>(kNanosecondsPerMicrosecond));
+    } else if (magnitude < kNanosecondsPerSecond) {
+        return VSTRING_FORMAT("%.3lfms", static_cast<double>(nanoseconds) / static_cast<double>(kNanosecondsPerMillisecond));
+    } else {
+        return VSTRING_FORMAT("%.3lfs", static_cast<double>(nanoseconds) / static_cast<double>(kNanosecondsPerSecond));
+    }
+}
+
 // VDate ---------------------------------------------------------------------
 
 // Is ASSERT_INVARIANT enabled/disabled specifically for VDate and VTimeOfDay?
@@ -1427,36 +1593,89 @@ VInstantFormatterLocaleInfo::VInstantFormatterLocaleInfo()
 #define DEFAULT_FORMAT_SPECIFIER "y-MM-dd HH:mm:ss.SSS"
 #define V_DEFAULT_LOCALE "en-us"
 
+// Each formatter gets an ID so that the per-thread cache can tell whose text it holds.
+static std::atomic<int> gNextInstantFormatterID(1);
+
 VInstantFormatter::VInstantFormatter()
     : mFormatSpecifier(DEFAULT_FORMAT_SPECIFIER)
+    , mInstructions()
+    , mMillisecondsAreFixedWidth(true)
+    , mFormatterID(gNextInstantFormatterID++)
     , mLocaleInfo(VInstantFormatterLocaleInfo::getLocaleInfo(V_DEFAULT_LOCALE))
     {
+    this->_compile();
 }
 
 VInstantFormatter::VInstantFormatter(const VInstantFormatterLocaleInfo& localeInfo)
     : mFormatSpecifier(DEFAULT_FORMAT_SPECIFIER)
+    , mInstructions()
+    , mMillisecondsAreFixedWidth(true)
+    , mFormatterID(gNextInstantFormatterID++)
     , mLocaleInfo(localeInfo)
     {
+    this->_compile();
 }
 
 VInstantFormatter::VInstantFormatter(const VString& formatSpecifier)
     : mFormatSpecifier(formatSpecifier)
+    , mInstructions()
+    , mMillisecondsAreFixedWidth(true)
+    , mFormatterID(gNextInstantFormatterID++)
     , mLocaleInfo(VInstantFormatterLocaleInfo::getLocaleInfo(V_DEFAULT_LOCALE))
     {
+    this->_compile();
 }
 
 VInstantFormatter::VInstantFormatter(const VString& formatSpecifier, const VInstantFormatterLocaleInfo& localeInfo)
     : mFormatSpecifier(formatSpecifier)
+    , mInstructions()
+    , mMillisecondsAreFixedWidth(true)
+    , mFormatterID(gNextInstantFormatterID++)
     , mLocaleInfo(localeInfo)
     {
+    this->_compile();
+}
+
+/*
+The per-thread cache used by VInstantFormatter::_formatInstant(). There is one for local time
+and one for UTC. The broken-down fields are good for any formatter; the text is only good
+for the formatter whose ID it has.
+*/
+class VInstantFormatterCache {
+    public:
+
+        VInstantFormatterCache()
+            : mSecond(V_MAX_S64)
+            , mFields()
+            , mUTCOffsetMilliseconds(0)
+            , mTextSecond(V_MAX_S64)
+            , mTextFormatterID(0)
+            , mText()
+            , mMillisecondOffsets()
+            {
+        }
+
+        Vs64                mSecond;                ///< The epoch second that mFields describes.
+        VInstantStruct      mFields;                ///< The broken-down fields of mSecond.
+        int                 mUTCOffsetMilliseconds; ///< The time zone offset at mSecond.
+        Vs64                mTextSecond;            ///< The epoch second that mText was rendered for.
+        int                 mTextFormatterID;       ///< The formatter that rendered mText.
+        VString             mText;                  ///< The most recently rendered text.
+        std::vector<int>    mMillisecondOffsets;    ///< Where the millisecond digits are in mText.
+};
+
+static VInstantFormatterCache& _getThreadFormatterCache(bool isLocal) {
+    static thread_local VInstantFormatterCache gLocalCache;
+    static thread_local VInstantFormatterCache gUTCCache;
+    return isLocal ? gLocalCache : gUTCCache;
 }
 
 VString VInstantFormatter::formatLocalString(const VInstant& when) const {
-    return this->_format(when.getLocalInstantFields(), static_cast<int>(when.getLocalOffsetMilliseconds()));
+    return this->_formatInstant(when, true);
 }
 
 VString VInstantFormatter::formatUTCString(const VInstant& when) const {
-    return this->_format(when.getUTCInstantFields(), 0);
+    return this->_formatInstant(when, false);
 }
 
 VString VInstantFormatter::formatDateString(const VDate& date) const {
@@ -1467,26 +1686,25 @@ VString VInstantFormatter::formatTimeOfDayString(const VTimeOfDay& timeOfDay) co
     return this->_format(timeOfDay.getTimeOfDayFields(), 0);
 }
 
-VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMilliseconds) const {
-    // For efficiency, extract the date and time once rather than while looping as needed.
-    // We'll almost inevitably need them.
-    VString result;
+void VInstantFormatter::_compile() {
+    // This follows the Java SimpleDateFormat rules for quoting and repeated field specifiers.
+    VString pendingLiteral;
     VString pendingFieldSpecifier;
     bool isEscaped = false; // true if we have encountered a single quote (') but not its match to close
     bool isUnescapePending = false; // true if we have encountered a second single quote (')
     bool gotEscapedChars = false;
-    
-    for (VString::const_iterator i = mFormatSpecifier.begin(); i != mFormatSpecifier.end(); ++i) {
+
+    for (VString::iterator i = mFormatSpecifier.begin(); i != mFormatSpecifier.end(); ++i) {
         VCodePoint cp = *i;
-        
+
         // If we're in escaped mode, handle all cases separately right here.
         if (isEscaped) {
-        
+
             if (cp == '\'') {
                 // This is likely the end of the escape block, but could be the first of a two adjacent quotes which would mean to emit a single quote
                 if (isUnescapePending) {
                     // Get back to normal escape mode and emit the single quote.
-                    result += '\'';
+                    pendingLiteral += '\'';
                     isUnescapePending = false;
                 } else {
                     isUnescapePending = true;
@@ -1498,7 +1716,7 @@ VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMill
                 // The unescape is complete. Exit escape mode and proceed on to the big switch statement as normal.
                 // If there was nothing between the escape quotes, we should emit a single quote.
                 if (!gotEscapedChars) {
-                    result += '\'';
+                    pendingLiteral += '\'';
                 }
 
                 isEscaped = false;
@@ -1508,19 +1726,19 @@ VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMill
             } else {
                 // This is some character inside the escape sequence. Just emit it.
                 gotEscapedChars = true;
-                result += cp;
+                pendingLiteral += cp;
                 continue;
             }
-        
+
         }
-        
+
         if (cp.isASCII()) {
             switch (cp.toASCIIChar()) {
 
                 case '\'':
-        
+
                     // Enter escaped mode.
-                    this->_flushPendingFieldSpecifier(when, utcOffsetMilliseconds, pendingFieldSpecifier, result);
+                    this->_addFieldInstruction(pendingLiteral, pendingFieldSpecifier);
                     isEscaped = true;
                     isUnescapePending = false;
                     break;
@@ -1550,7 +1768,7 @@ VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMill
                 case 'Z':
                 case 'X':
                     if (pendingFieldSpecifier.isNotEmpty() && (cp != *(pendingFieldSpecifier.begin()))) {
-                        this->_flushPendingFieldSpecifier(when, utcOffsetMilliseconds, pendingFieldSpecifier, result);
+                        this->_addFieldInstruction(pendingLiteral, pendingFieldSpecifier);
                     }
 
                     pendingFieldSpecifier += cp;
@@ -1561,97 +1779,191 @@ VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMill
                 case 'W': // week in month: NOT YET IMPLEMENTED
                 case 'D':
                 case 'F': // day of week in month: NOT YET IMPLEMENTED
-                    this->_flushPendingFieldSpecifier(when, utcOffsetMilliseconds, pendingFieldSpecifier, result);
+                    this->_addFieldInstruction(pendingLiteral, pendingFieldSpecifier);
                     break;
 
                 default:
-                    this->_flushPendingFieldSpecifier(when, utcOffsetMilliseconds, pendingFieldSpecifier, result);
-                    result += cp;
+                    this->_addFieldInstruction(pendingLiteral, pendingFieldSpecifier);
+                    pendingLiteral += cp;
                     break;
             }
 
         }
-        
+
     }
 
-    this->_flushPendingFieldSpecifier(when, utcOffsetMilliseconds, pendingFieldSpecifier, result);
-    
-    return result;
+    this->_addFieldInstruction(pendingLiteral, pendingFieldSpecifier);
+    this->_addLiteralInstruction(pendingLiteral);
+}
+
+void VInstantFormatter::_addLiteralInstruction(VString& pendingLiteral) {
+    if (pendingLiteral.isNotEmpty()) {
+        mInstructions.push_back(Instruction(0, 0, pendingLiteral));
+        pendingLiteral = VString::EMPTY();
+    }
 }
 
-void VInstantFormatter::_flushPendingFieldSpecifier(const VInstantStruct& when, int utcOffsetMilliseconds, VString& fieldSpecifier, VString& resultToAppendTo) const {
+void VInstantFormatter::_addFieldInstruction(VString& pendingLiteral, VString& fieldSpecifier) {
     if (fieldSpecifier.isEmpty()) {
         return;
     }
 
-    int fieldSpecifierLength = fieldSpecifier.length();
-    if (fieldSpecifier.startsWith('G')) {
-        this->_flushFixedLengthTextValue(mLocaleInfo.CE_MARKER, resultToAppendTo);
-    }
-    
-    else if (fieldSpecifier.startsWithIgnoreCase("y")) {
-        this->_flushYearValue(when.mYear, fieldSpecifierLength, resultToAppendTo);
-    }
+    this->_addLiteralInstruction(pendingLiteral);
 
-    else if (fieldSpecifier.startsWith('M')) { // month (long or short name, or number 1-12)
-        this->_flushMonthValue(when.mMonth, fieldSpecifierLength, resultToAppendTo);
-    }
+    char fieldCode = fieldSpecifier.charAt(0);
+    int fieldLength = fieldSpecifier.length();
+    mInstructions.push_back(Instruction(fieldCode, fieldLength, VString::EMPTY()));
 
-    else if (fieldSpecifier.startsWith('d')) { // day in month 1-31
-        this->_flushNumberValue(when.mDay, fieldSpecifierLength, resultToAppendTo);
+    if ((fieldCode == 'S') && (fieldLength < 3)) {
+        mMillisecondsAreFixedWidth = false;
     }
 
-    else if (fieldSpecifier.startsWith('E')) { // day name in week (long or short name)
-        this->_flushDayNameValue(when.mDayOfWeek, fieldSpecifierLength, resultToAppendTo);
-    }
+    fieldSpecifier = VString::EMPTY();
+}
 
-    else if (fieldSpecifier.startsWith('u')) { // day number in week (1=Monday, ..., 7=Sunday)
-        this->_flushDayNumberValue(when.mDayOfWeek, fieldSpecifierLength, resultToAppendTo);
-    }
+VString VInstantFormatter::_formatInstant(const VInstant& when, bool isLocal) const {
+    Vs64 value = when.getValue();
 
-    else if (fieldSpecifier.startsWith('a')) { // AM or PM
-        this->_flushFixedLengthTextValue((when.mHour < 12) ? mLocaleInfo.AM_MARKER : mLocaleInfo.PM_MARKER, resultToAppendTo);
+    // The platform conversion of times before 1970 has its own ideas about milliseconds, so don't try to cache those.
+    if (value < 0) {
+        return isLocal ? this->_format(when.getLocalInstantFields(), static_cast<int>(when.getLocalOffsetMilliseconds())) : this->_format(when.getUTCInstantFields(), 0);
     }
 
-    else if (fieldSpecifier.startsWith('H')) { // hour in day 0-23
-        this->_flushNumberValue(when.mHour, fieldSpecifierLength, resultToAppendTo);
+    VInstantFormatterCache& cache = _getThreadFormatterCache(isLocal);
+    Vs64 second = value / 1000;
+    int millisecond = static_cast<int>(value % 1000);
+
+    // If we rendered this second before, only the milliseconds have changed.
+    if ((second == cache.mTextSecond) && (mFormatterID == cache.mTextFormatterID)) {
+        VString result(cache.mText);
+        char* buffer = result.buffer();
+        for (std::vector<int>::const_iterator i = cache.mMillisecondOffsets.begin(); i != cache.mMillisecondOffsets.end(); ++i) {
+            buffer[*i]     = static_cast<char>('0' + (millisecond / 100));
+            buffer[*i + 1] = static_cast<char>('0' + ((millisecond / 10) % 10));
+            buffer[*i + 2] = static_cast<char>('0' + (millisecond % 10));
+        }
+
+        return result;
     }
 
-    else if (fieldSpecifier.startsWith('k')) { // hour in day 1-24
-        this->_flushNumberValue(when.mHour + 1, fieldSpecifierLength, resultToAppendTo);
+    if (second != cache.mSecond) {
+        cache.mFields = isLocal ? when.getLocalInstantFields() : when.getUTCInstantFields();
+        cache.mUTCOffsetMilliseconds = isLocal ? static_cast<int>(when.getLocalOffsetMilliseconds()) : 0;
+        cache.mSecond = second;
     }
 
-    else if (fieldSpecifier.startsWith('K')) { // hour in am/pm 0-11
-        this->_flushNumberValue(when.mHour % 12, fieldSpecifierLength, resultToAppendTo);
+    cache.mFields.mMillisecond = millisecond;
+
+    VString result;
+    if (mMillisecondsAreFixedWidth) {
+        cache.mMillisecondOffsets.clear();
+        this->_render(cache.mFields, cache.mUTCOffsetMilliseconds, result, &cache.mMillisecondOffsets);
+        cache.mText = result;
+        cache.mTextSecond = second;
+        cache.mTextFormatterID = mFormatterID;
+    } else {
+        this->_render(cache.mFields, cache.mUTCOffsetMilliseconds, result, NULL);
     }
 
-    else if (fieldSpecifier.startsWith('h')) { // hour in am/pm 1-12
-        int hour = when.mHour % 12;
-        if (hour == 0) {
-            hour = 12;
+    return result;
+}
+
+VString VInstantFormatter::_format(const VInstantStruct& when, int utcOffsetMilliseconds) const {
+    VString result;
+    this->_render(when, utcOffsetMilliseconds, result, NULL);
+    return result;
+}
+
+void VInstantFormatter::_render(const VInstantStruct& when, int utcOffsetMilliseconds, VString& resultToAppendTo, std::vector<int>* millisecondOffsets) const {
+    for (InstructionList::const_iterator i = mInstructions.begin(); i != mInstructions.end(); ++i) {
+        if ((*i).mFieldCode == 0) {
+            resultToAppendTo += (*i).mText;
+        } else {
+            if ((millisecondOffsets != NULL) && ((*i).mFieldCode == 'S')) {
+                millisecondOffsets->push_back(resultToAppendTo.length() + (*i).mFieldLength - 3);
+            }
+
+            this->_flushFieldValue(*i, when, utcOffsetMilliseconds, resultToAppendTo);
         }
-        this->_flushNumberValue(hour, fieldSpecifierLength, resultToAppendTo);
     }
+}
 
-    else if (fieldSpecifier.startsWith('m')) { // minute in hour 0-59
-        this->_flushNumberValue(when.mMinute, fieldSpecifierLength, resultToAppendTo);
-    }
+void VInstantFormatter::_flushFieldValue(const Instruction& field, const VInstantStruct& when, int utcOffsetMilliseconds, VString& resultToAppendTo) const {
+    const int fieldSpecifierLength = field.mFieldLength;
 
-    else if (fieldSpecifier.startsWith('s')) { // second in minute 0-59
-        this->_flushNumberValue(when.mSecond, fieldSpecifierLength, resultToAppendTo);
-    }
+    switch (field.mFieldCode) {
 
-    else if (fieldSpecifier.startsWith('S')) { // millisecond 0-999
-        this->_flushNumberValue(when.mMillisecond, fieldSpecifierLength, resultToAppendTo);
-    }
+        case 'G':
+            this->_flushFixedLengthTextValue(mLocaleInfo.CE_MARKER, resultToAppendTo);
+            break;
 
-    else if (fieldSpecifier.startsWith('z') || // time zone "general" format
-            fieldSpecifier.startsWith('Z') || // time zone RFC 822 format
-            fieldSpecifier.startsWith('X')) { // time zone ISO 8601 format
-        this->_flushTimeZoneValue(utcOffsetMilliseconds, fieldSpecifier, resultToAppendTo);
-    }
+        case 'y':
+        case 'Y':
+            this->_flushYearValue(when.mYear, fieldSpecifierLength, resultToAppendTo);
+            break;
 
-    fieldSpecifier = VString::EMPTY();
+        case 'M': // month (long or short name, or number 1-12)
+            this->_flushMonthValue(when.mMonth, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'd': // day in month 1-31
+            this->_flushNumberValue(when.mDay, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'E': // day name in week (long or short name)
+            this->_flushDayNameValue(when.mDayOfWeek, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'u': // day number in week (1=Monday, ..., 7=Sunday)
+            this->_flushDayNumberValue(when.mDayOfWeek, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'a': // AM or PM
+            this->_flushFixedLengthTextValue((when.mHour < 12) ? mLocaleInfo.AM_MARKER : mLocaleInfo.PM_MARKER, resultToAppendTo);
+            break;
+
+        case 'H': // hour in day 0-23
+            this->_flushNumberValue(when.mHour, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'k': // hour in day 1-24
+            this->_flushNumberValue(when.mHour + 1, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'K': // hour in am/pm 0-11
+            this->_flushNumberValue(when.mHour % 12, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'h': { // hour in am/pm 1-12
+            int hour = when.mHour % 12;
+            if (hour == 0) {
+                hour = 12;
+            }
+            this->_flushNumberValue(hour, fieldSpecifierLength, resultToAppendTo);
+            }
+            break;
+
+        case 'm': // minute in hour 0-59
+            this->_flushNumberValue(when.mMinute, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 's': // second in minute 0-59
+            this->_flushNumberValue(when.mSecond, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'S': // millisecond 0-999
+            this->_flushNumberValue(when.mMillisecond, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        case 'z': // time zone "general" format
+        case 'Z': // time zone RFC 822 format
+        case 'X': // time zone ISO 8601 format
+            this->_flushTimeZoneValue(utcOffsetMilliseconds, field.mFieldCode, fieldSpecifierLength, resultToAppendTo);
+            break;
+
+        default:
+            break;
+    }
 }
 
 void VInstantFormatter::_flushFixedLengthTextValue(const VString& value, VString& resultToAppendTo) const {
@@ -1663,8 +1975,25 @@ void VInstantFormatter::_flushVariableLengthTextValue(const VString& shortValue,
 }
 
 void VInstantFormatter::_flushNumberValue(int value, int fieldLength, VString& resultToAppendTo) const {
-    VString numberFormatter(VSTRING_FORMAT("%%0%dd", fieldLength)); // note double-percent to escape the first percent sign, and extra d: we want to end up with, say, "%05d" if the field length is 5.
-    resultToAppendTo += VSTRING_FORMAT(numberFormatter, value);
+    // The common case of a small non-negative value is rendered directly rather than via a format string.
+    char digits[12];
+    if ((value < 0) || (fieldLength >= static_cast<int>(sizeof(digits)))) {
+        resultToAppendTo += VSTRING_FORMAT("%0*d", fieldLength, value);
+        return;
+    }
+
+    int start = static_cast<int>(sizeof(digits)) - 1;
+    digits[start] = '\0';
+    do {
+        digits[--start] = static_cast<char>('0' + (value % 10));
+        value /= 10;
+    } while ((value != 0) && (start > 0));
+
+    while ((start > 0) && ((static_cast<int>(sizeof(digits)) - 1 - start) < fieldLength)) {
+        digits[--start] = '0';
+    }
+
+    resultToAppendTo += &digits[start];
 }
 
 void VInstantFormatter::_flushYearValue(int year, int fieldLength, VString& resultToAppendTo) const {
@@ -1696,25 +2025,24 @@ void VInstantFormatter::_flushDayNumberValue(int dayOfWeek/*0=sun ... 6=sat*/, i
     this->_flushNumberValue(dayOfWeek == 0 ? 7 : dayOfWeek, fieldLength, resultToAppendTo);
 }
 
-void VInstantFormatter::_flushTimeZoneValue(int utcOffsetMilliseconds, const VString& fieldSpecifier, VString& resultToAppendTo) const {
+void VInstantFormatter::_flushTimeZoneValue(int utcOffsetMilliseconds, char fieldCode, int fieldLength, VString& resultToAppendTo) const {
     int absOffsetHours = V_ABS(utcOffsetMilliseconds / (1000 * 60 * 60));
     int absOffsetMinutes = V_ABS((utcOffsetMilliseconds / (1000 * 60)) % 60);
 
-    if (fieldSpecifier.startsWith('z')) { // general
+    if (fieldCode == 'z') { // general
         resultToAppendTo += VSTRING_FORMAT("GMT%c%02d:%02d", (utcOffsetMilliseconds < 0 ? '-':'+'), absOffsetHours, absOffsetMinutes);
-    } else if (fieldSpecifier.startsWith('Z')) { // RFC 822
+    } else if (fieldCode == 'Z') { // RFC 822
         resultToAppendTo += VSTRING_FORMAT("%c%02d%02d", (utcOffsetMilliseconds < 0 ? '-':'+'), absOffsetHours, absOffsetMinutes);
-    } else if (fieldSpecifier.startsWith('X')) { // ISO 8601
-        const int fieldSpecifierLength = fieldSpecifier.length();
-        VASSERT_IN_RANGE(fieldSpecifierLength, 1, 4);
+    } else if (fieldCode == 'X') { // ISO 8601
+        VASSERT_IN_RANGE(fieldLength, 1, 4);
 
         if (utcOffsetMilliseconds == 0) {
             resultToAppendTo += 'Z';
-        } else if (fieldSpecifier.length() == 1) { // rule says: sign followed by two-digit hours only
+        } else if (fieldLength == 1) { // rule says: sign followed by two-digit hours only
             resultToAppendTo += VSTRING_FORMAT("%c%02dZ", (utcOffsetMilliseconds < 0 ? '-':'+'), absOffsetHours);
-        } else if (fieldSpecifier.length() == 2) { // rule says: sign followed by two-digit hours and minutes
+        } else if (fieldLength == 2) { // rule says: sign followed by two-digit hours and minutes
             resultToAppendTo += VSTRING_FORMAT("%c%02d%02dZ", (utcOffsetMilliseconds < 0 ? '-':'+'), absOffsetHours, absOffsetMinutes);
-        } else if (fieldSpecifier.length() == 3) { // rule says: sign followed by two-digit hours, colon, and minutes
+        } else if (fieldLength == 3) { // rule says: sign followed by two-digit hours, colon, and minutes
             resultToAppendTo += VSTRING_FORMAT("%c%02d:%02dZ", (utcOffsetMilliseconds < 0 ? '-':'+'), absOffsetHours, absOffsetMinutes);
         }
     }
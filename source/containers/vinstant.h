@@ -509,6 +509,33 @@ class VInstant {
         */
         void setTrueNow();
         /**
+        Sets the instant to the current time as last recorded by the coarse clock,
+        which a VCoarseClock thread updates every few milliseconds, so that this
+        costs one atomic load rather than a system call. As with setNow(), the time
+        is affected by any simulated or frozen time state that has been set. If the
+        coarse clock is not enabled, this is the same as setNow(). Use it for "last
+        activity" bookkeeping on hot paths, where an error of up to the coarse
+        clock's update interval does not matter.
+        */
+        void setNowCoarse();
+
+        /**
+        Records the actual current time as the coarse clock value used by setNowCoarse(),
+        enabling the coarse clock if it was not already. VCoarseClock calls this
+        periodically; you only need to call it if you drive the coarse clock yourself.
+        */
+        static void updateCoarseClock();
+        /**
+        Disables the coarse clock, so that setNowCoarse() reverts to reading the
+        platform clock. VCoarseClock calls this when it is stopped.
+        */
+        static void disableCoarseClock();
+        /**
+        Returns true if the coarse clock is enabled.
+        @return obvious
+        */
+        static bool isCoarseClockEnabled();
+        /**
         Returns an object holding the broken-down fields that this instant represents
         in UTC. This is primarily for use by VInstantFormatter when formatting a string.
         @return the UTC y/m/d/h/m/s etc. values for this instant
@@ -947,6 +974,146 @@ elements are objects, not pointers to objects.
 */
 typedef std::vector<VInstant> VInstantVector;
 
+/**
+VTicks is a reading of a monotonic clock with nanosecond resolution, for
+measuring elapsed time. Unlike VInstant::snapshot(), which reads the wall
+clock in milliseconds, it does not jump when the system time is set or
+slewed, and it can resolve sub-millisecond intervals. The base value is
+unspecified, so a VTicks value is only meaningful relative to another one
+taken in the same process.
+
+VTicks is deliberately not affected by the VInstant simulated clock
+offset or frozen time: those alter what the application sees as the
+current wall time, whereas VTicks measures how long the code actually
+took. Use VInstant for times that are displayed, stored, or compared to
+the calendar, and VTicks (or VStopwatch) for latency and timeout
+measurements.
+
+On Unix the clock is clock_gettime(CLOCK_MONOTONIC); on Windows it is
+QueryPerformanceCounter(). If VAULT_TICKS_USE_TSC is defined and the
+processor is x86 with an invariant time stamp counter, the clock is
+instead the TSC read by rdtsc, calibrated against the monotonic clock on
+first use; this avoids even the vDSO overhead of clock_gettime() on very
+hot paths, at the cost of a calibration of about 10 milliseconds. That
+calibration is accurate to a few parts per million, so over long spans the
+TSC clock drifts from the monotonic clock by that much; this is harmless for
+latencies and timeouts.
+
+<code>
+VTicks start;
+doSomething();
+Vs64 elapsedNanoseconds = VTicks() - start;
+</code>
+
+@see VStopwatch
+*/
+class VTicks {
+    public:
+
+        /** Constructs a value for the current time. */
+        VTicks() : mNanoseconds(VTicks::snapshot()) {}
+        /** Constructs a value from a snapshot() value. @param nanoseconds a value returned by snapshot() */
+        explicit VTicks(Vs64 nanoseconds) : mNanoseconds(nanoseconds) {}
+        ~VTicks() {}
+
+        /**
+        Returns the current monotonic clock value, in nanoseconds from an unspecified base.
+        @return the current monotonic clock value
+        */
+        static Vs64 snapshot();
+        /**
+        Returns the time elapsed since a snapshot() value.
+        @param  snapshotValue   a value returned by snapshot()
+        @return the elapsed time in nanoseconds
+        */
+        static Vs64 getNanosecondsSince(Vs64 snapshotValue) { return VTicks::snapshot() - snapshotValue; }
+        /**
+        Returns true if the clock is the calibrated time stamp counter rather than
+        the operating system's monotonic clock. Only possible if VAULT_TICKS_USE_TSC
+        is defined.
+        @return true if rdtsc is in use
+        */
+        static bool isUsingTSC();
+        /**
+        Formats a number of nanoseconds for log output, in whichever of ns, us, ms,
+        or s gives a readable number: for example "850ns", "12.345us", "1.500ms",
+        "3.250s".
+        @param  nanoseconds the interval to format
+        @return the formatted string
+        */
+        static VString getDurationString(Vs64 nanoseconds);
+
+        /** Returns the value in nanoseconds from an unspecified base. @return obvious */
+        Vs64 getValue() const { return mNanoseconds; }
+        /** Returns the time elapsed since this value. @return the elapsed time in nanoseconds */
+        Vs64 getNanosecondsSince() const { return VTicks::snapshot() - mNanoseconds; }
+
+        friend inline bool operator==(const VTicks& lhs, const VTicks& rhs);    ///< Compares two values.
+        friend inline bool operator!=(const VTicks& lhs, const VTicks& rhs);    ///< Compares two values.
+        friend inline bool operator< (const VTicks& lhs, const VTicks& rhs);    ///< Compares two values.
+        friend inline bool operator> (const VTicks& lhs, const VTicks& rhs);    ///< Compares two values.
+        friend inline Vs64 operator-(const VTicks& t1, const VTicks& t2);      ///< Returns the nanoseconds from t2 to t1. @param t1 a value @param t2 a value @return t1 - t2 in nanoseconds
+
+        static const Vs64 kNanosecondsPerMicrosecond = CONST_S64(1000);          ///< Nanoseconds in one microsecond.
+        static const Vs64 kNanosecondsPerMillisecond = CONST_S64(1000000);       ///< Nanoseconds in one millisecond.
+        static const Vs64 kNanosecondsPerSecond = CONST_S64(1000000000);         ///< Nanoseconds in one second.
+
+    private:
+
+        /**
+        Returns the platform's monotonic clock value in nanoseconds. Implemented in
+        the platform-specific version of vinstant_platform.cpp.
+        @return a clock value representing "now" in nanoseconds, base undefined
+        */
+        static Vs64 _platform_ticks();
+
+        Vs64 mNanoseconds; ///< The monotonic clock value.
+};
+
+inline bool operator==(const VTicks& lhs, const VTicks& rhs) { return lhs.mNanoseconds == rhs.mNanoseconds; }
+inline bool operator!=(const VTicks& lhs, const VTicks& rhs) { return lhs.mNanoseconds != rhs.mNanoseconds; }
+inline bool operator< (const VTicks& lhs, const VTicks& rhs) { return lhs.mNanoseconds < rhs.mNanoseconds; }
+inline bool operator> (const VTicks& lhs, const VTicks& rhs) { return lhs.mNanoseconds > rhs.mNanoseconds; }
+inline Vs64 operator-(const VTicks& t1, const VTicks& t2) { return t1.mNanoseconds - t2.mNanoseconds; }
+
+/**
+VStopwatch measures the time elapsed since it was started, using VTicks.
+It starts when constructed, and start() restarts it.
+
+<code>
+VStopwatch stopwatch;
+doSomething();
+VLOGGER_DEBUG(VSTRING_FORMAT("doSomething took %s.", stopwatch.getElapsedString().chars()));
+</code>
+*/
+class VStopwatch {
+    public:
+
+        /** Constructs and starts the stopwatch. */
+        VStopwatch() : mStart() {}
+        ~VStopwatch() {}
+
+        /** Restarts the stopwatch from now. */
+        void start() { mStart = VTicks(); }
+        /** Returns the time at which the stopwatch was started. @return obvious */
+        const VTicks& getStartTicks() const { return mStart; }
+
+        /** Returns the elapsed time in nanoseconds. @return obvious */
+        Vs64 getElapsedNanoseconds() const { return mStart.getNanosecondsSince(); }
+        /** Returns the elapsed time in whole microseconds. @return obvious */
+        Vs64 getElapsedMicroseconds() const { return this->getElapsedNanoseconds() / VTicks::kNanosecondsPerMicrosecond; }
+        /** Returns the elapsed time in whole milliseconds. @return obvious */
+        Vs64 getElapsedMilliseconds() const { return this->getElapsedNanoseconds() / VTicks::kNanosecondsPerMillisecond; }
+        /** Returns the elapsed time as a VDuration, truncated to milliseconds. @return obvious */
+        VDuration getElapsedDuration() const { return VDuration::MILLISECOND() * this->getElapsedMilliseconds(); }
+        /** Returns the elapsed time formatted by VTicks::getDurationString(). @return obvious */
+        VString getElapsedString() const { return VTicks::getDurationString(this->getElapsedNanoseconds()); }
+
+    private:
+
+        VTicks mStart; ///< When the stopwatch was started.
+};
+
 /**
 VDate represents a calendar date: a year/month/day.
 Per (*) below, the "day" field is actually allowed to be in the range 1 to 32,
@@ -1309,9 +1476,15 @@ You can also supply a locale info object to indicate the language of non-numeric
 parts of the string. In the future this may also include some aspects of formatting
 that differ per locale rather than per format specifier.
 
+The format specifier is compiled when the formatter is constructed into a list of
+literal text and field instructions, so formatting does not re-parse it.
+
 Because there is nothing mutable in this class, and because there is no transient
 internal state in the object, the format() method can be called freely by multiple
-threads at the same time.
+threads at the same time. To make formatting a series of nearby instants cheap (a
+logger formats one for every line), each thread caches the broken-down time of the
+second it most recently formatted, and the text that was rendered for it; formatting
+another instant in the same second then only needs to re-render the milliseconds.
 */
 class VInstantFormatter {
     public:
@@ -1373,14 +1546,45 @@ class VInstantFormatter {
         VString getFormatSpecifier() const { return mFormatSpecifier; }
 
     private:
-    
+
+        /**
+        One step of the compiled format specifier: either literal text, or a field
+        specifier character and the number of times it was repeated.
+        */
+        struct Instruction {
+            Instruction(char fieldCode, int fieldLength, const VString& text) : mFieldCode(fieldCode), mFieldLength(fieldLength), mText(text) {}
+            char    mFieldCode;     ///< The field specifier character, or 0 for literal text.
+            int     mFieldLength;   ///< The number of times the field specifier character was repeated.
+            VString mText;          ///< The literal text, if mFieldCode is 0.
+        };
+        typedef std::vector<Instruction> InstructionList;
+
+        /**
+        Compiles mFormatSpecifier into mInstructions. Called by the constructors.
+        */
+        void _compile();
+        void _addLiteralInstruction(VString& pendingLiteral/*will be set to empty on return*/);
+        void _addFieldInstruction(VString& pendingLiteral/*will be set to empty on return*/, VString& fieldSpecifier/*will be set to empty on return*/);
+
+        /**
+        Formats an instant in the local or UTC time zone, using and updating the calling
+        thread's cache of the most recently formatted second.
+        */
+        VString _formatInstant(const VInstant& when, bool isLocal) const;
         /**
         This is what we call internally to format the instant after converting it to
         a broken-down set of information. If it's a UTC time, the offset is zero;
         otherwise it's the offset in milliseconds.
         */
         VString _format(const VInstantStruct& when, int utcOffsetMilliseconds) const;
-        void _flushPendingFieldSpecifier(const VInstantStruct& when, int utcOffsetMilliseconds, VString& fieldSpecifier/*will be set to empty on return*/, VString& resultToAppendTo) const;
+        /**
+        Appends the formatted instant to the result. If millisecondOffsets is not null,
+        the offset in the result of the last three digits of each millisecond field is
+        appended to it, so that the caller can later replace them for another instant
+        in the same second.
+        */
+        void _render(const VInstantStruct& when, int utcOffsetMilliseconds, VString& resultToAppendTo, std::vector<int>* millisecondOffsets) const;
+        void _flushFieldValue(const Instruction& field, const VInstantStruct& when, int utcOffsetMilliseconds, VString& resultToAppendTo) const;
 
         void _flushFixedLengthTextValue(const VString& value, VString& resultToAppendTo) const;
         void _flushVariableLengthTextValue(const VString& shortValue, const VString& longValue, int fieldLength, VString& resultToAppendTo) const;
@@ -1389,9 +1593,12 @@ class VInstantFormatter {
         void _flushMonthValue(int month, int fieldLength, VString& resultToAppendTo) const;
         void _flushDayNameValue(int dayOfWeek/*0=sun ... 6=sat*/, int fieldLength, VString& resultToAppendTo) const;
         void _flushDayNumberValue(int dayOfWeek/*0=sun ... 6=sat*/, int fieldLength, VString& resultToAppendTo) const;
-        void _flushTimeZoneValue(int utcOffsetMilliseconds, const VString& fieldSpecifier, VString& resultToAppendTo) const;
-        
-        VString mFormatSpecifier;
+        void _flushTimeZoneValue(int utcOffsetMilliseconds, char fieldCode, int fieldLength, VString& resultToAppendTo) const;
+
+        VString         mFormatSpecifier;
+        InstructionList mInstructions;                  ///< The compiled format specifier.
+        bool            mMillisecondsAreFixedWidth;     ///< True if every millisecond field is at least 3 digits, so cached text can be updated in place.
+        int             mFormatterID;                   ///< Identifies this formatter's text in the per-thread cache. Copies share the ID, since they format identically.
         
         // Pseudo-constants: Potentially localized values, not static, because we allow setting per VInstantFormatter.
         const VInstantFormatterLocaleInfo& mLocaleInfo;
@@ -0,0 +1,435 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vasyncfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vthread.h"
+#include "vmutexlocker.h"
+#include "vexception.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #include <linux/io_uring.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+        // IORING_FEAT_RW_CUR_POS arrived in Linux 5.6 along with IORING_OP_READ and IORING_OP_WRITE, which we use.
+        #if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(IORING_FEAT_RW_CUR_POS)
+            #define VASYNCFILESTREAM_IO_URING_SUPPORT
+        #endif
+    #endif
+#endif
+
+// Platform-specific implementation of VAsyncFileStream: the io_uring engine on Linux, and aligned buffers.
+
+// static
+Vu8* VAsyncFileStream::allocateAlignedBuffer(Vs64 length) {
+    void* buffer = NULL;
+    int result = ::posix_memalign(&buffer, kDirectIOAlignment, static_cast<size_t>(V_MAX(CONST_S64(1), length)));
+
+    if (result != 0) {
+        throw VException(VSystemError(result), VSTRING_FORMAT("VAsyncFileStream::allocateAlignedBuffer failed to allocate " VSTRING_FORMATTER_S64 " bytes.", length));
+    }
+
+    return static_cast<Vu8*>(buffer);
+}
+
+// static
+void VAsyncFileStream::freeAlignedBuffer(Vu8* buffer) {
+    ::free(buffer);
+}
+
+// static
+int VAsyncFileStream::_platform_getDirectIOFlag() {
+#ifdef O_DIRECT
+    return O_DIRECT;
+#else
+    return 0; // Mac OS X has no O_DIRECT; fcntl(F_NOCACHE) is only a hint, so we do without.
+#endif
+}
+
+#ifdef VASYNCFILESTREAM_IO_URING_SUPPORT
+
+static const unsigned kNumRingEntries = 256;
+static const Vs64 kMaxTransferSize = CONST_S64(0x7FFFF000); // the most Linux transfers in one read or write
+
+class VAsyncFileIOUringReaper;
+
+/**
+The engine that performs requests with Linux io_uring. Requests are placed in the
+submission ring, which the kernel reads when we call io_uring_enter(), once per batch.
+The kernel performs them without a thread per request, and posts the results to the
+completion ring, where a single reaper thread collects them and completes the requests.
+
+At most as many requests are in flight as the completion ring has entries, so that it can
+never overflow; a submitter beyond that waits for the reaper to make room. A read or write
+that transfers less than requested, other than at end of file, is resubmitted for the rest
+by the reaper, without giving up its place.
+*/
+class VAsyncFileIOUringEngine : public VAsyncFileEngine {
+    public:
+
+        /**
+        Sets up a ring and starts its reaper thread.
+        @return the engine, or NULL if io_uring cannot be used here
+        */
+        static VAsyncFileIOUringEngine* create();
+
+        virtual ~VAsyncFileIOUringEngine();
+
+        virtual void submit(const VAsyncFileRequestList& requests);
+        virtual const char* getName() const { return "io_uring"; }
+
+    private:
+
+        friend class VAsyncFileIOUringReaper;
+
+        VAsyncFileIOUringEngine();
+
+        /**
+        Creates and maps the ring.
+        @return true if it succeeded
+        */
+        bool _setUp();
+        /**
+        Places the next step of a request in the submission ring, first passing the ring's
+        contents to the kernel if it is full. The caller must hold mSubmitMutex.
+        @param  request the request, or NULL to queue the no-op that stops the reaper
+        */
+        void _queue(VAsyncFileRequest* request);
+        /**
+        Passes the queued requests to the kernel. The caller must hold mSubmitMutex.
+        */
+        void _enter();
+        /**
+        Collects completions until the engine is stopped. Called by the reaper thread.
+        */
+        void _reap();
+        /**
+        Handles one completion: resubmits the rest of a partial transfer, or completes the
+        request and makes room for another.
+        @param  request the request
+        @param  result  the number of bytes transferred, or the negated errno value
+        */
+        void _handleCompletion(VAsyncFileRequest* request, int result);
+
+        int                             mRingFD;            ///< The io_uring file descriptor.
+        unsigned                        mNumSQEntries;      ///< The number of entries in the submission ring.
+        unsigned                        mMaxInFlight;       ///< The number of entries in the completion ring.
+        void*                           mSQRing;            ///< The mapped submission ring.
+        size_t                          mSQRingSize;        ///< Its size.
+        void*                           mCQRing;            ///< The mapped completion ring; the same as mSQRing if the kernel maps them together.
+        size_t                          mCQRingSize;        ///< Its size.
+        struct io_uring_sqe*            mSQEs;              ///< The mapped submission queue entries.
+        size_t                          mSQEsSize;          ///< Their size.
+        unsigned*                       mSQHead;            ///< The submission ring head, advanced by the kernel.
+        unsigned*                       mSQTail;            ///< The submission ring tail, advanced by us.
+        unsigned*                       mSQMask;            ///< The submission ring index mask.
+        unsigned*                       mSQArray;           ///< The submission ring, of indexes into mSQEs.
+        unsigned*                       mCQHead;            ///< The completion ring head, advanced by us.
+        unsigned*                       mCQTail;            ///< The completion ring tail, advanced by the kernel.
+        unsigned*                       mCQMask;            ///< The completion ring index mask.
+        struct io_uring_cqe*            mCQEs;              ///< The completion ring.
+        VMutex                          mSubmitMutex;       ///< Serializes use of the submission ring, and protects the counts.
+        VSemaphore                      mSpaceSemaphore;    ///< Broadcast when a request completes, for submitters waiting for room.
+        unsigned                        mNumInFlight;       ///< The number of requests queued or in the kernel.
+        unsigned                        mNumToSubmit;       ///< The number queued since the last io_uring_enter().
+        VAsyncFileIOUringReaper*        mReaper;            ///< The reaper thread.
+};
+
+/**
+The thread that collects completions from the io_uring ring.
+*/
+class VAsyncFileIOUringReaper : public VThread {
+    public:
+
+        VAsyncFileIOUringReaper(VAsyncFileIOUringEngine& engine) :
+            VThread("VAsyncFileStream.io_uring", "vault.files.VAsyncFileStream", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mEngine(engine) {
+        }
+
+        virtual ~VAsyncFileIOUringReaper() {}
+
+        virtual void run() {
+            mEngine._reap();
+        }
+
+    private:
+
+        VAsyncFileIOUringReaper(const VAsyncFileIOUringReaper&); // not copyable
+        VAsyncFileIOUringReaper& operator=(const VAsyncFileIOUringReaper&); // not assignable
+
+        VAsyncFileIOUringEngine& mEngine;
+};
+
+// static
+VAsyncFileIOUringEngine* VAsyncFileIOUringEngine::create() {
+    VAsyncFileIOUringEngine* engine = new VAsyncFileIOUringEngine();
+
+    if (! engine->_setUp()) {
+        delete engine;
+        return NULL;
+    }
+
+    engine->mReaper = new VAsyncFileIOUringReaper(*engine);
+    engine->mReaper->start();
+    return engine;
+}
+
+VAsyncFileIOUringEngine::VAsyncFileIOUringEngine()
+    : VAsyncFileEngine()
+    , mRingFD(-1)
+    , mNumSQEntries(0)
+    , mMaxInFlight(0)
+    , mSQRing(MAP_FAILED)
+    , mSQRingSize(0)
+    , mCQRing(MAP_FAILED)
+    , mCQRingSize(0)
+    , mSQEs(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+    , mSQEsSize(0)
+    , mSQHead(NULL)
+    , mSQTail(NULL)
+    , mSQMask(NULL)
+    , mSQArray(NULL)
+    , mCQHead(NULL)
+    , mCQTail(NULL)
+    , mCQMask(NULL)
+    , mCQEs(NULL)
+    , mSubmitMutex("VAsyncFileIOUringEngine::mSubmitMutex", true/*suppress logging; it is held across the waits for room*/)
+    , mSpaceSemaphore()
+    , mNumInFlight(0)
+    , mNumToSubmit(0)
+    , mReaper(NULL)
+    {
+}
+
+VAsyncFileIOUringEngine::~VAsyncFileIOUringEngine() {
+    if (mReaper != NULL) {
+        VMutexLocker locker(&mSubmitMutex, "VAsyncFileIOUringEngine::~VAsyncFileIOUringEngine");
+        while (mNumInFlight > 0) {
+            mSpaceSemaphore.wait(&mSubmitMutex, VDuration::ZERO());
+        }
+
+        this->_queue(NULL);
+        this->_enter();
+        locker.unlock();
+
+        (void) mReaper->join();
+        delete mReaper;
+    }
+
+    if (mSQEs != MAP_FAILED) {
+        (void) ::munmap(mSQEs, mSQEsSize);
+    }
+
+    if ((mCQRing != MAP_FAILED) && (mCQRing != mSQRing)) {
+        (void) ::munmap(mCQRing, mCQRingSize);
+    }
+
+    if (mSQRing != MAP_FAILED) {
+        (void) ::munmap(mSQRing, mSQRingSize);
+    }
+
+    if (mRingFD != -1) {
+        (void) VFileSystem::close(mRingFD);
+    }
+}
+
+bool VAsyncFileIOUringEngine::_setUp() {
+    struct io_uring_params params;
+    ::memset(&params, 0, sizeof(params));
+
+    mRingFD = static_cast<int>(::syscall(__NR_io_uring_setup, kNumRingEntries, &params));
+    if (mRingFD == -1) {
+        return false; // ENOSYS on an older kernel; EPERM where a sandbox or sysctl forbids io_uring
+    }
+
+    if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+        return false; // before Linux 5.6, which lacks IORING_OP_READ and IORING_OP_WRITE
+    }
+
+    mNumSQEntries = params.sq_entries;
+    mMaxInFlight = params.cq_entries;
+    mSQRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    mCQRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    const bool singleMap = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+    if (singleMap) {
+        mSQRingSize = mCQRingSize = V_MAX(mSQRingSize, mCQRingSize);
+    }
+
+    mSQRing = ::mmap(NULL, mSQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFD, IORING_OFF_SQ_RING);
+    if (mSQRing == MAP_FAILED) {
+        return false;
+    }
+
+    if (singleMap) {
+        mCQRing = mSQRing;
+    } else {
+        mCQRing = ::mmap(NULL, mCQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFD, IORING_OFF_CQ_RING);
+        if (mCQRing == MAP_FAILED) {
+            return false;
+        }
+    }
+
+    mSQEsSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    mSQEs = static_cast<struct io_uring_sqe*>(::mmap(NULL, mSQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRingFD, IORING_OFF_SQES));
+    if (mSQEs == MAP_FAILED) {
+        return false;
+    }
+
+    Vu8* sqRing = static_cast<Vu8*>(mSQRing);
+    mSQHead = reinterpret_cast<unsigned*>(sqRing + params.sq_off.head);
+    mSQTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+    mSQMask = reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+    mSQArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+
+    Vu8* cqRing = static_cast<Vu8*>(mCQRing);
+    mCQHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+    mCQTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+    mCQMask = reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+    mCQEs = reinterpret_cast<struct io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+    return true;
+}
+
+void VAsyncFileIOUringEngine::submit(const VAsyncFileRequestList& requests) {
+    VMutexLocker locker(&mSubmitMutex, "VAsyncFileIOUringEngine::submit");
+
+    for (VAsyncFileRequestList::const_iterator i = requests.begin(); i != requests.end(); ++i) {
+        while (mNumInFlight >= mMaxInFlight) {
+            this->_enter(); // the reaper can only make room for requests the kernel has
+            mSpaceSemaphore.wait(&mSubmitMutex, VDuration::ZERO());
+        }
+
+        ++mNumInFlight;
+        this->_queue(i->get());
+    }
+
+    this->_enter();
+}
+
+void VAsyncFileIOUringEngine::_queue(VAsyncFileRequest* request) {
+    unsigned tail = *mSQTail; // only we write it
+    if ((tail - __atomic_load_n(mSQHead, __ATOMIC_ACQUIRE)) == mNumSQEntries) {
+        this->_enter();
+        tail = *mSQTail;
+    }
+
+    const unsigned index = tail & *mSQMask;
+    struct io_uring_sqe* sqe = &mSQEs[index];
+    ::memset(sqe, 0, sizeof(*sqe));
+
+    if (request == NULL) {
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+    } else {
+        sqe->fd = VAsyncFileEngine::_getFileDescriptor(*request);
+        sqe->user_data = reinterpret_cast<Vu64>(request);
+
+        if (request->getOperation() == VAsyncFileRequest::kSync) {
+            sqe->opcode = IORING_OP_FSYNC;
+        } else {
+            const Vs64 numBytesDone = VAsyncFileEngine::_getNumBytesTransferred(*request);
+            sqe->opcode = (request->getOperation() == VAsyncFileRequest::kRead) ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->addr = reinterpret_cast<Vu64>(request->getBuffer() + numBytesDone);
+            sqe->len = static_cast<unsigned>(V_MIN(kMaxTransferSize, request->getLength() - numBytesDone));
+            sqe->off = static_cast<Vu64>(request->getOffset() + numBytesDone);
+        }
+    }
+
+    mSQArray[index] = index;
+    __atomic_store_n(mSQTail, tail + 1, __ATOMIC_RELEASE);
+    ++mNumToSubmit;
+}
+
+void VAsyncFileIOUringEngine::_enter() {
+    while (mNumToSubmit > 0) {
+        int result = static_cast<int>(::syscall(__NR_io_uring_enter, mRingFD, mNumToSubmit, 0, 0, NULL, 0));
+
+        if (result >= 0) {
+            mNumToSubmit -= static_cast<unsigned>(result);
+        } else if ((errno == EAGAIN) || (errno == EBUSY)) {
+            VThread::yield(); // the kernel is short of memory or completion space; let it catch up
+        } else if (errno != EINTR) {
+            // The ring itself is broken; nothing we submit can proceed.
+            throw VStackTraceException(VSystemError(), "VAsyncFileIOUringEngine: io_uring_enter failed.");
+        }
+    }
+}
+
+void VAsyncFileIOUringEngine::_reap() {
+    for (;;) {
+        unsigned head = *mCQHead; // only we write it
+        const unsigned tail = __atomic_load_n(mCQTail, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            (void) ::syscall(__NR_io_uring_enter, mRingFD, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            continue;
+        }
+
+        while (head != tail) {
+            const struct io_uring_cqe* cqe = &mCQEs[head & *mCQMask];
+            VAsyncFileRequest* request = reinterpret_cast<VAsyncFileRequest*>(cqe->user_data);
+            const int result = cqe->res;
+            __atomic_store_n(mCQHead, ++head, __ATOMIC_RELEASE);
+
+            if (request == NULL) {
+                return; // the destructor's no-op, queued once nothing else is in flight
+            }
+
+            this->_handleCompletion(request, result);
+        }
+    }
+}
+
+void VAsyncFileIOUringEngine::_handleCompletion(VAsyncFileRequest* request, int result) {
+    int errorCode = 0;
+    bool moreToDo = false;
+
+    if (result >= 0) {
+        moreToDo = (request->getOperation() != VAsyncFileRequest::kSync) && VAsyncFileEngine::_advance(*request, result);
+    } else if ((result == -EINTR) || (result == -EAGAIN)) {
+        moreToDo = true;
+    } else {
+        errorCode = -result;
+    }
+
+    VMutexLocker locker(&mSubmitMutex, "VAsyncFileIOUringEngine::_handleCompletion");
+
+    if (moreToDo) {
+        this->_queue(request);
+        this->_enter();
+        return;
+    }
+
+    --mNumInFlight;
+    mSpaceSemaphore.broadcast();
+    locker.unlock();
+
+    VAsyncFileEngine::_complete(*request, errorCode);
+}
+
+// static
+VAsyncFileEngine* VAsyncFileStream::_platform_createNativeEngine() {
+    return VAsyncFileIOUringEngine::create();
+}
+
+#else /* VASYNCFILESTREAM_IO_URING_SUPPORT */
+
+// static
+VAsyncFileEngine* VAsyncFileStream::_platform_createNativeEngine() {
+    return NULL; // requests are performed on the blocking i/o pool
+}
+
+#endif /* VASYNCFILESTREAM_IO_URING_SUPPORT */
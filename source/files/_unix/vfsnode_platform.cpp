@@ -11,8 +11,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vtypes_internal.h"
 
 #include "vexception.h"
-#include "vthread.h"
 #include <dirent.h>
+#include <fcntl.h>
 
 #ifdef VPLATFORM_MAC
     #ifndef VPLATFORM_MAC_IOS
@@ -292,17 +292,21 @@ VFSNode VFSNode::_platform_getExecutable() {
 
 #endif /* end of generic Unix implementation of VFSNode::_platform_getKnownDirectoryNode and VFSNode::_platform_getExecutable */
 
+static void _getNodeInfoFromStat(const struct stat& statData, VFSNodeInfo& info) {
+    info.mCreationDate = CONST_S64(1000) * static_cast<Vs64>(statData.st_ctime);
+    info.mModificationDate = CONST_S64(1000) * static_cast<Vs64>(statData.st_mtime);
+    info.mFileSize = statData.st_size;
+    info.mIsFile = (! S_ISDIR(statData.st_mode)) && (! S_ISLNK(statData.st_mode));
+    info.mIsDirectory = (S_ISDIR(statData.st_mode)) || (S_ISLNK(statData.st_mode));
+    info.mErrNo = 0;
+}
+
 bool VFSNode::_platform_getNodeInfo(VFSNodeInfo& info) const {
     struct stat statData;
     int result = VFileSystem::stat(mPath, &statData);
 
     if (result >= 0) {
-        info.mCreationDate = CONST_S64(1000) * static_cast<Vs64>(statData.st_ctime);
-        info.mModificationDate = CONST_S64(1000) * static_cast<Vs64>(statData.st_mtime);
-        info.mFileSize = statData.st_size;
-        info.mIsFile = (! S_ISDIR(statData.st_mode)) && (! S_ISLNK(statData.st_mode));
-        info.mIsDirectory = (S_ISDIR(statData.st_mode)) || (S_ISLNK(statData.st_mode));
-        info.mErrNo = 0;
+        _getNodeInfoFromStat(statData, info);
     } else {
         info.mErrNo = errno;
     }
@@ -351,8 +355,6 @@ void VFSNode::_platform_directoryIterate(VDirectoryIterationCallback& callback)
         struct dirent* entry = ::readdir(dir);
 
         while (keepGoing && (entry != NULL)) {
-            VThread::yield(); // be nice if we're iterating over a huge directory
-
             nodeName.copyFromCString(entry->d_name);
 
             // Skip current and parent pseudo-entries. Otherwise client must
@@ -374,3 +376,120 @@ void VFSNode::_platform_directoryIterate(VDirectoryIterationCallback& callback)
     ::closedir(dir);
 }
 
+
+// This is the Unix implementation of the directory walk. Each directory is read
+// through a descriptor opened relative to its parent's, so the kernel never
+// re-resolves the full path; and the entry type that readdir() supplies is used
+// to tell files from directories, so that a node is only stat'ed if the caller
+// wants its dates and size, or the file system does not supply the type, or the
+// node is a symbolic link and we must see what it points to.
+
+static void _walkDirectoryDescriptor(VDirectoryWalk& walk, int directoryFD, const VString& directoryPath, int depth) {
+    DIR* dir = ::fdopendir(directoryFD);
+    if (dir == NULL) {
+        int errNo = errno;
+        ::close(directoryFD);
+        walk.getCallback().handleWalkError(directoryPath, errNo);
+        return;
+    }
+
+    try {
+        VDirectoryWalkCallback& callback = walk.getCallback();
+        struct dirent* entry;
+
+        while ((! walk.isStopped()) && ((entry = ::readdir(dir)) != NULL)) {
+            const char* name = entry->d_name;
+
+            // Skip current and parent pseudo-entries.
+            if ((name[0] == '.') && ((name[1] == 0) || ((name[1] == '.') && (name[2] == 0)))) {
+                continue;
+            }
+
+            VFSNodeInfo info;
+            struct stat statData;
+            unsigned char type = entry->d_type;
+
+            bool haveInfo = false;
+
+            if (type == DT_UNKNOWN) {
+                if (::fstatat(directoryFD, name, &statData, AT_SYMLINK_NOFOLLOW) == 0) {
+                    type = IFTODT(statData.st_mode);
+                    if (type != DT_LNK) {
+                        _getNodeInfoFromStat(statData, info);
+                        haveInfo = true;
+                    }
+                } else {
+                    info.mErrNo = errno;
+                    haveInfo = true;
+                }
+            }
+
+            if (! haveInfo) {
+                if ((type == DT_LNK) || walk.getNodeInfo()) {
+                    if (::fstatat(directoryFD, name, &statData, 0) == 0) {
+                        _getNodeInfoFromStat(statData, info);
+                    } else {
+                        info.mErrNo = errno; // e.g., a dangling link: neither file nor directory
+                    }
+                } else {
+                    info.mIsDirectory = (type == DT_DIR);
+                    info.mIsFile = ! info.mIsDirectory;
+                }
+            }
+
+            VDirectoryWalkEntry walkEntry(directoryPath, name, depth, info, (type == DT_LNK));
+            if (! callback.handleWalkEntry(walkEntry)) {
+                walk.stop();
+                break;
+            }
+
+            // Never descend through a link; it could lead back up the tree.
+            if ((type == DT_DIR) && callback.shouldDescend(walkEntry)) {
+                VString childPath;
+                childPath.format("%s%s%s", directoryPath.chars(), (directoryPath.endsWith(VFSNode::PATH_SEPARATOR_CHAR) ? "" : VFSNode::PATH_SEPARATOR_CHARS), name);
+
+                if (! walk.handOff(childPath, depth + 1)) {
+                    int childFD = ::openat(directoryFD, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                    if (childFD < 0) {
+                        callback.handleWalkError(childPath, errno);
+                    } else {
+                        _walkDirectoryDescriptor(walk, childFD, childPath, depth + 1);
+                    }
+                }
+            }
+        }
+    } catch (...) {
+        ::closedir(dir);
+        throw;
+    }
+
+    ::closedir(dir);
+}
+
+// static
+void VFSNode::_platform_walkDirectory(VDirectoryWalk& walk, const VString& directoryPath, int depth) {
+    int directoryFD = ::open(directoryPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (directoryFD < 0) {
+        if (depth == 0) {
+            throw VException(VSystemError(), VSTRING_FORMAT("VFSNode::_platform_walkDirectory failed for directory '%s'.", directoryPath.chars()));
+        }
+
+        walk.getCallback().handleWalkError(directoryPath, errno);
+        return;
+    }
+
+    _walkDirectoryDescriptor(walk, directoryFD, directoryPath, depth);
+}
+
+// static
+VString VFSNode::_platform_getRealPath(const VString& path) {
+    char* resolvedPath = ::realpath(path, NULL);
+    if (resolvedPath == NULL) {
+        return VString::EMPTY();
+    }
+
+    VString realPath(resolvedPath);
+    ::free(resolvedPath);
+    return realPath;
+}
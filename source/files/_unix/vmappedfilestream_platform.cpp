@@ -0,0 +1,77 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vmappedfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vexception.h"
+
+#include <sys/mman.h>
+
+// Platform-specific implementation of VMappedFileStream mapping functions.
+
+void VMappedFileStream::_platform_map(Vs64 mapLength) {
+    int protection = mWritable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* address = ::mmap(NULL, static_cast<size_t>(mapLength), protection, MAP_SHARED, mFile, 0);
+
+    if (address == MAP_FAILED) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to map " VSTRING_FORMATTER_S64 " bytes of '%s'.", mapLength, mNode.getPath().chars()));
+    }
+
+    mMapAddress = static_cast<Vu8*>(address);
+    mMapLength = mapLength;
+}
+
+void VMappedFileStream::_platform_unmap() {
+    if (mMapAddress != NULL) {
+        (void) ::munmap(mMapAddress, static_cast<size_t>(mMapLength));
+        mMapAddress = NULL;
+        mMapLength = 0;
+    }
+}
+
+void VMappedFileStream::_platform_resizeFile(Vs64 length) {
+    int result;
+
+    do {
+        result = ::ftruncate(mFile, static_cast<off_t>(length));
+    } while ((result != 0) && (errno == EINTR));
+
+    if (result != 0) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to set length of '%s' to " VSTRING_FORMATTER_S64 ".", mNode.getPath().chars(), length));
+    }
+}
+
+Vs64 VMappedFileStream::_platform_getFileSize() const {
+    struct stat statData;
+
+    if (::fstat(mFile, &statData) != 0) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to get size of '%s'.", mNode.getPath().chars()));
+    }
+
+    return static_cast<Vs64>(statData.st_size);
+}
+
+void VMappedFileStream::_platform_advise() {
+    int advice = MADV_NORMAL;
+
+    switch (mAccessPattern) {
+        case kAccessSequential: advice = MADV_SEQUENTIAL; break;
+        case kAccessRandom:     advice = MADV_RANDOM; break;
+        case kAccessWillNeed:   advice = MADV_WILLNEED; break;
+        default:                break;
+    }
+
+    // This is only a hint, so failure is not an error.
+    (void) ::madvise(mMapAddress, static_cast<size_t>(mMapLength), advice);
+}
+
+void VMappedFileStream::_platform_sync() {
+    (void) ::msync(mMapAddress, static_cast<size_t>(mMapLength), MS_ASYNC);
+}
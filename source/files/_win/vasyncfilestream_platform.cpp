@@ -0,0 +1,44 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vasyncfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vexception.h"
+
+#include <malloc.h>
+
+// Platform-specific implementation of VAsyncFileStream: aligned buffers. Windows has no
+// engine of its own here; requests are performed on the blocking i/o pool.
+
+// static
+Vu8* VAsyncFileStream::allocateAlignedBuffer(Vs64 length) {
+    void* buffer = ::_aligned_malloc(static_cast<size_t>(V_MAX(CONST_S64(1), length)), kDirectIOAlignment);
+
+    if (buffer == NULL) {
+        throw VException(VSystemError(ENOMEM), VSTRING_FORMAT("VAsyncFileStream::allocateAlignedBuffer failed to allocate " VSTRING_FORMATTER_S64 " bytes.", length));
+    }
+
+    return static_cast<Vu8*>(buffer);
+}
+
+// static
+void VAsyncFileStream::freeAlignedBuffer(Vu8* buffer) {
+    ::_aligned_free(buffer);
+}
+
+// static
+int VAsyncFileStream::_platform_getDirectIOFlag() {
+    return 0; // the CRT open() has no equivalent of FILE_FLAG_NO_BUFFERING
+}
+
+// static
+VAsyncFileEngine* VAsyncFileStream::_platform_createNativeEngine() {
+    return NULL;
+}
@@ -322,3 +322,106 @@ void VFSNode::_platform_directoryIterate(VDirectoryIterationCallback& callback)
     ::FindClose(dir);
 }
 
+
+// This is the Windows implementation of the directory walk. FindFirstFileW()
+// already supplies each node's attributes, dates, and size, so no node needs to
+// be examined separately, whether or not the caller wants its dates and size.
+
+static Vs64 _fileTimeToInstantOffset(const FILETIME& fileTime) {
+    const Vs64 FILETIME_TICKS_AT_1970 = CONST_S64(116444736000000000); // 100ns ticks from 1601 to 1970
+    Vs64 ticks = (static_cast<Vs64>(fileTime.dwHighDateTime) << 32) | static_cast<Vs64>(fileTime.dwLowDateTime);
+    return (ticks - FILETIME_TICKS_AT_1970) / CONST_S64(10000);
+}
+
+// static
+void VFSNode::_platform_walkDirectory(VDirectoryWalk& walk, const VString& directoryPath, int depth) {
+    VString searchPath(VFSNode::denormalizePath(VSTRING_FORMAT("%s/*", directoryPath.chars())));    // Supply DOS path syntax to Win32 API
+    WIN32_FIND_DATAW data;
+    HANDLE dir = ::FindFirstFileExW(searchPath.toUTF16().c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+
+    if (dir == INVALID_HANDLE_VALUE) {
+        DWORD error = ::GetLastError();
+
+        if (error == ERROR_NO_MORE_FILES) {
+            return;
+        }
+
+        if (depth == 0) {
+            throw VException(VSTRING_FORMAT("VFSNode::_platform_walkDirectory failed (error %d) for directory '%s'.", error, searchPath.chars()));
+        }
+
+        walk.getCallback().handleWalkError(directoryPath, static_cast<int>(error));
+        return;
+    }
+
+    try {
+        VDirectoryWalkCallback& callback = walk.getCallback();
+        VString nodeName;
+
+        do {
+            nodeName = data.cFileName; // assign VString from wide char string
+
+            // Skip current and parent pseudo-entries.
+            if ((nodeName == ".") || (nodeName == "..")) {
+                continue;
+            }
+
+            VFSNodeInfo info;
+            info.mCreationDate = _fileTimeToInstantOffset(data.ftCreationTime);
+            info.mModificationDate = _fileTimeToInstantOffset(data.ftLastWriteTime);
+            info.mFileSize = (static_cast<VFSize>(data.nFileSizeHigh) << 32) | static_cast<VFSize>(data.nFileSizeLow);
+            info.mIsDirectory = ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+            info.mIsFile = ! info.mIsDirectory;
+
+            VDirectoryWalkEntry walkEntry(directoryPath, nodeName.chars(), depth, info, ((data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0));
+            if (! callback.handleWalkEntry(walkEntry)) {
+                walk.stop();
+                break;
+            }
+
+            // Never descend through a link or junction; it could lead back up the tree.
+            if (info.mIsDirectory && (! walkEntry.isLink()) && callback.shouldDescend(walkEntry)) {
+                VString childPath = walkEntry.getPath();
+                if (! walk.handOff(childPath, depth + 1)) {
+                    VFSNode::_platform_walkDirectory(walk, childPath, depth + 1);
+                }
+            }
+
+        } while ((! walk.isStopped()) && ::FindNextFileW(dir, &data));
+    } catch (...) {
+        ::FindClose(dir);
+        throw;
+    }
+
+    ::FindClose(dir);
+}
+
+// static
+VString VFSNode::_platform_getRealPath(const VString& path) {
+    // Opening the node resolves any links and junctions along the path; the handle then knows the final path.
+    HANDLE handle = ::CreateFileW(VFSNode::denormalizePath(path).toUTF16().c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return VString::EMPTY();
+    }
+
+    std::wstring buffer(MAX_PATH, L'\0');
+    DWORD length = ::GetFinalPathNameByHandleW(handle, &buffer[0], static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED);
+    if (length >= buffer.size()) { // too small; length is the size needed
+        buffer.resize(length);
+        length = ::GetFinalPathNameByHandleW(handle, &buffer[0], static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED);
+    }
+
+    ::CloseHandle(handle);
+
+    if ((length == 0) || (length >= buffer.size())) {
+        return VString::EMPTY();
+    }
+
+    buffer.resize(length);
+    VString realPath(buffer); // construct VString from wide char string
+    if (realPath.startsWith("\\\\?\\")) { // strip the "\\?\" prefix that marks a path with no length limit
+        realPath.substringInPlace(4);
+    }
+
+    return VFSNode::normalizePath(realPath);
+}
@@ -0,0 +1,76 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vmappedfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vexception.h"
+
+#include <io.h>
+
+// Platform-specific implementation of VMappedFileStream mapping functions.
+
+void VMappedFileStream::_platform_map(Vs64 mapLength) {
+    HANDLE fileHandle = reinterpret_cast<HANDLE>(::_get_osfhandle(mFile));
+    DWORD maximumSizeHigh = static_cast<DWORD>(static_cast<Vu64>(mapLength) >> 32);
+    DWORD maximumSizeLow = static_cast<DWORD>(static_cast<Vu64>(mapLength) & 0xFFFFFFFF);
+
+    HANDLE mappingHandle = ::CreateFileMappingW(fileHandle, NULL, mWritable ? PAGE_READWRITE : PAGE_READONLY, maximumSizeHigh, maximumSizeLow, NULL);
+    if (mappingHandle == NULL) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to create mapping of " VSTRING_FORMATTER_S64 " bytes of '%s'.", mapLength, mNode.getPath().chars()));
+    }
+
+    void* address = ::MapViewOfFile(mappingHandle, mWritable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ, 0, 0, static_cast<SIZE_T>(mapLength));
+    if (address == NULL) {
+        VSystemError error;
+        (void) ::CloseHandle(mappingHandle);
+        throw VException(error, VSTRING_FORMAT("VMappedFileStream: Failed to map " VSTRING_FORMATTER_S64 " bytes of '%s'.", mapLength, mNode.getPath().chars()));
+    }
+
+    mMappingHandle = mappingHandle;
+    mMapAddress = static_cast<Vu8*>(address);
+    mMapLength = mapLength;
+}
+
+void VMappedFileStream::_platform_unmap() {
+    if (mMapAddress != NULL) {
+        (void) ::UnmapViewOfFile(mMapAddress);
+        mMapAddress = NULL;
+        mMapLength = 0;
+    }
+
+    if (mMappingHandle != NULL) {
+        (void) ::CloseHandle(static_cast<HANDLE>(mMappingHandle));
+        mMappingHandle = NULL;
+    }
+}
+
+void VMappedFileStream::_platform_resizeFile(Vs64 length) {
+    if (::_chsize_s(mFile, length) != 0) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to set length of '%s' to " VSTRING_FORMATTER_S64 ".", mNode.getPath().chars(), length));
+    }
+}
+
+Vs64 VMappedFileStream::_platform_getFileSize() const {
+    Vs64 length = ::_filelengthi64(mFile);
+
+    if (length == -1) {
+        throw VException(VSystemError(), VSTRING_FORMAT("VMappedFileStream: Failed to get size of '%s'.", mNode.getPath().chars()));
+    }
+
+    return length;
+}
+
+void VMappedFileStream::_platform_advise() {
+    // Windows has no equivalent of madvise() for mapped views that is available on all supported versions.
+}
+
+void VMappedFileStream::_platform_sync() {
+    (void) ::FlushViewOfFile(mMapAddress, 0);
+}
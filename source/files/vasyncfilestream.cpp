@@ -0,0 +1,485 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vasyncfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vstream.h"
+#include "vthreadpool.h"
+#include "vmutexlocker.h"
+#include "vexception.h"
+#include "vlogger.h"
+
+static const VString kLoggerName("vault.files.VAsyncFileStream");
+
+static const Vs64 kMaxTransferSize = CONST_S64(0x7FFFF000); // the most Linux transfers in one read or write; a safe size elsewhere
+static const int kNumBlockingIOWorkers = 4;
+
+// VAsyncFileRequest -----------------------------------------------------------
+
+VAsyncFileRequest::VAsyncFileRequest(Operation operation, Vu8* buffer, Vs64 offset, Vs64 length)
+    : mOperation(operation)
+    , mBuffer(buffer)
+    , mOffset(offset)
+    , mLength((operation == kSync) ? 0 : length)
+    , mOwnedBuffer(NULL)
+    , mOwnedBufferIsAligned(false)
+    , mFileDescriptor(-1)
+    , mStream(NULL)
+    , mSelf()
+    , mNumBytesTransferred(0)
+    , mErrorCode(0)
+    , mMutex("VAsyncFileRequest::mMutex", true/*suppress logging; it is held across the waits for completion*/)
+    , mCompletedSemaphore()
+    , mIsCompleted(false)
+    {
+}
+
+VAsyncFileRequest::~VAsyncFileRequest() {
+    if (mOwnedBufferIsAligned) {
+        VAsyncFileStream::freeAlignedBuffer(mOwnedBuffer);
+    } else {
+        delete [] mOwnedBuffer;
+    }
+}
+
+void VAsyncFileRequest::waitUntilCompleted() {
+    if (mIsCompleted.load()) {
+        return;
+    }
+
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::waitUntilCompleted");
+    while (! mIsCompleted.load()) {
+        mCompletedSemaphore.wait(&mMutex, VDuration::ZERO());
+    }
+}
+
+bool VAsyncFileRequest::waitUntilCompleted(const VDuration& timeoutInterval) {
+    if (mIsCompleted.load()) {
+        return true;
+    }
+
+    const Vs64 deadline = VTicks::snapshot() + timeoutInterval.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond;
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::waitUntilCompleted");
+    while (! mIsCompleted.load()) {
+        Vs64 remaining = deadline - VTicks::snapshot();
+        if (remaining <= 0) {
+            break;
+        }
+
+        mCompletedSemaphore.waitNanoseconds(&mMutex, remaining);
+    }
+
+    return mIsCompleted.load();
+}
+
+bool VAsyncFileRequest::isCompleted() const {
+    return mIsCompleted.load();
+}
+
+bool VAsyncFileRequest::hasFailed() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::hasFailed");
+    return mErrorCode != 0;
+}
+
+Vs64 VAsyncFileRequest::getNumBytesTransferred() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::getNumBytesTransferred");
+    return mNumBytesTransferred;
+}
+
+int VAsyncFileRequest::getErrorCode() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::getErrorCode");
+    return mErrorCode;
+}
+
+VString VAsyncFileRequest::getErrorMessage() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::getErrorMessage");
+    return (mErrorCode == 0) ? VString::EMPTY() : VSystemError(mErrorCode).getErrorMessage();
+}
+
+void VAsyncFileRequest::_complete(int errorCode) {
+    // Our reference to ourself goes last, when this function returns, so that the
+    // stream and the engine need hold no reference of their own.
+    VAsyncFileRequestPtr self;
+    self.swap(mSelf);
+    VAsyncFileStream* stream = mStream;
+
+    VMutexLocker locker(&mMutex, "VAsyncFileRequest::_complete");
+    if ((errorCode == 0) && (mOperation == kWrite) && (mNumBytesTransferred < mLength)) {
+        errorCode = EIO; // the file system accepted no more data
+    }
+
+    mErrorCode = errorCode;
+    locker.unlock();
+
+    stream->_requestFinished(*this);
+
+    try {
+        this->completed();
+    } catch (const std::exception& ex) {
+        VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("VAsyncFileRequest completed() threw exception '%s'.", ex.what()));
+    } catch (...) {
+        VLOGGER_NAMED_ERROR(kLoggerName, "VAsyncFileRequest completed() threw unknown exception.");
+    }
+
+    locker.lock();
+    mIsCompleted.store(true);
+    mCompletedSemaphore.broadcast();
+    locker.unlock();
+
+    stream->_requestCompleted();
+}
+
+// VAsyncFileEngine ------------------------------------------------------------
+
+// static
+bool VAsyncFileEngine::_advance(VAsyncFileRequest& request, Vs64 numBytes) {
+    request.mNumBytesTransferred += numBytes;
+    return (numBytes > 0) && (request.mNumBytesTransferred < request.mLength);
+}
+
+// static
+void VAsyncFileEngine::_complete(VAsyncFileRequest& request, int errorCode) {
+    request._complete(errorCode);
+}
+
+// VAsyncFilePoolEngine --------------------------------------------------------
+
+/**
+The engine that performs requests with blocking i/o on the workers of a thread pool,
+one task per request.
+*/
+class VAsyncFilePoolEngine : public VAsyncFileEngine {
+    public:
+
+        VAsyncFilePoolEngine(VThreadPool& pool) : VAsyncFileEngine(), mPool(pool) {}
+        virtual ~VAsyncFilePoolEngine() {}
+
+        virtual void submit(const VAsyncFileRequestList& requests);
+        virtual const char* getName() const { return "thread pool"; }
+
+        /**
+        Performs a request with blocking i/o.
+        @param  request the request
+        @return 0 if the request succeeded; otherwise the errno value
+        */
+        static int perform(VAsyncFileRequest& request);
+        /**
+        Completes a request performed, or abandoned, by a task.
+        @param  request     the request
+        @param  errorCode   0 if the request succeeded; otherwise the errno value
+        */
+        static void finish(VAsyncFileRequest& request, int errorCode) { VAsyncFileEngine::_complete(request, errorCode); }
+
+    private:
+
+        VThreadPool& mPool; ///< The pool that runs the tasks.
+};
+
+/**
+The thread pool task that performs one request.
+*/
+class VAsyncFileIOTask : public VThreadPoolTask {
+    public:
+
+        VAsyncFileIOTask(const VAsyncFileRequestPtr& request) : VThreadPoolTask("VAsyncFileIOTask"), mRequest(request), mErrorCode(0) {}
+        virtual ~VAsyncFileIOTask() {}
+
+        virtual void run() {
+            mErrorCode = VAsyncFilePoolEngine::perform(*mRequest);
+        }
+
+        virtual void completed() {
+            if (this->hasFailed() && (mErrorCode == 0)) {
+                mErrorCode = ECANCELED; // the pool was stopped before the task ran
+            }
+
+            VAsyncFilePoolEngine::finish(*mRequest, mErrorCode);
+            mRequest.reset();
+        }
+
+    private:
+
+        VAsyncFileRequestPtr    mRequest;   ///< The request.
+        int                     mErrorCode; ///< The outcome of performing it.
+};
+
+void VAsyncFilePoolEngine::submit(const VAsyncFileRequestList& requests) {
+    for (VAsyncFileRequestList::const_iterator i = requests.begin(); i != requests.end(); ++i) {
+        mPool.submit(VThreadPoolTaskPtr(new VAsyncFileIOTask(*i)));
+    }
+}
+
+// static
+int VAsyncFilePoolEngine::perform(VAsyncFileRequest& request) {
+    int fd = VAsyncFileEngine::_getFileDescriptor(request);
+
+    if (request.getOperation() == VAsyncFileRequest::kSync) {
+        return (VFileSystem::fsync(fd) == 0) ? 0 : errno;
+    }
+
+    bool moreToDo = (request.getLength() > 0);
+    while (moreToDo) {
+        Vs64    numBytesDone = VAsyncFileEngine::_getNumBytesTransferred(request);
+        Vu8*    buffer = request.getBuffer() + numBytesDone;
+        size_t  numBytes = static_cast<size_t>(V_MIN(kMaxTransferSize, request.getLength() - numBytesDone));
+        Vs64    offset = request.getOffset() + numBytesDone;
+
+        ssize_t result;
+        if (request.getOperation() == VAsyncFileRequest::kRead) {
+            result = VFileSystem::pread(fd, buffer, numBytes, offset);
+        } else {
+            result = VFileSystem::pwrite(fd, buffer, numBytes, offset);
+        }
+
+        if (result == -1) {
+            return errno;
+        }
+
+        moreToDo = VAsyncFileEngine::_advance(request, static_cast<Vs64>(result));
+    }
+
+    return 0;
+}
+
+// VAsyncFileStream ------------------------------------------------------------
+
+static VMutex gBlockingIOPoolMutex("gBlockingIOPoolMutex");
+static VThreadPool* gBlockingIOPool = NULL;
+
+static VMutex gSharedEngineMutex("gSharedEngineMutex");
+static VAsyncFileEngine* gSharedEngine = NULL;
+
+// static
+VThreadPool& VAsyncFileStream::getBlockingIOPool() {
+    VMutexLocker locker(&gBlockingIOPoolMutex, "VAsyncFileStream::getBlockingIOPool");
+
+    if (gBlockingIOPool == NULL) {
+        gBlockingIOPool = new VThreadPool("blockingio", kNumBlockingIOWorkers);
+        gBlockingIOPool->start();
+    }
+
+    return *gBlockingIOPool;
+}
+
+// static
+VAsyncFileEngine* VAsyncFileStream::_getSharedEngine() {
+    VMutexLocker locker(&gSharedEngineMutex, "VAsyncFileStream::_getSharedEngine");
+
+    if (gSharedEngine == NULL) {
+        gSharedEngine = VAsyncFileStream::_platform_createNativeEngine();
+
+        if (gSharedEngine == NULL) {
+            gSharedEngine = new VAsyncFilePoolEngine(VAsyncFileStream::getBlockingIOPool());
+        }
+
+        VLOGGER_NAMED_DEBUG(kLoggerName, VSTRING_FORMAT("VAsyncFileStream requests will be performed using %s.", gSharedEngine->getName()));
+    }
+
+    return gSharedEngine;
+}
+
+VAsyncFileStream::VAsyncFileStream(const VFSNode& node, VThreadPool* pool)
+    : mNode(node)
+    , mEngine((pool == NULL) ? VAsyncFileStream::_getSharedEngine() : new VAsyncFilePoolEngine(*pool))
+    , mOwnsEngine(pool != NULL)
+    , mDirectIO(false)
+    , mFile(-1)
+    , mAppendOffset(0)
+    , mMutex("VAsyncFileStream::mMutex", true/*suppress logging; it is held across the waits for requests*/)
+    , mIdleSemaphore()
+    , mNumOutstanding(0)
+    , mNumFailed(0)
+    , mLastErrorMessage()
+    {
+}
+
+VAsyncFileStream::~VAsyncFileStream() {
+    try {
+        this->close();
+    } catch (...) {}
+
+    if (mOwnsEngine) {
+        delete mEngine;
+    }
+}
+
+void VAsyncFileStream::openReadOnly() {
+    this->_open(READ_ONLY_MODE, "VAsyncFileStream::openReadOnly");
+}
+
+void VAsyncFileStream::openReadWrite() {
+    this->_open(READWRITE_MODE, "VAsyncFileStream::openReadWrite");
+}
+
+void VAsyncFileStream::openWrite() {
+    this->_open(WRITE_CREATE_MODE, "VAsyncFileStream::openWrite");
+}
+
+void VAsyncFileStream::close() {
+    if (this->isOpen()) {
+        this->waitForAll();
+        (void) VFileSystem::close(mFile);
+        mFile = -1;
+    }
+}
+
+VAsyncFileRequestPtr VAsyncFileStream::read(Vu8* buffer, Vs64 offset, Vs64 length) {
+    VAsyncFileRequestPtr request(new VAsyncFileRequest(VAsyncFileRequest::kRead, buffer, offset, length));
+    this->submitBatch(VAsyncFileRequestList(1, request));
+    return request;
+}
+
+VAsyncFileRequestPtr VAsyncFileStream::write(const Vu8* buffer, Vs64 offset, Vs64 length) {
+    VAsyncFileRequestPtr request(new VAsyncFileRequest(VAsyncFileRequest::kWrite, const_cast<Vu8*>(buffer), offset, length));
+    this->submitBatch(VAsyncFileRequestList(1, request));
+    return request;
+}
+
+VAsyncFileRequestPtr VAsyncFileStream::append(const Vu8* buffer, Vs64 length) {
+    return this->write(buffer, VAsyncFileRequest::kAppendOffset, length);
+}
+
+VAsyncFileRequestPtr VAsyncFileStream::appendCopy(const Vu8* buffer, Vs64 length) {
+    // Only direct i/o needs an aligned buffer; otherwise a plain heap copy is cheaper.
+    Vu8* copy = mDirectIO ? VAsyncFileStream::allocateAlignedBuffer(length) : new Vu8[length];
+    VAsyncFileRequestPtr request(new VAsyncFileRequest(VAsyncFileRequest::kWrite, copy, VAsyncFileRequest::kAppendOffset, length));
+    request->mOwnedBuffer = copy;
+    request->mOwnedBufferIsAligned = mDirectIO;
+    VStream::copyMemory(copy, buffer, length);
+
+    this->submitBatch(VAsyncFileRequestList(1, request));
+    return request;
+}
+
+VAsyncFileRequestPtr VAsyncFileStream::sync() {
+    VAsyncFileRequestPtr request(new VAsyncFileRequest(VAsyncFileRequest::kSync, NULL, 0, 0));
+    this->submitBatch(VAsyncFileRequestList(1, request));
+    return request;
+}
+
+void VAsyncFileStream::submitBatch(const VAsyncFileRequestList& requests) {
+    for (VAsyncFileRequestList::const_iterator i = requests.begin(); i != requests.end(); ++i) {
+        this->_validate(**i);
+    }
+
+    for (VAsyncFileRequestList::const_iterator i = requests.begin(); i != requests.end(); ++i) {
+        this->_prepare(*i);
+    }
+
+    mEngine->submit(requests);
+}
+
+void VAsyncFileStream::waitForAll() {
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::waitForAll");
+    while (mNumOutstanding > 0) {
+        mIdleSemaphore.wait(&mMutex, VDuration::ZERO());
+    }
+}
+
+int VAsyncFileStream::getNumOutstanding() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::getNumOutstanding");
+    return mNumOutstanding;
+}
+
+Vs64 VAsyncFileStream::getNumFailed() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::getNumFailed");
+    return mNumFailed;
+}
+
+VString VAsyncFileStream::getLastErrorMessage() const {
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::getLastErrorMessage");
+    return mLastErrorMessage;
+}
+
+const char* VAsyncFileStream::getEngineName() const {
+    return mEngine->getName();
+}
+
+void VAsyncFileStream::_open(int flags, const char* label) {
+    const VString path = mNode.getPath();
+    const int directIOFlag = VAsyncFileStream::_platform_getDirectIOFlag();
+
+    if (mDirectIO && (directIOFlag != 0)) {
+        mFile = VFileSystem::open(path, flags | directIOFlag);
+
+        if ((mFile == -1) && (errno == EINVAL)) {
+            mDirectIO = false; // the file system does not support direct i/o
+        }
+    } else {
+        mDirectIO = false;
+    }
+
+    if (! mDirectIO) {
+        mFile = VFileSystem::open(path, flags);
+    }
+
+    if (mFile == -1) {
+        throw VException(VSystemError(), VSTRING_FORMAT("%s failed to open '%s'.", label, path.chars()));
+    }
+
+    off_t endOffset = VFileSystem::lseek(mFile, 0, SEEK_END);
+    mAppendOffset.store((endOffset == static_cast<off_t>(-1)) ? 0 : static_cast<Vs64>(endOffset));
+}
+
+void VAsyncFileStream::_validate(const VAsyncFileRequest& request) const {
+    if (! this->isOpen()) {
+        throw VException(VSTRING_FORMAT("VAsyncFileStream: request submitted for '%s', which is not open.", mNode.getPath().chars()));
+    }
+
+    if (request.mStream != NULL) {
+        throw VStackTraceException("VAsyncFileStream: request submitted more than once.");
+    }
+
+    if (mDirectIO && (request.getOperation() != VAsyncFileRequest::kSync)) {
+        const Vs64 alignment = kDirectIOAlignment;
+        bool aligned = ((reinterpret_cast<Vu64>(request.getBuffer()) % alignment) == 0) && ((request.getLength() % alignment) == 0);
+
+        if (request.getOffset() == VAsyncFileRequest::kAppendOffset) {
+            aligned = aligned && ((mAppendOffset.load() % alignment) == 0);
+        } else {
+            aligned = aligned && ((request.getOffset() % alignment) == 0);
+        }
+
+        if (! aligned) {
+            throw VRangeException(VSTRING_FORMAT("VAsyncFileStream: direct i/o request for '%s' has a buffer, offset, or length that is not a multiple of %d bytes.", mNode.getPath().chars(), kDirectIOAlignment));
+        }
+    }
+}
+
+void VAsyncFileStream::_prepare(const VAsyncFileRequestPtr& request) {
+    request->mFileDescriptor = mFile;
+    request->mStream = this;
+    request->mSelf = request;
+
+    if (request->mOffset == VAsyncFileRequest::kAppendOffset) {
+        request->mOffset = mAppendOffset.fetch_add(request->mLength);
+    }
+
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::_prepare");
+    ++mNumOutstanding;
+}
+
+void VAsyncFileStream::_requestFinished(const VAsyncFileRequest& request) {
+    if (request.mErrorCode == 0) {
+        return;
+    }
+
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::_requestFinished");
+    ++mNumFailed;
+    mLastErrorMessage = VSTRING_FORMAT("%s of '%s' failed: %s", (request.mOperation == VAsyncFileRequest::kRead) ? "Read" : ((request.mOperation == VAsyncFileRequest::kWrite) ? "Write" : "Sync"), mNode.getPath().chars(), VSystemError(request.mErrorCode).getErrorMessage().chars());
+}
+
+void VAsyncFileStream::_requestCompleted() {
+    VMutexLocker locker(&mMutex, "VAsyncFileStream::_requestCompleted");
+
+    if (--mNumOutstanding == 0) {
+        mIdleSemaphore.broadcast();
+    }
+}
@@ -0,0 +1,456 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vasyncfilestream_h
+#define vasyncfilestream_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vfsnode.h"
+#include "vinstant.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
+
+#include <atomic>
+#include <vector>
+
+class VAsyncFileStream;
+class VAsyncFileEngine;
+class VThreadPool;
+
+/**
+    @ingroup vstream_derived vfilesystem
+*/
+
+/**
+VAsyncFileRequest is one read, write, or sync of a VAsyncFileStream. It is
+also its own future: the thread that submitted it, or any other, can wait
+for it with waitUntilCompleted() and then look at the outcome. Subclass it
+and implement completed() to be called back instead of waiting.
+
+Requests are made by the VAsyncFileStream read(), write(), append(), and
+sync() functions, which submit them at once; or constructed directly, to
+be submitted together with VAsyncFileStream::submitBatch(). They are held
+as VAsyncFileRequestPtr, so a request lives until both the stream and the
+submitter are done with it. The caller's buffer, however, must remain valid
+until the request has completed. A request is submitted once; do not submit
+it again.
+*/
+class VAsyncFileRequest {
+    public:
+
+        /**
+        The operations a request can perform.
+        */
+        enum Operation {
+            kRead = 0,  ///< Reads into the buffer from the offset.
+            kWrite,     ///< Writes the buffer at the offset.
+            kSync       ///< Flushes the file's data to disk, as fsync does.
+        };
+
+        static const Vs64 kAppendOffset = -1; ///< The offset for a write at the end of the data written so far; see VAsyncFileStream::append().
+
+        /**
+        Constructs a request, to be submitted with VAsyncFileStream::submitBatch().
+        @param  operation   the operation
+        @param  buffer      the buffer to read into or write from; NULL for kSync
+        @param  offset      the file offset at which to read or write; kAppendOffset
+                            to write after everything previously appended
+        @param  length      the number of bytes to read or write; 0 for kSync
+        */
+        VAsyncFileRequest(Operation operation, Vu8* buffer, Vs64 offset, Vs64 length);
+        virtual ~VAsyncFileRequest();
+
+        /**
+        Called when the request has completed, successfully or not, before waiters are
+        released. It is called on an i/o thread, so it must be short and must not block;
+        anything lengthy should be handed off to another thread. The default
+        implementation does nothing.
+        */
+        virtual void completed() {}
+
+        /**
+        Blocks until the request has completed.
+        */
+        void waitUntilCompleted();
+        /**
+        Blocks until the request has completed, or until the timeout elapses.
+        @param  timeoutInterval the maximum time to wait
+        @return true if the request has completed
+        */
+        bool waitUntilCompleted(const VDuration& timeoutInterval);
+        /**
+        Returns true if the request has completed, successfully or not.
+        @return obvious
+        */
+        bool isCompleted() const;
+        /**
+        Returns true if the request has completed unsuccessfully. A read that reaches the
+        end of the file is not a failure; it transfers fewer bytes than requested. Valid
+        once the request has completed.
+        @return obvious
+        */
+        bool hasFailed() const;
+        /**
+        Returns the number of bytes read or written. Valid once the request has completed.
+        @return obvious
+        */
+        Vs64 getNumBytesTransferred() const;
+        /**
+        Returns the errno value describing the failure, if the request failed. Valid once
+        the request has completed.
+        @return the error code, or 0 if the request did not fail
+        */
+        int getErrorCode() const;
+        /**
+        Returns a description of the failure, if the request failed. Valid once the request
+        has completed.
+        @return the error message, or empty if the request did not fail
+        */
+        VString getErrorMessage() const;
+
+        Operation getOperation() const { return mOperation; }   ///< Returns the operation. @return obvious
+        Vu8* getBuffer() const { return mBuffer; }              ///< Returns the buffer. @return obvious
+        Vs64 getOffset() const { return mOffset; }              ///< Returns the file offset; an append's is assigned when it is submitted. @return obvious
+        Vs64 getLength() const { return mLength; }              ///< Returns the number of bytes to transfer. @return obvious
+
+    private:
+
+        VAsyncFileRequest(const VAsyncFileRequest&); // not copyable
+        VAsyncFileRequest& operator=(const VAsyncFileRequest&); // not assignable
+
+        friend class VAsyncFileStream;
+        friend class VAsyncFileEngine;
+
+        /**
+        Records the outcome, calls completed(), releases any waiters, and tells the stream.
+        Called by the engine, once.
+        @param  errorCode   0 if the request succeeded; otherwise the errno value
+        */
+        void _complete(int errorCode);
+
+        Operation                           mOperation;             ///< The operation.
+        Vu8*                                mBuffer;                ///< The buffer to read into or write from.
+        Vs64                                mOffset;                ///< The file offset at which to read or write.
+        Vs64                                mLength;                ///< The number of bytes to transfer.
+        Vu8*                                mOwnedBuffer;           ///< A copy of the data made by VAsyncFileStream::appendCopy(), freed with the request; NULL if none.
+        bool                                mOwnedBufferIsAligned;  ///< True if mOwnedBuffer came from VAsyncFileStream::allocateAlignedBuffer() rather than operator new[].
+        int                                 mFileDescriptor;        ///< The file, set when the request is submitted.
+        VAsyncFileStream*                   mStream;                ///< The stream the request was submitted to.
+        VSharedPtr<VAsyncFileRequest>       mSelf;                  ///< Keeps the request alive while an engine holds a plain pointer to it.
+        Vs64                                mNumBytesTransferred;   ///< The number of bytes read or written so far.
+        int                                 mErrorCode;             ///< The errno value if the request failed.
+        mutable VMutex                      mMutex;                 ///< Protects the completion state.
+        VSemaphore                          mCompletedSemaphore;    ///< Broadcast when the request completes.
+        std::atomic<bool>                   mIsCompleted;           ///< True once the request has completed.
+};
+
+typedef VSharedPtr<VAsyncFileRequest> VAsyncFileRequestPtr;
+typedef std::vector<VAsyncFileRequestPtr> VAsyncFileRequestList;
+
+/**
+VAsyncFileEngine is the abstract base class of the mechanisms that perform the
+requests of a VAsyncFileStream. There are two: one that uses Linux io_uring,
+which performs the i/o in the kernel without a thread per request; and one
+that performs blocking reads and writes on the workers of a VThreadPool.
+*/
+class VAsyncFileEngine {
+    public:
+
+        VAsyncFileEngine() {}
+        virtual ~VAsyncFileEngine() {}
+
+        /**
+        Starts performing a batch of requests, each of which has been prepared by the stream.
+        Does not wait for the i/o, but may wait while the engine has too many requests in
+        progress to accept more.
+        @param  requests    the requests
+        */
+        virtual void submit(const VAsyncFileRequestList& requests) = 0;
+        /**
+        Returns a short name for the engine, for diagnostics.
+        @return obvious
+        */
+        virtual const char* getName() const = 0;
+
+    protected:
+
+        /**
+        Returns the file a request is for.
+        @param  request the request
+        @return the file descriptor
+        */
+        static int _getFileDescriptor(const VAsyncFileRequest& request) { return request.mFileDescriptor; }
+        /**
+        Returns the number of bytes a request has transferred so far; the next step of the
+        request transfers from there.
+        @param  request the request
+        @return obvious
+        */
+        static Vs64 _getNumBytesTransferred(const VAsyncFileRequest& request) { return request.mNumBytesTransferred; }
+        /**
+        Records the bytes transferred by one step of a read or write.
+        @param  request     the request
+        @param  numBytes    the number of bytes the step transferred
+        @return true if the request has more to transfer; false if it is done, because all
+                of it has been transferred or the step reached the end of the file
+        */
+        static bool _advance(VAsyncFileRequest& request, Vs64 numBytes);
+        /**
+        Completes a request. The request may be destroyed by the time this returns.
+        @param  request     the request
+        @param  errorCode   0 if the request succeeded; otherwise the errno value
+        */
+        static void _complete(VAsyncFileRequest& request, int errorCode);
+
+    private:
+
+        VAsyncFileEngine(const VAsyncFileEngine&); // not copyable
+        VAsyncFileEngine& operator=(const VAsyncFileEngine&); // not assignable
+};
+
+/**
+VAsyncFileStream reads and writes a file without making the calling thread
+wait for the disk. Each read, write, or sync is a VAsyncFileRequest that
+is queued and performed in the background; the caller can carry on, and
+later wait for the request or be called back when it completes. Several
+requests can be in progress at once, and they complete in whatever order
+the system finishes them, so each carries its own file offset. append()
+assigns offsets in the order it is called, so that appended data lands
+in that order however the writes complete.
+
+On Linux, where the kernel supports it, requests are performed with
+io_uring: they are placed in a ring shared with the kernel and started
+with one system call per batch, and a single thread collects the
+completions of every stream. Elsewhere, and where io_uring is unavailable
+(an older kernel, or a sandbox that forbids it), requests are performed
+with ordinary blocking reads and writes on the workers of a small shared
+VThreadPool, getBlockingIOPool(). A stream constructed with a pool of its
+own always uses that pool.
+
+With setDirectIO(), the file is opened for direct i/o (O_DIRECT), which
+bypasses the page cache; this suits large sequential transfers of data
+that will not be read again soon. Direct i/o requires every buffer
+address, file offset, and length to be a multiple of kDirectIOAlignment;
+allocateAlignedBuffer() returns suitable buffers.
+
+<code>
+VAsyncFileStream file(node);
+file.openReadWrite();
+VAsyncFileRequestPtr request = file.append(data, length);
+... // other work
+request->waitUntilCompleted();
+</code>
+
+@see VAsyncFileRequest
+*/
+class VAsyncFileStream {
+    public:
+
+        static const int kDirectIOAlignment = 4096; ///< The alignment of buffers, offsets, and lengths for direct i/o.
+
+        /**
+        Allocates a buffer aligned for direct i/o. Free it with freeAlignedBuffer().
+        @param  length  the size of the buffer
+        @return the buffer
+        @throws VException if the memory cannot be allocated
+        */
+        static Vu8* allocateAlignedBuffer(Vs64 length);
+        /**
+        Frees a buffer allocated by allocateAlignedBuffer().
+        @param  buffer  the buffer, or NULL
+        */
+        static void freeAlignedBuffer(Vu8* buffer);
+        /**
+        Returns the pool that performs requests where io_uring is unavailable, creating and
+        starting it on first use. It has a few workers, which spend most of their time
+        blocked in the file system, and is never destroyed. Other blocking file work can be
+        run on it too.
+        @return the pool
+        */
+        static VThreadPool& getBlockingIOPool();
+
+        /**
+        Constructs a stream for a file, without opening it.
+        @param  node    the file
+        @param  pool    a pool whose workers perform the requests with blocking i/o; NULL to
+                        use io_uring where available, or else getBlockingIOPool()
+        */
+        VAsyncFileStream(const VFSNode& node, VThreadPool* pool = NULL);
+        /**
+        Closes the stream, waiting for outstanding requests.
+        */
+        ~VAsyncFileStream();
+
+        /**
+        Sets whether the file is opened for direct i/o. Call before opening the file.
+        @param  directIO    true to bypass the page cache
+        */
+        void setDirectIO(bool directIO) { mDirectIO = directIO; }
+        /**
+        Returns true if the file is open for direct i/o. Where the platform or file system
+        does not support direct i/o, the file is opened normally and this returns false.
+        @return obvious
+        */
+        bool isDirectIO() const { return mDirectIO; }
+
+        /**
+        Opens the file read-only.
+        @throws VException if it cannot be opened
+        */
+        void openReadOnly();
+        /**
+        Opens the file read-write, creating the file if it does not exist. Appends start at
+        the end of the existing data.
+        @throws VException if it cannot be opened
+        */
+        void openReadWrite();
+        /**
+        Opens the file for writing, creating it or truncating it to empty.
+        @throws VException if it cannot be opened
+        */
+        void openWrite();
+        /**
+        Returns true if the file is open.
+        @return obvious
+        */
+        bool isOpen() const { return mFile != -1; }
+        /**
+        Waits for outstanding requests, and closes the file.
+        */
+        void close();
+
+        /**
+        Starts reading from the file.
+        @param  buffer      the buffer to read into; it must remain valid until the request completes
+        @param  offset      the file offset to read from
+        @param  length      the number of bytes to read
+        @return the request
+        */
+        VAsyncFileRequestPtr read(Vu8* buffer, Vs64 offset, Vs64 length);
+        /**
+        Starts writing to the file.
+        @param  buffer      the data; it must remain valid until the request completes
+        @param  offset      the file offset to write at
+        @param  length      the number of bytes to write
+        @return the request
+        */
+        VAsyncFileRequestPtr write(const Vu8* buffer, Vs64 offset, Vs64 length);
+        /**
+        Starts writing to the file after everything previously appended, or after the data
+        present when the file was opened.
+        @param  buffer      the data; it must remain valid until the request completes
+        @param  length      the number of bytes to write
+        @return the request
+        */
+        VAsyncFileRequestPtr append(const Vu8* buffer, Vs64 length);
+        /**
+        Like append(), but writes a copy of the data, so the caller's buffer may be reused at once.
+        The copy is only aligned for direct i/o if the stream uses direct i/o.
+        @param  buffer      the data
+        @param  length      the number of bytes to write
+        @return the request
+        */
+        VAsyncFileRequestPtr appendCopy(const Vu8* buffer, Vs64 length);
+        /**
+        Starts flushing the file's data to disk. Only writes that have completed before the
+        sync is submitted are sure to be covered by it.
+        @return the request
+        */
+        VAsyncFileRequestPtr sync();
+        /**
+        Submits requests constructed by the caller, as a batch: with io_uring, the whole batch
+        is started with one system call.
+        @param  requests    the requests
+        @throws VException if the file is not open, or a request is unsuitable for direct i/o;
+                            in that case none of the requests is submitted
+        */
+        void submitBatch(const VAsyncFileRequestList& requests);
+        /**
+        Blocks until every request submitted so far has completed.
+        */
+        void waitForAll();
+
+        const VFSNode& getNode() const { return mNode; }    ///< Returns the file node. @return obvious
+        Vs64 getAppendOffset() const { return mAppendOffset.load(); } ///< Returns the offset of the next append. @return obvious
+        int getNumOutstanding() const;                      ///< Returns the number of requests submitted and not yet completed. @return obvious
+        Vs64 getNumFailed() const;                          ///< Returns the number of requests that have failed. @return obvious
+        VString getLastErrorMessage() const;                ///< Returns the error message of the most recent failure, or empty. @return obvious
+        const char* getEngineName() const;                  ///< Returns the name of the mechanism performing requests, "io_uring" or "thread pool". @return obvious
+
+    private:
+
+        VAsyncFileStream(const VAsyncFileStream&); // not copyable
+        VAsyncFileStream& operator=(const VAsyncFileStream&); // not assignable
+
+        friend class VAsyncFileRequest;
+
+        /**
+        Opens the file, with O_DIRECT added to the flags if direct i/o was requested and
+        can be had.
+        @param  flags   the open flags
+        @param  label   the name of the calling function, for the exception message
+        */
+        void _open(int flags, const char* label);
+        /**
+        Checks a request and readies it to be handed to the engine: assigns its file and
+        its offset if it is an append, and counts it as outstanding.
+        @param  request the request
+        */
+        void _prepare(const VAsyncFileRequestPtr& request);
+        /**
+        Throws if a request cannot be performed: the file is not open, or the request is
+        unsuitable for direct i/o.
+        @param  request the request
+        */
+        void _validate(const VAsyncFileRequest& request) const;
+        /**
+        Records a failed request in the stream's failure count and last error message.
+        Called by the request before it releases its waiters, so that a thread that has
+        waited for the request sees the failure counted.
+        @param  request the request
+        */
+        void _requestFinished(const VAsyncFileRequest& request);
+        /**
+        Counts a request as no longer outstanding. Called by the request as the last thing
+        it does with the stream.
+        */
+        void _requestCompleted();
+        /**
+        Returns the engine used by streams that were not given a pool: io_uring if the
+        platform supports it, else the blocking i/o pool. Created on first use.
+        @return obvious
+        */
+        static VAsyncFileEngine* _getSharedEngine();
+
+        /**
+        Creates the platform's native engine, if it has one that works here.
+        @return the engine, or NULL
+        */
+        static VAsyncFileEngine* _platform_createNativeEngine();
+        /**
+        Returns the open flag for direct i/o on this platform.
+        @return the flag, or 0 if the platform has none
+        */
+        static int _platform_getDirectIOFlag();
+
+        VFSNode             mNode;              ///< The file.
+        VAsyncFileEngine*   mEngine;            ///< The engine that performs our requests.
+        bool                mOwnsEngine;        ///< True if mEngine was created for this stream, and is deleted with it.
+        bool                mDirectIO;          ///< True if the file is, or is to be, opened for direct i/o.
+        int                 mFile;              ///< The file descriptor; -1 if not open.
+        std::atomic<Vs64>   mAppendOffset;      ///< The offset of the next append.
+        mutable VMutex      mMutex;             ///< Protects the outstanding count and failure statistics.
+        VSemaphore          mIdleSemaphore;     ///< Broadcast when the last outstanding request completes.
+        int                 mNumOutstanding;    ///< The number of requests submitted and not yet completed.
+        Vs64                mNumFailed;         ///< The number of requests that have failed.
+        VString             mLastErrorMessage;  ///< The error message of the most recent failure.
+};
+
+#endif /* vasyncfilestream_h */
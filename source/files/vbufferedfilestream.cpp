@@ -231,3 +231,11 @@ Vs64 VBufferedFileStream::available() const {
     return eofOffset - currentOffset;
 }
 
+int VBufferedFileStream::_prepareToSendFile() {
+    if ((! this->isOpen()) || (VFileSystem::fflush(mFile) != 0)) {
+        return -1;
+    }
+
+    return ::fileno(mFile);
+}
+
@@ -158,6 +158,15 @@ class VBufferedFileStream : public VAbstractFileStream {
         */
         virtual Vs64 available() const;
 
+    protected:
+
+        /**
+        Flushes any buffered writes and returns the file descriptor underlying
+        the FILE, so that streamCopy() can send directly from the file.
+        @return    the file descriptor, or -1 if the file is not open
+        */
+        virtual int _prepareToSendFile();
+
     private:
 
         // Prevent copy construction and assignment, since there is no provision for sharing the mFile pointer.
@@ -213,3 +213,11 @@ Vs64 VDirectIOFileStream::available() const {
     return eofOffset - currentOffset;
 }
 
+int VDirectIOFileStream::_prepareToSendFile() {
+    return mFile; // -1 if not open
+}
+
+
+Vs64 VDirectIOFileStream::_writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite) {
+    return VFileSystem::copyFileData(fileDescriptor, fileOffset, mFile, numBytesToWrite);
+}
@@ -148,6 +148,23 @@ class VDirectIOFileStream : public VAbstractFileStream {
         */
         virtual Vs64 available() const;
 
+    protected:
+
+        /**
+        Returns the file descriptor, so that streamCopy() can send directly from the file.
+        @return    the file descriptor, or -1 if the file is not open
+        */
+        virtual int _prepareToSendFile();
+        /**
+        Copies from a file into this one inside the kernel, where the platform can,
+        so that streamCopy() from a file stream to this one needs no buffer.
+        @param    fileDescriptor    the file to copy from
+        @param    fileOffset        the offset in the file of the first byte to copy
+        @param    numBytesToWrite   the number of bytes to copy
+        @return the number of bytes written, or -1 if the platform cannot copy between these files
+        */
+        virtual Vs64 _writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite);
+
     private:
 
         // Prevent copy construction and assignment, since there is no provision for sharing the mFile pointer.
@@ -8,6 +8,40 @@ http://www.bombaydigital.com/
 
 #include "vfilewriter.h"
 
+#include "vasyncfilestream.h"
+
+// VFileWriterSaveTask -----------------------------------------------------
+
+/**
+The task that does the work of VFileWriter::saveAsync(), with its own copy of the data.
+*/
+class VFileWriterSaveTask : public VThreadPoolTask {
+    public:
+
+        VFileWriterSaveTask(const VFSNode& target, const VMemoryStream& buffer, bool syncToDisk)
+            : VThreadPoolTask(VSTRING_FORMAT("VFileWriter.save(%s)", target.getPath().chars()))
+            , mTarget(target)
+            , mBuffer(buffer)
+            , mSyncToDisk(syncToDisk)
+            {
+        }
+
+        virtual ~VFileWriterSaveTask() {}
+
+        virtual void run() {
+            mBuffer.seek0();
+            VBinaryIOStream bufferStream(mBuffer);
+
+            VFSNode::safelyOverwriteFile(mTarget, mBuffer.getEOFOffset(), bufferStream, false, mSyncToDisk);
+        }
+
+    private:
+
+        VFSNode         mTarget;
+        VMemoryStream   mBuffer;
+        bool            mSyncToDisk;
+};
+
 // VFileWriter -------------------------------------------------
 
 VFileWriter::VFileWriter(const VFSNode& target)
@@ -18,9 +52,15 @@ VFileWriter::VFileWriter(const VFSNode& target)
     {
 }
 
-void VFileWriter::save() {
+void VFileWriter::save(bool syncToDisk) {
     mBuffer.seek0();
     VBinaryIOStream bufferStream(mBuffer);
     
-    VFSNode::safelyOverwriteFile(mTarget, mBuffer.getEOFOffset(), bufferStream);
+    VFSNode::safelyOverwriteFile(mTarget, mBuffer.getEOFOffset(), bufferStream, false, syncToDisk);
+}
+
+VThreadPoolTaskPtr VFileWriter::saveAsync(bool syncToDisk) {
+    VThreadPoolTaskPtr task(new VFileWriterSaveTask(mTarget, mBuffer, syncToDisk));
+    VAsyncFileStream::getBlockingIOPool().submit(task);
+    return task;
 }
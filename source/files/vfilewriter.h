@@ -11,6 +11,7 @@ http://www.bombaydigital.com/
 #include "vmemorystream.h"
 #include "vtextiostream.h"
 #include "vbinaryiostream.h"
+#include "vthreadpool.h"
 
 /** @file */
 
@@ -24,10 +25,9 @@ you want to catch it and still write whatever data you did put in the output str
 first manipulating the stream further). Normally you want such exceptions to propagate up and avoid
 writing entirely.
 
-This initial version always does your writes to a VMemoryStream and then uses that with the
-VFSNode::safelyOverwriteFile() API. It would be good to enhance this with an option (or default
-behavior) that actually writes to a temporary file directly, and then swaps it the way that
-VFSNode::safelyOverwriteFile() does with the buffered data.
+Your writes go to a VMemoryStream, which save() hands to VFSNode::safelyOverwriteFile(). That writes
+the memory buffer straight to the temporary file (an unnamed one, where the platform supports it),
+without copying it through another buffer, and then atomically replaces the target with it.
 
 So it can look like this,if you had text data for example:
 
@@ -52,7 +52,24 @@ class VFileWriter {
         VTextIOStream& getTextOutputStream() { return mTextOutputStream; }
         VBinaryIOStream& getBinaryOutputStream() { return mBinaryOutputStream; }
         
-        void save();
+        /**
+        Writes the data to the target file, replacing it.
+        @param  syncToDisk  if true, the file and its directory are flushed to disk before returning,
+                            so that the new contents survive a crash
+        @throws VException if the file cannot be written
+        */
+        void save(bool syncToDisk = false);
+        /**
+        Like save(), but does the writing in the background, on the workers of
+        VAsyncFileStream::getBlockingIOPool(), so the caller does not wait for the disk.
+        The data written so far is copied, so the writer may be reused or destroyed at once.
+        Wait for the returned task to learn whether the file was written; if two saves of
+        the same file are in progress at once, either may be the one that remains.
+        @param  syncToDisk  if true, the file and its directory are flushed to disk before
+                            the task completes
+        @return the task that writes the file
+        */
+        VThreadPoolTaskPtr saveAsync(bool syncToDisk = false);
 
     private:
     
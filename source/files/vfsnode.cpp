@@ -8,12 +8,17 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 /** @file */
 
 #include "vfsnode.h"
+#include "vtypes_internal.h"
 
 #include "vexception.h"
 #include "vinstant.h"
 #include "vbufferedfilestream.h"
+#include "vdirectiofilestream.h"
+#include "vreadbufferedstream.h"
 #include "vtextiostream.h"
 #include "vbinaryiostream.h"
+#include "vthreadpool.h"
+#include "vmutexlocker.h"
 
 // VListNodeInfoCallback -----------------------------------------------------
 
@@ -155,86 +160,138 @@ VFSNode VFSNode::getExecutable() {
 
 static VInstantFormatter VFSNODE_SAFE_FILE_NAME_INSTANT_FORMATTER("yMMddHHmmssSSS");
 
+static std::atomic<int> gNextTemporaryFileNumber(0);
+
 // static
-void VFSNode::safelyOverwriteFile(const VFSNode& target, Vs64 dataLength, VBinaryIOStream& dataStream, bool keepOld) {
+void VFSNode::safelyOverwriteFile(const VFSNode& target, Vs64 dataLength, VBinaryIOStream& dataStream, bool keepOld, bool syncToDisk) {
     bool success = true;
     VString errorMessage;
 
     VString targetFileName = target.getName();
 
-    VInstant now;
-    VString temporaryFileName = now.getLocalString(VFSNODE_SAFE_FILE_NAME_INSTANT_FORMATTER) + "_tmp_" + targetFileName;
-    VString keptFileName = now.getLocalString(VFSNODE_SAFE_FILE_NAME_INSTANT_FORMATTER) + "_ver_" + targetFileName;
+    // The temporary file name only has to be unique, so we don't pay for formatting a local time string.
+    VString temporaryFileName(VSTRING_ARGS(VSTRING_FORMATTER_S64 "_%d_tmp_%s", VInstant::snapshot(), gNextTemporaryFileNumber++, targetFileName.chars()));
 
     VFSNode directoryNode;
     target.getParentNode(directoryNode);
     VFSNode originalTargetNode(target);
     VFSNode temporaryFileNode(directoryNode, temporaryFileName);
-    VFSNode keptFileNode(directoryNode, keptFileName);
+    bool temporaryFileExists = false;
 
     // Create and write to the temp file within a scope block to ensure file is closed when scope is exited.
     /* stream scope */ {
-        VBufferedFileStream tempFileStream(temporaryFileNode);
-        VBinaryIOStream tempOutputStream(tempFileStream);
+        // Where the platform can, the file has no name until it is complete, so a crash can't leave it behind.
+        int fd = VFileSystem::openTemporary(directoryNode.getPath());
+        bool isUnnamed = (fd != -1);
+        if (! isUnnamed) {
+            fd = VFileSystem::open(temporaryFileNode.getPath(), WRITE_CREATE_MODE);
+            temporaryFileExists = (fd != -1);
+        }
 
-        try {
-            tempFileStream.openWrite();
-        } catch (const VException& ex) {
+        VDirectIOFileStream tempFileStream(temporaryFileNode);
+        tempFileStream.setFile(fd, true);
+
+        if (fd == -1) {
             success = false;
-            errorMessage = VSTRING_FORMAT("Unable to open temporary file '%s': %s", target.getPath().chars(), ex.what());
+            errorMessage = VSTRING_FORMAT("Unable to open temporary file '%s': %s", temporaryFileNode.getPath().chars(), VSystemError().getErrorMessage().chars());
         }
 
         if (success) {
             try {
-                VStream::streamCopy(dataStream, tempOutputStream, dataLength);
-                tempOutputStream.flush();
+                VStream::streamCopy(dataStream, tempFileStream, dataLength);
             } catch (const VException& ex) {
                 success = false;
-                errorMessage = VSTRING_FORMAT("Unable to write to temporary file '%s': %s", target.getPath().chars(), ex.what());
+                errorMessage = VSTRING_FORMAT("Unable to write to temporary file '%s': %s", temporaryFileNode.getPath().chars(), ex.what());
+            }
+        }
+
+        if (success && syncToDisk && (VFileSystem::fsync(fd) != 0)) {
+            success = false;
+            errorMessage = VSTRING_FORMAT("Unable to flush temporary file '%s' to disk: %s", temporaryFileNode.getPath().chars(), VSystemError().getErrorMessage().chars());
+        }
+
+        if (success && isUnnamed) {
+            if (VFileSystem::linkTemporary(fd, temporaryFileNode.getPath()) == 0) {
+                temporaryFileExists = true;
+            } else {
+                // Linking needs /proc and file system support that may be missing; copy the data we
+                // already wrote to a named temporary file instead, as if we'd had no unnamed file.
+                int namedFD = VFileSystem::open(temporaryFileNode.getPath(), WRITE_CREATE_MODE);
+                temporaryFileExists = (namedFD != -1);
+
+                VDirectIOFileStream namedFileStream(temporaryFileNode);
+                namedFileStream.setFile(namedFD, true);
+
+                if (namedFD == -1) {
+                    success = false;
+                    errorMessage = VSTRING_FORMAT("Unable to open temporary file '%s': %s", temporaryFileNode.getPath().chars(), VSystemError().getErrorMessage().chars());
+                }
+
+                if (success) {
+                    try {
+                        (void) tempFileStream.seek(0, SEEK_SET);
+                        VStream::streamCopy(tempFileStream, namedFileStream, dataLength);
+                    } catch (const VException& ex) {
+                        success = false;
+                        errorMessage = VSTRING_FORMAT("Unable to write to temporary file '%s': %s", temporaryFileNode.getPath().chars(), ex.what());
+                    }
+                }
+
+                if (success && syncToDisk && (VFileSystem::fsync(namedFD) != 0)) {
+                    success = false;
+                    errorMessage = VSTRING_FORMAT("Unable to flush temporary file '%s' to disk: %s", temporaryFileNode.getPath().chars(), VSystemError().getErrorMessage().chars());
+                }
             }
         }
     }
 
     /*
-    If we succeeded, delete or rename the original file, and rename the temporary file to the original location.
+    If we succeeded, rename the temporary file to the original location; first renaming the original if we're
+    keeping it. Where the platform's rename replaces an existing file atomically, there is never a moment when
+    the target is missing; elsewhere, the rename fails, and we have to delete the original first.
     If we failed, delete the temporary file.
     Do this itself in separate phases, so that if the delete/rename fails, we still delete the temporary file.
     */
-    // 1. Remove target. (It might not exist yet.)
-    if (success && target.exists()) {
-    
-        if (keepOld) {
-        
-            try {
-                target.renameToNode(keptFileNode);
-            } catch (const VException& ex) {
-                success = false;
-                errorMessage = VSTRING_FORMAT("Failed renaming '%s' to '%s': %s", target.getPath().chars(), keptFileNode.getPath().chars(), ex.what());
-            }
+    // 1. Rename target if keeping it. (It might not exist yet.)
+    if (success && keepOld && target.exists()) {
+        VString keptFileName = VInstant().getLocalString(VFSNODE_SAFE_FILE_NAME_INSTANT_FORMATTER) + "_ver_" + targetFileName;
+        VFSNode keptFileNode(directoryNode, keptFileName);
 
-        } else {
+        try {
+            target.renameToNode(keptFileNode);
+        } catch (const VException& ex) {
+            success = false;
+            errorMessage = VSTRING_FORMAT("Failed renaming '%s' to '%s': %s", target.getPath().chars(), keptFileNode.getPath().chars(), ex.what());
+        }
+    }
 
-            if (! target.rm()) {
+    // 2. Rename temporary to (original) target, removing the target first if the platform requires it.
+    if (success && (VFileSystem::rename(temporaryFileNode.getPath(), originalTargetNode.getPath()) != 0)) {
+        if (target.exists() && ! target.rm()) {
+            success = false;
+            errorMessage = VSTRING_FORMAT("Unable to remove target file '%s'.", target.getPath().chars());
+        } else {
+            try {
+                temporaryFileNode.renameToNode(originalTargetNode);
+            } catch (const VException& ex) {
                 success = false;
-                errorMessage = VSTRING_FORMAT("Unable to remove target file '%s'.", target.getPath().chars());
+                errorMessage = VSTRING_FORMAT("Failed renaming '%s' to '%s': %s", temporaryFileNode.getPath().chars(), originalTargetNode.getPath().chars(), ex.what());
             }
-
         }
-    
     }
 
-    // 2. Rename temporary to (original) target.
     if (success) {
-        try {
-            temporaryFileNode.renameToNode(originalTargetNode);
-        } catch (const VException& ex) {
+        temporaryFileExists = false;
+
+        // 3. Make the rename itself durable.
+        if (syncToDisk && (VFileSystem::syncDirectory(directoryNode.getPath()) != 0)) {
             success = false;
-            errorMessage = VSTRING_FORMAT("Failed renaming '%s' to '%s': %s", temporaryFileNode.getPath().chars(), originalTargetNode.getPath().chars(), ex.what());
+            errorMessage = VSTRING_FORMAT("Unable to flush directory '%s' to disk: %s", directoryNode.getPath().chars(), VSystemError().getErrorMessage().chars());
         }
     }
 
-    // 3. Remove temporary if unsuccessful.
-    if (! success) {
+    // 4. Remove temporary if unsuccessful.
+    if (temporaryFileExists) {
         if (! temporaryFileNode.rm()) {
             errorMessage += VSTRING_FORMAT(" Removal of temporary file '%s' failed.", temporaryFileNode.getPath().chars());
         }
@@ -247,38 +304,261 @@ void VFSNode::safelyOverwriteFile(const VFSNode& target, Vs64 dataLength, VBinar
 }
 
 // static
-void VFSNode::copyFile(const VFSNode& source, const VFSNode& dest) {
-    VBufferedFileStream fs(source);
+void VFSNode::copyFile(const VFSNode& source, const VFSNode& dest, bool syncToDisk) {
+    // Unbuffered, so that where the platform can, the data goes from file to file inside the kernel.
+    VDirectIOFileStream fs(source);
     fs.openReadOnly();
     VBinaryIOStream in(fs);
-    VFSNode::safelyOverwriteFile(dest, source.size(), in);
+    VFSNode::safelyOverwriteFile(dest, source.size(), in, false, syncToDisk);
 }
 
-// Helper class used by VFSNode::copyDirectory as callback. Copies the supplied node.
-// If the node is a file, it is copied. If the node is a directory and recursion is on, the directory is copied.
-class VFSNodeCopyDirectoryCallback : public VDirectoryIterationCallback {
+// VDirectoryWalkEntry --------------------------------------------------------
+
+VString VDirectoryWalkEntry::getPath() const {
+    VString path;
+    path.format("%s%s%s", mDirectoryPath.chars(),
+        (mDirectoryPath.endsWith(VFSNode::PATH_SEPARATOR_CHAR) ? "" : VFSNode::PATH_SEPARATOR_CHARS), // don't add another slash if already trailing
+        mName);
+    return path;
+}
+
+void VDirectoryWalkEntry::getNode(VFSNode& node) const {
+    node.setPath(this->getPath());
+}
+
+// VFSNodeWalk ----------------------------------------------------------------
+
+/**
+The state of a VFSNode::walk() in progress. It hands subdirectories off to the
+pool only while the pool has idle workers, so that a walk of a deep tree on a
+busy pool degrades to walking it on the calling thread rather than queueing a
+task per directory. It counts the tasks it has handed off so that the walk can
+wait for them all, and records the first failure of any of them.
+*/
+class VFSNodeWalk : public VDirectoryWalk {
+    public:
+
+        VFSNodeWalk(VDirectoryWalkCallback& callback, bool getNodeInfo, VThreadPool* pool);
+        virtual ~VFSNodeWalk() {}
+
+        virtual bool isStopped() const { return mStopped.load(); }
+        virtual void stop() { mStopped.store(true); }
+        virtual bool handOff(const VString& directoryPath, int depth);
+
+        /**
+        Records the failure of a handed-off task, and ends the walk. Only the first
+        failure is kept.
+        @param  errorMessage    why the task failed
+        */
+        void taskFailed(const VString& errorMessage);
+        /**
+        Called when a handed-off task has completed, successfully or not.
+        */
+        void taskCompleted();
+        /**
+        Blocks until every handed-off task has completed.
+        */
+        void waitForTasks();
+        /**
+        Returns the first failure recorded by taskFailed(). Valid after waitForTasks().
+        @return the error message, or empty if no task failed
+        */
+        const VString& getErrorMessage() const { return mErrorMessage; }
+
+    private:
+
+        VFSNodeWalk(const VFSNodeWalk&); // not copyable
+        VFSNodeWalk& operator=(const VFSNodeWalk&); // not assignable
+
+        VThreadPool*        mPool;                  ///< The pool to hand subdirectories off to, or NULL.
+        std::atomic<bool>   mStopped;               ///< True once the walk has been ended.
+        VMutex              mMutex;                 ///< Protects mNumTasks and mErrorMessage.
+        VSemaphore          mTasksDoneSemaphore;    ///< Signaled when mNumTasks drops to 0.
+        int                 mNumTasks;              ///< The number of handed-off tasks not yet completed.
+        VString             mErrorMessage;          ///< The first failure of a handed-off task.
+};
+
+/**
+A pool task that walks one subdirectory handed off by a VFSNodeWalk.
+*/
+class VFSNodeWalkTask : public VThreadPoolTask {
     public:
-        VFSNodeCopyDirectoryCallback(const VFSNode& destDir, bool recursive) : mDestDir(destDir), mRecursive(recursive) {}
+
+        VFSNodeWalkTask(VFSNodeWalk& walk, const VString& directoryPath, int depth) :
+            VThreadPoolTask("VFSNode::walk"), mWalk(walk), mDirectoryPath(directoryPath), mDepth(depth) {}
+        virtual ~VFSNodeWalkTask() {}
+
+        virtual void run();
+        virtual void completed();
+
+    private:
+
+        VFSNodeWalk&    mWalk;          ///< The walk the directory belongs to.
+        VString         mDirectoryPath; ///< The directory to walk.
+        int             mDepth;         ///< The depth of its contents below the walked directory.
+};
+
+VFSNodeWalk::VFSNodeWalk(VDirectoryWalkCallback& callback, bool getNodeInfo, VThreadPool* pool)
+    : VDirectoryWalk(callback, getNodeInfo)
+    , mPool(pool)
+    , mStopped(false)
+    , mMutex("VFSNodeWalk::mMutex", true/*suppress logging; it is held across the wait for the tasks*/)
+    , mTasksDoneSemaphore()
+    , mNumTasks(0)
+    , mErrorMessage()
+    {
+}
+
+bool VFSNodeWalk::handOff(const VString& directoryPath, int depth) {
+    if ((mPool == NULL) || (mPool->getNumQueuedTasks() >= mPool->getNumWorkers())) {
+        return false;
+    }
+
+    VMutexLocker locker(&mMutex, "VFSNodeWalk::handOff");
+    ++mNumTasks;
+    locker.unlock();
+
+    mPool->submit(VThreadPoolTaskPtr(new VFSNodeWalkTask(*this, directoryPath, depth)));
+    return true;
+}
+
+void VFSNodeWalk::taskFailed(const VString& errorMessage) {
+    VMutexLocker locker(&mMutex, "VFSNodeWalk::taskFailed");
+    if (mErrorMessage.isEmpty()) {
+        mErrorMessage = errorMessage;
+    }
+
+    mStopped.store(true);
+}
+
+void VFSNodeWalk::taskCompleted() {
+    // The walk may be destroyed as soon as waitForTasks() sees mNumTasks reach 0, which it
+    // can only do once we have released the mutex; so this is our last use of the walk.
+    VMutexLocker locker(&mMutex, "VFSNodeWalk::taskCompleted");
+    if (--mNumTasks == 0) {
+        mTasksDoneSemaphore.signal();
+    }
+}
+
+void VFSNodeWalk::waitForTasks() {
+    VMutexLocker locker(&mMutex, "VFSNodeWalk::waitForTasks");
+    while (mNumTasks != 0) {
+        mTasksDoneSemaphore.wait(&mMutex, VDuration::ZERO());
+    }
+}
+
+void VFSNodeWalkTask::run() {
+    if (! mWalk.isStopped()) {
+        VFSNode::_platform_walkDirectory(mWalk, mDirectoryPath, mDepth);
+    }
+}
+
+void VFSNodeWalkTask::completed() {
+    if (this->hasFailed()) {
+        mWalk.taskFailed(this->getErrorMessage());
+    }
+
+    mWalk.taskCompleted();
+}
+
+// VFSNodeCopyDirectoryCallback -----------------------------------------------
+
+/**
+The walk callback used by VFSNode::copyDirectory. Copies each file to the corresponding
+path below the destination directory, and if recursion is on, creates each directory
+there (before the walk descends into it, so before its files are copied). The walk does
+not descend through links, so for a link to a directory it copies the linked directory
+with a walk of its own, unless the link leads back to a directory already being copied.
+*/
+class VFSNodeCopyDirectoryCallback : public VDirectoryWalkCallback {
+    public:
+        VFSNodeCopyDirectoryCallback(const VFSNode& sourceDir, const VFSNode& destDir, bool recursive, VThreadPool* pool, const VStringVector& copyingRealPaths) :
+            mSourcePathLength(sourceDir.getPath().length()), mDestDir(destDir), mRecursive(recursive), mPool(pool), mCopyingRealPaths(copyingRealPaths) {}
         virtual ~VFSNodeCopyDirectoryCallback() {}
-        virtual bool handleNextNode(const VFSNode& node);
+        virtual bool handleWalkEntry(const VDirectoryWalkEntry& entry);
+        virtual bool shouldDescend(const VDirectoryWalkEntry& /*directory*/) { return mRecursive; }
     private:
+        void _copyLinkedDirectory(const VDirectoryWalkEntry& entry, const VFSNode& dest) const;
+        static bool _isSameOrAncestor(const VString& ancestorPath, const VString& path);
+
+        int mSourcePathLength;
         VFSNode mDestDir;
         bool mRecursive;
+        VThreadPool* mPool;
+        VStringVector mCopyingRealPaths; ///< The real paths of the source directory and of each linked directory whose copy led here.
 };
 
-bool VFSNodeCopyDirectoryCallback::handleNextNode(const VFSNode& source) {
-    VFSNode dest(mDestDir, source.getName());
-    if (source.isFile()) {
+bool VFSNodeCopyDirectoryCallback::handleWalkEntry(const VDirectoryWalkEntry& entry) {
+    if ((! entry.isFile()) && ! (entry.isDirectory() && mRecursive)) {
+        return true;
+    }
+
+    // The entry's directory path is the source path plus the entry's relative directory, if any.
+    VString relativeDirectory;
+    entry.getDirectoryPath().getSubstring(relativeDirectory, mSourcePathLength);
+    if (relativeDirectory.startsWith(VFSNode::PATH_SEPARATOR_CHAR)) {
+        relativeDirectory.substringInPlace(1);
+    }
+
+    VFSNode destDirectory = relativeDirectory.isEmpty() ? mDestDir : VFSNode(mDestDir, relativeDirectory);
+    VFSNode dest(destDirectory, entry.getName());
+
+    if (entry.isFile()) {
+        VFSNode source;
+        entry.getNode(source);
         VFSNode::copyFile(source, dest);
-    } else if (mRecursive) {
-        VFSNode::copyDirectory(source, dest, mRecursive);
+    } else {
+        if (! dest.exists()) {
+            dest.mkdirs();
+        }
+
+        if (entry.isLink()) {
+            this->_copyLinkedDirectory(entry, dest);
+        }
     }
-    
+
     return true;
 }
 
+void VFSNodeCopyDirectoryCallback::_copyLinkedDirectory(const VDirectoryWalkEntry& entry, const VFSNode& dest) const {
+    VString targetRealPath = VFSNode::_platform_getRealPath(entry.getPath());
+    if (targetRealPath.isEmpty()) {
+        return;
+    }
+
+    // The link loops if it leads to the directory containing it or to any directory above that, or to
+    // a directory being copied further up the chain of links that led here, or to one above that.
+    if (_isSameOrAncestor(targetRealPath, VFSNode::_platform_getRealPath(entry.getDirectoryPath()))) {
+        return;
+    }
+
+    for (VStringVector::const_iterator i = mCopyingRealPaths.begin(); i != mCopyingRealPaths.end(); ++i) {
+        if (_isSameOrAncestor(targetRealPath, *i)) {
+            return;
+        }
+    }
+
+    VStringVector copyingRealPaths(mCopyingRealPaths);
+    copyingRealPaths.push_back(targetRealPath);
+
+    VFSNode linkNode;
+    entry.getNode(linkNode);
+    VFSNodeCopyDirectoryCallback linkCallback(linkNode, dest, mRecursive, mPool, copyingRealPaths);
+    linkNode.walk(linkCallback, false, mPool);
+}
+
 // static
-void VFSNode::copyDirectory(const VFSNode& source, const VFSNode& dest, bool recursive) {
+bool VFSNodeCopyDirectoryCallback::_isSameOrAncestor(const VString& ancestorPath, const VString& path) {
+    if (path.isEmpty()) {
+        return false;
+    }
+
+    VString ancestorPathWithTrailingSeparator = ancestorPath + (ancestorPath.endsWith(VFSNode::PATH_SEPARATOR_CHAR) ? "" : VFSNode::PATH_SEPARATOR_CHARS);
+    return (path == ancestorPath) || path.startsWith(ancestorPathWithTrailingSeparator);
+}
+
+// static
+void VFSNode::copyDirectory(const VFSNode& source, const VFSNode& dest, bool recursive, VThreadPool* pool) {
     if (recursive) {
         VString sourcePathWithTrailingSeparator = source.getPath() + (source.getPath().endsWith(PATH_SEPARATOR_CHAR) ? "" : PATH_SEPARATOR_CHARS);
         if (dest.getPath().startsWith(sourcePathWithTrailingSeparator)) {
@@ -289,9 +569,13 @@ void VFSNode::copyDirectory(const VFSNode& source, const VFSNode& dest, bool rec
     if (!dest.exists()) {
         dest.mkdirs();
     }
-    
-    VFSNodeCopyDirectoryCallback copyDirectoryCallback(dest, recursive);
-	source.iterate(copyDirectoryCallback);
+
+    VStringVector copyingRealPaths;
+    VString sourceRealPath = VFSNode::_platform_getRealPath(source.getPath());
+    copyingRealPaths.push_back(sourceRealPath.isEmpty() ? source.getPath() : sourceRealPath);
+
+    VFSNodeCopyDirectoryCallback copyDirectoryCallback(source, dest, recursive, pool, copyingRealPaths);
+    source.walk(copyDirectoryCallback, false, pool);
 }
 
 VFSNode::VFSNode()
@@ -519,6 +803,27 @@ void VFSNode::iterate(VDirectoryIterationCallback& callback) const {
     this->_platform_directoryIterate(callback);
 }
 
+void VFSNode::walk(VDirectoryWalkCallback& callback, bool getNodeInfo, VThreadPool* pool) const {
+    // A worker of the pool must not wait for tasks it hands to its own pool; they may need that very worker.
+    VThreadPool* walkPool = ((pool != NULL) && pool->isCurrentThreadAWorker()) ? NULL : pool;
+    VFSNodeWalk walk(callback, getNodeInfo, walkPool);
+
+    try {
+        VFSNode::_platform_walkDirectory(walk, mPath, 0);
+    } catch (...) {
+        // Don't leave tasks running against a walk that is going away.
+        walk.stop();
+        walk.waitForTasks();
+        throw;
+    }
+
+    walk.waitForTasks();
+
+    if (walk.getErrorMessage().isNotEmpty()) {
+        throw VException(VSTRING_FORMAT("VFSNode::walk of '%s' failed: %s", mPath.chars(), walk.getErrorMessage().chars()));
+    }
+}
+
 bool VFSNode::find(const VString& name, VFSNode& node) const {
     VFSNodeFindCallback callback(name);
     this->_platform_directoryIterate(callback);
@@ -534,14 +839,16 @@ bool VFSNode::find(const VString& name, VFSNode& node) const {
 void VFSNode::readAll(VString& s, bool includeLineEndings) {
     VBufferedFileStream fs(*this);
     fs.openReadOnly();
-    VTextIOStream in(fs);
+    VReadBufferedStream bufferedStream(fs); // lets readLine() scan a block at a time
+    VTextIOStream in(bufferedStream);
     in.readAll(s, includeLineEndings);
 }
 
 void VFSNode::readAll(VStringVector& lines) {
     VBufferedFileStream fs(*this);
     fs.openReadOnly();
-    VTextIOStream in(fs);
+    VReadBufferedStream bufferedStream(fs); // lets readLine() scan a block at a time
+    VTextIOStream in(bufferedStream);
     in.readAll(lines);
 }
 
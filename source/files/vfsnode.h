@@ -107,6 +107,140 @@ class VDirectoryIterationCallback {
         virtual bool handleNextNode(const VFSNode& node) = 0;
 };
 
+/**
+VDirectoryWalkEntry describes one node found by VFSNode::walk(). It is
+cheap to make: its name points into the platform's directory buffer, and
+its directory path is one string shared by every node in the directory,
+so no path string is built for the node unless you ask for one with
+getPath() or getNode(). An entry is valid only for the duration of the
+callback it is passed to; copy what you need to keep.
+*/
+class VDirectoryWalkEntry {
+    public:
+
+        /**
+        Constructs the entry. Only the platform walk code needs to do this.
+        @param  directoryPath   the path of the directory containing the node
+        @param  name            the node's name within the directory
+        @param  depth           the depth of the directory below the walked directory
+        @param  info            the node's information
+        @param  isLink          true if the node is a symbolic link (or on Windows, a reparse point)
+        */
+        VDirectoryWalkEntry(const VString& directoryPath, const char* name, int depth, const VFSNodeInfo& info, bool isLink = false) :
+            mDirectoryPath(directoryPath), mName(name), mDepth(depth), mInfo(info), mIsLink(isLink) {}
+        ~VDirectoryWalkEntry() {}
+
+        const VString& getDirectoryPath() const { return mDirectoryPath; }  ///< Returns the path of the directory containing the node. @return obvious
+        const char* getName() const { return mName; }                       ///< Returns the node's name; the pointer is valid only during the callback. @return obvious
+        int getDepth() const { return mDepth; }                             ///< Returns 0 for a child of the walked directory, 1 for a grandchild, and so on. @return obvious
+        bool isFile() const { return mInfo.mIsFile; }                       ///< Returns true if the node is a file. @return obvious
+        bool isDirectory() const { return mInfo.mIsDirectory; }             ///< Returns true if the node is a directory. @return obvious
+        bool isLink() const { return mIsLink; }                             ///< Returns true if the node is a link; isFile() and isDirectory() describe what it points to. @return obvious
+        /**
+        Returns the node's information. The dates and size are filled in only if the
+        walk was asked for them; mErrNo is non-zero if they could not be obtained.
+        @return obvious
+        */
+        const VFSNodeInfo& getInfo() const { return mInfo; }
+        /**
+        Builds and returns the node's full path.
+        @return obvious
+        */
+        VString getPath() const;
+        /**
+        Sets a node to refer to this entry's node.
+        @param  node    the node to set
+        */
+        void getNode(VFSNode& node) const;
+
+    private:
+
+        VDirectoryWalkEntry(const VDirectoryWalkEntry&); // not copyable
+        VDirectoryWalkEntry& operator=(const VDirectoryWalkEntry&); // not assignable
+
+        const VString&      mDirectoryPath; ///< The path of the directory containing the node.
+        const char*         mName;          ///< The node's name.
+        int                 mDepth;         ///< The depth of the directory below the walked directory.
+        const VFSNodeInfo&  mInfo;          ///< The node's information.
+        bool                mIsLink;        ///< True if the node is a link.
+};
+
+/**
+VDirectoryWalkCallback is the interface through which VFSNode::walk()
+reports what it finds. When the walk uses a thread pool, the callback is
+called concurrently from several threads, and must be thread-safe.
+*/
+class VDirectoryWalkCallback {
+    public:
+
+        VDirectoryWalkCallback() {}
+        virtual ~VDirectoryWalkCallback() {}
+
+        /**
+        Called for each node found, before the walk descends into it if it is a
+        directory. Return false to end the whole walk.
+        @param  entry   the node
+        @return true to continue the walk
+        */
+        virtual bool handleWalkEntry(const VDirectoryWalkEntry& entry) = 0;
+        /**
+        Called for each directory the walk is about to descend into. The default
+        implementation always descends.
+        @param  directory   the directory's entry, already passed to handleWalkEntry()
+        @return true to walk the directory's contents
+        */
+        virtual bool shouldDescend(const VDirectoryWalkEntry& /*directory*/) { return true; }
+        /**
+        Called when a directory below the walked directory cannot be read; the walk
+        carries on without it. The default implementation does nothing.
+        @param  directoryPath   the directory's path
+        @param  errNo           the value of errno describing the failure
+        */
+        virtual void handleWalkError(const VString& /*directoryPath*/, int /*errNo*/) {}
+};
+
+/**
+VDirectoryWalk is the state of a walk in progress, through which the
+platform walk code consults the callback and hands subdirectories off to
+other threads. It is used internally by VFSNode::walk().
+*/
+class VDirectoryWalk {
+    public:
+
+        VDirectoryWalk(VDirectoryWalkCallback& callback, bool getNodeInfo) : mCallback(callback), mGetNodeInfo(getNodeInfo) {}
+        virtual ~VDirectoryWalk() {}
+
+        VDirectoryWalkCallback& getCallback() const { return mCallback; }   ///< Returns the walk's callback. @return obvious
+        bool getNodeInfo() const { return mGetNodeInfo; }                   ///< Returns true if every entry's dates and size are wanted. @return obvious
+
+        /**
+        Returns true once the walk has been ended, by the callback or by a failure.
+        @return obvious
+        */
+        virtual bool isStopped() const = 0;
+        /**
+        Ends the walk; directories not yet read are skipped.
+        */
+        virtual void stop() = 0;
+        /**
+        Offers a subdirectory to be walked on another thread.
+        @param  directoryPath   the subdirectory's path
+        @param  depth           the depth of its contents below the walked directory
+        @return true if the subdirectory was taken; false if the caller must walk it
+        */
+        virtual bool handOff(const VString& directoryPath, int depth) = 0;
+
+    private:
+
+        VDirectoryWalk(const VDirectoryWalk&); // not copyable
+        VDirectoryWalk& operator=(const VDirectoryWalk&); // not assignable
+
+        VDirectoryWalkCallback& mCallback;      ///< The walk's callback.
+        const bool              mGetNodeInfo;   ///< True if every entry's dates and size are wanted.
+};
+
+class VThreadPool;
+
 /**
 VFSNodeVector is simply a vector of VFSNode objects. Note that the vector
 elements are objects, not pointers to objects.
@@ -252,32 +386,39 @@ class VFSNode {
         /**
         This function safely overwrites an existing file using a temporary file, to ensure that the original
         file is intact if the write fails. Specifically, the sequence is:
-        1. create a temporary file next to the target file (named uniquely via current timestamp string)
+        1. create a temporary file next to the target file
         2. write to the temporary file
-        3. delete (or rename if keeping) the target file (it's OK if it doesn't exist)
-        4. rename the temporary file to the target file's name
+        3. rename the temporary file to the target file's name, which atomically replaces the target where
+           the platform allows; elsewhere, or if keeping the original, first delete (or rename if keeping)
+           the target file (it's OK if it doesn't exist)
         If steps 1, 2, or 3 fails, the original remains and the temporary is deleted.
         If there is a failure, a VException is thrown.
-        The temporary file is initially named "<timestamp>_tmp_<originalfilename>", before being renamed
-        to the original file name.
+        Where the platform supports it (Linux O_TMPFILE), the temporary file has no name until it is complete,
+        so a crash can't leave it behind; otherwise it is named "<timestamp>_<n>_tmp_<originalfilename>".
+        The data is written without further buffering, and where the platform can, a file stream's data is
+        copied inside the kernel (see VFileSystem::copyFileData()).
         If keepOld is specified, the original file is not deleted, but rather is renamed to the following
         file name: "<timestamp>_ver_<originalfilename>"
         @param  target      the file node to be overwritten (if it exists)
         @param  dataLength  the length of the data to be written
         @param  dataStream  the stream to be written to the file
         @param  keepOld     if true, the original file is not deleted, but rather renamed to a variant of the temporary file name
+        @param  syncToDisk  if true, the file is flushed to disk before it replaces the target, and the directory
+                            afterwards, so that once this returns the new contents survive a crash
         */
-        static void safelyOverwriteFile(const VFSNode& target, Vs64 dataLength, VBinaryIOStream& dataStream, bool keepOld=false);
+        static void safelyOverwriteFile(const VFSNode& target, Vs64 dataLength, VBinaryIOStream& dataStream, bool keepOld=false, bool syncToDisk=false);
 
         /**
         This function copies an existing file, overwriting the target file if it already exists, or creating it if not.
         The target directory must already exist. No meta data about the file is managed (the file is created using default
-        permissions of the process).
-        @param  source  the source file node
-        @param  dest    the destination file node, in an existing directory
+        permissions of the process). The copy is made with safelyOverwriteFile(), so the target is replaced atomically,
+        and where the file system allows, the copy shares the source's blocks or is made inside the kernel.
+        @param  source      the source file node
+        @param  dest        the destination file node, in an existing directory
+        @param  syncToDisk  if true, the copy and its directory are flushed to disk before returning
         @throws any exception that occurs while opening, reading, and writing the file data
         */
-        static void copyFile(const VFSNode& source, const VFSNode& dest);
+        static void copyFile(const VFSNode& source, const VFSNode& dest, bool syncToDisk=false);
     
         /**
         This function copies an entire directory structure, creating the destination if it does not yet exist.
@@ -287,15 +428,20 @@ class VFSNode {
         copy of the source into a subdirectory of itself (which could cause an infinite loop of subdirectory copying).
         It is only a check on the path strings of the source and destination, and does not cover things like aliases or
         drive letter mapping where the same directory might be reachable by two different paths.
+        A link to a directory is followed, and the directory it points to is copied in its place, unless it leads back
+        to a directory already being copied (that is, it would loop); such a link is copied as an empty directory.
+        If this is called from a task running on the pool, the copy is done on that task's thread.
         @param  source      the source directory node to be copied
         @param  dest        the destination directory node to create if non-existent, and then into which source's contents
                             are copied
         @param  recursive   true if the source's subdirectories are to be recursively copied; false if only the
                             top level files in the source directory are to be copied
-        @throws any exception thrown by the individual file copy operations; a VException if the destination
-                            node's path is a child of the source node's path
+        @param  pool        a running pool to copy subdirectories on in parallel, or NULL to copy on this thread
+        @throws any exception thrown by the individual file copy operations (as a VException with its message, if it
+                            was thrown on a pool thread); a VException if the destination node's path is a child of
+                            the source node's path
         */
-        static void copyDirectory(const VFSNode& source, const VFSNode& dest, bool recursive);
+        static void copyDirectory(const VFSNode& source, const VFSNode& dest, bool recursive, VThreadPool* pool = NULL);
 
         /**
         Constructs an undefined VFSNode object (you will have to set its path
@@ -516,6 +662,32 @@ class VFSNode {
         */
         void iterate(VDirectoryIterationCallback& callback) const;
         /**
+        Walks the whole tree below this directory, calling the supplied callback
+        for each node. This is the fast way to scan a large tree: no VFSNode or
+        path string is made per node, the platform's directory entry types are
+        used so that nodes need not be stat'ed one by one, and where the platform
+        allows, subdirectories are opened relative to their parent's open handle.
+        A directory's entry is passed to the callback before its contents are.
+        Symbolic links are reported as what they point to, but the walk does not
+        descend through a link to a directory, so it cannot loop.
+        If a thread pool is supplied, subdirectories are handed off to its idle
+        workers as they are found, and the callback is called concurrently from
+        those threads and this one; this thread returns when the whole tree has
+        been walked. If this is called from a task running on the pool, the pool
+        is not used and the whole tree is walked on that task's thread, because
+        waiting there for the pool's other tasks could leave none to run them.
+        @param  callback    the object to call for each node
+        @param  getNodeInfo true to fill in the dates and size of every entry, at
+                            the cost of a stat per node; otherwise only isFile() and
+                            isDirectory() are valid
+        @param  pool        a running pool to walk subdirectories on in parallel, or
+                            NULL to walk the whole tree on this thread
+        @throws VException if this directory cannot be read; or if the callback threw
+                            on a pool thread, one with its message; an exception the
+                            callback throws on this thread propagates unchanged
+        */
+        void walk(VDirectoryWalkCallback& callback, bool getNodeInfo = false, VThreadPool* pool = NULL) const;
+        /**
         Iterates over the directory until it finds the specified child node using
         a case-insensitive match on the node names. This is useful if you need
         to open a file but don't know what case it is in due to cross-platform
@@ -661,6 +833,29 @@ class VFSNode {
         */
         void _platform_directoryIterate(VDirectoryIterationCallback& callback) const;
 
+        friend class VFSNodeWalkTask;
+
+        /**
+        Walks the tree below a directory, reporting each node to the walk's callback,
+        and offering each subdirectory to the walk's handOff() before walking it here.
+        @param  walk            the walk in progress
+        @param  directoryPath   the directory's path
+        @param  depth           the depth of its contents below the walked directory
+        @throws VException if depth is 0 and the directory cannot be read; deeper
+                            directories that cannot be read are reported to the callback
+        */
+        static void _platform_walkDirectory(VDirectoryWalk& walk, const VString& directoryPath, int depth);
+
+        friend class VFSNodeCopyDirectoryCallback;
+
+        /**
+        Returns the absolute path of a node with every link along it resolved, so that
+        two paths to the same directory yield the same string.
+        @param  path    the node's path
+        @return the resolved path, or empty if the node does not exist or cannot be resolved
+        */
+        static VString _platform_getRealPath(const VString& path);
+
         VString mPath;  ///< The node's path.
 
 };
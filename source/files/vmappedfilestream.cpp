@@ -0,0 +1,255 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vmappedfilestream.h"
+#include "vtypes_internal.h"
+
+#include "vexception.h"
+
+// When a file is opened for writing, we map at least this much so that there is always
+// a buffer for streamCopy() to write into; the file is truncated to the data length on close.
+static const Vs64 kMinimumWritableMapLength = CONST_S64(65536);
+
+VMappedFileStream::VMappedFileStream(AccessPattern accessPattern)
+    : VAbstractFileStream()
+    , mFile(-1)
+    , mWritable(false)
+    , mAccessPattern(accessPattern)
+    , mMapAddress(NULL)
+    , mMapLength(0)
+    , mEOFOffset(0)
+    , mIOOffset(0)
+    , mMappingHandle(NULL)
+    {
+}
+
+VMappedFileStream::VMappedFileStream(const VFSNode& node, AccessPattern accessPattern)
+    : VAbstractFileStream(node)
+    , mFile(-1)
+    , mWritable(false)
+    , mAccessPattern(accessPattern)
+    , mMapAddress(NULL)
+    , mMapLength(0)
+    , mEOFOffset(0)
+    , mIOOffset(0)
+    , mMappingHandle(NULL)
+    {
+}
+
+VMappedFileStream::~VMappedFileStream() {
+    try {
+        VMappedFileStream::close();
+    } catch (...) {} // block exceptions from propagating
+}
+
+void VMappedFileStream::setAccessPattern(AccessPattern accessPattern) {
+    mAccessPattern = accessPattern;
+
+    if (mMapAddress != NULL) {
+        this->_platform_advise();
+    }
+}
+
+void VMappedFileStream::openReadOnly() {
+    this->_open(READ_ONLY_MODE, false, "VMappedFileStream::openReadOnly");
+}
+
+void VMappedFileStream::openReadWrite() {
+    // A writable mapping requires the file to be opened for reading as well as writing, hence READWRITE_MODE.
+    this->_open(READWRITE_MODE, true, "VMappedFileStream::openReadWrite");
+}
+
+void VMappedFileStream::openWrite() {
+    this->_open(READWRITE_MODE | O_TRUNC, true, "VMappedFileStream::openWrite");
+}
+
+bool VMappedFileStream::isOpen() const {
+    return (mFile != -1);
+}
+
+void VMappedFileStream::close() {
+    if (! this->isOpen()) {
+        return;
+    }
+
+    this->_platform_unmap();
+
+    if (mWritable) {
+        this->_platform_resizeFile(mEOFOffset);
+    }
+
+    (void) VFileSystem::close(mFile);
+    mFile = -1;
+    mWritable = false;
+    mMapLength = 0;
+    mEOFOffset = 0;
+    mIOOffset = 0;
+}
+
+Vs64 VMappedFileStream::read(Vu8* targetBuffer, Vs64 numBytesToRead) {
+    Vs64 numBytesRead = this->_prepareToRead(numBytesToRead);
+
+    if (numBytesRead > 0) {
+        VStream::copyMemory(targetBuffer, mMapAddress + mIOOffset, numBytesRead);
+        this->_finishRead(numBytesRead);
+    }
+
+    return numBytesRead;
+}
+
+Vs64 VMappedFileStream::write(const Vu8* buffer, Vs64 numBytesToWrite) {
+    this->_prepareToWrite(numBytesToWrite);
+    VStream::copyMemory(mMapAddress + mIOOffset, buffer, numBytesToWrite);
+    this->_finishWrite(numBytesToWrite);
+
+    return numBytesToWrite;
+}
+
+void VMappedFileStream::flush() {
+    if (mWritable && (mMapAddress != NULL)) {
+        this->_platform_sync();
+    }
+}
+
+bool VMappedFileStream::skip(Vs64 numBytesToSkip) {
+    return this->seek(numBytesToSkip, SEEK_CUR);
+}
+
+bool VMappedFileStream::seek(Vs64 offset, int whence) {
+    Vs64 requestedOffset;
+
+    switch (whence) {
+        case SEEK_SET:
+            requestedOffset = offset;
+            break;
+
+        case SEEK_CUR:
+            requestedOffset = mIOOffset + offset;
+            break;
+
+        case SEEK_END:
+            requestedOffset = mEOFOffset + offset;
+            break;
+
+        default:
+            requestedOffset = CONST_S64(0);
+            break;
+    }
+
+    if (requestedOffset < 0) {
+        mIOOffset = 0;
+        return false;
+    }
+
+    if (requestedOffset > mEOFOffset) {
+        if (! mWritable) {
+            mIOOffset = mEOFOffset;
+            return false;
+        }
+
+        // Like VMemoryStream, seeking past EOF on a writable stream extends it. The file grows with zeroes.
+        mIOOffset = mEOFOffset;
+        this->_ensureCapacity(requestedOffset - mEOFOffset);
+        mEOFOffset = requestedOffset;
+    }
+
+    mIOOffset = requestedOffset;
+    return true;
+}
+
+Vs64 VMappedFileStream::getIOOffset() const {
+    return mIOOffset;
+}
+
+Vs64 VMappedFileStream::available() const {
+    return mEOFOffset - mIOOffset;
+}
+
+Vu8* VMappedFileStream::_getReadIOPtr() const {
+    if (mMapAddress == NULL) {
+        return NULL;
+    }
+
+    return mMapAddress + mIOOffset;
+}
+
+Vu8* VMappedFileStream::_getWriteIOPtr() const {
+    if ((! mWritable) || (mMapAddress == NULL)) {
+        return NULL;
+    }
+
+    return mMapAddress + mIOOffset;
+}
+
+Vs64 VMappedFileStream::_prepareToRead(Vs64 numBytesToRead) const {
+    return V_MIN(numBytesToRead, mEOFOffset - mIOOffset);
+}
+
+void VMappedFileStream::_prepareToWrite(Vs64 numBytesToWrite) {
+    if (! mWritable) {
+        throw VEOFException(VSTRING_FORMAT("VMappedFileStream: Attempt to write to read-only file '%s'.", mNode.getPath().chars()));
+    }
+
+    this->_ensureCapacity(numBytesToWrite);
+}
+
+void VMappedFileStream::_finishRead(Vs64 numBytesRead) {
+    mIOOffset += numBytesRead;
+}
+
+void VMappedFileStream::_finishWrite(Vs64 numBytesWritten) {
+    mIOOffset += numBytesWritten;
+    mEOFOffset = V_MAX(mEOFOffset, mIOOffset);
+}
+
+void VMappedFileStream::_open(int openFlags, bool writable, const VString& failedMethod) {
+    this->close();
+
+    mFile = VFileSystem::open(mNode.getPath(), openFlags);
+    this->_throwIfOpenFailed(failedMethod, mNode.getPath());
+
+    mWritable = writable;
+    mEOFOffset = this->_platform_getFileSize();
+    mIOOffset = 0;
+
+    Vs64 mapLength = mEOFOffset;
+    if (mWritable) {
+        mapLength = V_MAX(mapLength, kMinimumWritableMapLength);
+        if (mapLength != mEOFOffset) {
+            this->_platform_resizeFile(mapLength);
+        }
+    }
+
+    // A zero-length file cannot be mapped; it simply has no data.
+    if (mapLength != 0) {
+        try {
+            this->_platform_map(mapLength);
+        } catch (...) {
+            this->close();
+            throw;
+        }
+
+        this->_platform_advise();
+    }
+}
+
+void VMappedFileStream::_ensureCapacity(Vs64 numBytesToWrite) {
+    Vs64 requiredLength = mIOOffset + numBytesToWrite;
+    if (requiredLength <= mMapLength) {
+        return;
+    }
+
+    // Grow by doubling, so that a series of small writes doesn't remap every time.
+    Vs64 newLength = V_MAX(requiredLength, mMapLength * 2);
+
+    this->_platform_unmap();
+    this->_platform_resizeFile(newLength);
+    this->_platform_map(newLength);
+    this->_platform_advise();
+}
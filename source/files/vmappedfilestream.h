@@ -0,0 +1,207 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vmappedfilestream_h
+#define vmappedfilestream_h
+
+/** @file */
+
+#include "vabstractfilestream.h"
+
+/**
+    @ingroup vstream_derived vfilesystem
+*/
+
+/**
+VMappedFileStream is a concrete VStream class that implements stream i/o
+on a file by memory-mapping it. Reads and writes are simple memory copies
+to and from the mapped file contents, and the mapped memory is exposed to
+VStream::streamCopy(), so copying between a mapped file and a memory stream
+or socket stream requires no intermediate buffer.
+
+When opened read-only, the file is mapped read-only and its size is fixed.
+When opened for writing, the mapping is grown as needed (by doubling)
+when a write extends past its end, and the file is truncated to the actual
+data length when it is closed.
+
+Mapping is best suited to large files that are read (or replayed) in bulk.
+For small files or for files that are appended to a little at a time, such
+as log files, VBufferedFileStream is a better choice.
+
+@see VStream
+@see VAbstractFileStream
+@see VBufferedFileStream
+@see VDirectIOFileStream
+*/
+class VMappedFileStream : public VAbstractFileStream {
+    public:
+
+        /**
+        Hints to the OS about how the mapped file will be accessed, so
+        that it can tune read-ahead and page eviction.
+        */
+        typedef enum {
+            kAccessNormal,      ///< No special treatment.
+            kAccessSequential,  ///< Pages will be accessed in order; read ahead aggressively and release pages behind.
+            kAccessRandom,      ///< Pages will be accessed in random order; don't bother reading ahead.
+            kAccessWillNeed     ///< The whole file will be needed soon; start reading it in now.
+        } AccessPattern;
+
+        /**
+        Constructs an undefined stream (you will have to set it up
+        with a subsequent call to setNode()).
+        @param  accessPattern   the access hint to apply when the file is mapped
+        */
+        VMappedFileStream(AccessPattern accessPattern = kAccessSequential);
+        /**
+        Constructs a stream with a node.
+        @param  node            the node representing the file
+        @param  accessPattern   the access hint to apply when the file is mapped
+        */
+        VMappedFileStream(const VFSNode& node, AccessPattern accessPattern = kAccessSequential);
+        /**
+        Destructor, closes the stream if it is open.
+        */
+        virtual ~VMappedFileStream();
+
+        /**
+        Changes the access hint. If the file is currently mapped, the hint is
+        applied immediately; otherwise it is applied when the file is opened.
+        @param  accessPattern   the new access hint
+        */
+        void setAccessPattern(AccessPattern accessPattern);
+        /**
+        Returns the access hint.
+        @return the access hint
+        */
+        AccessPattern getAccessPattern() const { return mAccessPattern; }
+        /**
+        Returns the length of the file data, which for a writable stream
+        may be less than the size of the mapping.
+        @return the data length
+        */
+        Vs64 getEOFOffset() const { return mEOFOffset; }
+
+        // Implementation of VAbstractFileStream -----------------------------
+
+        /**
+        Opens and maps the file read-only. Throws a VException if it cannot be opened or mapped.
+        */
+        virtual void openReadOnly();
+        /**
+        Opens and maps the file read-write, creating the file if it does not exist.
+        Throws a VException if it cannot be opened or mapped.
+        */
+        virtual void openReadWrite();
+        /**
+        Opens and maps the file for writing, creating the file if it does not exist,
+        and truncating it if it does. Throws a VException if it cannot be opened.
+        */
+        virtual void openWrite();
+        /**
+        Returns true if the file stream is open.
+        */
+        virtual bool isOpen() const;
+        /**
+        Unmaps and closes the file stream. For a writable stream, the file is
+        first truncated to the data length.
+        */
+        virtual void close();
+
+        // Implementation of VStream -----------------------------------------
+
+        /**
+        Copies data out of the mapped file.
+        @param    targetBuffer    the buffer to read into
+        @param    numBytesToRead    the number of bytes to read
+        @return    the number of bytes actually read
+        */
+        virtual Vs64 read(Vu8* targetBuffer, Vs64 numBytesToRead);
+        /**
+        Copies data into the mapped file, growing it as needed. Throws a
+        VException if the stream is read-only.
+        @param    buffer            the buffer to read from
+        @param    numBytesToWrite    the number of bytes to write
+        @return    the number of bytes actually written
+        */
+        virtual Vs64 write(const Vu8* buffer, Vs64 numBytesToWrite);
+        /**
+        Schedules the modified pages to be written to the file. (Like a buffered
+        file stream flush, this does not wait for the data to reach the disk.)
+        */
+        virtual void flush();
+        /**
+        Skips forward in the stream.
+        @param    numBytesToSkip    the number of bytes to skip
+        */
+        virtual bool skip(Vs64 numBytesToSkip);
+        /**
+        Seeks in the stream; seeks are constrained to the data length.
+        @param    offset    the offset (meaning depends on whence value)
+        @param    whence    SEEK_SET, SEEK_CUR, or SEEK_END
+        @return true if the seek was successful
+        */
+        virtual bool seek(Vs64 offset, int whence);
+        /**
+        Returns the current offset in the stream.
+        @return the current offset
+        */
+        virtual Vs64 getIOOffset() const;
+        /**
+        Returns the number of bytes from the current offset to the end of the data.
+        @return the number of bytes currently available for reading
+        */
+        virtual Vs64 available() const;
+
+    protected:
+
+        // Overrides of the VStream buffer access used by streamCopy().
+        virtual Vu8* _getReadIOPtr() const;
+        virtual Vu8* _getWriteIOPtr() const;
+        virtual Vs64 _prepareToRead(Vs64 numBytesToRead) const;
+        virtual void _prepareToWrite(Vs64 numBytesToWrite);
+        virtual void _finishRead(Vs64 numBytesRead);
+        virtual void _finishWrite(Vs64 numBytesWritten);
+
+    private:
+
+        VMappedFileStream(const VMappedFileStream&); // not copyable
+        VMappedFileStream& operator=(const VMappedFileStream&); // not assignable
+
+        /**
+        Opens the file with the specified flags and maps it.
+        @param  openFlags       flags to pass to VFileSystem::open()
+        @param  writable        true if the mapping is to be writable
+        @param  failedMethod    the name of the calling method, for error messages
+        */
+        void _open(int openFlags, bool writable, const VString& failedMethod);
+        /**
+        Grows the file and mapping if needed so that the specified number of bytes
+        can be written at the current offset.
+        @param  numBytesToWrite the number of bytes about to be written
+        */
+        void _ensureCapacity(Vs64 numBytesToWrite);
+
+        // These are implemented in the platform-specific source file.
+        void _platform_map(Vs64 mapLength);     ///< Maps mapLength bytes of mFile into mMapAddress; throws on failure.
+        void _platform_unmap();                 ///< Unmaps mMapAddress if mapped.
+        void _platform_resizeFile(Vs64 length); ///< Sets the length of the underlying file.
+        Vs64 _platform_getFileSize() const;     ///< Returns the length of the underlying file.
+        void _platform_advise();                ///< Applies mAccessPattern to the current mapping.
+        void _platform_sync();                  ///< Schedules modified pages to be written.
+
+        int             mFile;              ///< The file descriptor; -1 when closed.
+        bool            mWritable;          ///< True if the file is mapped for writing.
+        AccessPattern   mAccessPattern;     ///< The access hint for the mapping.
+        Vu8*            mMapAddress;        ///< The start of the mapped file contents, or NULL if nothing is mapped.
+        Vs64            mMapLength;         ///< The length of the mapping.
+        Vs64            mEOFOffset;         ///< The length of the file data (<= mMapLength).
+        Vs64            mIOOffset;          ///< The current i/o offset.
+        void*           mMappingHandle;     ///< The platform's file mapping object, where one is needed in addition to the address (Windows).
+};
+
+#endif /* vmappedfilestream_h */
@@ -36,9 +36,13 @@ VClientSession::VClientSession(const VString& sessionBaseName, VServer* server,
     , mStandbyStartTime(VInstant::NEVER_OCCURRED())
     , mStandbyTimeLimit(standbyTimeLimit)
     , mMaxClientQueueDataSize(maxQueueDataSize)
+    , mIdleTimeLimit(VDuration::ZERO())
+    , mStandbyTimer("VClientSession.standby", this, &VClientSession::_standbyTimeLimitExpired)
+    , mIdleTimer("VClientSession.idle", this, &VClientSession::_idleTimerExpired)
     , mSocket(socket)
     , mSocketStream(socket, "VClientSession") // FIXME: find a way to get the IP address here or to set in ctor
-    , mIOStream(mSocketStream)
+    , mBufferedStream(mSocketStream)
+    , mIOStream(mBufferedStream)
     {
     mClientAddress.format("%s:%d", mClientIP.chars(), mClientPort);
     mName.format("%s:%s:%d", sessionBaseName.chars(), mClientIP.chars(), mClientPort);
@@ -52,6 +56,10 @@ VClientSession::VClientSession(const VString& sessionBaseName, VServer* server,
 }
 
 VClientSession::~VClientSession() {
+    // Timers run on another thread; cancel() waits if one is firing now.
+    mStandbyTimer.cancel();
+    mIdleTimer.cancel();
+
     try {
         this->_releaseQueuedClientMessages();
     } catch (...) {}
@@ -75,7 +83,7 @@ void VClientSession::initIOThreads() {
 }
 
 void VClientSession::shutdown(VThread* callingThread) {
-    VMutexLocker locker(&mMutex, VSTRING_FORMAT("[%s]VClientSession::shutdown() %s", this->getName().chars(), (callingThread == NULL ? "" : callingThread->getName().chars())));
+    VMutexLocker locker(&mMutex, "VClientSession::shutdown()");
 
     mIsShuttingDown = true;
 
@@ -108,7 +116,7 @@ void VClientSession::shutdown(VThread* callingThread) {
 }
 
 void VClientSession::postOutputMessage(VMessagePtr message, bool isForBroadcast) {
-    VMutexLocker locker(&mMutex, VSTRING_FORMAT("[%s]VClientSession::postOutputMessage()", this->getName().chars())); // protect the mStartupStandbyQueue during queue operations
+    VMutexLocker locker(&mMutex, "VClientSession::postOutputMessage()"); // protect the mStartupStandbyQueue during queue operations
 
     // Don't post if client is doing a disconnect:
     if (mIsShuttingDown || this->isClientGoingOffline()) {
@@ -125,6 +133,11 @@ void VClientSession::postOutputMessage(VMessagePtr message, bool isForBroadcast)
 
         if (mStandbyStartTime == VInstant::NEVER_OCCURRED()) {
             mStandbyStartTime = now;
+
+            // Enforce the time limit even if nothing more is posted to notice it.
+            if (mStandbyTimeLimit != VDuration::ZERO()) {
+                VTimerWheel::getSharedWheel().schedule(&mStandbyTimer, mStandbyTimeLimit);
+            }
         }
 
         Vs64 currentQueueDataSize = mStartupStandbyQueue.getQueueDataSize();
@@ -191,6 +204,18 @@ VBentoNode* VClientSession::getSessionInfo() const {
     return result;
 }
 
+void VClientSession::setIdleTimeLimit(const VDuration& idleTimeLimit) {
+    VMutexLocker locker(&mMutex, "VClientSession::setIdleTimeLimit()");
+    mIdleTimeLimit = idleTimeLimit;
+    locker.unlock(); // cancel() may wait for _idleTimerExpired(), which needs mMutex
+
+    if (idleTimeLimit == VDuration::ZERO()) {
+        mIdleTimer.cancel();
+    } else {
+        VTimerWheel::getSharedWheel().schedule(&mIdleTimer, idleTimeLimit);
+    }
+}
+
 void VClientSession::_moveStandbyMessagesToAsyncOutputQueue() {
     // Note that we rely on the caller to lock the mMutex before calling us.
     // changeInitalizationState calls us but needs to lock a larger scope,
@@ -204,6 +229,8 @@ void VClientSession::_moveStandbyMessagesToAsyncOutputQueue() {
     }
 
     mStandbyStartTime = VInstant::NEVER_OCCURRED(); // We are no longer in standby queuing mode (until next time we queue).
+    // We leave mStandbyTimer scheduled: cancelling it here, under mMutex, could deadlock with it firing.
+    // It does nothing if it finds that standby has ended.
 }
 
 int VClientSession::_getOutputQueueSize() const {
@@ -215,7 +242,7 @@ void VClientSession::_postStandbyMessageToAsyncOutputQueue(VMessagePtr message)
 }
 
 void VClientSession::_releaseQueuedClientMessages() {
-    VMutexLocker locker(&mMutex, VSTRING_FORMAT("[%s]VClientSession::_releaseQueuedClientMessages()", this->getName().chars())); // protect the mStartupStandbyQueue during queue operations
+    VMutexLocker locker(&mMutex, "VClientSession::_releaseQueuedClientMessages()"); // protect the mStartupStandbyQueue during queue operations
 
     // Order probably does not matter, but it makes sense to pop them in the order they would have been sent.
 
@@ -226,6 +253,41 @@ void VClientSession::_releaseQueuedClientMessages() {
     mStartupStandbyQueue.releaseAllMessages();
 }
 
+void VClientSession::_standbyTimeLimitExpired() {
+    VMutexLocker locker(&mMutex, "VClientSession::_standbyTimeLimitExpired()");
+
+    if (mIsShuttingDown || (mStandbyStartTime == VInstant::NEVER_OCCURRED())) {
+        return;
+    }
+
+    // Standby may have ended and started again while we waited for mMutex.
+    VDuration remaining = (mStandbyStartTime + mStandbyTimeLimit) - VInstant();
+    if (remaining > VDuration::ZERO()) {
+        VTimerWheel::getSharedWheel().schedule(&mStandbyTimer, remaining);
+        return;
+    }
+
+    VLOGGER_NAMED_ERROR(mLoggerName, VSTRING_FORMAT("[%s] VClientSession::_standbyTimeLimitExpired: Reached standby time limit of %s with %d messages queued. Closing socket to force shutdown of session and its i/o threads.", this->getName().chars(), mStandbyTimeLimit.getDurationString().chars(), static_cast<int>(mStartupStandbyQueue.getQueueSize())));
+    mSocket->close();
+}
+
+void VClientSession::_idleTimerExpired() {
+    VMutexLocker locker(&mMutex, "VClientSession::_idleTimerExpired()");
+
+    if (mIsShuttingDown || (mIdleTimeLimit == VDuration::ZERO())) {
+        return;
+    }
+
+    VDuration idleTime = mSocket->getIdleTime();
+    if (idleTime < mIdleTimeLimit) {
+        // The client has sent something since the timer was set. Check again when the limit would next be reached.
+        VTimerWheel::getSharedWheel().schedule(&mIdleTimer, mIdleTimeLimit - idleTime);
+    } else {
+        VLOGGER_NAMED_ERROR(mLoggerName, VSTRING_FORMAT("[%s] VClientSession::_idleTimerExpired: Client has been idle for %s, over the limit of %s. Closing socket to force shutdown of session and its i/o threads.", this->getName().chars(), idleTime.getDurationString().chars(), mIdleTimeLimit.getDurationString().chars()));
+        mSocket->close();
+    }
+}
+
 // VClientSessionFactory -----------------------------------------------------------
 
 void VClientSessionFactory::addSessionToServer(VClientSessionPtr session) {
@@ -233,3 +295,17 @@ void VClientSessionFactory::addSessionToServer(VClientSessionPtr session) {
         mServer->addClientSession(session);
     }
 }
+
+void VClientSessionFactory::initSessionIOThreads(VClientSessionPtr session) const {
+    if (! mThreadOptions.isDefault()) {
+        if (session->getInputThread() != NULL) {
+            session->getInputThread()->setOptions(mThreadOptions);
+        }
+
+        if (session->getOutputThread() != NULL) {
+            session->getOutputThread()->setOptions(mThreadOptions);
+        }
+    }
+
+    session->initIOThreads();
+}
@@ -13,8 +13,11 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vstring.h"
 #include "vmutex.h"
 #include "vmutexlocker.h"
+#include "vthread.h"
+#include "vtimerwheel.h"
 #include "vmessagequeue.h"
 #include "vsocketstream.h"
+#include "vreadbufferedstream.h"
 #include "vbinaryiostream.h"
 
 /**
@@ -141,6 +144,14 @@ class VClientSession : public VEnableSharedFromThis<VClientSession> {
         @return obvious
         */
         virtual const VString& getClientAddress() const { return mClientAddress; }
+        /**
+        Sets a limit on how long the client may go without sending anything; once
+        it is reached, the socket is closed, which ends the session. The limit is
+        enforced by a timer on the shared VTimerWheel, which looks at the socket's
+        last read time only when the timer expires, so reads are not slowed.
+        @param  idleTimeLimit   the idle time limit; zero means no limit (the default)
+        */
+        void setIdleTimeLimit(const VDuration& idleTimeLimit);
 
         /**
         Returns a new bento node with attributes describing the session. Subclasses
@@ -183,18 +194,24 @@ class VClientSession : public VEnableSharedFromThis<VClientSession> {
         VClientSession& operator=(const VClientSession&); // not assignable
 
         void _releaseQueuedClientMessages();   ///< Releases all pending queued messages (called during shutdown).
+        void _standbyTimeLimitExpired();        ///< Called by mStandbyTimer; closes the socket if the session is still in standby.
+        void _idleTimerExpired();               ///< Called by mIdleTimer; closes the socket if the client has been idle for mIdleTimeLimit.
 
         VMessageQueue   mStartupStandbyQueue;   ///< A queue we use to hold outbound updates while this client session is starting up.
         VInstant        mStandbyStartTime;      ///< The time at which we started queueing standby messages; reset by _moveStandbyMessagesToAsyncOutputQueue().
         VDuration       mStandbyTimeLimit;      ///< Once we go to standby, a time limit applies after which posting standby causes session shutdown due to presumed failure.
         Vs64            mMaxClientQueueDataSize;///< If non-zero, if a message is posted when there are already this many bytes queued, we close the socket.
+        VDuration       mIdleTimeLimit;         ///< If non-zero, the time the client may go without sending anything before we close the socket.
+        VMethodTimerTask<VClientSession> mStandbyTimer; ///< Expires mStandbyTimeLimit after standby starts, so the limit applies even if nothing more is posted.
+        VMethodTimerTask<VClientSession> mIdleTimer;    ///< Expires when the client may have reached mIdleTimeLimit.
 
         // We only access the socket i/o stream if postOutputMessage() is called
         // and we are not set up to use a separate output message thread. However, we are responsible
         // for deleting the socket object.
         VSocket*        mSocket;        ///< The socket this session is using.
-        VSocketStream   mSocketStream;  ///< The underlying raw socket stream over which this thread communicates.
-        VBinaryIOStream mIOStream;      ///< The binary-format i/o stream over the raw socket stream.
+        VSocketStream       mSocketStream;      ///< The underlying raw socket stream over which this thread communicates.
+        VReadBufferedStream mBufferedStream;    ///< Buffers reads from the raw socket stream; writes pass straight through.
+        VBinaryIOStream     mIOStream;          ///< The binary-format i/o stream over the buffered socket stream.
 };
 
 typedef VSharedPtr<VClientSession> VClientSessionPtr;
@@ -215,7 +232,7 @@ class VClientSessionFactory {
         @param  manager the manager to be supplied to sessions that are created
         @param  server  the server to be supplied to sessions that are created
         */
-        VClientSessionFactory(VManagementInterface* manager, VServer* server) : mManager(manager), mServer(server) {}
+        VClientSessionFactory(VManagementInterface* manager, VServer* server) : mManager(manager), mServer(server), mThreadOptions() {}
         virtual ~VClientSessionFactory() {}
 
         /**
@@ -240,14 +257,36 @@ class VClientSessionFactory {
         @param  manager the manager to notify, or NULL
         */
         void setManager(VManagementInterface* manager) { mManager = manager; }
+        /**
+        Sets the operating system attributes -- stack size, CPU affinity, scheduling --
+        of the i/o threads of the sessions this factory creates. They are applied by
+        initSessionIOThreads(). A small stack size is what keeps the address space of
+        a server with thousands of sessions in check.
+        @param  options the thread options
+        */
+        void setThreadOptions(const VThreadOptions& options) { mThreadOptions = options; }
+        /**
+        Returns the operating system attributes of the sessions' i/o threads.
+        @return the thread options
+        */
+        const VThreadOptions& getThreadOptions() const { return mThreadOptions; }
 
     protected:
 
+        /**
+        Gives the session's i/o threads this factory's thread options, and then attaches
+        and starts them by calling the session's initIOThreads(). Your createSession()
+        should call this in place of calling initIOThreads() itself.
+        @param  session the session that has been created
+        */
+        void initSessionIOThreads(VClientSessionPtr session) const;
+
         VClientSessionFactory(const VClientSessionFactory&); // not copyable
         VClientSessionFactory& operator=(const VClientSessionFactory&); // not assignable
 
-        VManagementInterface*   mManager;   ///< The object that will be notified of session events.
-        VServer*                mServer;    ///< The server that will be notified of session creation.
+        VManagementInterface*   mManager;       ///< The object that will be notified of session events.
+        VServer*                mServer;        ///< The server that will be notified of session creation.
+        VThreadOptions          mThreadOptions; ///< The operating system attributes of each session's i/o threads.
 };
 
 #endif /* vclientsession_h */
@@ -31,6 +31,7 @@ VListenerThread::VListenerThread(const VString& threadBaseName, bool deleteSelfA
     , mSessionFactory(sessionFactory)
     , mSocketThreads()
     , mSocketThreadsMutex(VSTRING_FORMAT("VListenerThread(%s)::mSocketThreadsMutex", threadBaseName.chars()))
+    , mStartListeningEvent()
     {
 }
 
@@ -38,7 +39,7 @@ VListenerThread::~VListenerThread() {
     VLOGGER_NAMED_DEBUG(mLoggerName, VSTRING_FORMAT("VListenerThread '%s' ended.", mName.chars()));
 
     // Make sure any of socket threads still alive no longer reference us.
-    VMutexLocker locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::socketThreadEnded()", this->getName().chars()));
+    VMutexLocker locker(&mSocketThreadsMutex, "VListenerThread::socketThreadEnded()");
     for (VSocketThreadPtrVector::const_iterator i = mSocketThreads.begin(); i != mSocketThreads.end(); ++i) {
         (*i)->mOwnerThread = NULL;
     }
@@ -49,6 +50,7 @@ void VListenerThread::stop() {
     this->stopAllSocketThreads();
 
     VThread::stop();
+    mStartListeningEvent.signal(); // in case run() is waiting in non-listening mode
 }
 
 void VListenerThread::run() {
@@ -56,13 +58,13 @@ void VListenerThread::run() {
         if (mShouldListen) {
             this->_runListening();
         } else {
-            VThread::sleep(5 * VDuration::SECOND()); // this value limits how quickly we can be shut down
+            mStartListeningEvent.wait(); // until startListening() or stop()
         }
     }
 }
 
 void VListenerThread::socketThreadEnded(VSocketThread* socketThread) {
-    VMutexLocker                        locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::socketThreadEnded()", this->getName().chars()));
+    VMutexLocker                        locker(&mSocketThreadsMutex, "VListenerThread::socketThreadEnded()");
     VSocketThreadPtrVector::iterator    position;
 
     position = std::find(mSocketThreads.begin(), mSocketThreads.end(), socketThread);
@@ -78,7 +80,7 @@ int VListenerThread::getPortNumber() const {
 
 VSocketInfoVector VListenerThread::enumerateActiveSockets() {
     VSocketInfoVector   info;
-    VMutexLocker        locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::enumerateActiveSockets()", this->getName().chars()));
+    VMutexLocker        locker(&mSocketThreadsMutex, "VListenerThread::enumerateActiveSockets()");
 
     for (VSizeType i = 0; i < mSocketThreads.size(); ++i) {
         VSocketInfo oneSocketInfo(*(mSocketThreads[i]->getSocket()));
@@ -91,7 +93,7 @@ VSocketInfoVector VListenerThread::enumerateActiveSockets() {
 
 void VListenerThread::stopSocketThread(VSocketID socketID, int localPortNumber) {
     bool            found = false;
-    VMutexLocker    locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::stopSocketThread()", this->getName().chars()));
+    VMutexLocker    locker(&mSocketThreadsMutex, "VListenerThread::stopSocketThread()");
 
     for (VSizeType i = 0; i < mSocketThreads.size(); ++i) {
         VSocketThread*  thread = mSocketThreads[i];
@@ -110,7 +112,7 @@ void VListenerThread::stopSocketThread(VSocketID socketID, int localPortNumber)
 }
 
 void VListenerThread::stopAllSocketThreads() {
-    VMutexLocker locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::stopAllSocketThreads()", this->getName().chars()));
+    VMutexLocker locker(&mSocketThreadsMutex, "VListenerThread::stopAllSocketThreads()");
 
     for (VSizeType i = 0; i < mSocketThreads.size(); ++i) {
         VSocketThread* thread = mSocketThreads[i];
@@ -140,10 +142,13 @@ void VListenerThread::_runListening() {
 
             if (theSocket != NULL) {
                 try {
-                    VMutexLocker locker(&mSocketThreadsMutex, VSTRING_FORMAT("[%s]VListenerThread::_runListening()", this->getName().chars()));
+                    VMutexLocker locker(&mSocketThreadsMutex, "VListenerThread::_runListening()");
 
                     if (mSessionFactory == NULL) {
                         VSocketThread* thread = mThreadFactory->createThread(theSocket, this);
+                        if (! mThreadFactory->getThreadOptions().isDefault()) {
+                            thread->setOptions(mThreadFactory->getThreadOptions());
+                        }
                         thread->start(); // throws if can't create OS thread
                         mSocketThreads.push_back(thread);
                     } else {
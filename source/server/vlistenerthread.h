@@ -13,6 +13,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vsocketthread.h"
 #include "vsocket.h"
 #include "vmutex.h"
+#include "vcountingsemaphore.h"
 
 class VSocketFactory;
 class VSocketThreadFactory;
@@ -139,10 +140,10 @@ class VListenerThread : public VThread {
         void stopAllSocketThreads();
         /**
         Sets the thread to listen if it isn't already. If the thread is
-        currently listening, nothing changes. If it's sleeping in non-listening
-        mode, next time through the loop it will start listening again.
+        currently listening, nothing changes. If it's waiting in non-listening
+        mode, it wakes and starts listening again.
         */
-        void startListening() { mShouldListen = true; }
+        void startListening() { mShouldListen = true; mStartListeningEvent.signal(); }
         /**
         Sets the thread to stop listening if it's currently listening. If the
         thread is not currently listening, nothing changes. If it's running in
@@ -179,6 +180,7 @@ class VListenerThread : public VThread {
         VClientSessionFactory*  mSessionFactory;        ///< A factory for each incoming connection's VClientSession.
         VSocketThreadPtrVector  mSocketThreads;         ///< The VSocketThread objects we have created.
         VMutex                  mSocketThreadsMutex;    ///< Mutex to protect our VSocketThread vector.
+        VEvent                  mStartListeningEvent;   ///< Wakes the run loop from non-listening mode on startListening() or stop().
 
 };
 
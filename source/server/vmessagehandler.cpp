@@ -50,7 +50,7 @@ VMessageHandler::VMessageHandler(const VString& name, VMessagePtr m, VServer* se
     , mThread(thread)
     , mMessageFactory(messageFactory)
     , mStartTime(/*now*/)
-    , mLocker(mutex, VSTRING_FORMAT("VMessageHandler(%s)", name.chars()))
+    , mLocker(mutex, "VMessageHandler")
     , mUnblockTime(/*now*/) // Note that if we block locking the mutex, mUnblockTime - mStartTime will indicate how long we were blocked here.
     , mSessionName() // initialized below if session or thread was supplied
     {
@@ -87,6 +87,14 @@ void VMessageHandler::logMessageContentRecord(const VString& details, VNamedLogg
         logger->log(VMessage::kMessageContentRecordingLevel, details);
 }
 
+void VMessageHandler::logMessageContentRecord(const VString& details, const VBentoNode& content, VNamedLoggerPtr logger) const {
+    if (logger == nullptr)
+        logger = this->_getMessageContentRecordLogger();
+
+    if (logger != nullptr)
+        logger->logBento(VMessage::kMessageContentRecordingLevel, details, VString::EMPTY(), content);
+}
+
 void VMessageHandler::logMessageContentFields(const VString& details, VNamedLoggerPtr logger) const {
     if (logger == nullptr)
         logger = this->_getMessageContentFieldsLogger();
@@ -108,15 +116,15 @@ void VMessageHandler::logProcessMessageStart() const {
 }
 
 void VMessageHandler::logProcessMessageEnd() const {
-    VDuration elapsed = VInstant(/*now*/) - mStartTime;
-    if (mUnblockTime == mStartTime) {
-        VLOGGER_NAMED_LEVEL(mLoggerName, VMessage::kMessageHandlerDispatchLevel, VSTRING_FORMAT("%s end. (Elapsed time: %s)", mName.chars(), elapsed.getDurationString().chars()));
+    const Vs64 elapsedNanoseconds = mStartTime.getNanosecondsSince();
+    const Vs64 blockedNanoseconds = mUnblockTime - mStartTime;
+    if (blockedNanoseconds < VTicks::kNanosecondsPerMillisecond) {
+        VLOGGER_NAMED_LEVEL(mLoggerName, VMessage::kMessageHandlerDispatchLevel, VSTRING_FORMAT("%s end. (Elapsed time: %s)", mName.chars(), VTicks::getDurationString(elapsedNanoseconds).chars()));
     } else {
-        // We were evidently blocked for at least 1ms during construction, waiting for the mutex to be released.
+        // We were blocked for at least 1ms during construction, waiting for the mutex to be released.
         // If the duration of blocked time exceeded a certain amount, emit this at info level so it is even more visible.
-        VDuration blockedTime = mUnblockTime - mStartTime;
-        VLOGGER_NAMED_LEVEL(mLoggerName, (blockedTime > 25 * VDuration::MILLISECOND()) ? VLoggerLevel::INFO : (int)VMessage::kMessageHandlerDispatchLevel, // strangely, gcc gave linker error w/o int cast
-                              VSTRING_FORMAT("%s end. (Elapsed time: %s. Blocked for: %s.)", mName.chars(), elapsed.getDurationString().chars(), blockedTime.getDurationString().chars()));
+        VLOGGER_NAMED_LEVEL(mLoggerName, (blockedNanoseconds > 25 * VTicks::kNanosecondsPerMillisecond) ? VLoggerLevel::INFO : (int)VMessage::kMessageHandlerDispatchLevel, // strangely, gcc gave linker error w/o int cast
+                              VSTRING_FORMAT("%s end. (Elapsed time: %s. Blocked for: %s.)", mName.chars(), VTicks::getDurationString(elapsedNanoseconds).chars(), VTicks::getDurationString(blockedNanoseconds).chars()));
     }
 }
 
@@ -13,6 +13,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vmutex.h"
 #include "vmutexlocker.h"
 #include "vmessage.h"
+#include "vlogger.h"
 #include "vclientsession.h"
 
 /** @file */
@@ -125,6 +126,17 @@ class VMessageHandler {
         */
         void logMessageContentRecord(const VString& details, VNamedLoggerPtr logger = VNamedLoggerPtr()) const;
         /**
+        Like logMessageContentRecord(), but logs the message content as a structured Bento
+        payload along with a short description, rather than as text. Appenders that write
+        binary output, such as VBinaryLogAppender, keep the payload in binary form, so that
+        a handler need not format the whole message as text to record it.
+        @param    details    a short description of the message
+        @param    content    the message content
+        @param    logger    the logger to write to, or NULL to force the function to
+                        look up the logger
+        */
+        void logMessageContentRecord(const VString& details, const VBentoNode& content, VNamedLoggerPtr logger = VNamedLoggerPtr()) const;
+        /**
         Logs (at the appropriate log level) the supplied information about the
         message being handled. A message handler should call this to log the
         data contained in the inbound message, one field at a time. An
@@ -198,9 +210,9 @@ class VMessageHandler {
         VClientSessionPtr       mSession;       ///< The session reference for which we are running, which holds NULL if n/a.
         VSocketThread*          mThread;        ///< The thread in which we are running.
         const VMessageFactory*  mMessageFactory;///< Factory for instantiating new messages this handler wants to send.
-        VInstant                mStartTime;     ///< The time at which this handler was instantiated (message receipt). MUST BE DECLARED BEFORE mLocker.
+        VTicks                  mStartTime;     ///< The time at which this handler was instantiated (message receipt). MUST BE DECLARED BEFORE mLocker.
         VMutexLocker            mLocker;        ///< The mutex locker for the mutex we were given.
-        VInstant                mUnblockTime;   ///< The time at which this handler obtained the mLocker lock. MUST BE DECLARED AFTER mLocker.
+        VTicks                  mUnblockTime;   ///< The time at which this handler obtained the mLocker lock. MUST BE DECLARED AFTER mLocker.
         VString                 mSessionName;   ///< The name to identify this handler's session in log output.
 
     private:
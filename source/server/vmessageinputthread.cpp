@@ -8,6 +8,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vmessageinputthread.h"
 
 #include "vexception.h"
+#include "vmutexlocker.h"
 #include "vmessagehandler.h"
 #include "vlogger.h"
 #include "vmessage.h"
@@ -19,12 +20,15 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 VMessageInputThread::VMessageInputThread(const VString& threadBaseName, VSocket* socket, VListenerThread* ownerThread, VServer* server, const VMessageFactory* messageFactory)
     : VSocketThread(threadBaseName, socket, ownerThread)
     , mSocketStream(socket, "VMessageInputThread")
-    , mInputStream(mSocketStream)
+    , mBufferedStream(mSocketStream)
+    , mInputStream(mBufferedStream)
     , mConnected(false)
     , mSession()
     , mServer(server)
     , mMessageFactory(messageFactory)
     , mHasOutputThread(false)
+    , mOutputThreadMutex(VSTRING_FORMAT("VMessageInputThread(%s)::mOutputThreadMutex", threadBaseName.chars()), true/*suppress logging; it is held across the wait at the end of run()*/)
+    , mOutputThreadEndedSemaphore()
     {
 }
 
@@ -80,13 +84,15 @@ void VMessageInputThread::run() {
         mSession->shutdown(this);
     }
 
-    // If we are dependent on an output thread, we must spin here until it clears the flag.
+    // If we are dependent on an output thread, we must wait here until it clears the flag.
+    // Checking the flag under the mutex ensures the output thread has finished signaling us before we return.
     const VDuration warnLimit = 15 * VDuration::SECOND();
     const VInstant startTime;
     bool warned = false;
+    VMutexLocker locker(&mOutputThreadMutex, "VMessageInputThread::run()");
     while (mHasOutputThread) {
-        VThread::sleep(50 * VDuration::MILLISECOND());
-        if (!warned) {
+        mOutputThreadEndedSemaphore.wait(&mOutputThreadMutex, warned ? VDuration::ZERO() : warnLimit);
+        if (!warned && mHasOutputThread) {
             const VInstant now;
             const VDuration duration = now - startTime;
             if (duration > warnLimit) {
@@ -95,6 +101,7 @@ void VMessageInputThread::run() {
             }
         }
     }
+    locker.unlock();
 
     if (warned) {
         const VInstant now;
@@ -107,6 +114,15 @@ void VMessageInputThread::attachSession(VClientSessionPtr session) {
     mSession = session;
 }
 
+void VMessageInputThread::setHasOutputThread(bool hasOutputThread) {
+    VMutexLocker locker(&mOutputThreadMutex, "VMessageInputThread::setHasOutputThread()");
+    mHasOutputThread = hasOutputThread;
+
+    if (! hasOutputThread) {
+        mOutputThreadEndedSemaphore.signal();
+    }
+}
+
 //lint -e429 "Custodial pointer 'message' has not been freed or returned" [OK: try or catch branches guarantee message is released.]
 void VMessageInputThread::_processNextRequest() {
     VMessagePtr message = mMessageFactory->instantiateNewMessage();
@@ -12,9 +12,12 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vsocketthread.h"
 #include "vsocketstream.h"
+#include "vreadbufferedstream.h"
 #include "vserver.h"
 #include "vbinaryiostream.h"
 #include "vmessage.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
 
 class VMessageHandler;
 
@@ -69,7 +72,7 @@ class VMessageInputThread : public VSocketThread {
         handling i/o and the destruction sequence requires the input thread to wait for the
         output thread to die before dying itself.
         */
-        void setHasOutputThread(bool hasOutputThread) { mHasOutputThread = hasOutputThread; }
+        void setHasOutputThread(bool hasOutputThread);
 
     protected:
 
@@ -113,12 +116,15 @@ class VMessageInputThread : public VSocketThread {
         virtual void _afterProcessMessage(VMessageHandler* /*handler*/) {}
 
         VSocketStream           mSocketStream;      ///< The underlying raw stream from which data is read.
+        VReadBufferedStream     mBufferedStream;    ///< Buffers reads from the raw stream so that message fields don't each cost a socket read.
         VBinaryIOStream         mInputStream;       ///< The formatted stream from which data is directly read.
         bool                    mConnected;         ///< True if the client has completed the connection sequence.
         VClientSessionPtr       mSession;           ///< The session object we are associated with.
         VServer*                mServer;            ///< The server object that owns us.
         const VMessageFactory*  mMessageFactory;    ///< Factory for instantiating new messages to read from input stream.
         volatile bool           mHasOutputThread;   ///< True if we are dependent on an output thread completion before returning from run(). (see run() code)
+        VMutex                  mOutputThreadMutex; ///< Protects mHasOutputThread, so that the output thread is done with us before run() can return.
+        VSemaphore              mOutputThreadEndedSemaphore;///< Signaled when mHasOutputThread is cleared, to wake the end of run().
 
     private:
 
@@ -28,7 +28,8 @@ VMessageOutputThread::VMessageOutputThread(const VString& threadBaseName, VSocke
     , mMaxQueueGracePeriod(maxQueueGracePeriod)
     , mWhenMaxQueueSizeWarned(VInstant() - VDuration::MINUTE()) // one minute ago (past warning throttle threshold)
     , mWasOverLimit(false)
-    , mWhenWentOverLimit(VInstant::NEVER_OCCURRED())
+    , mWhenWentOverLimit(VInstant::NEVER_OCCURRED().getValue())
+    , mGracePeriodTimer("VMessageOutputThread.grace", this, &VMessageOutputThread::_gracePeriodExpired)
     {
 
     if (mDependentInputThread != NULL) {
@@ -37,6 +38,8 @@ VMessageOutputThread::VMessageOutputThread(const VString& threadBaseName, VSocke
 }
 
 VMessageOutputThread::~VMessageOutputThread() {
+    mGracePeriodTimer.cancel(); // waits if it is firing now
+
     mOutputQueue.releaseAllMessages();
 
     /*
@@ -104,14 +107,14 @@ bool VMessageOutputThread::postOutputMessage(VMessagePtr message, bool respectQu
         int currentQueueSize = 0;
         Vs64 currentQueueDataSize = 0;
         if (! this->isOutputQueueOverLimit(currentQueueSize, currentQueueDataSize)) {
-            mWasOverLimit = false;
+            mWasOverLimit.store(false);
         } else {
             VInstant now;
             bool gracePeriodExceeded = false;
 
-            if (mWasOverLimit) {
+            if (mWasOverLimit.load()) {
                 // Still over limit. Have we exceeded the grace period?
-                VDuration howLongOverLimit = now - mWhenWentOverLimit;
+                VDuration howLongOverLimit = now - VInstant::instantFromRawValue(mWhenWentOverLimit.load());
                 gracePeriodExceeded = (howLongOverLimit > mMaxQueueGracePeriod);
             } else {
                 // We've just gone over the limit.
@@ -119,8 +122,9 @@ bool VMessageOutputThread::postOutputMessage(VMessagePtr message, bool respectQu
                 if (mMaxQueueGracePeriod == VDuration::ZERO()) {
                     gracePeriodExceeded = true;
                 } else {
-                    mWhenWentOverLimit = now;
-                    mWasOverLimit = true;
+                    mWhenWentOverLimit.store(now.getValue()); // before the flag, which the timer checks first
+                    mWasOverLimit.store(true);
+                    VTimerWheel::getSharedWheel().schedule(&mGracePeriodTimer, mMaxQueueGracePeriod);
                 }
             }
 
@@ -136,7 +140,7 @@ bool VMessageOutputThread::postOutputMessage(VMessagePtr message, bool respectQu
             } else {
                 if (now - mWhenMaxQueueSizeWarned > VDuration::MINUTE()) { // Throttle the rate of ongoing warnings.
                     mWhenMaxQueueSizeWarned = now;
-                    VDuration gracePeriodRemaining = (mWhenWentOverLimit + mMaxQueueGracePeriod) - now;
+                    VDuration gracePeriodRemaining = (VInstant::instantFromRawValue(mWhenWentOverLimit.load()) + mMaxQueueGracePeriod) - now;
                     VLOGGER_NAMED_WARN(mLoggerName, VSTRING_FORMAT("[%s] VMessageOutputThread::postOutputMessage: Posting to queue with excess size of %d messages and " VSTRING_FORMATTER_S64 " bytes. Remaining grace period %d seconds.",
                                                 mName.chars(), currentQueueSize, currentQueueDataSize, gracePeriodRemaining.getDurationSeconds()));
                 }
@@ -188,3 +192,24 @@ void VMessageOutputThread::_processNextOutboundMessage() {
     }
 }
 
+void VMessageOutputThread::_gracePeriodExpired() {
+    // If a post has since found the queue back under its limits, the grace period no longer applies.
+    if (! mWasOverLimit.load() || ! this->isRunning()) {
+        return;
+    }
+
+    // The queue may have dropped under its limits and gone over again since the timer was set.
+    VDuration gracePeriodRemaining = (VInstant::instantFromRawValue(mWhenWentOverLimit.load()) + mMaxQueueGracePeriod) - VInstant();
+    if (gracePeriodRemaining > VDuration::ZERO()) {
+        VTimerWheel::getSharedWheel().schedule(&mGracePeriodTimer, gracePeriodRemaining);
+        return;
+    }
+
+    int currentQueueSize = 0;
+    Vs64 currentQueueDataSize = 0;
+    if (this->isOutputQueueOverLimit(currentQueueSize, currentQueueDataSize)) {
+        VLOGGER_NAMED_ERROR(mLoggerName, VSTRING_FORMAT("[%s] VMessageOutputThread::_gracePeriodExpired: Closing socket to shut down session because output queue size of %d messages and " VSTRING_FORMATTER_S64 " bytes is still over limit after grace period of %s.",
+                                     mName.chars(), currentQueueSize, currentQueueDataSize, mMaxQueueGracePeriod.getDurationString().chars()));
+        this->stop();
+    }
+}
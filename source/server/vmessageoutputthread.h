@@ -16,6 +16,9 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vmessage.h"
 #include "vmessagequeue.h"
 #include "vclientsession.h"
+#include "vtimerwheel.h"
+
+#include <atomic>
 
 class VServer;
 
@@ -51,7 +54,8 @@ class VMessageOutputThread : public VSocketThread {
                             to postOutputMessage() occurs when the limit has been exceeded,
                             the call will just close the socket and return
         @param maxQueueGracePeriod how long the maxQueueSize and maxQueueDataSize limits may be exceeded
-                            before the socket is closed upon next posted message
+                            before the socket is closed; a timer on the shared VTimerWheel closes it
+                            when the grace period ends, even if no more messages are posted
         */
         VMessageOutputThread(const VString& threadBaseName, VSocket* socket, VListenerThread* ownerThread, VServer* server, VClientSessionPtr session, VMessageInputThread* dependentInputThread, int maxQueueSize = 0, Vs64 maxQueueDataSize = 0, const VDuration& maxQueueGracePeriod = VDuration::ZERO());
         /**
@@ -122,6 +126,11 @@ class VMessageOutputThread : public VSocketThread {
         Processes the next queued message, blocking if there is nothing queued.
         */
         void _processNextOutboundMessage();
+        /**
+        Called by mGracePeriodTimer; stops the thread if the queue is still over its
+        limits at the end of the grace period.
+        */
+        void _gracePeriodExpired();
 
         VMessageQueue           mOutputQueue;       ///< The output queue that this thread pulls messages from.
         VSocketStream           mSocketStream;      ///< The underlying raw stream the message data is written to.
@@ -134,9 +143,11 @@ class VMessageOutputThread : public VSocketThread {
         VDuration               mMaxQueueGracePeriod;///< How long we will allow the queue limits to be exceeded before we close the socket.
         VInstant                mWhenMaxQueueSizeWarned;///< Time we last warned about exceeding the queue size; this avoids flood of warnings if condition persists.
 
-        // These are the transient flags we use to enforce and monitor the queue limits.
-        bool        mWasOverLimit;      ///< True if the last postOutputMessage() call left us over the limit.
-        VInstant    mWhenWentOverLimit; ///< When did we last transition from under-limit to over-limit.
+        // These are the transient flags we use to enforce and monitor the queue limits. They are written by
+        // posting threads and read by the grace period timer on the timer wheel thread, so they are atomic.
+        std::atomic<bool>   mWasOverLimit;      ///< True if the last postOutputMessage() call left us over the limit.
+        std::atomic<Vs64>   mWhenWentOverLimit; ///< When did we last transition from under-limit to over-limit, as a VInstant value.
+        VMethodTimerTask<VMessageOutputThread> mGracePeriodTimer; ///< Expires at the end of the grace period, so it ends even if nothing more is posted.
 };
 
 #endif /* vmessageoutputthread_h */
@@ -20,8 +20,8 @@ VMessageQueue::VMessageQueue()
     : mQueuedMessages()
     , mQueuedMessagesDataSize(0)
     , mMessageQueueMutex("VMessageQueue::mMessageQueueMutex")
-    , mMessageQueueSemaphore()
-    , mLastMessagePostTime()
+    , mMessageQueueEvent()
+    , mLastMessagePostTicks()
     {
 }
 
@@ -33,14 +33,16 @@ void VMessageQueue::postMessage(VMessagePtr message) {
     VMutexLocker locker(&mMessageQueueMutex, "VMessageQueue::postMessage()");
 
     mQueuedMessages.push_back(message);
-    mLastMessagePostTime.setNow();
+    if (gVMessageQueueLagLoggingThreshold >= VDuration::ZERO()) { // only needed for the lag check, which is off by default
+        mLastMessagePostTicks = VTicks();
+    }
 
     if (message != nullptr) {
         mQueuedMessagesDataSize += message->getMessageDataLength();
     }
 
-    locker.unlock();    // otherwise signal() will deadlock
-    mMessageQueueSemaphore.signal();
+    locker.unlock();    // so the woken thread does not immediately block on the mutex
+    mMessageQueueEvent.signal();
 }
 
 VMessagePtr VMessageQueue::blockUntilNextMessage() {
@@ -50,9 +52,9 @@ VMessagePtr VMessageQueue::blockUntilNextMessage() {
         return message;
     }
 
-    // There is nothing on the queue, so wait until someone posts a message.
-    VMutex dummy("VMessageQueue::blockUntilNextMessage() dummy");
-    mMessageQueueSemaphore.wait(&dummy, 5 * VDuration::SECOND());
+    // There is nothing on the queue, so wait until someone posts a message. A post made since
+    // we looked has already set the event, so this cannot miss it; the timeout is only a safety net.
+    (void) mMessageQueueEvent.timedWait(5 * VDuration::SECOND());
 
     return this->getNextMessage();
 }
@@ -70,13 +72,16 @@ VMessagePtr VMessageQueue::getNextMessage() {
             mQueuedMessagesDataSize -= message->getMessageDataLength();
         }
 
+        // Posts that arrive before a woken consumer clears the event share its one wake-up; pass it on to another consumer.
+        if (mQueuedMessages.size() > 0) {
+            mMessageQueueEvent.signal();
+        }
     }
 
     if ((message != nullptr) && (gVMessageQueueLagLoggingThreshold >= VDuration::ZERO())) {
-        VInstant now;
-        VDuration delayInterval = now - mLastMessagePostTime;
-        if (delayInterval >= gVMessageQueueLagLoggingThreshold) {
-            VLOGGER_NAMED_LEVEL("vault.messages.VMessageQueue", gVMessageQueueLagLoggingLevel, VSTRING_FORMAT("VMessageQueue saw a delay of %s when getting a message with ID %d.", delayInterval.getDurationString().chars(), message->getMessageID()));
+        Vs64 delayNanoseconds = mLastMessagePostTicks.getNanosecondsSince();
+        if (delayNanoseconds >= gVMessageQueueLagLoggingThreshold.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_NAMED_LEVEL("vault.messages.VMessageQueue", gVMessageQueueLagLoggingLevel, VSTRING_FORMAT("VMessageQueue saw a delay of %s when getting a message with ID %d.", VTicks::getDurationString(delayNanoseconds).chars(), message->getMessageID()));
         }
     }
 
@@ -84,7 +89,7 @@ VMessagePtr VMessageQueue::getNextMessage() {
 }
 
 void VMessageQueue::wakeUp() {
-    mMessageQueueSemaphore.signal();
+    mMessageQueueEvent.signal();
 }
 
 VSizeType VMessageQueue::getQueueSize() const {
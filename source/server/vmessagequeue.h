@@ -10,7 +10,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vtypes.h"
 #include "vmutex.h"
-#include "vsemaphore.h"
+#include "vcountingsemaphore.h"
 #include "vcompactingdeque.h"
 #include "vmessage.h"
 
@@ -32,6 +32,13 @@ getNextMessage() simply returns the next message, or NULL, so the caller must
 decide how to manage de-queueing messages without chewing up the CPU
 needlessly (for UI apps this may mean a notification scheme so that the app's
 UI thread only looks at the queue when something gets posted to it).
+
+The blocking is done with a VEvent, so a message posted (or a wakeUp())
+between the consumer finding the queue empty and starting to wait still
+wakes it immediately; the wake latency is that of the OS scheduler, not of
+a polling interval. The event wakes one consumer at a time, and a burst of
+posts may set it only once, so a consumer that takes a message and leaves
+more on the queue sets it again for the next one.
 */
 class VMessageQueue {
     public:
@@ -54,8 +61,10 @@ class VMessageQueue {
         virtual void postMessage(VMessagePtr message);
         /**
         Returns the message at the front of the queue, blocking if the queue
-        is empty. May be safely called from any thread.
-        @return the message at the front of the queue; the caller becomes
+        is empty. May be safely called from any thread. Returns NULL if woken
+        by wakeUp(), or after a few seconds with no message, so that the
+        caller can check whether it should stop.
+        @return the message at the front of the queue, or NULL; the caller becomes
                         owner of the object
         */
         VMessagePtr blockUntilNextMessage();
@@ -105,8 +114,8 @@ class VMessageQueue {
         VCompactingDeque<VMessagePtr> mQueuedMessages;///< The actual queue of messages.
         Vs64            mQueuedMessagesDataSize;    ///< The number of bytes in the queued messages.
         VMutex          mMessageQueueMutex;         ///< The mutex used to synchronize.
-        VSemaphore      mMessageQueueSemaphore;     ///< The semaphore used to block/awaken.
-        VInstant        mLastMessagePostTime;       ///< Time most recent message was posted.
+        VEvent          mMessageQueueEvent;         ///< The event used to block/awaken.
+        VTicks          mLastMessagePostTicks;      ///< Time most recent message was posted.
 
         static VDuration gVMessageQueueLagLoggingThreshold; ///< If >=0, queuing lags are logged.
         static int gVMessageQueueLagLoggingLevel;           ///< Log level at which queuing lags are logged.
@@ -20,6 +20,15 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include <sys/ioctl.h>
 #include <ifaddrs.h>
 
+// Linux and Mac OS X have (different) sendfile() APIs that can send from a file to a socket.
+#if defined(__linux__)
+    #include <sys/sendfile.h>
+    #define VSOCKET_HAVE_SENDFILE
+#elif defined(VPLATFORM_MAC)
+    #include <sys/uio.h>
+    #define VSOCKET_HAVE_SENDFILE
+#endif
+
 // static
 bool VSocket::_platform_staticInit() {
     //lint -e421 -e923 " Caution -- function 'signal(int, void (*)(int))' is considered dangerous [MISRA Rule 123]"
@@ -110,3 +119,39 @@ int VSocket::_platform_available() {
     return numBytesAvailable;
 }
 
+// static
+bool VSocket::_platform_isSendFileSupported() {
+#ifdef VSOCKET_HAVE_SENDFILE
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef VSOCKET_HAVE_SENDFILE
+Vs64 VSocket::_platform_sendFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToSend) {
+    // Linux won't send more than about 2GB in one call; just cap each call at that on either platform.
+    Vs64 requestCount = V_MIN(numBytesToSend, static_cast<Vs64>(0x7FFFF000));
+
+#ifdef __linux__
+    off_t offset = static_cast<off_t>(fileOffset);
+    ssize_t result = ::sendfile(mSocketID, fileDescriptor, &offset, static_cast<size_t>(requestCount));
+    return static_cast<Vs64>(result);
+#else
+    off_t length = static_cast<off_t>(requestCount);
+    int result = ::sendfile(fileDescriptor, mSocketID, static_cast<off_t>(fileOffset), &length, NULL, 0);
+
+    // Interrupted or non-blocking sends may have sent part of the data; report that rather than the error.
+    if ((result == -1) && (length > 0) && ((errno == EINTR) || (errno == EAGAIN))) {
+        return static_cast<Vs64>(length);
+    }
+
+    return (result == -1) ? CONST_S64(-1) : static_cast<Vs64>(length);
+#endif
+}
+#else
+Vs64 VSocket::_platform_sendFile(int /*fileDescriptor*/, Vs64 /*fileOffset*/, Vs64 /*numBytesToSend*/) {
+    // Not reached; sendFile() checks _platform_isSendFileSupported() first.
+    return -1;
+}
+#endif
@@ -119,3 +119,13 @@ int VSocket::_platform_available() {
     return (int) numBytesAvailable;
 }
 
+// static
+bool VSocket::_platform_isSendFileSupported() {
+    // TransmitFile() needs a HANDLE and overlapped i/o to be used well; for now, callers fall back to read()/write().
+    return false;
+}
+
+Vs64 VSocket::_platform_sendFile(int /*fileDescriptor*/, Vs64 /*fileOffset*/, Vs64 /*numBytesToSend*/) {
+    // Not reached; sendFile() checks _platform_isSendFileSupported() first.
+    return -1;
+}
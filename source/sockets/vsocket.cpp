@@ -423,7 +423,7 @@ int VSocket::read(Vu8* buffer, int numBytesToRead) {
         mNumBytesRead += theNumBytesRead;
     }
 
-    mLastEventTime.setNow();
+    mLastEventTime.setNowCoarse(); // bookkeeping only; avoids a clock read per read() when VCoarseClock is running
 
     return (numBytesToRead - bytesRemainingToRead);
 }
@@ -483,6 +483,71 @@ int VSocket::write(const Vu8* buffer, int numBytesToWrite) {
     return (numBytesToWrite - bytesRemainingToWrite);
 }
 
+Vs64 VSocket::sendFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToSend) {
+    if (! VSocket::_platform_isSocketIDValid(mSocketID)) {
+        throw VStackTraceException(VSTRING_FORMAT("VSocket[%s] sendFile: Invalid socket ID %d.", mSocketName.chars(), mSocketID));
+    }
+
+    if (! VSocket::_platform_isSendFileSupported()) {
+        return -1;
+    }
+
+    Vs64    nextFileOffset = fileOffset;
+    Vs64    bytesRemainingToSend = numBytesToSend;
+    fd_set  writeset;
+
+    while (bytesRemainingToSend > 0) {
+
+        FD_ZERO(&writeset);
+        FD_SET(mSocketID, &writeset);
+        int result = ::select(SelectSockIDTypeCast (mSocketID + 1), NULL, &writeset, NULL, (mWriteTimeOutActive ? &mWriteTimeOut : NULL));
+
+        if (result < 0) {
+            VSystemError e = VSystemError::getSocketError();
+            if (e.isLikePosixError(EINTR)) {
+                continue;
+            }
+
+            if (e.isLikePosixError(EBADF)) {
+                throw VSocketClosedException(e, VSTRING_FORMAT("VSocket[%s] sendFile: Socket has closed (EBADF).", mSocketName.chars()));
+            } else {
+                throw VException(e, VSTRING_FORMAT("VSocket[%s] sendFile: select() failed. Result=%d.", mSocketName.chars(), result));
+            }
+        } else if (result == 0) {
+            throw VException(VSTRING_FORMAT("VSocket[%s] sendFile: Select timed out.", mSocketName.chars()));
+        }
+
+        Vs64 theNumBytesSent = this->_platform_sendFile(fileDescriptor, nextFileOffset, bytesRemainingToSend);
+
+        if (theNumBytesSent < 0) {
+            VSystemError e = VSystemError::getSocketError();
+            if (e.isLikePosixError(EINTR) || e.isLikePosixError(EAGAIN)) {
+                continue;
+            }
+
+            // Some kinds of file can't be sent this way; we can tell on the first attempt, before anything has been sent.
+            if ((bytesRemainingToSend == numBytesToSend) && (e.isLikePosixError(EINVAL) || e.isLikePosixError(ENOSYS) || e.isLikePosixError(EOPNOTSUPP))) {
+                return -1;
+            }
+
+            if (e.isLikePosixError(EPIPE)) {
+                throw VSocketClosedException(e, VSTRING_FORMAT("VSocket[%s] sendFile: Socket has closed (EPIPE).", mSocketName.chars()));
+            } else {
+                throw VException(e, VSTRING_FORMAT("VSocket[%s] sendFile: sendfile() failed.", mSocketName.chars()));
+            }
+        } else if (theNumBytesSent == 0) {
+            break; // reached end of file
+        }
+
+        bytesRemainingToSend -= theNumBytesSent;
+        nextFileOffset += theNumBytesSent;
+
+        mNumBytesWritten += theNumBytesSent;
+    }
+
+    return (numBytesToSend - bytesRemainingToSend);
+}
+
 void VSocket::discoverHostAndPort() {
     struct sockaddr_in  info;
     VSocklenT           infoLength = sizeof(info);
@@ -917,7 +982,7 @@ void VSocketConnectionStrategyThreadedRunner::_lockedStartWorker(const VString&
 }
 
 void VSocketConnectionStrategyThreadedRunner::_workerSucceeded(VSocketConnectionStrategyThreadedWorker* worker, VSocket& openedSocket) {
-    VMutexLocker locker(&mMutex, VSTRING_FORMAT("_workerSucceeded(%s)", worker->getName().chars()));
+    VMutexLocker locker(&mMutex, "VSocketConnectionStrategyThreadedRunner::_workerSucceeded()");
     if (mConnectionCompleted) {
         VLOGGER_TRACE(VSTRING_FORMAT("VSocketConnectionStrategyThreadedRunner %s:%d _workerSucceeded(sockid %d) ignored because another worker has already won.", openedSocket.getHostIPAddress().chars(), mPortNumberToConnect, (int) openedSocket.getSockID()));
     } else {
@@ -934,7 +999,7 @@ void VSocketConnectionStrategyThreadedRunner::_workerSucceeded(VSocketConnection
 }
 
 void VSocketConnectionStrategyThreadedRunner::_workerFailed(VSocketConnectionStrategyThreadedWorker* worker, const VException& ex) {
-    VMutexLocker locker(&mMutex, VSTRING_FORMAT("_workerFailed(%s)", worker->getName().chars()));
+    VMutexLocker locker(&mMutex, "VSocketConnectionStrategyThreadedRunner::_workerFailed()");
     this->_lockedForgetOneWorker(worker);
 
     VLOGGER_ERROR(VSTRING_FORMAT("VSocketConnectionStrategyThreadedRunner::_workerFailed: %s", ex.what()));
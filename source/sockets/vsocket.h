@@ -419,6 +419,22 @@ class VSocket {
         */
         virtual int write(const Vu8* buffer, int numBytesToWrite);
         /**
+        Writes data to the socket directly from a file, using sendfile() so that the
+        data does not have to be read into memory first. The file descriptor's own
+        offset is neither used nor changed. The write timeout applies as for write().
+
+        If the platform does not support this, or does not support it for this kind
+        of file, nothing is sent and -1 is returned, so the caller can fall back to
+        reading the file and calling write().
+
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToSend    the number of bytes to send
+        @return    the number of bytes written, which is fewer than requested only if the
+                    end of the file was reached; or -1 if sendfile() is not supported
+        */
+        virtual Vs64 sendFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToSend);
+        /**
         Flushes any unwritten bytes to the socket.
         */
         virtual void flush();
@@ -524,6 +540,20 @@ class VSocket {
         @return the number of bytes currently available for reading
         */
         int _platform_available();
+        /**
+        Returns true if this platform has a sendfile() that can be used to implement sendFile().
+        @return true if _platform_sendFile() is implemented
+        */
+        static bool _platform_isSendFileSupported();
+        /**
+        Makes one sendfile() call to send up to the specified number of bytes from the file to
+        the socket. The caller has already waited for the socket to be writable.
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToSend    the maximum number of bytes to send
+        @return the number of bytes sent (0 at end of file), or -1 on error with the error code set
+        */
+        Vs64 _platform_sendFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToSend);
 };
 
 /**
@@ -88,3 +88,7 @@ Vs64 VSocketStream::available() const {
     return mSocket->available();
 }
 
+Vs64 VSocketStream::_writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite) {
+    return mSocket->sendFile(fileDescriptor, fileOffset, numBytesToWrite);
+}
+
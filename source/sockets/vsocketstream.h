@@ -122,6 +122,18 @@ class VSocketStream : public VStream {
         */
         virtual Vs64 available() const;
 
+    protected:
+
+        /**
+        Sends data straight from a file to the socket without reading it into
+        memory, if the platform supports it. See VSocket::sendFile().
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToWrite    the number of bytes to send
+        @return the number of bytes written, or -1 if not supported
+        */
+        virtual Vs64 _writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite);
+
     private:
 
         VSocket* mSocket;   ///< The socket on which this stream does its i/o.
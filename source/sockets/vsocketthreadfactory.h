@@ -13,6 +13,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 /* Note that this is an abstract base class with no implementation
 besides this header file's inline declarations. */
 
+#include "vthread.h"
+
 class VSocket;
 class VSocketThread;
 class VListenerThread;
@@ -28,12 +30,12 @@ socket thread to manage an incoming connection.
 class VSocketThreadFactory {
     public:
 
-        VSocketThreadFactory() : mManager(NULL) {}
+        VSocketThreadFactory() : mManager(NULL), mThreadOptions() {}
         /**
         Constructs the factory with the optional management interface that will
         be supplied to each socket thread.
         */
-        VSocketThreadFactory(VManagementInterface* manager) : mManager(manager) {}
+        VSocketThreadFactory(VManagementInterface* manager) : mManager(manager), mThreadOptions() {}
         /**
         Destructor, declared for completeness.
         */
@@ -45,6 +47,19 @@ class VSocketThreadFactory {
         @param  manager the manager to notify, or NULL
         */
         void setManager(VManagementInterface* manager) { mManager = manager; }
+        /**
+        Sets the operating system attributes -- stack size, CPU affinity, scheduling --
+        of the threads this factory creates. Unless they are all the defaults, the
+        VListenerThread gives them to each thread it gets from createThread(), before
+        starting it, in place of any the thread was created with.
+        @param  options the thread options
+        */
+        void setThreadOptions(const VThreadOptions& options) { mThreadOptions = options; }
+        /**
+        Returns the operating system attributes of the threads this factory creates.
+        @return the thread options
+        */
+        const VThreadOptions& getThreadOptions() const { return mThreadOptions; }
 
         /**
         Creates a VSocketThread object to communicate on the specified socket.
@@ -56,7 +71,8 @@ class VSocketThreadFactory {
 
     protected:
 
-        VManagementInterface* mManager; ///< The management interface supplied to each thread.
+        VManagementInterface*   mManager;       ///< The management interface supplied to each thread.
+        VThreadOptions          mThreadOptions; ///< The operating system attributes of each thread.
 
     private:
 
@@ -101,19 +101,7 @@ bool VBinaryIOStream::readBool() {
 }
 
 void VBinaryIOStream::readString(VString& s) {
-    Vs64 length = this->readDynamicCount();
-
-    if (length > V_MAX_S32) {
-        throw VStackTraceException("String with unsupported length > 2GB encountered in stream.");
-    }
-
-    if (length == 0) { // Avoid forced allocation of a buffer if none is needed.
-        s = VString::EMPTY();
-    } else {
-        s.preflight((int) length);
-        this->readGuaranteed(s.getDataBuffer(), length);
-        s.postflight((int) length);
-    }
+    this->_readStringOfLength(s, this->readDynamicCount());
 }
 
 VString VBinaryIOStream::readString() {
@@ -191,9 +179,147 @@ VDuration VBinaryIOStream::readDuration() {
 }
 
 Vs64 VBinaryIOStream::readDynamicCount() {
-    // See comments below in writeDynamicCount for the format.
+    return this->_readDynamicCountRemainder(this->readU8());
+}
+
+bool VBinaryIOStream::tryReadS8(Vs8& value) {
+    return this->tryReadBuffer(reinterpret_cast<Vu8*>(&value), CONST_S64(1));
+}
+
+bool VBinaryIOStream::tryReadU8(Vu8& value) {
+    return this->tryReadBuffer(&value, CONST_S64(1));
+}
+
+bool VBinaryIOStream::tryReadS16(Vs16& value) {
+    Vs16 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(2))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_S16_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadU16(Vu16& value) {
+    Vu16 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(2))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_U16_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadS32(Vs32& value) {
+    Vs32 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(4))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_S32_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadInt32(int& value) {
+    Vs32 readValue;
+    if (! this->tryReadS32(readValue)) {
+        return false;
+    }
+
+    value = static_cast<int>(readValue);
+    return true;
+}
+
+bool VBinaryIOStream::tryReadU32(Vu32& value) {
+    Vu32 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(4))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_U32_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadS64(Vs64& value) {
+    Vs64 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(8))) {
+        return false;
+    }
 
-    Vu8 lengthKind = this->readU8();
+    V_BYTESWAP_NTOH_S64_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadU64(Vu64& value) {
+    Vu64 readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(8))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_U64_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadFloat(VFloat& value) {
+    VFloat readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(4))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_F_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadDouble(VDouble& value) {
+    VDouble readValue;
+    if (! this->tryReadBuffer(reinterpret_cast<Vu8*>(&readValue), CONST_S64(8))) {
+        return false;
+    }
+
+    V_BYTESWAP_NTOH_D_IN_PLACE(readValue);
+    value = readValue;
+    return true;
+}
+
+bool VBinaryIOStream::tryReadBool(bool& value) {
+    Vu8 readValue;
+    if (! this->tryReadU8(readValue)) {
+        return false;
+    }
+
+    value = (readValue != 0);
+    return true;
+}
+
+bool VBinaryIOStream::tryReadString(VString& s) {
+    Vs64 length;
+    if (! this->tryReadDynamicCount(length)) {
+        return false;
+    }
+
+    this->_readStringOfLength(s, length);
+    return true;
+}
+
+bool VBinaryIOStream::tryReadDynamicCount(Vs64& count) {
+    Vu8 lengthKind;
+    if (! this->tryReadU8(lengthKind)) {
+        return false;
+    }
+
+    count = this->_readDynamicCountRemainder(lengthKind);
+    return true;
+}
+
+Vs64 VBinaryIOStream::_readDynamicCountRemainder(Vu8 lengthKind) {
+    // See comments below in writeDynamicCount for the format.
 
     if (lengthKind == THREE_BYTE_LENGTH_INDICATOR_BYTE)
         return (Vs64) this->readU16();
@@ -205,6 +331,20 @@ Vs64 VBinaryIOStream::readDynamicCount() {
         return (Vs64) lengthKind;
 }
 
+void VBinaryIOStream::_readStringOfLength(VString& s, Vs64 length) {
+    if (length > V_MAX_S32) {
+        throw VStackTraceException("String with unsupported length > 2GB encountered in stream.");
+    }
+
+    if (length == 0) { // Avoid forced allocation of a buffer if none is needed.
+        s = VString::EMPTY();
+    } else {
+        s.preflight((int) length);
+        this->readGuaranteed(s.getDataBuffer(), length);
+        s.postflight((int) length);
+    }
+}
+
 void VBinaryIOStream::writeS8(Vs8 i) {
     Vs8 value = i;
     (void) this->write(reinterpret_cast<Vu8*>(&value), CONST_S64(1));
@@ -317,6 +317,29 @@ class VBinaryIOStream : public VIOStream {
         */
         Vs64 readDynamicCount();
 
+        /*
+        The tryRead functions read a value like the corresponding read functions, but
+        report reaching the end of the stream by returning false rather than throwing
+        VEOFException, so that a loop reading values up to the end of a file or memory
+        stream does not pay for an exception to stop. The value is unchanged if false is
+        returned. A stream that ends partway through a value is truncated, and that still
+        throws VEOFException. (For a buffer of bytes, see VIOStream::tryReadBuffer.)
+        */
+        bool tryReadS8(Vs8& value);         ///< Reads a Vs8 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadU8(Vu8& value);         ///< Reads a Vu8 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadS16(Vs16& value);       ///< Reads a Vs16 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadU16(Vu16& value);       ///< Reads a Vu16 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadS32(Vs32& value);       ///< Reads a Vs32 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadInt32(int& value);      ///< Reads a Vs32 as int unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadU32(Vu32& value);       ///< Reads a Vu32 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadS64(Vs64& value);       ///< Reads a Vs64 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadU64(Vu64& value);       ///< Reads a Vu64 unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadFloat(VFloat& value);   ///< Reads a VFloat unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadDouble(VDouble& value); ///< Reads a VDouble unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadBool(bool& value);      ///< Reads a bool unless at the end of the stream. @param value the value read @return false if at the end of the stream
+        bool tryReadString(VString& s);     ///< Reads a string written by writeString unless at the end of the stream. @param s the string read @return false if at the end of the stream
+        bool tryReadDynamicCount(Vs64& count); ///< Reads a count written by writeDynamicCount unless at the end of the stream. @param count the count read @return false if at the end of the stream
+
         /**
         Writes a signed 8-bit value to the stream.
         @param    i    the Vs8
@@ -432,6 +455,11 @@ class VBinaryIOStream : public VIOStream {
         VBinaryIOStream(const VBinaryIOStream& other);
         VBinaryIOStream& operator=(const VBinaryIOStream& other);
 
+        /** Reads the rest of a dynamic count whose first byte has been read. */
+        Vs64 _readDynamicCountRemainder(Vu8 lengthKind);
+        /** Reads the characters of a string whose length has been read. */
+        void _readStringOfLength(VString& s, Vs64 length);
+
 };
 
 #endif /* vbinaryiostream_h */
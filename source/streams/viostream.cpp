@@ -24,6 +24,20 @@ Vu8 VIOStream::readGuaranteedByte() {
     return mRawStream.readGuaranteedByte();
 }
 
+bool VIOStream::tryReadBuffer(Vu8* targetBuffer, Vs64 numBytesToRead) {
+    Vs64 numBytesRead = mRawStream.read(targetBuffer, numBytesToRead);
+
+    if (numBytesRead == numBytesToRead) {
+        return true;
+    }
+
+    if (numBytesRead == 0) {
+        return false;
+    }
+
+    throw VEOFException(VSTRING_FORMAT("VIOStream::tryReadBuffer encountered end of stream. Read " VSTRING_FORMATTER_S64 " of " VSTRING_FORMATTER_S64 " bytes.", numBytesRead, numBytesToRead));
+}
+
 Vs64 VIOStream::read(Vu8* targetBuffer, Vs64 numBytesToRead) {
     return mRawStream.read(targetBuffer, numBytesToRead);
 }
@@ -66,6 +66,18 @@ class VIOStream {
         */
         virtual Vu8 readGuaranteedByte();
         /**
+        Reads a specified number of bytes from the stream, like readGuaranteed(),
+        except that reaching the end of the stream is reported by the return value
+        rather than by throwing, so that a loop reading up to the end of a file or
+        memory stream does not pay for an exception at the end.
+        @param    targetBuffer    the buffer to read into
+        @param    numBytesToRead    the number of bytes to read
+        @return true if the bytes were read; false if the stream was already at its end
+        @throws VEOFException if the stream ends partway through the bytes, which means
+                its data is truncated
+        */
+        bool tryReadBuffer(Vu8* targetBuffer, Vs64 numBytesToRead);
+        /**
         Attempts to read a specified number of bytes from the stream.
         @param    targetBuffer    the buffer to read into
         @param    numBytesToRead    the number of bytes to read
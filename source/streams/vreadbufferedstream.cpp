@@ -0,0 +1,160 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vreadbufferedstream.h"
+
+#include "vexception.h"
+
+VReadBufferedStream::VReadBufferedStream(VStream& rawStream, Vs64 bufferSize)
+    : VStream(rawStream.getName())
+    , mRawStream(rawStream)
+    , mBufferSize(bufferSize)
+    , mBuffer(NULL)
+    , mBufferOffset(0)
+    , mBufferEOF(0)
+    {
+    if (bufferSize <= 0) {
+        throw VRangeException(VSTRING_FORMAT("VReadBufferedStream: Invalid buffer size " VSTRING_FORMATTER_S64 ".", bufferSize));
+    }
+}
+
+VReadBufferedStream::~VReadBufferedStream() {
+    delete [] mBuffer;
+}
+
+Vs64 VReadBufferedStream::read(Vu8* targetBuffer, Vs64 numBytesToRead) {
+    Vs64 numBytesRead = V_MIN(numBytesToRead, this->getNumBufferedBytes());
+
+    // First satisfy as much of the request as we can from what is already buffered.
+    if (numBytesRead > 0) {
+        VStream::copyMemory(targetBuffer, mBuffer + mBufferOffset, numBytesRead);
+        mBufferOffset += numBytesRead;
+    }
+
+    Vs64 numBytesRemaining = numBytesToRead - numBytesRead;
+
+    if (numBytesRemaining == 0) {
+        return numBytesRead;
+    }
+
+    if (numBytesRemaining >= mBufferSize) {
+        // The buffer is drained and wouldn't help with a read this size; read straight into the caller's buffer.
+        numBytesRead += mRawStream.read(targetBuffer + numBytesRead, numBytesRemaining);
+    } else {
+        this->_fillBuffer(numBytesRemaining);
+
+        Vs64 numBytesToCopy = V_MIN(numBytesRemaining, this->getNumBufferedBytes());
+        VStream::copyMemory(targetBuffer + numBytesRead, mBuffer + mBufferOffset, numBytesToCopy);
+        mBufferOffset += numBytesToCopy;
+        numBytesRead += numBytesToCopy;
+    }
+
+    return numBytesRead;
+}
+
+Vs64 VReadBufferedStream::write(const Vu8* buffer, Vs64 numBytesToWrite) {
+    return mRawStream.write(buffer, numBytesToWrite);
+}
+
+void VReadBufferedStream::flush() {
+    mRawStream.flush();
+}
+
+bool VReadBufferedStream::skip(Vs64 numBytesToSkip) {
+    Vs64 numBufferedBytesToSkip = V_MIN(numBytesToSkip, this->getNumBufferedBytes());
+    mBufferOffset += numBufferedBytesToSkip;
+
+    Vs64 numBytesRemaining = numBytesToSkip - numBufferedBytesToSkip;
+    if (numBytesRemaining == 0) {
+        return true;
+    }
+
+    return mRawStream.skip(numBytesRemaining);
+}
+
+bool VReadBufferedStream::seek(Vs64 offset, int whence) {
+    if ((whence == SEEK_CUR) && (offset >= 0)) {
+        return this->skip(offset);
+    }
+
+    // The raw stream is positioned past our buffered data, so a relative seek must account for it.
+    Vs64 rawOffset = offset;
+    if (whence == SEEK_CUR) {
+        rawOffset -= this->getNumBufferedBytes();
+    }
+
+    this->_discardBuffer();
+    return mRawStream.seek(rawOffset, whence);
+}
+
+Vs64 VReadBufferedStream::getIOOffset() const {
+    return mRawStream.getIOOffset() - this->getNumBufferedBytes();
+}
+
+Vs64 VReadBufferedStream::available() const {
+    return this->getNumBufferedBytes() + mRawStream.available();
+}
+
+Vu8* VReadBufferedStream::_getReadIOPtr() const {
+    if (mBuffer == NULL) {
+        mBuffer = VStream::newNewBuffer(mBufferSize);
+    }
+
+    return mBuffer + mBufferOffset;
+}
+
+Vs64 VReadBufferedStream::_prepareToRead(Vs64 numBytesToRead) const {
+    if (this->getNumBufferedBytes() == 0) {
+        this->_fillBuffer(V_MIN(numBytesToRead, mBufferSize));
+    }
+
+    return V_MIN(numBytesToRead, this->getNumBufferedBytes());
+}
+
+void VReadBufferedStream::_finishRead(Vs64 numBytesRead) {
+    mBufferOffset += numBytesRead;
+}
+
+Vs64 VReadBufferedStream::_writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite) {
+    return VStream::_writeFromFileToStream(mRawStream, fileDescriptor, fileOffset, numBytesToWrite);
+}
+
+void VReadBufferedStream::_fillBuffer(Vs64 minBytesNeeded) const {
+    if (mBuffer == NULL) {
+        mBuffer = VStream::newNewBuffer(mBufferSize);
+    }
+
+    // Move any unconsumed data to the front so the rest of the buffer is free.
+    Vs64 numBufferedBytes = this->getNumBufferedBytes();
+    if ((mBufferOffset != 0) && (numBufferedBytes != 0)) {
+        ::memmove(mBuffer, mBuffer + mBufferOffset, static_cast<size_t>(numBufferedBytes));
+    }
+
+    mBufferOffset = 0;
+    mBufferEOF = numBufferedBytes;
+
+    Vs64 spaceRemaining = mBufferSize - mBufferEOF;
+    Vs64 numBytesNeeded = V_MIN(minBytesNeeded - numBufferedBytes, spaceRemaining);
+    if (numBytesNeeded <= 0) {
+        return;
+    }
+
+    /*
+    Only block for what the caller needs, but take whatever else is already
+    waiting in the raw stream, so that subsequent small reads are satisfied
+    from the buffer.
+    */
+    Vs64 numBytesToRead = V_MAX(numBytesNeeded, V_MIN(mRawStream.available(), spaceRemaining));
+    mBufferEOF += mRawStream.read(mBuffer + mBufferEOF, numBytesToRead);
+}
+
+void VReadBufferedStream::_discardBuffer() {
+    mBufferOffset = 0;
+    mBufferEOF = 0;
+}
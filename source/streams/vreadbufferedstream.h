@@ -0,0 +1,172 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vreadbufferedstream_h
+#define vreadbufferedstream_h
+
+/** @file */
+
+#include "vstream.h"
+
+/**
+    @ingroup vstream_derived
+*/
+
+/**
+VReadBufferedStream is a helper class that buffers reads from an underlying
+raw stream; it is the read-side counterpart of VWriteBufferedStream. It is
+mainly intended for use with VSocketStream, where every read otherwise turns
+into a select() plus recv() on the socket. When the buffer runs dry, it is
+refilled with as much data as the raw stream says is available (up to the
+buffer size), but never blocks waiting for more than the caller actually
+asked for. So a sequence of small typed reads from a VBinaryIOStream, such
+as a message length, ID, and fields, is satisfied from memory.
+
+Writes are not buffered; they are passed straight through to the raw stream,
+so a VReadBufferedStream can be used as the single stream for a socket that
+is both read and written. The buffer itself is only allocated on the first
+read, so a stream that is only written to costs nothing extra.
+
+The stream exposes its buffer via _getReadIOPtr(), so VStream::streamCopy()
+copies out of the buffer directly without an intermediate temporary buffer.
+
+You must instantiate a raw stream and supply it to the VReadBufferedStream,
+and must not read from the raw stream directly while the VReadBufferedStream
+is in use, since data may already have been buffered.
+
+@see    VWriteBufferedStream
+@see    VSocketStream
+@see    VBinaryIOStream
+*/
+class VReadBufferedStream : public VStream {
+    public:
+
+        static const Vs64 kDefaultBufferSize = 65536;   ///< The default read buffer size.
+
+        /**
+        Constructor.
+        @param  rawStream   the stream to read from and write to
+        @param  bufferSize  the size of the read buffer
+        */
+        VReadBufferedStream(VStream& rawStream, Vs64 bufferSize = kDefaultBufferSize);
+        /**
+        Destructor.
+        */
+        virtual ~VReadBufferedStream();
+
+        /**
+        Returns the number of bytes read from the raw stream that have not yet been
+        consumed by the reader.
+        @return the number of buffered bytes
+        */
+        Vs64 getNumBufferedBytes() const { return mBufferEOF - mBufferOffset; }
+
+        // Required VStream method overrides:
+
+        /**
+        Reads from the buffer, refilling it from the raw stream as needed.
+        Reads larger than the buffer size bypass the buffer once it has been drained.
+        @param    targetBuffer    the buffer to read into
+        @param    numBytesToRead    the number of bytes to read
+        @return    the actual number of bytes that could be read
+        */
+        virtual Vs64 read(Vu8* targetBuffer, Vs64 numBytesToRead);
+        /**
+        Writes directly to the raw stream.
+        @param    buffer            the buffer containing the data
+        @param    numBytesToWrite    the number of bytes to write to the stream
+        @return the actual number of bytes written
+        */
+        virtual Vs64 write(const Vu8* buffer, Vs64 numBytesToWrite);
+        /**
+        Flushes the raw stream.
+        */
+        virtual void flush();
+        /**
+        Skips over buffered data first, and then skips in the raw stream.
+        @param    numBytesToSkip    the number of bytes to skip
+        */
+        virtual bool skip(Vs64 numBytesToSkip);
+        /**
+        Forward SEEK_CUR seeks are done by skipping. Other seeks discard the
+        buffered data and are passed through to the raw stream, with SEEK_CUR
+        adjusted for the bytes that were buffered but not consumed.
+        @param  offset  the offset (meaning depends on whence param)
+        @param  whence  SEEK_SET, SEEK_CUR, or SEEK_END
+        @return true if the seek was successful
+        */
+        virtual bool seek(Vs64 offset, int whence);
+        /**
+        Returns the raw stream's offset minus the number of buffered bytes, that is,
+        the offset as seen by the reader.
+        @return the current offset
+        */
+        virtual Vs64 getIOOffset() const;
+        /**
+        Returns the number of buffered bytes plus what the raw stream says is available.
+        @return the number of bytes currently available for reading
+        */
+        virtual Vs64 available() const;
+
+    protected:
+
+        /**
+        Returns a pointer to the unconsumed data in the buffer. Note that the
+        buffer may be empty until _prepareToRead() refills it.
+        @return    the i/o buffer pointer
+        */
+        virtual Vu8* _getReadIOPtr() const;
+        /**
+        Refills the buffer if it is empty, and returns the number of bytes that
+        can be copied out of the buffer, which may be less than requested; streamCopy()
+        will come back for more.
+        @param    numBytesToRead    the number of bytes that will be read
+        @return    the number of bytes available to read from the buffer
+        */
+        virtual Vs64 _prepareToRead(Vs64 numBytesToRead) const;
+        /**
+        Advances the buffer offset past data that was copied out of the buffer.
+        @param    numBytesRead    the number of bytes that were previously read
+        */
+        virtual void _finishRead(Vs64 numBytesRead);
+        /**
+        Writes are unbuffered, so a direct write from a file is simply passed
+        through to the raw stream.
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToWrite    the number of bytes to send
+        @return the number of bytes written, or -1 if the raw stream does not support it
+        */
+        virtual Vs64 _writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite);
+
+    private:
+
+        // Prevent copy construction and assignment since there is no provision for sharing the raw stream.
+        VReadBufferedStream(const VReadBufferedStream& other);
+        VReadBufferedStream& operator=(const VReadBufferedStream& other);
+
+        /**
+        Compacts the buffered data to the start of the buffer and reads more from the
+        raw stream, blocking until at least minBytesNeeded are buffered (or EOF).
+        Declared const because it is needed by _prepareToRead(); the buffer state is
+        mutable because it is a cache of the raw stream's data.
+        @param  minBytesNeeded  the number of buffered bytes the caller needs
+        */
+        void _fillBuffer(Vs64 minBytesNeeded) const;
+        /**
+        Discards any buffered data.
+        */
+        void _discardBuffer();
+
+        VStream&        mRawStream;     ///< The raw stream we read from and write to.
+        const Vs64      mBufferSize;    ///< The capacity of mBuffer.
+        mutable Vu8*    mBuffer;        ///< The read buffer; allocated on first read.
+        mutable Vs64    mBufferOffset;  ///< Offset of the next unconsumed byte in mBuffer.
+        mutable Vs64    mBufferEOF;     ///< Offset of the end of valid data in mBuffer.
+};
+
+#endif /* vreadbufferedstream_h */
@@ -38,8 +38,6 @@ Vu8 VStream::readGuaranteedByte() {
 
 // static
 Vs64 VStream::streamCopy(VStream& fromStream, VStream& toStream, Vs64 numBytesToCopy, Vs64 tempBufferSize) {
-    Vs64 numBytesCopied = 0;
-
     /*
     First we figure out which (if either) of the streams can give us a buffer
     pointer. Either or both of these may be NULL.
@@ -48,83 +46,82 @@ Vs64 VStream::streamCopy(VStream& fromStream, VStream& toStream, Vs64 numBytesTo
     Vu8* toBuffer = toStream._getWriteIOPtr();
 
     /*
-    If the source stream gave us a buffer to read from, we have to ask it
-    how much data it really has, so we know how much we're really going to be
-    copying.
+    If neither stream has a buffer, there's no point in the buffer-based loop
+    below. If it's a file going to a socket, the OS may be able to do the copy
+    for us; otherwise we need a temporary buffer to do the transfer.
     */
-    if (fromBuffer != NULL) {
-        numBytesToCopy = fromStream._prepareToRead(numBytesToCopy);
-    }
+    if ((fromBuffer == NULL) && (toBuffer == NULL)) {
+        Vs64 numBytesSent = VStream::_streamCopyWithSendFile(fromStream, toStream, numBytesToCopy);
+        if (numBytesSent >= 0) {
+            return numBytesSent;
+        }
 
-    /*
-    If the target stream gave us a buffer to write to, we have to ask it
-    again after first giving it a chance to expand the buffer to fit the
-    requested copy size.
-    */
-    if (toBuffer != NULL) {
-        toStream._prepareToWrite(numBytesToCopy);
-        toBuffer = toStream._getWriteIOPtr();
+        return VStream::_streamCopyWithTempBuffer(fromStream, toStream, numBytesToCopy, tempBufferSize);
     }
 
     /*
-    Now we can proceed with the copy. The matrix of possibities is the
-    two possible sources (buffer or stream) and the two possible targets
-    (buffer or stream). We handle each case optimally.
+    A buffer-based source may only be able to give us part of the requested data
+    at once; for example, a VReadBufferedStream exposes one buffer-full at a time.
+    So we keep going until we've copied everything or the source runs dry.
+    A VMemoryStream source will give us everything it has on the first pass.
     */
-    if ((fromBuffer == NULL) && (toBuffer != NULL)) {
-        // stream-to-buffer copy
-        numBytesCopied = fromStream.read(toBuffer, numBytesToCopy);
-        toStream._finishWrite(numBytesCopied);
-    } else if ((fromBuffer != NULL) && (toBuffer == NULL)) {
-        // buffer-to-stream copy
-        numBytesCopied = toStream.write(fromBuffer, numBytesToCopy);
-        fromStream._finishRead(numBytesCopied);
-    } else if ((fromBuffer != NULL) && (toBuffer != NULL)) {
-        // buffer-to-buffer copy
-        VStream::copyMemory(toBuffer, fromBuffer, numBytesToCopy);
-        numBytesCopied = numBytesToCopy;
-
-        fromStream._finishRead(numBytesCopied);
-        toStream._finishWrite(numBytesCopied);
-    } else {
+    Vs64 numBytesCopied = 0;
+    while (numBytesCopied < numBytesToCopy) {
+        Vs64 numBytesToCopyThisPass = numBytesToCopy - numBytesCopied;
+        Vs64 numBytesCopiedThisPass = 0;
+
         /*
-        Worst case scenario: direct copy between streams without their own
-        buffers, so we have to create a buffer to do the transfer.
+        If the source stream gave us a buffer to read from, we have to ask it
+        how much data it really has, so we know how much we're really going to be
+        copying. Preparing may have refilled the buffer, so get the pointer again.
         */
+        if (fromBuffer != NULL) {
+            numBytesToCopyThisPass = fromStream._prepareToRead(numBytesToCopyThisPass);
+            fromBuffer = fromStream._getReadIOPtr();
 
-        Vu8* tempBuffer;
-        Vs64 numBytesRemaining;
-        Vs64 numTempBytesToCopy;
-        Vs64 numTempBytesRead;
-        Vs64 numTempBytesWritten;
-
-        numBytesRemaining = numBytesToCopy;
-        tempBufferSize = V_MIN(numBytesToCopy, tempBufferSize);
-
-        tempBuffer = VStream::newNewBuffer(tempBufferSize);
-
-        while (numBytesRemaining > 0) {
-            numTempBytesToCopy = V_MIN(numBytesRemaining, tempBufferSize);
-
-            numTempBytesRead = fromStream.read(tempBuffer, numTempBytesToCopy);
-
-            // If we detect EOF, we're done.
-            if (numTempBytesRead == 0) {
+            if (numBytesToCopyThisPass == 0) {
                 break;
             }
+        }
 
-            numTempBytesWritten = toStream.write(tempBuffer, numTempBytesRead);
-
-            numBytesRemaining -= numTempBytesWritten;
-            numBytesCopied += numTempBytesWritten;
+        /*
+        If the target stream gave us a buffer to write to, we have to ask it
+        again after first giving it a chance to expand the buffer to fit the
+        requested copy size.
+        */
+        if (toBuffer != NULL) {
+            toStream._prepareToWrite(numBytesToCopyThisPass);
+            toBuffer = toStream._getWriteIOPtr();
+        }
 
-            // If we couldn't write any bytes, we have a problem and should stop here.
-            if (numTempBytesWritten == 0) {
-                break;
-            }
+        /*
+        Now we can proceed with the copy. The matrix of possibities is the
+        two possible sources (buffer or stream) and the two possible targets
+        (buffer or stream). We handle each case optimally.
+        */
+        if ((fromBuffer == NULL) && (toBuffer != NULL)) {
+            // stream-to-buffer copy
+            numBytesCopiedThisPass = fromStream.read(toBuffer, numBytesToCopyThisPass);
+            toStream._finishWrite(numBytesCopiedThisPass);
+        } else if ((fromBuffer != NULL) && (toBuffer == NULL)) {
+            // buffer-to-stream copy
+            numBytesCopiedThisPass = toStream.write(fromBuffer, numBytesToCopyThisPass);
+            fromStream._finishRead(numBytesCopiedThisPass);
+        } else {
+            // buffer-to-buffer copy
+            VStream::copyMemory(toBuffer, fromBuffer, numBytesToCopyThisPass);
+            numBytesCopiedThisPass = numBytesToCopyThisPass;
+
+            fromStream._finishRead(numBytesCopiedThisPass);
+            toStream._finishWrite(numBytesCopiedThisPass);
         }
 
-        delete [] tempBuffer;
+        numBytesCopied += numBytesCopiedThisPass;
+
+        // A stream source has done its whole read in one pass; and a stalled write means we should stop.
+        if ((fromBuffer == NULL) || (numBytesCopiedThisPass == 0)) {
+            break;
+        }
     }
 
     return numBytesCopied;
@@ -145,6 +142,74 @@ Vs64 VStream::streamCopy(VStream& fromStream, VIOStream& toStream, Vs64 numBytes
     return VStream::streamCopy(fromStream, toStream.getRawStream(), numBytesToCopy, tempBufferSize);
 }
 
+// static
+Vs64 VStream::_streamCopyWithTempBuffer(VStream& fromStream, VStream& toStream, Vs64 numBytesToCopy, Vs64 tempBufferSize) {
+    /*
+    Worst case scenario: direct copy between streams without their own
+    buffers, so we have to create a buffer to do the transfer.
+    */
+
+    Vu8* tempBuffer;
+    Vs64 numBytesCopied = 0;
+    Vs64 numBytesRemaining;
+    Vs64 numTempBytesToCopy;
+    Vs64 numTempBytesRead;
+    Vs64 numTempBytesWritten;
+
+    numBytesRemaining = numBytesToCopy;
+    tempBufferSize = V_MIN(numBytesToCopy, tempBufferSize);
+
+    tempBuffer = VStream::newNewBuffer(tempBufferSize);
+
+    while (numBytesRemaining > 0) {
+        numTempBytesToCopy = V_MIN(numBytesRemaining, tempBufferSize);
+
+        numTempBytesRead = fromStream.read(tempBuffer, numTempBytesToCopy);
+
+        // If we detect EOF, we're done.
+        if (numTempBytesRead == 0) {
+            break;
+        }
+
+        numTempBytesWritten = toStream.write(tempBuffer, numTempBytesRead);
+
+        numBytesRemaining -= numTempBytesWritten;
+        numBytesCopied += numTempBytesWritten;
+
+        // If we couldn't write any bytes, we have a problem and should stop here.
+        if (numTempBytesWritten == 0) {
+            break;
+        }
+    }
+
+    delete [] tempBuffer;
+
+    return numBytesCopied;
+}
+
+// static
+Vs64 VStream::_streamCopyWithSendFile(VStream& fromStream, VStream& toStream, Vs64 numBytesToCopy) {
+    int fileDescriptor = fromStream._prepareToSendFile();
+    if (fileDescriptor == -1) {
+        return -1;
+    }
+
+    Vs64 fileOffset = fromStream.getIOOffset();
+    Vs64 numBytesCopied = toStream._writeFromFile(fileDescriptor, fileOffset, numBytesToCopy);
+
+    // The send used an explicit file offset, so the source stream's offset must be moved past what was sent.
+    if (numBytesCopied > 0) {
+        (void) fromStream.seek(fileOffset + numBytesCopied, SEEK_SET);
+    }
+
+    return numBytesCopied;
+}
+
+// static
+Vs64 VStream::_writeFromFileToStream(VStream& toStream, int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite) {
+    return toStream._writeFromFile(fileDescriptor, fileOffset, numBytesToWrite);
+}
+
 // static
 bool VStream::needSizeConversion(Vs64 sizeValue) {
     return ((sizeValue > V_MAX_S32) && (sizeof(Vs64) != sizeof(size_t)));
@@ -240,3 +305,13 @@ void VStream::_finishWrite(Vs64 /*numBytesWritten*/) {
     // To be overridden by memory-based streams.
 }
 
+int VStream::_prepareToSendFile() {
+    // To be overridden by file-descriptor-based streams.
+    return -1;
+}
+
+Vs64 VStream::_writeFromFile(int /*fileDescriptor*/, Vs64 /*fileOffset*/, Vs64 /*numBytesToWrite*/) {
+    // To be overridden by streams that can send directly from a file, such as socket streams.
+    return -1;
+}
+
@@ -35,7 +35,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
     bytes. You'll instantiate either a VBufferedFileStream, VDirectIOFileStream,
     VSocketStream, or VMemoryStream, either directly or indirectly. In
     addition, the class VWriteBufferedStream lets you buffer writes to a
-    stream such as VSocketStream that doesn't buffer data on its own.
+    stream such as VSocketStream that doesn't buffer data on its own, and
+    the class VReadBufferedStream does the same for reads.
     VMemoryStream uses a memory buffer to hold the stream data; you don't have
     to worry about writing past the end of the buffer: it expands as
     necessary. Regarding VBufferedFileStream vs. VDirectIOFileStream, you should
@@ -75,7 +76,11 @@ License: MIT. See LICENSE.md in the Vault top level directory.
     streams (file and socket) and a temporary buffer will be used to
     perform the copy without requiring you to deal with the details (although
     you may specify the buffer size explicitly if the default size is not
-    ideal).
+    ideal). When a file stream is copied to a socket stream, the copy is
+    done by the OS with sendfile() where available, so the data is never
+    read into user space at all. For socket input, wrapping the VSocketStream in a VReadBufferedStream
+    avoids a socket read for every small typed read, and lets streamCopy copy
+    directly out of its buffer.
 
     The semantics of stream copying are simple: the source is read
     and the destination is written. So the stream position moves as
@@ -342,9 +347,10 @@ class VStream {
         toStream is a VSocketStream).
 
         If either of the streams is a VMemoryStream, the copy is made
-        directly with no extra copying. If neither stream is a VMemoryStream,
-        a temporary buffer is used to transfer the data with just a single
-        copy.
+        directly with no extra copying. The same is true of a VReadBufferedStream
+        source, whose buffer is copied from (and refilled) as many times as needed.
+        If neither stream has a buffer, a temporary buffer is used to transfer the
+        data with just a single copy.
 
         Of course, this method does not actually know the stream classes,
         but simply asks the to and from streams about their capabilities.
@@ -361,6 +367,7 @@ class VStream {
         static Vs64 streamCopy(VStream& fromStream, VIOStream& toStream, Vs64 numBytesToCopy, Vs64 tempBufferSize = 16384);
 
         friend class VWriteBufferedStream;
+        friend class VTextIOStream; // readLine() scans the raw stream's read buffer directly
 
         /**
         Returns the name of the stream that it was given when constructed.
@@ -465,6 +472,63 @@ class VStream {
         */
         virtual void    _finishWrite(Vs64 numBytesWritten);
 
+        /*
+        These methods are ONLY overridden by file-descriptor-based streams
+        and by streams that can send directly from a file descriptor. They let
+        streamCopy() have the OS copy from a file to a socket (via sendfile())
+        without the data passing through user space at all.
+        */
+
+        /**
+        Returns a file descriptor that can be read from starting at the stream's
+        current i/o offset, or -1 if the stream is not backed by a file descriptor
+        (the default). A stream that buffers writes must flush them first, so that
+        the file contents are up to date.
+        @return    a readable file descriptor, or -1
+        */
+        virtual int _prepareToSendFile();
+        /**
+        Writes data to the stream directly from a file descriptor, if the stream
+        supports it; the default implementation does not and returns -1, in which
+        case nothing has been written and streamCopy() falls back to read() and
+        write(). The file descriptor's own offset is neither used nor changed.
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToWrite    the number of bytes to send
+        @return the number of bytes written (fewer than requested only at end of file), or -1 if not supported
+        */
+        virtual Vs64 _writeFromFile(int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite);
+        /**
+        Lets a stream that wraps another stream pass _writeFromFile() through to it.
+        @param    toStream        the stream to write to
+        @param    fileDescriptor    the file to send data from
+        @param    fileOffset        the offset in the file of the first byte to send
+        @param    numBytesToWrite    the number of bytes to send
+        @return the number of bytes written, or -1 if not supported
+        */
+        static Vs64 _writeFromFileToStream(VStream& toStream, int fileDescriptor, Vs64 fileOffset, Vs64 numBytesToWrite);
+
+        /**
+        Copies between two streams that do not have buffers, using a temporary buffer.
+        This is the fallback case of streamCopy().
+        @param    fromStream    the source stream that is read
+        @param    toStream    the target stream that is written
+        @param    numBytesToCopy    the number of bytes read from fromStream and write to toStream
+        @param    tempBufferSize    the size of temporary buffer to create
+        @return the actual number of bytes copied
+        */
+        static Vs64 _streamCopyWithTempBuffer(VStream& fromStream, VStream& toStream, Vs64 numBytesToCopy, Vs64 tempBufferSize);
+        /**
+        Copies from a file-descriptor-based stream to a stream that can write from a
+        file descriptor, such as a file stream to a socket stream, and then advances
+        the source stream's i/o offset past the copied data.
+        @param    fromStream    the source stream that is read
+        @param    toStream    the target stream that is written
+        @param    numBytesToCopy    the number of bytes read from fromStream and write to toStream
+        @return the actual number of bytes copied, or -1 if the streams do not support this
+        */
+        static Vs64 _streamCopyWithSendFile(VStream& fromStream, VStream& toStream, Vs64 numBytesToCopy);
+
         VString mName; ///< A name for use when debugging stream.
 };
 
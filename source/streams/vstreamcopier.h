@@ -37,6 +37,8 @@ the copy iteratively, in chunks. This is useful if you need to monitor the
 progress of a large copy. An example is when you are providing user feedback
 and want to update the progress. If you were to just use streamCopy() in a
 single call, you'd not be able to see the progress until the copy is complete.
+Each chunk is copied with streamCopy(), so a file-to-socket copy still gets
+the sendfile() path chunk by chunk.
 
 You can supply any pair of streams in the constructor, either VStream-based
 or VIOStream-based, in any combination. You also supply the chunk size.
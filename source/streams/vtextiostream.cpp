@@ -28,14 +28,42 @@ VTextIOStream::VTextIOStream(VStream& rawStream, int lineEndingsWriteKind) :
     this->setLineEndingsKind(lineEndingsWriteKind); // install the line ending data to be written
 }
 
+// Longest span we scan with memchr() at once, so that a buffer with no LF (e.g. Mac line endings) isn't re-scanned to its end for every line.
+static const Vs64 kMaxLineScanLength = 65536;
+
 void VTextIOStream::readLine(VString& s, bool includeLineEnding) {
-    // Note: We append char-by-char, but VString should already be optimized to
-    // avoid actually re-allocating its buffer for each single-char expansion.
+    if (! this->tryReadLine(s, includeLineEnding)) {
+        throw VEOFException("EOF");
+    }
+}
 
+bool VTextIOStream::tryReadLine(VString& s, bool includeLineEnding) {
     mLineBuffer = VString::EMPTY();
 
+    /*
+    If the raw stream has its own read buffer (a memory stream, a mapped file, or
+    a VReadBufferedStream), we can scan the buffer for the line ending and append
+    whole spans of the line at once. Otherwise we have to go one code point at a time.
+    */
+    bool gotLine;
+    if (mRawStream._getReadIOPtr() != NULL) {
+        gotLine = this->_readLineFromBuffer(includeLineEnding);
+    } else {
+        gotLine = this->_readLineByCodePoint(includeLineEnding);
+    }
+
+    if (gotLine) {
+        s = mLineBuffer;
+    }
+
+    return gotLine;
+}
+
+bool VTextIOStream::_readLineByCodePoint(bool includeLineEnding) {
+    // Note: We append char-by-char, but VString should already be optimized to
+    // avoid actually re-allocating its buffer for each single-char expansion.
+
     bool        readFirstByteOfLine = false;
-    Vs64        numBytesToRead = 1;
     Vs64        numBytesRead;
     VCodePoint  c(0);
     bool        done = false;
@@ -44,7 +72,6 @@ void VTextIOStream::readLine(VString& s, bool includeLineEnding) {
         if (mPendingCharacter.isNotNull()) {
             c = mPendingCharacter;
             mPendingCharacter = VCodePoint(0);
-            numBytesRead = 1;
         } else {
             if (this->available() == 0) {
                 numBytesRead = 0;
@@ -53,69 +80,255 @@ void VTextIOStream::readLine(VString& s, bool includeLineEnding) {
                 numBytesRead = c.getUTF8Length();
             }
 
-            // Throw EOF if we fail reading very first byte of line.
-            // Otherwise, we'll return whatever we read, and throw next time.
+            // Report EOF if we fail reading very first byte of line.
+            // Otherwise, we'll return whatever we read, and report EOF next time.
             if (numBytesRead == 0) {
                 if (readFirstByteOfLine) {
                     break; // this line is done
                 } else {
-                    throw VEOFException("EOF");
+                    return false;
                 }
             }
 
             readFirstByteOfLine = true;
         }
 
-        switch (mReadState) {
-            case kReadStateReady:
+        done = this->_processLineCodePoint(c, includeLineEnding);
+
+    } while (! done);
+
+    return true;
+}
+
+bool VTextIOStream::_readLineFromBuffer(bool includeLineEnding) {
+    bool readFirstByteOfLine = false;
+
+    if (mPendingCharacter.isNotNull()) {
+        VCodePoint c = mPendingCharacter;
+        mPendingCharacter = VCodePoint(0);
+        readFirstByteOfLine = true;
+
+        if (this->_processLineCodePoint(c, includeLineEnding)) {
+            return true;
+        }
+    }
+
+    for (;;) {
+        // Like the code point reader, we only consume what the stream says is available, so we never block.
+        Vs64 numBytesAvailable = this->available();
+        if (numBytesAvailable != 0) {
+            numBytesAvailable = mRawStream._prepareToRead(numBytesAvailable);
+        }
+
+        // Report EOF if we fail reading very first byte of line.
+        // Otherwise, we'll return whatever we read, and report EOF next time.
+        if (numBytesAvailable == 0) {
+            if (readFirstByteOfLine) {
+                break; // this line is done
+            } else {
+                return false;
+            }
+        }
+
+        readFirstByteOfLine = true;
+        const Vu8* buffer = mRawStream._getReadIOPtr();
+
+        if (mReadState == kReadStateGot0x0D) {
+            /*
+            The byte after a 0x0D decides whether it was a DOS or Mac line ending.
+            If it's not 0x0A, the state machine keeps it as the pending character,
+            so read it as a code point the usual way.
+            */
+            if (buffer[0] == 0x0A) {
+                mRawStream._finishRead(1);
+                (void) this->_processLineCodePoint(VCodePoint(0x0A), includeLineEnding);
+            } else {
+                (void) this->_processLineCodePoint(this->readUTF8CodePoint(), includeLineEnding);
+            }
+
+            break;
+        }
+
+        Vs64 numBytesToScan = V_MIN(numBytesAvailable, kMaxLineScanLength);
+        const Vu8* lineEnd = static_cast<const Vu8*>(::memchr(buffer, 0x0A, static_cast<size_t>(numBytesToScan)));
+        Vs64 numBytesBeforeLineEnd = (lineEnd == NULL) ? numBytesToScan : (lineEnd - buffer);
+        const Vu8* carriageReturn = static_cast<const Vu8*>(::memchr(buffer, 0x0D, static_cast<size_t>(numBytesBeforeLineEnd)));
+        if (carriageReturn != NULL) {
+            lineEnd = carriageReturn;
+            numBytesBeforeLineEnd = carriageReturn - buffer;
+        }
+
+        this->_appendLineBytes(buffer, numBytesBeforeLineEnd);
+
+        if (lineEnd == NULL) {
+            mRawStream._finishRead(numBytesBeforeLineEnd);
+            continue; // no line ending yet; keep scanning
+        }
+
+        VCodePoint lineEndChar(static_cast<int>(*lineEnd));
+        mRawStream._finishRead(numBytesBeforeLineEnd + 1);
+        if (this->_processLineCodePoint(lineEndChar, includeLineEnding)) {
+            break;
+        }
+
+        // We got a 0x0D, so we go around again to see whether the line ending is DOS or Mac.
+    }
+
+    this->_validateLineBuffer();
+    return true;
+}
 
-                if (c == 0x0A) {  // found a Unix line end
-                    if (includeLineEnding) {
-                        mLineBuffer += c;
-                    }
+bool VTextIOStream::_processLineCodePoint(const VCodePoint& c, bool includeLineEnding) {
+    bool done = false;
 
-                    done = true;    // done, bail out and return the string
+    switch (mReadState) {
+        case kReadStateReady:
 
-                    this->_updateLineEndingsReadKind(kLineEndingsUnix);
-                } else if (c == 0x0D) { // found a Mac line end, or 1st byte of a DOS line end
-                    mReadState = kReadStateGot0x0D;
-                } else { // found a normal character
+            if (c == 0x0A) {  // found a Unix line end
+                if (includeLineEnding) {
                     mLineBuffer += c;
                 }
 
-                break;
-
-            case kReadStateGot0x0D:
+                done = true;    // done, bail out and return the string
 
-                if (c == 0x0A) {  // found a DOS line end
-                    if (includeLineEnding) {
-                        mLineBuffer += VCodePoint(0x0D);
-                        mLineBuffer += VCodePoint(0x0A);
-                    }
+                this->_updateLineEndingsReadKind(kLineEndingsUnix);
+            } else if (c == 0x0D) { // found a Mac line end, or 1st byte of a DOS line end
+                mReadState = kReadStateGot0x0D;
+            } else { // found a normal character
+                mLineBuffer += c;
+            }
 
-                    mReadState = kReadStateReady;
-                    done = true;    // done, bail out and return the string
+            break;
 
-                    this->_updateLineEndingsReadKind(kLineEndingsDOS);
-                } else { // found a normal character, so we have a Mac line end pending
-                    if (includeLineEnding) {
-                        mLineBuffer += VCodePoint(0x0D);
-                    }
+        case kReadStateGot0x0D:
 
-                    mPendingCharacter = c;
+            if (c == 0x0A) {  // found a DOS line end
+                if (includeLineEnding) {
+                    mLineBuffer += VCodePoint(0x0D);
+                    mLineBuffer += VCodePoint(0x0A);
+                }
 
-                    mReadState = kReadStateReady;
-                    done = true;
+                mReadState = kReadStateReady;
+                done = true;    // done, bail out and return the string
 
-                    this->_updateLineEndingsReadKind(kLineEndingsMac);
+                this->_updateLineEndingsReadKind(kLineEndingsDOS);
+            } else { // found a normal character, so we have a Mac line end pending
+                if (includeLineEnding) {
+                    mLineBuffer += VCodePoint(0x0D);
                 }
 
-                break;
+                mPendingCharacter = c;
+
+                mReadState = kReadStateReady;
+                done = true;
+
+                this->_updateLineEndingsReadKind(kLineEndingsMac);
+            }
+
+            break;
+    }
+
+    return done;
+}
+
+void VTextIOStream::_appendLineBytes(const Vu8* bytes, Vs64 numBytes) {
+    if (numBytes == 0) {
+        return;
+    }
+
+    int lineLength = mLineBuffer.length();
+    int newLineLength = lineLength + static_cast<int>(numBytes);
+    mLineBuffer.preflight(newLineLength);
+    VStream::copyMemory(mLineBuffer.getDataBuffer() + lineLength, bytes, numBytes);
+    mLineBuffer.postflight(newLineLength);
+}
+
+void VTextIOStream::_validateLineBuffer() {
+    if (VTextIOStream::_isWellFormedUTF8(mLineBuffer.getDataBufferConst(), mLineBuffer.length())) {
+        return;
+    }
+
+    /*
+    Rare case: the bytes we appended are not well-formed UTF-8. Decode them one
+    code point at a time, exactly as the code point reader would have, so that
+    both readers produce the same string from the same input. A sequence that is
+    truncated by the end of the line is kept as individual bytes.
+    */
+    VString rawLine = mLineBuffer;
+    const Vu8* bytes = rawLine.getDataBufferConst();
+    int length = rawLine.length();
+    mLineBuffer = VString::EMPTY();
+
+    int offset = 0;
+    while (offset < length) {
+        int codePointLength = VCodePoint::getUTF8LengthFromUTF8StartByte(bytes[offset]);
+        if (offset + codePointLength > length) {
+            mLineBuffer += VCodePoint(static_cast<int>(bytes[offset]));
+            ++offset;
+        } else {
+            mLineBuffer += VCodePoint(bytes, offset);
+            offset += codePointLength;
+        }
+    }
+}
+
+// static
+bool VTextIOStream::_isWellFormedUTF8(const Vu8* bytes, int length) {
+    /*
+    "Well-formed" here means the bytes would be reproduced exactly by decoding
+    them into code points and re-encoding them, which is what the code point
+    reader does. So besides malformed sequences, we reject overlong encodings
+    and NUL, which would not survive the round trip.
+    */
+    int offset = 0;
+    while (offset < length) {
+        Vu8 b = bytes[offset];
+
+        if ((b < 0x80) && (b != 0x00)) {
+            ++offset;
+            continue;
+        }
+
+        int codePointLength;
+        Vu8 minSecondByte = 0x80;
+        Vu8 maxSecondByte = 0xBF;
+
+        if ((b >= 0xC2) && (b <= 0xDF)) {
+            codePointLength = 2;
+        } else if ((b >= 0xE0) && (b <= 0xEF)) {
+            codePointLength = 3;
+            if (b == 0xE0) {
+                minSecondByte = 0xA0;
+            }
+        } else if ((b >= 0xF0) && (b <= 0xF4)) {
+            codePointLength = 4;
+            if (b == 0xF0) {
+                minSecondByte = 0x90;
+            } else if (b == 0xF4) {
+                maxSecondByte = 0x8F;
+            }
+        } else {
+            return false; // NUL, continuation byte without a start byte, overlong 2-byte start, or out of range
+        }
+
+        if (offset + codePointLength > length) {
+            return false;
+        }
+
+        if ((bytes[offset + 1] < minSecondByte) || (bytes[offset + 1] > maxSecondByte)) {
+            return false;
         }
 
-    } while ((numBytesRead == numBytesToRead) && !done);
+        for (int i = 2; i < codePointLength; ++i) {
+            if ((bytes[offset + i] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
 
-    s = mLineBuffer;
+        offset += codePointLength;
+    }
+
+    return true;
 }
 
 VCodePoint VTextIOStream::readUTF8CodePoint() {
@@ -132,23 +345,17 @@ VChar VTextIOStream::readCharacterByte() {
 }
 
 void VTextIOStream::readAll(VString& s, bool includeLineEndings) {
-    try {
-        VString line;
-        for (;;) {
-            this->readLine(line, includeLineEndings);
-            s += line;
-        }
-    } catch (const VEOFException&) {}
+    VString line;
+    while (this->tryReadLine(line, includeLineEndings)) {
+        s += line;
+    }
 }
 
 void VTextIOStream::readAll(VStringVector& lines) {
-    try {
-        VString line;
-        for (;;) {
-            this->readLine(line);
-            lines.push_back(line);
-        }
-    } catch (const VEOFException&) {}
+    VString line;
+    while (this->tryReadLine(line)) {
+        lines.push_back(line);
+    }
 }
 
 void VTextIOStream::writeLine(const VString& s) {
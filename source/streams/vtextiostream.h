@@ -75,6 +75,17 @@ class VTextIOStream : public VIOStream {
                                     to be included in the string that is returned
         */
         void readLine(VString& s, bool includeLineEnding = false);
+        /**
+        Like readLine(), but reports EOF by returning false instead of throwing, so
+        that a loop over every line of a stream does not end in an exception. If
+        false is returned, s is left unchanged.
+
+        @param    s                    a VString to format
+        @param    includeLineEnding    true if you want the line ending character(s)
+                                    to be included in the string that is returned
+        @return    true if a line was read; false if the stream was at EOF
+        */
+        bool tryReadLine(VString& s, bool includeLineEnding = false);
 
         /**
         Reads the next code point (1 to 4 bytes) from the stream, even if it is part
@@ -175,6 +186,18 @@ class VTextIOStream : public VIOStream {
 
     private:
 
+        /** Implements tryReadLine() by reading one code point at a time from the stream. Returns false at EOF. */
+        bool _readLineByCodePoint(bool includeLineEnding);
+        /** Implements tryReadLine() by scanning the raw stream's read buffer for the line ending and appending whole spans. Returns false at EOF. */
+        bool _readLineFromBuffer(bool includeLineEnding);
+        /** Runs the line ending state machine on a code point; returns true if it completes the line. */
+        bool _processLineCodePoint(const VCodePoint& c, bool includeLineEnding);
+        /** Appends raw bytes to mLineBuffer; _validateLineBuffer() must be called once the line is complete. */
+        void _appendLineBytes(const Vu8* bytes, Vs64 numBytes);
+        /** Re-decodes mLineBuffer by code point if the raw bytes appended to it are not well-formed UTF-8. */
+        void _validateLineBuffer();
+        /** Returns true if the bytes are well-formed UTF-8 that decodes and re-encodes to the same bytes. */
+        static bool _isWellFormedUTF8(const Vu8* bytes, int length);
         /** Updates the mLineEndingsReadKind based on the kind of line ending just detected. */
         void _updateLineEndingsReadKind(int lineEndingKind);
 
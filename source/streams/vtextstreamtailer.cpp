@@ -62,8 +62,11 @@ void VTailRunnerThread::run() {
     while (this->isRunning()) {
         try {
             if (mProcessByLine) {
-                mInputStream->readLine(line);
-                mHandler.processLine(line);
+                if (mInputStream->tryReadLine(line)) {
+                    mHandler.processLine(line);
+                } else {
+                    VThread::sleep(mSleepDuration);
+                }
             } else {
                 VCodePoint c = mInputStream->readUTF8CodePoint();
                 mHandler.processCodePoint(c);
@@ -116,6 +119,7 @@ Vu8 VTailRunnerTextInputStream::readGuaranteedByte() {
 
 VTextTailRunner::VTextTailRunner(VStream& inputStream, VTailHandler& handler, bool processByLine, VDuration sleepDuration, const VString& loggerName)
     : mInputFileStream()
+    , mBufferedInputFileStream(mInputFileStream)
     , mInputStream(new VTailRunnerTextInputStream(this, inputStream, sleepDuration))
     , mHandler(handler)
     , mProcessByLine(processByLine)
@@ -128,6 +132,7 @@ VTextTailRunner::VTextTailRunner(VStream& inputStream, VTailHandler& handler, bo
 
 VTextTailRunner::VTextTailRunner(const VFSNode& inputFile, VTailHandler& handler, bool processByLine, VDuration sleepDuration, const VString& loggerName)
     : mInputFileStream(inputFile)
+    , mBufferedInputFileStream(mInputFileStream)
     , mInputStream()
     , mHandler(handler)
     , mProcessByLine(processByLine)
@@ -139,7 +144,7 @@ VTextTailRunner::VTextTailRunner(const VFSNode& inputFile, VTailHandler& handler
     mInputFileStream.openReadOnly();
     mInputFileStream.seek0();
     
-    mInputStream = VTailRunnerTextInputStreamPtr(new VTailRunnerTextInputStream(this, mInputFileStream, sleepDuration));
+    mInputStream = VTailRunnerTextInputStreamPtr(new VTailRunnerTextInputStream(this, mBufferedInputFileStream, sleepDuration));
 }
 
 VTextTailRunner::~VTextTailRunner() {
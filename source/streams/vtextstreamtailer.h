@@ -13,6 +13,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vtextiostream.h"
 #include "vthread.h"
 #include "vmutexlocker.h"
+#include "vreadbufferedstream.h"
 
 /**
     @ingroup viostream_derived
@@ -99,6 +100,7 @@ class VTextTailRunner {
     private:
     
         VBufferedFileStream             mInputFileStream;   ///< The file stream, if VFSNode constructor form was used.
+        VReadBufferedStream             mBufferedInputFileStream; ///< Buffers mInputFileStream so that lines are read a block at a time.
         VTailRunnerTextInputStreamPtr   mInputStream;       ///< The input stream, either as supplied or for the file.
         VTailHandler&                   mHandler;           ///< The handler to be called with each line or code point tailed.
         bool                            mProcessByLine;     ///< True if we are tailing line-by-line, vs. by code point.
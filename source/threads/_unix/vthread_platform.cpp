@@ -11,6 +11,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vtypes_internal_platform.h"
 
 #include "vmutex.h"
+#include "vreadwritelock.h"
+#include "vcountingsemaphore.h"
 #include "vsemaphore.h"
 #include "vlogger.h"
 #include "vinstant.h"
@@ -18,11 +20,14 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sched.h>
 
 // VThread platform-specific functions ---------------------------------------
 
 // static
-void VThread::threadCreate(VThreadID_Type* threadID, bool createDetached, threadMainFunction threadMainProcPtr, void* threadArgument) {
+void VThread::threadCreate(VThreadID_Type* threadID, bool createDetached, size_t stackSize, threadMainFunction threadMainProcPtr, void* threadArgument) {
     int             result;
     pthread_attr_t  threadAttributes;
 
@@ -38,6 +43,19 @@ void VThread::threadCreate(VThreadID_Type* threadID, bool createDetached, thread
         throw VStackTraceException(VSystemError(result), "VThread::threadCreate: pthread_attr_setdetachstate() failed.");
     }
 
+    if (stackSize != 0) {
+        // The size must be at least PTHREAD_STACK_MIN, and some platforms require a multiple of the page size.
+        size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        stackSize = V_MAX(stackSize, static_cast<size_t>(PTHREAD_STACK_MIN));
+        stackSize = ((stackSize + pageSize - 1) / pageSize) * pageSize;
+        result = ::pthread_attr_setstacksize(&threadAttributes, stackSize);
+
+        if (result != 0) {
+            (void) ::pthread_attr_destroy(&threadAttributes);
+            throw VStackTraceException(VSystemError(result), VSTRING_FORMAT("VThread::threadCreate: pthread_attr_setstacksize(" VSTRING_FORMATTER_S64 ") failed.", static_cast<Vs64>(stackSize)));
+        }
+    }
+
     result = ::pthread_create(threadID, &threadAttributes, threadMainProcPtr, threadArgument);
 
     if (result != 0) {
@@ -50,17 +68,24 @@ void VThread::threadCreate(VThreadID_Type* threadID, bool createDetached, thread
 }
 
 // static
-#ifdef VTHREAD_PTHREAD_SETNAME_SUPPORTED
 void VThread::_threadStarting(const VThread* thread) {
+#ifdef VTHREAD_PTHREAD_SETNAME_SUPPORTED
     // This API lets us associate our thread name with the native thread resource, so that debugger/crashdump/instruments etc. can see our thread name.
     (void)/*int result =*/ ::pthread_setname_np(thread->getName()); // "np" indicates API is non-POSIX
-}
-#else
-void VThread::_threadStarting(const VThread* /*thread*/) {
-    // Nothing to do if pthread_setname_np() is not available.
-}
 #endif
 
+    // The thread runs regardless if an option cannot be applied; most likely it needs a privilege we don't have.
+    const VThreadOptions& options = thread->getOptions();
+
+    if ((options.getCPUAffinityMask() != 0) && ! VThread::setCurrentThreadAffinityMask(options.getCPUAffinityMask())) {
+        VLOGGER_NAMED_WARN(thread->getLoggerName(), VSTRING_FORMAT("[%s] VThread: Unable to set CPU affinity mask 0x%llX.", thread->getName().chars(), options.getCPUAffinityMask()));
+    }
+
+    if ((options.getSchedulingPolicy() != VThreadOptions::kSchedulingDefault) && ! VThread::setCurrentThreadScheduling(options.getSchedulingPolicy(), options.getSchedulingPriority())) {
+        VLOGGER_NAMED_WARN(thread->getLoggerName(), VSTRING_FORMAT("[%s] VThread: Unable to set scheduling policy %d priority %d.", thread->getName().chars(), (int) options.getSchedulingPolicy(), options.getSchedulingPriority()));
+    }
+}
+
 // static
 void VThread::_threadEnded(const VThread* /*thread*/) {
     // Nothing to do for unix version.
@@ -91,6 +116,75 @@ bool VThread::setPriority(int nice) {
     return (::setpriority(PRIO_PROCESS, 0, nice) == 0);
 }
 
+// static
+bool VThread::setCurrentThreadAffinity(int cpuIndex) {
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpuIndex, &cpuSet);
+    return (::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet) == 0);
+#else
+    return false; // Mac OS X only offers affinity "tags" as hints, not binding.
+#endif
+}
+
+// static
+bool VThread::setCurrentThreadAffinityMask(Vu64 cpuAffinityMask) {
+#ifdef __linux__
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpuIndex = 0; cpuIndex < 64; ++cpuIndex) {
+        if ((cpuAffinityMask & (CONST_U64(1) << cpuIndex)) != 0) {
+            CPU_SET(cpuIndex, &cpuSet);
+        }
+    }
+
+    return (::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet) == 0);
+#else
+    (void) cpuAffinityMask;
+    return false; // Mac OS X only offers affinity "tags" as hints, not binding.
+#endif
+}
+
+// static
+bool VThread::setCurrentThreadScheduling(VThreadOptions::SchedulingPolicy policy, int priority) {
+    int nativePolicy;
+    switch (policy) {
+        case VThreadOptions::kSchedulingDefault:
+            nativePolicy = SCHED_OTHER;
+            priority = 0;
+            break;
+#ifdef __linux__
+        case VThreadOptions::kSchedulingBatch:
+            nativePolicy = SCHED_BATCH;
+            priority = 0;
+            break;
+        case VThreadOptions::kSchedulingIdle:
+            nativePolicy = SCHED_IDLE;
+            priority = 0;
+            break;
+#endif
+        case VThreadOptions::kSchedulingFIFO:
+            nativePolicy = SCHED_FIFO;
+            break;
+        case VThreadOptions::kSchedulingRoundRobin:
+            nativePolicy = SCHED_RR;
+            break;
+        default:
+            return false;
+    }
+
+    struct sched_param schedulingParameters;
+    schedulingParameters.sched_priority = priority;
+    return (::pthread_setschedparam(::pthread_self(), nativePolicy, &schedulingParameters) == 0);
+}
+
+// static
+int VThread::getNumberOfProcessors() {
+    long numProcessors = ::sysconf(_SC_NPROCESSORS_ONLN);
+    return (numProcessors < 1) ? 1 : static_cast<int>(numProcessors);
+}
+
 // static
 void VThread::sleep(const VDuration& interval) {
     int milliseconds = static_cast<int>(interval.getDurationMilliseconds());
@@ -129,16 +223,104 @@ bool VMutex::mutexLock(VMutex_Type* mutex) {
     return (::pthread_mutex_lock(mutex) == 0);
 }
 
+// static
+bool VMutex::mutexTryLock(VMutex_Type* mutex) {
+    return (::pthread_mutex_trylock(mutex) == 0);
+}
+
 // static
 bool VMutex::mutexUnlock(VMutex_Type* mutex) {
     return (::pthread_mutex_unlock(mutex) == 0);
 }
 
+// VReadWriteLock platform-specific functions --------------------------------
+
+// static
+bool VReadWriteLock::readWriteLockInit(VReadWriteLock_Type* lock) {
+    return (::pthread_rwlock_init(lock, NULL) == 0);
+}
+
+// static
+void VReadWriteLock::readWriteLockDestroy(VReadWriteLock_Type* lock) {
+    (void) ::pthread_rwlock_destroy(lock);
+}
+
+// static
+bool VReadWriteLock::readLock(VReadWriteLock_Type* lock) {
+    return (::pthread_rwlock_rdlock(lock) == 0);
+}
+
+// static
+bool VReadWriteLock::readUnlock(VReadWriteLock_Type* lock) {
+    return (::pthread_rwlock_unlock(lock) == 0);
+}
+
+// static
+bool VReadWriteLock::writeLock(VReadWriteLock_Type* lock) {
+    return (::pthread_rwlock_wrlock(lock) == 0);
+}
+
+// static
+bool VReadWriteLock::writeUnlock(VReadWriteLock_Type* lock) {
+    return (::pthread_rwlock_unlock(lock) == 0);
+}
+
 // VSemaphore platform-specific functions ------------------------------------
 
+/*
+Timed waits on condition variables are measured on CLOCK_MONOTONIC, not on the wall clock,
+so that setting the wall clock -- by NTP, an administrator, or VInstant's simulated clock
+offset -- neither stretches a wait nor cuts it short. Mac OS X has no
+pthread_condattr_setclock(), but has a relative timed wait, which is just as good.
+*/
+#ifdef VPLATFORM_MAC
+    #define VTHREAD_CONDITION_RELATIVE_WAIT
+#endif
+
+static bool _initMonotonicCondition(pthread_cond_t* condition) {
+#ifdef VTHREAD_CONDITION_RELATIVE_WAIT
+    return (pthread_cond_init(condition, NULL) == 0);
+#else
+    pthread_condattr_t conditionAttributes;
+    if (pthread_condattr_init(&conditionAttributes) != 0) {
+        return false;
+    }
+
+    bool success = (pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC) == 0) && (pthread_cond_init(condition, &conditionAttributes) == 0);
+    (void) pthread_condattr_destroy(&conditionAttributes);
+    return success;
+#endif
+}
+
+// Returns the CLOCK_MONOTONIC time in nanoseconds, for computing deadlines for _monotonicTimedWait().
+static Vs64 _getMonotonicNanoseconds() {
+    struct timespec now;
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<Vs64>(now.tv_sec) * CONST_S64(1000000000)) + static_cast<Vs64>(now.tv_nsec);
+}
+
+// Waits on a condition initialized by _initMonotonicCondition() until a deadline from _getMonotonicNanoseconds().
+static int _monotonicTimedWait(pthread_cond_t* condition, pthread_mutex_t* mutex, Vs64 deadlineNanoseconds) {
+    struct timespec timeoutSpec;
+#ifdef VTHREAD_CONDITION_RELATIVE_WAIT
+    Vs64 remainingNanoseconds = deadlineNanoseconds - _getMonotonicNanoseconds();
+    if (remainingNanoseconds <= 0) {
+        return ETIMEDOUT;
+    }
+
+    timeoutSpec.tv_sec = static_cast<time_t>(remainingNanoseconds / CONST_S64(1000000000));
+    timeoutSpec.tv_nsec = static_cast<long>(remainingNanoseconds % CONST_S64(1000000000));
+    return pthread_cond_timedwait_relative_np(condition, mutex, &timeoutSpec);
+#else
+    timeoutSpec.tv_sec = static_cast<time_t>(deadlineNanoseconds / CONST_S64(1000000000));
+    timeoutSpec.tv_nsec = static_cast<long>(deadlineNanoseconds % CONST_S64(1000000000));
+    return pthread_cond_timedwait(condition, mutex, &timeoutSpec);
+#endif
+}
+
 // static
 bool VSemaphore::semaphoreInit(VSemaphore_Type* semaphore) {
-    return (pthread_cond_init(semaphore, NULL) == 0);
+    return _initMonotonicCondition(semaphore);
 }
 
 // static
@@ -147,24 +329,12 @@ bool VSemaphore::semaphoreDestroy(VSemaphore_Type* semaphore) {
 }
 
 // static
-bool VSemaphore::semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* mutex, const VDuration& timeoutInterval) {
-    if (timeoutInterval == VDuration::ZERO()) {
+bool VSemaphore::semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* mutex, Vs64 timeoutNanoseconds) {
+    if (timeoutNanoseconds == 0) {
         return (pthread_cond_wait(semaphore, mutex) == 0);
     }
 
-    // The timespec is an absolute time (base is 1970 UTC), not an
-    // offset from the current time.
-    VInstant now;
-    VInstant timeoutWhen = now + timeoutInterval;
-    Vs64     timeoutValue = timeoutWhen.getValue();
-
-    struct timespec timeoutSpec;
-
-    // Convert milliseconds to seconds.nanoseconds. e.g., 1234ms = 1sec + 234,000,000ns
-    timeoutSpec.tv_sec = static_cast<time_t>(timeoutValue / CONST_S64(1000));
-    timeoutSpec.tv_nsec = static_cast<time_t>(CONST_S64(1000000) * (timeoutValue % CONST_S64(1000)));
-
-    int result = pthread_cond_timedwait(semaphore, mutex, &timeoutSpec);
+    int result = _monotonicTimedWait(semaphore, mutex, _getMonotonicNanoseconds() + timeoutNanoseconds);
 
     return (result == 0) || (result == ETIMEDOUT);
 }
@@ -179,3 +349,160 @@ bool VSemaphore::semaphoreBroadcast(VSemaphore_Type* semaphore) {
     return (pthread_cond_broadcast(semaphore) == 0);
 }
 
+
+// VCountingSemaphore platform-specific functions ----------------------------
+
+#ifdef __linux__
+
+// static
+bool VCountingSemaphore::countingSemaphoreInit(VCountingSemaphore_Type* semaphore, int initialCount) {
+    return (sem_init(semaphore, 0, static_cast<unsigned int>(initialCount)) == 0);
+}
+
+// static
+void VCountingSemaphore::countingSemaphoreDestroy(VCountingSemaphore_Type* semaphore) {
+    (void) sem_destroy(semaphore);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphorePost(VCountingSemaphore_Type* semaphore) {
+    return (sem_post(semaphore) == 0);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphoreWait(VCountingSemaphore_Type* semaphore, const VDuration& timeoutInterval, bool& acquired) {
+    acquired = false;
+
+    if (timeoutInterval == VDuration::ZERO()) {
+        int result;
+        do {
+            result = sem_wait(semaphore);
+        } while ((result != 0) && (errno == EINTR));
+
+        acquired = (result == 0);
+        return acquired;
+    }
+
+    // sem_clockwait (glibc 2.30) takes an absolute time on the clock we choose, so we can use
+    // CLOCK_MONOTONIC, as for condition variables. Before that, sem_timedwait only takes a
+    // CLOCK_REALTIME time; we read that clock directly rather than using VInstant, which may be
+    // offset or frozen by the simulated clock.
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 30)))
+    const clockid_t timeoutClock = CLOCK_MONOTONIC;
+#else
+    const clockid_t timeoutClock = CLOCK_REALTIME;
+#endif
+    struct timespec timeoutSpec;
+    (void) clock_gettime(timeoutClock, &timeoutSpec);
+    Vs64 timeoutNanoseconds = static_cast<Vs64>(timeoutSpec.tv_nsec) + (timeoutInterval.getDurationMilliseconds() * CONST_S64(1000000));
+    timeoutSpec.tv_sec += static_cast<time_t>(timeoutNanoseconds / CONST_S64(1000000000));
+    timeoutSpec.tv_nsec = static_cast<long>(timeoutNanoseconds % CONST_S64(1000000000));
+
+    int result;
+    do {
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 30)))
+        result = sem_clockwait(semaphore, timeoutClock, &timeoutSpec);
+#else
+        result = sem_timedwait(semaphore, &timeoutSpec);
+#endif
+    } while ((result != 0) && (errno == EINTR));
+
+    acquired = (result == 0);
+    return acquired || (errno == ETIMEDOUT);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphoreTryWait(VCountingSemaphore_Type* semaphore) {
+    int result;
+    do {
+        result = sem_trywait(semaphore);
+    } while ((result != 0) && (errno == EINTR));
+
+    return (result == 0);
+}
+
+#else /* not __linux__ */
+
+// static
+bool VCountingSemaphore::countingSemaphoreInit(VCountingSemaphore_Type* semaphore, int initialCount) {
+    semaphore->mCount = initialCount;
+
+    if (pthread_mutex_init(&semaphore->mMutex, NULL) != 0) {
+        return false;
+    }
+
+    if (! _initMonotonicCondition(&semaphore->mCondition)) {
+        (void) pthread_mutex_destroy(&semaphore->mMutex);
+        return false;
+    }
+
+    return true;
+}
+
+// static
+void VCountingSemaphore::countingSemaphoreDestroy(VCountingSemaphore_Type* semaphore) {
+    (void) pthread_cond_destroy(&semaphore->mCondition);
+    (void) pthread_mutex_destroy(&semaphore->mMutex);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphorePost(VCountingSemaphore_Type* semaphore) {
+    if (pthread_mutex_lock(&semaphore->mMutex) != 0) {
+        return false;
+    }
+
+    ++semaphore->mCount;
+    bool success = (pthread_cond_signal(&semaphore->mCondition) == 0);
+    (void) pthread_mutex_unlock(&semaphore->mMutex);
+    return success;
+}
+
+// static
+bool VCountingSemaphore::countingSemaphoreWait(VCountingSemaphore_Type* semaphore, const VDuration& timeoutInterval, bool& acquired) {
+    acquired = false;
+
+    Vs64 deadlineNanoseconds = 0;
+    if (timeoutInterval != VDuration::ZERO()) {
+        deadlineNanoseconds = _getMonotonicNanoseconds() + (timeoutInterval.getDurationMilliseconds() * CONST_S64(1000000));
+    }
+
+    if (pthread_mutex_lock(&semaphore->mMutex) != 0) {
+        return false;
+    }
+
+    // The count, not the condition, records the posts; so a post made before we got here is not lost,
+    // and a spurious wakeup just goes around again.
+    int result = 0;
+    while ((semaphore->mCount == 0) && (result == 0)) {
+        if (timeoutInterval == VDuration::ZERO()) {
+            result = pthread_cond_wait(&semaphore->mCondition, &semaphore->mMutex);
+        } else {
+            result = _monotonicTimedWait(&semaphore->mCondition, &semaphore->mMutex, deadlineNanoseconds);
+        }
+    }
+
+    if (semaphore->mCount > 0) {
+        --semaphore->mCount;
+        acquired = true;
+    }
+
+    (void) pthread_mutex_unlock(&semaphore->mMutex);
+    return acquired || (result == ETIMEDOUT);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphoreTryWait(VCountingSemaphore_Type* semaphore) {
+    if (pthread_mutex_lock(&semaphore->mMutex) != 0) {
+        return false;
+    }
+
+    bool acquired = (semaphore->mCount > 0);
+    if (acquired) {
+        --semaphore->mCount;
+    }
+
+    (void) pthread_mutex_unlock(&semaphore->mMutex);
+    return acquired;
+}
+
+#endif /* __linux__ */
@@ -14,6 +14,9 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 extern "C" {
 #include <pthread.h>
+#ifdef __linux__
+#include <semaphore.h>
+#endif
 }
 
 // We define our own names here so that we are independent of the platform names,
@@ -21,6 +24,17 @@ extern "C" {
 typedef pthread_t       VThreadID_Type;
 typedef pthread_cond_t  VSemaphore_Type;
 typedef pthread_mutex_t VMutex_Type;
+typedef pthread_rwlock_t VReadWriteLock_Type;
+#ifdef __linux__
+typedef sem_t VCountingSemaphore_Type; // futex-based; waits and posts do not enter the kernel unless they must block or wake
+#else
+/** The portable form of a counting semaphore, for Unix platforms without unnamed POSIX semaphores (such as Mac OS X). */
+struct VCountingSemaphore_Type {
+    pthread_mutex_t mMutex;
+    pthread_cond_t  mCondition;
+    int             mCount;
+};
+#endif
 typedef struct timespec VTimeout_Type;
 
 #endif /* vthread_platform_h */
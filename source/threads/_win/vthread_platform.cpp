@@ -9,6 +9,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vthread.h"
 #include "vmutex.h"
+#include "vreadwritelock.h"
+#include "vcountingsemaphore.h"
 #include "vsemaphore.h"
 #include "vexception.h"
 #include "vmutexlocker.h"
@@ -46,8 +48,9 @@ static HANDLE _lookupThreadHandle(VThreadID_Type threadID) {
 // VThread platform-specific functions ---------------------------------------
 
 // static
-void VThread::threadCreate(VThreadID_Type* threadID, bool /*createDetached*/, threadMainFunction threadMainProcPtr, void* threadArgument) {
-    HANDLE threadHandle = ::CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE) threadMainProcPtr, threadArgument, 0, /*(LPDWORD)*/ threadID);
+void VThread::threadCreate(VThreadID_Type* threadID, bool /*createDetached*/, size_t stackSize, threadMainFunction threadMainProcPtr, void* threadArgument) {
+    // The size is a reservation, which is what matters for address space; 0 means the executable's default.
+    HANDLE threadHandle = ::CreateThread(NULL, stackSize, (LPTHREAD_START_ROUTINE) threadMainProcPtr, threadArgument, (stackSize == 0) ? 0 : STACK_SIZE_PARAM_IS_A_RESERVATION, /*(LPDWORD)*/ threadID);
 
     if (threadHandle == NULL) {
         throw VStackTraceException(VSystemError(), "VThread::threadCreate: CreateThread returned null.");
@@ -60,6 +63,16 @@ void VThread::threadCreate(VThreadID_Type* threadID, bool /*createDetached*/, th
 void VThread::_threadStarting(const VThread* thread) {
     HANDLE threadHandle = _lookupThreadHandle(thread->threadID());
     ResetEvent(threadHandle);    // remove any signal from this thread
+
+    const VThreadOptions& options = thread->getOptions();
+
+    if ((options.getCPUAffinityMask() != 0) && ! VThread::setCurrentThreadAffinityMask(options.getCPUAffinityMask())) {
+        VLOGGER_NAMED_WARN(thread->getLoggerName(), VSTRING_FORMAT("[%s] VThread: Unable to set CPU affinity mask 0x%llX.", thread->getName().chars(), options.getCPUAffinityMask()));
+    }
+
+    if ((options.getSchedulingPolicy() != VThreadOptions::kSchedulingDefault) && ! VThread::setCurrentThreadScheduling(options.getSchedulingPolicy(), options.getSchedulingPriority())) {
+        VLOGGER_NAMED_WARN(thread->getLoggerName(), VSTRING_FORMAT("[%s] VThread: Unable to set scheduling policy %d.", thread->getName().chars(), (int) options.getSchedulingPolicy()));
+    }
 }
 
 // static
@@ -101,6 +114,39 @@ bool VThread::setPriority(int /*nice*/) {
     return true;
 }
 
+// static
+bool VThread::setCurrentThreadAffinity(int cpuIndex) {
+    return (::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpuIndex) != 0);
+}
+
+// static
+bool VThread::setCurrentThreadAffinityMask(Vu64 cpuAffinityMask) {
+    return (::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(cpuAffinityMask)) != 0);
+}
+
+// static
+bool VThread::setCurrentThreadScheduling(VThreadOptions::SchedulingPolicy policy, int /*priority*/) {
+    // Windows has priorities rather than policies; approximate each policy with one.
+    int threadPriority;
+    switch (policy) {
+        case VThreadOptions::kSchedulingDefault: threadPriority = THREAD_PRIORITY_NORMAL; break;
+        case VThreadOptions::kSchedulingBatch: threadPriority = THREAD_PRIORITY_BELOW_NORMAL; break;
+        case VThreadOptions::kSchedulingIdle: threadPriority = THREAD_PRIORITY_IDLE; break;
+        case VThreadOptions::kSchedulingFIFO: threadPriority = THREAD_PRIORITY_TIME_CRITICAL; break;
+        case VThreadOptions::kSchedulingRoundRobin: threadPriority = THREAD_PRIORITY_HIGHEST; break;
+        default: return false;
+    }
+
+    return (::SetThreadPriority(::GetCurrentThread(), threadPriority) != 0);
+}
+
+// static
+int VThread::getNumberOfProcessors() {
+    SYSTEM_INFO systemInfo;
+    ::GetSystemInfo(&systemInfo);
+    return (systemInfo.dwNumberOfProcessors < 1) ? 1 : static_cast<int>(systemInfo.dwNumberOfProcessors);
+}
+
 // static
 void VThread::sleep(const VDuration& interval) {
     Sleep(static_cast<DWORD>(interval.getDurationMilliseconds()));
@@ -132,54 +178,134 @@ bool VMutex::mutexLock(VMutex_Type* mutex) {
     return true;
 }
 
+// static
+bool VMutex::mutexTryLock(VMutex_Type* mutex) {
+    return (TryEnterCriticalSection(mutex) != 0);
+}
+
 // static
 bool VMutex::mutexUnlock(VMutex_Type* mutex) {
     LeaveCriticalSection(mutex);
     return true;
 }
 
+// VReadWriteLock platform-specific functions --------------------------------
+
+// static
+bool VReadWriteLock::readWriteLockInit(VReadWriteLock_Type* lock) {
+    InitializeSRWLock(lock);
+    return true;
+}
+
+// static
+void VReadWriteLock::readWriteLockDestroy(VReadWriteLock_Type* /*lock*/) {
+    // SRW locks have no resources to release.
+}
+
+// static
+bool VReadWriteLock::readLock(VReadWriteLock_Type* lock) {
+    AcquireSRWLockShared(lock);
+    return true;
+}
+
+// static
+bool VReadWriteLock::readUnlock(VReadWriteLock_Type* lock) {
+    ReleaseSRWLockShared(lock);
+    return true;
+}
+
+// static
+bool VReadWriteLock::writeLock(VReadWriteLock_Type* lock) {
+    AcquireSRWLockExclusive(lock);
+    return true;
+}
+
+// static
+bool VReadWriteLock::writeUnlock(VReadWriteLock_Type* lock) {
+    ReleaseSRWLockExclusive(lock);
+    return true;
+}
+
 // VSemaphore platform-specific functions ------------------------------------
 
-#define kSemaphoreMaxCount 1
+// A condition variable on the VMutex's critical section, so that as on Unix the mutex is released
+// while waiting, and broadcast() can wake every waiter.
 
 // static
 bool VSemaphore::semaphoreInit(VSemaphore_Type* semaphore) {
-    *semaphore = CreateSemaphore(NULL, 0, kSemaphoreMaxCount, NULL);
-    return (*semaphore != NULL);
+    InitializeConditionVariable(semaphore);
+    return true;
 }
 
 // static
-bool VSemaphore::semaphoreDestroy(VSemaphore_Type* semaphore) {
-    CloseHandle(*semaphore);
-    return true;
+bool VSemaphore::semaphoreDestroy(VSemaphore_Type* /*semaphore*/) {
+    return true; // Windows condition variables need no cleanup.
 }
 
 // static
-bool VSemaphore::semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* /*mutex*/, const VDuration& timeoutInterval) {
+bool VSemaphore::semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* mutex, Vs64 timeoutNanoseconds) {
     DWORD timeoutMillisecondsDWORD;
 
-    if (timeoutInterval == VDuration::ZERO()) {
+    // The timeout is relative, so it is already unaffected by changes to the wall clock.
+    // Round up, since Windows waits are in whole milliseconds.
+    if (timeoutNanoseconds == 0) {
         timeoutMillisecondsDWORD = INFINITE;
     } else {
-        timeoutMillisecondsDWORD = static_cast<DWORD>(timeoutInterval.getDurationMilliseconds());
+        timeoutMillisecondsDWORD = static_cast<DWORD>((timeoutNanoseconds + CONST_S64(999999)) / CONST_S64(1000000));
     }
 
-    DWORD result = WaitForSingleObject(*semaphore, timeoutMillisecondsDWORD);    // waits until the semaphore's count is > 0, then decrements it
-    return (result != WAIT_FAILED);
+    // Releases the critical section while waiting, and reacquires it before returning.
+    BOOL result = SleepConditionVariableCS(semaphore, mutex, timeoutMillisecondsDWORD);
+    return (result != 0) || (GetLastError() == ERROR_TIMEOUT);
 }
 
 // static
 bool VSemaphore::semaphoreSignal(VSemaphore_Type* semaphore) {
-    LONG previousCount = 1;
-    BOOL result = ReleaseSemaphore(*semaphore, 1, &previousCount);    // increases the semaphore's "count" by 1
+    WakeConditionVariable(semaphore);
+    return true;
+}
+
+// static
+bool VSemaphore::semaphoreBroadcast(VSemaphore_Type* semaphore) {
+    WakeAllConditionVariable(semaphore);
+    return true;
+}
+
+
+// VCountingSemaphore platform-specific functions ----------------------------
 
-    // The only acceptable "error" is an attempt to increment from 1 to 2.
-    return (result != 0 || (previousCount == 1));
+// static
+bool VCountingSemaphore::countingSemaphoreInit(VCountingSemaphore_Type* semaphore, int initialCount) {
+    *semaphore = CreateSemaphore(NULL, initialCount, LONG_MAX, NULL);
+    return (*semaphore != NULL);
+}
+
+// static
+void VCountingSemaphore::countingSemaphoreDestroy(VCountingSemaphore_Type* semaphore) {
+    CloseHandle(*semaphore);
 }
 
 // static
-bool VSemaphore::semaphoreBroadcast(VSemaphore_Type* /*semaphore*/) {
-    // FIXME: How can this be done on Windows?
-    return false;
+bool VCountingSemaphore::countingSemaphorePost(VCountingSemaphore_Type* semaphore) {
+    return (ReleaseSemaphore(*semaphore, 1, NULL) != 0);
+}
+
+// static
+bool VCountingSemaphore::countingSemaphoreWait(VCountingSemaphore_Type* semaphore, const VDuration& timeoutInterval, bool& acquired) {
+    DWORD timeoutMillisecondsDWORD;
+
+    if (timeoutInterval == VDuration::ZERO()) {
+        timeoutMillisecondsDWORD = INFINITE;
+    } else {
+        timeoutMillisecondsDWORD = static_cast<DWORD>(timeoutInterval.getDurationMilliseconds());
+    }
+
+    DWORD result = WaitForSingleObject(*semaphore, timeoutMillisecondsDWORD);
+    acquired = (result == WAIT_OBJECT_0);
+    return (result != WAIT_FAILED);
 }
 
+// static
+bool VCountingSemaphore::countingSemaphoreTryWait(VCountingSemaphore_Type* semaphore) {
+    return (WaitForSingleObject(*semaphore, 0) == WAIT_OBJECT_0);
+}
@@ -22,8 +22,10 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 // and don't conflict with any similarly-named platform typedefs (such as "ThreadID").
 
 typedef DWORD               VThreadID_Type;
-typedef HANDLE              VSemaphore_Type;
+typedef CONDITION_VARIABLE  VSemaphore_Type;
 typedef CRITICAL_SECTION    VMutex_Type;
+typedef SRWLOCK             VReadWriteLock_Type;
+typedef HANDLE              VCountingSemaphore_Type;
 typedef long                VTimeout_Type;
 
 #endif /* vthread_platform_h */
@@ -0,0 +1,99 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vcoarseclock.h"
+
+#include "vthread.h"
+#include "vmutex.h"
+#include "vmutexlocker.h"
+
+#include <atomic>
+
+// VCoarseClockThread ----------------------------------------------------------
+
+static std::atomic<Vs64> gResolutionMilliseconds(10);
+
+/**
+The ticker thread that records the current time for VInstant::setNowCoarse().
+*/
+class VCoarseClockThread : public VThread {
+    public:
+
+        VCoarseClockThread() :
+            VThread("VCoarseClock", "vault.threads.VCoarseClock", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mStopRequested(false) {
+        }
+
+        virtual ~VCoarseClockThread() {}
+
+        virtual void run() {
+            while (! mStopRequested.load()) {
+                VInstant::updateCoarseClock();
+                VThread::sleep(VDuration::MILLISECOND() * gResolutionMilliseconds.load(std::memory_order_relaxed));
+            }
+        }
+
+        // Not stop() and join(): VThread::join() returns at once for a thread that has been stop()ped.
+        void stopAndJoin() {
+            mStopRequested.store(true);
+            (void) this->join();
+        }
+
+    private:
+
+        VCoarseClockThread(const VCoarseClockThread&); // not copyable
+        VCoarseClockThread& operator=(const VCoarseClockThread&); // not assignable
+
+        std::atomic<bool> mStopRequested; ///< Set by stopAndJoin() to end run().
+};
+
+// VCoarseClock ----------------------------------------------------------------
+
+static VMutex gCoarseClockMutex("gCoarseClockMutex", true/*suppress logging; the logger may use the coarse clock*/);
+static VCoarseClockThread* gCoarseClockThread = NULL;
+
+// static
+void VCoarseClock::start(const VDuration& resolution) {
+    VMutexLocker locker(&gCoarseClockMutex, "VCoarseClock::start");
+
+    gResolutionMilliseconds.store(V_MAX(CONST_S64(1), resolution.getDurationMilliseconds()), std::memory_order_relaxed);
+
+    if (gCoarseClockThread == NULL) {
+        // Enable the coarse clock before returning, so that callers see a current value
+        // immediately rather than after the thread gets scheduled.
+        VInstant::updateCoarseClock();
+        gCoarseClockThread = new VCoarseClockThread();
+        gCoarseClockThread->start();
+    }
+}
+
+// static
+void VCoarseClock::stop() {
+    VMutexLocker locker(&gCoarseClockMutex, "VCoarseClock::stop");
+
+    if (gCoarseClockThread != NULL) {
+        gCoarseClockThread->stopAndJoin();
+        delete gCoarseClockThread;
+        gCoarseClockThread = NULL;
+    }
+
+    // Disable after the thread has ended, so that its last update cannot re-enable it.
+    VInstant::disableCoarseClock();
+}
+
+// static
+bool VCoarseClock::isRunning() {
+    VMutexLocker locker(&gCoarseClockMutex, "VCoarseClock::isRunning");
+    return gCoarseClockThread != NULL;
+}
+
+// static
+VDuration VCoarseClock::getResolution() {
+    return VDuration::MILLISECOND() * gResolutionMilliseconds.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,70 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vcoarseclock_h
+#define vcoarseclock_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vinstant.h"
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VCoarseClock runs a background thread that periodically records the current
+time for VInstant::setNowCoarse(). Code on a hot path that only needs to
+know roughly when something last happened, such as the time of the last
+read on a socket, can then timestamp it with one atomic load instead of a
+call into the platform clock on every operation.
+
+The coarse clock is opt-in: until start() is called, setNowCoarse() reads
+the platform clock like setNow(), so its callers are merely as precise as
+before. An application that wants the saving calls start() once at
+startup, and optionally stop() at shutdown:
+
+<code>
+VCoarseClock::start(10 * VDuration::MILLISECOND());
+</code>
+
+The coarse time lags the true time by up to the resolution, plus any delay
+in scheduling the ticker thread. Do not use it to measure short intervals;
+use VTicks for that.
+*/
+class VCoarseClock {
+    public:
+
+        /**
+        Starts the ticker thread, if it is not already running, and enables the coarse
+        clock. If it is already running, its resolution is changed.
+        @param  resolution  how often the coarse time is updated; at least 1 millisecond
+        */
+        static void start(const VDuration& resolution = 10 * VDuration::MILLISECOND());
+        /**
+        Disables the coarse clock and stops the ticker thread, waiting for it to end.
+        */
+        static void stop();
+        /**
+        Returns true if the ticker thread is running.
+        @return obvious
+        */
+        static bool isRunning();
+        /**
+        Returns how often the coarse time is updated.
+        @return the resolution
+        */
+        static VDuration getResolution();
+
+    private:
+
+        VCoarseClock(); // not instantiable; static API only
+};
+
+#endif /* vcoarseclock_h */
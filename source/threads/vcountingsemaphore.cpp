@@ -0,0 +1,88 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vcountingsemaphore.h"
+
+#include "vexception.h"
+
+// VCountingSemaphore ----------------------------------------------------------
+
+VCountingSemaphore::VCountingSemaphore(int initialCount)
+    : mSemaphore()
+    {
+
+    if (! VCountingSemaphore::countingSemaphoreInit(&mSemaphore, initialCount)) {
+        throw VStackTraceException("VCountingSemaphore::VCountingSemaphore unable to initialize semaphore.");
+    }
+}
+
+VCountingSemaphore::~VCountingSemaphore() {
+    VCountingSemaphore::countingSemaphoreDestroy(&mSemaphore);
+}
+
+void VCountingSemaphore::post() {
+    if (! VCountingSemaphore::countingSemaphorePost(&mSemaphore)) {
+        throw VStackTraceException("VCountingSemaphore::post unable to post semaphore.");
+    }
+}
+
+void VCountingSemaphore::wait() {
+    bool acquired = false;
+    if (! VCountingSemaphore::countingSemaphoreWait(&mSemaphore, VDuration::ZERO(), acquired)) {
+        throw VStackTraceException("VCountingSemaphore::wait unable to wait on semaphore.");
+    }
+}
+
+bool VCountingSemaphore::timedWait(const VDuration& timeoutInterval) {
+    if (timeoutInterval <= VDuration::ZERO()) {
+        return this->tryWait(); // zero means no timeout to the platform function, but no wait here
+    }
+
+    bool acquired = false;
+    if (! VCountingSemaphore::countingSemaphoreWait(&mSemaphore, timeoutInterval, acquired)) {
+        throw VStackTraceException("VCountingSemaphore::timedWait unable to wait on semaphore.");
+    }
+
+    return acquired;
+}
+
+bool VCountingSemaphore::tryWait() {
+    return VCountingSemaphore::countingSemaphoreTryWait(&mSemaphore);
+}
+
+// VEvent ----------------------------------------------------------------------
+
+VEvent::VEvent()
+    : mSignaled(false)
+    , mSemaphore(0)
+    {
+}
+
+void VEvent::signal() {
+    // Only the signal that sets the event posts, so the count never exceeds 1.
+    if (! mSignaled.exchange(true)) {
+        mSemaphore.post();
+    }
+}
+
+void VEvent::wait() {
+    mSemaphore.wait();
+    // Clear the event before the caller examines its state, so that a signal for a change made
+    // after that examination sets the event again rather than being coalesced into this one.
+    mSignaled.store(false);
+}
+
+bool VEvent::timedWait(const VDuration& timeoutInterval) {
+    if (! mSemaphore.timedWait(timeoutInterval)) {
+        return false;
+    }
+
+    mSignaled.store(false);
+    return true;
+}
@@ -0,0 +1,177 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vcountingsemaphore_h
+#define vcountingsemaphore_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vthread_platform.h"
+#include "vinstant.h"
+
+#include <atomic>
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VCountingSemaphore is a classic counting semaphore. post() increments the
+count, and wait() blocks until the count is non-zero and then decrements it.
+Unlike VSemaphore, which is a condition variable and so forgets a signal()
+that arrives while no thread is waiting, a post() is never lost: a thread
+that calls wait() after the post() returns immediately. And no mutex needs
+to be supplied or held by the caller.
+
+On Linux this is an unnamed POSIX semaphore, which is futex-based, so a
+post() with no waiter, or a wait() on a non-zero count, does not enter the
+kernel. On Windows it is a Win32 semaphore. On other Unix platforms it is a
+count guarded by a pthread mutex and condition variable.
+
+@see VEvent
+*/
+class VCountingSemaphore {
+    public:
+
+        /**
+        Creates and initializes the semaphore.
+        @param  initialCount    the initial count
+        */
+        VCountingSemaphore(int initialCount = 0);
+        /**
+        Destructs the semaphore. No thread may be waiting on it.
+        */
+        virtual ~VCountingSemaphore();
+
+        /**
+        Increments the count; if one or more threads is waiting, one of them is woken.
+        */
+        void post();
+        /**
+        Blocks until the count is non-zero, and decrements it.
+        */
+        void wait();
+        /**
+        Blocks until the count is non-zero, and decrements it, or until the timeout elapses.
+        @param  timeoutInterval the maximum time to wait
+        @return true if the count was decremented; false if the wait timed out
+        */
+        bool timedWait(const VDuration& timeoutInterval);
+        /**
+        Decrements the count if it is non-zero, without blocking.
+        @return true if the count was decremented; false if it was zero
+        */
+        bool tryWait();
+
+        /* PLATFORM-SPECIFIC STATIC FUNCTIONS --------------------------------
+        The remaining functions defined here are the low-level interfaces to
+        the platform-specific semaphore APIs. These are implemented in each
+        platform-specific version of vthread_platform.cpp.
+        */
+
+        /**
+        Initializes the platform semaphore value.
+        Wrapper on Linux for sem_init.
+        @param    semaphore     pointer to the platform semaphore
+        @param    initialCount  the initial count
+        @return true on success; false on failure
+        */
+        static bool countingSemaphoreInit(VCountingSemaphore_Type* semaphore, int initialCount);
+        /**
+        Destroys the platform semaphore value.
+        Wrapper on Linux for sem_destroy.
+        @param    semaphore    pointer to the platform semaphore
+        */
+        static void countingSemaphoreDestroy(VCountingSemaphore_Type* semaphore);
+        /**
+        Increments the platform semaphore value.
+        Wrapper on Linux for sem_post.
+        @param    semaphore    pointer to the platform semaphore
+        @return true on success; false on failure
+        */
+        static bool countingSemaphorePost(VCountingSemaphore_Type* semaphore);
+        /**
+        Waits to decrement the platform semaphore value.
+        Wrapper on Linux for sem_wait and sem_timedwait.
+        @param    semaphore         pointer to the platform semaphore
+        @param    timeoutInterval   zero for no timeout; otherwise, the interval after which to timeout
+        @param    acquired          set to true if the count was decremented, false if the wait timed out
+        @return true on success; false on failure; timeout is considered success
+        */
+        static bool countingSemaphoreWait(VCountingSemaphore_Type* semaphore, const VDuration& timeoutInterval, bool& acquired);
+        /**
+        Decrements the platform semaphore value if it is non-zero.
+        Wrapper on Linux for sem_trywait.
+        @param    semaphore    pointer to the platform semaphore
+        @return true if the count was decremented
+        */
+        static bool countingSemaphoreTryWait(VCountingSemaphore_Type* semaphore);
+
+    private:
+
+        VCountingSemaphore(const VCountingSemaphore&); // not copyable
+        VCountingSemaphore& operator=(const VCountingSemaphore&); // not assignable
+
+        VCountingSemaphore_Type mSemaphore; ///< The OS semaphore handle.
+};
+
+/**
+VEvent is an auto-reset event: signal() sets it, and wait() blocks until it
+is set and then clears it. Signals that arrive while the event is already set
+are coalesced, so one wait() consumes any number of them; and a signal() that
+arrives before the wait() is not lost.
+
+It is meant for a thread waiting for work that is described by some other
+state, such as a queue. The waiter must check that state after wait()
+returns, and must not assume that there is work, because a signal may have
+been sent for work that was already taken:
+
+<code>
+for (;;) {<br>
+&nbsp;&nbsp;&nbsp;&nbsp;if (queue has an item) return the item;<br>
+&nbsp;&nbsp;&nbsp;&nbsp;mEvent.wait();<br>
+}
+</code>
+
+The producer changes the state and then calls signal().
+
+@see VCountingSemaphore
+*/
+class VEvent {
+    public:
+
+        VEvent();
+        ~VEvent() {}
+
+        /**
+        Sets the event; if a thread is waiting, it is woken. Costs one atomic operation if
+        the event is already set.
+        */
+        void signal();
+        /**
+        Blocks until the event is set, and clears it.
+        */
+        void wait();
+        /**
+        Blocks until the event is set, and clears it, or until the timeout elapses.
+        @param  timeoutInterval the maximum time to wait
+        @return true if the event was set; false if the wait timed out
+        */
+        bool timedWait(const VDuration& timeoutInterval);
+
+    private:
+
+        VEvent(const VEvent&); // not copyable
+        VEvent& operator=(const VEvent&); // not assignable
+
+        std::atomic<bool>   mSignaled;  ///< True if the event is set; the semaphore count is then 1.
+        VCountingSemaphore  mSemaphore; ///< Holds the wakeup while the event is set.
+};
+
+#endif /* vcountingsemaphore_h */
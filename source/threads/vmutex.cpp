@@ -15,15 +15,28 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 VDuration VMutex::gVMutexLockDelayLoggingThreshold(100 * VDuration::MILLISECOND());
 int VMutex::gVMutexLockDelayLoggingLevel(VLoggerLevel::DEBUG);
+int VMutex::gVMutexMaxSpinCount(100);
+
+// Tells the processor we are in a spin-wait loop, so it can save power and yield to a hyperthread sibling.
+static inline void _spinPause() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(VPLATFORM_WIN)
+    YieldProcessor();
+#endif
+}
 
 VMutex::VMutex(const VString& name, bool suppressLogging)
     : mMutex()
     , mName(name)
     , mSuppressLogging(suppressLogging)
     , mLastLockThread((VThreadID_Type) - 1)
-    , mLastLockerName()
-    , mLastLockTime(VInstant::NEVER_OCCURRED())
     , mIsLocked(false)
+    , mSpinEstimate(0)
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    , mLastLockerName()
+    , mLastLockTicks(0)
+#endif
     {
 
     if (! VMutex::mutexInit(&mMutex))
@@ -46,48 +59,51 @@ bool VMutex::isLockedByCurrentThread() const {
     return mIsLocked && (mLastLockThread == VThread::threadSelf());
 }
 
-void VMutex::_lock(const VString& lockerName) {
+void VMutex::_lock(const char* lockerName) {
 #ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
-    VInstant start;
+    // Only read the clock, and copy the locker name, if the check is on; this is on every lock.
+    const bool checkDelay = (gVMutexLockDelayLoggingThreshold >= VDuration::ZERO()) && ! mSuppressLogging;
+    const Vs64 start = checkDelay ? VTicks::snapshot() : 0;
 #endif
-    if (VMutex::mutexLock(&mMutex)) {
-        mLastLockTime.setNow();
+
+    // The uncontended case is a single atomic operation in the OS mutex.
+    if (! VMutex::mutexTryLock(&mMutex)) {
+        this->_lockContended();
+    }
 
 #ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
-        if ((gVMutexLockDelayLoggingThreshold >= VDuration::ZERO()) && ! mSuppressLogging) {
-            VInstant end;
-            VDuration waitTime = end - start;
-
-            if (waitTime >= gVMutexLockDelayLoggingThreshold) {
-                VLOGGER_LEVEL(gVMutexLockDelayLoggingLevel, VSTRING_FORMAT("Delay: '%s' was blocked " VSTRING_FORMATTER_S64 "ms on mutex '%s' released by '%s'.",
-                                                                           lockerName.chars(), waitTime.getDurationMilliseconds(), mName.chars(), mLastLockerName.chars()));
-            }
+    if (checkDelay) {
+        const Vs64 end = VTicks::snapshot();
+        Vs64 waitTimeNanoseconds = end - start;
+
+        if (waitTimeNanoseconds >= gVMutexLockDelayLoggingThreshold.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_LEVEL(gVMutexLockDelayLoggingLevel, VSTRING_FORMAT("Delay: '%s' was blocked %s on mutex '%s' released by '%s'.",
+                                                                       (lockerName == NULL) ? "" : lockerName, VTicks::getDurationString(waitTimeNanoseconds).chars(), mName.chars(), mLastLockerName.chars()));
         }
-#endif
 
-        // Note: These properties are only valid with the understanding that they are not set atomically during lock/unlock.
-        // The only guarantee is that they end up set to their new values after the lock is acquired above, and before we return.
-        // They may only be used for mutex diagnostics (e.g. isLockedByCurrentThread() and lock delay reporting), not for concurrency control.
-        mLastLockThread = VThread::threadSelf();
-        mLastLockerName = lockerName;
-        mIsLocked = true;
+        mLastLockerName = (lockerName == NULL) ? "" : lockerName;
+        mLastLockTicks = end;
     } else {
-        if (mName.isEmpty()) {
-            throw VStackTraceException("VMutex::lock unable to lock mutex.");
-        } else {
-            throw VStackTraceException(VSTRING_FORMAT("VMutex::lock unable to lock mutex '%s'.", mName.chars()));
-        }
+        mLastLockTicks = 0; // so that _unlock() does not measure the hold time from a stale value
     }
+#else
+    (void) lockerName; // only recorded for lock delay checking
+#endif
+
+    // Note: These properties are only valid with the understanding that they are not set atomically during lock/unlock.
+    // The only guarantee is that they end up set to their new values after the lock is acquired above, and before we return.
+    // They may only be used for mutex diagnostics (e.g. isLockedByCurrentThread() and lock delay reporting), not for concurrency control.
+    mLastLockThread = VThread::threadSelf();
+    mIsLocked = true;
 }
 
 void VMutex::_unlock() {
 #ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
-    if ((gVMutexLockDelayLoggingThreshold >= VDuration::ZERO()) && ! mSuppressLogging) {
-        VInstant now;
-        VDuration delay = now - mLastLockTime;
-        if (delay >= gVMutexLockDelayLoggingThreshold) {
-            VLOGGER_LEVEL(gVMutexLockDelayLoggingLevel, VSTRING_FORMAT("Delay: '%s' is unlocking mutex '%s' after holding it for " VSTRING_FORMATTER_S64 "ms.",
-                                                                       mLastLockerName.chars(), mName.chars(), delay.getDurationMilliseconds()));
+    if ((mLastLockTicks != 0) && (gVMutexLockDelayLoggingThreshold >= VDuration::ZERO())) {
+        Vs64 delayNanoseconds = VTicks::snapshot() - mLastLockTicks;
+        if (delayNanoseconds >= gVMutexLockDelayLoggingThreshold.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_LEVEL(gVMutexLockDelayLoggingLevel, VSTRING_FORMAT("Delay: '%s' is unlocking mutex '%s' after holding it for %s.",
+                                                                       mLastLockerName.chars(), mName.chars(), VTicks::getDurationString(delayNanoseconds).chars()));
         }
     }
 #endif
@@ -103,3 +119,25 @@ void VMutex::_unlock() {
     }
 }
 
+void VMutex::_lockContended() {
+    // Spin up to about twice the recent average before blocking. mSpinEstimate is only
+    // updated once we hold the lock, so it needs no synchronization of its own.
+    const int maxSpins = V_MIN(gVMutexMaxSpinCount, (mSpinEstimate * 2) + 10);
+    for (int numSpins = 1; numSpins <= maxSpins; ++numSpins) {
+        _spinPause();
+        if (VMutex::mutexTryLock(&mMutex)) {
+            mSpinEstimate += (numSpins - mSpinEstimate) / 8;
+            return;
+        }
+    }
+
+    if (! VMutex::mutexLock(&mMutex)) {
+        if (mName.isEmpty()) {
+            throw VStackTraceException("VMutex::lock unable to lock mutex.");
+        } else {
+            throw VStackTraceException(VSTRING_FORMAT("VMutex::lock unable to lock mutex '%s'.", mName.chars()));
+        }
+    }
+
+    mSpinEstimate += (maxSpins - mSpinEstimate) / 8;
+}
@@ -32,6 +32,16 @@ to guarantee the proper release of the mutex when the VMutexLocker
 is destructed (typically by going out of scope) regardless of exceptions
 being raised.
 
+Locking is kept as cheap as the underlying OS mutex. The diagnostic state
+recorded on each lock is just the locking thread, unless lock delay checking
+is compiled in (see setLockDelayLoggingThreshold()), in which case the
+locker name and lock time are also recorded. When the mutex is already
+locked, the locking thread first spins briefly, retrying the lock, before
+blocking in the OS; most locks are held only for a short time, and a thread
+that blocks pays for two context switches. The number of spins adapts per
+mutex to how long the lock has recently taken to become free, in the manner
+of glibc's adaptive mutexes, and is capped by setMaxSpinCount().
+
 @see VMutexLocker
 */
 class VMutex {
@@ -107,6 +117,13 @@ class VMutex {
         */
         static bool mutexLock(VMutex_Type* mutex);
 
+        /**
+        Locks the platform mutex value if it is not locked, without blocking.
+        Wrapper on Unix for pthread_mutex_trylock.
+        @return true if the mutex was locked; false if it is already locked
+        */
+        static bool mutexTryLock(VMutex_Type* mutex);
+
         /**
         Unlocks the platform mutex value.
         Wrapper on Unix for pthread_mutex_unlock.
@@ -127,6 +144,15 @@ class VMutex {
         static void setLockDelayLoggingLevel(int logLevel)                      { gVMutexLockDelayLoggingLevel = logLevel; }
         static int getLockDelayLoggingLevel()                                   { return gVMutexLockDelayLoggingLevel; }
 
+        /**
+        Sets the maximum number of times a thread retries a locked mutex before blocking.
+        The default is 100. Zero means a thread blocks immediately, which may be better
+        on a single processor machine.
+        @param  maxSpinCount    the maximum number of retries
+        */
+        static void setMaxSpinCount(int maxSpinCount)                           { gVMutexMaxSpinCount = maxSpinCount; }
+        static int getMaxSpinCount()                                            { return gVMutexMaxSpinCount; }
+
     private:
 
         VMutex(const VMutex&); // not copyable
@@ -142,27 +168,37 @@ class VMutex {
         thread, this call blocks until the mutex lock can be acquired (if
         several threads are competing, the order in which they acquire the
         mutex is not known). You can supply a name to identify who is attempting
-        to lock, for diagnostic purposes (the name is stored).
-        @param lockerName the name of the caller, for diagnostic purposes
+        to lock, for diagnostic purposes (the name is only stored if lock delay
+        checking is compiled in).
+        @param lockerName the name of the caller, for diagnostic purposes; may be NULL
         */
-        void _lock(const VString& lockerName = VString::EMPTY());
+        void _lock(const char* lockerName = NULL);
         /**
         Releases the mutex lock; if one or more other threads is waiting on
         the mutex, one of them will unblock and acquire the mutex lock once
         this thread releases it.
         */
         void _unlock();
+        /**
+        Acquires the mutex lock after an initial attempt has found it locked,
+        spinning briefly before blocking.
+        */
+        void _lockContended();
 
         VMutex_Type             mMutex;             ///< The OS mutex handle.
         VString                 mName;              ///< The name of this mutex for diagnostic purposes.
         bool                    mSuppressLogging;   ///< True if this VMutex must not call logger functions.
         volatile VThreadID_Type mLastLockThread;    ///< If locked, the thread that acquired the lock.
-        VString                 mLastLockerName;    ///< The name of the last (or current) caller of lock().
-        VInstant                mLastLockTime;      ///< When the last acquisition of the lock occurred.
         volatile bool           mIsLocked;          ///< For use only by isLockedByCurrentThread(); value may change concurrently.
+        int                     mSpinEstimate;      ///< The recent average number of spins needed to acquire the lock when contended; only updated while locked.
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+        VString                 mLastLockerName;    ///< The name of the last (or current) caller of lock().
+        Vs64                    mLastLockTicks;     ///< When the last acquisition of the lock occurred, as a VTicks::snapshot() value; 0 if it was not checked.
+#endif
 
         static VDuration gVMutexLockDelayLoggingThreshold;  ///< If >=0, lock delays are logged.
         static int gVMutexLockDelayLoggingLevel;            ///< Log level at which lock delays are logged.
+        static int gVMutexMaxSpinCount;                     ///< The limit on spins before blocking on a contended lock.
 };
 
 #endif /* vmutex_h */
@@ -14,12 +14,27 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 // VMutexLocker ----------------------------------------------------------------
 
-VMutexLocker::VMutexLocker(VMutex* mutex, const VString& name, bool lockInitially)
+VMutexLocker::VMutexLocker(VMutex* mutex, const char* name, bool lockInitially)
     : mMutex(mutex)
     , mIsLocked(false)
     , mName(name)
+    , mNameStorage()
+    {
+
+    if (lockInitially) {
+        this->lock();
+    }
+}
+
+VMutexLocker::VMutexLocker(VMutex* mutex, const VString& name, bool lockInitially)
+    : mMutex(mutex)
+    , mIsLocked(false)
+    , mName(NULL)
+    , mNameStorage(name)
     {
 
+    mName = mNameStorage.chars();
+
     if (lockInitially) {
         this->lock();
     }
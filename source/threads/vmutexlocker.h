@@ -75,10 +75,22 @@ class VMutexLocker {
         happen; this can useful if, for example, you allow a NULL VMutex
         pointer to be passed to a routine that needs to lock it if supplied.
 
+        The name is only used for diagnostics, so pass a string literal rather than
+        formatting one; the pointer is stored without copying the string, so it must
+        remain valid for the life of the locker.
+
         @param    mutex            the VMutex to lock, or NULL if no action is wanted
         @param    name             the mutex locker name; calling object/function name is a useful string
         @param    lockInitially    true if the lock should be acquired on construction
         */
+        VMutexLocker(VMutex* mutex, const char* name, bool lockInitially = true);
+        /**
+        Constructs the locker with a name that is a VString. The name is copied, so
+        prefer the const char* constructor where the name is a literal.
+        @param    mutex            the VMutex to lock, or NULL if no action is wanted
+        @param    name             the mutex locker name
+        @param    lockInitially    true if the lock should be acquired on construction
+        */
         VMutexLocker(VMutex* mutex, const VString& name, bool lockInitially = true);
         /**
         Destructor, unlocks the mutex if this object has acquired it.
@@ -120,7 +132,8 @@ class VMutexLocker {
 
         VMutex* mMutex;     ///< Pointer to the VMutex object, or NULL.
         bool    mIsLocked;  ///< True if this object has acquired the lock.
-        VString mName;      ///< The name of this locker, for diagnostic purposes.
+        const char* mName;  ///< The name of this locker, for diagnostic purposes; a literal, or mNameStorage's characters.
+        VString mNameStorage; ///< Holds the name if it was supplied as a VString.
 
     private:
 
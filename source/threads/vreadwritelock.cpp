@@ -0,0 +1,213 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vreadwritelock.h"
+
+#include "vmutex.h"
+#include "vexception.h"
+#include "vthread.h"
+#include "vlogger.h"
+
+// VReadWriteLock --------------------------------------------------------------
+
+VReadWriteLock::VReadWriteLock(const VString& name, bool suppressLogging)
+    : mLock()
+    , mName(name)
+    , mSuppressLogging(suppressLogging)
+    , mWriteLockThread((VThreadID_Type) - 1)
+    , mIsWriteLocked(false)
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    , mLastWriterName()
+    , mLastWriteLockTicks(0)
+#endif
+    {
+
+    if (! VReadWriteLock::readWriteLockInit(&mLock))
+        throw VStackTraceException(VSTRING_FORMAT("VReadWriteLock::VReadWriteLock unable to initialize lock '%s'.", name.chars()));
+}
+
+VReadWriteLock::~VReadWriteLock() {
+    VReadWriteLock::readWriteLockDestroy(&mLock);
+}
+
+void VReadWriteLock::setName(const VString& name) {
+    mName = name;
+}
+
+VReadWriteLock_Type* VReadWriteLock::getReadWriteLock() {
+    return &mLock;
+}
+
+bool VReadWriteLock::isWriteLockedByCurrentThread() const {
+    return mIsWriteLocked && (mWriteLockThread == VThread::threadSelf());
+}
+
+void VReadWriteLock::_readLock(const char* lockerName) {
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    const bool checkDelay = (VMutex::getLockDelayLoggingThreshold() >= VDuration::ZERO()) && ! mSuppressLogging;
+    const Vs64 start = checkDelay ? VTicks::snapshot() : 0;
+#endif
+
+    if (! VReadWriteLock::readLock(&mLock)) {
+        this->_throwLockFailure("lock for reading");
+    }
+
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    if (checkDelay) {
+        Vs64 waitTimeNanoseconds = VTicks::snapshot() - start;
+        if (waitTimeNanoseconds >= VMutex::getLockDelayLoggingThreshold().getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_LEVEL(VMutex::getLockDelayLoggingLevel(), VSTRING_FORMAT("Delay: '%s' was blocked %s reading lock '%s'.",
+                                                                             (lockerName == NULL) ? "" : lockerName, VTicks::getDurationString(waitTimeNanoseconds).chars(), mName.chars()));
+        }
+    }
+#else
+    (void) lockerName; // only used for lock delay checking
+#endif
+}
+
+void VReadWriteLock::_readUnlock() {
+    if (! VReadWriteLock::readUnlock(&mLock)) {
+        this->_throwLockFailure("unlock after reading");
+    }
+}
+
+void VReadWriteLock::_writeLock(const char* lockerName) {
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    const bool checkDelay = (VMutex::getLockDelayLoggingThreshold() >= VDuration::ZERO()) && ! mSuppressLogging;
+    const Vs64 start = checkDelay ? VTicks::snapshot() : 0;
+#endif
+
+    if (! VReadWriteLock::writeLock(&mLock)) {
+        this->_throwLockFailure("lock for writing");
+    }
+
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    if (checkDelay) {
+        const Vs64 end = VTicks::snapshot();
+        Vs64 waitTimeNanoseconds = end - start;
+        if (waitTimeNanoseconds >= VMutex::getLockDelayLoggingThreshold().getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_LEVEL(VMutex::getLockDelayLoggingLevel(), VSTRING_FORMAT("Delay: '%s' was blocked %s writing lock '%s'.",
+                                                                             (lockerName == NULL) ? "" : lockerName, VTicks::getDurationString(waitTimeNanoseconds).chars(), mName.chars()));
+        }
+
+        mLastWriterName = (lockerName == NULL) ? "" : lockerName;
+        mLastWriteLockTicks = end;
+    } else {
+        mLastWriteLockTicks = 0; // so that _writeUnlock() does not measure the hold time from a stale value
+    }
+#else
+    (void) lockerName; // only recorded for lock delay checking
+#endif
+
+    // As with VMutex, these are only for diagnostics, not for concurrency control.
+    mWriteLockThread = VThread::threadSelf();
+    mIsWriteLocked = true;
+}
+
+void VReadWriteLock::_writeUnlock() {
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+    if ((mLastWriteLockTicks != 0) && (VMutex::getLockDelayLoggingThreshold() >= VDuration::ZERO())) {
+        Vs64 delayNanoseconds = VTicks::snapshot() - mLastWriteLockTicks;
+        if (delayNanoseconds >= VMutex::getLockDelayLoggingThreshold().getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond) {
+            VLOGGER_LEVEL(VMutex::getLockDelayLoggingLevel(), VSTRING_FORMAT("Delay: '%s' is unlocking lock '%s' after writing for %s.",
+                                                                             mLastWriterName.chars(), mName.chars(), VTicks::getDurationString(delayNanoseconds).chars()));
+        }
+    }
+#endif
+
+    mIsWriteLocked = false; // Must set false before unlocking; see VMutex::_unlock().
+    if (! VReadWriteLock::writeUnlock(&mLock)) {
+        mIsWriteLocked = true; // Restore value since we failed to unlock.
+        this->_throwLockFailure("unlock after writing");
+    }
+}
+
+void VReadWriteLock::_throwLockFailure(const char* operation) const {
+    if (mName.isEmpty()) {
+        throw VStackTraceException(VSTRING_FORMAT("VReadWriteLock unable to %s.", operation));
+    } else {
+        throw VStackTraceException(VSTRING_FORMAT("VReadWriteLock unable to %s lock '%s'.", operation, mName.chars()));
+    }
+}
+
+// VReadLocker -----------------------------------------------------------------
+
+VReadLocker::VReadLocker(VReadWriteLock* lock, const char* name, bool lockInitially)
+    : mLock(lock)
+    , mIsLocked(false)
+    , mName(name)
+    {
+
+    if (lockInitially) {
+        this->lock();
+    }
+}
+
+VReadLocker::~VReadLocker() {
+    if (this->isLocked()) {
+        // Prevent all exceptions from escaping destructor.
+        try {
+            this->unlock();
+        } catch (...) {}
+    }
+
+    mLock = NULL;
+}
+
+void VReadLocker::lock() {
+    if (mLock != NULL) {
+        mLock->_readLock(mName); // specific friend access to private API
+        mIsLocked = true;
+    }
+}
+
+void VReadLocker::unlock() {
+    if ((mLock != NULL) && this->isLocked()) {
+        mLock->_readUnlock(); // specific friend access to private API
+        mIsLocked = false;
+    }
+}
+
+// VWriteLocker ----------------------------------------------------------------
+
+VWriteLocker::VWriteLocker(VReadWriteLock* lock, const char* name, bool lockInitially)
+    : mLock(lock)
+    , mIsLocked(false)
+    , mName(name)
+    {
+
+    if (lockInitially) {
+        this->lock();
+    }
+}
+
+VWriteLocker::~VWriteLocker() {
+    if (this->isLocked()) {
+        // Prevent all exceptions from escaping destructor.
+        try {
+            this->unlock();
+        } catch (...) {}
+    }
+
+    mLock = NULL;
+}
+
+void VWriteLocker::lock() {
+    if (mLock != NULL) {
+        mLock->_writeLock(mName); // specific friend access to private API
+        mIsLocked = true;
+    }
+}
+
+void VWriteLocker::unlock() {
+    if ((mLock != NULL) && this->isLocked()) {
+        mLock->_writeUnlock(); // specific friend access to private API
+        mIsLocked = false;
+    }
+}
@@ -0,0 +1,232 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vreadwritelock_h
+#define vreadwritelock_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vthread_platform.h"
+#include "vstring.h"
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VReadWriteLock implements a platform-independent reader-writer lock. Any
+number of threads may hold the lock for reading at the same time, while a
+thread holding it for writing excludes all others. Use it instead of a VMutex
+to protect a structure that is read far more often than it is changed, so
+that readers do not serialize behind one another.
+
+As with VMutex, you should not call the lock and unlock methods directly;
+use the helper classes VReadLocker and VWriteLocker, which guarantee the
+lock is released when they go out of scope, even if an exception is thrown.
+
+A thread must not acquire the lock for writing while it holds it for
+reading, or vice versa; it will deadlock. The lock is not recursive.
+
+The diagnostics are the same as VMutex: if VAULT_MUTEX_LOCK_DELAY_CHECK is
+compiled in, a delay in acquiring the lock, or a lengthy hold of the write
+lock, is logged according to VMutex::setLockDelayLoggingThreshold() and
+VMutex::setLockDelayLoggingLevel().
+
+@see VReadLocker
+@see VWriteLocker
+@see VMutex
+*/
+class VReadWriteLock {
+    public:
+
+        /**
+        Creates and initializes the lock with an optional name that can be
+        used when debugging lock behavior.
+        @param name             a name for the lock; should be unique to avoid confusion
+        @param suppressLogging  if this lock is specifically locked during logging, this flag
+                must be set so that VReadWriteLock doesn't try to log information
+                about this lock (avoids recursive locking deadlock)
+        */
+        VReadWriteLock(const VString& name = VString::EMPTY(), bool suppressLogging = false);
+        /**
+        Destructs the lock.
+        */
+        virtual ~VReadWriteLock();
+
+        /**
+        Sets the name of the lock, which is only used for diagnostic purposes.
+        @param name     a name for the lock; should be unique to avoid confusion
+        */
+        void setName(const VString& name);
+        /**
+        Returns the name of the lock.
+        @return the name
+        */
+        const VString& getName() const { return mName; }
+
+        /**
+        Returns a pointer to the raw OS lock handle.
+        @return    a pointer to the raw OS lock handle
+        */
+        VReadWriteLock_Type* getReadWriteLock();
+
+        /**
+        Returns true if the lock is held for writing by the current thread. Like
+        VMutex::isLockedByCurrentThread(), this is intended for asserting that
+        the current thread holds the lock. There is no equivalent for reading,
+        since any number of threads may hold the lock for reading.
+        @return true if the lock was locked for writing on the current thread
+        */
+        bool isWriteLockedByCurrentThread() const;
+
+        /* PLATFORM-SPECIFIC STATIC FUNCTIONS --------------------------------
+        The remaining functions defined here are the low-level interfaces to
+        the platform-specific threading APIs. These are implemented in each
+        platform-specific version of vthread_platform.cpp.
+        */
+
+        /**
+        Initializes the platform lock value.
+        Wrapper on Unix for pthread_rwlock_init.
+        @param    lock    pointer to the platform lock
+        @return true on success; false on failure
+        */
+        static bool readWriteLockInit(VReadWriteLock_Type* lock);
+        /**
+        Destroys the platform lock value.
+        Wrapper on Unix for pthread_rwlock_destroy.
+        @param    lock    pointer to the platform lock
+        */
+        static void readWriteLockDestroy(VReadWriteLock_Type* lock);
+        /**
+        Locks the platform lock value for reading.
+        Wrapper on Unix for pthread_rwlock_rdlock.
+        @return true on success; false on failure
+        */
+        static bool readLock(VReadWriteLock_Type* lock);
+        /**
+        Unlocks the platform lock value after reading.
+        Wrapper on Unix for pthread_rwlock_unlock.
+        @return true on success; false on failure
+        */
+        static bool readUnlock(VReadWriteLock_Type* lock);
+        /**
+        Locks the platform lock value for writing.
+        Wrapper on Unix for pthread_rwlock_wrlock.
+        @return true on success; false on failure
+        */
+        static bool writeLock(VReadWriteLock_Type* lock);
+        /**
+        Unlocks the platform lock value after writing.
+        Wrapper on Unix for pthread_rwlock_unlock.
+        @return true on success; false on failure
+        */
+        static bool writeUnlock(VReadWriteLock_Type* lock);
+
+    private:
+
+        VReadWriteLock(const VReadWriteLock&); // not copyable
+        VReadWriteLock& operator=(const VReadWriteLock&); // not assignable
+
+        // These are only accessible to the locker classes, and unit test.
+        friend class VReadLocker;
+        friend class VWriteLocker;
+        friend class VThreadsUnit;
+
+        void _readLock(const char* lockerName = NULL);  ///< Acquires the lock for reading. @param lockerName the name of the caller, for diagnostic purposes; may be NULL
+        void _readUnlock();                             ///< Releases the lock after reading.
+        void _writeLock(const char* lockerName = NULL); ///< Acquires the lock for writing. @param lockerName the name of the caller, for diagnostic purposes; may be NULL
+        void _writeUnlock();                            ///< Releases the lock after writing.
+
+        /**
+        Throws an exception describing a failure of the platform lock.
+        @param  operation   the operation that failed
+        */
+        void _throwLockFailure(const char* operation) const;
+
+        VReadWriteLock_Type     mLock;              ///< The OS lock handle.
+        VString                 mName;              ///< The name of this lock for diagnostic purposes.
+        bool                    mSuppressLogging;   ///< True if this lock must not call logger functions.
+        volatile VThreadID_Type mWriteLockThread;   ///< If locked for writing, the thread that acquired the lock.
+        volatile bool           mIsWriteLocked;     ///< For use only by isWriteLockedByCurrentThread(); value may change concurrently.
+#ifdef VAULT_MUTEX_LOCK_DELAY_CHECK
+        VString                 mLastWriterName;    ///< The name of the last (or current) caller of _writeLock().
+        Vs64                    mLastWriteLockTicks; ///< When the write lock was last acquired, as a VTicks::snapshot() value; 0 if it was not checked.
+#endif
+};
+
+/**
+VReadLocker acquires a VReadWriteLock for reading, and releases it when
+destructed, in the manner of VMutexLocker.
+*/
+class VReadLocker {
+    public:
+
+        /**
+        Constructs the locker, and if specified, acquires the lock for reading.
+        @param    lock             the VReadWriteLock to lock, or NULL if no action is wanted
+        @param    name             the locker name, for diagnostics; a string literal, since it is not copied
+        @param    lockInitially    true if the lock should be acquired on construction
+        */
+        VReadLocker(VReadWriteLock* lock, const char* name, bool lockInitially = true);
+        /**
+        Destructor, unlocks the lock if this object has acquired it.
+        */
+        virtual ~VReadLocker();
+
+        virtual void lock();    ///< Acquires the lock for reading, blocking while a writer holds it.
+        virtual void unlock();  ///< Releases the lock.
+        bool isLocked() const { return mIsLocked; } ///< Returns true if this object has acquired the lock. @return obvious
+        VReadWriteLock* getReadWriteLock() { return mLock; } ///< Returns the lock. @return the lock (may be NULL)
+
+    private:
+
+        VReadLocker(const VReadLocker& other); // not copyable
+        VReadLocker& operator=(const VReadLocker& other); // not assignable
+
+        VReadWriteLock* mLock;      ///< Pointer to the lock, or NULL.
+        bool            mIsLocked;  ///< True if this object has acquired the lock.
+        const char*     mName;      ///< The name of this locker, for diagnostic purposes.
+};
+
+/**
+VWriteLocker acquires a VReadWriteLock for writing, and releases it when
+destructed, in the manner of VMutexLocker.
+*/
+class VWriteLocker {
+    public:
+
+        /**
+        Constructs the locker, and if specified, acquires the lock for writing.
+        @param    lock             the VReadWriteLock to lock, or NULL if no action is wanted
+        @param    name             the locker name, for diagnostics; a string literal, since it is not copied
+        @param    lockInitially    true if the lock should be acquired on construction
+        */
+        VWriteLocker(VReadWriteLock* lock, const char* name, bool lockInitially = true);
+        /**
+        Destructor, unlocks the lock if this object has acquired it.
+        */
+        virtual ~VWriteLocker();
+
+        virtual void lock();    ///< Acquires the lock for writing, blocking while any reader or writer holds it.
+        virtual void unlock();  ///< Releases the lock.
+        bool isLocked() const { return mIsLocked; } ///< Returns true if this object has acquired the lock. @return obvious
+        VReadWriteLock* getReadWriteLock() { return mLock; } ///< Returns the lock. @return the lock (may be NULL)
+
+    private:
+
+        VWriteLocker(const VWriteLocker& other); // not copyable
+        VWriteLocker& operator=(const VWriteLocker& other); // not assignable
+
+        VReadWriteLock* mLock;      ///< Pointer to the lock, or NULL.
+        bool            mIsLocked;  ///< True if this object has acquired the lock.
+        const char*     mName;      ///< The name of this locker, for diagnostic purposes.
+};
+
+#endif /* vreadwritelock_h */
@@ -11,6 +11,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vexception.h"
 #include "vmutex.h"
+#include "vinstant.h"
 
 VSemaphore::VSemaphore()
     : mSemaphore()
@@ -26,7 +27,11 @@ VSemaphore::~VSemaphore() {
 }
 
 void VSemaphore::wait(VMutex* ownedMutex, const VDuration& timeoutInterval) {
-    if (! VSemaphore::semaphoreWait(&mSemaphore, ownedMutex->getMutex(), timeoutInterval)) {
+    this->waitNanoseconds(ownedMutex, timeoutInterval.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond);
+}
+
+void VSemaphore::waitNanoseconds(VMutex* ownedMutex, Vs64 timeoutNanoseconds) {
+    if (! VSemaphore::semaphoreWait(&mSemaphore, ownedMutex->getMutex(), timeoutNanoseconds)) {
         throw VStackTraceException("VSemaphore::wait unable to wait on semaphore.");
     }
 }
@@ -37,3 +42,8 @@ void VSemaphore::signal() {
     }
 }
 
+void VSemaphore::broadcast() {
+    if (! VSemaphore::semaphoreBroadcast(&mSemaphore)) {
+        throw VStackTraceException("VSemaphore::broadcast unable to broadcast semaphore.");
+    }
+}
@@ -41,7 +41,10 @@ class VSemaphore {
         virtual ~VSemaphore();
 
         /**
-        Waits until the semaphore is signaled by another thread.
+        Waits until the semaphore is signaled by another thread. The timeout is
+        measured on a monotonic clock, so it is not stretched or cut short if the
+        wall clock is set, whether by NTP, an administrator, or VInstant's simulated
+        clock offset.
         @param    ownedMutex    the mutex that the caller has already
                             acquired the lock for
         @param    timeoutInterval    zero for no timeout; otherwise, the amount
@@ -49,11 +52,25 @@ class VSemaphore {
         */
         void wait(VMutex* ownedMutex, const VDuration& timeoutInterval);
         /**
+        Waits until the semaphore is signaled by another thread, with a timeout
+        finer than VDuration's milliseconds. Otherwise the same as wait().
+        @param    ownedMutex    the mutex that the caller has already
+                            acquired the lock for
+        @param    timeoutNanoseconds    zero for no timeout; otherwise, the number
+                            of nanoseconds after which to timeout
+        */
+        void waitNanoseconds(VMutex* ownedMutex, Vs64 timeoutNanoseconds);
+        /**
         Signals the semaphore; if one or more other threads is waiting on
         the semaphore, exactly one of them will become unblocked by its
         wait() call returning.
         */
         void signal();
+        /**
+        Signals the semaphore so that all threads waiting on it become
+        unblocked by their wait() calls returning.
+        */
+        void broadcast();
 
         /* PLATFORM-SPECIFIC STATIC FUNCTIONS --------------------------------
         The remaining functions defined here are the low-level interfaces to
@@ -63,7 +80,7 @@ class VSemaphore {
 
         /**
         Initializes the platform semaphore value.
-        Wrapper on Unix for pthread_cond_init.
+        Wrapper on Unix for pthread_cond_init, and on Windows for InitializeConditionVariable.
         @param    semaphore    pointer to the platform semaphore
         @return true on success; false on failure
         */
@@ -71,7 +88,7 @@ class VSemaphore {
 
         /**
         Destroys the platform semaphore value.
-        Wrapper on Unix for pthread_cond_semaphore.
+        Wrapper on Unix for pthread_cond_semaphore; nothing to do on Windows.
         @param    semaphore    pointer to the platform semaphore
         @return true on success; false on failure
         */
@@ -79,20 +96,21 @@ class VSemaphore {
 
         /**
         Waits on the platform semaphore value.
-        Wrapper on Unix for pthread_cond_wait.
+        Wrapper on Unix for pthread_cond_wait, and pthread_cond_timedwait on a
+        monotonic clock; and on Windows for SleepConditionVariableCS.
         @param    semaphore    pointer to the platform semaphore
         @param    mutex        pointer to a locked platform mutex that the calling
                             thread had acquired; this function unlocks it while
                             waiting and locks it upon return
-        @param    timeoutInterval    zero for no timeout; otherwise, the interval after
-                            which to timeout
+        @param    timeoutNanoseconds    zero for no timeout; otherwise, the interval
+                            in nanoseconds after which to timeout
         @return true on success; false on failure; timeout is considered success
         */
-        static bool semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* mutex, const VDuration& timeoutInterval);
+        static bool semaphoreWait(VSemaphore_Type* semaphore, VMutex_Type* mutex, Vs64 timeoutNanoseconds);
 
         /**
         Signals the platform semaphore value.
-        Wrapper on Unix for pthread_cond_signal.
+        Wrapper on Unix for pthread_cond_signal, and on Windows for WakeConditionVariable.
         @param    semaphore    pointer to the platform semaphore
         @return true on success; false on failure
         */
@@ -101,7 +119,7 @@ class VSemaphore {
         /**
         Broadcasts a signal the platform semaphore value; all threads waiting
         on the semaphore will unblock.
-        Wrapper on Unix for pthread_cond_broadcast.
+        Wrapper on Unix for pthread_cond_broadcast, and on Windows for WakeAllConditionVariable.
         @param    semaphore    pointer to the platform semaphore
         @return true on success; false on failure
         */
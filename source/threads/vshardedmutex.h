@@ -0,0 +1,125 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vshardedmutex_h
+#define vshardedmutex_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vmutex.h"
+#include "vstring.h"
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VShardedMutex holds N mutexes and picks one by the hash of a key, so that
+operations on a structure that is partitioned by key, such as a map of
+sessions by ID, only contend when their keys fall in the same shard. The
+structure itself must of course be partitioned the same way, for example
+by keeping N maps and using getShardIndex() to pick both the map and its
+mutex.
+
+Each shard is an ordinary VMutex, with the same diagnostics, named after the
+sharded mutex with its index appended. Lock a shard with VMutexLocker:
+
+<code>
+VMutexLocker locker(&mSessionLocks.getMutex(sessionID), "MyServer::findSession");
+</code>
+
+Each shard is allocated separately, with a cache line of padding on either
+side of its mutex, so that threads locking different shards do not also
+contend for the same cache line. The padding is explicit rather than an
+alignas() because operator new does not honor over-alignment before C++17.
+*/
+template <int N>
+class VShardedMutex {
+    public:
+
+        /**
+        Creates the shard mutexes.
+        @param name             a name for the sharded mutex; each shard's name has its index appended
+        @param suppressLogging  passed to each shard's VMutex constructor; see VMutex
+        */
+        VShardedMutex(const VString& name = VString::EMPTY(), bool suppressLogging = false) {
+            for (int i = 0; i < N; ++i) {
+                mShards[i] = new Shard(VSTRING_FORMAT("%s[%d]", name.chars(), i), suppressLogging);
+            }
+        }
+        /**
+        Destroys the shard mutexes.
+        */
+        ~VShardedMutex() {
+            for (int i = 0; i < N; ++i) {
+                delete mShards[i];
+            }
+        }
+
+        static int getNumShards() { return N; } ///< Returns the number of shards. @return N
+
+        /**
+        Returns the index of the shard for a string key.
+        @param  key the key
+        @return an index from 0 to N-1
+        */
+        static int getShardIndex(const VString& key) {
+            // FNV-1a
+            Vu32 hash = 2166136261U;
+            const char* chars = key.chars();
+            for (int i = 0; i < key.length(); ++i) {
+                hash = (hash ^ static_cast<Vu8>(chars[i])) * 16777619U;
+            }
+
+            return static_cast<int>(hash % static_cast<Vu32>(N));
+        }
+        /**
+        Returns the index of the shard for an integer key. The key is mixed first,
+        so that keys that differ only in their high bits, or are all multiples of N,
+        are still spread across the shards.
+        @param  key the key
+        @return an index from 0 to N-1
+        */
+        static int getShardIndex(Vs64 key) {
+            // The MurmurHash3 64-bit finalizer.
+            Vu64 hash = static_cast<Vu64>(key);
+            hash ^= hash >> 33;
+            hash *= CONST_U64(0xFF51AFD7ED558CCD);
+            hash ^= hash >> 33;
+            hash *= CONST_U64(0xC4CEB9FE1A85EC53);
+            hash ^= hash >> 33;
+            return static_cast<int>(hash % static_cast<Vu64>(N));
+        }
+
+        VMutex& getMutex(const VString& key) { return mShards[getShardIndex(key)]->mMutex; }   ///< Returns the mutex for a string key. @param key the key @return the shard mutex
+        VMutex& getMutex(Vs64 key) { return mShards[getShardIndex(key)]->mMutex; }             ///< Returns the mutex for an integer key. @param key the key @return the shard mutex
+        VMutex& getShard(int index) { return mShards[index]->mMutex; }                         ///< Returns a shard mutex by index, for example to lock them all in order. @param index 0 to N-1 @return the shard mutex
+
+    private:
+
+        VShardedMutex(const VShardedMutex&); // not copyable
+        VShardedMutex& operator=(const VShardedMutex&); // not assignable
+
+        static const int kCacheLineSize = 64; ///< The cache line size we pad to; 64 bytes on current x86 and most ARM cores.
+
+        /**
+        One shard's mutex, padded so that nothing else allocated nearby shares its cache lines.
+        */
+        struct Shard {
+            Shard(const VString& name, bool suppressLogging) : mMutex(name, suppressLogging) {}
+
+            char    mLeadingPad[kCacheLineSize];    ///< Keeps the preceding allocation off the mutex's first cache line.
+            VMutex  mMutex;                         ///< The shard mutex.
+            char    mTrailingPad[kCacheLineSize];   ///< Keeps the following allocation off the mutex's last cache line.
+        };
+
+        Shard* mShards[N]; ///< The shards.
+};
+
+#endif /* vshardedmutex_h */
@@ -16,9 +16,10 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vmutexlocker.h"
 #include "vbento.h"
 
-// This private map allows us to keep track of all VThread objects, and therefore to
-// find the current thread's VThread object from the thread ID. We also have an API
-// to get info about all these threads.
+// This private map allows us to keep track of all VThread objects, so that we can find
+// a thread by its ID, and have an API to get info about all these threads. The current
+// thread's VThread is found through thread-local storage instead (see gCurrentThread),
+// so that logging, which wants it for every line, does not contend for this map's lock.
 typedef std::map<VThreadID_Type, VThread*> VThreadIDToVThreadMap;
 VThreadIDToVThreadMap gVThreadIDToVThreadMap;
 static VMutex gVThreadMapMutex("gVThreadMapMutex", true/*suppress logging because logging itself uses this*/);
@@ -48,18 +49,12 @@ class VStandinThread : public VThread {
 
 static VStandinThread gStandinThread;
 
-static VThread* _getCurrentVThread() {
-    VThreadID_Type currentThreadID = VThread::threadSelf();
-    VMutexLocker locker(&gVThreadMapMutex, "_getCurrentVThread");
-    VThreadIDToVThreadMap::const_iterator position = gVThreadIDToVThreadMap.find(currentThreadID);
-    if (position == gVThreadIDToVThreadMap.end())
-        return &gStandinThread; // If called from main thread, or non-VThread-derived thread, we won't find a VThread. This allows us to return something workable to any caller.
+// Each thread's own VThread, so that finding the current thread needs neither the map nor its lock.
+// Set by threadMain(), and by VMainThread and VForeignThread, which are constructed on their thread.
+static thread_local VThread* gCurrentThread = NULL;
 
-    return (*position).second;
-    // Note: once we return, the thread could stop.
-    // But since this is called from the current thread, it really can't disappear while caller lives.
-    // It just can't be passed around to other threads!
-}
+// For a thread that has no VThread, its name as returned by getCurrentThreadName(), formatted on first use.
+static thread_local VString gCurrentThreadIDName;
 
 VThread::VThread(const VString& name, const VString& loggerName, bool deleteAtEnd, bool createDetached, VManagementInterface* manager)
     : mIsDeleted(false)
@@ -70,6 +65,7 @@ VThread::VThread(const VString& name, const VString& loggerName, bool deleteAtEn
     , mManager(manager)
     , mThreadID((VThreadID_Type) - 1)
     , mIsRunning(false)
+    , mOptions()
     {
 }
 
@@ -91,7 +87,7 @@ void VThread::start() {
     mIsRunning = true;
 
     try {
-        VThread::threadCreate(&mThreadID, mCreateDetached, VThread::userThreadMain, (void*) this);
+        VThread::threadCreate(&mThreadID, mCreateDetached, mOptions.getStackSize(), VThread::userThreadMain, (void*) this);
     } catch (...) {
         mIsRunning = false;
         throw;
@@ -145,8 +141,13 @@ void* VThread::threadMain(void* arg) {
 
     VManagementInterface* manager = thread->getManagementInterface();
 
+    gCurrentThread = thread;
+
     try {
         VAutoreleasePool pool;
+        // The creating thread sets mThreadID when threadCreate() returns, which may be after we
+        // get here; set it ourselves so that we are registered under the right ID.
+        thread->mThreadID = VThread::threadSelf();
         _vthreadStarting(thread);
         VThread::_threadStarting(thread);
 
@@ -175,6 +176,7 @@ void* VThread::threadMain(void* arg) {
 
     VThread::_threadEnded(thread);
     _vthreadEnded(thread);
+    gCurrentThread = NULL;
 
     if (deleteAtEnd) {
         delete thread;
@@ -187,20 +189,27 @@ void* VThread::threadMain(void* arg) {
 
 // static
 VThread* VThread::getCurrentThread() {
-    return _getCurrentVThread();
+    // If called from main thread, or non-VThread-derived thread, we won't have a VThread. This allows us to return something workable to any caller.
+    return (gCurrentThread == NULL) ? &gStandinThread : gCurrentThread;
+    // Note: once we return, the thread could stop.
+    // But since this is called from the current thread, it really can't disappear while caller lives.
+    // It just can't be passed around to other threads!
 }
 
 // static
-VString VThread::getCurrentThreadName() {
-    VThread* currentThread = VThread::getCurrentThread();
-    if (currentThread != &gStandinThread) {
-        return currentThread->getName();
+const VString& VThread::getCurrentThreadName() {
+    if (gCurrentThread != NULL) {
+        return gCurrentThread->getName();
+    }
+
+    // There is only the stand-in thread for non-VThread threads. Its name is meaningless.
+    // Format the current OS thread ID, once per thread.
+    if (gCurrentThreadIDName.isEmpty()) {
+        Vs64 id64 = (Vs64) VThread::threadSelf();
+        gCurrentThreadIDName = VSTRING_S64(id64);
     }
 
-    // It's the stand-in thread for non-VThread threads. Its name is meaningless.
-    // Format the current OS thread ID.
-    Vs64 id64 = (Vs64) VThread::threadSelf();
-    return VSTRING_S64(id64);
+    return gCurrentThreadIDName;
 }
 
 // static
@@ -218,6 +227,7 @@ void VThread::getThreadsInfo(VBentoNode& bento) {
         child->addBool("deleteAtEnd", thread->mDeleteAtEnd);
         child->addBool("createdDetached", thread->mCreateDetached);
         child->addBool("hasManager", thread->mManager != NULL);
+        thread->getThreadInfo(*child);
     }
 }
 
@@ -262,10 +272,14 @@ VMainThread::VMainThread()
     {
     mThreadID = VThread::threadSelf();
     _vthreadStarting(this); // Register this object for lookup by mThreadID.
+    gCurrentThread = this;
 }
 
 VMainThread::~VMainThread() {
     _vthreadEnded(this); // De-register this object.
+    if (gCurrentThread == this) {
+        gCurrentThread = NULL;
+    }
 }
 
 void VMainThread::start() {
@@ -285,10 +299,14 @@ VForeignThread::VForeignThread(const VString& name)
     {
     mThreadID = VThread::threadSelf();
     _vthreadStarting(this); // Register this object for lookup by mThreadID.
+    gCurrentThread = this;
 }
 
 VForeignThread::~VForeignThread() {
     _vthreadEnded(this); // De-register this object.
+    if (gCurrentThread == this) {
+        gCurrentThread = NULL;
+    }
 }
 
 void VForeignThread::start() {
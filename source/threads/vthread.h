@@ -89,6 +89,74 @@ class VBentoNode;
     @ingroup vthread
 */
 
+/**
+VThreadOptions holds the operating system attributes that a VThread is
+created with: its stack size, the CPUs it may run on, and its scheduling
+policy. Default-constructed, every attribute is the platform default. Set
+a thread's options with VThread::setOptions() before starting it; or set
+them on a VSocketThreadFactory or VClientSessionFactory to apply them to
+every thread it creates.
+
+The stack size is the most useful of these for servers with many
+sessions: each session has one or two threads, and by default each
+thread reserves the platform's default stack (8 MB on Linux), which
+dominates the process's virtual memory long before the memory is used.
+*/
+class VThreadOptions {
+    public:
+
+        /**
+        The scheduling policies a thread can be given. Not all are available on all
+        platforms; the real-time policies usually require privileges. If a policy
+        cannot be applied, the thread runs anyway with the default, and a warning is
+        logged.
+        */
+        enum SchedulingPolicy {
+            kSchedulingDefault,     ///< The platform's normal time-sharing policy.
+            kSchedulingBatch,       ///< Time-sharing, for CPU-bound threads that are not latency sensitive (Linux SCHED_BATCH).
+            kSchedulingIdle,        ///< Runs only when the CPU would otherwise be idle (Linux SCHED_IDLE).
+            kSchedulingFIFO,        ///< Real-time, first-in first-out, at the scheduling priority (SCHED_FIFO).
+            kSchedulingRoundRobin   ///< Real-time, round-robin, at the scheduling priority (SCHED_RR).
+        };
+
+        VThreadOptions() : mStackSize(0), mCPUAffinityMask(0), mSchedulingPolicy(kSchedulingDefault), mSchedulingPriority(0) {}
+        ~VThreadOptions() {}
+
+        /**
+        Sets the stack size. It is rounded up to the platform's minimum and page size.
+        @param  stackSize   the stack size in bytes; 0 means the platform default
+        */
+        void setStackSize(size_t stackSize) { mStackSize = stackSize; }
+        size_t getStackSize() const { return mStackSize; } ///< Returns the stack size; 0 means the platform default. @return obvious
+        /**
+        Sets the CPUs the thread may run on.
+        @param  cpuAffinityMask bit i set allows CPU i; 0 means any CPU
+        */
+        void setCPUAffinityMask(Vu64 cpuAffinityMask) { mCPUAffinityMask = cpuAffinityMask; }
+        Vu64 getCPUAffinityMask() const { return mCPUAffinityMask; } ///< Returns the CPU affinity mask; 0 means any CPU. @return obvious
+        /**
+        Sets the scheduling policy.
+        @param  policy      the policy
+        @param  priority    for the real-time policies, the priority within the policy (1-99 on Linux); otherwise ignored
+        */
+        void setScheduling(SchedulingPolicy policy, int priority = 0) { mSchedulingPolicy = policy; mSchedulingPriority = priority; }
+        SchedulingPolicy getSchedulingPolicy() const { return mSchedulingPolicy; } ///< Returns the scheduling policy. @return obvious
+        int getSchedulingPriority() const { return mSchedulingPriority; } ///< Returns the real-time scheduling priority. @return obvious
+
+        /**
+        Returns true if every attribute is the platform default.
+        @return obvious
+        */
+        bool isDefault() const { return (mStackSize == 0) && (mCPUAffinityMask == 0) && (mSchedulingPolicy == kSchedulingDefault); }
+
+    private:
+
+        size_t              mStackSize;             ///< The stack size in bytes; 0 means the platform default.
+        Vu64                mCPUAffinityMask;       ///< Bit i set allows CPU i; 0 means any CPU.
+        SchedulingPolicy    mSchedulingPolicy;      ///< The scheduling policy.
+        int                 mSchedulingPriority;    ///< The priority within a real-time policy.
+};
+
 /**
 VThread is class that provides an easy way to create a thread of execution.
 
@@ -282,6 +350,24 @@ class VThread {
         @return the thread's logger name
         */
         const VString& getLoggerName() const { return mLoggerName; }
+        /**
+        Sets the operating system attributes the thread is created with. Has no effect
+        on a thread that has already been started.
+        @param  options the options
+        */
+        void setOptions(const VThreadOptions& options) { mOptions = options; }
+        /**
+        Returns the operating system attributes the thread is, or will be, created with.
+        @return the options
+        */
+        const VThreadOptions& getOptions() const { return mOptions; }
+        /**
+        Adds attributes describing this thread to its node in getThreadsInfo(), beyond
+        the ones that every thread has. The default implementation adds nothing.
+        Called with the thread map locked, so it must not block.
+        @param  threadNode  the thread's node
+        */
+        virtual void getThreadInfo(VBentoNode& /*threadNode*/) const {}
 
         /**
         The main function that invokes the thread's run() and cleans up when
@@ -329,11 +415,12 @@ class VThread {
         Wrapper on Unix for pthread_create.
         @param    threadID            pointer to where to return the new thread's ID
         @param    createDetached        true to create the thread in detached state; false if not.
+        @param    stackSize            the stack size in bytes; 0 means the platform default
         @param    threadMainProcPtr    the thread main function that will be invoked
         @param    threadArgument        the argument to be passed to the thread main
         @throws VException if the thread cannot be created
         */
-        static void threadCreate(VThreadID_Type* threadID, bool createDetached, threadMainFunction threadMainProcPtr, void* threadArgument);
+        static void threadCreate(VThreadID_Type* threadID, bool createDetached, size_t stackSize, threadMainFunction threadMainProcPtr, void* threadArgument);
 
         /**
         Terminates the current thread. This could be called from anywhere, but
@@ -372,6 +459,7 @@ class VThread {
         Returns the current thread's VThread. If the current thread is main or a thread that
         was not created using VThread, a dummy "stand-in" object is returned, that is not actually
         running or having a valid thread ID. But this means we guarantee to not return NULL.
+        The VThread is kept in thread-local storage, so this takes no lock.
         */
         static VThread* getCurrentThread();
 
@@ -379,9 +467,12 @@ class VThread {
         This is a preferred alternative to getCurrentThread()->getName() to handle the case where
         it is called from a thread that was not created with a VThread. It is smart enough to
         return a name converted from the thread ID, rather than using the dummy "stand-in" thread
-        object that has a single name.
+        object that has a single name. It takes no lock and, after the first call on a thread
+        that has no VThread, does not allocate; it is called for every log line that shows the
+        thread name.
+        @return the current thread's name; valid only on the current thread, until its name changes
         */
-        static VString getCurrentThreadName();
+        static const VString& getCurrentThreadName();
 
         /**
         Sets the current thread's priority, specifying the Unix nice level.
@@ -390,6 +481,37 @@ class VThread {
         @return true on success; false on failure
         */
         static bool setPriority(int nice);
+        /**
+        Binds the current thread to one CPU, so that the scheduler does not migrate
+        it to another and its cache stays warm.
+        Wrapper on Linux for pthread_setaffinity_np; on Windows for SetThreadAffinityMask.
+        Not supported on other platforms.
+        @param  cpuIndex    the zero-based CPU index
+        @return true on success; false on failure, or if not supported
+        */
+        static bool setCurrentThreadAffinity(int cpuIndex);
+        /**
+        Restricts the current thread to a set of CPUs.
+        Wrapper on Linux for pthread_setaffinity_np; on Windows for SetThreadAffinityMask.
+        Not supported on other platforms.
+        @param  cpuAffinityMask bit i set allows CPU i
+        @return true on success; false on failure, or if not supported
+        */
+        static bool setCurrentThreadAffinityMask(Vu64 cpuAffinityMask);
+        /**
+        Sets the scheduling policy of the current thread.
+        Wrapper on Unix for pthread_setschedparam; on Windows, SetThreadPriority
+        approximates the policies.
+        @param  policy      the policy
+        @param  priority    for the real-time policies, the priority within the policy
+        @return true on success; false on failure, or if the policy is not supported
+        */
+        static bool setCurrentThreadScheduling(VThreadOptions::SchedulingPolicy policy, int priority);
+        /**
+        Returns the number of CPUs that are online.
+        @return the number of CPUs; at least 1
+        */
+        static int getNumberOfProcessors();
 
         /**
         Blocks the current thread for a specified number of milliseconds.
@@ -418,6 +540,7 @@ class VThread {
         VManagementInterface*   mManager;           ///< The VManagementInterface that manages us, or NULL.
         VThreadID_Type          mThreadID;          ///< The OS-specific thread ID value.
         volatile bool           mIsRunning;         ///< The running state of the thread (@see isRunning()).
+        VThreadOptions          mOptions;           ///< The operating system attributes the thread is created with.
 
     private:
 
@@ -426,9 +549,9 @@ class VThread {
         VThread& operator=(const VThread& other);
 
         // These two function are implemented in the platform-specific code to perform any
-        // necessary per-thread bookkeeping. They are called from VThread::threadMain() just
-        // before and after the corresponding VManagementInterface threadStarting() and
-        // threadEnded() calls.
+        // necessary per-thread bookkeeping, and _threadStarting() applies the thread's affinity
+        // and scheduling options. They are called from VThread::threadMain() just before and
+        // after the corresponding VManagementInterface threadStarting() and threadEnded() calls.
         static void _threadStarting(const VThread* thread);
         static void _threadEnded(const VThread* thread);
 };
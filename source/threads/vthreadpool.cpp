@@ -0,0 +1,421 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vthreadpool.h"
+
+#include "vthread.h"
+#include "vmutexlocker.h"
+#include "vexception.h"
+#include "vlogger.h"
+#include "vbento.h"
+
+#include <deque>
+
+static const VString kLoggerName("vault.threads.VThreadPool");
+
+// VThreadPoolTask -------------------------------------------------------------
+
+VThreadPoolTask::VThreadPoolTask(const VString& name, Priority priority)
+    : mName(name)
+    , mPriority(((priority < kPriorityHigh) || (priority >= kNumPriorities)) ? kPriorityNormal : priority)
+    , mMutex("VThreadPoolTask::mMutex", true/*suppress logging; it is held across the waits for completion*/)
+    , mCompletedSemaphore()
+    , mIsCompleted(false)
+    , mFailed(false)
+    , mErrorMessage()
+    {
+}
+
+VThreadPoolTask::~VThreadPoolTask() {
+}
+
+void VThreadPoolTask::waitUntilCompleted() {
+    if (mIsCompleted.load()) {
+        return;
+    }
+
+    VMutexLocker locker(&mMutex, "VThreadPoolTask::waitUntilCompleted");
+    while (! mIsCompleted.load()) {
+        mCompletedSemaphore.wait(&mMutex, VDuration::ZERO());
+    }
+}
+
+bool VThreadPoolTask::waitUntilCompleted(const VDuration& timeoutInterval) {
+    if (mIsCompleted.load()) {
+        return true;
+    }
+
+    const Vs64 deadline = VTicks::snapshot() + timeoutInterval.getDurationMilliseconds() * VTicks::kNanosecondsPerMillisecond;
+    VMutexLocker locker(&mMutex, "VThreadPoolTask::waitUntilCompleted");
+    while (! mIsCompleted.load()) {
+        Vs64 remaining = deadline - VTicks::snapshot();
+        if (remaining <= 0) {
+            break;
+        }
+
+        mCompletedSemaphore.waitNanoseconds(&mMutex, remaining);
+    }
+
+    return mIsCompleted.load();
+}
+
+bool VThreadPoolTask::isCompleted() const {
+    return mIsCompleted.load();
+}
+
+bool VThreadPoolTask::hasFailed() const {
+    VMutexLocker locker(&mMutex, "VThreadPoolTask::hasFailed");
+    return mFailed;
+}
+
+VString VThreadPoolTask::getErrorMessage() const {
+    VMutexLocker locker(&mMutex, "VThreadPoolTask::getErrorMessage");
+    return mErrorMessage;
+}
+
+void VThreadPoolTask::_execute() {
+    VString errorMessage;
+    try {
+        this->run();
+    } catch (const VException& ex) {
+        errorMessage.format("Task '%s' threw exception #%d '%s'.", mName.chars(), ex.getError(), ex.what());
+    } catch (const std::exception& ex) {
+        errorMessage.format("Task '%s' threw exception '%s'.", mName.chars(), ex.what());
+    } catch (...) {
+        errorMessage.format("Task '%s' threw unknown exception.", mName.chars());
+    }
+
+    if (errorMessage.isNotEmpty()) {
+        VLOGGER_NAMED_ERROR(kLoggerName, errorMessage);
+    }
+
+    this->_complete(errorMessage);
+}
+
+void VThreadPoolTask::_complete(const VString& errorMessage) {
+    VMutexLocker locker(&mMutex, "VThreadPoolTask::_complete");
+    mFailed = errorMessage.isNotEmpty();
+    mErrorMessage = errorMessage;
+    locker.unlock();
+
+    try {
+        this->completed();
+    } catch (const std::exception& ex) {
+        VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("Task '%s' completed() threw exception '%s'.", mName.chars(), ex.what()));
+    } catch (...) {
+        VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("Task '%s' completed() threw unknown exception.", mName.chars()));
+    }
+
+    locker.lock();
+    mIsCompleted.store(true);
+    mCompletedSemaphore.broadcast();
+}
+
+// VThreadPoolWorker -----------------------------------------------------------
+
+/**
+A worker thread of a VThreadPool, and its queues of tasks. The worker takes tasks
+from the front of its own queues; other workers steal from the back.
+*/
+class VThreadPoolWorker : public VThread {
+    public:
+
+        VThreadPoolWorker(VThreadPool& pool, int index, VManagementInterface* manager) :
+            VThread(VSTRING_FORMAT("VThreadPool.%s.%d", pool.getName().chars(), index), kLoggerName, kDontDeleteSelfAtEnd, kCreateThreadJoinable, manager),
+            mPool(pool),
+            mIndex(index),
+            mQueueMutex(VSTRING_FORMAT("VThreadPool(%s)[%d]::mQueueMutex", pool.getName().chars(), index)),
+            mNumTasksRun(0),
+            mNumTasksStolen(0) {
+
+            for (int priority = 0; priority < VThreadPoolTask::kNumPriorities; ++priority) {
+                mNumQueued[priority].store(0);
+            }
+        }
+
+        virtual ~VThreadPoolWorker() {}
+
+        virtual void run() {
+            if (mPool.mPinWorkersToCPUs) {
+                int cpuIndex = mIndex % VThread::getNumberOfProcessors();
+                if (! VThread::setCurrentThreadAffinity(cpuIndex)) {
+                    VLOGGER_NAMED_WARN(mLoggerName, VSTRING_FORMAT("[%s] VThreadPoolWorker: Unable to pin thread to CPU %d.", mName.chars(), cpuIndex));
+                }
+            }
+
+            while (! mPool.mIsStopped.load()) {
+                VThreadPoolTaskPtr task = mPool._takeTask(*this);
+                if (task == nullptr) {
+                    mPool._waitForWork();
+                } else {
+                    task->_execute();
+                    ++mNumTasksRun;
+                }
+            }
+        }
+
+        virtual void getThreadInfo(VBentoNode& threadNode) const {
+            threadNode.addString("pool", mPool.getName());
+            threadNode.addInt("poolWorkerIndex", mIndex);
+            threadNode.addInt("poolQueuedTasks", this->getNumQueued());
+            threadNode.addS64("poolTasksRun", mNumTasksRun.load());
+            threadNode.addS64("poolTasksStolen", mNumTasksStolen.load());
+        }
+
+        void push(VThreadPoolTaskPtr task) {
+            const int priority = static_cast<int>(task->getPriority());
+            VMutexLocker locker(&mQueueMutex, "VThreadPoolWorker::push");
+            mQueues[priority].push_back(task);
+            ++mNumQueued[priority];
+            ++mPool.mNumQueuedTasks;
+        }
+
+        VThreadPoolTaskPtr pop(int priority, bool fromBack) {
+            // Skip the lock when there is evidently nothing to take; the count is rechecked under it.
+            if (mNumQueued[priority].load() == 0) {
+                return VThreadPoolTaskPtr();
+            }
+
+            VMutexLocker locker(&mQueueMutex, "VThreadPoolWorker::pop");
+            std::deque<VThreadPoolTaskPtr>& queue = mQueues[priority];
+            if (queue.empty()) {
+                return VThreadPoolTaskPtr();
+            }
+
+            VThreadPoolTaskPtr task;
+            if (fromBack) {
+                task = queue.back();
+                queue.pop_back();
+            } else {
+                task = queue.front();
+                queue.pop_front();
+            }
+
+            --mNumQueued[priority];
+            --mPool.mNumQueuedTasks;
+            return task;
+        }
+
+        int getNumQueued() const {
+            int numQueued = 0;
+            for (int priority = 0; priority < VThreadPoolTask::kNumPriorities; ++priority) {
+                numQueued += mNumQueued[priority].load();
+            }
+
+            return numQueued;
+        }
+
+        VThreadPool&                    mPool;                                          ///< The pool we belong to.
+        const int                       mIndex;                                         ///< Our index in the pool.
+        VMutex                          mQueueMutex;                                    ///< Protects mQueues.
+        std::deque<VThreadPoolTaskPtr>  mQueues[VThreadPoolTask::kNumPriorities];       ///< Our queued tasks, by priority.
+        std::atomic<int>                mNumQueued[VThreadPoolTask::kNumPriorities];    ///< The size of each queue, readable without the lock.
+        std::atomic<Vs64>               mNumTasksRun;                                   ///< The number of tasks we have run.
+        std::atomic<Vs64>               mNumTasksStolen;                                ///< The number of those we stole from other workers.
+
+    private:
+
+        VThreadPoolWorker(const VThreadPoolWorker&); // not copyable
+        VThreadPoolWorker& operator=(const VThreadPoolWorker&); // not assignable
+};
+
+// VThreadPool -----------------------------------------------------------------
+
+static VMutex gSharedPoolMutex("gSharedPoolMutex");
+static VThreadPool* gSharedPool = NULL;
+
+// static
+VThreadPool& VThreadPool::getSharedPool() {
+    VMutexLocker locker(&gSharedPoolMutex, "VThreadPool::getSharedPool");
+
+    if (gSharedPool == NULL) {
+        gSharedPool = new VThreadPool("shared");
+        gSharedPool->start();
+    }
+
+    return *gSharedPool;
+}
+
+VThreadPool::VThreadPool(const VString& name, int numWorkers, bool pinWorkersToCPUs, VManagementInterface* manager)
+    : mName(name)
+    , mNumWorkers((numWorkers > 0) ? numWorkers : VThread::getNumberOfProcessors())
+    , mPinWorkersToCPUs(pinWorkersToCPUs)
+    , mManager(manager)
+    , mMutex(VSTRING_FORMAT("VThreadPool(%s)::mMutex", name.chars()))
+    , mWorkers()
+    , mIsStarted(false)
+    , mIsStopped(false)
+    , mNextWorkerIndex(0)
+    , mNumQueuedTasks(0)
+    , mNumIdleWorkers(0)
+    , mWorkSemaphore(0)
+    {
+
+    for (int i = 0; i < mNumWorkers; ++i) {
+        mWorkers.push_back(new VThreadPoolWorker(*this, i, mManager));
+    }
+}
+
+VThreadPool::~VThreadPool() {
+    this->stop();
+
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        delete *i;
+    }
+}
+
+void VThreadPool::start() {
+    VMutexLocker locker(&mMutex, "VThreadPool::start");
+
+    if (mIsStarted.load() || mIsStopped.load()) {
+        return;
+    }
+
+    mIsStarted.store(true);
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        (*i)->start();
+    }
+}
+
+void VThreadPool::stop() {
+    VMutexLocker locker(&mMutex, "VThreadPool::stop");
+
+    // The workers watch mIsStopped rather than being stop()ped, because VThread::join() returns
+    // at once for a thread that has been stop()ped.
+    if (! mIsStopped.exchange(true) && mIsStarted.load()) {
+        // Wake every idle worker so that it sees the pool has been stopped.
+        for (int i = 0; i < mNumWorkers; ++i) {
+            mWorkSemaphore.post();
+        }
+
+        for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+            (*i)->join();
+        }
+    }
+
+    locker.unlock();
+
+    this->_abandonQueuedTasks();
+}
+
+void VThreadPool::submit(VThreadPoolTaskPtr task) {
+    if (mIsStopped.load()) {
+        task->_complete(VSTRING_FORMAT("Task '%s' was not run because pool '%s' is stopped.", task->getName().chars(), mName.chars()));
+        return;
+    }
+
+    VThreadPoolWorker* worker = this->_getCurrentWorker();
+    if (worker == NULL) {
+        unsigned int index = static_cast<unsigned int>(mNextWorkerIndex.fetch_add(1));
+        worker = mWorkers[index % static_cast<unsigned int>(mNumWorkers)];
+    }
+
+    worker->push(task);
+
+    if (mNumIdleWorkers.load() > 0) {
+        mWorkSemaphore.post();
+    }
+
+    // If stop() drained the queues while we were pushing, don't leave the task stranded.
+    if (mIsStopped.load()) {
+        this->_abandonQueuedTasks();
+    }
+}
+
+int VThreadPool::getNumQueuedTasks() const {
+    return mNumQueuedTasks.load();
+}
+
+Vs64 VThreadPool::getNumTasksRun() const {
+    Vs64 numTasksRun = 0;
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        numTasksRun += (*i)->mNumTasksRun.load();
+    }
+
+    return numTasksRun;
+}
+
+Vs64 VThreadPool::getNumTasksStolen() const {
+    Vs64 numTasksStolen = 0;
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        numTasksStolen += (*i)->mNumTasksStolen.load();
+    }
+
+    return numTasksStolen;
+}
+
+void VThreadPool::getPoolInfo(VBentoNode& bento) const {
+    bento.addString("name", mName);
+    bento.addInt("workers", mNumWorkers);
+    bento.addBool("pinned", mPinWorkersToCPUs);
+    bento.addBool("running", mIsStarted.load() && ! mIsStopped.load());
+    bento.addInt("queuedTasks", this->getNumQueuedTasks());
+    bento.addS64("tasksRun", this->getNumTasksRun());
+    bento.addS64("tasksStolen", this->getNumTasksStolen());
+}
+
+VThreadPoolTaskPtr VThreadPool::_takeTask(VThreadPoolWorker& worker) {
+    // Try each priority in turn, own queue first, so that a high priority task
+    // queued on another worker runs before a lower priority one queued on ours.
+    for (int priority = 0; priority < VThreadPoolTask::kNumPriorities; ++priority) {
+        VThreadPoolTaskPtr task = worker.pop(priority, false);
+        if (task != nullptr) {
+            return task;
+        }
+
+        for (int i = 1; i < mNumWorkers; ++i) {
+            VThreadPoolWorker* victim = mWorkers[(worker.mIndex + i) % mNumWorkers];
+            task = victim->pop(priority, true);
+            if (task != nullptr) {
+                ++worker.mNumTasksStolen;
+                return task;
+            }
+        }
+    }
+
+    return VThreadPoolTaskPtr();
+}
+
+void VThreadPool::_waitForWork() {
+    // submit() queues the task and then checks for idle workers; we count ourselves idle and then
+    // check for queued tasks. Whichever order they interleave in, one of us sees the other, so a
+    // task cannot be left queued while we sleep.
+    ++mNumIdleWorkers;
+    if ((mNumQueuedTasks.load() == 0) && ! mIsStopped.load()) {
+        mWorkSemaphore.wait();
+    }
+    --mNumIdleWorkers;
+}
+
+void VThreadPool::_abandonQueuedTasks() {
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        for (int priority = 0; priority < VThreadPoolTask::kNumPriorities; ++priority) {
+            VThreadPoolTaskPtr task = (*i)->pop(priority, false);
+            while (task != nullptr) {
+                task->_complete(VSTRING_FORMAT("Task '%s' was not run because pool '%s' was stopped.", task->getName().chars(), mName.chars()));
+                task = (*i)->pop(priority, false);
+            }
+        }
+    }
+}
+
+VThreadPoolWorker* VThreadPool::_getCurrentWorker() const {
+    if (! mIsStarted.load()) {
+        return NULL;
+    }
+
+    const VThread* currentThread = VThread::getCurrentThread();
+    for (std::vector<VThreadPoolWorker*>::const_iterator i = mWorkers.begin(); i != mWorkers.end(); ++i) {
+        if (*i == currentThread) {
+            return *i;
+        }
+    }
+
+    return NULL;
+}
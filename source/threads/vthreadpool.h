@@ -0,0 +1,264 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vthreadpool_h
+#define vthreadpool_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vstring.h"
+#include "vinstant.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
+#include "vcountingsemaphore.h"
+
+#include <atomic>
+
+class VThreadPool;
+class VThreadPoolWorker;
+class VManagementInterface;
+class VBentoNode;
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VThreadPoolTask is the abstract base class for a unit of work run by a
+VThreadPool. Implement run() to do the work, and optionally completed() to
+be called back when it is done. A task is also its own future: another
+thread can wait for it with waitUntilCompleted(), and then see whether it
+failed.
+
+Tasks are submitted and held as VThreadPoolTaskPtr, so a task lives until
+both the pool and the submitter are done with it. A task is run once; do
+not submit it again.
+*/
+class VThreadPoolTask {
+    public:
+
+        /**
+        The priorities of tasks. An idle worker takes the highest priority task
+        queued anywhere in the pool; tasks of equal priority run roughly in the
+        order they were submitted.
+        */
+        enum Priority {
+            kPriorityHigh = 0,  ///< Runs before any normal or low priority task.
+            kPriorityNormal,    ///< The default.
+            kPriorityLow,       ///< Runs only when no higher priority task is queued.
+            kNumPriorities      ///< The number of priorities.
+        };
+
+        /**
+        Constructs the task.
+        @param  name        a name for the task, used in diagnostics
+        @param  priority    the task priority
+        */
+        VThreadPoolTask(const VString& name, Priority priority = kPriorityNormal);
+        virtual ~VThreadPoolTask();
+
+        /**
+        Performs the task, on one of the pool's worker threads. An exception thrown
+        from run() marks the task as failed; it does not affect the worker.
+        */
+        virtual void run() = 0;
+        /**
+        Called on the worker thread after run() returns or throws, or when the pool
+        is stopped before the task could run, and before waiters are released. The
+        default implementation does nothing.
+        */
+        virtual void completed() {}
+
+        /**
+        Blocks until the task has completed.
+        */
+        void waitUntilCompleted();
+        /**
+        Blocks until the task has completed, or until the timeout elapses.
+        @param  timeoutInterval the maximum time to wait
+        @return true if the task has completed
+        */
+        bool waitUntilCompleted(const VDuration& timeoutInterval);
+        /**
+        Returns true if the task has completed, successfully or not.
+        @return obvious
+        */
+        bool isCompleted() const;
+        /**
+        Returns true if the task has completed unsuccessfully: run() threw an exception,
+        or the pool was stopped before the task could run. Valid once the task has completed.
+        @return obvious
+        */
+        bool hasFailed() const;
+        /**
+        Returns a description of the failure, if the task failed. Valid once the task
+        has completed.
+        @return the error message, or empty if the task did not fail
+        */
+        VString getErrorMessage() const;
+
+        const VString& getName() const { return mName; }    ///< Returns the task name. @return obvious
+        Priority getPriority() const { return mPriority; }  ///< Returns the task priority. @return obvious
+
+    private:
+
+        VThreadPoolTask(const VThreadPoolTask&); // not copyable
+        VThreadPoolTask& operator=(const VThreadPoolTask&); // not assignable
+
+        friend class VThreadPool;
+        friend class VThreadPoolWorker;
+
+        /**
+        Runs the task and completes it.
+        */
+        void _execute();
+        /**
+        Records the outcome, calls completed(), and releases any waiters.
+        @param  errorMessage    empty if the task succeeded; otherwise, why it failed
+        */
+        void _complete(const VString& errorMessage);
+
+        VString             mName;                  ///< The task name.
+        Priority            mPriority;              ///< The task priority.
+        mutable VMutex      mMutex;                 ///< Protects the completion state.
+        VSemaphore          mCompletedSemaphore;    ///< Broadcast when the task completes.
+        std::atomic<bool>   mIsCompleted;           ///< True once the task has completed.
+        bool                mFailed;                ///< True if the task failed.
+        VString             mErrorMessage;          ///< Why the task failed.
+};
+
+typedef VSharedPtr<VThreadPoolTask> VThreadPoolTaskPtr;
+
+/**
+VThreadPool runs VThreadPoolTask objects on a fixed set of worker threads,
+so that framework code and applications can do work in parallel without
+creating a thread for each piece of it.
+
+Each worker has its own queue, for each priority. A task submitted from
+one of the pool's own workers goes on that worker's queue, where it is
+likely to find the data it needs already in cache; a task submitted from
+any other thread goes to the workers in turn. A worker runs its own queue
+first, and when that is empty, steals from the others, so no worker is
+idle while work is queued anywhere. Idle workers block on a semaphore and
+use no CPU.
+
+Optionally, each worker can be pinned to a CPU (see
+VThread::setCurrentThreadAffinity()), to keep its cache warm. This is best
+when the pool has no more workers than the machine has CPUs and the pool
+is the main load on the machine.
+
+The workers are ordinary VThread objects named after the pool. They are
+registered with the VManagementInterface supplied, if any, like any other
+thread; and VThread::getThreadsInfo() includes, for each worker, its pool,
+index, and task counts.
+
+Do not wait for a task from inside another task on the same pool, unless
+the pool has workers to spare: the waiting worker cannot run anything else.
+*/
+class VThreadPool {
+    public:
+
+        /**
+        Returns the shared pool, creating and starting it on first use. It has one
+        worker per CPU, unpinned, and is never destroyed.
+        @return the shared pool
+        */
+        static VThreadPool& getSharedPool();
+
+        /**
+        Constructs the pool. Its worker threads do not run until start() is called.
+        @param  name                a name for the pool, used to name the worker threads
+        @param  numWorkers          the number of workers; 0 means one per CPU
+        @param  pinWorkersToCPUs    true to pin worker i to CPU (i modulo the number of CPUs)
+        @param  manager             the management interface to register the workers with, or NULL
+        */
+        VThreadPool(const VString& name, int numWorkers = 0, bool pinWorkersToCPUs = false, VManagementInterface* manager = NULL);
+        /**
+        Stops the pool if it is running.
+        */
+        ~VThreadPool();
+
+        /**
+        Starts the worker threads, if they are not already running.
+        */
+        void start();
+        /**
+        Stops the workers and waits for them to end. A task that is running is allowed
+        to finish; tasks still queued are completed as failed without being run. A
+        stopped pool cannot be started again.
+        */
+        void stop();
+        /**
+        Queues a task to be run. Tasks submitted before start() run once it is called;
+        a task submitted after stop() is completed as failed without being run.
+        @param  task    the task
+        */
+        void submit(VThreadPoolTaskPtr task);
+        /**
+        Returns true if the current thread is one of this pool's workers. Code that
+        waits for tasks it submits can use this to do the work itself instead when it
+        is already running on the pool, where waiting could occupy the only worker.
+        @return obvious
+        */
+        bool isCurrentThreadAWorker() const { return this->_getCurrentWorker() != NULL; }
+
+        const VString& getName() const { return mName; }    ///< Returns the pool name. @return obvious
+        int getNumWorkers() const { return mNumWorkers; }   ///< Returns the number of workers. @return obvious
+        int getNumQueuedTasks() const;                      ///< Returns the number of tasks waiting to run. @return obvious
+        Vs64 getNumTasksRun() const;                        ///< Returns the number of tasks the workers have run. @return obvious
+        Vs64 getNumTasksStolen() const;                     ///< Returns how many of those a worker took from another worker's queue. @return obvious
+        /**
+        Adds attributes describing the pool to a bento node.
+        @param  bento   the node to add to
+        */
+        void getPoolInfo(VBentoNode& bento) const;
+
+    private:
+
+        VThreadPool(const VThreadPool&); // not copyable
+        VThreadPool& operator=(const VThreadPool&); // not assignable
+
+        friend class VThreadPoolWorker;
+
+        /**
+        Returns the next task for a worker to run: the highest priority task in its own
+        queues, or else one stolen from another worker. Called by the worker.
+        @param  worker  the worker looking for work
+        @return the task, or null if there is none
+        */
+        VThreadPoolTaskPtr _takeTask(VThreadPoolWorker& worker);
+        /**
+        Blocks an idle worker until a task may have been submitted, or the pool is stopping.
+        */
+        void _waitForWork();
+        /**
+        Completes every queued task as failed, without running it. Called once the pool is stopped.
+        */
+        void _abandonQueuedTasks();
+        /**
+        Returns the worker that is the current thread, if it is one of ours.
+        @return the worker, or NULL
+        */
+        VThreadPoolWorker* _getCurrentWorker() const;
+
+        VString                         mName;              ///< The pool name.
+        const int                       mNumWorkers;        ///< The number of workers.
+        const bool                      mPinWorkersToCPUs;  ///< True if worker i is pinned to CPU (i modulo the number of CPUs).
+        VManagementInterface*           mManager;           ///< The management interface for the workers, or NULL.
+        VMutex                          mMutex;             ///< Serializes start() and stop().
+        std::vector<VThreadPoolWorker*> mWorkers;           ///< The workers; created by the constructor, their threads started by start().
+        std::atomic<bool>               mIsStarted;         ///< True once start() has been called.
+        std::atomic<bool>               mIsStopped;         ///< True once stop() has been called.
+        std::atomic<int>                mNextWorkerIndex;   ///< The worker to queue the next task from a non-worker thread on.
+        std::atomic<int>                mNumQueuedTasks;    ///< The total number of tasks queued on all workers.
+        std::atomic<int>                mNumIdleWorkers;    ///< The number of workers blocked, or about to block, in _waitForWork().
+        VCountingSemaphore              mWorkSemaphore;     ///< Posted when a task is submitted while a worker is idle.
+};
+
+#endif /* vthreadpool_h */
@@ -0,0 +1,412 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vtimerwheel.h"
+
+#include "vthread.h"
+#include "vmutexlocker.h"
+#include "vexception.h"
+#include "vlogger.h"
+
+static const VString kLoggerName("vault.threads.VTimerWheel");
+
+static const Vu64 kSlotMask = static_cast<Vu64>(VTimerWheel::kNumSlots - 1);
+static const Vu64 kMaxTicksAhead = (CONST_U64(1) << (VTimerWheel::kSlotBits * VTimerWheel::kNumLevels)) - 1; // the span of the wheel
+static const Vs64 kMaxDelayMilliseconds = CONST_S64(0x3FFFFFFFFFFFFFFF) / VTicks::kNanosecondsPerMillisecond; // keeps nanosecond math from overflowing
+
+// VTimerTask ------------------------------------------------------------------
+
+VTimerTask::VTimerTask(const VString& name)
+    : mName(name)
+    , mWheel(NULL)
+    , mList(NULL)
+    , mPrev(NULL)
+    , mNext(NULL)
+    , mExpiryTick(0)
+    , mPeriodTicks(0)
+    {
+}
+
+VTimerTask::~VTimerTask() {
+    try {
+        (void) this->cancel();
+    } catch (...) {}
+}
+
+bool VTimerTask::cancel() {
+    VTimerWheel* wheel = mWheel.load();
+    return (wheel == NULL) ? false : wheel->cancel(this);
+}
+
+// VTimerWheelThread -----------------------------------------------------------
+
+/**
+The thread that turns a VTimerWheel and fires its tasks.
+*/
+class VTimerWheelThread : public VThread {
+    public:
+
+        VTimerWheelThread(VTimerWheel& wheel) :
+            VThread(VSTRING_FORMAT("VTimerWheel.%s", wheel.getName().chars()), kLoggerName, kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mWheel(wheel),
+            mStopRequested(false) {
+        }
+
+        virtual ~VTimerWheelThread() {}
+
+        virtual void run() {
+            while (! mStopRequested.load()) {
+                Vs64 nanosecondsUntilWork = mWheel._advance(this);
+
+                if (mStopRequested.load()) {
+                    break;
+                }
+
+                if (nanosecondsUntilWork < 0) {
+                    mWheel.mWakeEvent.wait(); // nothing scheduled; schedule() or stop() wakes us
+                } else if (nanosecondsUntilWork > 0) {
+                    // Round up, so that we never wake just before the tick and spin.
+                    Vs64 milliseconds = (nanosecondsUntilWork + VTicks::kNanosecondsPerMillisecond - 1) / VTicks::kNanosecondsPerMillisecond;
+                    (void) mWheel.mWakeEvent.timedWait(VDuration::MILLISECOND() * milliseconds);
+                }
+            }
+        }
+
+        // Not stop() and join(): VThread::join() returns at once for a thread that has been stop()ped.
+        void stopAndJoin() {
+            mStopRequested.store(true);
+            mWheel.mWakeEvent.signal();
+            (void) this->join();
+        }
+
+    private:
+
+        VTimerWheelThread(const VTimerWheelThread&); // not copyable
+        VTimerWheelThread& operator=(const VTimerWheelThread&); // not assignable
+
+        VTimerWheel&        mWheel;
+        std::atomic<bool>   mStopRequested; ///< Set by stopAndJoin() to end run().
+};
+
+// VTimerWheel -----------------------------------------------------------------
+
+static VMutex gSharedWheelMutex("gSharedWheelMutex");
+static VTimerWheel* gSharedWheel = NULL;
+
+// static
+VTimerWheel& VTimerWheel::getSharedWheel() {
+    VMutexLocker locker(&gSharedWheelMutex, "VTimerWheel::getSharedWheel");
+
+    if (gSharedWheel == NULL) {
+        gSharedWheel = new VTimerWheel("shared");
+        gSharedWheel->start();
+    }
+
+    return *gSharedWheel;
+}
+
+VTimerWheel::VTimerWheel(const VString& name, const VDuration& resolution)
+    : mName(name)
+    , mResolutionNanoseconds(V_MAX(CONST_S64(1), resolution.getDurationMilliseconds()) * VTicks::kNanosecondsPerMillisecond)
+    , mBaseNanoseconds(VTicks::snapshot())
+    , mMutex(VSTRING_FORMAT("VTimerWheel(%s)::mMutex", name.chars()))
+    , mDueList(NULL)
+    , mCurrentTick(0)
+    , mWakeTick(0)
+    , mNumScheduled(0)
+    , mFiringTask(NULL)
+    , mFiringThread(NULL)
+    , mFiringTaskCancelled(false)
+    , mFiringDoneSemaphore()
+    , mWakeEvent()
+    , mThread(NULL)
+    {
+
+    for (int level = 0; level < kNumLevels; ++level) {
+        for (int slot = 0; slot < kNumSlots; ++slot) {
+            mSlots[level][slot] = NULL;
+        }
+    }
+}
+
+VTimerWheel::~VTimerWheel() {
+    this->stop();
+
+    VMutexLocker locker(&mMutex, "VTimerWheel::~VTimerWheel");
+
+    for (int level = 0; level < kNumLevels; ++level) {
+        for (int slot = 0; slot < kNumSlots; ++slot) {
+            while (mSlots[level][slot] != NULL) {
+                VTimerTask* task = mSlots[level][slot];
+                VTimerWheel::_unlink(task);
+                task->mWheel = NULL;
+            }
+        }
+    }
+
+    while (mDueList != NULL) {
+        VTimerTask* task = mDueList;
+        VTimerWheel::_unlink(task);
+        task->mWheel = NULL;
+    }
+}
+
+void VTimerWheel::start() {
+    VMutexLocker locker(&mMutex, "VTimerWheel::start");
+
+    if (mThread == NULL) {
+        mThread = new VTimerWheelThread(*this);
+        mThread->start();
+    }
+}
+
+void VTimerWheel::stop() {
+    VMutexLocker locker(&mMutex, "VTimerWheel::stop");
+    VTimerWheelThread* thread = mThread;
+    mThread = NULL;
+    locker.unlock(); // the thread needs mMutex to finish its current pass
+
+    if (thread != NULL) {
+        thread->stopAndJoin();
+        delete thread;
+    }
+}
+
+void VTimerWheel::schedule(VTimerTask* task, const VDuration& delay, const VDuration& period) {
+    Vs64 delayNanoseconds = V_MIN(kMaxDelayMilliseconds, V_MAX(CONST_S64(0), delay.getDurationMilliseconds())) * VTicks::kNanosecondsPerMillisecond;
+    Vs64 periodNanoseconds = V_MIN(kMaxDelayMilliseconds, V_MAX(CONST_S64(0), period.getDurationMilliseconds())) * VTicks::kNanosecondsPerMillisecond;
+
+    VMutexLocker locker(&mMutex, "VTimerWheel::schedule");
+
+    VTimerWheel* taskWheel = task->mWheel.load();
+    if ((taskWheel != NULL) && (taskWheel != this)) {
+        throw VStackTraceException(VSTRING_FORMAT("VTimerWheel::schedule: Task '%s' is already scheduled on wheel '%s'.", task->getName().chars(), taskWheel->getName().chars()));
+    }
+
+    if (task->mList != NULL) {
+        VTimerWheel::_unlink(task);
+        --mNumScheduled;
+    }
+
+    // The first tick that begins at or after the deadline; never one already processed.
+    Vs64 deadlineNanoseconds = (VTicks::snapshot() - mBaseNanoseconds) + delayNanoseconds;
+    Vu64 expiryTick = static_cast<Vu64>((deadlineNanoseconds + mResolutionNanoseconds - 1) / mResolutionNanoseconds);
+    task->mExpiryTick = V_MAX(expiryTick, mCurrentTick);
+    task->mPeriodTicks = (periodNanoseconds == 0) ? 0 : static_cast<Vu64>(V_MAX(CONST_S64(1), (periodNanoseconds + mResolutionNanoseconds - 1) / mResolutionNanoseconds));
+    task->mWheel = this;
+
+    this->_insert(task);
+    ++mNumScheduled;
+
+    if (task->mExpiryTick < mWakeTick) {
+        mWakeTick = task->mExpiryTick;
+        mWakeEvent.signal();
+    }
+}
+
+bool VTimerWheel::cancel(VTimerTask* task) {
+    VMutexLocker locker(&mMutex, "VTimerWheel::cancel");
+
+    if (task->mWheel.load() != this) {
+        return false;
+    }
+
+    bool wasScheduled = false;
+    if (task->mList != NULL) {
+        VTimerWheel::_unlink(task);
+        --mNumScheduled;
+        wasScheduled = true;
+    }
+
+    if (mFiringTask == task) {
+        // The wheel thread clears mWheel when fire() returns. Waiting for that from within
+        // fire() itself would never end.
+        mFiringTaskCancelled = true;
+        if (VThread::getCurrentThread() != mFiringThread) {
+            while (mFiringTask == task) {
+                mFiringDoneSemaphore.wait(&mMutex, VDuration::ZERO());
+            }
+        }
+    } else {
+        task->mWheel = NULL;
+    }
+
+    return wasScheduled;
+}
+
+bool VTimerWheel::isScheduled(const VTimerTask* task) const {
+    VMutexLocker locker(&mMutex, "VTimerWheel::isScheduled");
+    return (task->mWheel.load() == this) && (task->mList != NULL);
+}
+
+int VTimerWheel::getNumScheduled() const {
+    VMutexLocker locker(&mMutex, "VTimerWheel::getNumScheduled");
+    return mNumScheduled;
+}
+
+VDuration VTimerWheel::getResolution() const {
+    return VDuration::MILLISECOND() * (mResolutionNanoseconds / VTicks::kNanosecondsPerMillisecond);
+}
+
+Vs64 VTimerWheel::_advance(const VThread* wheelThread) {
+    VMutexLocker locker(&mMutex, "VTimerWheel::_advance");
+
+    Vu64 currentTimeTick = this->_getCurrentTimeTick();
+    while (mCurrentTick <= currentTimeTick) {
+        if (mNumScheduled == 0) {
+            // Nothing to process; jump straight to the present.
+            mCurrentTick = currentTimeTick + 1;
+            break;
+        }
+
+        this->_processTick();
+    }
+
+    while (mDueList != NULL) {
+        VTimerTask* task = mDueList;
+        VTimerWheel::_unlink(task);
+        --mNumScheduled;
+        mFiringTask = task;
+        mFiringThread = wheelThread;
+        mFiringTaskCancelled = false;
+
+        locker.unlock();
+
+        try {
+            task->fire();
+        } catch (const VException& ex) {
+            VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("[%s] VTimerWheel: Task '%s' threw exception #%d '%s'.", mName.chars(), task->getName().chars(), ex.getError(), ex.what()));
+        } catch (const std::exception& ex) {
+            VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("[%s] VTimerWheel: Task '%s' threw exception '%s'.", mName.chars(), task->getName().chars(), ex.what()));
+        } catch (...) {
+            VLOGGER_NAMED_ERROR(kLoggerName, VSTRING_FORMAT("[%s] VTimerWheel: Task '%s' threw unknown exception.", mName.chars(), task->getName().chars()));
+        }
+
+        locker.lock();
+
+        mFiringTask = NULL;
+        mFiringThread = NULL;
+
+        // If fire() rescheduled the task, that takes precedence over its period.
+        if (task->mList == NULL) {
+            if ((task->mPeriodTicks != 0) && ! mFiringTaskCancelled) {
+                task->mExpiryTick = V_MAX(task->mExpiryTick + task->mPeriodTicks, mCurrentTick);
+                this->_insert(task);
+                ++mNumScheduled;
+            } else {
+                task->mWheel = NULL;
+            }
+        }
+
+        mFiringDoneSemaphore.broadcast();
+    }
+
+    if (mNumScheduled == 0) {
+        mWakeTick = static_cast<Vu64>(-1);
+        return -1;
+    }
+
+    mWakeTick = this->_getNextWorkTick();
+    Vs64 wakeNanoseconds = static_cast<Vs64>(mWakeTick) * mResolutionNanoseconds;
+    return V_MAX(CONST_S64(0), wakeNanoseconds - (VTicks::snapshot() - mBaseNanoseconds));
+}
+
+Vu64 VTimerWheel::_getCurrentTimeTick() const {
+    return static_cast<Vu64>((VTicks::snapshot() - mBaseNanoseconds) / mResolutionNanoseconds);
+}
+
+void VTimerWheel::_insert(VTimerTask* task) {
+    // Place by distance from now. Beyond the span of the wheel, park the task in the
+    // farthest slot; it is placed again, by its real expiry, each time that slot comes due.
+    Vu64 ticksAhead = task->mExpiryTick - mCurrentTick;
+    Vu64 placementTick = task->mExpiryTick;
+    if (ticksAhead > kMaxTicksAhead) {
+        ticksAhead = kMaxTicksAhead;
+        placementTick = mCurrentTick + kMaxTicksAhead;
+    }
+
+    int level = 0;
+    while (ticksAhead >= (CONST_U64(1) << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+
+    int slot = static_cast<int>((placementTick >> (kSlotBits * level)) & kSlotMask);
+    VTimerWheel::_link(task, &mSlots[level][slot]);
+}
+
+// static
+void VTimerWheel::_unlink(VTimerTask* task) {
+    if (task->mPrev == NULL) {
+        *(task->mList) = task->mNext;
+    } else {
+        task->mPrev->mNext = task->mNext;
+    }
+
+    if (task->mNext != NULL) {
+        task->mNext->mPrev = task->mPrev;
+    }
+
+    task->mList = NULL;
+    task->mPrev = NULL;
+    task->mNext = NULL;
+}
+
+// static
+void VTimerWheel::_link(VTimerTask* task, VTimerTask** list) {
+    task->mList = list;
+    task->mPrev = NULL;
+    task->mNext = *list;
+
+    if (*list != NULL) {
+        (*list)->mPrev = task;
+    }
+
+    *list = task;
+}
+
+void VTimerWheel::_processTick() {
+    // When a level wraps to slot 0, the next slot of the level above comes within its
+    // span, so we redistribute that slot's tasks into the lower levels.
+    int index = static_cast<int>(mCurrentTick & kSlotMask);
+    for (int level = 1; (level < kNumLevels) && (index == 0); ++level) {
+        index = static_cast<int>((mCurrentTick >> (kSlotBits * level)) & kSlotMask);
+
+        VTimerTask* task = mSlots[level][index];
+        mSlots[level][index] = NULL;
+        while (task != NULL) {
+            VTimerTask* next = task->mNext;
+            this->_insert(task);
+            task = next;
+        }
+    }
+
+    VTimerTask** slot = &mSlots[0][mCurrentTick & kSlotMask];
+    while (*slot != NULL) {
+        VTimerTask* task = *slot;
+        VTimerWheel::_unlink(task);
+        VTimerWheel::_link(task, &mDueList);
+    }
+
+    ++mCurrentTick;
+}
+
+Vu64 VTimerWheel::_getNextWorkTick() const {
+    if ((mCurrentTick & kSlotMask) == 0) {
+        return mCurrentTick; // a redistribution is due
+    }
+
+    Vu64 redistributionTick = (mCurrentTick | kSlotMask) + 1;
+    for (Vu64 tick = mCurrentTick; tick < redistributionTick; ++tick) {
+        if (mSlots[0][tick & kSlotMask] != NULL) {
+            return tick;
+        }
+    }
+
+    return redistributionTick;
+}
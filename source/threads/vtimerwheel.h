@@ -0,0 +1,280 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vtimerwheel_h
+#define vtimerwheel_h
+
+/** @file */
+
+#include "vtypes.h"
+
+#include "vstring.h"
+#include "vinstant.h"
+#include "vmutex.h"
+#include "vsemaphore.h"
+#include "vcountingsemaphore.h"
+
+#include <atomic>
+
+class VTimerWheel;
+class VTimerWheelThread;
+class VThread;
+
+/**
+    @ingroup vthread
+*/
+
+/**
+VTimerTask is the abstract base class for work that a VTimerWheel performs
+after a delay, once or periodically. Implement fire() to do the work. It
+is called on the wheel's thread, so it must be short and must not block;
+anything lengthy should be handed off to another thread.
+
+A task is scheduled on at most one wheel at a time. Before destroying a
+task, its owner must cancel it with cancel(), which waits for a fire()
+that is in progress on another thread. The base class destructor also
+cancels, but by then the subclass part of the object is already gone.
+
+@see VTimerWheel
+@see VMethodTimerTask
+*/
+class VTimerTask {
+    public:
+
+        /**
+        Constructs an unscheduled task.
+        @param  name    a name for the task, used in diagnostics
+        */
+        VTimerTask(const VString& name);
+        /**
+        Cancels the task if it is still scheduled.
+        */
+        virtual ~VTimerTask();
+
+        /**
+        Performs the task. Called on the wheel's thread, with no wheel lock held, so
+        it may schedule or cancel tasks, including itself.
+        */
+        virtual void fire() = 0;
+
+        /**
+        Cancels the task on whichever wheel it is scheduled or firing on, as
+        VTimerWheel::cancel() does. Does nothing if it is neither.
+        @return true if the task was scheduled, and so will now not fire
+        */
+        bool cancel();
+
+        const VString& getName() const { return mName; } ///< Returns the task name. @return obvious
+
+    private:
+
+        VTimerTask(const VTimerTask&); // not copyable
+        VTimerTask& operator=(const VTimerTask&); // not assignable
+
+        friend class VTimerWheel;
+
+        VString                     mName;          ///< The task name.
+        std::atomic<VTimerWheel*>   mWheel;         ///< The wheel the task is scheduled or firing on; NULL if neither.
+        VTimerTask**                mList;          ///< The wheel list the task is linked into; NULL if not scheduled.
+        VTimerTask*                 mPrev;          ///< The previous task in mList.
+        VTimerTask*                 mNext;          ///< The next task in mList.
+        Vu64                        mExpiryTick;    ///< The wheel tick at which the task fires.
+        Vu64                        mPeriodTicks;   ///< The number of ticks between periodic firings; 0 if it fires once.
+};
+
+/**
+VMethodTimerTask is a VTimerTask that calls a member function of an object.
+This saves writing a task subclass for each timer an object owns:
+
+<code>
+VMethodTimerTask<MySession> mIdleTimer; // initialized with ("idle", this, &MySession::_idleTimerFired)
+</code>
+*/
+template <class T>
+class VMethodTimerTask : public VTimerTask {
+    public:
+
+        typedef void (T::*Method)(); ///< The type of member function called by fire().
+
+        /**
+        Constructs the task.
+        @param  name    a name for the task, used in diagnostics
+        @param  object  the object whose member function fire() calls
+        @param  method  the member function
+        */
+        VMethodTimerTask(const VString& name, T* object, Method method) : VTimerTask(name), mObject(object), mMethod(method) {}
+        virtual ~VMethodTimerTask() {}
+
+        virtual void fire() { (mObject->*mMethod)(); }
+
+    private:
+
+        T*      mObject;    ///< The object to call.
+        Method  mMethod;    ///< The member function to call.
+};
+
+/**
+VTimerWheel runs timer tasks from a single thread, so that a server's many
+timeouts -- idle sessions, queue limits, grace periods, periodic
+housekeeping -- need neither a thread each nor a loop that polls for them.
+
+It is a hierarchical timing wheel: 4 levels of 256 slots, where level 0
+holds the tasks due in the next 256 ticks, one slot per tick, and each
+higher level holds 256 times the span of the one below. Scheduling and
+cancelling are O(1), whatever the number of tasks: a task is linked into
+the slot for its expiry tick, and unlinked from it. As the wheel turns,
+each slot of a higher level is redistributed into the levels below when
+its span comes due. With the default 10ms tick, the wheel covers 497 days;
+a task due later than that is simply redistributed until it comes into
+range.
+
+A task fires on the first tick at or after its delay has elapsed, so it
+fires up to one tick late, plus any scheduling delay of the wheel thread.
+The wheel thread sleeps until the next tick that has anything to do, and
+not at all while the wheel is empty.
+
+You can create a wheel of your own, or use the shared wheel, which starts
+on first use:
+
+<code>
+VTimerWheel::getSharedWheel().schedule(&mIdleTimer, 5 * VDuration::MINUTE());
+</code>
+*/
+class VTimerWheel {
+    public:
+
+        /**
+        Returns the shared wheel, creating and starting it on first use. It uses the
+        default resolution and is never destroyed.
+        @return the shared wheel
+        */
+        static VTimerWheel& getSharedWheel();
+
+        /**
+        Constructs a wheel. Tasks may be scheduled before start() is called, but do
+        not fire until it is.
+        @param  name        a name for the wheel, used for its thread and mutex
+        @param  resolution  the duration of one tick; at least 1 millisecond
+        */
+        VTimerWheel(const VString& name, const VDuration& resolution = 10 * VDuration::MILLISECOND());
+        /**
+        Stops the wheel and unschedules any tasks still scheduled, without firing them.
+        */
+        ~VTimerWheel();
+
+        /**
+        Starts the wheel thread, if it is not already running.
+        */
+        void start();
+        /**
+        Stops the wheel thread, waiting for it to end. Scheduled tasks remain scheduled
+        and fire if the wheel is started again.
+        */
+        void stop();
+
+        /**
+        Schedules a task to fire after a delay and, optionally, periodically after
+        that. If the task is already scheduled on this wheel, it is rescheduled.
+        Periodic firings are kept in phase with the first one; if the wheel falls
+        behind by more than a period, the missed firings are skipped.
+        @param  task    the task to schedule
+        @param  delay   the time until the task fires; zero or less means the next tick
+        @param  period  if greater than zero, the time between subsequent firings
+        */
+        void schedule(VTimerTask* task, const VDuration& delay, const VDuration& period = VDuration::ZERO());
+        /**
+        Unschedules a task. If the task is firing on another thread, waits for fire()
+        to return; if the task is periodic, it is not rescheduled. Do not call cancel()
+        while holding a lock that the task's fire() acquires, unless the caller is
+        the task's own fire().
+        @param  task    the task to cancel
+        @return true if the task was scheduled, and so will now not fire
+        */
+        bool cancel(VTimerTask* task);
+        /**
+        Returns true if the task is scheduled on this wheel.
+        @param  task    the task
+        @return obvious
+        */
+        bool isScheduled(const VTimerTask* task) const;
+
+        int getNumScheduled() const;                                    ///< Returns the number of scheduled tasks. @return obvious
+        VDuration getResolution() const;                                ///< Returns the duration of one tick. @return obvious
+        const VString& getName() const { return mName; }                ///< Returns the wheel name. @return obvious
+
+        static const int kNumLevels = 4;                                ///< The number of levels of the wheel.
+        static const int kSlotBits = 8;                                 ///< Each level has 2^kSlotBits slots.
+        static const int kNumSlots = 1 << kSlotBits;                    ///< The number of slots in each level.
+
+    private:
+
+        VTimerWheel(const VTimerWheel&); // not copyable
+        VTimerWheel& operator=(const VTimerWheel&); // not assignable
+
+        friend class VTimerWheelThread;
+
+        /**
+        Advances the wheel to the current time, firing the tasks that are due. Called
+        repeatedly by the wheel thread.
+        @param  wheelThread the calling thread
+        @return the nanoseconds until the next tick with work to do; or -1 if the wheel is empty
+        */
+        Vs64 _advance(const VThread* wheelThread);
+        /**
+        Returns the tick that contains the current time.
+        @return obvious
+        */
+        Vu64 _getCurrentTimeTick() const;
+        /**
+        Links a task into the slot for its expiry tick, relative to mCurrentTick. The
+        caller must hold mMutex.
+        @param  task    the task
+        */
+        void _insert(VTimerTask* task);
+        /**
+        Unlinks a task from the list it is in. The caller must hold mMutex.
+        @param  task    the task
+        */
+        static void _unlink(VTimerTask* task);
+        /**
+        Links a task at the head of a list. The caller must hold mMutex.
+        @param  task    the task
+        @param  list    the list head
+        */
+        static void _link(VTimerTask* task, VTimerTask** list);
+        /**
+        Processes tick mCurrentTick, moving its tasks to mDueList and redistributing
+        higher-level slots that come due, then advances mCurrentTick. The caller must
+        hold mMutex.
+        */
+        void _processTick();
+        /**
+        Returns the tick after mCurrentTick at which the wheel next has work: the first
+        non-empty level 0 slot, or else the next redistribution of level 1. The caller
+        must hold mMutex.
+        @return obvious
+        */
+        Vu64 _getNextWorkTick() const;
+
+        VString             mName;                          ///< The wheel name.
+        Vs64                mResolutionNanoseconds;         ///< The duration of one tick.
+        Vs64                mBaseNanoseconds;               ///< The VTicks value at which tick 0 began.
+        mutable VMutex      mMutex;                         ///< Protects all the wheel state.
+        VTimerTask*         mSlots[kNumLevels][kNumSlots];  ///< The task lists of each slot.
+        VTimerTask*         mDueList;                       ///< The tasks that are due and waiting for fire().
+        Vu64                mCurrentTick;                   ///< The next tick to be processed; all earlier ticks have been.
+        Vu64                mWakeTick;                      ///< The tick the thread sleeps until; schedule() wakes it for earlier work.
+        int                 mNumScheduled;                  ///< The number of tasks in mSlots and mDueList.
+        VTimerTask*         mFiringTask;                    ///< The task whose fire() is running; NULL if none.
+        const VThread*      mFiringThread;                  ///< The thread running mFiringTask's fire(); NULL if none.
+        bool                mFiringTaskCancelled;           ///< True if mFiringTask was cancelled during fire(), so must not be rescheduled.
+        VSemaphore          mFiringDoneSemaphore;           ///< Signaled when a fire() returns, for cancel() to wait on.
+        VEvent              mWakeEvent;                     ///< Wakes the wheel thread when it must re-examine the wheel.
+        VTimerWheelThread*  mThread;                        ///< The wheel thread; NULL if not started.
+};
+
+#endif /* vtimerwheel_h */
@@ -0,0 +1,804 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+/** @file */
+
+#include "vbinarylog.h"
+
+#include "vthread.h"
+#include "vmutexlocker.h"
+#include "vsemaphore.h"
+#include "vexception.h"
+#include "vsettings.h"
+
+// The file format is described in vbinarylog.h.
+
+static const Vu8 kFileHeaderRecord = 'H';
+static const Vu8 kSegmentIndexRecord = 'S';
+static const Vu8 kLoggerDefinitionRecord = 'L';
+static const Vu8 kThreadDefinitionRecord = 'T';
+static const Vu8 kMessageRecord = 'M';
+
+static const Vu8 kFileHeaderMagic[4] = { 'V', 'B', 'L', 'G' };
+static const Vu8 kSegmentIndexMagic[4] = { 'V', 'B', 'S', 'G' };
+static const Vs32 kFormatVersion = 1;
+
+static const Vs64 kRecordPrefixLength = 5; // Vu8 type + Vs32 body length
+static const Vs32 kFileHeaderBodyLength = 4 + 4 + 8;
+static const Vs32 kSegmentIndexBodyLength = 4 + 8 + 4 + 4 + 8 + 8 + 4 + 4 + VBinaryLogBloomFilter::kNumBytes;
+static const Vs64 kUnsealedSegmentLength = -1;
+
+static const Vu8 kMessageFlagRawLine = 0x01;
+static const Vu8 kMessageFlagHasPayload = 0x02;
+
+static bool _isKnownRecordType(Vu8 recordType) {
+    return (recordType == kFileHeaderRecord) ||
+           (recordType == kSegmentIndexRecord) ||
+           (recordType == kLoggerDefinitionRecord) ||
+           (recordType == kThreadDefinitionRecord) ||
+           (recordType == kMessageRecord);
+}
+
+// VBinaryLogBloomFilter -----------------------------------------------------
+
+static const Vu32 kFNVOffsetBasis = 2166136261U;
+static const Vu32 kFNVPrime = 16777619U;
+
+void VBinaryLogBloomFilter::clear() {
+    ::memset(mBits, 0, sizeof(mBits));
+}
+
+void VBinaryLogBloomFilter::addLoggerName(const VString& loggerName) {
+    // FNV-1a is computed incrementally, so the hash of each dotted prefix is available along the way.
+    const char* chars = loggerName.chars();
+    const int length = loggerName.length();
+    Vu32 hash = kFNVOffsetBasis;
+    for (int i = 0; i < length; ++i) {
+        if (chars[i] == '.') {
+            this->_addHash(hash);
+        }
+
+        hash = (hash ^ static_cast<Vu8>(chars[i])) * kFNVPrime;
+    }
+
+    this->_addHash(hash);
+}
+
+void VBinaryLogBloomFilter::addAll(const VBinaryLogBloomFilter& other) {
+    for (int i = 0; i < kNumBytes; ++i) {
+        mBits[i] |= other.mBits[i];
+    }
+}
+
+bool VBinaryLogBloomFilter::mayContain(const VString& loggerName) const {
+    const char* chars = loggerName.chars();
+    const int length = loggerName.length();
+    Vu32 hash = kFNVOffsetBasis;
+    for (int i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<Vu8>(chars[i])) * kFNVPrime;
+    }
+
+    const int bit1 = static_cast<int>(hash & 0xFF);
+    const int bit2 = static_cast<int>((hash >> 8) & 0xFF);
+    return ((mBits[bit1 / 8] & (1 << (bit1 % 8))) != 0) && ((mBits[bit2 / 8] & (1 << (bit2 % 8))) != 0);
+}
+
+void VBinaryLogBloomFilter::writeToStream(VBinaryIOStream& stream) const {
+    (void) stream.write(mBits, kNumBytes);
+}
+
+void VBinaryLogBloomFilter::readFromStream(VBinaryIOStream& stream) {
+    stream.readGuaranteed(mBits, kNumBytes);
+}
+
+void VBinaryLogBloomFilter::_addHash(Vu32 hash) {
+    const int bit1 = static_cast<int>(hash & 0xFF);
+    const int bit2 = static_cast<int>((hash >> 8) & 0xFF);
+    mBits[bit1 / 8] |= static_cast<Vu8>(1 << (bit1 % 8));
+    mBits[bit2 / 8] |= static_cast<Vu8>(1 << (bit2 % 8));
+}
+
+// VBinaryLogRecord ----------------------------------------------------------
+
+VBinaryLogRecord::VBinaryLogRecord()
+    : mWhen()
+    , mLevel(0)
+    , mLoggerName()
+    , mThreadName()
+    , mIsRawLine(false)
+    , mMessage()
+    , mHasPayload(false)
+    , mPayload()
+    {
+}
+
+VString VBinaryLogRecord::format(bool utc) const {
+    if (mIsRawLine) {
+        return mMessage;
+    }
+
+    static const VInstantFormatter kTimeFormatter("y-MM-dd HH:mm:ss.SSS");
+    VString s(VSTRING_ARGS("%s %s | %s | %s | %s",
+        (utc ? kTimeFormatter.formatUTCString(mWhen) : kTimeFormatter.formatLocalString(mWhen)).chars(),
+        VLoggerLevel::getName(mLevel).chars(), mThreadName.chars(), mLoggerName.chars(), mMessage.chars()));
+
+    if (mHasPayload) {
+        VString payloadText;
+        mPayload.writeToBentoTextString(payloadText);
+        s += ' ';
+        s += payloadText;
+    }
+
+    return s;
+}
+
+// VBinaryLogFlushThread -----------------------------------------------------
+
+/**
+The background thread that writes a VBinaryLogAppender's buffer once records have been waiting in it
+for the flush interval, so that the last records before the process goes quiet reach the file
+without waiting for another message to be emitted.
+*/
+class VBinaryLogFlushThread : public VThread {
+    public:
+
+        VBinaryLogFlushThread(VBinaryLogAppender& appender);
+        virtual ~VBinaryLogFlushThread() {}
+
+        virtual void run();
+
+        /**
+        Tells the thread to return, and waits for it.
+        */
+        void stopAndJoin();
+
+    private:
+
+        VBinaryLogAppender& mAppender;
+        VMutex              mMutex;
+        VSemaphore          mStopSemaphore;
+        bool                mStopRequested;
+};
+
+VBinaryLogFlushThread::VBinaryLogFlushThread(VBinaryLogAppender& appender)
+    : VThread(VSTRING_FORMAT("VBinaryLogAppender(%s)", appender.getName().chars()), "vault.toolbox.VBinaryLogAppender", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL)
+    , mAppender(appender)
+    , mMutex(VSTRING_FORMAT("VBinaryLogFlushThread(%s)", appender.getName().chars()), true/*this mutex itself must not log*/)
+    , mStopSemaphore()
+    , mStopRequested(false)
+    {
+}
+
+void VBinaryLogFlushThread::run() {
+    for (;;) {
+        /* locker scope */ {
+            VMutexLocker locker(&mMutex, "VBinaryLogFlushThread::run");
+            if (! mStopRequested) {
+                mStopSemaphore.wait(&mMutex, mAppender.mFlushInterval);
+            }
+
+            if (mStopRequested) {
+                break;
+            }
+        }
+
+        mAppender._flushIfStale();
+    }
+}
+
+void VBinaryLogFlushThread::stopAndJoin() {
+    {
+        VMutexLocker locker(&mMutex, "VBinaryLogFlushThread::stopAndJoin");
+        mStopRequested = true;
+        mStopSemaphore.signal();
+    }
+
+    (void) this->join();
+}
+
+// VBinaryLogAppender --------------------------------------------------------
+
+VBinaryLogAppender::VBinaryLogAppender(const VString& name, const VString& filePath, int indexInterval)
+    : VLogAppender(name, DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY())
+    , mIndexInterval(V_MAX(1, indexInterval))
+    , mBufferSize(kDefaultBufferSize)
+    , mFlushInterval(kDefaultFlushMilliseconds * VDuration::MILLISECOND())
+    , mFileStream(filePath.isEmpty() ? VFSNode(VLogger::getBaseLogDirectory(), name + ".vblog") : VFSNode(filePath))
+    , mBufferedStream(mFileStream, mBufferSize)
+    , mOutputStream(mBufferedStream)
+    , mScratchBuffer()
+    , mScratchStream(mScratchBuffer)
+    , mLastWriteTime()
+    , mFileOffset(0)
+    , mLoggerIDs()
+    , mThreadIDs()
+    , mLoggerBlooms()
+    , mNumSegments(0)
+    , mSegmentIsOpen(false)
+    , mSegmentOffset(0)
+    , mSegmentNumMessages(0)
+    , mSegmentNumDefinitions(0)
+    , mSegmentFirstTime(0)
+    , mSegmentLastTime(0)
+    , mSegmentMostSevereLevel(0)
+    , mSegmentLeastSevereLevel(0)
+    , mSegmentBloom()
+    , mFlushThread(NULL)
+    {
+    this->_open();
+}
+
+VBinaryLogAppender::VBinaryLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults)
+    : VLogAppender(settings, defaults)
+    , mIndexInterval(V_MAX(1, VLogAppender::_getIntInitSetting("index-interval", settings, defaults, kDefaultIndexInterval)))
+    , mBufferSize(CONST_S64(1024) * VLogAppender::_getIntInitSetting("buffer-kbytes", settings, defaults, kDefaultBufferSize / 1024))
+    , mFlushInterval(V_MAX(0, VLogAppender::_getIntInitSetting("flush-ms", settings, defaults, kDefaultFlushMilliseconds)) * VDuration::MILLISECOND())
+    , mFileStream()
+    , mBufferedStream(mFileStream, mBufferSize)
+    , mOutputStream(mBufferedStream)
+    , mScratchBuffer()
+    , mScratchStream(mScratchBuffer)
+    , mLastWriteTime()
+    , mFileOffset(0)
+    , mLoggerIDs()
+    , mThreadIDs()
+    , mLoggerBlooms()
+    , mNumSegments(0)
+    , mSegmentIsOpen(false)
+    , mSegmentOffset(0)
+    , mSegmentNumMessages(0)
+    , mSegmentNumDefinitions(0)
+    , mSegmentFirstTime(0)
+    , mSegmentLastTime(0)
+    , mSegmentMostSevereLevel(0)
+    , mSegmentLeastSevereLevel(0)
+    , mSegmentBloom()
+    , mFlushThread(NULL)
+    {
+    // If no path is specified, we'll use "<appendername>.vblog" in the base log directory.
+    VString defaultPath;
+    VLogger::getBaseLogDirectory().getChildPath(settings.getString("name") + ".vblog", defaultPath);
+    mFileStream.setNode(VFSNode(_getStringInitSetting("path", settings, defaults, defaultPath)));
+
+    this->_open();
+}
+
+VBinaryLogAppender::~VBinaryLogAppender() {
+    if (mFlushThread != NULL) {
+        mFlushThread->stopAndJoin();
+        delete mFlushThread;
+    }
+
+    try {
+        this->_sealSegment();
+        mFileStream.close();
+    } catch (...) {} // block exceptions from propagating
+}
+
+void VBinaryLogAppender::addInfo(VBentoNode& infoNode) const {
+    VLogAppender::addInfo(infoNode);
+    infoNode.addString("type", "VBinaryLogAppender");
+    infoNode.addString("file", mFileStream.getNode().getPath());
+    infoNode.addInt("index-interval", mIndexInterval);
+    infoNode.addS64("buffer-size", mBufferSize);
+    infoNode.addDuration("flush-interval", mFlushInterval);
+    infoNode.addInt("segments", mNumSegments);
+    infoNode.addInt("loggers", static_cast<int>(mLoggerIDs.size()));
+    infoNode.addInt("threads", static_cast<int>(mThreadIDs.size()));
+}
+
+void VBinaryLogAppender::emit(int level, const char* /*file*/, int /*line*/, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine) {
+    VMutexLocker locker(&mMutex, "VBinaryLogAppender::emit");
+
+    const VString& loggerName = specifiedLoggerName.isEmpty() ? actualLoggerName : specifiedLoggerName;
+
+    if (emitMessage) {
+        this->_writeMessage(level, loggerName, false, message, NULL);
+    }
+
+    if (emitRawLine) {
+        this->_writeMessage(level, loggerName, true, rawLine, NULL);
+    }
+}
+
+void VBinaryLogAppender::emitBento(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload) {
+    VMutexLocker locker(&mMutex, "VBinaryLogAppender::emitBento");
+    this->_writeMessage(level, specifiedLoggerName.isEmpty() ? actualLoggerName : specifiedLoggerName, false, message, &payload);
+}
+
+void VBinaryLogAppender::sync() {
+    VMutexLocker locker(&mMutex, "VBinaryLogAppender::sync");
+    this->_sealSegment();
+    this->_writeBuffer();
+}
+
+void VBinaryLogAppender::_emitRawLine(const VString& line) {
+    // Only reached through the base class paths that have neither a level nor a logger name.
+    this->_writeMessage(VLoggerLevel::TRACE, VString::EMPTY(), true, line, NULL);
+}
+
+void VBinaryLogAppender::_flush() {
+    this->_writeBuffer();
+}
+
+void VBinaryLogAppender::_open() {
+    const VFSNode& file = mFileStream.getNode();
+    VFSNode directory;
+    file.getParentNode(directory);
+    directory.mkdirs();
+
+    const bool appending = file.exists();
+    mFileStream.openReadWrite();
+    if (appending) {
+        (void) mFileStream.seek(0, SEEK_END);
+    }
+
+    mFileOffset = mFileStream.getIOOffset();
+
+    (void) mScratchStream.write(kFileHeaderMagic, sizeof(kFileHeaderMagic));
+    mScratchStream.writeS32(kFormatVersion);
+    mScratchStream.writeS64(VInstant().getValue());
+    this->_writeRecord(kFileHeaderRecord);
+    this->_writeBuffer();
+
+    // With a zero flush interval every record is written as it is emitted, so there is nothing for the thread to do.
+    if (mFlushInterval > VDuration::ZERO()) {
+        mFlushThread = new VBinaryLogFlushThread(*this);
+        mFlushThread->start();
+    }
+}
+
+void VBinaryLogAppender::_writeMessage(int level, const VString& loggerName, bool isRawLine, const VString& message, const VBentoNode* payload) {
+    VInstant now;
+
+    // A segment starts with the first message after the previous one was sealed, so that there are no empty segments.
+    if (! mSegmentIsOpen) {
+        this->_beginSegment();
+    }
+
+    // Definitions must precede the message that refers to them, so get the IDs first.
+    const int loggerID = this->_getNameID(mLoggerIDs, kLoggerDefinitionRecord, loggerName);
+
+    VString threadName;
+    try {
+        threadName = VThread::getCurrentThreadName();
+    } catch (...) {
+    }
+
+    const int threadID = this->_getNameID(mThreadIDs, kThreadDefinitionRecord, threadName);
+
+    Vu8 flags = 0;
+    if (isRawLine) {
+        flags |= kMessageFlagRawLine;
+    }
+
+    if (payload != NULL) {
+        flags |= kMessageFlagHasPayload;
+    }
+
+    mScratchStream.writeS64(now.getValue());
+    mScratchStream.writeS32(level);
+    mScratchStream.writeS32(loggerID);
+    mScratchStream.writeS32(threadID);
+    mScratchStream.writeU8(flags);
+    mScratchStream.writeString(message);
+    if (payload != NULL) {
+        payload->writeToStream(mScratchStream);
+    }
+
+    this->_writeRecord(kMessageRecord);
+
+    if (mSegmentNumMessages == 0) {
+        mSegmentFirstTime = now.getValue();
+        mSegmentLastTime = now.getValue();
+        mSegmentMostSevereLevel = level;
+        mSegmentLeastSevereLevel = level;
+    } else {
+        mSegmentFirstTime = V_MIN(mSegmentFirstTime, now.getValue());
+        mSegmentLastTime = V_MAX(mSegmentLastTime, now.getValue());
+        mSegmentMostSevereLevel = V_MIN(mSegmentMostSevereLevel, level);
+        mSegmentLeastSevereLevel = V_MAX(mSegmentLeastSevereLevel, level);
+    }
+
+    mSegmentBloom.addAll(mLoggerBlooms[loggerID]);
+
+    if (++mSegmentNumMessages >= mIndexInterval) {
+        this->_sealSegment();
+    }
+
+    // Don't leave a serious error sitting in the buffer, in case the process is about to die.
+    if ((level <= VLoggerLevel::ERROR) || (now - mLastWriteTime >= mFlushInterval)) {
+        this->_writeBuffer();
+    }
+}
+
+int VBinaryLogAppender::_getNameID(IDMap& ids, Vu8 recordType, const VString& name) {
+    IDMap::const_iterator i = ids.find(name);
+    if (i != ids.end()) {
+        return i->second;
+    }
+
+    const int id = static_cast<int>(ids.size()) + 1;
+    ids[name] = id;
+
+    if (recordType == kLoggerDefinitionRecord) {
+        mLoggerBlooms[id].addLoggerName(name);
+    }
+
+    mScratchStream.writeS32(id);
+    mScratchStream.writeString(name);
+    this->_writeRecord(recordType);
+    ++mSegmentNumDefinitions;
+
+    return id;
+}
+
+void VBinaryLogAppender::_writeRecord(Vu8 recordType) {
+    const Vs64 bodyLength = mScratchBuffer.getEOFOffset();
+    const Vs64 recordLength = kRecordPrefixLength + bodyLength;
+
+    // Write the buffer first rather than let it grow; a record larger than the buffer is written by itself.
+    if (mBufferedStream.getEOFOffset() + recordLength > mBufferSize) {
+        this->_writeBuffer();
+    }
+
+    mOutputStream.writeU8(recordType);
+    mOutputStream.writeS32(static_cast<Vs32>(bodyLength));
+    (void) mOutputStream.write(mScratchBuffer.getBuffer(), bodyLength);
+    mFileOffset += recordLength;
+
+    mScratchBuffer.setEOF(0);
+}
+
+void VBinaryLogAppender::_writeSegmentIndex(Vs64 segmentLength) {
+    (void) mScratchStream.write(kSegmentIndexMagic, sizeof(kSegmentIndexMagic));
+    mScratchStream.writeS64(segmentLength);
+    mScratchStream.writeS32(mSegmentNumMessages);
+    mScratchStream.writeS32(mSegmentNumDefinitions);
+    mScratchStream.writeS64(mSegmentFirstTime);
+    mScratchStream.writeS64(mSegmentLastTime);
+    mScratchStream.writeS32(mSegmentMostSevereLevel);
+    mScratchStream.writeS32(mSegmentLeastSevereLevel);
+    mSegmentBloom.writeToStream(mScratchStream);
+}
+
+void VBinaryLogAppender::_beginSegment() {
+    mSegmentOffset = mFileOffset;
+    mSegmentNumMessages = 0;
+    mSegmentNumDefinitions = 0;
+    mSegmentFirstTime = 0;
+    mSegmentLastTime = 0;
+    mSegmentMostSevereLevel = 0;
+    mSegmentLeastSevereLevel = 0;
+    mSegmentBloom.clear();
+    mSegmentIsOpen = true;
+    ++mNumSegments;
+
+    this->_writeSegmentIndex(kUnsealedSegmentLength);
+    this->_writeRecord(kSegmentIndexRecord);
+}
+
+void VBinaryLogAppender::_sealSegment() {
+    if (! mSegmentIsOpen) {
+        return;
+    }
+
+    // The index record is usually already in the file, so write the buffer and then overwrite the placeholder in place.
+    this->_writeBuffer();
+
+    this->_writeSegmentIndex(mFileOffset - (mSegmentOffset + kRecordPrefixLength + kSegmentIndexBodyLength));
+    (void) mFileStream.seek(mSegmentOffset + kRecordPrefixLength, SEEK_SET);
+    (void) mFileStream.write(mScratchBuffer.getBuffer(), mScratchBuffer.getEOFOffset());
+    (void) mFileStream.seek(0, SEEK_END);
+
+    mScratchBuffer.setEOF(0);
+    mSegmentIsOpen = false;
+}
+
+void VBinaryLogAppender::_writeBuffer() {
+    if (mBufferedStream.getEOFOffset() == 0) {
+        return;
+    }
+
+    mBufferedStream.flush();
+    mLastWriteTime = VInstant();
+}
+
+void VBinaryLogAppender::_flushIfStale() {
+    VMutexLocker locker(&mMutex, "VBinaryLogAppender::_flushIfStale");
+    if ((mBufferedStream.getEOFOffset() != 0) && (VInstant() - mLastWriteTime >= mFlushInterval)) {
+        this->_writeBuffer();
+    }
+}
+
+// VBinaryLogReader ----------------------------------------------------------
+
+VBinaryLogReader::VBinaryLogReader(const VFSNode& file)
+    : mFileStream(file, VMappedFileStream::kAccessSequential)
+    , mInputStream(mFileStream)
+    , mFileLength(0)
+    , mFromTime(VInstant::INFINITE_PAST())
+    , mToTime(VInstant::INFINITE_FUTURE())
+    , mLoggerName()
+    , mMaxLevel(VLoggerLevel::ALL)
+    , mLoggerNames()
+    , mThreadNames()
+    , mNumSegmentsRead(0)
+    , mNumSegmentsSkipped(0)
+    , mNumResyncs(0)
+    , mIsTruncated(false)
+    {
+    mFileStream.openReadOnly();
+    mFileLength = mFileStream.getEOFOffset();
+
+    bool isBinaryLog = false;
+    if (mFileLength >= kRecordPrefixLength + kFileHeaderBodyLength) {
+        Vu8 magic[sizeof(kFileHeaderMagic)];
+        isBinaryLog = (mInputStream.readU8() == kFileHeaderRecord) &&
+                      (mInputStream.readS32() == kFileHeaderBodyLength) &&
+                      (mInputStream.read(magic, sizeof(magic)) == sizeof(magic)) &&
+                      (::memcmp(magic, kFileHeaderMagic, sizeof(magic)) == 0);
+    }
+
+    if (! isBinaryLog) {
+        throw VException(VSTRING_FORMAT("VBinaryLogReader: '%s' is not a binary log file.", file.getPath().chars()));
+    }
+
+    (void) mFileStream.seek(0, SEEK_SET);
+}
+
+VBinaryLogReader::~VBinaryLogReader() {
+}
+
+void VBinaryLogReader::setTimeRange(const VInstant& from, const VInstant& to) {
+    mFromTime = from;
+    mToTime = to;
+}
+
+void VBinaryLogReader::setLoggerName(const VString& loggerName) {
+    mLoggerName = loggerName;
+}
+
+void VBinaryLogReader::setMaxLevel(int maxLevel) {
+    mMaxLevel = maxLevel;
+}
+
+bool VBinaryLogReader::readNext(VBinaryLogRecord& record) {
+    for (;;) {
+        const Vs64 offset = mFileStream.getIOOffset();
+        const Vs64 numBytesRemaining = mFileLength - offset;
+
+        if (numBytesRemaining == 0) {
+            return false;
+        }
+
+        if (numBytesRemaining < kRecordPrefixLength) {
+            mIsTruncated = true;
+            return false;
+        }
+
+        const Vu8 recordType = mInputStream.readU8();
+        const Vs32 bodyLength = mInputStream.readS32();
+        const Vs64 bodyEnd = offset + kRecordPrefixLength + bodyLength;
+
+        if ((! _isKnownRecordType(recordType)) || (bodyLength < 0) || (bodyEnd > mFileLength)) {
+            // Either a damaged record, or a partial one at the end of the file.
+            if (! this->_resync(offset + 1)) {
+                mIsTruncated = true;
+                return false;
+            }
+
+            continue;
+        }
+
+        try {
+            if (this->_readRecord(recordType, bodyEnd, record)) {
+                return true;
+            }
+        } catch (const VException& /*ex*/) {
+            // The body didn't hold what its type says it should.
+            if (! this->_resync(offset + 1)) {
+                mIsTruncated = true;
+                return false;
+            }
+        }
+    }
+}
+
+bool VBinaryLogReader::_readRecord(Vu8 recordType, Vs64 bodyEnd, VBinaryLogRecord& record) {
+    switch (recordType) {
+        case kFileHeaderRecord: {
+            Vu8 magic[sizeof(kFileHeaderMagic)];
+            mInputStream.readGuaranteed(magic, sizeof(magic));
+            if (::memcmp(magic, kFileHeaderMagic, sizeof(magic)) != 0) {
+                throw VException("VBinaryLogReader: Invalid file header record.");
+            }
+
+            // The appender that wrote this header starts numbering its names over again.
+            mLoggerNames.clear();
+            mThreadNames.clear();
+            break;
+        }
+
+        case kSegmentIndexRecord:
+            this->_readSegmentIndex(bodyEnd);
+            return false; // _readSegmentIndex() leaves the stream positioned at the next record to read
+
+        case kLoggerDefinitionRecord:
+        case kThreadDefinitionRecord:
+            (void) this->_readDefinition(recordType);
+            break;
+
+        case kMessageRecord: {
+            const VInstant when = VInstant::instantFromRawValue(mInputStream.readS64());
+            const int level = mInputStream.readS32();
+            const int loggerID = mInputStream.readS32();
+            const int threadID = mInputStream.readS32();
+            const Vu8 flags = mInputStream.readU8();
+
+            // Check the filter before decoding the text and payload.
+            const VString& loggerName = mLoggerNames[loggerID];
+            if ((when < mFromTime) || (when > mToTime) || (level > mMaxLevel) || ! this->_matchesLoggerName(loggerName)) {
+                break;
+            }
+
+            // Check the string length before reading it, so a damaged length can't cause a huge allocation.
+            const Vs64 textOffset = mFileStream.getIOOffset();
+            const Vs64 textLength = mInputStream.readDynamicCount();
+            if ((textLength < 0) || (mFileStream.getIOOffset() + textLength > bodyEnd)) {
+                throw VException("VBinaryLogReader: Invalid message text length.");
+            }
+
+            (void) mFileStream.seek(textOffset, SEEK_SET);
+
+            record.mWhen = when;
+            record.mLevel = level;
+            record.mLoggerName = loggerName;
+            record.mThreadName = mThreadNames[threadID];
+            record.mIsRawLine = ((flags & kMessageFlagRawLine) != 0);
+            record.mHasPayload = ((flags & kMessageFlagHasPayload) != 0);
+            mInputStream.readString(record.mMessage);
+
+            record.mPayload.clear();
+            if (record.mHasPayload) {
+                record.mPayload.readFromStream(mInputStream);
+            }
+
+            if (mFileStream.getIOOffset() != bodyEnd) {
+                throw VException("VBinaryLogReader: Invalid message record length.");
+            }
+
+            return true;
+        }
+
+        default:
+            break;
+    }
+
+    (void) mFileStream.seek(bodyEnd, SEEK_SET);
+    return false;
+}
+
+void VBinaryLogReader::_readSegmentIndex(Vs64 bodyEnd) {
+    Vu8 magic[sizeof(kSegmentIndexMagic)];
+    mInputStream.readGuaranteed(magic, sizeof(magic));
+    if (::memcmp(magic, kSegmentIndexMagic, sizeof(magic)) != 0) {
+        throw VException("VBinaryLogReader: Invalid segment index record.");
+    }
+
+    const Vs64 segmentLength = mInputStream.readS64();
+    const int numMessages = mInputStream.readS32();
+    const int numDefinitions = mInputStream.readS32();
+    const VInstant firstTime = VInstant::instantFromRawValue(mInputStream.readS64());
+    const VInstant lastTime = VInstant::instantFromRawValue(mInputStream.readS64());
+    const int mostSevereLevel = mInputStream.readS32();
+    (void) mInputStream.readS32(); // least severe level; not needed for filtering
+    VBinaryLogBloomFilter loggerNames;
+    loggerNames.readFromStream(mInputStream);
+
+    (void) mFileStream.seek(bodyEnd, SEEK_SET);
+
+    // An unsealed segment's index is empty, so it must be read; so must a sealed one that doesn't fit in the file.
+    const Vs64 segmentEnd = bodyEnd + segmentLength;
+    if ((segmentLength == kUnsealedSegmentLength) || (segmentLength < 0) || (segmentEnd > mFileLength)) {
+        ++mNumSegmentsRead;
+        return;
+    }
+
+    const bool mayMatch = (numMessages > 0) &&
+                          (lastTime >= mFromTime) &&
+                          (firstTime <= mToTime) &&
+                          (mostSevereLevel <= mMaxLevel) &&
+                          (mLoggerName.isEmpty() || loggerNames.mayContain(mLoggerName));
+
+    if (mayMatch) {
+        ++mNumSegmentsRead;
+    } else {
+        this->_skipSegment(segmentEnd, numDefinitions > 0);
+        ++mNumSegmentsSkipped;
+    }
+}
+
+void VBinaryLogReader::_skipSegment(Vs64 segmentEnd, bool hasDefinitions) {
+    if (! hasDefinitions) {
+        (void) mFileStream.seek(segmentEnd, SEEK_SET);
+        return;
+    }
+
+    // Later segments may refer to names defined in this one, so visit its records, reading only the definitions.
+    while (mFileStream.getIOOffset() + kRecordPrefixLength <= segmentEnd) {
+        const Vu8 recordType = mInputStream.readU8();
+        const Vs32 bodyLength = mInputStream.readS32();
+        const Vs64 bodyEnd = mFileStream.getIOOffset() + bodyLength;
+        if ((bodyLength < 0) || (bodyEnd > segmentEnd)) {
+            break;
+        }
+
+        (void) this->_readDefinition(recordType);
+        (void) mFileStream.seek(bodyEnd, SEEK_SET);
+    }
+
+    (void) mFileStream.seek(segmentEnd, SEEK_SET);
+}
+
+bool VBinaryLogReader::_readDefinition(Vu8 recordType) {
+    if ((recordType != kLoggerDefinitionRecord) && (recordType != kThreadDefinitionRecord)) {
+        return false;
+    }
+
+    const int id = mInputStream.readS32();
+    VString name;
+    mInputStream.readString(name);
+
+    if (recordType == kLoggerDefinitionRecord) {
+        mLoggerNames[id] = name;
+    } else {
+        mThreadNames[id] = name;
+    }
+
+    return true;
+}
+
+bool VBinaryLogReader::_matchesLoggerName(const VString& loggerName) const {
+    if (mLoggerName.isEmpty() || (loggerName == mLoggerName)) {
+        return true;
+    }
+
+    return loggerName.startsWith(mLoggerName) && (loggerName.length() > mLoggerName.length()) && (loggerName.charAt(mLoggerName.length()) == '.');
+}
+
+bool VBinaryLogReader::_resync(Vs64 fromOffset) {
+    ++mNumResyncs;
+
+    // Look for the prefix and magic number of a segment index or file header record.
+    const int kSignatureLength = static_cast<int>(kRecordPrefixLength) + 4;
+    Vu8 window[kSignatureLength];
+    int numBytesInWindow = 0;
+
+    (void) mFileStream.seek(fromOffset, SEEK_SET);
+    while (mFileStream.getIOOffset() < mFileLength) {
+        if (numBytesInWindow == kSignatureLength) {
+            ::memmove(window, window + 1, kSignatureLength - 1);
+            --numBytesInWindow;
+        }
+
+        window[numBytesInWindow++] = mInputStream.readU8();
+        if (numBytesInWindow < kSignatureLength) {
+            continue;
+        }
+
+        const Vs32 bodyLength = static_cast<Vs32>((window[1] << 24) | (window[2] << 16) | (window[3] << 8) | window[4]);
+        const bool isSegmentIndex = (window[0] == kSegmentIndexRecord) && (bodyLength == kSegmentIndexBodyLength) && (::memcmp(window + 5, kSegmentIndexMagic, 4) == 0);
+        const bool isFileHeader = (window[0] == kFileHeaderRecord) && (bodyLength == kFileHeaderBodyLength) && (::memcmp(window + 5, kFileHeaderMagic, 4) == 0);
+        if (isSegmentIndex || isFileHeader) {
+            (void) mFileStream.seek(-kSignatureLength, SEEK_CUR);
+            return true;
+        }
+    }
+
+    return false;
+}
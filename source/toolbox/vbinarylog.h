@@ -0,0 +1,311 @@
+/*
+Copyright c1997-2014 Trygve Isaacson. All rights reserved.
+This file is part of the Code Vault version 4.1
+http://www.bombaydigital.com/
+License: MIT. See LICENSE.md in the Vault top level directory.
+*/
+
+#ifndef vbinarylog_h
+#define vbinarylog_h
+
+/** @file */
+
+#include "vlogger.h"
+#include "vmappedfilestream.h"
+#include "vmemorystream.h"
+#include "vbinaryiostream.h"
+#include "vbento.h"
+
+#include <map>
+
+/**
+    @ingroup vlogger
+*/
+
+/*
+The binary log file format, shared by VBinaryLogAppender and VBinaryLogReader.
+
+A file is a sequence of records. Every record starts with a 1-byte type code and a 4-byte body
+length, so a reader can step over a record it isn't interested in (or doesn't understand) without
+decoding it. All numbers are big-endian, as written by VBinaryIOStream; times are VInstant values
+(UTC milliseconds); strings use the VBinaryIOStream dynamic length encoding.
+
+'H' file header. Written each time an appender opens the file, since an appender appends to an
+    existing file. Body: 'VBLG', Vs32 format version, Vs64 time opened. The logger and thread IDs
+    defined after one header are unrelated to those defined after another.
+'S' segment index. Written before every run of records (a "segment"); the records up to the next
+    'S' or 'H' belong to it. Written as a placeholder when the segment starts, and filled in when
+    it is sealed. Body: 'VBSG', Vs64 length of the segment's records in bytes (-1 until sealed),
+    Vs32 number of messages, Vs32 number of definitions, Vs64 earliest and latest message times,
+    Vs32 most and least severe message levels, and a 256-bit bloom filter of the logger names
+    (and their dotted prefixes) of the segment's messages.
+'L' logger name definition. Body: Vs32 logger ID, string name.
+'T' thread name definition. Body: Vs32 thread ID, string name.
+'M' message. Body: Vs64 time, Vs32 level, Vs32 logger ID, Vs32 thread ID, Vu8 flags, string text,
+    then a Bento binary payload if the payload flag is set.
+*/
+
+/**
+The 256-bit bloom filter of logger names kept in each segment index. Adding a name also adds its
+dotted prefixes, so that the filter can answer whether a segment may contain messages logged to a
+logger or to any logger beneath it.
+*/
+class VBinaryLogBloomFilter {
+    public:
+
+        static const int kNumBytes = 32; ///< The size of the filter.
+
+        VBinaryLogBloomFilter() { this->clear(); }
+        ~VBinaryLogBloomFilter() {}
+
+        void clear();                                       ///< Removes all names.
+        void addLoggerName(const VString& loggerName);      ///< Adds the name and each of its dotted prefixes. @param loggerName obvious
+        void addAll(const VBinaryLogBloomFilter& other);    ///< Adds the names in another filter. @param other obvious
+        bool mayContain(const VString& loggerName) const;   ///< Returns false if the name was definitely not added. @param loggerName obvious @return obvious
+
+        void writeToStream(VBinaryIOStream& stream) const;  ///< Writes the filter bits. @param stream obvious
+        void readFromStream(VBinaryIOStream& stream);       ///< Reads the filter bits. @param stream obvious
+
+    private:
+
+        void _addHash(Vu32 hash); ///< Sets the bits for one name's hash.
+
+        Vu8 mBits[kNumBytes];
+};
+
+/**
+A message read back from a binary log file by VBinaryLogReader.
+*/
+class VBinaryLogRecord {
+    public:
+
+        VBinaryLogRecord();
+        ~VBinaryLogRecord() {}
+
+        /**
+        Returns the record as a line of text in the same layout as the default appender format.
+        @param  utc true to show the time in UTC rather than local time
+        @return the formatted line
+        */
+        VString format(bool utc = false) const;
+
+        VInstant    mWhen;          ///< The time the message was logged.
+        int         mLevel;         ///< The level at which it was logged.
+        VString     mLoggerName;    ///< The logger name (the specified name, if the caller gave one).
+        VString     mThreadName;    ///< The name of the thread that logged it.
+        bool        mIsRawLine;     ///< True if the message is a raw line, such as a hex dump or stack crawl line.
+        VString     mMessage;       ///< The message text.
+        bool        mHasPayload;    ///< True if the message was logged with a Bento payload.
+        VBentoNode  mPayload;       ///< The payload, if mHasPayload is set.
+
+    private:
+
+        VBinaryLogRecord(const VBinaryLogRecord&); // not copyable
+        VBinaryLogRecord& operator=(const VBinaryLogRecord&); // not assignable
+};
+
+/**
+An appender that writes compact binary records to a single file, rather than formatted text.
+Nothing is formatted at log time: a message costs a few integers plus its text, and a message
+logged with a Bento payload (VLOGGER_NAMED_BENTO) keeps the payload in its binary form. Logger
+and thread names are written once, the first time they appear, and referred to by number after that.
+
+Records are grouped into segments, each of which is preceded by a small index record holding the
+time range, level range, and logger names of its messages. VBinaryLogReader uses the index to skip
+whole segments that cannot match its filter without reading them. The index of the current segment
+is filled in when the segment is sealed, which happens after a set number of messages and when the
+appender is destroyed; if the process dies first, the reader simply scans the unsealed segment.
+
+Like VRollingFileLogAppender, records are collected in a buffer that is written to the file when it
+fills up, when a message at ERROR level or more severe is emitted, and otherwise at the flush
+interval, by a background thread that writes records that have been waiting that long. This
+appender does no formatting, and VLogger ignores the "async" setting for it; the asynchronous
+writer would hand it the messages as formatted text, without their level or logger name.
+
+If the file already exists, it is appended to. Use the vbinarylogdecoder tool in extras/tools, or
+VBinaryLogReader, to read it.
+
+It defines the following additional properties:
+- "path" (string)
+  Defaults to the appender name plus ".vblog" in the base log directory. The file to write.
+- "index-interval" (int)
+  Defaults to 1000. The number of messages in each segment.
+- "buffer-kbytes" (int)
+  Defaults to 64. The size of the write buffer.
+- "flush-ms" (int)
+  Defaults to 1000. How often the background thread writes records that have been waiting in the
+  buffer; 0 means each record is written as soon as it is emitted, and no thread is started.
+*/
+class VBinaryLogFlushThread;
+
+class VBinaryLogAppender : public VLogAppender {
+    public:
+
+        static const int kDefaultIndexInterval = 1000;      ///< The default number of messages per segment.
+        static const int kDefaultBufferSize = 64 * 1024;    ///< The default write buffer size in bytes.
+        static const int kDefaultFlushMilliseconds = 1000;  ///< The default longest time a message waits in the buffer.
+
+        VBinaryLogAppender(const VString& name, const VString& filePath, int indexInterval = kDefaultIndexInterval);
+        VBinaryLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults);
+        /**
+        Stops the flush thread, seals the current segment, writes the buffer, and closes the file.
+        */
+        virtual ~VBinaryLogAppender();
+        virtual void addInfo(VBentoNode& infoNode) const;
+
+        /**
+        Writes a message record for the message and/or raw line.
+        */
+        virtual void emit(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine);
+        /**
+        Writes a message record that includes the payload in Bento binary form.
+        */
+        virtual void emitBento(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload);
+
+        /**
+        Seals the current segment and writes all buffered records to the file.
+        */
+        void sync();
+
+        const VFSNode& getFile() const { return mFileStream.getNode(); }    ///< Returns the file being written. @return obvious
+        int getNumSegments() const { return mNumSegments; }                 ///< Returns the number of segments started by this appender. @return obvious
+
+    protected:
+
+        virtual void _emitRawLine(const VString& line);
+        virtual void _flush();
+
+    private:
+
+        VBinaryLogAppender(const VBinaryLogAppender&); // not copyable
+        VBinaryLogAppender& operator=(const VBinaryLogAppender&); // not assignable
+
+        typedef std::map<VString, int> IDMap;
+
+        void _open();   ///< Constructor helper; opens or creates the file, writes the file header, and starts the flush thread.
+        /**
+        Writes one message record, starting or sealing a segment and writing the buffer as needed.
+        The caller must hold mMutex.
+        */
+        void _writeMessage(int level, const VString& loggerName, bool isRawLine, const VString& message, const VBentoNode* payload);
+        /**
+        Returns the ID for the name, first writing a definition record if it is new.
+        */
+        int _getNameID(IDMap& ids, Vu8 recordType, const VString& name);
+        void _writeRecord(Vu8 recordType);  ///< Writes mScratchBuffer to the buffered stream as the body of a record of the specified type.
+        void _writeSegmentIndex(Vs64 segmentLength); ///< Writes the current segment's index record body to mScratchBuffer.
+        void _beginSegment();               ///< Writes a placeholder index record and resets the segment statistics.
+        void _sealSegment();                ///< If a segment is open, writes the buffer and fills in the segment's index record in the file.
+        void _writeBuffer();                ///< Writes the buffered records to the file.
+
+        friend class VBinaryLogFlushThread;
+        void _flushIfStale(); ///< Locks and writes the buffer if it has been at least mFlushInterval since it was last written.
+
+        int                     mIndexInterval;     ///< The number of messages per segment.
+        Vs64                    mBufferSize;        ///< The size of the write buffer.
+        VDuration               mFlushInterval;     ///< The longest time a message waits in the buffer.
+        VDirectIOFileStream     mFileStream;        ///< The file; written only in whole buffers, except for sealing segments.
+        VWriteBufferedStream    mBufferedStream;    ///< The write buffer.
+        VBinaryIOStream         mOutputStream;      ///< The binary stream that records are written to.
+        VMemoryStream           mScratchBuffer;     ///< Each record body is assembled here, so its length is known before it is written.
+        VBinaryIOStream         mScratchStream;     ///< The binary stream on mScratchBuffer.
+        VInstant                mLastWriteTime;     ///< When the buffer was last written to the file.
+        Vs64                    mFileOffset;        ///< The logical end of file, including buffered records.
+        IDMap                   mLoggerIDs;         ///< The IDs of the logger names defined so far.
+        IDMap                   mThreadIDs;         ///< The IDs of the thread names defined so far.
+        std::map<int, VBinaryLogBloomFilter> mLoggerBlooms; ///< For each logger ID, the bloom filter of its name, so it is only computed once.
+        int                     mNumSegments;       ///< The number of segments started.
+        bool                    mSegmentIsOpen;     ///< True if a segment has been started and not yet sealed.
+        Vs64                    mSegmentOffset;     ///< The file offset of the current segment's index record.
+        int                     mSegmentNumMessages;    ///< Index of the current segment: the number of messages.
+        int                     mSegmentNumDefinitions; ///< Index of the current segment: the number of definitions.
+        Vs64                    mSegmentFirstTime;      ///< Index of the current segment: the earliest message time.
+        Vs64                    mSegmentLastTime;       ///< Index of the current segment: the latest message time.
+        int                     mSegmentMostSevereLevel;    ///< Index of the current segment: the lowest message level value.
+        int                     mSegmentLeastSevereLevel;   ///< Index of the current segment: the highest message level value.
+        VBinaryLogBloomFilter   mSegmentBloom;          ///< Index of the current segment: the logger name bloom filter.
+        VBinaryLogFlushThread*  mFlushThread;           ///< The background thread that writes waiting records; NULL if the flush interval is zero.
+};
+
+/**
+Reads the messages from a binary log file written by VBinaryLogAppender, optionally filtering them
+by time range, logger name, and level. Segments whose index shows that none of their messages can
+match are skipped without being read (other than any name definitions they contain), and within a
+segment, the text and payload of a message are only decoded if the message matches.
+
+The reader tolerates damage: if it finds a record that makes no sense, it scans forward for the
+next segment or file header and carries on from there; and it stops quietly at a partial record at
+the end of the file, as left by a process that died while writing.
+*/
+class VBinaryLogReader {
+    public:
+
+        /**
+        Opens the file. Throws a VException if it cannot be opened or is not a binary log file.
+        @param  file    the file to read
+        */
+        VBinaryLogReader(const VFSNode& file);
+        ~VBinaryLogReader();
+
+        /**
+        Only return messages logged within the time range (inclusive).
+        @param  from    the earliest time, or VInstant::INFINITE_PAST() for no limit
+        @param  to      the latest time, or VInstant::INFINITE_FUTURE() for no limit
+        */
+        void setTimeRange(const VInstant& from, const VInstant& to);
+        /**
+        Only return messages logged to the specified logger, or to a logger beneath it in the dotted
+        name hierarchy; for example, "vault.sockets" matches "vault.sockets.VSocket".
+        @param  loggerName  the logger name, or empty for all loggers
+        */
+        void setLoggerName(const VString& loggerName);
+        /**
+        Only return messages at the specified level or more severe.
+        @param  maxLevel    the level, for example VLoggerLevel::WARN
+        */
+        void setMaxLevel(int maxLevel);
+
+        /**
+        Reads the next message that matches the filter.
+        @param  record  the record to fill in
+        @return false if there are no more matching messages
+        */
+        bool readNext(VBinaryLogRecord& record);
+
+        int getNumSegmentsRead() const { return mNumSegmentsRead; }         ///< Returns the number of segments whose messages were examined. @return obvious
+        int getNumSegmentsSkipped() const { return mNumSegmentsSkipped; }   ///< Returns the number of segments skipped using their index. @return obvious
+        int getNumResyncs() const { return mNumResyncs; }                   ///< Returns the number of times damage caused the reader to scan for the next segment. @return obvious
+        bool isTruncated() const { return mIsTruncated; }                   ///< Returns true if the file ended with a partial record. @return obvious
+
+    private:
+
+        VBinaryLogReader(const VBinaryLogReader&); // not copyable
+        VBinaryLogReader& operator=(const VBinaryLogReader&); // not assignable
+
+        /**
+        Processes the record body at the current offset, which has been checked to lie within the file.
+        @return true if it was a matching message, now in record
+        */
+        bool _readRecord(Vu8 recordType, Vs64 bodyEnd, VBinaryLogRecord& record);
+        void _readSegmentIndex(Vs64 bodyEnd);   ///< Reads an index record, and skips the segment if it cannot match.
+        void _skipSegment(Vs64 segmentEnd, bool hasDefinitions); ///< Moves past a segment, reading only its definition records.
+        bool _readDefinition(Vu8 recordType);   ///< Reads a logger or thread definition record. @return true if it was one
+        bool _matchesLoggerName(const VString& loggerName) const;
+        bool _resync(Vs64 fromOffset);          ///< Scans for the next segment or file header record. @return false if there is none
+
+        VMappedFileStream       mFileStream;        ///< The file.
+        VBinaryIOStream         mInputStream;       ///< The binary stream on mFileStream.
+        Vs64                    mFileLength;        ///< The length of the file.
+        VInstant                mFromTime;          ///< The filter's earliest time.
+        VInstant                mToTime;            ///< The filter's latest time.
+        VString                 mLoggerName;        ///< The filter's logger name, or empty.
+        int                     mMaxLevel;          ///< The filter's level.
+        std::map<int, VString>  mLoggerNames;       ///< The logger names defined so far, by ID.
+        std::map<int, VString>  mThreadNames;       ///< The thread names defined so far, by ID.
+        int                     mNumSegmentsRead;
+        int                     mNumSegmentsSkipped;
+        int                     mNumResyncs;
+        bool                    mIsTruncated;
+};
+
+#endif /* vbinarylog_h */
@@ -9,12 +9,23 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vlogger.h"
 
+#include "vasyncfilestream.h"
+#include "vbinarylog.h"
 #include "vthread.h"
 #include "vmutexlocker.h"
+#include "vsemaphore.h"
+#include "vtimerwheel.h"
+#include "vexception.h"
 #include "vsettings.h"
 #include "vbento.h"
 #include "vchar.h"
 
+#include <algorithm>
+
+#ifdef VAULT_ZLIB_SUPPORT
+#include <zlib.h>
+#endif
+
 static const VNamedLoggerPtr NULL_NAMED_LOGGER_PTR;
 static const VLogAppenderPtr NULL_LOG_APPENDER_PTR;
 
@@ -33,7 +44,8 @@ VNamedLogger::VNamedLogger(const VString& name, int level, const VStringVector&
     , mAppenderNames(appenderNames)
     , mSpecificAppender(specificAppender)
     , mRepetitionFilter()
-    , mPrintStackConfig() {
+    , mPrintStackConfig()
+    , mThrottle() {
     if (appenderNames.empty() && (specificAppender == NULL_LOG_APPENDER_PTR)) {
         mAppenderNames.push_back(VString::EMPTY());
     }
@@ -93,6 +105,7 @@ void VNamedLogger::addInfo(VBentoNode& infoNode) const {
 
     infoNode.addBool("repetition-filter-enabled", mRepetitionFilter.isEnabled());
     infoNode.addInt("print-stack-level", mPrintStackConfig.getLevel());
+    mThrottle.addInfo(infoNode);
 }
 
 void VNamedLogger::log(int level, const VString& message) {
@@ -123,6 +136,17 @@ void VNamedLogger::logHexDump(int level, const VString& message, const VString&
     this->_emitToAppenders(level, NULL, 0, true, message, specifiedLoggerName, true, hexString);
 }
 
+void VNamedLogger::logBento(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload) {
+    if (level > mLevel) {
+        return;
+    }
+
+    VNamedLogger::_breakpointLocationForLog();
+
+    VMutexLocker locker(&mAppendersMutex, "VNamedLogger::logBento");
+    this->_emitBentoToAppenders(level, message, specifiedLoggerName, payload);
+}
+
 void VNamedLogger::emitStackCrawlLine(const VString& message) {
     VMutexLocker locker(&mAppendersMutex, "VNamedLogger::emitStackCrawlLine");
     this->_emitToAppenders(VLoggerLevel::TRACE /* not used for raw line emit */, NULL, 0, false, VString::EMPTY(), VString::EMPTY(), true, message);
@@ -151,6 +175,19 @@ void VNamedLogger::_emitToAppenders(int level, const char* file, int line, bool
     VLogger::emitToGlobalAppenders(level, file, line, emitMessage, message, specifiedLoggerName, mName, emitRawLine, rawLine);
 }
 
+void VNamedLogger::_emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload) {
+    if (mSpecificAppender != NULL_LOG_APPENDER_PTR) {
+        mSpecificAppender->emitBento(level, message, specifiedLoggerName, mName, payload);
+    }
+
+    for (VStringVector::const_iterator i = mAppenderNames.begin(); i != mAppenderNames.end(); ++i) {
+        VLogAppenderPtr appender = (*i).isEmpty() ? VLogger::getDefaultAppender() : VLogger::getAppender(*i);
+        appender->emitBento(level, message, specifiedLoggerName, mName, payload);
+    }
+
+    VLogger::emitBentoToGlobalAppenders(level, message, specifiedLoggerName, mName, payload);
+}
+
 VString VNamedLogger::_toString() const {
     VString s(VSTRING_ARGS("VNamedLogger '%s' (%d) ->", mName.chars(), mLevel));
 
@@ -203,6 +240,17 @@ class VRollingFileLogAppenderFactory : public VLogAppenderFactory {
             { infoNode.addString("type", "VRollingFileLogAppenderFactory"); }
 };
 
+class VBinaryLogAppenderFactory : public VLogAppenderFactory {
+    public:
+        VBinaryLogAppenderFactory() : VLogAppenderFactory() {}
+        virtual ~VBinaryLogAppenderFactory() {}
+
+        virtual VLogAppenderPtr instantiateLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults) const
+            { return VLogAppenderPtr(new VBinaryLogAppender(settings, defaults)); }
+        virtual void addInfo(VBentoNode& infoNode) const
+            { infoNode.addString("type", "VBinaryLogAppenderFactory"); }
+};
+
 class VSilentLogAppenderFactory : public VLogAppenderFactory {
     public:
         VSilentLogAppenderFactory() : VLogAppenderFactory() {}
@@ -248,11 +296,171 @@ static VMutex* _mutexInstance() {
 // _mutexInstance() must be used internally whenever referencing these static accessors:
 
 typedef std::map<VString, VNamedLoggerPtr> VNamedLoggerMap;
+typedef std::vector<VNamedLoggerPtr> VNamedLoggerList;
 static VNamedLoggerMap& _getLoggerMap() {
     static VNamedLoggerMap* gLoggerMap = new VNamedLoggerMap();
     return *gLoggerMap;
 };
 
+/**
+VNamedLoggerSnapshot is an immutable copy of the logger map and default logger, published for
+lock-free lookups. A snapshot that has been replaced may still be in use by a thread that loaded
+it just before, so it is retired rather than deleted, and deleted once no thread is reading;
+see VLoggerReadSection.
+*/
+class VNamedLoggerSnapshot {
+    public:
+
+        VNamedLoggerSnapshot(Vu64 generation, const VNamedLoggerMap& loggers, VNamedLoggerPtr defaultLogger)
+            : mGeneration(generation)
+            , mLoggers(loggers)
+            , mDefaultLogger(defaultLogger)
+            {
+        }
+
+        // Returns the logger with the specified name, or null if it doesn't exist. (@ Nullable)
+        VNamedLogger* findFromExactName(const VString& name) const {
+            VNamedLoggerMap::const_iterator pos = mLoggers.find(name);
+            return (pos == mLoggers.end()) ? NULL : pos->second.get();
+        }
+
+        // Returns a logger using a dot-separated path name, falling back to an exact name find. (@ Nullable)
+        VNamedLogger* findFromPathName(const VString& pathName) const {
+            // Most names are found as is, so don't copy the name unless we need to strip segments.
+            VNamedLogger* foundLogger = this->findFromExactName(pathName);
+            if ((foundLogger != NULL) || !pathName.contains('.')) {
+                return foundLogger;
+            }
+
+            VString nextNameToSearch(pathName);
+            do {
+                nextNameToSearch.substringInPlace(0, nextNameToSearch.lastIndexOf('.'));
+                foundLogger = this->findFromExactName(nextNameToSearch);
+            } while ((foundLogger == NULL) && nextNameToSearch.contains('.'));
+
+            return foundLogger;
+        }
+
+        const Vu64              mGeneration;    ///< Incremented for each snapshot published, so that call site caches can tell whether they are current.
+        const VNamedLoggerMap   mLoggers;       ///< The registered loggers at the time the snapshot was published.
+        const VNamedLoggerPtr   mDefaultLogger; ///< The default logger at the time the snapshot was published. (@ Nullable)
+};
+
+/**
+VLoggerCallSiteEntry is the immutable resolution that a VLoggerCallSiteCache points to. An entry
+that has been replaced may still be read by another thread, so like a snapshot it is retired
+rather than deleted. The raw logger pointer is kept alive by the snapshot of the same generation,
+and is not used once that generation has been replaced.
+*/
+class VLoggerCallSiteEntry {
+    public:
+
+        VLoggerCallSiteEntry(Vu64 generation, const VString& name, VNamedLogger* logger)
+            : mGeneration(generation)
+            , mName(name)
+            , mLogger(logger)
+            {
+        }
+
+        const Vu64          mGeneration;    ///< The generation of the snapshot the name was resolved in.
+        const VString       mName;          ///< The logger name that was resolved.
+        VNamedLogger* const mLogger;        ///< The logger it resolved to, including the fallback to the default logger. (@ Nullable)
+};
+
+// The published snapshot is read without locking; it is only replaced while holding _mutexInstance().
+static std::atomic<const VNamedLoggerSnapshot*> gLoggerSnapshot(NULL);
+static Vu64 gLoggerSnapshotGeneration = 0;
+
+// The number of threads currently inside a VLoggerReadSection.
+static std::atomic<int> gNumLoggerReaders(0);
+
+/**
+VLoggerReadSection brackets a use of the published snapshot or of a call site entry. Replaced
+snapshots and entries are retired, and VLogger::_reclaimRetiredLoggerObjects() deletes them only when
+no thread is inside a read section. A reader that could still see a retired object must have entered
+its section before the object was replaced, so it is counted when the retired objects are checked.
+Sections cover only the lookup; a logger found there is returned as a VNamedLoggerPtr, so it stays
+valid after the section ends even if it is deregistered meanwhile.
+*/
+class VLoggerReadSection {
+    public:
+        VLoggerReadSection() { gNumLoggerReaders.fetch_add(1); }
+        ~VLoggerReadSection() { gNumLoggerReaders.fetch_sub(1); }
+};
+
+/**
+VLoggerSummaryTimerTask fires once a second on the shared timer wheel, and reports the summaries of
+suppressed messages that are due for the registered loggers. Otherwise a logger's summary would wait
+for its next throttled message, so that of a burst that is not followed by another would never appear.
+It is scheduled when a throttle is first configured, and cancelled by VLogger::shutdown().
+*/
+class VLoggerSummaryTimerTask : public VTimerTask {
+    public:
+        VLoggerSummaryTimerTask() : VTimerTask("VLoggerSummaryTimerTask") {}
+        virtual ~VLoggerSummaryTimerTask() {}
+        virtual void fire();
+};
+
+static VLoggerSummaryTimerTask& _getSummaryTimerTask() {
+    static VLoggerSummaryTimerTask* gSummaryTimerTask = new VLoggerSummaryTimerTask();
+    return *gSummaryTimerTask;
+}
+
+static std::atomic<bool> gSummaryTimerScheduled(false);
+
+static void _scheduleSummaryTimer() {
+    if (! gSummaryTimerScheduled.exchange(true)) {
+        VTimerWheel::getSharedWheel().schedule(&_getSummaryTimerTask(), VDuration::SECOND(), VDuration::SECOND());
+    }
+}
+
+static void _cancelSummaryTimer() {
+    (void) _getSummaryTimerTask().cancel();
+    gSummaryTimerScheduled.store(false);
+}
+
+// Reports the registered loggers' suppressed message counts: those whose summary is due, or else all of them.
+static void _reportSuppressedMessages(bool onlyIfDue) {
+    VNamedLoggerMap loggers;
+    {
+        VLoggerReadSection readSection;
+        const VNamedLoggerSnapshot* snapshot = gLoggerSnapshot.load(std::memory_order_acquire);
+        if (snapshot != NULL) {
+            loggers = snapshot->mLoggers;
+        }
+    }
+
+    for (VNamedLoggerMap::const_iterator i = loggers.begin(); i != loggers.end(); ++i) {
+        VLoggerThrottle& throttle = i->second->getThrottle();
+        if (throttle.getNumSuppressed() == 0) {
+            continue;
+        }
+
+        if (onlyIfDue) {
+            throttle.reportIfDue(*(i->second));
+        } else {
+            throttle.reportSuppressed(*(i->second));
+        }
+    }
+}
+
+void VLoggerSummaryTimerTask::fire() {
+    _reportSuppressedMessages(true);
+}
+
+// _mutexInstance() must be held when referencing the retired object lists.
+typedef std::vector<const VNamedLoggerSnapshot*> VNamedLoggerSnapshotList;
+static VNamedLoggerSnapshotList& _getRetiredLoggerSnapshots() {
+    static VNamedLoggerSnapshotList* gRetiredLoggerSnapshots = new VNamedLoggerSnapshotList();
+    return *gRetiredLoggerSnapshots;
+}
+
+typedef std::vector<const VLoggerCallSiteEntry*> VLoggerCallSiteEntryList;
+static VLoggerCallSiteEntryList& _getRetiredCallSiteEntries() {
+    static VLoggerCallSiteEntryList* gRetiredCallSiteEntries = new VLoggerCallSiteEntryList();
+    return *gRetiredCallSiteEntries;
+}
+
 typedef std::map<VString, VLogAppenderPtr> VLogAppendersMap;
 static VLogAppendersMap& _getAppendersMap() {
     static VLogAppendersMap* gAppendersMap = new VLogAppendersMap();
@@ -325,17 +533,40 @@ int VLoggerLevel::fromString(const VString& value) {
 // static
 void VLogger::installNewLogAppender(const VSettingsNode& appenderSettings, const VSettingsNode& appenderDefaults) {
     VMutexLocker locker(_mutexInstance(), "VLogger::installNewLogAppender");
-    VLogAppenderFactoriesMap::const_iterator pos = _getAppenderFactoriesMap().find(appenderSettings.getString("kind"));
+    const VString kind = appenderSettings.getString("kind");
+    VLogAppenderFactoriesMap::const_iterator pos = _getAppenderFactoriesMap().find(kind);
     if (pos != _getAppenderFactoriesMap().end()) {
         VLogAppenderPtr appender = pos->second->instantiateLogAppender(appenderSettings, appenderDefaults);
+        bool asyncIgnored = false;
+        if (VAsyncLogAppender::isAsyncConfigured(appenderSettings, appenderDefaults)) {
+            // The asynchronous writer hands the wrapped appender formatted lines, which would cost the
+            // binary appender's records their level and logger name. It does no formatting anyway.
+            if (kind == "binary") {
+                asyncIgnored = true;
+            } else {
+                appender = VLogAppenderPtr(new VAsyncLogAppender(appender, appenderSettings, appenderDefaults));
+            }
+        }
 
         locker.unlock();
         VLogger::registerLogAppender(appender);
+
+        if (asyncIgnored) {
+            VLOGGER_WARN(VSTRING_FORMAT("VLogger::installNewLogAppender: Ignoring the async setting of binary appender '%s'.", appender->getName().chars()));
+        }
     }
 }
 
 // static
 void VLogger::installNewNamedLogger(const VSettingsNode& loggerSettings) {
+    VNamedLoggerPtr logger = VLogger::_newNamedLogger(loggerSettings);
+
+    VMutexLocker locker(_mutexInstance(), "VLogger::installNewNamedLogger");
+    VLogger::_registerLogger(logger, false);
+}
+
+// static
+VNamedLoggerPtr VLogger::_newNamedLogger(const VSettingsNode& loggerSettings) {
     VString name = loggerSettings.getString("name");
     VString levelText = loggerSettings.getString("level", "INFO");
     int level = VLoggerLevel::fromString(levelText);
@@ -362,8 +593,14 @@ void VLogger::installNewNamedLogger(const VSettingsNode& loggerSettings) {
         logger->setPrintStackInfo(printStackLevel, maxNumOccurrences, timeLimit);
     }
 
-    VMutexLocker locker(_mutexInstance(), "VLogger::installNewNamedLogger");
-    VLogger::_registerLogger(logger, false);
+    VLoggerThrottle& throttle = logger->getThrottle();
+    throttle.setExemptLevel(VLoggerLevel::fromString(loggerSettings.getString("throttle-exempt-level", "ERROR")));
+    throttle.setSummaryInterval(loggerSettings.getDuration("suppressed-summary-interval", VDuration::SECOND() * 10));
+    throttle.setRateLimit(loggerSettings.getInt("rate-limit", 0), loggerSettings.getInt("rate-limit-burst", 0));
+    throttle.setCallSiteRateLimit(loggerSettings.getInt("call-site-rate-limit", 0), loggerSettings.getInt("call-site-rate-limit-burst", 0));
+    throttle.setSampleRate(loggerSettings.getInt("sample-rate", 1));
+
+    return logger;
 }
 
 // static
@@ -396,6 +633,7 @@ void VLogger::configure(const VFSNode& baseLogDirectory, const VSettingsNode& lo
     VLogger::registerLogAppenderFactory("cout", VLogAppenderFactoryPtr(new VCoutLogAppenderFactory()));
     VLogger::registerLogAppenderFactory("file", VLogAppenderFactoryPtr(new VFileLogAppenderFactory()));
     VLogger::registerLogAppenderFactory("rolling-file", VLogAppenderFactoryPtr(new VRollingFileLogAppenderFactory()));
+    VLogger::registerLogAppenderFactory("binary", VLogAppenderFactoryPtr(new VBinaryLogAppenderFactory()));
     VLogger::registerLogAppenderFactory("silent", VLogAppenderFactoryPtr(new VSilentLogAppenderFactory()));
     VLogger::registerLogAppenderFactory("string", VLogAppenderFactoryPtr(new VStringLogAppenderFactory()));
     VLogger::registerLogAppenderFactory("string-vector", VLogAppenderFactoryPtr(new VStringVectorLogAppenderFactory()));
@@ -420,36 +658,65 @@ void VLogger::configure(const VFSNode& baseLogDirectory, const VSettingsNode& lo
         VLogger::installNewLogAppender(*appenderNode, *appenderDefaults);
     }
 
+    // Register all the loggers at once, so that we publish one snapshot rather than one per logger.
+    VNamedLoggerList newLoggers;
     const int numLoggers = loggingSettings.countNamedChildren("logger");
     for (int i = 0; i < numLoggers; ++i) {
         const VSettingsNode* loggerNode = loggingSettings.getNamedChild("logger", i);
-        VLogger::installNewNamedLogger(*loggerNode);
+        newLoggers.push_back(VLogger::_newNamedLogger(*loggerNode));
+    }
+
+    if (! newLoggers.empty()) {
+        VMutexLocker locker(_mutexInstance(), "VLogger::configure");
+        for (VNamedLoggerList::const_iterator i = newLoggers.begin(); i != newLoggers.end(); ++i) {
+            VLogger::_registerLogger(*i, false, false);
+        }
+
+        VLogger::_publishLoggerSnapshot();
     }
 }
 
 // static
 void VLogger::shutdown() {
+    // Report what the loggers have suppressed while their appenders are still registered.
+    _cancelSummaryTimer();
+    _reportSuppressedMessages(false);
+
+    // The appenders and loggers are released only after we unlock, because destroying an appender
+    // may involve logging; for example, VAsyncLogAppender joins its writer thread, which may log as it ends.
+    VNamedLoggerPtr releasedDefaultLogger;
+    VLogAppenderPtr releasedDefaultAppender;
+    VNamedLoggerMap releasedLoggers;
+    VLogAppendersMap releasedAppenders;
+
     VMutexLocker locker(_mutexInstance(), "VLogger::shutdown");
 
     // Clear all shared_ptr references. This will allow all referenced objects to be deleted (unless someone outside retains a reference).
-    gDefaultLogger.reset();
-    gDefaultAppender.reset();
-    _getLoggerMap().clear();
-    _getAppendersMap().clear();
+    releasedDefaultLogger.swap(gDefaultLogger);
+    releasedDefaultAppender.swap(gDefaultAppender);
+    releasedLoggers.swap(_getLoggerMap());
+    releasedAppenders.swap(_getAppendersMap());
     _getAppenderFactoriesMap().clear();
 
     gMaxActiveLevel = 0;
+
+    // Publish an empty snapshot, which lets go of the old snapshot's references to the loggers.
+    VLogger::_publishLoggerSnapshot();
 }
 
 // static
 void VLogger::registerLogAppender(VLogAppenderPtr appender, bool asDefaultAppender) {
+    VLogAppenderPtr replacedAppender; // released after we unlock; see shutdown()
     VMutexLocker locker(_mutexInstance(), "VLogger::registerLogAppender");
+    replacedAppender = VLogger::findAppender(appender->getName());
     VLogger::_registerAppender(appender, asDefaultAppender, false);
 }
 
 // static
 void VLogger::registerGlobalAppender(VLogAppenderPtr appender, bool asDefaultAppender) {
+    VLogAppenderPtr replacedAppender; // released after we unlock; see shutdown()
     VMutexLocker locker(_mutexInstance(), "VLogger::registerLogAppender");
+    replacedAppender = VLogger::findAppender(appender->getName());
     VLogger::_registerAppender(appender, asDefaultAppender, true);
 }
 
@@ -500,7 +767,12 @@ void VLogger::deregisterLogger(VNamedLoggerPtr namedLogger) {
         _getLoggerMap().erase(pos);
     }
 
+    VLogger::_publishLoggerSnapshot();
     VLogger::_checkMaxActiveLogLevelForRemovedLogger(namedLogger->getLevel());
+    locker.unlock(); // logging takes the mutex to find the appenders
+
+    // Report what the logger has suppressed, since no summary timer will see it now.
+    namedLogger->getThrottle().reportSuppressed(*namedLogger);
 }
 
 // static
@@ -524,13 +796,8 @@ bool VLogger::isLogLevelActive(int level) {
 
 // static
 VNamedLoggerPtr VLogger::getDefaultLogger() {
-    VMutexLocker locker(_mutexInstance(), "VLogger::getDefaultLogger");
-
-    if (gDefaultLogger == nullptr) {
-        VLogger::_registerLogger(VNamedLoggerPtr(new VNamedLogger("auto-default-logger", VLoggerLevel::INFO, VStringVector())), true);
-    }
-
-    return gDefaultLogger;
+    VLoggerReadSection readSection;
+    return VLogger::_getLoggerSnapshotWithDefaultLogger("auto-default-logger")->mDefaultLogger;
 }
 
 #ifdef VLOGGER_INTERNAL_DEBUGGING
@@ -548,6 +815,7 @@ void VLogger::setDefaultLogger(VNamedLoggerPtr namedLogger) {
     VMutexLocker locker(_mutexInstance(), "VLogger::getDefaultLogger");
     VLogger::_reportLoggerChange(true, "setDefaultLogger", gDefaultLogger, namedLogger);
     gDefaultLogger = namedLogger;
+    VLogger::_publishLoggerSnapshot();
     VLogger::_reportLoggerChange(false, "setDefaultLogger", gDefaultLogger, namedLogger);
 }
 
@@ -564,25 +832,24 @@ VNamedLoggerPtr VLogger::getLogger(const VString& name) {
 
 // static
 VNamedLoggerPtr VLogger::findDefaultLogger() {
-    VMutexLocker locker(_mutexInstance(), "VLogger::findDefaultLogger");
-    return gDefaultLogger;
+    VLoggerReadSection readSection;
+    const VNamedLoggerSnapshot* snapshot = gLoggerSnapshot.load(std::memory_order_acquire);
+    return (snapshot == NULL) ? NULL_NAMED_LOGGER_PTR : snapshot->mDefaultLogger;
 }
 
 // static
 VNamedLoggerPtr VLogger::findDefaultLoggerForLevel(int level) {
-    VMutexLocker locker(_mutexInstance(), "VLogger::findDefaultLoggerForLevel");
-
-    if (gDefaultLogger == nullptr) {
-        VLogger::_registerLogger(VNamedLoggerPtr(new VNamedLogger("default", VLoggerLevel::INFO, VStringVector())), true);
-    }
-
-    return gDefaultLogger->isEnabledFor(level) ? gDefaultLogger : NULL_NAMED_LOGGER_PTR;
+    VLoggerReadSection readSection;
+    const VNamedLoggerPtr& defaultLogger = VLogger::_getLoggerSnapshotWithDefaultLogger("default")->mDefaultLogger;
+    return defaultLogger->isEnabledFor(level) ? defaultLogger : NULL_NAMED_LOGGER_PTR;
 }
 
 // static
 VNamedLoggerPtr VLogger::findNamedLogger(const VString& name) {
-    VMutexLocker locker(_mutexInstance(), "VLogger::findNamedLogger");
-    return VLogger::_findNamedLoggerFromPathName(name);
+    VLoggerReadSection readSection;
+    const VNamedLoggerSnapshot* snapshot = gLoggerSnapshot.load(std::memory_order_acquire);
+    VNamedLogger* logger = (snapshot == NULL) ? NULL : snapshot->findFromPathName(name);
+    return (logger == NULL) ? NULL_NAMED_LOGGER_PTR : logger->shared_from_this();
 }
 
 // static
@@ -607,6 +874,26 @@ VNamedLoggerPtr VLogger::findNamedLoggerForLevel(const VString& name, int level)
     return logger;
 }
 
+// static
+VNamedLoggerPtr VLogger::findNamedLoggerForLevel(VLoggerCallSiteCache& cache, const char* name, int level) {
+    if (! VLogger::isLogLevelActive(level)) {
+        return NULL_NAMED_LOGGER_PTR;
+    }
+
+    // The cached entry is good if it was resolved from the current snapshot, for the same name.
+    VLoggerReadSection readSection;
+    VNamedLogger* logger;
+    const VNamedLoggerSnapshot* snapshot = gLoggerSnapshot.load(std::memory_order_acquire);
+    const VLoggerCallSiteEntry* entry = cache.mEntry.load(std::memory_order_acquire);
+    if ((entry != NULL) && (snapshot != NULL) && (entry->mGeneration == snapshot->mGeneration) && (entry->mName == name)) {
+        logger = entry->mLogger;
+    } else {
+        logger = VLogger::_resolveCallSite(cache, name);
+    }
+
+    return logger->isEnabledFor(level) ? logger->shared_from_this() : NULL_NAMED_LOGGER_PTR;
+}
+
 #ifdef VLOGGER_INTERNAL_DEBUGGING
 // static
 void VLogger::_reportAppenderChange(bool before, const VString& label, const VLogAppenderPtr& was, const VLogAppenderPtr& is) {
@@ -732,6 +1019,38 @@ VString VLogger::_commandGetInfoString() {
     return s;
 }
 
+// static
+void VLogger::commandRollAppender(const VString& appenderName) {
+
+    VLogAppenderPtrList targetAppenders;
+
+    // First, get all the desired appenders, with required locking in place.
+    /* locker scope */ {
+        VMutexLocker locker(_mutexInstance(), "VLogger::commandRollAppender()");
+        const VLogAppendersMap& appenders = _getAppendersMap();
+        for (VLogAppendersMap::const_iterator i = appenders.begin(); i != appenders.end(); ++i) {
+            VLogAppenderPtr appender = (*i).second;
+            if (appenderName.isEmpty() || (appender->getName() == appenderName)) {
+                targetAppenders.push_back(appender);
+            }
+        }
+    }
+
+    // Now, roll each one that is a rolling file appender, possibly wrapped in an asynchronous one. It locks each time.
+    for (VLogAppenderPtrList::const_iterator i = targetAppenders.begin(); i != targetAppenders.end(); ++i) {
+        VLogAppenderPtr appender = *i;
+        VAsyncLogAppender* asyncAppender = dynamic_cast<VAsyncLogAppender*>(appender.get());
+        if (asyncAppender != NULL) {
+            appender = asyncAppender->getAppender();
+        }
+
+        VRollingFileLogAppender* rollingAppender = dynamic_cast<VRollingFileLogAppender*>(appender.get());
+        if (rollingAppender != NULL) {
+            rollingAppender->roll();
+        }
+    }
+}
+
 // static
 void VLogger::commandSetLogLevel(const VString& loggerName, int level) {
 
@@ -776,6 +1095,15 @@ void VLogger::emitToGlobalAppenders(int level, const char* file, int line, bool
     }
 }
 
+// static
+void VLogger::emitBentoToGlobalAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload) {
+    VMutexLocker locker(_mutexInstance(), "VLogger::emitBentoToGlobalAppenders");
+    for (VLogAppendersMap::const_iterator i = _getGlobalAppendersMap().begin(); i != _getGlobalAppendersMap().end(); ++i) {
+        VLogAppenderPtr appender = (*i).second;
+        appender->emitBento(level, message, specifiedLoggerName, actualLoggerName, payload);
+    }
+}
+
 // static
 VString VLogger::getCleansedLoggerName(const VString& s) {
     VString cleansed(s);
@@ -804,7 +1132,7 @@ void VLogger::_registerAppender(VLogAppenderPtr appender, bool asDefaultAppender
 
 
 // static
-void VLogger::_registerLogger(VNamedLoggerPtr namedLogger, bool asDefaultLogger) {
+void VLogger::_registerLogger(VNamedLoggerPtr namedLogger, bool asDefaultLogger, bool publishSnapshot) {
     // ASSUMES CALLER HOLDS _mutexInstance().
 
     VLogger::_reportLoggerChange(true, "_registerLogger", gDefaultLogger, namedLogger);
@@ -815,6 +1143,10 @@ void VLogger::_registerLogger(VNamedLoggerPtr namedLogger, bool asDefaultLogger)
 
     _getLoggerMap()[namedLogger->getName()] = namedLogger;
 
+    if (publishSnapshot) {
+        VLogger::_publishLoggerSnapshot();
+    }
+
     VLogger::_checkMaxActiveLogLevelForNewLogger(namedLogger->getLevel());
 
     VLogger::_reportLoggerChange(false, "_registerLogger", gDefaultLogger, namedLogger);
@@ -879,29 +1211,140 @@ void VLogger::_recalculateMaxActiveLogLevel() {
 }
 
 // static
-VNamedLoggerPtr VLogger::_findNamedLoggerFromExactName(const VString& name) {
-    VNamedLoggerMap::const_iterator pos = _getLoggerMap().find(name);
-    if (pos == _getLoggerMap().end()) {
-        return NULL_NAMED_LOGGER_PTR;
+void VLogger::_publishLoggerSnapshot() {
+    // ASSUMES CALLER HOLDS _mutexInstance().
+
+    const VNamedLoggerSnapshot* snapshot = new VNamedLoggerSnapshot(++gLoggerSnapshotGeneration, _getLoggerMap(), gDefaultLogger);
+    const VNamedLoggerSnapshot* replacedSnapshot = gLoggerSnapshot.exchange(snapshot);
+    if (replacedSnapshot != NULL) {
+        _getRetiredLoggerSnapshots().push_back(replacedSnapshot);
     }
 
-    return pos->second;
+    VLogger::_reclaimRetiredLoggerObjects();
 }
 
 // static
-VNamedLoggerPtr VLogger::_findNamedLoggerFromPathName(const VString& pathName) {
-    VString nextNameToSearch(pathName);
+void VLogger::_reclaimRetiredLoggerObjects() {
+    // ASSUMES CALLER HOLDS _mutexInstance().
 
-    while (nextNameToSearch.contains('.')) {
-        VNamedLoggerPtr foundLogger = VLogger::_findNamedLoggerFromExactName(nextNameToSearch);
-        if (foundLogger != nullptr) {
-            return foundLogger;
-        }
+    /*
+    Everything in the lists was replaced before we got here, so a thread that can still see one of
+    them entered its read section before now, and is counted. If any thread is reading, we leave the
+    lists for the next time the registry changes; a read section lasts only for one lookup, so this
+    rarely happens twice in a row.
+    */
+    if (gNumLoggerReaders.load() != 0) {
+        return;
+    }
+
+    VNamedLoggerSnapshotList& retiredSnapshots = _getRetiredLoggerSnapshots();
+    for (VNamedLoggerSnapshotList::const_iterator i = retiredSnapshots.begin(); i != retiredSnapshots.end(); ++i) {
+        delete *i;
+    }
+
+    retiredSnapshots.clear();
+
+    VLoggerCallSiteEntryList& retiredEntries = _getRetiredCallSiteEntries();
+    for (VLoggerCallSiteEntryList::const_iterator i = retiredEntries.begin(); i != retiredEntries.end(); ++i) {
+        delete *i;
+    }
 
-        nextNameToSearch.substringInPlace(0, nextNameToSearch.lastIndexOf('.'));
+    retiredEntries.clear();
+}
+
+// static
+const VNamedLoggerSnapshot* VLogger::_getLoggerSnapshotWithDefaultLogger(const VString& defaultLoggerName) {
+    // ASSUMES CALLER IS IN A VLoggerReadSection.
+
+    const VNamedLoggerSnapshot* snapshot = gLoggerSnapshot.load(std::memory_order_acquire);
+    if ((snapshot != NULL) && (snapshot->mDefaultLogger != nullptr)) {
+        return snapshot;
+    }
+
+    VMutexLocker locker(_mutexInstance(), "VLogger::_getLoggerSnapshotWithDefaultLogger");
+
+    if (gDefaultLogger == nullptr) {
+        VLogger::_registerLogger(VNamedLoggerPtr(new VNamedLogger(defaultLoggerName, VLoggerLevel::INFO, VStringVector())), true);
+    }
+
+    return gLoggerSnapshot.load(std::memory_order_acquire);
+}
+
+// static
+VNamedLogger* VLogger::_resolveCallSite(VLoggerCallSiteCache& cache, const char* name) {
+    // ASSUMES CALLER IS IN A VLoggerReadSection.
+
+    VString loggerName(name);
+    const VNamedLoggerSnapshot* snapshot = VLogger::_getLoggerSnapshotWithDefaultLogger("default");
+    VNamedLogger* logger = snapshot->findFromPathName(loggerName);
+    if (logger == NULL) {
+        logger = snapshot->mDefaultLogger.get();
+    }
+
+    /*
+    Only replace an entry that is missing or out of date. A statement that is called with varying
+    names (for example, a per-instance logger name) keeps the first name it resolved in this
+    generation, and the other names are looked up in the snapshot each time. That way the number
+    of entries created is bounded by the number of registry changes.
+    */
+    const VLoggerCallSiteEntry* entry = cache.mEntry.load(std::memory_order_acquire);
+    if ((entry == NULL) || (entry->mGeneration != snapshot->mGeneration)) {
+        const VLoggerCallSiteEntry* newEntry = new VLoggerCallSiteEntry(snapshot->mGeneration, loggerName, logger);
+        if (! cache.mEntry.compare_exchange_strong(entry, newEntry)) {
+            delete newEntry; // another thread updated the cache first; no one else has seen our entry
+        } else if (entry != NULL) {
+            // Another thread may be reading the entry we replaced; it is deleted along with the replaced snapshots.
+            VMutexLocker locker(_mutexInstance(), "VLogger::_resolveCallSite");
+            _getRetiredCallSiteEntries().push_back(entry);
+        }
     }
 
-    return VLogger::_findNamedLoggerFromExactName(nextNameToSearch);
+    return logger;
+}
+
+// VLogRecord ----------------------------------------------------------------
+
+VLogRecord::VLogRecord()
+    : mLevel(VLoggerLevel::OFF)
+    , mFile(NULL)
+    , mLine(0)
+    , mEmitMessage(false)
+    , mMessage()
+    , mSpecifiedLoggerName()
+    , mActualLoggerName()
+    , mEmitRawLine(false)
+    , mRawLine()
+    , mWhen()
+    , mTrueWhen()
+    , mHasTrueTime(false)
+    , mThreadName()
+    {
+}
+
+void VLogRecord::capture(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine, bool captureThreadName) {
+    mLevel = level;
+    mFile = file;
+    mLine = line;
+    mEmitMessage = emitMessage;
+    mMessage = emitMessage ? message : VString::EMPTY();
+    mSpecifiedLoggerName = specifiedLoggerName;
+    mActualLoggerName = actualLoggerName;
+    mEmitRawLine = emitRawLine;
+    mRawLine = emitRawLine ? rawLine : VString::EMPTY();
+
+    mWhen.setNow();
+    mHasTrueTime = (VInstant::getSimulatedClockOffset() != VDuration::ZERO()) || VInstant::isTimeFrozen();
+    if (mHasTrueTime) {
+        mTrueWhen.setTrueNow();
+    }
+
+    mThreadName = VString::EMPTY();
+    if (captureThreadName) {
+        try {
+            mThreadName = VThread::getCurrentThreadName();
+        } catch (...) {
+        }
+    }
 }
 
 // VLogAppender ------------------------------------------------------
@@ -923,7 +1366,16 @@ VLogAppender::VLogAppender(const VString& name, bool formatOutput, const VString
     , mFormatUsesLocation(mFormatSpec.contains("$location"))
     , mFormatUsesSpecifiedLoggerName(mFormatSpec.contains("$specifiedlogger"))
     , mFormatUsesActualLoggerName(mFormatSpec.contains("$actuallogger"))
+    , mFlushDeferred(false)
+    , mFormatSegments()
+    , mTimeStampGranularity(1)
+    , mCachedLocalTimeStampKey(V_MAX_S64)
+    , mCachedLocalTimeStamp()
+    , mCachedUTCTimeStampKey(V_MAX_S64)
+    , mCachedUTCTimeStamp()
+    , mFormatBuffer()
     {
+    this->_compileFormatSpec();
 }
 
 VLogAppender::VLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults)
@@ -939,7 +1391,16 @@ VLogAppender::VLogAppender(const VSettingsNode& settings, const VSettingsNode& d
     , mFormatUsesLocation(mFormatSpec.contains("$location"))
     , mFormatUsesSpecifiedLoggerName(mFormatSpec.contains("$specifiedlogger"))
     , mFormatUsesActualLoggerName(mFormatSpec.contains("$actuallogger"))
+    , mFlushDeferred(false)
+    , mFormatSegments()
+    , mTimeStampGranularity(1)
+    , mCachedLocalTimeStampKey(V_MAX_S64)
+    , mCachedLocalTimeStamp()
+    , mCachedUTCTimeStampKey(V_MAX_S64)
+    , mCachedUTCTimeStamp()
+    , mFormatBuffer()
     {
+    this->_compileFormatSpec();
 }
 
 VLogAppender::~VLogAppender() {
@@ -978,6 +1439,12 @@ void VLogAppender::emitRaw(const VString& message) {
     this->emit(VLoggerLevel::TRACE, NULL, 0, false, VString::EMPTY(), VString::EMPTY(), VString::EMPTY(), true, message);
 }
 
+void VLogAppender::emitBento(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload) {
+    VString payloadText;
+    payload.writeToBentoTextString(payloadText);
+    this->emit(level, NULL, 0, true, message + " " + payloadText, specifiedLoggerName, actualLoggerName, false, VString::EMPTY());
+}
+
 bool VLogAppender::isDefaultAppender() const {
     return VLogger::gDefaultAppender.get() == this;
 }
@@ -1016,59 +1483,179 @@ VString VLogAppender::_formatMessage(int level, const char* file, int line, cons
         trueNow.setTrueNow();
     }
 
-    VString formattedMessage = mFormatSpec;
-    
-    // I am do replacement in this order (mainly with $message last) to be sure that
-    // none of the replacements put a $ specifier into the string.
-    if (mFormatUsesLocalTime) {
-        VString localTimeStampString;
-        if (prependTrueTime) {
-            localTimeStampString = trueNow.getLocalString(mTimeFormatter) + " ";
+    VString threadName;
+    if (mFormatUsesThread) {
+        try {
+            threadName = VThread::getCurrentThreadName();
+        } catch (...) {
         }
+    }
+
+    return this->_applyFormatSpec(now, trueNow, prependTrueTime, threadName, level, file, line, message, specifiedLoggerName, actualLoggerName);
+}
 
-        localTimeStampString += now.getLocalString(mTimeFormatter);
-        formattedMessage.replace("$localtime", localTimeStampString);
+void VLogAppender::_emitRecord(const VLogRecord& record) {
+    if (record.mEmitMessage) {
+        if (mFormatOutput) {
+            this->_emitRawLine(this->_applyFormatSpec(record.mWhen, record.mTrueWhen, record.mHasTrueTime, record.mThreadName, record.mLevel, record.mFile, record.mLine, record.mMessage, record.mSpecifiedLoggerName, record.mActualLoggerName));
+        } else {
+            this->_emitRawLine(record.mMessage);
+        }
     }
 
-    if (mFormatUsesUTCTime) {
-        VString utcTimeStampString;
-        if (prependTrueTime) {
-            utcTimeStampString = trueNow.getUTCString(mTimeFormatter) + " ";
+    if (record.mEmitRawLine) {
+        this->_emitRawLine(record.mRawLine);
+    }
+}
+
+void VLogAppender::_compileFormatSpec() {
+    // The $ variables that may appear in a format spec. Note that "$localtime" and "$location" share a prefix,
+    // so each candidate is matched in full.
+    static const struct {
+        const char* mName;
+        int         mNameLength;
+        FormatField mField;
+    } kFormatVariables[] = {
+        { "$localtime",         10, kFormatLocalTime },
+        { "$utctime",           8,  kFormatUTCTime },
+        { "$level",             6,  kFormatLevel },
+        { "$location",          9,  kFormatLocation },
+        { "$thread",            7,  kFormatThread },
+        { "$specifiedlogger",   16, kFormatSpecifiedLogger },
+        { "$actuallogger",      13, kFormatActualLogger },
+        { "$message",           8,  kFormatMessage }
+    };
+    static const int kNumFormatVariables = static_cast<int>(sizeof(kFormatVariables) / sizeof(kFormatVariables[0]));
+
+    mFormatSegments.clear();
+
+    const int specLength = mFormatSpec.length();
+    const char* spec = mFormatSpec.chars();
+    int literalStart = 0;
+    int i = 0;
+    while (i < specLength) {
+        int matchedVariable = -1;
+        if (spec[i] == '$') {
+            for (int v = 0; v < kNumFormatVariables; ++v) {
+                if (::strncmp(spec + i, kFormatVariables[v].mName, static_cast<VSizeType>(kFormatVariables[v].mNameLength)) == 0) {
+                    matchedVariable = v;
+                    break;
+                }
+            }
+        }
+
+        if (matchedVariable == -1) {
+            ++i;
+            continue;
+        }
+
+        if (i > literalStart) {
+            VString literal;
+            mFormatSpec.getSubstring(literal, literalStart, i);
+            mFormatSegments.push_back(FormatSegment(kFormatLiteral, literal));
         }
-        utcTimeStampString += now.getUTCString(mTimeFormatter);
-        formattedMessage.replace("$utctime", utcTimeStampString);
+
+        mFormatSegments.push_back(FormatSegment(kFormatVariables[matchedVariable].mField, VString::EMPTY()));
+        i += kFormatVariables[matchedVariable].mNameLength;
+        literalStart = i;
     }
 
-    if (mFormatUsesLevel) {
-        formattedMessage.replace("$level", VLoggerLevel::getName(level));
+    if (specLength > literalStart) {
+        VString literal;
+        mFormatSpec.getSubstring(literal, literalStart, specLength);
+        mFormatSegments.push_back(FormatSegment(kFormatLiteral, literal));
+    }
+
+    // A time stamp can be reused for a whole second unless it shows milliseconds ('S' outside of quoted text).
+    mTimeStampGranularity = 1000;
+    const VString& timeFormat = mTimeFormatter.getFormatSpecifier();
+    bool inQuotes = false;
+    for (int j = 0; j < timeFormat.length(); ++j) {
+        char c = timeFormat.charAt(j);
+        if (c == '\'') {
+            inQuotes = !inQuotes;
+        } else if ((c == 'S') && !inQuotes) {
+            mTimeStampGranularity = 1;
+            break;
+        }
     }
+}
 
-    if (mFormatUsesLocation) {
-        if (file == NULL) {
-            formattedMessage.replace("$location", VString::EMPTY());
+const VString& VLogAppender::_applyFormatSpec(const VInstant& now, const VInstant& trueNow, bool prependTrueTime, const VString& threadName, int level, const char* file, int line, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName) const {
+    // Gather the text of each variable, formatting only those that the spec uses.
+    const VString* fieldText[kNumFormatFields];
+    fieldText[kFormatLiteral] = NULL;
+    fieldText[kFormatLocalTime] = &VString::EMPTY();
+    fieldText[kFormatUTCTime] = &VString::EMPTY();
+
+    VString localTimeStamp;
+    if (mFormatUsesLocalTime) {
+        if (prependTrueTime) {
+            localTimeStamp = trueNow.getLocalString(mTimeFormatter) + " " + now.getLocalString(mTimeFormatter);
+            fieldText[kFormatLocalTime] = &localTimeStamp;
         } else {
-            formattedMessage.replace("$location", VSTRING_FORMAT("@ %s:%d: ", file, line));
+            fieldText[kFormatLocalTime] = &this->_getTimeStampString(now, false);
         }
     }
 
-    if (mFormatUsesThread) {
-        try {
-            formattedMessage.replace("$thread", VThread::getCurrentThreadName());
-        } catch (...) {
+    VString utcTimeStamp;
+    if (mFormatUsesUTCTime) {
+        if (prependTrueTime) {
+            utcTimeStamp = trueNow.getUTCString(mTimeFormatter) + " " + now.getUTCString(mTimeFormatter);
+            fieldText[kFormatUTCTime] = &utcTimeStamp;
+        } else {
+            fieldText[kFormatUTCTime] = &this->_getTimeStampString(now, true);
         }
     }
 
-    if (mFormatUsesSpecifiedLoggerName) {
-        formattedMessage.replace("$specifiedlogger", specifiedLoggerName);
+    VString levelName;
+    if (mFormatUsesLevel) {
+        levelName = VLoggerLevel::getName(level);
+    }
+
+    VString location;
+    if (mFormatUsesLocation && (file != NULL)) {
+        location.format("@ %s:%d: ", file, line);
+    }
+
+    fieldText[kFormatLevel] = &levelName;
+    fieldText[kFormatLocation] = &location;
+    fieldText[kFormatThread] = &threadName;
+    fieldText[kFormatSpecifiedLogger] = &specifiedLoggerName;
+    fieldText[kFormatActualLogger] = &actualLoggerName;
+    fieldText[kFormatMessage] = &message;
+
+    // Size the buffer once, then copy each segment into place.
+    int formattedLength = 0;
+    for (FormatSegmentList::const_iterator i = mFormatSegments.begin(); i != mFormatSegments.end(); ++i) {
+        formattedLength += ((*i).mField == kFormatLiteral) ? (*i).mLiteral.length() : fieldText[(*i).mField]->length();
     }
 
-    if (mFormatUsesActualLoggerName) {
-        formattedMessage.replace("$actuallogger", actualLoggerName);
+    mFormatBuffer.preflight(formattedLength);
+    char* p = mFormatBuffer.buffer();
+    for (FormatSegmentList::const_iterator i = mFormatSegments.begin(); i != mFormatSegments.end(); ++i) {
+        const VString& text = ((*i).mField == kFormatLiteral) ? (*i).mLiteral : *fieldText[(*i).mField];
+        ::memcpy(p, text.chars(), static_cast<VSizeType>(text.length()));
+        p += text.length();
     }
 
-    formattedMessage.replace("$message", message);
+    mFormatBuffer.postflight(formattedLength);
+    return mFormatBuffer;
+}
+
+const VString& VLogAppender::_getTimeStampString(const VInstant& when, bool utc) const {
+    // Floor division, so that times before 1970 don't share a key with the following second.
+    Vs64 value = when.getValue();
+    Vs64 key = (value >= 0) ? (value / mTimeStampGranularity) : (((value + 1) / mTimeStampGranularity) - 1);
+
+    Vs64& cachedKey = utc ? mCachedUTCTimeStampKey : mCachedLocalTimeStampKey;
+    VString& cachedTimeStamp = utc ? mCachedUTCTimeStamp : mCachedLocalTimeStamp;
+    if (key != cachedKey) {
+        cachedTimeStamp = utc ? when.getUTCString(mTimeFormatter) : when.getLocalString(mTimeFormatter);
+        cachedKey = key;
+    }
 
-    return formattedMessage;
+    return cachedTimeStamp;
 }
 
 VString VLogAppender::_toString() const {
@@ -1101,16 +1688,26 @@ void VCoutLogAppender::addInfo(VBentoNode& infoNode) const {
 }
 
 void VCoutLogAppender::_emitRawLine(const VString& line) {
-    std::cout << line.chars() << std::endl;
+    std::cout << line.chars() << '\n';
+
+    if (! mFlushDeferred) {
+        this->_flush();
+    }
+}
+
+void VCoutLogAppender::_flush() {
+    std::cout.flush();
     (void) ::fflush(stdout);
 }
 
 // VFileLogAppender ----------------------------------------------------------
 
-VFileLogAppender::VFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& filePath)
+VFileLogAppender::VFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& filePath, bool asyncWrites)
     : VLogAppender(name, formatOutput, formatSpec, timeFormat)
     , mFileStream(VFSNode(filePath))
     , mOutputStream(mFileStream)
+    , mAsyncFile(asyncWrites ? new VAsyncFileStream(VFSNode(filePath)) : NULL)
+    , mPendingLines()
     {
     this->_openFile();
 }
@@ -1119,6 +1716,8 @@ VFileLogAppender::VFileLogAppender(const VSettingsNode& settings, const VSetting
     : VLogAppender(settings, defaults)
     , mFileStream()
     , mOutputStream(mFileStream)
+    , mAsyncFile(NULL)
+    , mPendingLines()
     {
     // If no path is specified, we'll use "<appendername>.log" in the base log directory, simply
     // using the appender's "name" property as our base file name.
@@ -1126,14 +1725,35 @@ VFileLogAppender::VFileLogAppender(const VSettingsNode& settings, const VSetting
     VLogger::getBaseLogDirectory().getChildPath(settings.getString("name") + ".log", defaultPath);
     mFileStream.setNode(VFSNode(_getStringInitSetting("path", settings, defaults, defaultPath)));
 
+    if (_getBooleanInitSetting("async-io", settings, defaults, false)) {
+        mAsyncFile = new VAsyncFileStream(mFileStream.getNode());
+    }
+
     this->_openFile();
 }
 
+VFileLogAppender::~VFileLogAppender() {
+    if (mAsyncFile != NULL) {
+        try {
+            this->_flush();
+        } catch (...) {} // destructors must not throw
+
+        delete mAsyncFile; // waits for the writes to complete
+    }
+}
+
 void VFileLogAppender::_openFile() {
     VFSNode newLogFileDir;
     mFileStream.getNode().getParentNode(newLogFileDir);
     newLogFileDir.mkdirs();
 
+    if (mAsyncFile != NULL) {
+        mAsyncFile->openReadWrite(); // appends after the existing contents
+        mPendingLines = VString::NATIVE_LINE_ENDING();
+        this->_flush();
+        return;
+    }
+
     mFileStream.openReadWrite();
     mFileStream.seek(CONST_S64(0), SEEK_END);
 
@@ -1144,38 +1764,561 @@ void VFileLogAppender::addInfo(VBentoNode& infoNode) const {
     VLogAppender::addInfo(infoNode);
     infoNode.addString("type", "VFileLogAppender");
     infoNode.addString("file", mFileStream.getNode().getPath());
-}
+    infoNode.addBool("async-io", mAsyncFile != NULL);
+
+    if (mAsyncFile != NULL) {
+        infoNode.addString("async-io-engine", mAsyncFile->getEngineName());
+        infoNode.addS64("async-io-failures", mAsyncFile->getNumFailed());
+        infoNode.addStringIfNotEmpty("async-io-last-error", mAsyncFile->getLastErrorMessage());
+    }
+}
 
 void VFileLogAppender::_emitRawLine(const VString& line) {
-    mOutputStream.writeLine(line);
-    mOutputStream.flush();
+    if (mAsyncFile != NULL) {
+        mPendingLines += line;
+        mPendingLines += VString::NATIVE_LINE_ENDING();
+    } else {
+        mOutputStream.writeLine(line);
+    }
+
+    if (! mFlushDeferred) {
+        this->_flush();
+    }
+}
+
+void VFileLogAppender::_flush() {
+    if (mAsyncFile == NULL) {
+        mOutputStream.flush();
+    } else if (mPendingLines.isNotEmpty()) {
+        // The copy lets us reuse mPendingLines at once; append() keeps the writes in order.
+        (void) mAsyncFile->appendCopy(reinterpret_cast<const Vu8*>(mPendingLines.chars()), mPendingLines.length());
+        mPendingLines.truncateLength(0);
+    }
+}
+
+// VRollingFileHousekeeperThread ---------------------------------------------
+
+/**
+The background thread that does the slow work for a VRollingFileLogAppender: it periodically writes
+the appender's buffer if lines have been waiting in it, and after each roll over it compresses the
+rolled file and deletes old files beyond the retention limits. It lowers its own priority so that
+compression does not compete with the threads doing real work.
+*/
+class VRollingFileHousekeeperThread : public VThread {
+    public:
+
+        VRollingFileHousekeeperThread(VRollingFileLogAppender& appender, int maxNumFiles, const VDuration& maxAge, bool compress);
+        virtual ~VRollingFileHousekeeperThread() {}
+
+        virtual void run();
+
+        /**
+        Queues a rolled file for compression and cleanup, and records the new current file, which
+        cleanup must not touch. Pass an empty rolled file path to just record the current file.
+        */
+        void postRolledFile(const VString& rolledFilePath, const VString& currentFilePath);
+        void setRetention(int maxNumFiles, const VDuration& maxAge, bool compress);
+        void addInfo(VBentoNode& infoNode) const;
+        /**
+        Waits until every file posted so far, and the startup scan, have been processed.
+        */
+        void drain();
+        /**
+        Tells the thread to return once it has processed everything posted, and waits for it.
+        */
+        void stopAndJoin();
+
+    private:
+
+        static const int kNiceLevel = 10; ///< The nice level the thread runs at.
+
+        /**
+        Compresses the specified rolled files (or, for the startup scan, all uncompressed files
+        with our prefix other than the current one), and then applies the retention limits.
+        */
+        void _housekeep(const VStringVector& rolledFileNames, bool scanForLeftovers, const VString& currentFileName, int maxNumFiles, const VDuration& maxAge, bool compress);
+        bool _isRolledFileName(const VString& fileName, const VString& currentFileName) const; ///< Returns true if the file is one of ours and is not the current file.
+        static void _compressFile(const VFSNode& file); ///< Replaces the file with a ".gz" compressed copy; does nothing unless built with VAULT_ZLIB_SUPPORT.
+
+        VRollingFileLogAppender&    mAppender;
+        const VFSNode               mDirectory;
+        const VString               mFileNamePrefix;
+        mutable VMutex              mMutex;
+        VSemaphore                  mWorkSemaphore;
+        VSemaphore                  mDrainSemaphore;
+        VStringVector               mPendingFileNames;
+        VString                     mCurrentFileName;
+        int                         mMaxNumFiles;
+        VDuration                   mMaxAge;
+        bool                        mCompress;
+        bool                        mScanPending;
+        bool                        mStopRequested;
+        Vs64                        mNumPosted;
+        Vs64                        mNumProcessed;
+};
+
+VRollingFileHousekeeperThread::VRollingFileHousekeeperThread(VRollingFileLogAppender& appender, int maxNumFiles, const VDuration& maxAge, bool compress)
+    : VThread(VSTRING_FORMAT("VRollingFileLogAppender(%s)", appender.getName().chars()), "vault.toolbox.VRollingFileLogAppender", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL)
+    , mAppender(appender)
+    , mDirectory(appender.getDirectory())
+    , mFileNamePrefix(appender.getFileNamePrefix())
+    , mMutex(VSTRING_FORMAT("VRollingFileHousekeeperThread(%s)", appender.getName().chars()), true/*this mutex itself must not log*/)
+    , mWorkSemaphore()
+    , mDrainSemaphore()
+    , mPendingFileNames()
+    , mCurrentFileName()
+    , mMaxNumFiles(maxNumFiles)
+    , mMaxAge(maxAge)
+    , mCompress(compress)
+    , mScanPending(true) // we pick up files left by a previous run when we start
+    , mStopRequested(false)
+    , mNumPosted(1) // the startup scan
+    , mNumProcessed(0)
+    {
+}
+
+void VRollingFileHousekeeperThread::run() {
+    (void) VThread::setPriority(kNiceLevel);
+
+    for (;;) {
+        VStringVector rolledFileNames;
+        VString currentFileName;
+        int maxNumFiles;
+        VDuration maxAge;
+        bool compress;
+        bool scanForLeftovers;
+        bool stopRequested;
+
+        /* locker scope */ {
+            VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::run");
+            if (mPendingFileNames.empty() && ! mScanPending && ! mStopRequested) {
+                // A zero flush interval waits without a timeout, which is right because then the appender writes every line itself.
+                mWorkSemaphore.wait(&mMutex, mAppender.mFlushInterval);
+            }
+
+            rolledFileNames.swap(mPendingFileNames);
+            currentFileName = mCurrentFileName;
+            maxNumFiles = mMaxNumFiles;
+            maxAge = mMaxAge;
+            compress = mCompress;
+            scanForLeftovers = mScanPending;
+            mScanPending = false;
+            stopRequested = mStopRequested;
+        }
+
+        mAppender._flushIfStale();
+
+        if (! rolledFileNames.empty() || scanForLeftovers) {
+            this->_housekeep(rolledFileNames, scanForLeftovers, currentFileName, maxNumFiles, maxAge, compress);
+
+            VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::run");
+            mNumProcessed += static_cast<Vs64>(rolledFileNames.size()) + (scanForLeftovers ? 1 : 0);
+            mDrainSemaphore.signal();
+        }
+
+        if (stopRequested) {
+            break;
+        }
+    }
+}
+
+void VRollingFileHousekeeperThread::postRolledFile(const VString& rolledFilePath, const VString& currentFilePath) {
+    VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::postRolledFile");
+
+    VFSNode(currentFilePath).getName(mCurrentFileName);
+
+    if (rolledFilePath.isNotEmpty()) {
+        mPendingFileNames.push_back(VFSNode(rolledFilePath).getName());
+        ++mNumPosted;
+        mWorkSemaphore.signal();
+    }
+}
+
+void VRollingFileHousekeeperThread::setRetention(int maxNumFiles, const VDuration& maxAge, bool compress) {
+    VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::setRetention");
+    mMaxNumFiles = maxNumFiles;
+    mMaxAge = maxAge;
+    mCompress = compress;
+}
+
+void VRollingFileHousekeeperThread::addInfo(VBentoNode& infoNode) const {
+    VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::addInfo");
+    infoNode.addInt("max-files", mMaxNumFiles);
+    infoNode.addDuration("max-age", mMaxAge);
+#ifdef VAULT_ZLIB_SUPPORT
+    infoNode.addBool("compress", mCompress);
+#else
+    infoNode.addBool("compress", false);
+#endif
+    infoNode.addS64("files-pending", mNumPosted - mNumProcessed);
+}
+
+void VRollingFileHousekeeperThread::drain() {
+    VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::drain");
+    while (mNumProcessed < mNumPosted) {
+        // Time out now and then in case another caller of drain() took the signal.
+        mDrainSemaphore.wait(&mMutex, 100 * VDuration::MILLISECOND());
+    }
+}
+
+void VRollingFileHousekeeperThread::stopAndJoin() {
+    {
+        VMutexLocker locker(&mMutex, "VRollingFileHousekeeperThread::stopAndJoin");
+        mStopRequested = true;
+        mWorkSemaphore.signal();
+    }
+
+    (void) this->join();
+}
+
+void VRollingFileHousekeeperThread::_housekeep(const VStringVector& rolledFileNames, bool scanForLeftovers, const VString& currentFileName, int maxNumFiles, const VDuration& maxAge, bool compress) {
+    try {
+        VStringVector fileNames;
+        mDirectory.list(fileNames);
+
+        if (compress) {
+            VStringVector fileNamesToCompress;
+            if (scanForLeftovers) {
+                for (VStringVector::const_iterator i = fileNames.begin(); i != fileNames.end(); ++i) {
+                    if ((*i).endsWith(".log") && this->_isRolledFileName(*i, currentFileName)) {
+                        fileNamesToCompress.push_back(*i);
+                    }
+                }
+            } else {
+                fileNamesToCompress = rolledFileNames;
+            }
+
+            for (VStringVector::const_iterator i = fileNamesToCompress.begin(); i != fileNamesToCompress.end(); ++i) {
+                VRollingFileHousekeeperThread::_compressFile(VFSNode(mDirectory, *i));
+            }
+
+            if (! fileNamesToCompress.empty()) {
+                fileNames.clear();
+                mDirectory.list(fileNames);
+            }
+        }
+
+        // The names start with the time each file was started, so sorting them puts the oldest first.
+        VStringVector rolledFiles;
+        for (VStringVector::const_iterator i = fileNames.begin(); i != fileNames.end(); ++i) {
+            if (this->_isRolledFileName(*i, currentFileName)) {
+                rolledFiles.push_back(*i);
+            }
+        }
+
+        std::sort(rolledFiles.begin(), rolledFiles.end());
+
+        const VInstant expirationTime = (maxAge == VDuration::ZERO()) ? VInstant::INFINITE_PAST() : (VInstant() - maxAge);
+        const int numExcessFiles = (maxNumFiles > 0) ? static_cast<int>(rolledFiles.size()) - maxNumFiles : 0;
+        for (int i = 0; i < static_cast<int>(rolledFiles.size()); ++i) {
+            VFSNode file(mDirectory, rolledFiles[i]);
+            if ((i < numExcessFiles) || (file.modificationDate() < expirationTime)) {
+                (void) file.rm();
+            }
+        }
+
+    } catch (const VException& ex) {
+        VLOGGER_ERROR(VSTRING_FORMAT("VRollingFileHousekeeperThread(%s): Error cleaning up log files in '%s': %s", mAppender.getName().chars(), mDirectory.getPath().chars(), ex.what()));
+    }
+}
+
+// Returns true if the specified number of characters starting at the index are all decimal digits.
+static bool _isDigitRun(const VString& s, int startIndex, int numDigits) {
+    if (startIndex + numDigits > s.length()) {
+        return false;
+    }
+
+    for (int i = startIndex; i < startIndex + numDigits; ++i) {
+        if ((s.charAt(i) < '0') || (s.charAt(i) > '9')) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool VRollingFileHousekeeperThread::_isRolledFileName(const VString& fileName, const VString& currentFileName) const {
+    /*
+    Only accept exactly the names that VRollingFileLogAppender::_openNewFile() produces:
+        <prefix>-yyyyMMdd-HHmmss-SSS[_NNNN].log[.gz]
+    Checking each field matters because another appender may write to the same directory with a
+    prefix that starts with ours (e.g. "app" and "app-debug"), and we must not touch its files.
+    */
+    if ((fileName == currentFileName) || ! fileName.startsWith(mFileNamePrefix + "-")) {
+        return false;
+    }
+
+    int index = mFileNamePrefix.length() + 1;
+    if (! _isDigitRun(fileName, index, 8) || (fileName.charAt(index + 8) != '-') ||
+        ! _isDigitRun(fileName, index + 9, 6) || (fileName.charAt(index + 15) != '-') ||
+        ! _isDigitRun(fileName, index + 16, 3)) {
+        return false;
+    }
+
+    index += 19;
+    if ((index < fileName.length()) && (fileName.charAt(index) == '_')) {
+        // The suffix is formatted with "%04d", so it has at least 4 digits.
+        int numSuffixDigits = 0;
+        while (_isDigitRun(fileName, index + 1 + numSuffixDigits, 1)) {
+            ++numSuffixDigits;
+        }
+
+        if (numSuffixDigits < 4) {
+            return false;
+        }
+
+        index += 1 + numSuffixDigits;
+    }
+
+    VString extension;
+    fileName.getSubstring(extension, index);
+    return (extension == ".log") || (extension == ".log.gz");
+}
+
+// static
+void VRollingFileHousekeeperThread::_compressFile(const VFSNode& file) {
+#ifdef VAULT_ZLIB_SUPPORT
+    VFSNode compressedFile(file.getPath() + ".gz");
+    gzFile compressedOutput = ::gzopen(compressedFile.getPath().chars(), "wb");
+    if (compressedOutput == NULL) {
+        throw VStackTraceException(VSTRING_FORMAT("Unable to create compressed file '%s'.", compressedFile.getPath().chars()));
+    }
+
+    bool success = true;
+    try {
+        VBufferedFileStream input(file);
+        input.openReadOnly();
+
+        const int kChunkSize = 65536;
+        Vu8 chunk[kChunkSize];
+        for (;;) {
+            Vs64 numBytesRead = input.read(chunk, kChunkSize);
+            if (numBytesRead == 0) {
+                break;
+            }
+
+            if (::gzwrite(compressedOutput, chunk, static_cast<unsigned int>(numBytesRead)) != static_cast<int>(numBytesRead)) {
+                success = false;
+                break;
+            }
+        }
+    } catch (...) {
+        (void) ::gzclose(compressedOutput);
+        (void) compressedFile.rm();
+        throw;
+    }
+
+    if ((::gzclose(compressedOutput) != Z_OK) || ! success) {
+        (void) compressedFile.rm();
+        throw VStackTraceException(VSTRING_FORMAT("Unable to write compressed file '%s'.", compressedFile.getPath().chars()));
+    }
+
+    (void) file.rm();
+#else
+    (void) file; // Without zlib, rolled files are left as is.
+#endif
 }
 
 // VRollingFileLogAppender ---------------------------------------------------
 
-VRollingFileLogAppender::VRollingFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& /*dirPath*/, const VString& /*fileNamePrefix*/, int /*maxNumLines*/)
+VRollingFileLogAppender::VRollingFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& dirPath, const VString& fileNamePrefix, int maxNumLines)
     : VLogAppender(name, formatOutput, formatSpec, timeFormat)
+    , mDirectory(dirPath.isEmpty() ? VLogger::getBaseLogDirectory() : VFSNode(dirPath))
+    , mFileNamePrefix(fileNamePrefix.isEmpty() ? name : fileNamePrefix)
+    , mMaxNumLines(maxNumLines)
+    , mMaxNumBytes(0)
+    , mRollInterval(VDuration::ZERO())
+    , mBufferSize(kDefaultBufferSize)
+    , mFlushInterval(kDefaultFlushMilliseconds * VDuration::MILLISECOND())
+    , mFileStream()
+    , mBufferedStream(mFileStream, mBufferSize)
+    , mOutputStream(mBufferedStream)
+    , mNumLines(0)
+    , mNumBytesWritten(0)
+    , mNextRollTime(VInstant::INFINITE_FUTURE())
+    , mLastWriteTime()
+    , mNumRolls(0)
+    , mHousekeeper(NULL)
     {
+    this->_init(0, VDuration::ZERO(), true);
 }
 
 VRollingFileLogAppender::VRollingFileLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults)
     : VLogAppender(settings, defaults)
+    , mDirectory(VLogAppender::_getStringInitSetting("dir", settings, defaults, VLogger::getBaseLogDirectory().getPath()))
+    , mFileNamePrefix(VLogAppender::_getStringInitSetting("prefix", settings, defaults, settings.getString("name")))
+    , mMaxNumLines(VLogAppender::_getIntInitSetting("max-lines", settings, defaults, kDefaultMaxNumLines))
+    , mMaxNumBytes(CONST_S64(1024) * VLogAppender::_getIntInitSetting("max-kbytes", settings, defaults, 0))
+    , mRollInterval(VLogAppender::_getIntInitSetting("roll-minutes", settings, defaults, 0) * VDuration::MINUTE())
+    , mBufferSize(CONST_S64(1024) * VLogAppender::_getIntInitSetting("buffer-kbytes", settings, defaults, kDefaultBufferSize / 1024))
+    , mFlushInterval(V_MAX(0, VLogAppender::_getIntInitSetting("flush-ms", settings, defaults, kDefaultFlushMilliseconds)) * VDuration::MILLISECOND())
+    , mFileStream()
+    , mBufferedStream(mFileStream, mBufferSize)
+    , mOutputStream(mBufferedStream)
+    , mNumLines(0)
+    , mNumBytesWritten(0)
+    , mNextRollTime(VInstant::INFINITE_FUTURE())
+    , mLastWriteTime()
+    , mNumRolls(0)
+    , mHousekeeper(NULL)
     {
-    /* todo: use these settings properties to construct, something like:
-        mDirPath = VLogAppender::_getStringInitSetting("dir", settings, defaults, VLogger::getBaseLogDirectory().getPath());
-        mPrefix = VLogAppender::_getStringInitSetting("prefix", settings, defaults, settings.getString("name"));
-        mMaxLines = VLogAppender::_getIntInitSetting("max-lines", settings, defaults, 10000);
-    */
+    this->_init(VLogAppender::_getIntInitSetting("max-files", settings, defaults, 0),
+                VLogAppender::_getIntInitSetting("max-age-hours", settings, defaults, 0) * VDuration::HOUR(),
+                VLogAppender::_getBooleanInitSetting("compress", settings, defaults, true));
+}
+
+VRollingFileLogAppender::~VRollingFileLogAppender() {
+    try {
+        mHousekeeper->stopAndJoin();
+    } catch (...) {} // block exceptions from propagating
+
+    delete mHousekeeper;
+
+    try {
+        this->_writeBuffer();
+        mFileStream.close();
+    } catch (...) {} // block exceptions from propagating
+}
+
+void VRollingFileLogAppender::_init(int maxNumFiles, const VDuration& maxAge, bool compress) {
+    mDirectory.mkdirs();
+
+    VInstant now;
+    this->_openNewFile(now);
+
+    mHousekeeper = new VRollingFileHousekeeperThread(*this, maxNumFiles, maxAge, compress);
+    mHousekeeper->postRolledFile(VString::EMPTY(), mFileStream.getNode().getPath());
+    mHousekeeper->start();
 }
 
 void VRollingFileLogAppender::addInfo(VBentoNode& infoNode) const {
     VLogAppender::addInfo(infoNode);
     infoNode.addString("type", "VRollingFileLogAppender");
-    // TODO: current file etc.
+    infoNode.addString("file", mFileStream.getNode().getPath());
+    infoNode.addInt("max-lines", mMaxNumLines);
+    infoNode.addS64("max-bytes", mMaxNumBytes);
+    infoNode.addDuration("roll-interval", mRollInterval);
+    infoNode.addS64("buffer-size", mBufferSize);
+    infoNode.addDuration("flush-interval", mFlushInterval);
+    infoNode.addInt("rolls", mNumRolls);
+    mHousekeeper->addInfo(infoNode);
+}
+
+void VRollingFileLogAppender::setRollLimits(int maxNumLines, Vs64 maxNumBytes, const VDuration& rollInterval) {
+    VMutexLocker locker(&mMutex, "VRollingFileLogAppender::setRollLimits");
+    mMaxNumLines = maxNumLines;
+    mMaxNumBytes = maxNumBytes;
+    mRollInterval = rollInterval;
+    this->_computeNextRollTime(VInstant());
+}
+
+void VRollingFileLogAppender::setRetention(int maxNumFiles, const VDuration& maxAge, bool compress) {
+    mHousekeeper->setRetention(maxNumFiles, maxAge, compress);
 }
 
-void VRollingFileLogAppender::_emitRawLine(const VString& /*line*/) {
-    // TODO!
+void VRollingFileLogAppender::roll() {
+    VMutexLocker locker(&mMutex, "VRollingFileLogAppender::roll");
+    this->_roll(VInstant());
+}
+
+void VRollingFileLogAppender::drainHousekeeping() {
+    mHousekeeper->drain();
+}
+
+VString VRollingFileLogAppender::getCurrentFilePath() {
+    VMutexLocker locker(&mMutex, "VRollingFileLogAppender::getCurrentFilePath");
+    return mFileStream.getNode().getPath();
+}
+
+void VRollingFileLogAppender::_emitMessage(int level, const char* file, int line, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName) {
+    VLogAppender::_emitMessage(level, file, line, message, specifiedLoggerName, actualLoggerName);
+
+    // Don't leave a serious error sitting in the buffer, in case the process is about to die.
+    if ((level <= VLoggerLevel::ERROR) && ! mFlushDeferred) {
+        this->_writeBuffer();
+    }
+}
+
+void VRollingFileLogAppender::_emitRawLine(const VString& line) {
+    const Vs64 numBufferedBytes = mBufferedStream.getEOFOffset();
+
+    // Roll before writing, so that each line goes entirely into one file.
+    if (((mMaxNumLines > 0) && (mNumLines >= mMaxNumLines)) ||
+        ((mMaxNumBytes > 0) && (mNumBytesWritten + numBufferedBytes >= mMaxNumBytes)) ||
+        ((mRollInterval != VDuration::ZERO()) && (VInstant() >= mNextRollTime))) {
+        this->_roll(VInstant());
+    } else if (numBufferedBytes + line.length() + 2 > mBufferSize) { // 2 allows for a CRLF line ending
+        this->_writeBuffer();
+    }
+
+    mOutputStream.writeLine(line);
+    ++mNumLines;
+
+    // A zero flush interval means every line is written out right away.
+    if ((mFlushInterval == VDuration::ZERO()) && ! mFlushDeferred) {
+        this->_writeBuffer();
+    }
+}
+
+void VRollingFileLogAppender::_flush() {
+    this->_writeBuffer();
+}
+
+void VRollingFileLogAppender::_openNewFile(const VInstant& now) {
+    // A file name only has millisecond resolution, so add a suffix if files are rolled faster than that.
+    // The suffix is chosen so that the names still sort in the order the files were started. The time is
+    // UTC because retention sorts by name, and local time goes backward when daylight saving time ends.
+    const VString baseName = mFileNamePrefix + "-" + VInstantFormatter("yyyyMMdd-HHmmss-SSS").formatUTCString(now);
+    VString fileName = baseName + ".log";
+    for (int suffix = 1; VFSNode(mDirectory, fileName).exists() || VFSNode(mDirectory, fileName + ".gz").exists(); ++suffix) {
+        fileName.format("%s_%04d.log", baseName.chars(), suffix);
+    }
+
+    mFileStream.setNode(VFSNode(mDirectory, fileName));
+    mFileStream.openWrite();
+
+    mNumLines = 0;
+    mNumBytesWritten = 0;
+    mLastWriteTime = now;
+    this->_computeNextRollTime(now);
+}
+
+void VRollingFileLogAppender::_roll(const VInstant& now) {
+    this->_writeBuffer();
+
+    VString rolledFilePath = mFileStream.getNode().getPath();
+    mFileStream.close();
+    this->_openNewFile(now);
+    ++mNumRolls;
+
+    mHousekeeper->postRolledFile(rolledFilePath, mFileStream.getNode().getPath());
+}
+
+void VRollingFileLogAppender::_writeBuffer() {
+    Vs64 numBufferedBytes = mBufferedStream.getEOFOffset();
+    if (numBufferedBytes == 0) {
+        return;
+    }
+
+    mBufferedStream.flush();
+    mNumBytesWritten += numBufferedBytes;
+    mLastWriteTime = VInstant();
+}
+
+void VRollingFileLogAppender::_computeNextRollTime(const VInstant& now) {
+    Vs64 intervalMilliseconds = mRollInterval.getDurationMilliseconds();
+    if (intervalMilliseconds <= 0) {
+        mNextRollTime = VInstant::INFINITE_FUTURE();
+    } else {
+        mNextRollTime.setValue(((now.getValue() / intervalMilliseconds) + 1) * intervalMilliseconds);
+    }
+}
+
+void VRollingFileLogAppender::_flushIfStale() {
+    VMutexLocker locker(&mMutex, "VRollingFileLogAppender::_flushIfStale");
+    if ((mBufferedStream.getEOFOffset() != 0) && (VInstant() - mLastWriteTime >= mFlushInterval)) {
+        this->_writeBuffer();
+    }
 }
 
 // VSilentLogAppender ----------------------------------------------------------
@@ -1243,6 +2386,401 @@ void VStringVectorLogAppender::_emitRawLine(const VString& line) {
     mStorage->push_back(line);
 }
 
+// VAsyncLogWriterThread -----------------------------------------------------
+
+/**
+The background thread that writes the records queued in a VAsyncLogAppender. When the ring is
+empty it sleeps on a semaphore. Producers only take the mutex to signal it when it has said
+that it is idle, so while it is busy, queueing a record costs no more than a fence and a load.
+*/
+class VAsyncLogWriterThread : public VThread {
+    public:
+
+        VAsyncLogWriterThread(VAsyncLogAppender& appender);
+        virtual ~VAsyncLogWriterThread() {}
+
+        virtual void run();
+
+        /**
+        Wakes the thread if it is idle. Must be called after a record has been published.
+        */
+        void wake();
+        /**
+        Tells the thread to return once it has written everything in the ring, and waits for it.
+        */
+        void stopAndJoin();
+
+    private:
+
+        VAsyncLogAppender&  mAppender;
+        VMutex              mIdleMutex;
+        VSemaphore          mIdleSemaphore;
+        std::atomic<bool>   mIsIdle;
+        std::atomic<bool>   mStopRequested;
+};
+
+VAsyncLogWriterThread::VAsyncLogWriterThread(VAsyncLogAppender& appender)
+    : VThread(VSTRING_FORMAT("VAsyncLogAppender(%s)", appender.getName().chars()), "vault.toolbox.VAsyncLogAppender", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL)
+    , mAppender(appender)
+    , mIdleMutex(VSTRING_FORMAT("VAsyncLogWriterThread(%s)", appender.getName().chars()), true/*this mutex itself must not log*/)
+    , mIdleSemaphore()
+    , mIsIdle(false)
+    , mStopRequested(false)
+    {
+}
+
+void VAsyncLogWriterThread::run() {
+    for (;;) {
+        if (mAppender._writeBatch() != 0) {
+            continue;
+        }
+
+        // Only look at the stop flag once the ring is empty, so that nothing queued before the stop is lost.
+        if (mStopRequested.load()) {
+            break;
+        }
+
+        /*
+        Announce that we are idle and then look at the ring once more, with a full fence in between.
+        A producer publishes its record, fences, and then looks at mIsIdle. So either the producer
+        sees that we are idle and signals (and since it has to take the mutex to do so, the signal
+        can't arrive before we are waiting), or we see its record and don't wait.
+        */
+        mIsIdle.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        VMutexLocker locker(&mIdleMutex, "VAsyncLogWriterThread::run");
+        if (! mAppender._isRecordReady() && ! mStopRequested.load()) {
+            mIdleSemaphore.wait(&mIdleMutex, VDuration::ZERO());
+        }
+
+        mIsIdle.store(false);
+    }
+}
+
+void VAsyncLogWriterThread::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (mIsIdle.load(std::memory_order_relaxed) && mIsIdle.exchange(false)) {
+        VMutexLocker locker(&mIdleMutex, "VAsyncLogWriterThread::wake");
+        mIdleSemaphore.signal();
+    }
+}
+
+void VAsyncLogWriterThread::stopAndJoin() {
+    {
+        VMutexLocker locker(&mIdleMutex, "VAsyncLogWriterThread::stopAndJoin");
+        mStopRequested.store(true);
+        mIdleSemaphore.signal();
+    }
+
+    (void) this->join();
+}
+
+// VAsyncLogAppender ---------------------------------------------------------
+
+// static
+bool VAsyncLogAppender::isAsyncConfigured(const VSettingsNode& settings, const VSettingsNode& defaults) {
+    return VLogAppender::_getBooleanInitSetting("async", settings, defaults, false);
+}
+
+VAsyncLogAppender::VAsyncLogAppender(VLogAppenderPtr appender, int queueSize, OverflowPolicy overflowPolicy, int sampleRate, int batchSize)
+    : VLogAppender(appender->getName(), DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY())
+    , mAppender(appender)
+    , mOverflowPolicy(overflowPolicy)
+    , mSampleRate(sampleRate)
+    , mBatchSize(batchSize)
+    , mCaptureThreadName(false)
+    , mCapacity(0)
+    , mMask(0)
+    , mCells(NULL)
+    , mEnqueuePosition(0)
+    , mDequeuePosition(0)
+    , mWrittenPosition(0)
+    , mNumDropped(0)
+    , mNumOverflowed(0)
+    , mNumBlocked(0)
+    , mNumDropsReported(0)
+    , mDropReport()
+    , mWriterThread(NULL)
+    {
+    this->_init(queueSize);
+}
+
+VAsyncLogAppender::VAsyncLogAppender(VLogAppenderPtr appender, const VSettingsNode& settings, const VSettingsNode& defaults)
+    : VLogAppender(appender->getName(), DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY())
+    , mAppender(appender)
+    , mOverflowPolicy(VAsyncLogAppender::overflowPolicyFromString(VLogAppender::_getStringInitSetting("async-overflow", settings, defaults, "block")))
+    , mSampleRate(VLogAppender::_getIntInitSetting("async-sample-rate", settings, defaults, kDefaultSampleRate))
+    , mBatchSize(VLogAppender::_getIntInitSetting("async-batch-size", settings, defaults, kDefaultBatchSize))
+    , mCaptureThreadName(false)
+    , mCapacity(0)
+    , mMask(0)
+    , mCells(NULL)
+    , mEnqueuePosition(0)
+    , mDequeuePosition(0)
+    , mWrittenPosition(0)
+    , mNumDropped(0)
+    , mNumOverflowed(0)
+    , mNumBlocked(0)
+    , mNumDropsReported(0)
+    , mDropReport()
+    , mWriterThread(NULL)
+    {
+    this->_init(VLogAppender::_getIntInitSetting("async-queue-size", settings, defaults, kDefaultQueueSize));
+}
+
+VAsyncLogAppender::~VAsyncLogAppender() {
+    try {
+        mWriterThread->stopAndJoin();
+    } catch (...) {} // block exceptions from propagating
+
+    delete mWriterThread;
+    delete [] mCells;
+}
+
+void VAsyncLogAppender::addInfo(VBentoNode& infoNode) const {
+    // We don't call VLogAppender::addInfo() because our own formatting properties are unused; the wrapped appender's are shown below.
+    infoNode.addString("name", mName);
+
+    if (this->isDefaultAppender()) {
+        infoNode.addBool("is-default-appender", true);
+    }
+
+    infoNode.addString("type", "VAsyncLogAppender");
+    infoNode.addInt("async-queue-size", this->getQueueSize());
+    infoNode.addString("async-overflow", VAsyncLogAppender::getOverflowPolicyName(mOverflowPolicy));
+
+    if (mOverflowPolicy == kOverflowSample) {
+        infoNode.addInt("async-sample-rate", mSampleRate);
+    }
+
+    infoNode.addInt("async-batch-size", mBatchSize);
+    infoNode.addS64("async-num-queued", this->getNumQueued());
+    infoNode.addS64("async-num-written", this->getNumWritten());
+    infoNode.addS64("async-num-dropped", this->getNumDropped());
+    infoNode.addS64("async-num-blocked", this->getNumBlocked());
+
+    VBentoNode* appenderNode = infoNode.addNewChildNode("appender");
+    mAppender->addInfo(*appenderNode);
+}
+
+void VAsyncLogAppender::emit(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine) {
+    Vu64 position;
+    Cell* cell = this->_tryClaimCell(position);
+
+    if (cell == NULL) {
+        // The ring is full. Errors are too important to lose, so they always wait for room.
+        bool waitForRoom = (level <= VLoggerLevel::ERROR);
+
+        if (! waitForRoom) {
+            switch (mOverflowPolicy) {
+                case kOverflowBlock:
+                    waitForRoom = true;
+                    break;
+
+                case kOverflowSample:
+                    waitForRoom = ((++mNumOverflowed % mSampleRate) == 0);
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        // The writer thread's own log output can't wait for the writer to make room.
+        if (waitForRoom && (VThread::getCurrentThread() == mWriterThread)) {
+            waitForRoom = false;
+        }
+
+        if (! waitForRoom) {
+            ++mNumDropped;
+            return;
+        }
+
+        ++mNumBlocked;
+        cell = this->_waitToClaimCell(position);
+    }
+
+    cell->mRecord.capture(level, file, line, emitMessage, message, specifiedLoggerName, actualLoggerName, emitRawLine, rawLine, mCaptureThreadName);
+    cell->mSequence.store(position + 1, std::memory_order_release);
+    mWriterThread->wake();
+
+    // A fatal message may be the last thing the process does, so make sure it has been written before returning.
+    if ((level == VLoggerLevel::FATAL) && (VThread::getCurrentThread() != mWriterThread)) {
+        this->_waitUntilWritten(position);
+    }
+}
+
+void VAsyncLogAppender::drain() {
+    Vu64 position = mEnqueuePosition.load();
+    if (position != 0) {
+        this->_waitUntilWritten(position - 1);
+    }
+}
+
+// static
+VString VAsyncLogAppender::getOverflowPolicyName(OverflowPolicy overflowPolicy) {
+    switch (overflowPolicy) {
+        case kOverflowBlock:
+            return "block";
+
+        case kOverflowDrop:
+            return "drop";
+
+        case kOverflowSample:
+            return "sample";
+
+        default:
+            return VSTRING_FORMAT("%d", static_cast<int>(overflowPolicy));
+    }
+}
+
+// static
+VAsyncLogAppender::OverflowPolicy VAsyncLogAppender::overflowPolicyFromString(const VString& name) {
+    if (name.equalsIgnoreCase("block")) {
+        return kOverflowBlock;
+    }
+
+    if (name.equalsIgnoreCase("drop")) {
+        return kOverflowDrop;
+    }
+
+    if (name.equalsIgnoreCase("sample")) {
+        return kOverflowSample;
+    }
+
+    throw VRangeException(VSTRING_FORMAT("VAsyncLogAppender: Invalid overflow policy '%s'.", name.chars()));
+}
+
+void VAsyncLogAppender::_init(int queueSize) {
+    mSampleRate = V_MAX(1, mSampleRate);
+    mBatchSize = V_MAX(1, mBatchSize);
+    mCaptureThreadName = mAppender->mFormatOutput && mAppender->mFormatUsesThread;
+
+    // The position-to-slot mapping is a mask, so the capacity must be a power of 2.
+    mCapacity = 2;
+    while (mCapacity < static_cast<Vu64>(V_MAX(1, queueSize))) {
+        mCapacity *= 2;
+    }
+
+    mMask = mCapacity - 1;
+    mCells = new Cell[mCapacity];
+    for (Vu64 i = 0; i < mCapacity; ++i) {
+        mCells[i].mSequence.store(i, std::memory_order_relaxed);
+    }
+
+    mWriterThread = new VAsyncLogWriterThread(*this);
+    mWriterThread->start();
+}
+
+VAsyncLogAppender::Cell* VAsyncLogAppender::_tryClaimCell(Vu64& position) {
+    Vu64 candidatePosition = mEnqueuePosition.load(std::memory_order_relaxed);
+
+    for (;;) {
+        Cell* cell = &mCells[candidatePosition & mMask];
+        Vu64 sequence = cell->mSequence.load(std::memory_order_acquire);
+        Vs64 difference = static_cast<Vs64>(sequence - candidatePosition);
+
+        if (difference == 0) {
+            // The slot is free for this position; race the other producers for it.
+            if (mEnqueuePosition.compare_exchange_weak(candidatePosition, candidatePosition + 1, std::memory_order_relaxed)) {
+                position = candidatePosition;
+                return cell;
+            }
+        } else if (difference < 0) {
+            // The slot still holds the record from one lap ago, so the ring is full.
+            return NULL;
+        } else {
+            // Another producer claimed this position first.
+            candidatePosition = mEnqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+VAsyncLogAppender::Cell* VAsyncLogAppender::_waitToClaimCell(Vu64& position) {
+    for (int numTries = 0; ; ++numTries) {
+        Cell* cell = this->_tryClaimCell(position);
+        if (cell != NULL) {
+            return cell;
+        }
+
+        mWriterThread->wake();
+        _pause(numTries);
+    }
+}
+
+void VAsyncLogAppender::_waitUntilWritten(Vu64 position) {
+    for (int numTries = 0; mWrittenPosition.load() <= position; ++numTries) {
+        mWriterThread->wake();
+        _pause(numTries);
+    }
+}
+
+bool VAsyncLogAppender::_isRecordReady() const {
+    return mCells[mDequeuePosition & mMask].mSequence.load(std::memory_order_acquire) == (mDequeuePosition + 1);
+}
+
+int VAsyncLogAppender::_writeBatch() {
+    if (! this->_isRecordReady()) {
+        return 0;
+    }
+
+    int numWritten = 0;
+
+    VMutexLocker locker(&mAppender->mMutex, "VAsyncLogAppender::_writeBatch");
+    mAppender->mFlushDeferred = true;
+
+    while ((numWritten < mBatchSize) && this->_isRecordReady()) {
+        Cell& cell = mCells[mDequeuePosition & mMask];
+
+        try {
+            mAppender->_emitRecord(cell.mRecord);
+        } catch (...) {} // a failed write must not stop the writer or leave the slot occupied
+
+        // Free the slot for the producer of the position one lap ahead.
+        cell.mSequence.store(mDequeuePosition + mCapacity, std::memory_order_release);
+        ++mDequeuePosition;
+        ++numWritten;
+    }
+
+    Vs64 numDropped = mNumDropped.load();
+    if (numDropped != mNumDropsReported) {
+        try {
+            mAppender->_emitRecord(this->_prepareDropReport(numDropped - mNumDropsReported));
+        } catch (...) {}
+
+        mNumDropsReported = numDropped;
+    }
+
+    mAppender->mFlushDeferred = false;
+
+    try {
+        mAppender->_flush();
+    } catch (...) {}
+
+    mWrittenPosition.store(mDequeuePosition);
+
+    return numWritten;
+}
+
+VLogRecord& VAsyncLogAppender::_prepareDropReport(Vs64 numDropped) {
+    mDropReport.capture(VLoggerLevel::WARN, NULL, 0, true,
+        VSTRING_FORMAT("VAsyncLogAppender '%s' discarded " VSTRING_FORMATTER_S64 " messages because its queue was full.", mName.chars(), numDropped),
+        VString::EMPTY(), VString::EMPTY(), false, VString::EMPTY(), mCaptureThreadName);
+    return mDropReport;
+}
+
+// static
+void VAsyncLogAppender::_pause(int numTries) {
+    // Spin briefly since the writer usually frees room quickly, then stop burning the CPU it may need.
+    if (numTries < 16) {
+        VThread::yield();
+    } else {
+        VThread::sleep(VDuration::MILLISECOND());
+    }
+}
+
 // VStringLogger -------------------------------------------------------------
 
 VStringLogger::VStringLogger(const VString& name, int level, bool formatOutput, const VString& formatSpec, const VString& timeFormat)
@@ -1260,6 +2798,10 @@ void VStringLogger::_emitToAppenders(int level, const char* file, int line, bool
     mAppender.emit(level, file, line, emitMessage, message, specifiedLoggerName, this->getName(), emitRawLine, rawLine);
 }
 
+void VStringLogger::_emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload) {
+    mAppender.emitBento(level, message, specifiedLoggerName, this->getName(), payload);
+}
+
 // VStringVectorLogger -------------------------------------------------------------
 
 VStringVectorLogger::VStringVectorLogger(const VString& name, int level, /*@Nullable*/VStringVector* storage, bool formatOutput, const VString& formatSpec, const VString& timeFormat)
@@ -1277,6 +2819,10 @@ void VStringVectorLogger::_emitToAppenders(int level, const char* file, int line
     mAppender.emit(level, file, line, emitMessage, message, specifiedLoggerName, this->getName(), emitRawLine, rawLine);
 }
 
+void VStringVectorLogger::_emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload) {
+    mAppender.emitBento(level, message, specifiedLoggerName, this->getName(), payload);
+}
+
 // VLoggerRepetitionFilter ---------------------------------------------------
 
 VLoggerRepetitionFilter::VLoggerRepetitionFilter()
@@ -1468,3 +3014,171 @@ bool VLoggerPrintStackConfig::shouldPrintStack(int level, VNamedLogger& logger)
     return printStack;
 }
 
+
+// VLoggerThrottle -----------------------------------------------------------
+
+VLoggerThrottle::VLoggerThrottle()
+    : mThrottledAboveLevel(static_cast<int>(V_MAX_S32))
+    , mExemptLevel(VLoggerLevel::ERROR)
+    , mRateLimit(0)
+    , mRateBurst(0)
+    , mInterval(0)
+    , mTolerance(0)
+    , mCallSiteRateLimit(0)
+    , mCallSiteRateBurst(0)
+    , mCallSiteInterval(0)
+    , mCallSiteTolerance(0)
+    , mSampleRate(1)
+    , mSummaryInterval(CONST_S64(10000000))
+    , mTheoreticalArrivalTime(0)
+    , mRandomState(static_cast<Vu32>(VInstant::snapshot()))
+    , mNumRateLimited(0)
+    , mNumSampledOut(0)
+    , mLastSummaryTime(VTicks::snapshot() / VTicks::kNanosecondsPerMicrosecond)
+    {
+}
+
+void VLoggerThrottle::setRateLimit(int messagesPerSecond, int burst) {
+    mRateLimit = V_MAX(0, messagesPerSecond);
+    mRateBurst = (burst > 0) ? burst : V_MAX(1, mRateLimit);
+    mInterval = (mRateLimit == 0) ? 0 : (CONST_S64(1000000) / mRateLimit);
+    mTolerance = mInterval * (mRateBurst - 1);
+    this->_updateThrottledLevel();
+}
+
+void VLoggerThrottle::setCallSiteRateLimit(int messagesPerSecond, int burst) {
+    mCallSiteRateLimit = V_MAX(0, messagesPerSecond);
+    mCallSiteRateBurst = (burst > 0) ? burst : V_MAX(1, mCallSiteRateLimit);
+    mCallSiteInterval = (mCallSiteRateLimit == 0) ? 0 : (CONST_S64(1000000) / mCallSiteRateLimit);
+    mCallSiteTolerance = mCallSiteInterval * (mCallSiteRateBurst - 1);
+    this->_updateThrottledLevel();
+}
+
+void VLoggerThrottle::setSampleRate(int sampleRate) {
+    mSampleRate = V_MAX(1, sampleRate);
+    this->_updateThrottledLevel();
+}
+
+void VLoggerThrottle::setExemptLevel(int level) {
+    mExemptLevel = level;
+    this->_updateThrottledLevel();
+}
+
+void VLoggerThrottle::setSummaryInterval(const VDuration& interval) {
+    mSummaryInterval = interval.getDurationMilliseconds() * 1000;
+}
+
+bool VLoggerThrottle::admit(VNamedLogger& logger, int level, VLoggerCallSiteCache* callSite) {
+    const Vs64 now = VTicks::snapshot() / VTicks::kNanosecondsPerMicrosecond;
+    bool admitted = true;
+
+    if ((mSampleRate > 1) && ((this->_nextRandom() % static_cast<Vu32>(mSampleRate)) != 0)) {
+        ++mNumSampledOut;
+        admitted = false;
+    } else if (((callSite != NULL) && (mCallSiteInterval != 0) && !VLoggerThrottle::_conforms(callSite->mTheoreticalArrivalTime, now, mCallSiteInterval, mCallSiteTolerance)) ||
+               ((mInterval != 0) && !VLoggerThrottle::_conforms(mTheoreticalArrivalTime, now, mInterval, mTolerance))) {
+        ++mNumRateLimited;
+        admitted = false;
+    }
+
+    this->_reportIfDue(logger, level, now);
+    return admitted;
+}
+
+void VLoggerThrottle::addInfo(VBentoNode& infoNode) const {
+    if (mThrottledAboveLevel == static_cast<int>(V_MAX_S32)) {
+        return;
+    }
+
+    infoNode.addInt("throttle-exempt-level", mExemptLevel);
+
+    if (mRateLimit != 0) {
+        infoNode.addInt("rate-limit", mRateLimit);
+        infoNode.addInt("rate-limit-burst", mRateBurst);
+    }
+
+    if (mCallSiteRateLimit != 0) {
+        infoNode.addInt("call-site-rate-limit", mCallSiteRateLimit);
+        infoNode.addInt("call-site-rate-limit-burst", mCallSiteRateBurst);
+    }
+
+    if (mSampleRate > 1) {
+        infoNode.addInt("sample-rate", mSampleRate);
+    }
+}
+
+// static
+bool VLoggerThrottle::_conforms(std::atomic<Vs64>& theoreticalArrivalTime, Vs64 now, Vs64 interval, Vs64 tolerance) {
+    Vs64 arrivalTime = theoreticalArrivalTime.load(std::memory_order_relaxed);
+    for (;;) {
+        const Vs64 start = V_MAX(arrivalTime, now);
+        if (start - now > tolerance) {
+            return false;
+        }
+
+        // On failure, arrivalTime is reloaded with the value another thread stored, and we re-evaluate.
+        if (theoreticalArrivalTime.compare_exchange_weak(arrivalTime, start + interval, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void VLoggerThrottle::reportIfDue(VNamedLogger& logger) {
+    this->_reportIfDue(logger, VLoggerLevel::WARN, VTicks::snapshot() / VTicks::kNanosecondsPerMicrosecond);
+}
+
+void VLoggerThrottle::reportSuppressed(VNamedLogger& logger) {
+    if (this->getNumSuppressed() == 0) {
+        return;
+    }
+
+    const Vs64 now = VTicks::snapshot() / VTicks::kNanosecondsPerMicrosecond;
+    const Vs64 lastSummaryTime = mLastSummaryTime.exchange(now, std::memory_order_relaxed);
+    this->_report(logger, VLoggerLevel::WARN, now - lastSummaryTime);
+}
+
+void VLoggerThrottle::_updateThrottledLevel() {
+    const bool throttling = (mRateLimit != 0) || (mCallSiteRateLimit != 0) || (mSampleRate > 1);
+    mThrottledAboveLevel = throttling ? mExemptLevel : static_cast<int>(V_MAX_S32);
+
+    if (throttling) {
+        _scheduleSummaryTimer();
+    }
+}
+
+Vu32 VLoggerThrottle::_nextRandom() {
+    // A Weyl sequence scrambled by the MurmurHash3 finalizer; good enough for sampling, and lock-free.
+    Vu32 x = mRandomState.fetch_add(0x9E3779B9U, std::memory_order_relaxed);
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    x ^= x >> 16;
+    return x;
+}
+
+void VLoggerThrottle::_reportIfDue(VNamedLogger& logger, int level, Vs64 now) {
+    Vs64 lastSummaryTime = mLastSummaryTime.load(std::memory_order_relaxed);
+    if ((now - lastSummaryTime < mSummaryInterval) || (this->getNumSuppressed() == 0)) {
+        return;
+    }
+
+    // Only the thread that advances the summary time reports, so each suppressed message is counted once.
+    if (!mLastSummaryTime.compare_exchange_strong(lastSummaryTime, now, std::memory_order_relaxed)) {
+        return;
+    }
+
+    this->_report(logger, level, now - lastSummaryTime);
+}
+
+void VLoggerThrottle::_report(VNamedLogger& logger, int level, Vs64 elapsedMicros) {
+    const int numRateLimited = mNumRateLimited.exchange(0);
+    const int numSampledOut = mNumSampledOut.exchange(0);
+    if (numRateLimited + numSampledOut == 0) {
+        return;
+    }
+
+    VDuration elapsed = VDuration::MILLISECOND() * (elapsedMicros / 1000);
+    logger.log(V_MIN(level, VLoggerLevel::WARN), VSTRING_FORMAT("Suppressed %d messages in the last %s (%d by rate limit, %d by sampling).",
+        numRateLimited + numSampledOut, elapsed.getDurationString().chars(), numRateLimited, numSampledOut));
+}
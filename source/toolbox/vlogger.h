@@ -12,8 +12,12 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vtypes.h"
 
+#include <atomic>
+
 #include "vmutex.h"
 #include "vbufferedfilestream.h"
+#include "vdirectiofilestream.h"
+#include "vwritebufferedstream.h"
 #include "vtextiostream.h"
 
 // Microsoft steals this symbol name globally. Take it back.
@@ -94,6 +98,12 @@ class VBentoNode;
     hierarchy could be unrelated to the class structure of the code, and instead describe some
     hierarchy of entities and their ids).
 
+    Finding a named logger does not take any lock. The registry of loggers is published as an immutable
+    snapshot that is replaced whenever a logger is registered or deregistered, or the default logger is
+    changed. In addition, each VLOGGER_NAMED macro statement caches the logger that its name resolved to,
+    along with the generation of the snapshot it was resolved in; as long as the registry is unchanged and
+    the statement is called with the same name, it reuses that logger without searching.
+
     <h1>Configuration XML</h1>
 
     If you do nothing to configure logging, a logger at INFO level is created upon first use, and
@@ -193,6 +203,43 @@ class VBentoNode;
       Defaults to infinity ("INFINITY") meaning no limit. If specific, this is a time limit on how
       long stack tracing will continue to emit once triggered. It is another way of preventing runaway
       repeated stack tracing.
+    - "async" (boolean)
+      Defaults to false. If true, the appender is wrapped in a VAsyncLogAppender, so that callers
+      only queue their messages, and a background thread formats and writes them. The related
+      "async-queue-size", "async-overflow", "async-sample-rate", and "async-batch-size" settings
+      are described with VAsyncLogAppender. It is ignored for the "binary" kind, which must
+      receive each message's level and logger name rather than a formatted line.
+
+    <h1>Rate Limiting and Sampling</h1>
+
+    The repetition filter only suppresses a message that is exactly repeated. To keep a burst of
+    similar messages (say, the same warning with varying text from thousands of sessions) from
+    overwhelming the output, a logger can limit the rate at which it emits, and can sample its
+    messages. The following settings are specified on the logger node:
+    - "rate-limit" (int)
+      Defaults to 0 (no limit). The number of messages per second the logger emits on average.
+    - "rate-limit-burst" (int)
+      Defaults to the "rate-limit" value. The number of messages that may be emitted in a burst
+      before the rate limit applies.
+    - "call-site-rate-limit" (int) and "call-site-rate-limit-burst" (int)
+      The same, but applied separately to each VLOGGER_NAMED macro statement that logs to the
+      logger, so that one noisy statement cannot use up the logger's entire rate.
+    - "sample-rate" (int)
+      Defaults to 1 (no sampling). If greater than 1, only a random 1 in N messages is emitted.
+    - "throttle-exempt-level" (level)
+      Defaults to ERROR. Messages at this level or more severe are never rate limited or sampled.
+    - "suppressed-summary-interval" (duration string such as "10s")
+      Defaults to 10 seconds. When messages have been suppressed, the logger emits a line saying
+      how many, at most once per interval. It is emitted along with the next message the logger
+      emits after the interval has passed.
+
+    The decision is made by the VLOGGER macros before the message is formatted, so a suppressed
+    message costs neither formatting nor locking, and a logger with no limits costs nothing extra.
+    For example:
+
+    <pre>
+        <logger name="sessions" level="INFO" rate-limit="100" call-site-rate-limit="10" />
+    </pre>
 
     <h1>Custom Appenders</h1>
 
@@ -212,8 +259,8 @@ class VBentoNode;
 */
 
 // This first set of macros sends output to the default logger.
-#define VLOGGER_LEVEL(level, message) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VLogger::getDefaultLogger()->log(level, NULL, 0, message, VString::EMPTY()); } while (false)
-#define VLOGGER_LEVEL_FILELINE(level, message, file, line) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VLogger::getDefaultLogger()->log(level, file, line, message, VString::EMPTY()); } while (false)
+#define VLOGGER_LEVEL(level, message) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VNamedLoggerPtr dl = VLogger::getDefaultLogger(); if (dl->admit(level)) dl->log(level, NULL, 0, message, VString::EMPTY()); } while (false)
+#define VLOGGER_LEVEL_FILELINE(level, message, file, line) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VNamedLoggerPtr dl = VLogger::getDefaultLogger(); if (dl->admit(level)) dl->log(level, file, line, message, VString::EMPTY()); } while (false)
 #define VLOGGER_LINE(level, message) VLOGGER_LEVEL_FILELINE(level, message, __FILE__, __LINE__)
 #define VLOGGER_FATAL_AND_THROW(message) do { VLogger::getDefaultLogger()->log(VLoggerLevel::FATAL, __FILE__, __LINE__, message); throw VStackTraceException(message); } while (false)
 #define VLOGGER_FATAL(message) VLOGGER_LEVEL_FILELINE(VLoggerLevel::FATAL, message, __FILE__, __LINE__)
@@ -222,12 +269,13 @@ class VBentoNode;
 #define VLOGGER_INFO(message) VLOGGER_LEVEL(VLoggerLevel::INFO, message)
 #define VLOGGER_DEBUG(message) VLOGGER_LEVEL(VLoggerLevel::DEBUG, message)
 #define VLOGGER_TRACE(message) VLOGGER_LEVEL(VLoggerLevel::TRACE, message)
-#define VLOGGER_HEXDUMP(level, message, buffer, length) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VLogger::getDefaultLogger()->logHexDump(level, message, VString::EMPTY(), buffer, length); } while (false)
+#define VLOGGER_HEXDUMP(level, message, buffer, length) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VNamedLoggerPtr dl = VLogger::getDefaultLogger(); if (dl->admit(level)) dl->logHexDump(level, message, VString::EMPTY(), buffer, length); } while (false)
+#define VLOGGER_BENTO(level, message, bento) do { if (!VLogger::isDefaultLogLevelActive(level)) break; VNamedLoggerPtr dl = VLogger::getDefaultLogger(); if (dl->admit(level)) dl->logBento(level, message, VString::EMPTY(), bento); } while (false)
 #define VLOGGER_WOULD_LOG(level) (VLogger::isDefaultLogLevelActive(level))
 
 // This set of macros sends output to a specified named logger.
-#define VLOGGER_NAMED_LEVEL(loggername, level, message) do { if (!VLogger::isLogLevelActive(level)) break; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(loggername, level); if (nl != nullptr) nl->log(level, NULL, 0, message, loggername); } while (false)
-#define VLOGGER_NAMED_LEVEL_FILELINE(loggername, level, message, file, line) do { if (!VLogger::isLogLevelActive(level)) break; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(loggername, level); if (nl != nullptr) nl->log(level, file, line, message, loggername); } while (false)
+#define VLOGGER_NAMED_LEVEL(loggername, level, message) do { if (!VLogger::isLogLevelActive(level)) break; static VLoggerCallSiteCache vlcache; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(vlcache, loggername, level); if ((nl != nullptr) && nl->admit(level, &vlcache)) nl->log(level, NULL, 0, message, loggername); } while (false)
+#define VLOGGER_NAMED_LEVEL_FILELINE(loggername, level, message, file, line) do { if (!VLogger::isLogLevelActive(level)) break; static VLoggerCallSiteCache vlcache; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(vlcache, loggername, level); if ((nl != nullptr) && nl->admit(level, &vlcache)) nl->log(level, file, line, message, loggername); } while (false)
 #define VLOGGER_NAMED_LINE(loggername, level, message) VLOGGER_NAMED_LEVEL_FILELINE(loggername, level, message, __FILE__, __LINE__)
 #define VLOGGER_NAMED_FATAL(loggername, message) VLOGGER_NAMED_LEVEL_FILELINE(loggername, VLoggerLevel::FATAL, message, __FILE__, __LINE__)
 #define VLOGGER_NAMED_ERROR(loggername, message) VLOGGER_NAMED_LEVEL_FILELINE(loggername, VLoggerLevel::ERROR, message, __FILE__, __LINE__)
@@ -235,12 +283,64 @@ class VBentoNode;
 #define VLOGGER_NAMED_INFO(loggername, message) VLOGGER_NAMED_LEVEL(loggername, VLoggerLevel::INFO, message)
 #define VLOGGER_NAMED_DEBUG(loggername, message) VLOGGER_NAMED_LEVEL(loggername, VLoggerLevel::DEBUG, message)
 #define VLOGGER_NAMED_TRACE(loggername, message) VLOGGER_NAMED_LEVEL(loggername, VLoggerLevel::TRACE, message)
-#define VLOGGER_NAMED_HEXDUMP(loggername, level, message, buffer, length) do { if (!VLogger::isLogLevelActive(level)) break; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(loggername, level); if (nl != nullptr) nl->logHexDump(level, message, loggername, buffer, length); } while (false)
+#define VLOGGER_NAMED_HEXDUMP(loggername, level, message, buffer, length) do { if (!VLogger::isLogLevelActive(level)) break; static VLoggerCallSiteCache vlcache; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(vlcache, loggername, level); if ((nl != nullptr) && nl->admit(level, &vlcache)) nl->logHexDump(level, message, loggername, buffer, length); } while (false)
+#define VLOGGER_NAMED_BENTO(loggername, level, message, bento) do { if (!VLogger::isLogLevelActive(level)) break; static VLoggerCallSiteCache vlcache; VNamedLoggerPtr nl = VLogger::findNamedLoggerForLevel(vlcache, loggername, level); if ((nl != nullptr) && nl->admit(level, &vlcache)) nl->logBento(level, message, loggername, bento); } while (false)
 #define VLOGGER_NAMED_WOULD_LOG(loggername, level) (VLogger::isLogLevelActive(level) && (VLogger::findNamedLoggerForLevel(loggername, level) != nullptr))
 
 #define VLOGGER_APPENDER_EMIT(appender, level, message) do { (appender).emit(level, (level <= VLoggerLevel::ERROR) ? __FILE__ : NULL, (level <= VLoggerLevel::ERROR) ? __LINE__ : 0, true, message, VString::EMPTY(), VString::EMPTY(), false, VString::EMPTY()); } while (false)
 #define VLOGGER_APPENDER_EMIT_FILELINE(appender, level, message, file, line) do { (appender).emit(level, file, line, true, message, VString::EMPTY(), VString::EMPTY(), false, VString::EMPTY()); } while (false)
 
+class VLoggerCallSiteEntry;
+
+/**
+VLoggerCallSiteCache is the per-statement cache used by the VLOGGER_NAMED macros; each macro
+statement declares one as a function-local static. It has no constructor, so it is zero-initialized
+before any code runs and needs no initialization guard. It points to an immutable entry that records
+the logger name that was last resolved at that statement, the logger it resolved to, and the
+generation of the logger registry in which it was resolved. The entry is only used while that
+generation is current. See VLogger::findNamedLoggerForLevel(). It also holds the statement's
+rate limiting state, used if the logger it resolves to has a "call-site-rate-limit"; see
+VNamedLogger::admit().
+*/
+struct VLoggerCallSiteCache {
+    std::atomic<const VLoggerCallSiteEntry*> mEntry;
+    std::atomic<Vs64> mTheoreticalArrivalTime; ///< The call site's token bucket state, in microseconds; see VLoggerThrottle.
+};
+
+/**
+VLogRecord captures the arguments of one VLogAppender::emit() call, along with the time and the
+name of the calling thread, so that the message can be formatted and written later on another
+thread, as VAsyncLogAppender does. The file pointer is retained as is, so it must be a __FILE__
+string literal (or NULL), as it is for all of the VLOGGER macros.
+*/
+class VLogRecord {
+    public:
+
+        VLogRecord();
+        ~VLogRecord() {}
+
+        /**
+        Sets all of the record's properties from the arguments to VLogAppender::emit() and from the
+        current time. The calling thread's name is only looked up if captureThreadName is true,
+        since a thread name is only needed by an appender whose format uses it.
+        */
+        void capture(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine, bool captureThreadName);
+
+        int         mLevel;                 ///< The level at which the message was logged.
+        const char* mFile;                  ///< The __FILE__ value of the log statement, or NULL.
+        int         mLine;                  ///< The __LINE__ value of the log statement, or 0.
+        bool        mEmitMessage;           ///< True if mMessage is to be emitted with formatting.
+        VString     mMessage;               ///< The message text.
+        VString     mSpecifiedLoggerName;   ///< The logger name supplied by the original caller.
+        VString     mActualLoggerName;      ///< The name of the logger that emitted the message.
+        bool        mEmitRawLine;           ///< True if mRawLine is to be emitted as is.
+        VString     mRawLine;               ///< The raw line text.
+        VInstant    mWhen;                  ///< The time the message was logged (which may be simulated or frozen time).
+        VInstant    mTrueWhen;              ///< The true time the message was logged, if mHasTrueTime is set.
+        bool        mHasTrueTime;           ///< True if simulated or frozen time was in effect, so both times should be printed.
+        VString     mThreadName;            ///< The name of the thread that logged the message, if it was captured.
+};
+
 /**
 VLogAppender is an abstract base class that defines the API for writing output to a destination.
 */
@@ -303,6 +403,18 @@ class VLogAppender {
         @param  message     the message to be emitted in raw form
         */
         void emitRaw(const VString& message);
+        /**
+        Entry point called by named loggers to append a message that carries a structured Bento payload.
+        The base class implementation appends the payload's Bento text form to the message and emits it
+        like any other message, so text appenders need not know about payloads. Appenders with a binary
+        output format, such as VBinaryLogAppender, override this to keep the payload in its binary form.
+        @param  level       the level at which the message is being logged, and has already been filtered
+        @param  message     the message to emit
+        @param  specifiedLoggerName if not empty, the logger name supplied by the original caller
+        @param  actualLoggerName if not empty, the name of the logger that is actually calling us
+        @param  payload     the structured data that accompanies the message
+        */
+        virtual void emitBento(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload);
 
         /**
         For diagnostic purposes, adds the properties/state of this appender to the supplied Bento node.
@@ -341,6 +453,20 @@ class VLogAppender {
         */
         virtual VString _formatMessage(int level, const char* file, int line, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName);
         /**
+        Emits a record that was captured earlier, formatting its message exactly as _emitMessage()
+        would have at the time it was captured. This is how VAsyncLogAppender writes to the appender
+        it wraps; the caller must hold mMutex. Note that the base class formatting is used, so
+        an appender that overrides _emitMessage() or _formatMessage() should not be made asynchronous.
+        @param  record  the record to emit
+        */
+        void _emitRecord(const VLogRecord& record);
+        /**
+        Flushes any output written by _emitRawLine() while mFlushDeferred was set. Appenders whose
+        _emitRawLine() flushes after each line should override this and skip that flush while
+        mFlushDeferred is set, so that a batch of lines is written with a single flush.
+        */
+        virtual void _flush() {}
+        /**
         This is the method that most concrete appenders must implement in order to write a message
         (whether it is in raw form or has already been formatted) to the output medium.
         The reason an emty implementation is provided here, rather than it being pure virtual, is that
@@ -366,7 +492,7 @@ class VLogAppender {
         
         // These fields cache state of the mFormatSpec. This allows _formatMessage() to avoid unnecessary work
         // when we know the format doesn't need everything to be supplied. If we allow mFormatSpec to be set
-        // after construction, these will have to be re-calculated at that time.
+        // after construction, these will have to be re-calculated at that time, and _compileFormatSpec() called.
         bool    mFormatUsesLocalTime;
         bool    mFormatUsesUTCTime;
         bool    mFormatUsesLevel;
@@ -375,11 +501,71 @@ class VLogAppender {
         bool    mFormatUsesSpecifiedLoggerName;
         bool    mFormatUsesActualLoggerName;
 
+        bool    mFlushDeferred; ///< True while an asynchronous writer is emitting a batch of lines; see _flush().
+
     private:
 
+        /**
+        The kinds of segment that mFormatSpec is compiled into: literal text, or one of the $ variables.
+        */
+        typedef enum {
+            kFormatLiteral,
+            kFormatLocalTime,
+            kFormatUTCTime,
+            kFormatLevel,
+            kFormatLocation,
+            kFormatThread,
+            kFormatSpecifiedLogger,
+            kFormatActualLogger,
+            kFormatMessage,
+            kNumFormatFields
+        } FormatField;
+
+        /**
+        One segment of the compiled format spec.
+        */
+        struct FormatSegment {
+            FormatSegment(FormatField field, const VString& literal) : mField(field), mLiteral(literal) {}
+            FormatField mField;     ///< What the segment renders.
+            VString     mLiteral;   ///< The text, if mField is kFormatLiteral.
+        };
+        typedef std::vector<FormatSegment> FormatSegmentList;
+
+        /**
+        Compiles mFormatSpec into mFormatSegments, and decides how long a formatted time stamp can be
+        reused. Called by the constructors.
+        */
+        void _compileFormatSpec();
+        /**
+        Renders the compiled format with the supplied values, in a single pass, into mFormatBuffer.
+        This is the common part of _formatMessage() and _emitRecord(), which differ only in where the
+        time stamp and thread name come from. The caller must hold mMutex, which protects the buffer
+        and time stamp caches.
+        @return a reference to mFormatBuffer, which is valid until the next call
+        */
+        const VString& _applyFormatSpec(const VInstant& now, const VInstant& trueNow, bool prependTrueTime, const VString& threadName, int level, const char* file, int line, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName) const;
+        /**
+        Returns the time stamp text for the specified time, reusing the previous result if it is
+        in the same millisecond, or in the same second if the time format does not show milliseconds.
+        @param  when    the time to format
+        @param  utc     true for UTC, false for local time
+        @return a reference to the cached text, which is valid until the next call
+        */
+        const VString& _getTimeStampString(const VInstant& when, bool utc) const;
+
+        FormatSegmentList   mFormatSegments;            ///< The compiled mFormatSpec.
+        Vs64                mTimeStampGranularity;      ///< The number of milliseconds for which one formatted time stamp is good: 1 or 1000.
+        mutable Vs64        mCachedLocalTimeStampKey;   ///< The time value divided by mTimeStampGranularity, for mCachedLocalTimeStamp.
+        mutable VString     mCachedLocalTimeStamp;      ///< The most recently formatted local time stamp.
+        mutable Vs64        mCachedUTCTimeStampKey;     ///< The time value divided by mTimeStampGranularity, for mCachedUTCTimeStamp.
+        mutable VString     mCachedUTCTimeStamp;        ///< The most recently formatted UTC time stamp.
+        mutable VString     mFormatBuffer;              ///< The buffer that each formatted line is rendered into; its allocation is reused from line to line.
+
         VString _toString() const; ///< For diagnostics, returns a string representation of this appender and its name.
 
         static void _breakpointLocationForEmit(); ///< A convenient place to set a debugger breakpoint for any appender emitting output.
+
+        friend class VAsyncLogAppender; // it emits records to the appender it wraps
 };
 
 typedef VSharedPtr<VLogAppender> VLogAppenderPtr;
@@ -494,6 +680,134 @@ class VLoggerPrintStackConfig {
         VInstant    mExpiration;    ///< Internal instant for when the configured duration expires and we turn back to OFF
 };
 
+/**
+VLoggerThrottle encapsulates the rate limiting and sampling configuration and state of a named logger;
+see VNamedLogger::admit(). Rate limits are token buckets implemented by the generic cell rate algorithm,
+so the state of a bucket is a single "theoretical arrival time" that is advanced by compare-and-swap;
+no lock is taken. A limit of N messages per second with a burst of B allows a message if the bucket's
+theoretical arrival time is no more than (B - 1) intervals of 1/N seconds ahead of now, and then
+advances it by one interval.
+
+The count of suppressed messages is reported as a summary message when a throttled message arrives
+after the summary interval has passed. So that the summary of the last burst is not held back until
+the next one, the registered loggers' due summaries are also reported once a second from the shared
+timer wheel, and any pending counts are reported when a logger is deregistered or VLogger is shut down.
+*/
+class VLoggerThrottle {
+    public:
+
+        VLoggerThrottle();
+        ~VLoggerThrottle() {}
+
+        /**
+        Sets the rate limit applied to all messages admitted by the logger.
+        @param  messagesPerSecond   the average rate allowed; 0 means no limit
+        @param  burst               the number of messages allowed in a burst; 0 means the same as messagesPerSecond
+        */
+        void setRateLimit(int messagesPerSecond, int burst);
+        /**
+        Sets the rate limit applied to each VLOGGER_NAMED macro statement that logs to the logger.
+        @param  messagesPerSecond   the average rate allowed; 0 means no limit
+        @param  burst               the number of messages allowed in a burst; 0 means the same as messagesPerSecond
+        */
+        void setCallSiteRateLimit(int messagesPerSecond, int burst);
+        /**
+        Sets the sampling of messages.
+        @param  sampleRate  if greater than 1, 1 in sampleRate messages is admitted at random
+        */
+        void setSampleRate(int sampleRate);
+        /**
+        Sets the level at and below which (more severe) messages are exempt from throttling.
+        @param  level   the exempt level, for example VLoggerLevel::ERROR
+        */
+        void setExemptLevel(int level);
+        /**
+        Sets how often the count of suppressed messages may be reported.
+        @param  interval    the minimum time between reports
+        */
+        void setSummaryInterval(const VDuration& interval);
+
+        /**
+        Returns true if a message at the specified level is subject to throttling; if not, it is
+        admitted without further checking.
+        @param  level   the level of the message
+        @return true if admit() must be called to decide
+        */
+        bool isThrottled(int level) const { return level > mThrottledAboveLevel; }
+        /**
+        Decides whether a throttled message is emitted, counting it if not, and reporting the counts
+        to the logger when they are due.
+        @param  logger      the logger whose throttle this is, to which the summary is reported
+        @param  level       the level of the message
+        @param  callSite    the macro statement's cache, or NULL if not logged through a VLOGGER_NAMED macro
+        @return true if the message is to be emitted
+        */
+        bool admit(VNamedLogger& logger, int level, VLoggerCallSiteCache* callSite);
+
+        /**
+        Reports the count of suppressed messages to the logger if the summary interval has passed.
+        @param  logger  the logger whose throttle this is
+        */
+        void reportIfDue(VNamedLogger& logger);
+        /**
+        Reports the count of suppressed messages to the logger now, if there are any.
+        @param  logger  the logger whose throttle this is
+        */
+        void reportSuppressed(VNamedLogger& logger);
+
+        int getNumSuppressed() const { return mNumRateLimited + mNumSampledOut; } ///< Returns the number of messages suppressed and not yet reported. @return obvious
+        void addInfo(VBentoNode& infoNode) const; ///< Adds the settings to the logger's info, if any are in effect. @param infoNode the node to add to
+
+    private:
+
+        VLoggerThrottle(const VLoggerThrottle&); // not copyable
+        VLoggerThrottle& operator=(const VLoggerThrottle&); // not assignable
+
+        /**
+        Applies the generic cell rate algorithm to a bucket.
+        @param  theoreticalArrivalTime  the bucket state, updated if the message conforms
+        @param  now                     the current monotonic time in microseconds
+        @param  interval                the emission interval in microseconds
+        @param  tolerance               the burst tolerance in microseconds
+        @return true if the message conforms to the rate
+        */
+        static bool _conforms(std::atomic<Vs64>& theoreticalArrivalTime, Vs64 now, Vs64 interval, Vs64 tolerance);
+        void _updateThrottledLevel(); ///< Recalculates mThrottledAboveLevel after a setting changes.
+        Vu32 _nextRandom();           ///< Returns a pseudo-random number for sampling.
+        /**
+        If the summary interval has passed and messages have been suppressed, logs the counts and resets them.
+        @param  logger  the logger to log the summary to
+        @param  level   the level of the message being admitted; the summary is logged at that level or WARN, whichever is more severe
+        @param  now     the current monotonic time in microseconds
+        */
+        void _reportIfDue(VNamedLogger& logger, int level, Vs64 now);
+        /**
+        Logs the counts of suppressed messages and resets them. Does nothing if they are 0.
+        @param  logger          the logger to log the summary to
+        @param  level           as for _reportIfDue()
+        @param  elapsedMicros   the time since the last summary, in microseconds
+        */
+        void _report(VNamedLogger& logger, int level, Vs64 elapsedMicros);
+
+        int                 mThrottledAboveLevel;   ///< Messages at levels above this are throttled; V_MAX_S32 if no throttling is configured.
+        int                 mExemptLevel;           ///< The configured exempt level.
+        int                 mRateLimit;             ///< The configured logger rate, in messages per second.
+        int                 mRateBurst;             ///< The configured logger burst size.
+        Vs64                mInterval;              ///< The logger emission interval in microseconds, or 0 if not limited.
+        Vs64                mTolerance;             ///< The logger burst tolerance in microseconds.
+        int                 mCallSiteRateLimit;     ///< The configured per-call-site rate, in messages per second.
+        int                 mCallSiteRateBurst;     ///< The configured per-call-site burst size.
+        Vs64                mCallSiteInterval;      ///< The per-call-site emission interval in microseconds, or 0 if not limited.
+        Vs64                mCallSiteTolerance;     ///< The per-call-site burst tolerance in microseconds.
+        int                 mSampleRate;            ///< 1 in this many messages is admitted; 1 for no sampling.
+        Vs64                mSummaryInterval;       ///< The minimum time between summaries, in microseconds.
+        std::atomic<Vs64>   mTheoreticalArrivalTime;///< The logger's bucket state.
+        std::atomic<Vu32>   mRandomState;           ///< State of the sampling random number sequence.
+        std::atomic<int>    mNumRateLimited;        ///< Messages suppressed by a rate limit since the last summary.
+        std::atomic<int>    mNumSampledOut;         ///< Messages suppressed by sampling since the last summary.
+        std::atomic<Vs64>   mLastSummaryTime;       ///< The time of the last summary, or of construction.
+};
+
 /**
 VNamedLogger defines an object to which log output is initially sent. A logger has a name (that is used
 to locate it and direct output to it) and a level (which the logger uses to filter what it receives).
@@ -565,6 +879,15 @@ class VNamedLogger : public VEnableSharedFromThis<VNamedLogger> {
         */
         void logHexDump(int level, const VString& message, const VString& specifiedLoggerName, const Vu8* buffer, Vs64 length);
         /**
+        Logs a message along with a structured Bento payload (subject to filtering). Each appender
+        decides how to render the payload; see VLogAppender::emitBento().
+        @param  level               the level of the message
+        @param  message             the message to be logged
+        @param  specifiedLoggerName if not empty, the logger name supplied by caller
+        @param  payload             the structured data to be logged with the message
+        */
+        void logBento(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload);
+        /**
         Emits a string in its raw form, without filtering; presumably called by a stack trace function.
         @param  message the string to be logged
         */
@@ -577,6 +900,19 @@ class VNamedLogger : public VEnableSharedFromThis<VNamedLogger> {
 
         void setRepetitionFilterEnabled(bool enabled) { mRepetitionFilter.setEnabled(enabled); }    ///< Enabled or disables repetition filtering by this logger. @param enabled obvious
 
+        /**
+        Returns true if a message at the specified level, which has already passed the level check,
+        should be logged according to this logger's rate limits and sampling; see "Rate Limiting and
+        Sampling" above. The VLOGGER macros call this before formatting the message, so that a
+        suppressed message costs little; if no throttling is configured, this is a single comparison.
+        Calling log() directly does not apply throttling, so code that does so should call this first.
+        @param  level       the level of the message
+        @param  callSite    the VLOGGER_NAMED macro statement's cache, for per-call-site limits; NULL if none
+        @return true if the message should be logged
+        */
+        bool admit(int level, VLoggerCallSiteCache* callSite = NULL) { return !mThrottle.isThrottled(level) || mThrottle.admit(*this, level, callSite); }
+        VLoggerThrottle& getThrottle() { return mThrottle; } ///< Returns the throttle, to configure rate limits and sampling. @return obvious
+
         /**
         Returns the log level at which the logger will cause a stack trace to be emitted along with
         the logged message. For example, if the print stack level is ERROR, then any log output at
@@ -619,6 +955,15 @@ class VNamedLogger : public VEnableSharedFromThis<VNamedLogger> {
         @param  rawLine     the raw line to be emitted if emitRawLine is true (the appenders should not format the raw line)
         */
         virtual void _emitToAppenders(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, bool emitRawLine, const VString& rawLine);
+        /**
+        The counterpart of _emitToAppenders() for a message with a Bento payload; it emits to the same
+        appenders. The caller must hold mAppendersMutex.
+        @param  level       the log level of the message
+        @param  message     the message to be emitted
+        @param  specifiedLoggerName if not empty, the logger name supplied by caller
+        @param  payload     the structured data to be emitted with the message
+        */
+        virtual void _emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload);
 
     private:
 
@@ -633,6 +978,7 @@ class VNamedLogger : public VEnableSharedFromThis<VNamedLogger> {
         VLogAppenderPtr         mSpecificAppender;  ///< If not null, a specific appender instance we emit to.
         VLoggerRepetitionFilter mRepetitionFilter;  ///< Used to prevent repetitive info from clogging output.
         VLoggerPrintStackConfig mPrintStackConfig;  ///< Settings that control whether we add a stack trace for log messages at certain levels.
+        VLoggerThrottle         mThrottle;          ///< Rate limiting and sampling settings and state.
 
         friend class VLoggerRepetitionFilter; // it can call our _emitToAppenders when we call it from our log() function
         friend class VLoggerPrintStackConfig; // ditto
@@ -715,6 +1061,8 @@ The VLogger class provides the static APIs for configuring the logging system, a
 finding appenders and loggers, etc. This is the primary outward facing class for logging beyond the
 use of the macros that generate output.
 */
+class VNamedLoggerSnapshot;
+
 class VLogger {
     public:
 
@@ -753,7 +1101,9 @@ class VLogger {
         /**
         This function should always be called when terminating the application, as late as possible
         to ensure that no attempt is made to log after this is called. It cleans up and removes all
-        logging objects.
+        logging objects. It is also where loggers that have been deregistered, and are therefore no
+        longer visible to new lookups, are finally released; so no other thread may be logging while
+        this is called.
         */
         static void shutdown();
 
@@ -904,6 +1254,18 @@ class VLogger {
         @return a logger (@ Nullable)
         */
         static VNamedLoggerPtr findNamedLoggerForLevel(const VString& name, int level);
+        /**
+        Like findNamedLoggerForLevel() above, but remembers the result in the supplied call site cache,
+        so that a subsequent call with the same name finds the logger with a couple of atomic loads and
+        a string compare, as long as no logger has been registered or deregistered in the meantime.
+        This is what the VLOGGER_NAMED macros use. A null pointer is returned without touching the
+        logger's reference count, so a statement that won't log pays only for the lookup.
+        @param  cache   the caller's call site cache, normally a function-local static
+        @param  name    the name of the logger to find
+        @param  level   the level to check as active for the found logger
+        @return a logger (@ Nullable)
+        */
+        static VNamedLoggerPtr findNamedLoggerForLevel(VLoggerCallSiteCache& cache, const char* name, int level);
 
         // Appenders:
         /**
@@ -958,6 +1320,8 @@ class VLogger {
 
         // Used specifically by VNamedLogger::_emitToAppenders to emit to all "global appenders" with correct locking. Should not be called elsewhere.
         static void emitToGlobalAppenders(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine);
+        // Used specifically by VNamedLogger::_emitBentoToAppenders in the same way. Should not be called elsewhere.
+        static void emitBentoToGlobalAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, const VBentoNode& payload);
         
         // Utility function useful in forming a logger name; returns a copy of the input string with dots (our path separators) converted to dashes.
         static VString getCleansedLoggerName(const VString& s);
@@ -967,9 +1331,11 @@ class VLogger {
         VLogger(const VLogger&); // not copyable
         VLogger& operator=(const VLogger&); // not assignable
 
+        static VNamedLoggerPtr _newNamedLogger(const VSettingsNode& loggerSettings); // Creates a logger as specified by the settings, without registering it.
+
         // These helper methods, like private methods in general, assume the caller has locked.
         static void _registerAppender(VLogAppenderPtr appender, bool asDefaultAppender = false, bool asGlobalAppender = false);
-        static void _registerLogger(VNamedLoggerPtr namedLogger, bool asDefaultLogger = false);
+        static void _registerLogger(VNamedLoggerPtr namedLogger, bool asDefaultLogger = false, bool publishSnapshot = true);
         static VBentoNode* _commandGetInfo();
         static VString _commandGetInfoString();
 
@@ -979,9 +1345,11 @@ class VLogger {
         static void _checkMaxActiveLogLevelForChangedLogger(int oldActiveLevel, int newActiveLevel); // Called when a logger's level is changed, since that may change the max active log level.
         static void _recalculateMaxActiveLogLevel(); // Called when one of the _check... methods decides the max active log level may indeed have changed, and must be recalculated.
 
-        // These two methods are how we really search for a specified named logger.
-        static VNamedLoggerPtr _findNamedLoggerFromExactName(const VString& name);      ///< Return the logger with the specified name, or null if it doesn't exist. (@ Nullable)
-        static VNamedLoggerPtr _findNamedLoggerFromPathName(const VString& pathName);   ///< Return a logger using a dot-separated path name, falling back to an exact name find. (@ Nullable)
+        // These methods maintain the lock-free snapshot of the logger registry that the finders use.
+        static void _publishLoggerSnapshot(); // Called whenever the logger map or default logger changes, to replace the published snapshot.
+        static void _reclaimRetiredLoggerObjects(); // Deletes replaced snapshots and call site entries, unless a thread may still be reading them.
+        static const VNamedLoggerSnapshot* _getLoggerSnapshotWithDefaultLogger(const VString& defaultLoggerName); // Returns the snapshot, first creating the default logger with the specified name if there is none. Locks only in that case.
+        static VNamedLogger* _resolveCallSite(VLoggerCallSiteCache& cache, const char* name); // The slow path of the call site cache: searches the snapshot and updates the cache.
 
         // _mutexInstance() must be used internally whenever referencing these variables:
         volatile static int     gMaxActiveLevel;    ///< The max level of any registered logger. Used to optimize the VLOGGER macros so they can return early if a log statement won't pass level filters.
@@ -1016,6 +1384,7 @@ class VCoutLogAppender : public VLogAppender {
         virtual void addInfo(VBentoNode& infoNode) const;
     protected:
         virtual void _emitRawLine(const VString& line);
+        virtual void _flush();
 };
 
 /**
@@ -1023,40 +1392,160 @@ An appender that emits to one big file.
 It defines the following additional properties:
 - "path" (string)
   Defaults to the appender name. Specifies the file path for the log file.
+- "async-io" (boolean)
+  Defaults to false. Writes the lines with a VAsyncFileStream, so the thread emitting a line
+  hands it off and never waits for the disk. The lines emitted while flushing is deferred are
+  written together when it ends. A write that fails cannot be reported to the caller; the
+  number of failures appears in the appender info. This is separate from the "async" setting,
+  which any appender accepts and which moves the formatting and emitting to a VAsyncLogAppender
+  thread; the two can be combined.
 */
+class VAsyncFileStream;
+
 class VFileLogAppender : public VLogAppender {
     public:
-        VFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& filePath);
+        VFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& filePath, bool asyncWrites = false);
         VFileLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults);
-        virtual ~VFileLogAppender() {}
+        virtual ~VFileLogAppender();
         virtual void addInfo(VBentoNode& infoNode) const;
     protected:
         virtual void _emitRawLine(const VString& line);
+        virtual void _flush();
     private:
         void _openFile(); // constructor helper
         VBufferedFileStream mFileStream;    ///< The underlying file stream we open and write to.
         VTextIOStream       mOutputStream;  ///< The high-level text stream we write to.
+        VAsyncFileStream*   mAsyncFile;     ///< In async mode, the stream we write to instead; otherwise NULL.
+        VString             mPendingLines;  ///< In async mode, the lines not yet handed to mAsyncFile.
 };
 
+class VRollingFileHousekeeperThread;
+
 /**
-Not yet implemented. An appender that emits to rolling log files.
-It will define several properties to control the limits on log file size
-and the lifecycle for cleaning up "old" files. I plan to define a class
-that has a global housekeeping object which all rolling file appenders register with,
-to indicate their file patterns, directories, lifetimes, and currently in use file.
-The housekeeper task will periodically remove sufficiently old files as long as they
-are not currently in use. Another approach might be to only fire a cleaning job upon
-rollover, since although a file can become old due to the passing of time, if no rollover
-occurs then there is no growth in the number of files on disk.
+An appender that emits to a series of log files in one directory, starting a new file ("rolling
+over") when the current one reaches a limit. Each file is named with the prefix and the local time
+at which it was started, for example "myapp-20140521-153012-004.log", so the names sort in the order
+the files were written. A new file is started each time the appender is constructed.
+
+Lines are written into a large in-memory buffer, which is written to the file when it fills up,
+when a message at ERROR level or more severe is emitted, and otherwise at a regular interval. There
+is no flush or fsync per line.
+
+Everything that can be slow is done on a background housekeeper thread that runs at a low priority:
+the periodic flush, compressing rolled files (when built with VAULT_ZLIB_SUPPORT), and deleting old
+files to enforce the retention limits. Rolling over itself just closes one file and opens another,
+so the thread that happens to emit the line that crosses a limit is never held up by compression or
+cleanup. When the appender starts, the housekeeper also picks up files with the same prefix left
+behind by a previous run, compressing and expiring them along with the rest.
+
+It defines the following additional properties:
+- "dir" (string)
+  Defaults to the base log directory. The directory for the log files; it is created if needed.
+- "prefix" (string)
+  Defaults to the appender name. The file name prefix.
+- "max-lines" (int)
+  Defaults to 10000. Roll over after this many lines; 0 means no line limit.
+- "max-kbytes" (int)
+  Defaults to 0. Roll over when the file reaches this many kilobytes; 0 means no size limit.
+- "roll-minutes" (int)
+  Defaults to 0. Roll over when the time crosses a multiple of this many minutes (counted in UTC
+  from the epoch, so 60 rolls on the hour); 0 means no time limit.
+- "buffer-kbytes" (int)
+  Defaults to 256. The size of the write buffer.
+- "flush-ms" (int)
+  Defaults to 1000. How often the housekeeper writes lines that have been waiting in the buffer;
+  0 means each line is written as soon as it is emitted.
+- "compress" (boolean)
+  Defaults to true. Compresses rolled files with gzip. Ignored unless built with VAULT_ZLIB_SUPPORT.
+- "max-files" (int)
+  Defaults to 0. The number of rolled files to keep, not counting the current file; 0 means no limit.
+- "max-age-hours" (int)
+  Defaults to 0. Rolled files last modified longer ago than this are deleted; 0 means no limit.
 */
 class VRollingFileLogAppender : public VLogAppender {
     public:
+
+        static const int kDefaultMaxNumLines = 10000;       ///< The default line limit per file.
+        static const int kDefaultBufferSize = 256 * 1024;   ///< The default write buffer size in bytes.
+        static const int kDefaultFlushMilliseconds = 1000;  ///< The default interval between flushes of the buffer.
+
         VRollingFileLogAppender(const VString& name, bool formatOutput, const VString& formatSpec, const VString& timeFormat, const VString& dirPath, const VString& fileNamePrefix, int maxNumLines);
         VRollingFileLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults);
-        virtual ~VRollingFileLogAppender() {}
+        /**
+        Stops the housekeeper thread, after it finishes compressing and cleaning up the files
+        rolled so far, and writes and closes the current file.
+        */
+        virtual ~VRollingFileLogAppender();
         virtual void addInfo(VBentoNode& infoNode) const;
+
+        /**
+        Sets the limits that cause a roll over. Each limit is disabled by a zero value.
+        @param  maxNumLines     the maximum number of lines per file
+        @param  maxNumBytes     the maximum file size in bytes
+        @param  rollInterval    the time interval; files roll when the time crosses a multiple of it
+        */
+        void setRollLimits(int maxNumLines, Vs64 maxNumBytes, const VDuration& rollInterval);
+        /**
+        Sets the limits on rolled files, which are applied by the housekeeper thread after each roll over.
+        Each limit is disabled by a zero value.
+        @param  maxNumFiles the number of rolled files to keep
+        @param  maxAge      rolled files older than this are deleted
+        @param  compress    true to compress rolled files (only has an effect if built with VAULT_ZLIB_SUPPORT)
+        */
+        void setRetention(int maxNumFiles, const VDuration& maxAge, bool compress);
+        /**
+        Closes the current file, hands it to the housekeeper, and starts a new file.
+        */
+        void roll();
+        /**
+        Waits until the housekeeper has finished with every file rolled so far.
+        */
+        void drainHousekeeping();
+
+        VString getCurrentFilePath();                               ///< Returns the path of the file currently being written. @return obvious
+        const VFSNode& getDirectory() const { return mDirectory; }  ///< Returns the directory containing the files. @return obvious
+        const VString& getFileNamePrefix() const { return mFileNamePrefix; } ///< Returns the file name prefix. @return obvious
+        int getNumRolls() const { return mNumRolls; }               ///< Returns the number of times the appender has rolled over. @return obvious
+
     protected:
+        /**
+        Emits the message normally, and writes the buffer to the file if the level is ERROR or more severe.
+        */
+        virtual void _emitMessage(int level, const char* file, int line, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName);
         virtual void _emitRawLine(const VString& line);
+        virtual void _flush();
+
+    private:
+
+        VRollingFileLogAppender(const VRollingFileLogAppender&); // not copyable
+        VRollingFileLogAppender& operator=(const VRollingFileLogAppender&); // not assignable
+
+        void _init(int maxNumFiles, const VDuration& maxAge, bool compress); // constructor helper; starts the housekeeper and opens the first file
+        void _openNewFile(const VInstant& now); ///< Opens a new uniquely named file and resets the counters and roll time.
+        void _roll(const VInstant& now);        ///< Closes the current file, hands it to the housekeeper, and opens a new one.
+        void _writeBuffer();                    ///< Writes the buffered lines to the file.
+        void _computeNextRollTime(const VInstant& now); ///< Sets mNextRollTime from the roll interval.
+
+        // Called on the housekeeper thread.
+        friend class VRollingFileHousekeeperThread;
+        void _flushIfStale(); ///< Locks and writes the buffer if it has been at least mFlushInterval since it was last written.
+
+        VFSNode                 mDirectory;         ///< The directory containing the files.
+        VString                 mFileNamePrefix;    ///< The prefix of every file name.
+        int                     mMaxNumLines;       ///< Roll after this many lines; 0 for no limit.
+        Vs64                    mMaxNumBytes;       ///< Roll at this file size; 0 for no limit.
+        VDuration               mRollInterval;      ///< Roll at multiples of this interval; zero for no limit.
+        Vs64                    mBufferSize;        ///< The size of the write buffer.
+        VDuration               mFlushInterval;     ///< How often waiting lines are written if the buffer doesn't fill first.
+        VDirectIOFileStream     mFileStream;        ///< The current file; written only in whole buffers.
+        VWriteBufferedStream    mBufferedStream;    ///< The write buffer.
+        VTextIOStream           mOutputStream;      ///< The text stream that lines are written to.
+        int                     mNumLines;          ///< The number of lines in the current file.
+        Vs64                    mNumBytesWritten;   ///< The number of bytes written to the current file, not counting the buffer.
+        VInstant                mNextRollTime;      ///< When the current file rolls due to the roll interval.
+        VInstant                mLastWriteTime;     ///< When the buffer was last written to the file.
+        int                     mNumRolls;          ///< The number of roll overs.
+        VRollingFileHousekeeperThread* mHousekeeper; ///< The background thread that flushes, compresses, and cleans up.
 };
 
 /**
@@ -1119,6 +1608,175 @@ class VStringVectorLogAppender : public VLogAppender {
         VStringVector mLines;
 };
 
+class VAsyncLogWriterThread;
+
+/**
+An appender that makes another appender asynchronous. Callers of emit() do not take the wrapped
+appender's mutex or do any formatting or i/o; they just capture the record (including the time
+and the thread name) into a fixed-size lock-free ring buffer and return. A single background
+writer thread takes records off the ring in batches, formats them, writes them to the wrapped
+appender under its mutex, and flushes once per batch. So a slow disk delays only the writer,
+not the threads that are logging.
+
+When the ring is full, the overflow policy determines what a caller does:
+- kOverflowBlock: wait for the writer to make room. Nothing is lost.
+- kOverflowDrop: discard the message and count it.
+- kOverflowSample: keep one in every N overflowing messages (waiting for room for it), and
+  discard and count the rest.
+Messages at ERROR level and more severe are never discarded; they always wait for room.
+When messages have been discarded, the writer emits a warning with the count.
+
+A FATAL message is not only queued; the caller waits until the writer has written and flushed it,
+along with everything queued before it. So the output of VLOGGER_FATAL_AND_THROW or a FATAL message
+logged just before an abort is on disk before the caller proceeds. The same guarantee can be had
+at any time by calling drain(), and the destructor drains the ring before stopping the writer.
+
+Any configured appender can be made asynchronous with these settings properties, which
+VLogger::installNewLogAppender() checks after instantiating the appender:
+- "async" (boolean)
+  Defaults to false. If true, the appender is wrapped in a VAsyncLogAppender of the same name.
+- "async-queue-size" (int)
+  Defaults to 8192. The number of records the ring can hold; rounded up to a power of 2.
+- "async-overflow" (string)
+  Defaults to "block". One of "block", "drop", or "sample".
+- "async-sample-rate" (int)
+  Defaults to 100. For "sample", one in this many overflowing messages is kept.
+- "async-batch-size" (int)
+  Defaults to 256. The maximum number of records written between flushes.
+The counters of queued, written, dropped, and blocked messages appear in the appender's
+VLogger info.
+*/
+class VAsyncLogAppender : public VLogAppender {
+    public:
+
+        typedef enum {
+            kOverflowBlock,     ///< A caller waits for room in the ring.
+            kOverflowDrop,      ///< A caller discards its message.
+            kOverflowSample     ///< A caller discards its message unless it's the Nth overflow, in which case it waits.
+        } OverflowPolicy;
+
+        static const int kDefaultQueueSize = 8192;  ///< The default number of records the ring can hold.
+        static const int kDefaultSampleRate = 100;  ///< The default for kOverflowSample, to keep 1 in 100 overflowing messages.
+        static const int kDefaultBatchSize = 256;   ///< The default maximum number of records written per flush.
+
+        /**
+        Returns true if the appender settings (or defaults) say the appender should be asynchronous.
+        @param  settings    the appender's settings
+        @param  defaults    the default settings for the appender's kind
+        @return true if the "async" setting is true
+        */
+        static bool isAsyncConfigured(const VSettingsNode& settings, const VSettingsNode& defaults);
+
+        /**
+        Wraps the specified appender, with the same name, and starts the writer thread.
+        @param  appender        the appender that will be written to by the writer thread
+        @param  queueSize       the number of records the ring can hold (rounded up to a power of 2)
+        @param  overflowPolicy  what to do with a message when the ring is full
+        @param  sampleRate      for kOverflowSample, one in this many overflowing messages is kept
+        @param  batchSize       the maximum number of records to write between flushes
+        */
+        VAsyncLogAppender(VLogAppenderPtr appender, int queueSize = kDefaultQueueSize, OverflowPolicy overflowPolicy = kOverflowBlock, int sampleRate = kDefaultSampleRate, int batchSize = kDefaultBatchSize);
+        /**
+        Wraps the specified appender, taking the "async-*" properties from the settings, and starts
+        the writer thread.
+        @param  appender    the appender that will be written to by the writer thread
+        @param  settings    the appender's settings
+        @param  defaults    the default settings for the appender's kind
+        */
+        VAsyncLogAppender(VLogAppenderPtr appender, const VSettingsNode& settings, const VSettingsNode& defaults);
+        /**
+        Drains the ring, and stops and deletes the writer thread.
+        */
+        virtual ~VAsyncLogAppender();
+
+        virtual void addInfo(VBentoNode& infoNode) const;
+        /**
+        Queues the record for the writer thread, applying the overflow policy if the ring is
+        full. If the level is FATAL, waits until the record has been written and flushed.
+        */
+        virtual void emit(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, const VString& actualLoggerName, bool emitRawLine, const VString& rawLine);
+
+        /**
+        Waits until everything queued so far has been written to the wrapped appender and flushed.
+        */
+        void drain();
+
+        VLogAppenderPtr getAppender() const { return mAppender; }                   ///< Returns the wrapped appender. @return obvious
+        OverflowPolicy getOverflowPolicy() const { return mOverflowPolicy; }        ///< Returns the overflow policy. @return obvious
+        int getQueueSize() const { return static_cast<int>(mCapacity); }            ///< Returns the ring capacity. @return obvious
+        Vs64 getNumQueued() const { return static_cast<Vs64>(mEnqueuePosition.load()); } ///< Returns the total number of records queued. @return obvious
+        Vs64 getNumWritten() const { return static_cast<Vs64>(mWrittenPosition.load()); } ///< Returns the total number of records written. @return obvious
+        Vs64 getNumDropped() const { return mNumDropped.load(); }                   ///< Returns the number of messages discarded because the ring was full. @return obvious
+        Vs64 getNumBlocked() const { return mNumBlocked.load(); }                   ///< Returns the number of times a caller had to wait for room in the ring. @return obvious
+
+        static VString getOverflowPolicyName(OverflowPolicy overflowPolicy);        ///< Returns "block", "drop", or "sample". @return obvious
+        static OverflowPolicy overflowPolicyFromString(const VString& name);        ///< Returns the policy named by getOverflowPolicyName(); throws VRangeException if not recognized. @return obvious
+
+    private:
+
+        VAsyncLogAppender(const VAsyncLogAppender&); // not copyable
+        VAsyncLogAppender& operator=(const VAsyncLogAppender&); // not assignable
+
+        /**
+        One slot in the ring. The sequence number tells producers and the consumer whose turn it
+        is to use the slot, as in Dmitry Vyukov's bounded MPMC queue: it equals the position when
+        the slot is free for the producer of that position, and the position plus 1 when the
+        record at that position is ready for the writer.
+        */
+        struct Cell {
+            std::atomic<Vu64>   mSequence;
+            VLogRecord          mRecord;
+        };
+
+        void _init(int queueSize); // constructor helper; allocates the ring and starts the writer thread
+        /**
+        Claims the slot for the next position if the ring is not full.
+        @param  position    set to the claimed position
+        @return the claimed slot, or NULL if the ring is full
+        */
+        Cell* _tryClaimCell(Vu64& position);
+        /**
+        Waits until a slot can be claimed.
+        @param  position    set to the claimed position
+        @return the claimed slot
+        */
+        Cell* _waitToClaimCell(Vu64& position);
+        /**
+        Waits until the writer has written and flushed the record at the specified position.
+        @param  position    the position of the record
+        */
+        void _waitUntilWritten(Vu64 position);
+        /**
+        Backs off while waiting for the writer: yields for the first few tries, then sleeps.
+        @param  numTries    the number of times the caller has already waited
+        */
+        static void _pause(int numTries);
+
+        // These are called on the writer thread.
+        friend class VAsyncLogWriterThread;
+        bool _isRecordReady() const;    ///< Returns true if the record at the dequeue position is ready for the writer.
+        int _writeBatch();              ///< Writes and releases up to mBatchSize ready records, then flushes. Returns the number written.
+        VLogRecord& _prepareDropReport(Vs64 numDropped);    ///< Fills in mDropReport with a warning about discarded messages.
+
+        VLogAppenderPtr         mAppender;          ///< The appender that the writer writes to.
+        OverflowPolicy          mOverflowPolicy;    ///< What to do with a message when the ring is full.
+        int                     mSampleRate;        ///< For kOverflowSample, one in this many overflowing messages is kept.
+        int                     mBatchSize;         ///< The maximum number of records written per flush.
+        bool                    mCaptureThreadName; ///< True if the wrapped appender's format uses the thread name.
+        Vu64                    mCapacity;          ///< The number of slots in the ring; a power of 2.
+        Vu64                    mMask;              ///< mCapacity - 1, to turn a position into a slot index.
+        Cell*                   mCells;             ///< The ring.
+        std::atomic<Vu64>       mEnqueuePosition;   ///< The next position to be claimed by a producer.
+        Vu64                    mDequeuePosition;   ///< The next position to be written; only touched by the writer.
+        std::atomic<Vu64>       mWrittenPosition;   ///< All positions before this have been written and flushed.
+        std::atomic<Vs64>       mNumDropped;        ///< The number of messages discarded because the ring was full.
+        std::atomic<Vs64>       mNumOverflowed;     ///< The number of times a caller found the ring full; drives sampling.
+        std::atomic<Vs64>       mNumBlocked;        ///< The number of times a caller waited for room in the ring.
+        Vs64                    mNumDropsReported;  ///< The value of mNumDropped when the writer last reported drops.
+        VLogRecord              mDropReport;        ///< Reused by the writer to report drops.
+        VAsyncLogWriterThread*  mWriterThread;      ///< The background thread that writes to mAppender.
+};
+
 /**
 A special logger subclass meant to be declared on the stack (not "registered") and explicitly logged
 to, which uses an embedded VStringLogAppender to capture the emitted messages to a multi-line string.
@@ -1136,6 +1794,7 @@ class VStringLogger : public VNamedLogger {
     protected:
 
         virtual void _emitToAppenders(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, bool emitRawLine, const VString& rawLine);
+        virtual void _emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload);
 
     private:
 
@@ -1162,6 +1821,7 @@ class VStringVectorLogger : public VNamedLogger {
     protected:
 
         virtual void _emitToAppenders(int level, const char* file, int line, bool emitMessage, const VString& message, const VString& specifiedLoggerName, bool emitRawLine, const VString& rawLine);
+        virtual void _emitBentoToAppenders(int level, const VString& message, const VString& specifiedLoggerName, const VBentoNode& payload);
 
     private:
 
@@ -1423,21 +1423,11 @@ VSettingsXMLParser::VSettingsXMLParser(VTextIOStream& inputStream, VSettingsNode
 }
 
 void VSettingsXMLParser::parse() {
-    bool    done = false;
-    VString line;
-
     mParserState = kReady;
 
-    while (! done) {
-        try {
-            mInputStream.readLine(mCurrentLine);
-
-            ++mCurrentLineNumber;
-
-            this->parseLine();
-        } catch (const VEOFException& /*ex*/) {
-            done = true;
-        }
+    while (mInputStream.tryReadLine(mCurrentLine)) {
+        ++mCurrentLineNumber;
+        this->parseLine();
     }
 }
 
@@ -9,11 +9,23 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vfsnodeunit.h"
 
+#include "vasyncfilestream.h"
+#include "vbento.h"
 #include "vbinaryiostream.h"
 #include "vbufferedfilestream.h"
 #include "vdirectiofilestream.h"
 #include "vexception.h"
+#include "vfilewriter.h"
+#include "vlogger.h"
+#include "vmappedfilestream.h"
+#include "vmemorystream.h"
+#include "vsettings.h"
+#include "vsocket.h"
+#include "vsocketstream.h"
+#include "vstreamcopier.h"
 #include "vtextiostream.h"
+#include "vthreadpool.h"
+#include "vmutexlocker.h"
 
 // VFSNodeIterateTestCallback -----------------------------------------------------
 
@@ -28,6 +40,132 @@ class VFSNodeIterateTestCallback : public VDirectoryIterationCallback {
         VStringVector mNodeNames;
 };
 
+// VFSNodeWalkTestCallback --------------------------------------------------------
+
+class VFSNodeWalkTestCallback : public VDirectoryWalkCallback {
+    public:
+
+        VFSNodeWalkTestCallback(int maxEntries = -1, const VString& throwOnName = VString::EMPTY()) :
+            mMutex("VFSNodeWalkTestCallback", true), mPaths(), mNumFiles(0), mNumDirectories(0),
+            mTotalFileSize(0), mMaxDepth(0), mMaxEntries(maxEntries), mThrowOnName(throwOnName) {}
+        virtual ~VFSNodeWalkTestCallback() {}
+
+        virtual bool handleWalkEntry(const VDirectoryWalkEntry& entry);
+
+        VMutex          mMutex; // the callback is called concurrently when walking on a pool
+        VStringVector   mPaths;
+        int             mNumFiles;
+        int             mNumDirectories;
+        VFSize          mTotalFileSize;
+        int             mMaxDepth;
+        int             mMaxEntries;
+        VString         mThrowOnName;
+};
+
+bool VFSNodeWalkTestCallback::handleWalkEntry(const VDirectoryWalkEntry& entry) {
+    if (mThrowOnName == entry.getName()) {
+        throw VException(VSTRING_FORMAT("Test exception on '%s'.", entry.getName()));
+    }
+
+    VMutexLocker locker(&mMutex, "VFSNodeWalkTestCallback::handleWalkEntry");
+    mPaths.push_back(entry.getPath());
+    if (entry.isFile()) {
+        ++mNumFiles;
+        mTotalFileSize += entry.getInfo().mFileSize;
+    } else if (entry.isDirectory()) {
+        ++mNumDirectories;
+    }
+
+    mMaxDepth = V_MAX(mMaxDepth, entry.getDepth());
+    return (mMaxEntries < 0) || (static_cast<int>(mPaths.size()) < mMaxEntries);
+}
+
+// VFSNodeWalkTestTask ------------------------------------------------------------
+
+/**
+A pool task that walks a directory and copies it, handing both the pool it is running on.
+*/
+class VFSNodeWalkTestTask : public VThreadPoolTask {
+    public:
+
+        VFSNodeWalkTestTask(const VFSNode& walkRoot, const VFSNode& copyDir, VThreadPool& pool) :
+            VThreadPoolTask("VFSNodeWalkTestTask"), mWalkRoot(walkRoot), mCopyDir(copyDir), mPool(pool), mCallback() {}
+        virtual ~VFSNodeWalkTestTask() {}
+
+        virtual void run() {
+            mWalkRoot.walk(mCallback, false, &mPool);
+            VFSNode::copyDirectory(mWalkRoot, mCopyDir, true, &mPool);
+        }
+
+        VFSNode                 mWalkRoot;
+        VFSNode                 mCopyDir;
+        VThreadPool&            mPool;
+        VFSNodeWalkTestCallback mCallback;
+
+    private:
+
+        VFSNodeWalkTestTask(const VFSNodeWalkTestTask&); // not copyable
+        VFSNodeWalkTestTask& operator=(const VFSNodeWalkTestTask&); // not assignable
+};
+
+// VFSNodeAsyncTestRequest --------------------------------------------------------
+
+class VFSNodeAsyncTestRequest : public VAsyncFileRequest {
+    public:
+
+        VFSNodeAsyncTestRequest(Operation operation, Vu8* buffer, Vs64 offset, Vs64 length, std::atomic<int>& numCompleted, const VDuration& completionDelay = VDuration::ZERO()) :
+            VAsyncFileRequest(operation, buffer, offset, length), mNumCompleted(numCompleted), mCompletionDelay(completionDelay) {}
+        virtual ~VFSNodeAsyncTestRequest() {}
+
+        virtual void completed() {
+            // A delay here holds off the request's waiters, so that they are all blocked when it completes.
+            if (mCompletionDelay != VDuration::ZERO()) {
+                VThread::sleep(mCompletionDelay);
+            }
+
+            ++mNumCompleted;
+        }
+
+    private:
+
+        std::atomic<int>&   mNumCompleted;
+        VDuration           mCompletionDelay;
+};
+
+// VFSNodeAsyncWaitThread ---------------------------------------------------------
+
+/**
+Waits for an asynchronous request to complete, or if given no request, for the stream to have none outstanding.
+*/
+class VFSNodeAsyncWaitThread : public VThread {
+    public:
+
+        VFSNodeAsyncWaitThread(VAsyncFileStream& stream, VAsyncFileRequestPtr request) :
+            VThread("VFSNodeAsyncWaitThread", "vault.files.VFSNodeAsyncWaitThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mStream(stream), mRequest(request), mCompleted(false) {}
+        virtual ~VFSNodeAsyncWaitThread() {}
+
+        virtual void run() {
+            if (mRequest == nullptr) {
+                mStream.waitForAll();
+                mCompleted = true;
+            } else {
+                mCompleted = mRequest->waitUntilCompleted(VDuration::MINUTE());
+            }
+        }
+
+        bool sawCompletion() const { return mCompleted; }
+
+    private:
+
+        VFSNodeAsyncWaitThread(const VFSNodeAsyncWaitThread&); // not copyable
+        VFSNodeAsyncWaitThread& operator=(const VFSNodeAsyncWaitThread&); // not assignable
+
+        VAsyncFileStream&       mStream;
+        VAsyncFileRequestPtr    mRequest;
+        volatile bool           mCompleted;
+};
+
 // VFSNodeUnit -------------------------------------------------------------
 
 VFSNodeUnit::VFSNodeUnit(bool logOnSuccess, bool throwOnError) :
@@ -87,6 +225,12 @@ void VFSNodeUnit::run() {
     (void) testTextFileNode.rm();
     VUNIT_ASSERT_FALSE_LABELED(testTextFileNode.exists(), "unbuffered text file removed");
 
+    VMappedFileStream mtfs(testTextFileNode);
+    this->_testTextFileIO("starting Mapped Text IO tests", testTextFileNode, mtfs);
+    this->_testTextFileReadAll(testTextFileNode);
+    (void) testTextFileNode.rm();
+    VUNIT_ASSERT_FALSE_LABELED(testTextFileNode.exists(), "mapped text file removed");
+
     VFSNode testBinaryFileNode(testDirDeeper, "test_binary_file");
 
     VBufferedFileStream bbfs(testBinaryFileNode);
@@ -99,6 +243,13 @@ void VFSNodeUnit::run() {
     (void) testBinaryFileNode.rm();
     VUNIT_ASSERT_FALSE_LABELED(testBinaryFileNode.exists(), "unbuffered binary file removed");
 
+    VMappedFileStream mbfs(testBinaryFileNode);
+    this->_testBinaryFileIO("starting Mapped Binary IO tests", testBinaryFileNode, mbfs);
+    this->_testMappedFileStreamCopy(testBinaryFileNode);
+    this->_testFileToSocketStreamCopy(testBinaryFileNode);
+    (void) testBinaryFileNode.rm();
+    VUNIT_ASSERT_FALSE_LABELED(testBinaryFileNode.exists(), "mapped binary file removed");
+
     this->_testDirectoryIteration(testDirDeeper);
 
     // Next, test all flavors of renaming operations.
@@ -160,6 +311,10 @@ void VFSNodeUnit::run() {
         VUNIT_ASSERT_SUCCESS("Recursive nested copy threw an exception as expected");
     }
 
+    this->_testDirectoryWalk(tempDir);
+    this->_testSafeOverwrite(tempDir);
+    this->_testAsyncFileStream(tempDir);
+
     // Clean up our litter.
     (void) copyTest5.rm();
     (void) dirCopyTarget.rm();
@@ -350,6 +505,107 @@ void VFSNodeUnit::_testBinaryFileIO(const VString& seriesLabel, VFSNode& node, V
     fileStream.close();
 }
 
+void VFSNodeUnit::_testMappedFileStreamCopy(VFSNode& node) {
+    // Copy a memory stream bigger than the initial writable mapping into a mapped file
+    // and back out again, so that streamCopy() goes buffer-to-buffer in both directions
+    // and the mapping has to grow.
+    const Vs64 kDataLength = CONST_S64(200000);
+    VMemoryStream source;
+    for (Vs64 i = 0; i < kDataLength; ++i) {
+        Vu8 b = static_cast<Vu8>(i % 251);
+        (void) source.write(&b, 1);
+    }
+
+    source.seek0();
+
+    VMappedFileStream writer(node, VMappedFileStream::kAccessSequential);
+    writer.openWrite();
+    Vs64 numBytesCopied = VStream::streamCopy(source, writer, kDataLength);
+    writer.close();
+    VUNIT_ASSERT_EQUAL_LABELED(numBytesCopied, kDataLength, "mapped file copy in");
+    VUNIT_ASSERT_EQUAL_LABELED(static_cast<Vs64>(node.size()), kDataLength, "mapped file truncated to data length");
+
+    VMappedFileStream reader(node, VMappedFileStream::kAccessRandom);
+    reader.openReadOnly();
+    VUNIT_ASSERT_EQUAL_LABELED(reader.available(), kDataLength, "mapped file available");
+    VMemoryStream target;
+    numBytesCopied = VStream::streamCopy(reader, target, kDataLength + 100);
+    VUNIT_ASSERT_EQUAL_LABELED(numBytesCopied, kDataLength, "mapped file copy out");
+    VUNIT_ASSERT_TRUE_LABELED(source == target, "mapped file copy content");
+
+    VUNIT_ASSERT_TRUE_LABELED(reader.seek(-10, SEEK_END), "mapped file seek from end");
+    VUNIT_ASSERT_EQUAL_LABELED(reader.available(), CONST_S64(10), "mapped file available after seek");
+    VUNIT_ASSERT_FALSE_LABELED(reader.seek(20, SEEK_CUR), "mapped file read-only seek past end");
+
+    try {
+        Vu8 b = 0;
+        (void) reader.write(&b, 1);
+        VUNIT_ASSERT_FAILURE("write to read-only mapped file");
+    } catch (const VException& /*ex*/) {
+        VUNIT_ASSERT_SUCCESS("write to read-only mapped file");
+    }
+
+    reader.close();
+}
+
+void VFSNodeUnit::_testFileToSocketStreamCopy(VFSNode& node) {
+#ifdef VPLATFORM_WIN
+    (void) node; // No socketpair() on Windows; and streamCopy() doesn't use sendfile() there anyway.
+#else
+    // Copy file data to one end of a connected socket pair, where it will take the sendfile() path, and read it back from the other end.
+    const int kDataLength = 100000;
+    const int kHeaderLength = 10;
+    const int kFirstCopyLength = 50000;
+    const int kSecondCopyLength = kDataLength - kHeaderLength - kFirstCopyLength;
+    Vu8* data = new Vu8[kDataLength];
+    Vu8* received = new Vu8[kDataLength];
+    for (int i = 0; i < kDataLength; ++i) {
+        data[i] = static_cast<Vu8>(i % 253);
+    }
+
+    VDirectIOFileStream writer(node);
+    writer.openWrite();
+    (void) writer.write(data, kDataLength);
+    writer.close();
+
+    int socketIDs[2];
+    VUNIT_ASSERT_EQUAL_LABELED(::socketpair(AF_UNIX, SOCK_STREAM, 0, socketIDs), 0, "socketpair");
+    VSocket sendingSocket(socketIDs[0]);
+    VSocket receivingSocket(socketIDs[1]);
+    VSocketStream sendingStream(&sendingSocket, "sendfile test");
+
+    // Unbuffered file, starting part way into the file, so the source offset matters.
+    VDirectIOFileStream directReader(node);
+    directReader.openReadOnly();
+    (void) directReader.skip(kHeaderLength);
+    Vs64 numBytesCopied = VStream::streamCopy(directReader, sendingStream, kFirstCopyLength);
+    VUNIT_ASSERT_EQUAL_LABELED(numBytesCopied, static_cast<Vs64>(kFirstCopyLength), "file to socket copy");
+    VUNIT_ASSERT_EQUAL_LABELED(directReader.getIOOffset(), static_cast<Vs64>(kHeaderLength + kFirstCopyLength), "file offset after file to socket copy");
+    VUNIT_ASSERT_EQUAL_LABELED(sendingSocket.numBytesWritten(), static_cast<Vs64>(kFirstCopyLength), "socket byte count after file to socket copy");
+    (void) receivingSocket.read(received, kFirstCopyLength);
+    VUNIT_ASSERT_TRUE_LABELED(::memcmp(received, data + kHeaderLength, kFirstCopyLength) == 0, "file to socket copy content");
+    directReader.close();
+
+    // Buffered file, copied in chunks until end of file, after having read from the FILE so its buffer is in use.
+    VBufferedFileStream bufferedReader(node);
+    bufferedReader.openReadOnly();
+    (void) bufferedReader.read(received, kHeaderLength);
+    (void) bufferedReader.seek(kHeaderLength + kFirstCopyLength, SEEK_SET);
+    VStreamCopier copier(16384, &bufferedReader, &sendingStream);
+    while (copier.copyChunk()) {
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(copier.numBytesCopied(), static_cast<Vs64>(kSecondCopyLength), "chunked file to socket copy");
+    VUNIT_ASSERT_EQUAL_LABELED(bufferedReader.getIOOffset(), static_cast<Vs64>(kDataLength), "file offset after chunked file to socket copy");
+    VUNIT_ASSERT_EQUAL_LABELED(sendingSocket.numBytesWritten(), static_cast<Vs64>(kFirstCopyLength + kSecondCopyLength), "socket byte count after chunked file to socket copy");
+    (void) receivingSocket.read(received, kSecondCopyLength);
+    VUNIT_ASSERT_TRUE_LABELED(::memcmp(received, data + kHeaderLength + kFirstCopyLength, kSecondCopyLength) == 0, "chunked file to socket copy content");
+    bufferedReader.close();
+
+    delete [] data;
+    delete [] received;
+#endif
+}
+
 void VFSNodeUnit::_testDirectoryIteration(const VFSNode& dir) {
     const int NUM_FILES_TO_CREATE = 5;
     const int NUM_FILES_TO_CHECK = NUM_FILES_TO_CREATE + 3; // we'll verify we don't have these extras
@@ -427,6 +683,456 @@ void VFSNodeUnit::_testDirectoryIteration(const VFSNode& dir) {
 
 }
 
+void VFSNodeUnit::_testDirectoryWalk(const VFSNode& tempDir) {
+    const int NUM_DIRECTORIES_PER_LEVEL = 4;
+    const int NUM_FILES_PER_DIRECTORY = 5;
+    const int NUM_DIRECTORIES = NUM_DIRECTORIES_PER_LEVEL + (NUM_DIRECTORIES_PER_LEVEL * NUM_DIRECTORIES_PER_LEVEL);
+    const int NUM_FILES = 1 + (NUM_DIRECTORIES_PER_LEVEL * NUM_DIRECTORIES_PER_LEVEL * NUM_FILES_PER_DIRECTORY);
+    const VFSize TOTAL_FILE_SIZE = 7 + (NUM_DIRECTORIES_PER_LEVEL * NUM_DIRECTORIES_PER_LEVEL * (10 + 20 + 30 + 40 + 50));
+
+    // Build a tree two directories deep, with files of known sizes at the bottom, and one file at the top.
+    VFSNode walkRoot(tempDir, "vfsnodetest_walk");
+    (void) walkRoot.rm();
+    std::vector<VFSNode> files;
+    files.push_back(VFSNode(walkRoot, "top.dat"));
+    for (int i = 0; i < NUM_DIRECTORIES_PER_LEVEL; ++i) {
+        for (int j = 0; j < NUM_DIRECTORIES_PER_LEVEL; ++j) {
+            VFSNode dir(walkRoot, VSTRING_FORMAT("a%d/b%d", i, j));
+            dir.mkdirs();
+            for (int k = 0; k < NUM_FILES_PER_DIRECTORY; ++k) {
+                files.push_back(VFSNode(dir, VSTRING_FORMAT("f%d.dat", k)));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        int fileSize = (i == 0) ? 7 : static_cast<int>(10 * (1 + ((i - 1) % NUM_FILES_PER_DIRECTORY)));
+        VBufferedFileStream fileStream(files[i]);
+        fileStream.openWrite();
+        VBinaryIOStream out(fileStream);
+        for (int j = 0; j < fileSize; ++j) {
+            out.writeU8(static_cast<Vu8>(j));
+        }
+        out.flush();
+        fileStream.close();
+    }
+
+    // Serially, with node info.
+    VFSNodeWalkTestCallback serialCallback;
+    walkRoot.walk(serialCallback, true);
+    VUNIT_ASSERT_EQUAL_LABELED(serialCallback.mNumFiles, NUM_FILES, "serial walk files");
+    VUNIT_ASSERT_EQUAL_LABELED(serialCallback.mNumDirectories, NUM_DIRECTORIES, "serial walk directories");
+    VUNIT_ASSERT_EQUAL_LABELED(serialCallback.mTotalFileSize, TOTAL_FILE_SIZE, "serial walk file sizes");
+    VUNIT_ASSERT_EQUAL_LABELED(serialCallback.mMaxDepth, 2, "serial walk depth");
+    VUNIT_ASSERT_TRUE_LABELED(std::find(serialCallback.mPaths.begin(), serialCallback.mPaths.end(), files[1].getPath()) != serialCallback.mPaths.end(), "serial walk entry path");
+    std::sort(serialCallback.mPaths.begin(), serialCallback.mPaths.end());
+
+    // Serially, without node info: the types are still known.
+    VFSNodeWalkTestCallback typesOnlyCallback;
+    walkRoot.walk(typesOnlyCallback);
+    VUNIT_ASSERT_EQUAL_LABELED(typesOnlyCallback.mNumFiles, NUM_FILES, "types-only walk files");
+    VUNIT_ASSERT_EQUAL_LABELED(typesOnlyCallback.mNumDirectories, NUM_DIRECTORIES, "types-only walk directories");
+
+    // The callback can end the walk.
+    VFSNodeWalkTestCallback stoppingCallback(3);
+    walkRoot.walk(stoppingCallback);
+    VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(stoppingCallback.mPaths.size()), 3, "stopped walk");
+
+    VThreadPool pool("vfsnodetest-walk", 4);
+    pool.start();
+
+    // On a pool, the same nodes are found.
+    VFSNodeWalkTestCallback poolCallback;
+    walkRoot.walk(poolCallback, true, &pool);
+    VUNIT_ASSERT_EQUAL_LABELED(poolCallback.mNumFiles, NUM_FILES, "pool walk files");
+    VUNIT_ASSERT_EQUAL_LABELED(poolCallback.mNumDirectories, NUM_DIRECTORIES, "pool walk directories");
+    VUNIT_ASSERT_EQUAL_LABELED(poolCallback.mTotalFileSize, TOTAL_FILE_SIZE, "pool walk file sizes");
+    std::sort(poolCallback.mPaths.begin(), poolCallback.mPaths.end());
+    VUNIT_ASSERT_TRUE_LABELED(poolCallback.mPaths == serialCallback.mPaths, "pool walk paths");
+
+    // A callback exception ends the walk, wherever it was thrown.
+    try {
+        VFSNodeWalkTestCallback throwingCallback(-1, "f3.dat");
+        walkRoot.walk(throwingCallback, false, &pool);
+        VUNIT_ASSERT_FAILURE("Walk callback exception was not propagated");
+    } catch (const VException& /*ex*/) {
+        VUNIT_ASSERT_SUCCESS("Walk callback exception was propagated");
+    }
+
+    // Copying on the pool.
+    VFSNode walkCopy(tempDir, "vfsnodetest_walk_copy");
+    (void) walkCopy.rm();
+    VFSNode::copyDirectory(walkRoot, walkCopy, true, &pool);
+    VFSNodeWalkTestCallback copyCallback;
+    walkCopy.walk(copyCallback, true);
+    VUNIT_ASSERT_EQUAL_LABELED(copyCallback.mNumFiles, NUM_FILES, "pool copy files");
+    VUNIT_ASSERT_EQUAL_LABELED(copyCallback.mNumDirectories, NUM_DIRECTORIES, "pool copy directories");
+    VUNIT_ASSERT_EQUAL_LABELED(copyCallback.mTotalFileSize, TOTAL_FILE_SIZE, "pool copy file sizes");
+
+    pool.stop();
+
+    // Walking and copying from a task on a one-worker pool, handing it that pool, must not wait on the pool.
+    VThreadPool singlePool("vfsnodetest-walk-single", 1);
+    singlePool.start();
+    VFSNode taskCopy(tempDir, "vfsnodetest_walk_task_copy");
+    (void) taskCopy.rm();
+    VFSNodeWalkTestTask* walkTask = new VFSNodeWalkTestTask(walkRoot, taskCopy, singlePool);
+    VThreadPoolTaskPtr walkTaskPtr(walkTask);
+    singlePool.submit(walkTaskPtr);
+    VUNIT_ASSERT_TRUE_LABELED(walkTaskPtr->waitUntilCompleted(30 * VDuration::SECOND()), "walk from own pool task completes");
+    VUNIT_ASSERT_FALSE_LABELED(walkTaskPtr->hasFailed(), "walk from own pool task succeeds");
+    VUNIT_ASSERT_EQUAL_LABELED(walkTask->mCallback.mNumFiles, NUM_FILES, "walk from own pool task files");
+    VFSNodeWalkTestCallback taskCopyCallback;
+    taskCopy.walk(taskCopyCallback);
+    VUNIT_ASSERT_EQUAL_LABELED(taskCopyCallback.mNumFiles, NUM_FILES, "copy from own pool task files");
+    singlePool.stop();
+    (void) taskCopy.rm();
+
+#ifndef VPLATFORM_WIN
+    // A link to a directory is reported as a directory but not descended into, so a link back up cannot loop.
+    VFSNode loopLink(walkRoot, "a0/b0/loop");
+    VUNIT_ASSERT_EQUAL_LABELED(::symlink(walkRoot.getPath().chars(), loopLink.getPath().chars()), 0, "create loop link");
+    VFSNodeWalkTestCallback linkCallback;
+    walkRoot.walk(linkCallback);
+    VUNIT_ASSERT_EQUAL_LABELED(linkCallback.mNumFiles, NUM_FILES, "walk with loop link files");
+    VUNIT_ASSERT_EQUAL_LABELED(linkCallback.mNumDirectories, NUM_DIRECTORIES + 1, "walk with loop link directories");
+
+    // A copy follows a link to a directory outside the tree, but copies the loop link as an empty directory.
+    VFSNode linkedDir(tempDir, "vfsnodetest_walk_linked");
+    (void) linkedDir.rm();
+    VFSNode(linkedDir, "sub").mkdirs();
+    VFSNode linkedFile(linkedDir, "sub/linked.dat");
+    {
+        VBufferedFileStream fileStream(linkedFile);
+        fileStream.openWrite();
+        VBinaryIOStream out(fileStream);
+        out.writeS32(1);
+        out.flush();
+        fileStream.close();
+    }
+    VFSNode outsideLink(walkRoot, "a1/outside");
+    VUNIT_ASSERT_EQUAL_LABELED(::symlink(linkedDir.getPath().chars(), outsideLink.getPath().chars()), 0, "create outside link");
+    VFSNode linkCopy(tempDir, "vfsnodetest_walk_link_copy");
+    (void) linkCopy.rm();
+    VFSNode::copyDirectory(walkRoot, linkCopy, true);
+    VFSNodeWalkTestCallback linkCopyCallback;
+    linkCopy.walk(linkCopyCallback, true);
+    VUNIT_ASSERT_EQUAL_LABELED(linkCopyCallback.mNumFiles, NUM_FILES + 1, "copy with links files");
+    VUNIT_ASSERT_EQUAL_LABELED(linkCopyCallback.mNumDirectories, NUM_DIRECTORIES + 3, "copy with links directories");
+    VUNIT_ASSERT_TRUE_LABELED(VFSNode(linkCopy, "a1/outside/sub/linked.dat").isFile(), "copy with links followed outside link");
+    VUNIT_ASSERT_TRUE_LABELED(VFSNode(linkCopy, "a0/b0/loop").isDirectory(), "copy with links copied loop link");
+    VUNIT_ASSERT_FALSE_LABELED(VFSNode(linkCopy, "a0/b0/loop/top.dat").exists(), "copy with links did not follow loop link");
+
+    (void) ::unlink(outsideLink.getPath().chars());
+    (void) ::unlink(loopLink.getPath().chars());
+    (void) linkCopy.rm();
+    (void) linkedDir.rm();
+#endif
+
+    try {
+        VFSNodeWalkTestCallback missingCallback;
+        VFSNode(walkRoot, "missing").walk(missingCallback);
+        VUNIT_ASSERT_FAILURE("Walk of missing directory did not throw");
+    } catch (const VException& /*ex*/) {
+        VUNIT_ASSERT_SUCCESS("Walk of missing directory threw");
+    }
+
+    (void) walkCopy.rm();
+    (void) walkRoot.rm();
+}
+
+void VFSNodeUnit::_testSafeOverwrite(const VFSNode& tempDir) {
+    VFSNode overwriteDir(tempDir, "vfsnodetest_overwrite");
+    (void) overwriteDir.rm();
+    overwriteDir.mkdirs();
+
+    // A source file big enough to take several passes of any copy loop.
+    const int SOURCE_SIZE = 3 * 1024 * 1024 + 17;
+    VFSNode sourceNode(overwriteDir, "source.dat");
+    {
+        VMemoryStream sourceData;
+        VBinaryIOStream sourceOut(sourceData);
+        for (int i = 0; i < SOURCE_SIZE; ++i) {
+            sourceOut.writeU8(static_cast<Vu8>(i * 7));
+        }
+
+        sourceData.seek0();
+        VBinaryIOStream sourceIn(sourceData);
+        VFSNode::safelyOverwriteFile(sourceNode, sourceData.getEOFOffset(), sourceIn);
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(sourceNode.size(), static_cast<VFSize>(SOURCE_SIZE), "overwrite from memory size");
+
+    // Copy over an existing, larger, file, flushing to disk.
+    VFSNode copyNode(overwriteDir, "copy.dat");
+    {
+        VFileWriter writer(copyNode);
+        for (int i = 0; i < SOURCE_SIZE + 1000; ++i) {
+            writer.getBinaryOutputStream().writeU8(0xFF);
+        }
+        writer.save(true);
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(copyNode.size(), static_cast<VFSize>(SOURCE_SIZE + 1000), "file writer size");
+
+    VFSNode::copyFile(sourceNode, copyNode, true);
+    VUNIT_ASSERT_EQUAL_LABELED(copyNode.size(), static_cast<VFSize>(SOURCE_SIZE), "copy size");
+    {
+        VBufferedFileStream sourceStream(sourceNode);
+        sourceStream.openReadOnly();
+        VBufferedFileStream copyStream(copyNode);
+        copyStream.openReadOnly();
+        VBinaryIOStream sourceIn(sourceStream);
+        VBinaryIOStream copyIn(copyStream);
+        bool contentsMatch = true;
+        for (int i = 0; (i < SOURCE_SIZE) && contentsMatch; ++i) {
+            contentsMatch = (sourceIn.readU8() == copyIn.readU8());
+        }
+        VUNIT_ASSERT_TRUE_LABELED(contentsMatch, "copy contents");
+    }
+
+    // Copying an empty file.
+    VFSNode emptyNode(overwriteDir, "empty.dat");
+    {
+        VFileWriter writer(emptyNode);
+        writer.save();
+    }
+    VFSNode::copyFile(emptyNode, copyNode);
+    VUNIT_ASSERT_TRUE_LABELED(copyNode.exists() && (copyNode.size() == 0), "copy empty file");
+
+    // Keeping the old file.
+    {
+        VFileWriter writer(copyNode);
+        writer.getTextOutputStream().writeLine("kept");
+        writer.save();
+    }
+    VFSNode::copyFile(sourceNode, copyNode);
+    {
+        VMemoryStream newData;
+        VBinaryIOStream newOut(newData);
+        newOut.writeS32(42);
+        newData.seek0();
+        VBinaryIOStream newIn(newData);
+        VFSNode::safelyOverwriteFile(copyNode, newData.getEOFOffset(), newIn, true);
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(copyNode.size(), static_cast<VFSize>(4), "overwrite keeping old size");
+
+    // Nothing is left behind but our files and the kept one.
+    VStringVector names;
+    overwriteDir.list(names);
+    int numKept = 0;
+    int numTemporary = 0;
+    for (VStringVector::const_iterator i = names.begin(); i != names.end(); ++i) {
+        if (i->contains("_ver_copy.dat")) {
+            ++numKept;
+            VUNIT_ASSERT_EQUAL_LABELED(VFSNode(overwriteDir, *i).size(), static_cast<VFSize>(SOURCE_SIZE), "kept old file size");
+        } else if (i->contains("_tmp_")) {
+            ++numTemporary;
+        }
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(numKept, 1, "kept old file");
+    VUNIT_ASSERT_EQUAL_LABELED(numTemporary, 0, "no temporary files left");
+    VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(names.size()), 4, "directory contents after overwrites");
+
+    (void) overwriteDir.rm();
+}
+
+void VFSNodeUnit::_testAsyncFileStream(const VFSNode& tempDir) {
+    VFSNode asyncDir(tempDir, "vfsnodetest_async");
+    (void) asyncDir.rm();
+    asyncDir.mkdirs();
+
+    VThreadPool pool("vfsnodetest_async", 2);
+    pool.start();
+
+    this->_testAsyncFileStreamIO("async default", VFSNode(asyncDir, "default.dat"), NULL, false);
+    this->_testAsyncFileStreamIO("async direct", VFSNode(asyncDir, "direct.dat"), NULL, true);
+    this->_testAsyncFileStreamIO("async pool", VFSNode(asyncDir, "pool.dat"), &pool, false);
+    this->_testAsyncFileStreamIO("async pool direct", VFSNode(asyncDir, "pooldirect.dat"), &pool, true);
+
+    pool.stop();
+
+    // A file writer saving in the background.
+    VFSNode savedNode(asyncDir, "saved.txt");
+    VThreadPoolTaskPtr saveTask;
+    {
+        VFileWriter writer(savedNode);
+        writer.getTextOutputStream().writeLine("saved in the background");
+        saveTask = writer.saveAsync(true);
+    } // the writer is gone before the save completes, most likely
+    saveTask->waitUntilCompleted();
+    VUNIT_ASSERT_FALSE_LABELED(saveTask->hasFailed(), "file writer save async");
+    VUNIT_ASSERT_EQUAL_LABELED(savedNode.size(), static_cast<VFSize>(VString("saved in the background").length() + VString::NATIVE_LINE_ENDING().length()), "file writer save async size");
+
+    // A file appender writing asynchronously.
+    VFSNode logNode(asyncDir, "async.log");
+    const int NUM_LOG_LINES = 500;
+    {
+        VFileLogAppender appender("vfsnodetest_async", false, VString::EMPTY(), VString::EMPTY(), logNode.getPath(), true);
+        for (int i = 0; i < NUM_LOG_LINES; ++i) {
+            appender.emitRaw(VSTRING_FORMAT("line %d", i));
+        }
+    } // the destructor waits for the writes
+    {
+        VBufferedFileStream logStream(logNode);
+        logStream.openReadOnly();
+        VTextIOStream logIn(logStream);
+        VString line;
+        logIn.readLine(line); // the appender starts each run with an empty line
+        bool linesInOrder = line.isEmpty();
+        for (int i = 0; (i < NUM_LOG_LINES) && linesInOrder; ++i) {
+            logIn.readLine(line);
+            linesInOrder = (line == VSTRING_FORMAT("line %d", i));
+        }
+        VUNIT_ASSERT_TRUE_LABELED(linesInOrder, "async file appender lines in order");
+    }
+
+    // The file appender's "async-io" setting must not be mistaken for the "async" setting that
+    // wraps an appender in a VAsyncLogAppender.
+    {
+        VString settingsText(VSTRING_FORMAT("<appender name=\"vfsnodetest_async_io\" kind=\"file\" path=\"%s\" async-io=\"true\" />", logNode.getPath().chars()));
+        VMemoryStream buf(settingsText.getDataBuffer(), VMemoryStream::kAllocatedByOperatorNew, false, settingsText.length(), settingsText.length());
+        VTextIOStream in(buf);
+        VSettings settings(in);
+        VSettings emptyDefaults;
+        const VSettingsNode& appenderSettings = *settings.findNode("appender");
+
+        VUNIT_ASSERT_FALSE_LABELED(VAsyncLogAppender::isAsyncConfigured(appenderSettings, emptyDefaults), "async-io setting not async appender");
+        VFileLogAppender appender(appenderSettings, emptyDefaults);
+        VBentoNode info;
+        appender.addInfo(info);
+        VUNIT_ASSERT_TRUE_LABELED(info.getBool("async-io"), "async-io setting file appender");
+    }
+
+    (void) asyncDir.rm();
+}
+
+void VFSNodeUnit::_testAsyncFileStreamIO(const VString& seriesLabel, const VFSNode& node, VThreadPool* pool, bool directIO) {
+    const int BLOCK_SIZE = VAsyncFileStream::kDirectIOAlignment;
+    const int NUM_BLOCKS = 64;
+    const Vs64 FILE_SIZE = static_cast<Vs64>(BLOCK_SIZE) * NUM_BLOCKS;
+
+    Vu8* data = VAsyncFileStream::allocateAlignedBuffer(FILE_SIZE);
+    Vu8* readBack = VAsyncFileStream::allocateAlignedBuffer(FILE_SIZE);
+    for (Vs64 i = 0; i < FILE_SIZE; ++i) {
+        data[i] = static_cast<Vu8>((i * 13) + (i / BLOCK_SIZE));
+    }
+
+    {
+        VAsyncFileStream file(node, pool);
+        file.setDirectIO(directIO);
+        file.openWrite();
+        VUNIT_ASSERT_TRUE_LABELED(pool == NULL || VString(file.getEngineName()) == "thread pool", VSTRING_FORMAT("%s engine", seriesLabel.chars()));
+
+        // Write the blocks as one batch, in reverse order, each calling back when it completes.
+        std::atomic<int> numCompleted(0);
+        VAsyncFileRequestList writes;
+        for (int i = NUM_BLOCKS - 1; i >= 0; --i) {
+            writes.push_back(VAsyncFileRequestPtr(new VFSNodeAsyncTestRequest(VAsyncFileRequest::kWrite, data + (i * BLOCK_SIZE), static_cast<Vs64>(i) * BLOCK_SIZE, BLOCK_SIZE, numCompleted)));
+        }
+        file.submitBatch(writes);
+        file.waitForAll();
+        VUNIT_ASSERT_EQUAL_LABELED(numCompleted.load(), NUM_BLOCKS, VSTRING_FORMAT("%s write callbacks", seriesLabel.chars()));
+        bool allWritten = true;
+        for (VAsyncFileRequestList::const_iterator i = writes.begin(); i != writes.end(); ++i) {
+            allWritten = allWritten && (*i)->isCompleted() && ! (*i)->hasFailed() && ((*i)->getNumBytesTransferred() == BLOCK_SIZE);
+        }
+        VUNIT_ASSERT_TRUE_LABELED(allWritten, VSTRING_FORMAT("%s batch writes", seriesLabel.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(file.getNumOutstanding(), 0, VSTRING_FORMAT("%s none outstanding", seriesLabel.chars()));
+
+        VAsyncFileRequestPtr syncRequest = file.sync();
+        syncRequest->waitUntilCompleted();
+        VUNIT_ASSERT_FALSE_LABELED(syncRequest->hasFailed(), VSTRING_FORMAT("%s sync", seriesLabel.chars()));
+
+        // Completing a request wakes every thread waiting for it, and for the stream to be idle. On Windows,
+        // which only has the thread pool engine, this is the path every request takes.
+        {
+            VAsyncFileRequestPtr slowWrite(new VFSNodeAsyncTestRequest(VAsyncFileRequest::kWrite, data, 0, BLOCK_SIZE, numCompleted, 100 * VDuration::MILLISECOND()));
+            file.submitBatch(VAsyncFileRequestList(1, slowWrite));
+
+            std::vector<VFSNodeAsyncWaitThread*> waiters;
+            for (int i = 0; i < 4; ++i) {
+                waiters.push_back(new VFSNodeAsyncWaitThread(file, (i == 0) ? VAsyncFileRequestPtr() : slowWrite));
+                waiters.back()->start();
+            }
+
+            bool allSawCompletion = true;
+            for (std::vector<VFSNodeAsyncWaitThread*>::iterator i = waiters.begin(); i != waiters.end(); ++i) {
+                (*i)->join();
+                allSawCompletion = allSawCompletion && (*i)->sawCompletion();
+                delete *i;
+            }
+
+            VUNIT_ASSERT_TRUE_LABELED(allSawCompletion && ! slowWrite->hasFailed(), VSTRING_FORMAT("%s completion wakes all waiters", seriesLabel.chars()));
+        }
+
+        // Reading from a file opened for writing only fails, without throwing.
+        VAsyncFileRequestPtr badRead = file.read(readBack, 0, BLOCK_SIZE);
+        VUNIT_ASSERT_TRUE_LABELED(badRead->waitUntilCompleted(VDuration::MINUTE()), VSTRING_FORMAT("%s bad read completed", seriesLabel.chars()));
+        VUNIT_ASSERT_TRUE_LABELED(badRead->hasFailed() && (badRead->getErrorCode() == EBADF) && badRead->getErrorMessage().isNotEmpty(), VSTRING_FORMAT("%s bad read failed", seriesLabel.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(file.getNumFailed(), CONST_S64(1), VSTRING_FORMAT("%s failure counted", seriesLabel.chars()));
+        VUNIT_ASSERT_TRUE_LABELED(file.getLastErrorMessage().isNotEmpty(), VSTRING_FORMAT("%s failure message", seriesLabel.chars()));
+
+        if (file.isDirectIO()) {
+            try {
+                (void) file.write(data + 1, 0, BLOCK_SIZE);
+                VUNIT_ASSERT_FAILURE(VSTRING_FORMAT("%s unaligned direct write", seriesLabel.chars()));
+            } catch (const VRangeException& /*ex*/) {
+                VUNIT_ASSERT_SUCCESS(VSTRING_FORMAT("%s unaligned direct write", seriesLabel.chars()));
+            }
+        }
+    } // the destructor waits for outstanding requests and closes the file
+    VUNIT_ASSERT_EQUAL_LABELED(node.size(), static_cast<VFSize>(FILE_SIZE), VSTRING_FORMAT("%s file size", seriesLabel.chars()));
+
+    {
+        VAsyncFileStream file(node, pool);
+        file.setDirectIO(directIO);
+        file.openReadWrite();
+        VUNIT_ASSERT_EQUAL_LABELED(file.getAppendOffset(), FILE_SIZE, VSTRING_FORMAT("%s append offset", seriesLabel.chars()));
+
+        // Read it all back as one batch.
+        VAsyncFileRequestList reads;
+        for (int i = 0; i < NUM_BLOCKS; ++i) {
+            reads.push_back(VAsyncFileRequestPtr(new VAsyncFileRequest(VAsyncFileRequest::kRead, readBack + (i * BLOCK_SIZE), static_cast<Vs64>(i) * BLOCK_SIZE, BLOCK_SIZE)));
+        }
+        file.submitBatch(reads);
+        for (VAsyncFileRequestList::const_iterator i = reads.begin(); i != reads.end(); ++i) {
+            (*i)->waitUntilCompleted();
+        }
+        VUNIT_ASSERT_TRUE_LABELED(::memcmp(data, readBack, static_cast<size_t>(FILE_SIZE)) == 0, VSTRING_FORMAT("%s read back", seriesLabel.chars()));
+
+        // A read that runs into the end of the file transfers what there is.
+        VAsyncFileRequestPtr endRead = file.read(readBack, FILE_SIZE - BLOCK_SIZE, 2 * BLOCK_SIZE);
+        endRead->waitUntilCompleted();
+        VUNIT_ASSERT_FALSE_LABELED(endRead->hasFailed(), VSTRING_FORMAT("%s read at end not failed", seriesLabel.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(endRead->getNumBytesTransferred(), static_cast<Vs64>(BLOCK_SIZE), VSTRING_FORMAT("%s read at end size", seriesLabel.chars()));
+
+        // Appends land in the order they were made, however they complete.
+        for (int i = 0; i < NUM_BLOCKS; ++i) {
+            (void) file.append(data + (i * BLOCK_SIZE), BLOCK_SIZE);
+        }
+        file.close();
+        VUNIT_ASSERT_FALSE_LABELED(file.isOpen(), VSTRING_FORMAT("%s closed", seriesLabel.chars()));
+
+        try {
+            (void) file.sync();
+            VUNIT_ASSERT_FAILURE(VSTRING_FORMAT("%s request on closed file", seriesLabel.chars()));
+        } catch (const VException& /*ex*/) {
+            VUNIT_ASSERT_SUCCESS(VSTRING_FORMAT("%s request on closed file", seriesLabel.chars()));
+        }
+    }
+    VUNIT_ASSERT_EQUAL_LABELED(node.size(), static_cast<VFSize>(2 * FILE_SIZE), VSTRING_FORMAT("%s appended size", seriesLabel.chars()));
+
+    {
+        VAsyncFileStream file(node, pool);
+        file.openReadOnly();
+        VAsyncFileRequestPtr appendedRead = file.read(readBack, FILE_SIZE, FILE_SIZE);
+        appendedRead->waitUntilCompleted();
+        VUNIT_ASSERT_TRUE_LABELED((appendedRead->getNumBytesTransferred() == FILE_SIZE) && (::memcmp(data, readBack, static_cast<size_t>(FILE_SIZE)) == 0), VSTRING_FORMAT("%s appended contents", seriesLabel.chars()));
+    }
+
+    VAsyncFileStream::freeAlignedBuffer(data);
+    VAsyncFileStream::freeAlignedBuffer(readBack);
+}
+
 bool VFSNodeIterateTestCallback::handleNextNode(const VFSNode& node) {
     VString nodeName;
     node.getName(nodeName);
@@ -14,6 +14,8 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vfsnode.h"
 #include "vabstractfilestream.h"
 
+class VThreadPool;
+
 /**
 Unit test class for validating VFSNode.
 */
@@ -41,7 +43,13 @@ class VFSNodeUnit : public VUnit {
         void _testTextFileIO(const VString& seriesLabel, VFSNode& node, VAbstractFileStream& fileStream);
         void _testTextFileReadAll(VFSNode& node);
         void _testBinaryFileIO(const VString& seriesLabel, VFSNode& node, VAbstractFileStream& fileStream);
+        void _testMappedFileStreamCopy(VFSNode& node);
+        void _testFileToSocketStreamCopy(VFSNode& node);
         void _testDirectoryIteration(const VFSNode& dir);
+        void _testDirectoryWalk(const VFSNode& tempDir);
+        void _testSafeOverwrite(const VFSNode& tempDir);
+        void _testAsyncFileStream(const VFSNode& tempDir);
+        void _testAsyncFileStreamIO(const VString& seriesLabel, const VFSNode& node, VThreadPool* pool, bool directIO);
         void _writeKnownDirectoryTestFile(VFSNode::KnownDirectoryIdentifier id, const VString& fileName);
         void _testWindowsDrivePaths(const VString& driveLetter, const VString& childNodeName, bool adornedWithSlash, bool childIsDirectory);
 
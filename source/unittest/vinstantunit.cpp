@@ -12,6 +12,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vinstant.h"
 #include "vexception.h"
 #include "vthread.h"
+#include "vcoarseclock.h"
 #include "vassert.h"
 
 VInstantUnit::VInstantUnit(bool logOnSuccess, bool throwOnError) :
@@ -26,11 +27,14 @@ void VInstantUnit::run() {
     this->_runInstantOperatorTests();
     this->_runInstantComparatorTests();
     this->_runClockSimulationTests();
+    this->_runTicksTests();
+    this->_runCoarseClockTests();
     this->_runTimeZoneConversionTests();
     this->_runDurationValueTests();
     this->_runExoticDurationValueTests();
     this->_runDurationStringTests();
     this->_runInstantFormatterTests();
+    this->_runInstantFormatterCacheTests();
 }
 
 void VInstantUnit::_runInstantOperatorTests() {
@@ -202,11 +206,13 @@ void VInstantUnit::_runClockSimulationTests() {
 
         // Freeze time at the specified past time.
         VInstant::freezeTime(fakePastInstant);
+        VStopwatch realElapsed;
 
         // Sleep for 2 seconds and verify that no time seemed to actually pass.
         VThread::sleep(2 * VDuration::SECOND());
         VInstant frozenNow1;
         VUNIT_ASSERT_TRUE_LABELED(frozenNow1 == fakePastInstant, "freeze time 1");
+        VUNIT_ASSERT_TRUE_LABELED(realElapsed.getElapsedMilliseconds() >= 1900, "ticks are not frozen"); // VTicks measures real time regardless
 
         Vs64 frozenSnapshot = VInstant::snapshot();
 
@@ -245,6 +251,89 @@ void VInstantUnit::_runClockSimulationTests() {
 
 }
 
+void VInstantUnit::_runTicksTests() {
+    this->logStatus(VSTRING_FORMAT("VTicks clock: %s.", VTicks::isUsingTSC() ? "calibrated TSC" : "platform monotonic clock"));
+
+    // The clock never goes backward, and resolves well below a millisecond.
+    Vs64 previous = VTicks::snapshot();
+    bool monotonic = true;
+    Vs64 smallestStep = V_MAX_S64;
+    for (int i = 0; i < 10000; ++i) {
+        const Vs64 current = VTicks::snapshot();
+        monotonic = monotonic && (current >= previous);
+        if (current > previous) {
+            smallestStep = V_MIN(smallestStep, current - previous);
+        }
+
+        previous = current;
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(monotonic, "ticks monotonic");
+    VUNIT_ASSERT_TRUE_LABELED(smallestStep < VTicks::kNanosecondsPerMillisecond, "ticks sub-millisecond resolution");
+
+    VTicks t1;
+    VTicks t2(t1.getValue() + 1500);
+    VUNIT_ASSERT_EQUAL_LABELED(t2 - t1, CONST_S64(1500), "ticks difference");
+    VUNIT_ASSERT_TRUE_LABELED(t1 < t2 && t2 > t1 && t1 != t2 && t1 == VTicks(t1.getValue()), "ticks comparison");
+
+    VStopwatch stopwatch;
+    VThread::sleep(50 * VDuration::MILLISECOND());
+    const Vs64 elapsedNanoseconds = stopwatch.getElapsedNanoseconds();
+    VUNIT_ASSERT_TRUE_LABELED(elapsedNanoseconds >= 45 * VTicks::kNanosecondsPerMillisecond, "stopwatch measures sleep"); // allow for coarse sleep granularity
+    VUNIT_ASSERT_TRUE_LABELED(stopwatch.getElapsedMicroseconds() >= elapsedNanoseconds / VTicks::kNanosecondsPerMicrosecond, "stopwatch microseconds");
+    VUNIT_ASSERT_TRUE_LABELED(stopwatch.getElapsedDuration() >= 45 * VDuration::MILLISECOND(), "stopwatch duration");
+    stopwatch.start();
+    VUNIT_ASSERT_TRUE_LABELED(stopwatch.getElapsedMilliseconds() < 45, "stopwatch restart");
+
+    VUNIT_ASSERT_EQUAL_LABELED(VTicks::getDurationString(850), VString("850ns"), "ticks duration string ns");
+    VUNIT_ASSERT_EQUAL_LABELED(VTicks::getDurationString(12345), VString("12.345us"), "ticks duration string us");
+    VUNIT_ASSERT_EQUAL_LABELED(VTicks::getDurationString(CONST_S64(1500000)), VString("1.500ms"), "ticks duration string ms");
+    VUNIT_ASSERT_EQUAL_LABELED(VTicks::getDurationString(CONST_S64(3250000000)), VString("3.250s"), "ticks duration string s");
+    VUNIT_ASSERT_EQUAL_LABELED(VTicks::getDurationString(-2000), VString("-2.000us"), "ticks duration string negative");
+}
+
+void VInstantUnit::_runCoarseClockTests() {
+    const VDuration kTolerance = 500 * VDuration::MILLISECOND(); // generous, for scheduling delays on a loaded machine
+
+    // Without the ticker, the coarse time is simply the current time.
+    VUNIT_ASSERT_FALSE_LABELED(VCoarseClock::isRunning(), "coarse clock initially stopped");
+    VUNIT_ASSERT_FALSE_LABELED(VInstant::isCoarseClockEnabled(), "coarse clock initially disabled");
+    VInstant before;
+    VInstant coarse; coarse.setNowCoarse();
+    VInstant after;
+    VUNIT_ASSERT_TRUE_LABELED((coarse >= before) && (coarse <= after), "coarse time without ticker");
+
+    VCoarseClock::start(5 * VDuration::MILLISECOND());
+    VUNIT_ASSERT_TRUE_LABELED(VCoarseClock::isRunning(), "coarse clock started");
+    VUNIT_ASSERT_TRUE_LABELED(VInstant::isCoarseClockEnabled(), "coarse clock enabled");
+    VUNIT_ASSERT_EQUAL_LABELED(VCoarseClock::getResolution(), 5 * VDuration::MILLISECOND(), "coarse clock resolution");
+
+    VInstant coarse1; coarse1.setNowCoarse();
+    VInstant now1;
+    VUNIT_ASSERT_TRUE_LABELED((coarse1 <= now1) && (now1 - coarse1 < kTolerance), "coarse time lags by at most the tolerance");
+    VThread::sleep(100 * VDuration::MILLISECOND());
+    VInstant coarse2; coarse2.setNowCoarse();
+    VUNIT_ASSERT_TRUE_LABELED(coarse2 > coarse1, "coarse time advances");
+
+    // The simulated clock offset and frozen time apply to coarse time just as to setNow().
+    VInstant::setSimulatedClockOffset(VDuration::HOUR());
+    VInstant simulatedCoarse; simulatedCoarse.setNowCoarse();
+    VInstant simulatedNow;
+    VUNIT_ASSERT_TRUE_LABELED((simulatedCoarse <= simulatedNow) && (simulatedNow - simulatedCoarse < kTolerance), "coarse time simulated offset");
+    VInstant::setSimulatedClockOffset(VDuration::ZERO());
+
+    VInstant frozenValue; frozenValue -= VDuration::DAY();
+    VInstant::freezeTime(frozenValue);
+    VInstant frozenCoarse; frozenCoarse.setNowCoarse();
+    VUNIT_ASSERT_TRUE_LABELED(frozenCoarse == frozenValue, "coarse time frozen");
+    VInstant::unfreezeTime();
+    VInstant::setSimulatedClockOffset(VDuration::ZERO());
+
+    VCoarseClock::stop();
+    VUNIT_ASSERT_FALSE_LABELED(VCoarseClock::isRunning(), "coarse clock stopped");
+    VUNIT_ASSERT_FALSE_LABELED(VInstant::isCoarseClockEnabled(), "coarse clock disabled");
+}
+
 void VInstantUnit::_runTimeZoneConversionTests() {
 
     // Test local-gm time conversion consistency.
@@ -833,6 +922,63 @@ void VInstantUnit::_runInstantFormatterTests() {
         "2001-W-3");
 }
 
+void VInstantUnit::_runInstantFormatterCacheTests() {
+    // Consecutive instants reuse the per-thread cached fields and text. Step across second, minute, and day
+    // boundaries and compare against fields computed the slow way. Interleave two formatters to make sure
+    // each one's cached text is not handed to the other.
+    VInstantFormatter defaultFormatter;
+    VInstantFormatter isoFormatter("yyyy-MM-dd'T'HH:mm:ss.SSSXXX");
+    VInstant when;
+    when.setValues(VDate(2013, 12, 31), VTimeOfDay(23, 59, 58, 0), VInstant::UTC_TIME_ZONE_ID());
+    const Vs64 startValue = when.getValue();
+
+    int numMismatches = 0;
+    for (int i = 0; i < 1000; ++i) {
+        when.setValue(startValue + (i * 7));
+
+        VInstantStruct utc = when.getUTCInstantFields();
+        VString expectedUTC(VSTRING_ARGS("%04d-%02d-%02d %02d:%02d:%02d.%03d", utc.mYear, utc.mMonth, utc.mDay, utc.mHour, utc.mMinute, utc.mSecond, utc.mMillisecond));
+        VInstantStruct local = when.getLocalInstantFields();
+        VString expectedLocal(VSTRING_ARGS("%04d-%02d-%02d %02d:%02d:%02d.%03d", local.mYear, local.mMonth, local.mDay, local.mHour, local.mMinute, local.mSecond, local.mMillisecond));
+
+        if ((defaultFormatter.formatUTCString(when) != expectedUTC) ||
+            (defaultFormatter.formatLocalString(when) != expectedLocal) ||
+            (isoFormatter.formatUTCString(when) != VSTRING_FORMAT("%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", utc.mYear, utc.mMonth, utc.mDay, utc.mHour, utc.mMinute, utc.mSecond, utc.mMillisecond))) {
+            ++numMismatches;
+        }
+    }
+
+    VUNIT_ASSERT_EQUAL_LABELED(numMismatches, 0, "formatter cache consecutive instants");
+
+    // A format with a short millisecond field can't be patched in place, so it is rendered each time.
+    VInstantFormatter shortMillisecondFormatter("ss.S");
+    when.setValue(startValue + 5);
+    VUNIT_ASSERT_EQUAL_LABELED(shortMillisecondFormatter.formatUTCString(when), "58.5", "formatter short millisecond field");
+    when.setValue(startValue + 45);
+    VUNIT_ASSERT_EQUAL_LABELED(shortMillisecondFormatter.formatUTCString(when), "58.45", "formatter short millisecond field again");
+
+    // Benchmark: time stamps as a logger would produce them, one per millisecond.
+    const int numIterations = 200000;
+    VInstant start;
+    for (int i = 0; i < numIterations; ++i) {
+        when.setValue(startValue + i);
+        (void) defaultFormatter.formatLocalString(when);
+    }
+    VDuration localDuration(VInstant() - start);
+
+    start = VInstant();
+    for (int i = 0; i < numIterations; ++i) {
+        when.setValue(startValue + i);
+        (void) defaultFormatter.formatUTCString(when);
+    }
+    VDuration utcDuration(VInstant() - start);
+
+    this->logStatus(VSTRING_FORMAT("VInstantFormatter local: %d time stamps in %s (" VSTRING_FORMATTER_S64 " per second).",
+        numIterations, localDuration.getDurationString().chars(), (CONST_S64(1000) * numIterations) / V_MAX(CONST_S64(1), localDuration.getDurationMilliseconds())));
+    this->logStatus(VSTRING_FORMAT("VInstantFormatter UTC: %d time stamps in %s (" VSTRING_FORMATTER_S64 " per second).",
+        numIterations, utcDuration.getDurationString().chars(), (CONST_S64(1000) * numIterations) / V_MAX(CONST_S64(1), utcDuration.getDurationMilliseconds())));
+}
+
 void VInstantUnit::_testInstantFormatter(const VString& label, const VInstant& instant, const VString& format, const VString& expectedUTCOutput, const VString& expectedLocalOutput) {
     VInstantFormatter formatter(format);
     
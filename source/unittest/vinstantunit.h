@@ -39,11 +39,14 @@ class VInstantUnit : public VUnit {
         void _runInstantOperatorTests();
         void _runInstantComparatorTests();
         void _runClockSimulationTests();
+        void _runTicksTests();
+        void _runCoarseClockTests();
         void _runTimeZoneConversionTests();
         void _runDurationValueTests();
         void _runExoticDurationValueTests();
         void _runDurationStringTests();
         void _runInstantFormatterTests();
+        void _runInstantFormatterCacheTests();
 
         void _testInstantFormatter(const VString& label, const VInstant& instant, const VString& format, const VString& expectedUTCOutput, const VString& expectedLocalOutput);
         void _testInstantRangeRoundTripConversion(const VString& label, const VInstant& startInstant, const VDuration& increment, int numIncrements);
@@ -9,9 +9,14 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vloggerunit.h"
 #include "vlogger.h"
+#include "vbinarylog.h"
 #include "vmessage.h"
 #include "vbento.h"
 #include "vsettings.h"
+#include "vthread.h"
+#include "vmutexlocker.h"
+
+#include <algorithm>
 
 typedef std::vector<VNamedLogger*> VLoggerUnitLoggerList;
 
@@ -36,7 +41,13 @@ void VLoggerUnit::run() {
     this->_testStringLoggers();
     this->_testMaxActiveLogLevel();
     this->_testLoggerPathNames();
+    this->_testCallSiteCache();
+    this->_testThrottling();
     this->_testSmartPtrLifecycle();
+    this->_testAsyncAppender();
+    this->_testRollingFileAppender();
+    this->_testBinaryLogAppender();
+    this->_testFormatSpec();
 //    this->_testOptimizationPerformance();
 }
 
@@ -414,6 +425,192 @@ void VLoggerUnit::_testLoggerPathNames() {
     // Do not reference them after the loop. Destructing the list is OK.
 }
 
+// All calls to this function log from the same VLOGGER_NAMED statement, and therefore use the same call site cache.
+static void _logFromOneCallSite(const VString& loggerName, const VString& message) {
+    VLOGGER_NAMED_INFO(loggerName, message);
+}
+
+void VLoggerUnit::_testCallSiteCache() {
+    VNamedLoggerPtr parentLogger(new VStringLogger("callsite", VLoggerLevel::INFO));
+    VNamedLoggerPtr childLogger(new VStringLogger("callsite.child", VLoggerLevel::INFO));
+    VStringLogger* parentLines = static_cast<VStringLogger*>(parentLogger.get());
+    VStringLogger* childLines = static_cast<VStringLogger*>(childLogger.get());
+    VLogger::registerLogger(parentLogger);
+    VLogger::registerLogger(childLogger);
+
+    // The first call resolves the name and fills the cache; the second uses the cache.
+    _logFromOneCallSite("callsite.child.x", "first");
+    _logFromOneCallSite("callsite.child.x", "second");
+    VUNIT_ASSERT_TRUE_LABELED(childLines->getLines().contains("first") && childLines->getLines().contains("second"), "resolved and cached to child");
+    VUNIT_ASSERT_FALSE_LABELED(parentLines->getLines().contains("first") || parentLines->getLines().contains("second"), "not logged to parent");
+
+    // A different name at the same statement must not use the cached logger.
+    _logFromOneCallSite("callsite.other", "third");
+    _logFromOneCallSite("callsite.child.x", "fourth");
+    VUNIT_ASSERT_TRUE_LABELED(parentLines->getLines().contains("third"), "different name resolved to parent");
+    VUNIT_ASSERT_TRUE_LABELED(childLines->getLines().contains("fourth"), "original name still resolved to child");
+
+    // Registering a better match invalidates the cache.
+    VNamedLoggerPtr grandchildLogger(new VStringLogger("callsite.child.x", VLoggerLevel::INFO));
+    VStringLogger* grandchildLines = static_cast<VStringLogger*>(grandchildLogger.get());
+    VLogger::registerLogger(grandchildLogger);
+    _logFromOneCallSite("callsite.child.x", "fifth");
+    VUNIT_ASSERT_TRUE_LABELED(grandchildLines->getLines().contains("fifth"), "new logger found after register");
+    VUNIT_ASSERT_FALSE_LABELED(childLines->getLines().contains("fifth"), "stale logger not used after register");
+
+    // Deregistering it invalidates the cache again, and the name falls back to the parent path.
+    VLogger::deregisterLogger(grandchildLogger);
+    _logFromOneCallSite("callsite.child.x", "sixth");
+    VUNIT_ASSERT_TRUE_LABELED(childLines->getLines().contains("sixth"), "parent path found after deregister");
+    VUNIT_ASSERT_FALSE_LABELED(grandchildLines->getLines().contains("sixth"), "deregistered logger not used");
+
+    // The cache does not bypass the level check.
+    static VLoggerCallSiteCache cache;
+    VNamedLoggerPtr found = VLogger::findNamedLoggerForLevel(cache, "callsite.child.x", VLoggerLevel::INFO);
+    VUNIT_ASSERT_TRUE_LABELED(found == childLogger, "cached find");
+    VUNIT_ASSERT_TRUE_LABELED(VLogger::findNamedLoggerForLevel(cache, "callsite.child.x", VLoggerLevel::INFO) == found, "cached find again");
+    childLogger->setLevel(VLoggerLevel::WARN);
+    VUNIT_ASSERT_TRUE_LABELED(VLogger::findNamedLoggerForLevel(cache, "callsite.child.x", VLoggerLevel::INFO) == nullptr, "cached find honors level");
+
+    VLogger::deregisterLogger(childLogger);
+    VLogger::deregisterLogger(parentLogger);
+
+    // The registry doesn't keep deregistered loggers alive; they are destroyed when the last reference is released.
+    VWeakPtr<VNamedLogger> weakGrandchildLogger(grandchildLogger);
+    VWeakPtr<VNamedLogger> weakChildLogger(childLogger);
+    grandchildLogger.reset();
+    found.reset();
+    childLogger.reset();
+    VUNIT_ASSERT_TRUE_LABELED(weakGrandchildLogger.expired(), "deregistered logger destroyed");
+    VUNIT_ASSERT_TRUE_LABELED(weakChildLogger.expired(), "deregistered cached logger destroyed");
+}
+
+// Two separate VLOGGER_NAMED statements, for the per-call-site rate limit test.
+static void _logFromThrottledCallSiteA(const VString& loggerName, const VString& message) {
+    VLOGGER_NAMED_WARN(loggerName, message);
+}
+
+static void _logFromThrottledCallSiteB(const VString& loggerName, const VString& message) {
+    VLOGGER_NAMED_WARN(loggerName, message);
+}
+
+void VLoggerUnit::_testThrottling() {
+    // A logger rate limit of 1 per second with a burst of 5 lets the first 5 of a quick series through.
+    // (If this runs slowly enough for a second to pass, one more may be let through.)
+    {
+        VStringVectorLoggerPtr logger(new VStringVectorLogger("throttle", VLoggerLevel::INFO, NULL, VLogAppender::DONT_FORMAT_OUTPUT));
+        logger->getThrottle().setRateLimit(1, 5);
+        VLogger::registerLogger(logger);
+
+        for (int i = 0; i < 20; ++i) {
+            VLOGGER_NAMED_INFO("throttle", VSTRING_FORMAT("info %d", i));
+        }
+
+        const int numEmitted = static_cast<int>(logger->getLines().size());
+        VUNIT_ASSERT_TRUE_LABELED((numEmitted == 5) || (numEmitted == 6), "rate limit allows burst");
+        VUNIT_ASSERT_EQUAL_LABELED(logger->getLines()[0], VString("info 0"), "rate limit first message emitted");
+        VUNIT_ASSERT_EQUAL_LABELED(logger->getThrottle().getNumSuppressed(), 20 - numEmitted, "rate limit suppressed count");
+
+        // Errors are exempt by default.
+        for (int i = 0; i < 10; ++i) {
+            VLOGGER_NAMED_ERROR("throttle", VSTRING_FORMAT("error %d", i));
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(logger->getLines().size()), numEmitted + 10, "rate limit exempts errors");
+
+        // Once the summary interval has passed, the next message reports the suppressed count.
+        logger->getThrottle().setSummaryInterval(VDuration::ZERO());
+        // The message itself may be suppressed too, and counted in the summary; if not, it follows the summary.
+        VLOGGER_NAMED_INFO("throttle", "after");
+        const size_t summaryIndex = static_cast<size_t>(numEmitted + 10);
+        const VString summary = (logger->getLines().size() > summaryIndex) ? logger->getLines()[summaryIndex] : VString::EMPTY();
+        VUNIT_ASSERT_TRUE_LABELED(summary.startsWith("Suppressed ") && summary.contains(" by rate limit, 0 by sampling)"), "rate limit summary emitted");
+        VUNIT_ASSERT_EQUAL_LABELED(logger->getThrottle().getNumSuppressed(), 0, "rate limit summary resets count");
+
+        VLogger::deregisterLogger(logger);
+    }
+
+    // The summary of a burst is reported by the summary timer once it is due, without another message to trigger it.
+    {
+        VStringVectorLoggerPtr logger(new VStringVectorLogger("throttle-timer", VLoggerLevel::INFO, NULL, VLogAppender::DONT_FORMAT_OUTPUT));
+        logger->getThrottle().setRateLimit(1, 1);
+        logger->getThrottle().setSummaryInterval(VDuration::MILLISECOND() * 200);
+        VLogger::registerLogger(logger);
+
+        for (int i = 0; i < 5; ++i) {
+            VLOGGER_NAMED_INFO("throttle-timer", VSTRING_FORMAT("info %d", i));
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED(logger->getThrottle().getNumSuppressed() > 0, "summary timer burst suppressed");
+        for (int i = 0; (i < 100) && (logger->getThrottle().getNumSuppressed() != 0); ++i) {
+            VThread::sleep(VDuration::MILLISECOND() * 50);
+        }
+
+        VThread::sleep(VDuration::MILLISECOND() * 50); // the summary is logged just after the count is reset
+        VUNIT_ASSERT_EQUAL_LABELED(logger->getThrottle().getNumSuppressed(), 0, "summary timer reset count");
+        VUNIT_ASSERT_TRUE_LABELED(logger->getLines().back().startsWith("Suppressed "), "summary timer emitted summary");
+
+        VLogger::deregisterLogger(logger);
+    }
+
+    // Deregistering a logger reports what it has suppressed, however recently it last reported.
+    {
+        VStringVectorLoggerPtr logger(new VStringVectorLogger("throttle-deregister", VLoggerLevel::INFO, NULL, VLogAppender::DONT_FORMAT_OUTPUT));
+        logger->getThrottle().setRateLimit(1, 1);
+        VLogger::registerLogger(logger);
+
+        for (int i = 0; i < 5; ++i) {
+            VLOGGER_NAMED_INFO("throttle-deregister", VSTRING_FORMAT("info %d", i));
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED(logger->getThrottle().getNumSuppressed() > 0, "deregistered logger burst suppressed");
+        VLogger::deregisterLogger(logger);
+        VUNIT_ASSERT_EQUAL_LABELED(logger->getThrottle().getNumSuppressed(), 0, "deregistered logger reset count");
+        VUNIT_ASSERT_TRUE_LABELED(logger->getLines().back().startsWith("Suppressed "), "deregistered logger emitted summary");
+    }
+
+    // A per-call-site limit applies to each statement separately.
+    {
+        VStringVectorLoggerPtr logger(new VStringVectorLogger("throttle-site", VLoggerLevel::INFO, NULL, VLogAppender::DONT_FORMAT_OUTPUT));
+        logger->getThrottle().setCallSiteRateLimit(1, 2);
+        VLogger::registerLogger(logger);
+
+        for (int i = 0; i < 5; ++i) {
+            _logFromThrottledCallSiteA("throttle-site", "a");
+            _logFromThrottledCallSiteB("throttle-site", "b");
+        }
+
+        int numA = 0;
+        int numB = 0;
+        for (VStringVector::const_iterator i = logger->getLines().begin(); i != logger->getLines().end(); ++i) {
+            numA += ((*i) == "a") ? 1 : 0;
+            numB += ((*i) == "b") ? 1 : 0;
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED((numA >= 2) && (numA <= 3), "call site limit statement a");
+        VUNIT_ASSERT_TRUE_LABELED((numB >= 2) && (numB <= 3), "call site limit statement b");
+
+        VLogger::deregisterLogger(logger);
+    }
+
+    // Sampling admits about 1 in N.
+    {
+        VNamedLoggerPtr logger(new VStringVectorLogger("throttle-sample", VLoggerLevel::INFO, NULL));
+        logger->getThrottle().setSampleRate(10);
+
+        int numAdmitted = 0;
+        for (int i = 0; i < 10000; ++i) {
+            numAdmitted += logger->admit(VLoggerLevel::INFO) ? 1 : 0;
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED((numAdmitted > 800) && (numAdmitted < 1200), "sampling admits about 1 in 10");
+        VUNIT_ASSERT_TRUE_LABELED(logger->admit(VLoggerLevel::ERROR), "sampling exempts errors");
+
+        logger->getThrottle().setSampleRate(1);
+        VUNIT_ASSERT_TRUE_LABELED(logger->admit(VLoggerLevel::TRACE), "no throttling admits all");
+    }
+}
+
 void VLoggerUnit::_testSmartPtrLifecycle() {
 
     // Regression test for bug in VNamedLogger::log() that incorrectly passed naked (this) to VNamedLoggerPtr() for VThread::logStackCrawl() parameter, causing premature destruction of logger on return.
@@ -423,11 +620,521 @@ void VLoggerUnit::_testSmartPtrLifecycle() {
 
 }
 
+/**
+Emits a series of numbered messages to an appender from its own thread, for the async appender tests.
+*/
+class VLoggerUnitEmitterThread : public VThread {
+    public:
+
+        VLoggerUnitEmitterThread(VLogAppender& appender, const VString& prefix, int numMessages)
+            : VThread(VSTRING_FORMAT("VLoggerUnitEmitterThread.%s", prefix.chars()), "vault.unittest.VLoggerUnitEmitterThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL)
+            , mAppender(appender)
+            , mPrefix(prefix)
+            , mNumMessages(numMessages)
+            {
+        }
+        virtual ~VLoggerUnitEmitterThread() {}
+
+        virtual void run() {
+            for (int i = 0; i < mNumMessages; ++i) {
+                VLOGGER_APPENDER_EMIT(mAppender, VLoggerLevel::INFO, VSTRING_FORMAT("%s %d", mPrefix.chars(), i));
+            }
+        }
+
+    private:
+
+        VLoggerUnitEmitterThread(const VLoggerUnitEmitterThread&); // not copyable
+        VLoggerUnitEmitterThread& operator=(const VLoggerUnitEmitterThread&); // not assignable
+
+        VLogAppender&   mAppender;
+        VString         mPrefix;
+        int             mNumMessages;
+};
+
+static int _countLinesWithPrefix(const VStringVector& lines, const VString& prefix) {
+    int count = 0;
+    for (VStringVector::const_iterator i = lines.begin(); i != lines.end(); ++i) {
+        if ((*i).startsWith(prefix)) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+void VLoggerUnit::_testAsyncAppender() {
+    const VString DROP_REPORT_PREFIX("VAsyncLogAppender");
+
+    // Several threads emitting through a small ring with the block policy: nothing is lost, and each thread's output stays in order.
+    {
+        VStringVectorLogAppender* target = new VStringVectorLogAppender("async-block", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), NULL);
+        VAsyncLogAppender async(VLogAppenderPtr(target), 64, VAsyncLogAppender::kOverflowBlock);
+
+        const int kNumThreads = 4;
+        const int kNumMessagesPerThread = 2000;
+        std::vector<VLoggerUnitEmitterThread*> threads;
+        for (int i = 0; i < kNumThreads; ++i) {
+            threads.push_back(new VLoggerUnitEmitterThread(async, VSTRING_FORMAT("t%d", i), kNumMessagesPerThread));
+        }
+
+        for (int i = 0; i < kNumThreads; ++i) {
+            threads[i]->start();
+        }
+
+        for (int i = 0; i < kNumThreads; ++i) {
+            threads[i]->join();
+            delete threads[i];
+        }
+
+        async.drain();
+
+        const VStringVector& lines = target->getLines();
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(lines.size()), kNumThreads * kNumMessagesPerThread, "async block all lines written");
+        VUNIT_ASSERT_EQUAL_LABELED(async.getNumWritten(), static_cast<Vs64>(kNumThreads * kNumMessagesPerThread), "async block num written");
+        VUNIT_ASSERT_EQUAL_LABELED(async.getNumDropped(), CONST_S64(0), "async block none dropped");
+
+        bool inOrder = true;
+        for (int threadIndex = 0; threadIndex < kNumThreads; ++threadIndex) {
+            VString prefix(VSTRING_FORMAT("t%d ", threadIndex));
+            int expectedIndex = 0;
+            for (VStringVector::const_iterator i = lines.begin(); i != lines.end(); ++i) {
+                if ((*i).startsWith(prefix)) {
+                    inOrder = inOrder && ((*i) == VSTRING_FORMAT("t%d %d", threadIndex, expectedIndex));
+                    ++expectedIndex;
+                }
+            }
+        }
+        VUNIT_ASSERT_TRUE_LABELED(inOrder, "async block per-thread order");
+    }
+
+    // The drop policy: while the target appender is locked, the writer can't empty the ring, so overflowing messages are discarded.
+    // Errors are never discarded, and the writer reports how many were.
+    {
+        VStringVectorLogAppender* target = new VStringVectorLogAppender("async-drop", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), NULL);
+        VAsyncLogAppender async(VLogAppenderPtr(target), 8, VAsyncLogAppender::kOverflowDrop);
+        VUNIT_ASSERT_EQUAL_LABELED(async.getQueueSize(), 8, "async drop queue size");
+
+        VMutexLocker targetLocker(&target->getMutex(), "VLoggerUnit::_testAsyncAppender");
+        for (int i = 0; i < 20; ++i) {
+            VLOGGER_APPENDER_EMIT(async, VLoggerLevel::INFO, VSTRING_FORMAT("drop %d", i));
+        }
+        VUNIT_ASSERT_EQUAL_LABELED(async.getNumDropped(), CONST_S64(12), "async drop num dropped");
+        targetLocker.unlock();
+
+        VLOGGER_APPENDER_EMIT(async, VLoggerLevel::ERROR, "drop error");
+        async.drain();
+
+        const VStringVector& lines = target->getLines();
+        VUNIT_ASSERT_EQUAL_LABELED(_countLinesWithPrefix(lines, "drop "), 9, "async drop lines written");
+        VUNIT_ASSERT_EQUAL_LABELED(lines[7], VString("drop 7"), "async drop last queued line");
+        VUNIT_ASSERT_EQUAL_LABELED(_countLinesWithPrefix(lines, DROP_REPORT_PREFIX), 1, "async drop report");
+        VUNIT_ASSERT_TRUE_LABELED(lines[8].contains("discarded 12 messages"), "async drop report count");
+
+        VBentoNode info;
+        async.addInfo(info);
+        VUNIT_ASSERT_EQUAL_LABELED(info.getS64("async-num-dropped"), CONST_S64(12), "async drop info num dropped");
+        VUNIT_ASSERT_EQUAL_LABELED(info.getString("async-overflow"), VString("drop"), "async drop info policy");
+    }
+
+    // The sample policy: every Nth overflowing message waits for room, and the ones in between are discarded.
+    // Another thread overflows the ring while we hold the target appender's lock, until it has to wait; then we let the writer catch up.
+    {
+        VStringVectorLogAppender* target = new VStringVectorLogAppender("async-sample", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), NULL);
+        VAsyncLogAppender async(VLogAppenderPtr(target), 8, VAsyncLogAppender::kOverflowSample, 4);
+
+        VMutexLocker targetLocker(&target->getMutex(), "VLoggerUnit::_testAsyncAppender");
+        VLoggerUnitEmitterThread emitter(async, "sample", 20);
+        emitter.start();
+        for (int i = 0; (i < 500) && (async.getNumBlocked() == 0); ++i) {
+            VThread::sleep(10 * VDuration::MILLISECOND());
+        }
+        targetLocker.unlock();
+        emitter.join();
+        async.drain();
+
+        // 8 messages filled the ring, the next 3 were discarded, and the 4th waited. After that, more may have overflowed
+        // while the writer was still emptying the ring, so we can only say that at least those 3 were discarded.
+        const VStringVector& lines = target->getLines();
+        VUNIT_ASSERT_TRUE_LABELED(async.getNumBlocked() >= 1, "async sample num blocked");
+        VUNIT_ASSERT_TRUE_LABELED(async.getNumDropped() >= 3, "async sample num dropped");
+        VUNIT_ASSERT_EQUAL_LABELED(_countLinesWithPrefix(lines, "sample ") + async.getNumDropped(), CONST_S64(20), "async sample lines written or dropped");
+        VUNIT_ASSERT_TRUE_LABELED(_countLinesWithPrefix(lines, DROP_REPORT_PREFIX) >= 1, "async sample drop report");
+    }
+
+    // A fatal message has been written by the time emit() returns, and the formatting uses the caller's thread name, not the writer's.
+    {
+        VStringVectorLogAppender* target = new VStringVectorLogAppender("async-fatal", VLogAppender::DO_FORMAT_OUTPUT, "$thread | $message", VString::EMPTY(), NULL);
+        VLogAppenderPtr async(new VAsyncLogAppender(VLogAppenderPtr(target)));
+
+        VLOGGER_APPENDER_EMIT(*async, VLoggerLevel::INFO, "before fatal");
+        VLOGGER_APPENDER_EMIT(*async, VLoggerLevel::FATAL, "fatal");
+
+        const VStringVector& lines = target->getLines();
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(lines.size()), 2, "async fatal lines written");
+        VUNIT_ASSERT_EQUAL_LABELED(lines[1], VSTRING_FORMAT("%s | fatal", VThread::getCurrentThreadName().chars()), "async fatal formatted on caller's thread name");
+    }
+
+    // Construction from settings.
+    {
+        VString settingsText(VSTRING_COPY("<appender name=\"async-settings\" kind=\"silent\" async=\"true\" async-queue-size=\"100\" async-overflow=\"sample\" async-sample-rate=\"10\" />"));
+        VMemoryStream buf(settingsText.getDataBuffer(), VMemoryStream::kAllocatedByOperatorNew, false, settingsText.length(), settingsText.length());
+        VTextIOStream in(buf);
+        VSettings settings(in);
+        VSettings emptyDefaults;
+        const VSettingsNode* appenderNode = settings.findNode("appender");
+
+        VUNIT_ASSERT_TRUE_LABELED(VAsyncLogAppender::isAsyncConfigured(*appenderNode, emptyDefaults), "async configured");
+        VUNIT_ASSERT_FALSE_LABELED(VAsyncLogAppender::isAsyncConfigured(emptyDefaults, emptyDefaults), "async not configured");
+
+        VAsyncLogAppender async(VLogAppenderPtr(new VSilentLogAppender(*appenderNode, emptyDefaults)), *appenderNode, emptyDefaults);
+        VUNIT_ASSERT_EQUAL_LABELED(async.getName(), VString("async-settings"), "async settings name");
+        VUNIT_ASSERT_EQUAL_LABELED(async.getQueueSize(), 128, "async settings queue size rounded up");
+        VUNIT_ASSERT_TRUE_LABELED(async.getOverflowPolicy() == VAsyncLogAppender::kOverflowSample, "async settings overflow policy");
+
+        try {
+            (void) VAsyncLogAppender::overflowPolicyFromString("bogus");
+            VUNIT_ASSERT_FAILURE("async settings invalid overflow policy");
+        } catch (const VRangeException& /*ex*/) {
+            VUNIT_ASSERT_SUCCESS("async settings invalid overflow policy");
+        }
+    }
+}
+
 #define OLDEST_VLOGGER_NAMED_DEBUG(loggername, message) VLogger::getLogger(loggername)->log(VLoggerLevel::DEBUG, message)
 #define OLD_VLOGGER_NAMED_DEBUG(loggername, message) do { VNamedLoggerPtr vlcond = VLogger::findNamedLoggerForLevel(loggername, VLoggerLevel::DEBUG); if (vlcond != NULL) vlcond->log(VLoggerLevel::DEBUG, NULL, 0, message); } while (false)
 // for reference, as of this writing, the new one basically expands to:
 // #define VLOGGER_NAMED_DEBUG(loggername, message) do { if (!VLogger::isLogLevelActive(VLoggerLevel::DEBUG)) break; VLogger* vlcond = VLogger::getLoggerConditional(loggername, VLoggerLevel::DEBUG); if (vlcond != NULL) vlcond->log(VLoggerLevel::DEBUG, NULL, 0, message); } while (false)
 
+static int _countRollingFiles(const VFSNode& dir, const VString& prefix) {
+    VStringVector fileNames;
+    dir.list(fileNames);
+
+    int numFiles = 0;
+    for (VStringVector::const_iterator i = fileNames.begin(); i != fileNames.end(); ++i) {
+        if ((*i).startsWith(prefix + "-")) {
+            ++numFiles;
+        }
+    }
+
+    return numFiles;
+}
+
+void VLoggerUnit::_testRollingFileAppender() {
+    VFSNode testDir(VFSNode::getKnownDirectoryNode(VFSNode::CACHED_DATA_DIRECTORY, "vault", "unittest"), "vloggertest_rolling");
+    (void) testDir.rm();
+
+    // Roll by line count, keeping only the newest 3 rolled files.
+    {
+        VRollingFileLogAppender appender("rolling-lines", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), testDir.getPath(), "lines", 100);
+        appender.setRetention(3, VDuration::ZERO(), true);
+        VString firstFilePath = appender.getCurrentFilePath();
+
+        for (int i = 0; i < 450; ++i) {
+            appender.emitRaw(VSTRING_FORMAT("line %d", i));
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(appender.getNumRolls(), 4, "rolling lines num rolls");
+        VUNIT_ASSERT_NOT_EQUAL_LABELED(appender.getCurrentFilePath(), firstFilePath, "rolling lines new file");
+
+        appender.drainHousekeeping();
+        VUNIT_ASSERT_EQUAL_LABELED(_countRollingFiles(testDir, "lines"), 4, "rolling lines retention");
+        VUNIT_ASSERT_FALSE_LABELED(VFSNode(firstFilePath).exists(), "rolling lines oldest file deleted");
+
+        // Lines are buffered, except that an error is written out right away.
+        VFSNode currentFile(appender.getCurrentFilePath());
+        VUNIT_ASSERT_EQUAL_LABELED(currentFile.size(), CONST_S64(0), "rolling lines buffered");
+        VLOGGER_APPENDER_EMIT(appender, VLoggerLevel::ERROR, "rolling error");
+        VUNIT_ASSERT_TRUE_LABELED(currentFile.size() > CONST_S64(0), "rolling lines error written");
+
+        // The command API finds the appender by name.
+        VLogAppenderPtr registered(new VRollingFileLogAppender("rolling-command", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), testDir.getPath(), "command", 0));
+        VLogger::registerLogAppender(registered);
+        VLogger::commandRollAppender("rolling-command");
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<VRollingFileLogAppender*>(registered.get())->getNumRolls(), 1, "rolling command roll");
+        VLogger::deregisterLogAppender(registered);
+    }
+
+    // The current file is written out when the appender is destroyed.
+    {
+        VStringVector fileNames;
+        testDir.list(fileNames);
+        std::sort(fileNames.begin(), fileNames.end());
+        VString lastLinesFileName;
+        for (VStringVector::const_iterator i = fileNames.begin(); i != fileNames.end(); ++i) {
+            if ((*i).startsWith("lines-")) {
+                lastLinesFileName = *i;
+            }
+        }
+
+        VBufferedFileStream fs(VFSNode(testDir, lastLinesFileName));
+        fs.openReadOnly();
+        VTextIOStream in(fs);
+        VStringVector lines;
+        try {
+            for (;;) {
+                VString line;
+                in.readLine(line);
+                lines.push_back(line);
+            }
+        } catch (const VEOFException& /*ex*/) {}
+
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(lines.size()), 51, "rolling lines last file line count");
+        VUNIT_ASSERT_EQUAL_LABELED(lines.front(), VString("line 400"), "rolling lines first line of last file");
+        VUNIT_ASSERT_EQUAL_LABELED(lines.back(), VString("rolling error"), "rolling lines last line of last file");
+    }
+
+    // Roll by size; each file holds about 1KB. The buffer writes out whenever it fills in between.
+    {
+        VRollingFileLogAppender appender("rolling-size", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), testDir.getPath(), "size", 0);
+        appender.setRollLimits(0, 1024, VDuration::ZERO());
+        VString filler;
+        for (int i = 0; i < 90; ++i) {
+            filler += 'x';
+        }
+
+        for (int i = 0; i < 100; ++i) {
+            appender.emitRaw(filler);
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(appender.getNumRolls(), 8, "rolling size num rolls");
+        appender.drainHousekeeping();
+        VUNIT_ASSERT_EQUAL_LABELED(_countRollingFiles(testDir, "size"), 9, "rolling size no retention limit");
+    }
+
+    // Two appenders in one directory whose prefixes overlap: retention and compression for "app" must not touch "app-debug" files.
+    {
+        VRollingFileLogAppender debugAppender("rolling-app-debug", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), testDir.getPath(), "app-debug", 10);
+        for (int i = 0; i < 35; ++i) {
+            debugAppender.emitRaw(VSTRING_FORMAT("debug line %d", i));
+        }
+
+        debugAppender.drainHousekeeping();
+        const int numDebugFiles = _countRollingFiles(testDir, "app-debug");
+        VUNIT_ASSERT_EQUAL_LABELED(numDebugFiles, 4, "rolling overlapping prefix other appender's files");
+
+        VRollingFileLogAppender appAppender("rolling-app", VLogAppender::DONT_FORMAT_OUTPUT, VString::EMPTY(), VString::EMPTY(), testDir.getPath(), "app", 10);
+        appAppender.setRetention(1, VDuration::ZERO(), true);
+        for (int i = 0; i < 35; ++i) {
+            appAppender.emitRaw(VSTRING_FORMAT("app line %d", i));
+        }
+
+        appAppender.drainHousekeeping();
+        VUNIT_ASSERT_EQUAL_LABELED(_countRollingFiles(testDir, "app-debug"), numDebugFiles, "rolling overlapping prefix other appender's files kept");
+        VUNIT_ASSERT_EQUAL_LABELED(_countRollingFiles(testDir, "app") - numDebugFiles, 2, "rolling overlapping prefix own retention");
+        VUNIT_ASSERT_TRUE_LABELED(VFSNode(debugAppender.getCurrentFilePath()).exists(), "rolling overlapping prefix other appender's current file kept");
+    }
+
+    // A zero flush interval writes each line right away.
+    {
+        VString settingsText(VSTRING_FORMAT("<appender name=\"rolling-unbuffered\" kind=\"rolling-file\" dir=\"%s\" prefix=\"unbuffered\" flush-ms=\"0\" />", testDir.getPath().chars()));
+        VMemoryStream buf(settingsText.getDataBuffer(), VMemoryStream::kAllocatedByOperatorNew, false, settingsText.length(), settingsText.length());
+        VTextIOStream in(buf);
+        VSettings settings(in);
+        VSettings emptyDefaults;
+
+        VRollingFileLogAppender appender(*settings.findNode("appender"), emptyDefaults);
+        appender.emitRaw("unbuffered line");
+        VUNIT_ASSERT_TRUE_LABELED(VFSNode(appender.getCurrentFilePath()).size() > CONST_S64(0), "rolling zero flush interval line written");
+    }
+
+    (void) testDir.rm();
+}
+
+// The built-in appender factories are only registered by VLogger::configure(), so the binary appender test registers its own.
+class VLoggerUnitBinaryAppenderFactory : public VLogAppenderFactory {
+    public:
+        VLoggerUnitBinaryAppenderFactory() : VLogAppenderFactory() {}
+        virtual ~VLoggerUnitBinaryAppenderFactory() {}
+
+        virtual VLogAppenderPtr instantiateLogAppender(const VSettingsNode& settings, const VSettingsNode& defaults) const
+            { return VLogAppenderPtr(new VBinaryLogAppender(settings, defaults)); }
+        virtual void addInfo(VBentoNode& infoNode) const
+            { infoNode.addString("type", "VLoggerUnitBinaryAppenderFactory"); }
+};
+
+// Reads the binary log file with the reader as configured, and returns the number of messages that match.
+static int _countBinaryLogRecords(VBinaryLogReader& reader) {
+    int numRecords = 0;
+    VBinaryLogRecord record;
+    while (reader.readNext(record)) {
+        ++numRecords;
+    }
+
+    return numRecords;
+}
+
+void VLoggerUnit::_testBinaryLogAppender() {
+    VFSNode testDir(VFSNode::getKnownDirectoryNode(VFSNode::CACHED_DATA_DIRECTORY, "vault", "unittest"), "vloggertest_binary");
+    (void) testDir.rm();
+    VFSNode logFile(testDir, "binary.vblog");
+
+    // 100 messages in segments of 10: 50 to "app.db" at INFO, then 50 to "app.net" at DEBUG, one of which is an error with a payload.
+    {
+        VLogAppenderPtr appender(new VBinaryLogAppender("binary", logFile.getPath(), 10));
+        VNamedLoggerPtr netLogger(new VNamedLogger("app.net", VLoggerLevel::TRACE, VStringVector(), appender));
+
+        for (int i = 0; i < 50; ++i) {
+            appender->emit(VLoggerLevel::INFO, NULL, 0, true, VSTRING_FORMAT("db %d", i), VString::EMPTY(), "app.db", false, VString::EMPTY());
+        }
+
+        for (int i = 50; i < 100; ++i) {
+            if (i == 75) {
+                VBentoNode payload("payload");
+                payload.addInt("i", i);
+                payload.addString("peer", "10.0.0.1");
+                netLogger->logBento(VLoggerLevel::ERROR, "net failure", VString::EMPTY(), payload);
+            } else {
+                netLogger->log(VLoggerLevel::DEBUG, VSTRING_FORMAT("net %d", i));
+            }
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<VBinaryLogAppender*>(appender.get())->getNumSegments(), 10, "binary log segments");
+    }
+
+    // Read everything back.
+    {
+        VBinaryLogReader reader(logFile);
+        VBinaryLogRecord record;
+        int numRecords = 0;
+        while (reader.readNext(record)) {
+            if (numRecords == 0) {
+                VUNIT_ASSERT_EQUAL_LABELED(record.mMessage, "db 0", "binary log first message");
+                VUNIT_ASSERT_EQUAL_LABELED(record.mLoggerName, "app.db", "binary log first logger");
+                VUNIT_ASSERT_EQUAL_LABELED(record.mLevel, VLoggerLevel::INFO, "binary log first level");
+                VUNIT_ASSERT_EQUAL_LABELED(record.mThreadName, VThread::getCurrentThreadName(), "binary log thread name");
+            } else if (numRecords == 75) {
+                VUNIT_ASSERT_EQUAL_LABELED(record.mMessage, "net failure", "binary log payload message");
+                VUNIT_ASSERT_TRUE_LABELED(record.mHasPayload, "binary log has payload");
+                VUNIT_ASSERT_EQUAL_LABELED(record.mPayload.getInt("i"), 75, "binary log payload int");
+                VUNIT_ASSERT_EQUAL_LABELED(record.mPayload.getString("peer"), "10.0.0.1", "binary log payload string");
+            }
+
+            ++numRecords;
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(numRecords, 100, "binary log all records");
+        VUNIT_ASSERT_EQUAL_LABELED(reader.getNumSegmentsSkipped(), 0, "binary log no filter skips nothing");
+        VUNIT_ASSERT_FALSE_LABELED(reader.isTruncated(), "binary log not truncated");
+    }
+
+    // Filters skip the segments that cannot match, using their index.
+    {
+        VBinaryLogReader reader(logFile);
+        reader.setLoggerName("app.db");
+        VUNIT_ASSERT_EQUAL_LABELED(_countBinaryLogRecords(reader), 50, "binary log logger filter");
+        VUNIT_ASSERT_TRUE_LABELED(reader.getNumSegmentsSkipped() >= 5, "binary log logger filter skips segments");
+    }
+    {
+        VBinaryLogReader reader(logFile);
+        reader.setLoggerName("app");
+        VUNIT_ASSERT_EQUAL_LABELED(_countBinaryLogRecords(reader), 100, "binary log logger prefix filter");
+    }
+    {
+        VBinaryLogReader reader(logFile);
+        reader.setMaxLevel(VLoggerLevel::WARN);
+        VUNIT_ASSERT_EQUAL_LABELED(_countBinaryLogRecords(reader), 1, "binary log level filter");
+        VUNIT_ASSERT_EQUAL_LABELED(reader.getNumSegmentsSkipped(), 9, "binary log level filter skips segments");
+    }
+    {
+        VBinaryLogReader reader(logFile);
+        reader.setTimeRange(VInstant() + VDuration::HOUR(), VInstant::INFINITE_FUTURE());
+        VUNIT_ASSERT_EQUAL_LABELED(_countBinaryLogRecords(reader), 0, "binary log time filter");
+        VUNIT_ASSERT_EQUAL_LABELED(reader.getNumSegmentsSkipped(), 10, "binary log time filter skips segments");
+    }
+
+    // A second appender appends, with its own name definitions.
+    {
+        VBinaryLogAppender appender("binary", logFile.getPath(), 10);
+        VLOGGER_APPENDER_EMIT(appender, VLoggerLevel::INFO, "appended");
+    }
+    {
+        VBinaryLogReader reader(logFile);
+        reader.setLoggerName("app.net");
+        VUNIT_ASSERT_EQUAL_LABELED(_countBinaryLogRecords(reader), 50, "binary log logger filter after append");
+    }
+
+    // Damage in the middle of the file costs the rest of that segment; a partial record at the end is ignored.
+    {
+        VDirectIOFileStream damage(logFile);
+        damage.openReadWrite();
+        (void) damage.seek(logFile.size() / 2, SEEK_SET);
+        const Vu8 garbage[16] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+        (void) damage.write(garbage, sizeof(garbage));
+        (void) damage.seek(0, SEEK_END);
+        (void) damage.write(garbage, 3);
+        damage.close();
+
+        VBinaryLogReader reader(logFile);
+        const int numRecords = _countBinaryLogRecords(reader);
+        VUNIT_ASSERT_TRUE_LABELED((numRecords >= 90) && (numRecords < 101), VSTRING_FORMAT("binary log records after damage (%d)", numRecords));
+        VUNIT_ASSERT_TRUE_LABELED(reader.getNumResyncs() > 0, "binary log resync after damage");
+        VUNIT_ASSERT_TRUE_LABELED(reader.isTruncated(), "binary log truncated");
+    }
+
+    // The flush thread writes the last record once it has waited the flush interval, with no further messages
+    // to trigger it. VLogger ignores the "async" setting for the binary kind, which would lose each record's level and logger.
+    {
+        VFSNode idleFile(testDir, "idle.vblog");
+        VString settingsText(VSTRING_FORMAT("<appender name=\"binary-idle\" kind=\"binary\" path=\"%s\" flush-ms=\"20\" async=\"true\" />", idleFile.getPath().chars()));
+        VMemoryStream buf(settingsText.getDataBuffer(), VMemoryStream::kAllocatedByOperatorNew, false, settingsText.length(), settingsText.length());
+        VTextIOStream in(buf);
+        VSettings settings(in);
+        VSettings emptyDefaults;
+
+        VLogger::registerLogAppenderFactory("binary", VLogAppenderFactoryPtr(new VLoggerUnitBinaryAppenderFactory()));
+        VLogger::installNewLogAppender(*settings.findNode("appender"), emptyDefaults);
+        VLogAppenderPtr appender = VLogger::findAppender("binary-idle");
+        VUNIT_ASSERT_TRUE_LABELED(dynamic_cast<VBinaryLogAppender*>(appender.get()) != NULL, "binary log async setting ignored");
+
+        appender->emit(VLoggerLevel::INFO, NULL, 0, true, "idle tail", VString::EMPTY(), "app.idle", false, VString::EMPTY());
+        int numRecords = 0;
+        for (int i = 0; (i < 200) && (numRecords == 0); ++i) {
+            VThread::sleep(10 * VDuration::MILLISECOND());
+            VBinaryLogReader reader(idleFile);
+            numRecords = _countBinaryLogRecords(reader);
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(numRecords, 1, "binary log idle tail flushed");
+
+        VLogger::deregisterLogAppender(appender);
+    }
+
+    (void) testDir.rm();
+}
+
+void VLoggerUnit::_testFormatSpec() {
+    // Each variable, repeated variables, and stray '$' characters, which are literal text.
+    {
+        VStringVectorLogAppender appender("format-fields", VLogAppender::DO_FORMAT_OUTPUT, "$level|$specifiedlogger>$actuallogger|$location$message|$message|$$price|$", VString::EMPTY(), NULL);
+        appender.emit(VLoggerLevel::INFO, NULL, 0, true, "hello $level", "specified", "actual", false, VString::EMPTY());
+        appender.emit(VLoggerLevel::ERROR, "file.cpp", 12, true, "oops", "specified", "actual", false, VString::EMPTY());
+        appender.emit(VLoggerLevel::INFO, NULL, 0, false, VString::EMPTY(), VString::EMPTY(), VString::EMPTY(), true, "raw $level");
+        const VStringVector& lines = appender.getLines();
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(lines.size()), 3, "number of lines");
+        if (lines.size() == 3) {
+            VUNIT_ASSERT_EQUAL_LABELED(lines[0], "INFO |specified>actual|hello $level|hello $level|$$price|$", "fields");
+            VUNIT_ASSERT_EQUAL_LABELED(lines[1], "ERROR|specified>actual|@ file.cpp:12: oops|oops|$$price|$", "fields with location");
+            VUNIT_ASSERT_EQUAL_LABELED(lines[2], "raw $level", "raw line is not formatted");
+        }
+    }
+
+    // Time stamps, both with and without milliseconds, which determines how long a formatted time stamp is reused.
+    const char* timeFormats[] = { "y-MM-dd HH:mm:ss.SSS", "'Second' ss 'of' HH:mm" };
+    for (int i = 0; i < 2; ++i) {
+        VStringVectorLogAppender appender("format-time", VLogAppender::DO_FORMAT_OUTPUT, "$utctime $localtime", timeFormats[i], NULL);
+        VInstantFormatter formatter(timeFormats[i]);
+        for (int j = 0; j < 3; ++j) {
+            VInstant before;
+            appender.emit(VLoggerLevel::INFO, NULL, 0, true, "x", VString::EMPTY(), VString::EMPTY(), false, VString::EMPTY());
+            VInstant after;
+            const VString& line = appender.getLines().back();
+            VString expectedBefore = before.getUTCString(formatter) + " " + before.getLocalString(formatter);
+            VString expectedAfter = after.getUTCString(formatter) + " " + after.getLocalString(formatter);
+            VUNIT_ASSERT_TRUE_LABELED((line == expectedBefore) || (line == expectedAfter), VSTRING_FORMAT("time stamp '%s'", line.chars()));
+        }
+    }
+}
+
 void VLoggerUnit::_testOptimizationPerformance() {
     const int numIterations = 10000000;
     const VString loggerName("speed-test-logger");
@@ -41,7 +41,13 @@ class VLoggerUnit : public VUnit {
         void _testStringLoggers();
         void _testMaxActiveLogLevel();
         void _testLoggerPathNames();
+        void _testCallSiteCache();
+        void _testThrottling();
         void _testSmartPtrLifecycle();
+        void _testAsyncAppender();
+        void _testRollingFileAppender();
+        void _testBinaryLogAppender();
+        void _testFormatSpec();
         void _testOptimizationPerformance();
 
 };
@@ -11,6 +11,10 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 
 #include "vmessage.h"
 #include "vcompactingdeque.h"
+#include "vmessagequeue.h"
+#include "vthread.h"
+
+#include <algorithm>
 
 class TestMessage;
 typedef VSharedPtr<TestMessage> TestMessagePtr;
@@ -88,6 +92,47 @@ class TestMessageFactory : public VMessageFactory {
         virtual VMessagePtr instantiateNewMessage(VMessageID messageID) const { return TestMessage::factory(messageID); }
 };
 
+/**
+Takes messages off a queue with blockUntilNextMessage(), and records for each one how long after
+its posting it was received, in nanoseconds, for the message queue wake latency test. The message ID is the index
+of the message's post time in the shared array.
+*/
+class TestMessageQueueConsumerThread : public VThread {
+    public:
+
+        TestMessageQueueConsumerThread(VMessageQueue& queue, const volatile Vs64* postTimes, Vs64* wakeDelays, int numMessages) :
+            VThread("TestMessageQueueConsumerThread", "vault.messages.TestMessageQueueConsumerThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mQueue(queue),
+            mPostTimes(postTimes),
+            mWakeDelays(wakeDelays),
+            mNumMessages(numMessages) {
+        }
+
+        virtual ~TestMessageQueueConsumerThread() {}
+
+        virtual void run() {
+            int numReceived = 0;
+            while ((numReceived < mNumMessages) && this->isRunning()) {
+                VMessagePtr message = mQueue.blockUntilNextMessage();
+                if (message != nullptr) {
+                    const int index = message->getMessageID();
+                    mWakeDelays[index] = VTicks::snapshot() - mPostTimes[index];
+                    ++numReceived;
+                }
+            }
+        }
+
+    private:
+
+        TestMessageQueueConsumerThread(const TestMessageQueueConsumerThread&); // not copyable
+        TestMessageQueueConsumerThread& operator=(const TestMessageQueueConsumerThread&); // not assignable
+
+        VMessageQueue&          mQueue;
+        const volatile Vs64*    mPostTimes;
+        Vs64*                   mWakeDelays;
+        int                     mNumMessages;
+};
+
 VMessageUnit::VMessageUnit(bool logOnSuccess, bool throwOnError) :
     VUnit("VMessageUnit", logOnSuccess, throwOnError) {
 }
@@ -156,5 +201,91 @@ void VMessageUnit::run() {
     VUNIT_ASSERT_EQUAL(q.mHighWaterMark, (size_t) 4); // <- verifies that pop_back updated mHighWaterMark to max before pop
     VUNIT_ASSERT_EQUAL(q.mHighWaterMarkRequired, HWM);
     VUNIT_ASSERT_EQUAL(q.mLowWaterMarkRequired, LWM);
+
+    this->_testMessageQueueWakeLatency();
+}
+
+void VMessageUnit::_testMessageQueueWakeLatency() {
+    VMessageQueue queue;
+
+    // A wakeUp() before the consumer blocks must not be lost. Before VMessageQueue used VEvent,
+    // this waited out the full 5-second safety timeout.
+    queue.wakeUp();
+    Vs64 start = VInstant::snapshot();
+    VMessagePtr message = queue.blockUntilNextMessage();
+    VUNIT_ASSERT_TRUE_LABELED(message == nullptr, "wakeUp before block returns no message");
+    VUNIT_ASSERT_TRUE_LABELED(VInstant::snapshot() - start < 1000, "wakeUp before block is not lost");
+
+    // Post messages at intervals to a consumer that blocks between them, and measure how long each
+    // takes to reach it. A wake-up costs microseconds, so the 99th percentile must be within a few
+    // milliseconds; a polling or timeout interval would push it well past that.
+    const int kNumMessages = 200;
+    volatile Vs64 postTimes[kNumMessages];
+    Vs64 wakeDelays[kNumMessages];
+    for (int i = 0; i < kNumMessages; ++i) {
+        postTimes[i] = 0;
+        wakeDelays[i] = -1;
+    }
+
+    TestMessageQueueConsumerThread consumer(queue, postTimes, wakeDelays, kNumMessages);
+    consumer.start();
+
+    for (int i = 0; i < kNumMessages; ++i) {
+        VThread::sleep(VDuration::MILLISECOND()); // let the consumer block on the empty queue
+        postTimes[i] = VTicks::snapshot();
+        queue.postMessage(TestMessage::factory(i));
+    }
+
+    consumer.join();
+
+    std::vector<Vs64> delays(wakeDelays, wakeDelays + kNumMessages);
+    std::sort(delays.begin(), delays.end());
+    VUNIT_ASSERT_TRUE_LABELED(delays.front() >= 0, "message queue consumer received every message");
+    this->logStatus(VSTRING_FORMAT("message queue wake latency: %d messages, median %s, 99th percentile %s, max %s.",
+                                   kNumMessages, VTicks::getDurationString(delays[kNumMessages / 2]).chars(), VTicks::getDurationString(delays[(kNumMessages * 99) / 100]).chars(), VTicks::getDurationString(delays.back()).chars()));
+    VUNIT_ASSERT_TRUE_LABELED(delays[(kNumMessages * 99) / 100] < 3 * VTicks::kNanosecondsPerMillisecond, "message queue 99th percentile wake latency under 3ms");
+    // The worst case is only a guard against a lost wake-up. It is loose because a busy machine can deschedule
+    // the consumer for a whole time slice or more, which says nothing about the queue.
+    VUNIT_ASSERT_TRUE_LABELED(delays.back() < 100 * VTicks::kNanosecondsPerMillisecond, "message queue worst-case wake latency under 100ms");
+
+    // A burst of posts to several blocked consumers must reach them all promptly, although the event
+    // coalesces posts that arrive before a woken consumer has cleared it; left alone, the consumers that
+    // missed out would wait out the timeout. The coalescing is a race, so try a number of bursts.
+    const int kNumConsumers = 8;
+    const int kNumBursts = 20;
+    volatile Vs64 burstPostTimes[kNumConsumers];
+    Vs64 burstWakeDelays[kNumConsumers];
+    Vs64 maxBurstDelay = 0;
+    bool allReceived = true;
+    for (int burst = 0; burst < kNumBursts; ++burst) {
+        std::vector<TestMessageQueueConsumerThread*> consumers;
+        std::vector<VMessagePtr> burstMessages;
+        for (int i = 0; i < kNumConsumers; ++i) {
+            burstPostTimes[i] = 0;
+            burstWakeDelays[i] = -1;
+            burstMessages.push_back(TestMessage::factory(i));
+            consumers.push_back(new TestMessageQueueConsumerThread(queue, burstPostTimes, burstWakeDelays, 1));
+            consumers.back()->start();
+        }
+
+        VThread::sleep(20 * VDuration::MILLISECOND()); // let the consumers block on the empty queue
+        for (int i = 0; i < kNumConsumers; ++i) {
+            burstPostTimes[i] = VTicks::snapshot();
+            queue.postMessage(burstMessages[i]);
+        }
+
+        for (std::vector<TestMessageQueueConsumerThread*>::const_iterator i = consumers.begin(); i != consumers.end(); ++i) {
+            (*i)->join();
+            delete *i;
+        }
+
+        for (int i = 0; i < kNumConsumers; ++i) {
+            allReceived = allReceived && (burstWakeDelays[i] >= 0);
+            maxBurstDelay = V_MAX(maxBurstDelay, burstWakeDelays[i]);
+        }
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(allReceived, "message queue consumers each received a message");
+    VUNIT_ASSERT_TRUE_LABELED(maxBurstDelay < 1000 * VTicks::kNanosecondsPerMillisecond, "message queue burst wakes every consumer");
 }
 
@@ -34,6 +34,10 @@ class VMessageUnit : public VUnit {
         */
         virtual void run();
 
+    private:
+
+        void _testMessageQueueWakeLatency();
+
 };
 
 #endif /* vmessageunit_h */
@@ -10,8 +10,10 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vstreamsunit.h"
 
 #include "vwritebufferedstream.h"
+#include "vreadbufferedstream.h"
 #include "vbinaryiostream.h"
 #include "vstreamcopier.h"
+#include "vtextiostream.h"
 #include "vexception.h"
 
 #include "vtextstreamtailer.h"
@@ -33,6 +35,9 @@ void VStreamsUnit::run() {
     // of two memory streams for equality.
 
     this->_testWriteBufferedStream();
+    this->_testReadBufferedStream();
+    this->_testTextLineReading();
+    this->_testTryReads();
     this->_testStreamCopier();
     this->_testBufferOwnership();
     this->_testReadOnlyStream();
@@ -71,6 +76,213 @@ void VStreamsUnit::_testWriteBufferedStream() {
     VUNIT_ASSERT_EQUAL_LABELED(verifier.readS32(), 2468, "write-buffered stream check 5");
 }
 
+void VStreamsUnit::_testReadBufferedStream() {
+    // Test VReadBufferedStream. We'll have it buffer from a memory stream
+    // so we don't need a socket. We use a buffer size of 16 bytes so that
+    // we exercise refilling, compacting, and reads that bypass the buffer.
+
+    VMemoryStream   rawStream;
+    VBinaryIOStream rawIO(rawStream);
+    for (int i = 0; i < 10; ++i) {
+        rawIO.writeS32(i);
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        rawIO.writeU8(static_cast<Vu8>(i));
+    }
+
+    rawIO.writeS32(1234);
+    rawStream.seek0();
+
+    VReadBufferedStream bufferedStream(rawStream, 16);
+    VBinaryIOStream     io(bufferedStream);
+
+    bool allIntsMatched = true;
+    for (int i = 0; i < 10; ++i) {
+        allIntsMatched = allIntsMatched && (io.readS32() == i);
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(allIntsMatched, "read-buffered stream small reads");
+    VUNIT_ASSERT_EQUAL_LABELED(io.getIOOffset(), CONST_S64(40), "read-buffered stream offset");
+
+    // Copy the 100-byte blob out; it's bigger than the buffer, so streamCopy has to come back for more.
+    VMemoryStream blob;
+    Vs64 numBytesCopied = VStream::streamCopy(io, blob, 100);
+    VUNIT_ASSERT_EQUAL_LABELED(numBytesCopied, CONST_S64(100), "read-buffered stream copy count");
+    bool allBytesMatched = (blob.getEOFOffset() == 100);
+    for (int i = 0; allBytesMatched && (i < 100); ++i) {
+        allBytesMatched = (blob.getBuffer()[i] == static_cast<Vu8>(i));
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(allBytesMatched, "read-buffered stream copy content");
+    VUNIT_ASSERT_EQUAL_LABELED(io.readS32(), 1234, "read-buffered stream read after copy");
+    VUNIT_ASSERT_EQUAL_LABELED(io.available(), CONST_S64(0), "read-buffered stream available at end");
+
+    // Seek back and read a large chunk, which should bypass the buffer once it has been drained.
+    io.seek(-144, SEEK_CUR);
+    VUNIT_ASSERT_EQUAL_LABELED(io.readS32(), 0, "read-buffered stream read after seek");
+    Vu8 largeRead[60];
+    io.readGuaranteed(largeRead, 60);
+    VUNIT_ASSERT_TRUE_LABELED((largeRead[3] == 1) && (largeRead[7] == 2) && (largeRead[35] == 9) && (largeRead[36] == 0) && (largeRead[59] == 23), "read-buffered stream large read");
+    VUNIT_ASSERT_TRUE_LABELED(io.skip(76), "read-buffered stream skip");
+    VUNIT_ASSERT_EQUAL_LABELED(io.readS32(), 1234, "read-buffered stream read after skip");
+
+    // Writes go straight through to the raw stream.
+    io.writeS32(5678);
+    VUNIT_ASSERT_EQUAL_LABELED(rawStream.getEOFOffset(), CONST_S64(148), "read-buffered stream write-through");
+
+    try {
+        (void) io.readS32();
+        VUNIT_ASSERT_FAILURE("EOF was not thrown on read-buffered read past EOF");
+    } catch (const VEOFException& /*ex*/) {
+        VUNIT_ASSERT_SUCCESS("EOF thrown on read-buffered read past EOF");
+    }
+}
+
+/**
+A stream that reads from a memory stream but does not expose its buffer, so
+that VTextIOStream::readLine() has to read it one code point at a time.
+*/
+class VUnbufferedMemoryStream : public VStream {
+    public:
+        VUnbufferedMemoryStream(VMemoryStream& memoryStream) : VStream("unbuffered"), mMemoryStream(memoryStream) {}
+        virtual ~VUnbufferedMemoryStream() {}
+        virtual Vs64 read(Vu8* targetBuffer, Vs64 numBytesToRead) { return mMemoryStream.read(targetBuffer, numBytesToRead); }
+        virtual Vs64 write(const Vu8* buffer, Vs64 numBytesToWrite) { return mMemoryStream.write(buffer, numBytesToWrite); }
+        virtual void flush() { mMemoryStream.flush(); }
+        virtual bool skip(Vs64 numBytesToSkip) { return mMemoryStream.skip(numBytesToSkip); }
+        virtual bool seek(Vs64 offset, int whence) { return mMemoryStream.seek(offset, whence); }
+        virtual Vs64 getIOOffset() const { return mMemoryStream.getIOOffset(); }
+        virtual Vs64 available() const { return mMemoryStream.available(); }
+    private:
+        VUnbufferedMemoryStream(const VUnbufferedMemoryStream&); // not copyable
+        VUnbufferedMemoryStream& operator=(const VUnbufferedMemoryStream&); // not assignable
+        VMemoryStream& mMemoryStream;
+};
+
+static void _readAllLines(VStream& rawStream, bool includeLineEndings, VStringVector& lines, int& lineEndingsReadKind) {
+    VTextIOStream in(rawStream);
+    try {
+        VString line;
+        for (;;) {
+            in.readLine(line, includeLineEndings);
+            lines.push_back(line);
+        }
+    } catch (const VEOFException& /*ex*/) {}
+
+    lineEndingsReadKind = in.getLineEndingsReadKind();
+}
+
+void VStreamsUnit::_testTextLineReading() {
+    // readLine() scans the raw stream's buffer if it has one, and otherwise reads a code point at a time.
+    // Verify that both ways produce the same lines, including across VReadBufferedStream refills.
+    const char kText[] =
+        "alpha\n"
+        "beta\r\n"
+        "gamma\r"
+        "delta \xC3\xA9t\xC3\xA9\n"
+        "\xE2\x82\xAC euro \xF0\x9F\x98\x80\r\n"
+        "\n"
+        "overlong \xC0\xAF slash\n"
+        "\r\r"
+        "a line that is longer than the read buffer used below\r\n"
+        "last";
+
+    for (int includeLineEndings = 0; includeLineEndings <= 1; ++includeLineEndings) {
+        VMemoryStream memoryStream;
+        (void) memoryStream.write(reinterpret_cast<const Vu8*>(kText), static_cast<Vs64>(sizeof(kText) - 1));
+
+        VStringVector unbufferedLines;
+        int unbufferedReadKind;
+        memoryStream.seek0();
+        VUnbufferedMemoryStream unbufferedStream(memoryStream);
+        _readAllLines(unbufferedStream, includeLineEndings != 0, unbufferedLines, unbufferedReadKind);
+
+        VStringVector memoryLines;
+        int memoryReadKind;
+        memoryStream.seek0();
+        _readAllLines(memoryStream, includeLineEndings != 0, memoryLines, memoryReadKind);
+
+        VStringVector bufferedLines;
+        int bufferedReadKind;
+        memoryStream.seek0();
+        VReadBufferedStream bufferedStream(memoryStream, 7);
+        _readAllLines(bufferedStream, includeLineEndings != 0, bufferedLines, bufferedReadKind);
+
+        VString label = includeLineEndings ? "with line endings" : "without line endings";
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(unbufferedLines.size()), 11, VSTRING_FORMAT("readLine by code point line count %s", label.chars()));
+        VUNIT_ASSERT_TRUE_LABELED(memoryLines == unbufferedLines, VSTRING_FORMAT("readLine from memory buffer matches code point reader %s", label.chars()));
+        VUNIT_ASSERT_TRUE_LABELED(bufferedLines == unbufferedLines, VSTRING_FORMAT("readLine from read buffer matches code point reader %s", label.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(unbufferedReadKind, static_cast<int>(VTextIOStream::kLineEndingsMixed), VSTRING_FORMAT("readLine by code point line endings kind %s", label.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(memoryReadKind, unbufferedReadKind, VSTRING_FORMAT("readLine from memory buffer line endings kind %s", label.chars()));
+        VUNIT_ASSERT_EQUAL_LABELED(bufferedReadKind, unbufferedReadKind, VSTRING_FORMAT("readLine from read buffer line endings kind %s", label.chars()));
+
+        if (memoryLines.size() == 11) {
+            VUNIT_ASSERT_EQUAL_LABELED(memoryLines[2], VString(includeLineEndings ? "gamma\r" : "gamma"), "readLine Mac line ending");
+            VUNIT_ASSERT_EQUAL_LABELED(memoryLines[3], VString(includeLineEndings ? "delta \xC3\xA9t\xC3\xA9\n" : "delta \xC3\xA9t\xC3\xA9"), "readLine UTF-8 line");
+            VUNIT_ASSERT_EQUAL_LABELED(memoryLines[10], VString("last"), "readLine last line without line ending");
+        }
+    }
+
+    // A single kind of line ending is detected as such.
+    VMemoryStream dosStream;
+    VTextIOStream dosWriter(dosStream, VTextIOStream::kUseDOSLineEndings);
+    dosWriter.writeLine("one");
+    dosWriter.writeLine("two");
+    dosStream.seek0();
+    VStringVector dosLines;
+    int dosReadKind;
+    _readAllLines(dosStream, false, dosLines, dosReadKind);
+    VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(dosLines.size()), 2, "readLine DOS line count");
+    VUNIT_ASSERT_EQUAL_LABELED(dosReadKind, static_cast<int>(VTextIOStream::kLineEndingsDOS), "readLine DOS line endings kind");
+}
+
+void VStreamsUnit::_testTryReads() {
+    // The try variants report a clean EOF by returning false, leaving the value alone,
+    // but still throw if the stream ends partway through a value.
+    VMemoryStream textStream;
+    VTextIOStream textIO(textStream, VTextIOStream::kUseUnixLineEndings);
+    textIO.writeLine("first");
+    textIO.writeString("second");
+    textStream.seek0();
+
+    VString line;
+    VUNIT_ASSERT_TRUE_LABELED(textIO.tryReadLine(line), "tryReadLine first line");
+    VUNIT_ASSERT_EQUAL_LABELED(line, VString("first"), "tryReadLine first line value");
+    VUNIT_ASSERT_TRUE_LABELED(textIO.tryReadLine(line), "tryReadLine last line");
+    VUNIT_ASSERT_EQUAL_LABELED(line, VString("second"), "tryReadLine last line value");
+    VUNIT_ASSERT_FALSE_LABELED(textIO.tryReadLine(line), "tryReadLine at EOF");
+    VUNIT_ASSERT_EQUAL_LABELED(line, VString("second"), "tryReadLine at EOF leaves line unchanged");
+
+    VMemoryStream binaryStream;
+    VBinaryIOStream binaryIO(binaryStream);
+    binaryIO.writeS32(-42);
+    binaryIO.writeString("hello");
+    binaryIO.writeU8(1);
+    binaryStream.seek0();
+
+    Vs32 s32Value = 0;
+    VString stringValue;
+    VUNIT_ASSERT_TRUE_LABELED(binaryIO.tryReadS32(s32Value), "tryReadS32");
+    VUNIT_ASSERT_EQUAL_LABELED(s32Value, static_cast<Vs32>(-42), "tryReadS32 value");
+    VUNIT_ASSERT_TRUE_LABELED(binaryIO.tryReadString(stringValue), "tryReadString");
+    VUNIT_ASSERT_EQUAL_LABELED(stringValue, VString("hello"), "tryReadString value");
+
+    bool threwEOF = false;
+    try {
+        (void) binaryIO.tryReadS32(s32Value); // only 1 of 4 bytes remain
+    } catch (const VEOFException& /*ex*/) {
+        threwEOF = true;
+    }
+    VUNIT_ASSERT_TRUE_LABELED(threwEOF, "tryReadS32 throws on a truncated value");
+
+    VUNIT_ASSERT_FALSE_LABELED(binaryIO.tryReadS32(s32Value), "tryReadS32 at EOF");
+    VUNIT_ASSERT_EQUAL_LABELED(s32Value, static_cast<Vs32>(-42), "tryReadS32 at EOF leaves value unchanged");
+    VUNIT_ASSERT_FALSE_LABELED(binaryIO.tryReadString(stringValue), "tryReadString at EOF");
+    Vu8 buffer[4];
+    VUNIT_ASSERT_FALSE_LABELED(binaryIO.tryReadBuffer(buffer, 4), "tryReadBuffer at EOF");
+}
+
 void VStreamsUnit::_testStreamCopier() {
     // Test VStreamCopier. We'll copy between streams using the different
     // constructor and init forms, and verify the results.
@@ -37,6 +37,9 @@ class VStreamsUnit : public VUnit {
     private:
 
         void _testWriteBufferedStream();
+        void _testReadBufferedStream();
+        void _testTextLineReading();
+        void _testTryReads();
         void _testStreamCopier();
         void _testBufferOwnership();
         void _testReadOnlyStream();
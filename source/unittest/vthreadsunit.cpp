@@ -11,9 +11,17 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vthread.h"
 #include "vmutex.h"
 #include "vmutexlocker.h"
+#include "vreadwritelock.h"
+#include "vshardedmutex.h"
 #include "vsemaphore.h"
+#include "vcountingsemaphore.h"
+#include "vtimerwheel.h"
+#include "vthreadpool.h"
+#include "vbento.h"
 #include "vexception.h"
 
+#include <stdio.h>
+
 class TestThreadClass : public VThread {
     public:
 
@@ -79,6 +87,409 @@ void TestThreadClass::run() {
     mOwnerUnit->logStatus(info);
 }
 
+/**
+Repeatedly locks a shared mutex and increments a shared counter, for the contention benchmark.
+*/
+class TestMutexContentionThread : public VThread {
+    public:
+
+        TestMutexContentionThread(const VString& name, VMutex& mutex, int numIterations, volatile Vs64* counter) :
+            VThread(name, "vault.threads.TestMutexContentionThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mMutex(mutex),
+            mNumIterations(numIterations),
+            mCounter(counter) {
+        }
+
+        virtual ~TestMutexContentionThread() {}
+
+        virtual void run() {
+            for (int i = 0; i < mNumIterations; ++i) {
+                VMutexLocker locker(&mMutex, "TestMutexContentionThread::run");
+                *mCounter = *mCounter + 1;
+            }
+        }
+
+    private:
+
+        TestMutexContentionThread(const TestMutexContentionThread&); // not copyable
+        TestMutexContentionThread& operator=(const TestMutexContentionThread&); // not assignable
+
+        VMutex&         mMutex;
+        int             mNumIterations;
+        volatile Vs64*  mCounter;
+};
+
+/**
+Acquires a read-write lock for reading or writing and sets a flag once it has it, for the
+VReadWriteLock exclusion tests.
+*/
+class TestReadWriteLockThread : public VThread {
+    public:
+
+        TestReadWriteLockThread(VReadWriteLock& lock, bool forWriting, volatile bool* acquired) :
+            VThread("TestReadWriteLockThread", "vault.threads.TestReadWriteLockThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mLock(lock),
+            mForWriting(forWriting),
+            mAcquired(acquired) {
+        }
+
+        virtual ~TestReadWriteLockThread() {}
+
+        virtual void run() {
+            if (mForWriting) {
+                VWriteLocker locker(&mLock, "TestReadWriteLockThread::run");
+                *mAcquired = true;
+            } else {
+                VReadLocker locker(&mLock, "TestReadWriteLockThread::run");
+                *mAcquired = true;
+            }
+        }
+
+    private:
+
+        TestReadWriteLockThread(const TestReadWriteLockThread&); // not copyable
+        TestReadWriteLockThread& operator=(const TestReadWriteLockThread&); // not assignable
+
+        VReadWriteLock& mLock;
+        bool            mForWriting;
+        volatile bool*  mAcquired;
+};
+
+/**
+Waits on a VEvent, with a timeout, and records whether it was signaled, for the VEvent tests.
+*/
+class TestEventWaitThread : public VThread {
+    public:
+
+        TestEventWaitThread(VEvent& event, const VDuration& timeout) :
+            VThread("TestEventWaitThread", "vault.threads.TestEventWaitThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mEvent(event),
+            mTimeout(timeout),
+            mSignaled(false) {
+        }
+
+        virtual ~TestEventWaitThread() {}
+
+        virtual void run() {
+            mSignaled = mEvent.timedWait(mTimeout);
+        }
+
+        bool wasSignaled() const { return mSignaled; }
+
+    private:
+
+        TestEventWaitThread(const TestEventWaitThread&); // not copyable
+        TestEventWaitThread& operator=(const TestEventWaitThread&); // not assignable
+
+        VEvent&         mEvent;
+        VDuration       mTimeout;
+        volatile bool   mSignaled;
+};
+
+/**
+Waits on a VSemaphore until a flag guarded by the mutex is set, for the VSemaphore broadcast test.
+*/
+class TestSemaphoreWaitThread : public VThread {
+    public:
+
+        TestSemaphoreWaitThread(VMutex& mutex, VSemaphore& semaphore, const bool& released, int& numWaiting) :
+            VThread("TestSemaphoreWaitThread", "vault.threads.TestSemaphoreWaitThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mMutex(mutex),
+            mSemaphore(semaphore),
+            mReleased(released),
+            mNumWaiting(numWaiting) {
+        }
+
+        virtual ~TestSemaphoreWaitThread() {}
+
+        virtual void run() {
+            VMutexLocker locker(&mMutex, "TestSemaphoreWaitThread::run");
+            ++mNumWaiting;
+            while (! mReleased) {
+                mSemaphore.wait(&mMutex, 10 * VDuration::SECOND());
+            }
+        }
+
+    private:
+
+        TestSemaphoreWaitThread(const TestSemaphoreWaitThread&); // not copyable
+        TestSemaphoreWaitThread& operator=(const TestSemaphoreWaitThread&); // not assignable
+
+        VMutex&         mMutex;
+        VSemaphore&     mSemaphore;
+        const bool&     mReleased;
+        int&            mNumWaiting;
+};
+
+/**
+Records when it fires, for the VTimerWheel tests. It can cancel itself after a number of firings,
+and can take a while to fire, to test cancelling a task that is firing.
+*/
+class TestTimerTask : public VTimerTask {
+    public:
+
+        TestTimerTask(const VString& name, VTimerWheel& wheel, std::vector<VString>* firingOrder = NULL) :
+            VTimerTask(name),
+            mWheel(wheel),
+            mFiringOrder(firingOrder),
+            mScheduledTicks(),
+            mFirstFireNanoseconds(0),
+            mFireCount(0),
+            mCancelAfterCount(0),
+            mFireDuration(VDuration::ZERO()),
+            mIsFiring(false) {
+        }
+
+        virtual ~TestTimerTask() {
+            this->cancel();
+        }
+
+        virtual void fire() {
+            mIsFiring = true;
+
+            if (mFireCount.fetch_add(1) == 0) {
+                mFirstFireNanoseconds = mScheduledTicks.getNanosecondsSince();
+            }
+
+            if (mFiringOrder != NULL) {
+                mFiringOrder->push_back(this->getName()); // only the wheel thread appends
+            }
+
+            if (mFireCount.load() == mCancelAfterCount) {
+                this->cancel();
+            }
+
+            if (mFireDuration != VDuration::ZERO()) {
+                VThread::sleep(mFireDuration);
+            }
+
+            mIsFiring = false;
+        }
+
+        void schedule(const VDuration& delay, const VDuration& period = VDuration::ZERO()) {
+            mScheduledTicks = VTicks();
+            mWheel.schedule(this, delay, period);
+        }
+
+        VTimerWheel&            mWheel;
+        std::vector<VString>*   mFiringOrder;
+        VTicks                  mScheduledTicks;
+        volatile Vs64           mFirstFireNanoseconds;
+        std::atomic<int>        mFireCount;
+        int                     mCancelAfterCount;
+        VDuration               mFireDuration;
+        volatile bool           mIsFiring;
+
+    private:
+
+        TestTimerTask(const TestTimerTask&); // not copyable
+        TestTimerTask& operator=(const TestTimerTask&); // not assignable
+};
+
+/**
+A VThreadPool task for the pool tests. It counts itself, records the order tasks run in, and can
+wait for a gate, throw, or submit subtasks to its pool and then linger so that they get stolen.
+*/
+class TestPoolTask : public VThreadPoolTask {
+    public:
+
+        TestPoolTask(const VString& name, Priority priority, std::atomic<int>* runCount, std::vector<VString>* runOrder = NULL) :
+            VThreadPoolTask(name, priority),
+            mRunCount(runCount),
+            mRunOrder(runOrder),
+            mGate(NULL),
+            mThrows(false),
+            mPool(NULL),
+            mNumSubtasks(0),
+            mRunDuration(VDuration::ZERO()),
+            mCompletedCalled(false) {
+        }
+
+        virtual ~TestPoolTask() {}
+
+        virtual void run() {
+            mStarted.signal();
+
+            if (mGate != NULL) {
+                (void) mGate->timedWait(VDuration::SECOND()); // gives up after a second if never signaled
+            }
+
+            if (mThrows) {
+                throw VStackTraceException(VSTRING_FORMAT("TestPoolTask %s failed on purpose.", this->getName().chars()));
+            }
+
+            if (mRunOrder != NULL) {
+                mRunOrder->push_back(this->getName()); // only used with a single worker
+            }
+
+            for (int i = 0; i < mNumSubtasks; ++i) {
+                mPool->submit(VThreadPoolTaskPtr(new TestPoolTask(VSTRING_FORMAT("%s.%d", this->getName().chars(), i), kPriorityNormal, mRunCount)));
+            }
+
+            if (mRunDuration != VDuration::ZERO()) {
+                VThread::sleep(mRunDuration);
+            }
+
+            ++(*mRunCount);
+        }
+
+        virtual void completed() {
+            mCompletedCalled = true;
+        }
+
+        std::atomic<int>*       mRunCount;
+        std::vector<VString>*   mRunOrder;
+        VEvent*                 mGate;
+        bool                    mThrows;
+        VThreadPool*            mPool;
+        int                     mNumSubtasks;
+        VDuration               mRunDuration;
+        volatile bool           mCompletedCalled;
+        VEvent                  mStarted;
+
+    private:
+
+        TestPoolTask(const TestPoolTask&); // not copyable
+        TestPoolTask& operator=(const TestPoolTask&); // not assignable
+};
+
+/**
+Waits for a VThreadPool task to complete, with a timeout, for the test of several threads waiting on one task.
+*/
+class TestPoolTaskWaitThread : public VThread {
+    public:
+
+        TestPoolTaskWaitThread(VThreadPoolTaskPtr task) :
+            VThread("TestPoolTaskWaitThread", "vault.threads.TestPoolTaskWaitThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mTask(task),
+            mCompleted(false) {
+        }
+
+        virtual ~TestPoolTaskWaitThread() {}
+
+        virtual void run() {
+            mCompleted = mTask->waitUntilCompleted(10 * VDuration::SECOND());
+        }
+
+        bool sawCompletion() const { return mCompleted; }
+
+    private:
+
+        TestPoolTaskWaitThread(const TestPoolTaskWaitThread&); // not copyable
+        TestPoolTaskWaitThread& operator=(const TestPoolTaskWaitThread&); // not assignable
+
+        VThreadPoolTaskPtr  mTask;
+        volatile bool       mCompleted;
+};
+
+/**
+A thread that does nothing but wait to be released, for measuring what threads themselves cost
+in memory with different options. It notes what it finds as the current thread.
+*/
+class TestIdleThread : public VThread {
+    public:
+
+        TestIdleThread(const VString& name, std::atomic<int>& numStarted, VCountingSemaphore& release) :
+            VThread(name, "vault.threads.TestIdleThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mCurrentThread(NULL),
+            mCurrentThreadName(),
+            mNumStarted(numStarted),
+            mRelease(release) {
+        }
+
+        virtual ~TestIdleThread() {}
+
+        virtual void run() {
+            mCurrentThread = VThread::getCurrentThread();
+            mCurrentThreadName = VThread::getCurrentThreadName();
+            ++mNumStarted;
+            mRelease.wait();
+        }
+
+        VThread*    mCurrentThread;
+        VString     mCurrentThreadName;
+
+    private:
+
+        TestIdleThread(const TestIdleThread&); // not copyable
+        TestIdleThread& operator=(const TestIdleThread&); // not assignable
+
+        std::atomic<int>&   mNumStarted;
+        VCountingSemaphore& mRelease;
+};
+
+static const int kLockScalingTableSize = 64;
+typedef VShardedMutex<16> TestShardedMutex;
+
+/**
+Repeatedly reads a small shared table under a lock, for the lock scaling benchmark. The lock is
+a single mutex, a read-write lock held for reading, or a shard of a sharded mutex picked by a
+per-thread key.
+*/
+class TestLockScalingThread : public VThread {
+    public:
+
+        enum Mode { kLockMutex, kLockForReading, kLockShard };
+
+        TestLockScalingThread(int index, Mode mode, VMutex& mutex, VReadWriteLock& readWriteLock, TestShardedMutex& shardedMutex, const int* table, int numIterations) :
+            VThread(VSTRING_FORMAT("scaling.%d", index), "vault.threads.TestLockScalingThread", kDontDeleteSelfAtEnd, kCreateThreadJoinable, NULL),
+            mIndex(index),
+            mMode(mode),
+            mMutex(mutex),
+            mReadWriteLock(readWriteLock),
+            mShardedMutex(shardedMutex),
+            mTable(table),
+            mNumIterations(numIterations),
+            mSum(0) {
+        }
+
+        virtual ~TestLockScalingThread() {}
+
+        virtual void run() {
+            for (int i = 0; i < mNumIterations; ++i) {
+                switch (mMode) {
+                    case kLockMutex: {
+                        VMutexLocker locker(&mMutex, "TestLockScalingThread::run");
+                        this->_readTable();
+                        break;
+                    }
+                    case kLockForReading: {
+                        VReadLocker locker(&mReadWriteLock, "TestLockScalingThread::run");
+                        this->_readTable();
+                        break;
+                    }
+                    case kLockShard: {
+                        VMutexLocker locker(&mShardedMutex.getMutex(static_cast<Vs64>(mIndex)), "TestLockScalingThread::run");
+                        this->_readTable();
+                        break;
+                    }
+                }
+            }
+        }
+
+        Vs64 getSum() const { return mSum; }
+
+    private:
+
+        TestLockScalingThread(const TestLockScalingThread&); // not copyable
+        TestLockScalingThread& operator=(const TestLockScalingThread&); // not assignable
+
+        void _readTable() {
+            for (int i = 0; i < kLockScalingTableSize; ++i) {
+                mSum += mTable[i];
+            }
+        }
+
+        int                 mIndex;
+        Mode                mMode;
+        VMutex&             mMutex;
+        VReadWriteLock&     mReadWriteLock;
+        TestShardedMutex&   mShardedMutex;
+        const int*          mTable;
+        int                 mNumIterations;
+        Vs64                mSum;
+};
+
 VThreadsUnit::VThreadsUnit(bool logOnSuccess, bool throwOnError) :
     VUnit("VThreadsUnit", logOnSuccess, throwOnError) {
 }
@@ -192,5 +603,727 @@ void VThreadsUnit::run() {
         VUNIT_ASSERT_FALSE_LABELED(mutexX.isLockedByCurrentThread(), "9 - local mutex not locked by current thread");
     }
 
+    this->_testMutexContention();
+    this->_testReadWriteLock();
+    this->_testShardedMutex();
+    this->_testLockScaling();
+    this->_testSemaphoreBroadcast();
+    this->_testCountingSemaphore();
+    this->_testEvent();
+    this->_testTimerWheel();
+    this->_testThreadPool();
+    this->_testThreadOptions();
+    this->_testCurrentThread();
+    this->_testMonotonicWaits();
 }
 
+void VThreadsUnit::_testMutexContention() {
+    // Benchmark: increments of a shared counter under one mutex, by an increasing number of threads.
+    // The counter verifies mutual exclusion; the timings are logged for comparison, not asserted.
+    const int kNumLocksPerThread = 100000;
+    const int kThreadCounts[] = { 1, 2, 4, 8 };
+    VMutex mutex("contention");
+
+    for (size_t t = 0; t < sizeof(kThreadCounts) / sizeof(kThreadCounts[0]); ++t) {
+        const int numThreads = kThreadCounts[t];
+        volatile Vs64 counter = 0;
+
+        std::vector<TestMutexContentionThread*> threads;
+        for (int i = 0; i < numThreads; ++i) {
+            threads.push_back(new TestMutexContentionThread(VSTRING_FORMAT("contention.%d", i), mutex, kNumLocksPerThread, &counter));
+        }
+
+        const Vs64 start = VInstant::snapshot();
+        for (int i = 0; i < numThreads; ++i) {
+            threads[i]->start();
+        }
+
+        for (int i = 0; i < numThreads; ++i) {
+            threads[i]->join();
+            delete threads[i];
+        }
+
+        const Vs64 elapsedMilliseconds = VInstant::snapshot() - start;
+        const Vs64 numLocks = static_cast<Vs64>(numThreads) * kNumLocksPerThread;
+        VUNIT_ASSERT_EQUAL_LABELED((Vs64) counter, numLocks, VSTRING_FORMAT("mutex contention %d threads count", numThreads));
+        this->logStatus(VSTRING_FORMAT("mutex contention: %d threads, " VSTRING_FORMATTER_S64 " locks in " VSTRING_FORMATTER_S64 "ms (%.1f ns/lock).",
+                                       numThreads, numLocks, elapsedMilliseconds, (elapsedMilliseconds * 1000000.0) / static_cast<double>(numLocks)));
+    }
+}
+
+
+void VThreadsUnit::_testReadWriteLock() {
+    VReadWriteLock lock("rwlock");
+
+    {
+        VWriteLocker locker(&lock, "VThreadsUnit write locker");
+        VUNIT_ASSERT_TRUE_LABELED(locker.isLocked(), "write locker initial lock");
+        VUNIT_ASSERT_TRUE_LABELED(lock.isWriteLockedByCurrentThread(), "write locked by current thread");
+    }
+
+    VUNIT_ASSERT_FALSE_LABELED(lock.isWriteLockedByCurrentThread(), "write lock released");
+
+    {
+        VReadLocker locker(&lock, "VThreadsUnit read locker", false);
+        VUNIT_ASSERT_FALSE_LABELED(locker.isLocked(), "read locker initial unlock");
+        locker.lock();
+        VUNIT_ASSERT_TRUE_LABELED(locker.isLocked(), "read locker explicit lock");
+        VUNIT_ASSERT_FALSE_LABELED(lock.isWriteLockedByCurrentThread(), "read lock is not write lock");
+        locker.unlock();
+        VUNIT_ASSERT_FALSE_LABELED(locker.isLocked(), "read locker explicit unlock");
+    }
+
+    // While we hold the lock for reading, another reader gets it, but a writer must wait.
+    {
+        VReadLocker locker(&lock, "VThreadsUnit shared reader");
+
+        volatile bool readerAcquired = false;
+        TestReadWriteLockThread reader(lock, false, &readerAcquired);
+        reader.start();
+        reader.join(); // would never return if readers excluded each other
+        VUNIT_ASSERT_TRUE_LABELED(readerAcquired, "second reader shares lock");
+
+        volatile bool writerAcquired = false;
+        TestReadWriteLockThread writer(lock, true, &writerAcquired);
+        writer.start();
+        VThread::sleep(100 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_FALSE_LABELED(writerAcquired, "writer waits for reader");
+
+        locker.unlock();
+        writer.join();
+        VUNIT_ASSERT_TRUE_LABELED(writerAcquired, "writer proceeds after reader");
+    }
+
+    // While we hold the lock for writing, a reader must wait.
+    {
+        VWriteLocker locker(&lock, "VThreadsUnit exclusive writer");
+
+        volatile bool readerAcquired = false;
+        TestReadWriteLockThread reader(lock, false, &readerAcquired);
+        reader.start();
+        VThread::sleep(100 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_FALSE_LABELED(readerAcquired, "reader waits for writer");
+
+        locker.unlock();
+        reader.join();
+        VUNIT_ASSERT_TRUE_LABELED(readerAcquired, "reader proceeds after writer");
+    }
+}
+
+void VThreadsUnit::_testShardedMutex() {
+    TestShardedMutex shardedMutex("sharded");
+    VUNIT_ASSERT_EQUAL_LABELED(TestShardedMutex::getNumShards(), 16, "sharded mutex num shards");
+    VUNIT_ASSERT_EQUAL_LABELED(shardedMutex.getShard(3).isLockedByCurrentThread(), false, "sharded mutex shard initially unlocked");
+
+    // A key always maps to the same shard, and sequential keys cover all of them.
+    VUNIT_ASSERT_TRUE_LABELED(&shardedMutex.getMutex(VString("session-42")) == &shardedMutex.getMutex(VString("session-42")), "sharded mutex string key stable");
+    VUNIT_ASSERT_TRUE_LABELED(&shardedMutex.getMutex(CONST_S64(42)) == &shardedMutex.getMutex(CONST_S64(42)), "sharded mutex integer key stable");
+
+    int numKeysPerShard[16] = { 0 };
+    for (Vs64 key = 0; key < 1600; ++key) {
+        ++numKeysPerShard[TestShardedMutex::getShardIndex(key * 16)]; // multiples of N would all land in one shard without mixing
+    }
+
+    bool allShardsUsed = true;
+    for (int i = 0; i < 16; ++i) {
+        allShardsUsed = allShardsUsed && (numKeysPerShard[i] > 0);
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(allShardsUsed, "sharded mutex integer keys spread across shards");
+
+    // No two shard mutexes come within a cache line of each other.
+    bool shardsPadded = true;
+    for (int i = 0; i < 16; ++i) {
+        for (int j = 0; j < 16; ++j) {
+            const char* a = reinterpret_cast<const char*>(&shardedMutex.getShard(i));
+            const char* b = reinterpret_cast<const char*>(&shardedMutex.getShard(j));
+            shardsPadded = shardsPadded && ((i == j) || (b >= a + sizeof(VMutex) + 64) || (a >= b + sizeof(VMutex) + 64));
+        }
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(shardsPadded, "sharded mutex shards on separate cache lines");
+
+    {
+        VMutexLocker locker(&shardedMutex.getMutex(VString("session-42")), "VThreadsUnit shard locker");
+        VUNIT_ASSERT_TRUE_LABELED(shardedMutex.getMutex(VString("session-42")).isLockedByCurrentThread(), "sharded mutex shard locked");
+        VUNIT_ASSERT_TRUE_LABELED(shardedMutex.getShard(TestShardedMutex::getShardIndex(VString("session-42"))).isLockedByCurrentThread(), "sharded mutex shard by index");
+    }
+}
+
+void VThreadsUnit::_testLockScaling() {
+    // Benchmark: readers of a small shared table under a single mutex, under a read-write lock
+    // held for reading, and under a sharded mutex, with 1 to 64 threads. The timings are logged
+    // for comparison, not asserted, since they depend on the machine.
+    const int kNumIterationsPerThread = 20000;
+    const int kThreadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    const TestLockScalingThread::Mode kModes[] = { TestLockScalingThread::kLockMutex, TestLockScalingThread::kLockForReading, TestLockScalingThread::kLockShard };
+    const char* kModeNames[] = { "mutex", "read lock", "sharded mutex" };
+
+    int table[kLockScalingTableSize];
+    Vs64 tableSum = 0;
+    for (int i = 0; i < kLockScalingTableSize; ++i) {
+        table[i] = i;
+        tableSum += i;
+    }
+
+    VMutex mutex("scaling");
+    VReadWriteLock readWriteLock("scaling");
+    TestShardedMutex shardedMutex("scaling");
+
+    for (size_t m = 0; m < sizeof(kModes) / sizeof(kModes[0]); ++m) {
+        for (size_t t = 0; t < sizeof(kThreadCounts) / sizeof(kThreadCounts[0]); ++t) {
+            const int numThreads = kThreadCounts[t];
+
+            std::vector<TestLockScalingThread*> threads;
+            for (int i = 0; i < numThreads; ++i) {
+                threads.push_back(new TestLockScalingThread(i, kModes[m], mutex, readWriteLock, shardedMutex, table, kNumIterationsPerThread));
+            }
+
+            const Vs64 start = VInstant::snapshot();
+            for (int i = 0; i < numThreads; ++i) {
+                threads[i]->start();
+            }
+
+            bool sumsCorrect = true;
+            for (int i = 0; i < numThreads; ++i) {
+                threads[i]->join();
+                sumsCorrect = sumsCorrect && (threads[i]->getSum() == tableSum * kNumIterationsPerThread);
+                delete threads[i];
+            }
+
+            const Vs64 elapsedMilliseconds = VInstant::snapshot() - start;
+            const Vs64 numLocks = static_cast<Vs64>(numThreads) * kNumIterationsPerThread;
+            VUNIT_ASSERT_TRUE_LABELED(sumsCorrect, VSTRING_FORMAT("lock scaling %s %d threads sums", kModeNames[m], numThreads));
+            this->logStatus(VSTRING_FORMAT("lock scaling: %s, %d threads, " VSTRING_FORMATTER_S64 " locks in " VSTRING_FORMATTER_S64 "ms (" VSTRING_FORMATTER_S64 " locks/ms).",
+                                           kModeNames[m], numThreads, numLocks, elapsedMilliseconds, numLocks / V_MAX(CONST_S64(1), elapsedMilliseconds)));
+        }
+    }
+}
+
+void VThreadsUnit::_testSemaphoreBroadcast() {
+    // A broadcast wakes every waiter at once, rather than one of them with the rest left for their timeouts.
+    VMutex mutex("VThreadsUnit::_testSemaphoreBroadcast", true/*suppress logging; held across the waits*/);
+    VSemaphore semaphore;
+    bool released = false;
+    int numWaiting = 0;
+    const int kNumWaiters = 4;
+
+    std::vector<TestSemaphoreWaitThread*> waiters;
+    for (int i = 0; i < kNumWaiters; ++i) {
+        waiters.push_back(new TestSemaphoreWaitThread(mutex, semaphore, released, numWaiting));
+        waiters.back()->start();
+    }
+
+    // Each waiter counts itself under the mutex that it then releases by waiting, so once all have counted,
+    // all are waiting or about to check the flag.
+    bool allWaiting = false;
+    for (int i = 0; (i < 500) && ! allWaiting; ++i) {
+        VThread::sleep(10 * VDuration::MILLISECOND());
+        VMutexLocker locker(&mutex, "VThreadsUnit::_testSemaphoreBroadcast");
+        allWaiting = (numWaiting == kNumWaiters);
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(allWaiting, "semaphore broadcast waiters started");
+
+    const Vs64 start = VInstant::snapshot();
+    {
+        VMutexLocker locker(&mutex, "VThreadsUnit::_testSemaphoreBroadcast");
+        released = true;
+        semaphore.broadcast();
+    }
+
+    for (std::vector<TestSemaphoreWaitThread*>::iterator i = waiters.begin(); i != waiters.end(); ++i) {
+        (*i)->join();
+        delete *i;
+    }
+
+    VUNIT_ASSERT_TRUE_LABELED(VInstant::snapshot() - start < 5000, "semaphore broadcast wakes all waiters");
+}
+
+void VThreadsUnit::_testCountingSemaphore() {
+    VCountingSemaphore semaphore;
+    VUNIT_ASSERT_FALSE_LABELED(semaphore.tryWait(), "counting semaphore initially zero");
+
+    // Posts are counted, not lost, when no one is waiting.
+    semaphore.post();
+    semaphore.post();
+    semaphore.post();
+    VUNIT_ASSERT_TRUE_LABELED(semaphore.tryWait(), "counting semaphore count 3 -> 2");
+    semaphore.wait(); // would block forever if the count had been lost
+    VUNIT_ASSERT_TRUE_LABELED(semaphore.timedWait(VDuration::SECOND()), "counting semaphore count 1 -> 0");
+    VUNIT_ASSERT_FALSE_LABELED(semaphore.tryWait(), "counting semaphore count exhausted");
+
+    const Vs64 start = VInstant::snapshot();
+    VUNIT_ASSERT_FALSE_LABELED(semaphore.timedWait(100 * VDuration::MILLISECOND()), "counting semaphore wait times out");
+    VUNIT_ASSERT_TRUE_LABELED(VInstant::snapshot() - start >= 90, "counting semaphore wait timeout elapsed"); // allow for clock granularity
+
+    VCountingSemaphore initialized(2);
+    VUNIT_ASSERT_TRUE_LABELED(initialized.tryWait() && initialized.tryWait() && ! initialized.tryWait(), "counting semaphore initial count");
+}
+
+void VThreadsUnit::_testEvent() {
+    VEvent event;
+    VUNIT_ASSERT_FALSE_LABELED(event.timedWait(10 * VDuration::MILLISECOND()), "event initially clear");
+
+    // A signal made before the wait is not lost; repeated signals are coalesced into one.
+    event.signal();
+    event.signal();
+    VUNIT_ASSERT_TRUE_LABELED(event.timedWait(VDuration::ZERO()), "event signaled before wait");
+    VUNIT_ASSERT_FALSE_LABELED(event.timedWait(10 * VDuration::MILLISECOND()), "event signals coalesced");
+
+    // A signal wakes a thread that is already waiting.
+    {
+        TestEventWaitThread waiter(event, 10 * VDuration::SECOND());
+        waiter.start();
+        VThread::sleep(50 * VDuration::MILLISECOND());
+        const Vs64 start = VInstant::snapshot();
+        event.signal();
+        waiter.join();
+        VUNIT_ASSERT_TRUE_LABELED(waiter.wasSignaled(), "event wakes waiting thread");
+        VUNIT_ASSERT_TRUE_LABELED(VInstant::snapshot() - start < 1000, "event wakes waiting thread promptly");
+    }
+
+    // A signal made after the waiter started but before it blocked, the case a condition variable loses.
+    {
+        TestEventWaitThread waiter(event, 10 * VDuration::SECOND());
+        event.signal();
+        waiter.start();
+        waiter.join();
+        VUNIT_ASSERT_TRUE_LABELED(waiter.wasSignaled(), "event signal before waiter blocks");
+    }
+
+    {
+        TestEventWaitThread waiter(event, 50 * VDuration::MILLISECOND());
+        waiter.start();
+        waiter.join();
+        VUNIT_ASSERT_FALSE_LABELED(waiter.wasSignaled(), "event waiter times out");
+    }
+}
+
+void VThreadsUnit::_testTimerWheel() {
+    VTimerWheel wheel("test", VDuration::MILLISECOND());
+    wheel.start();
+
+    // Tasks fire in order of expiry, not of scheduling, and never early.
+    {
+        std::vector<VString> firingOrder;
+        TestTimerTask late("late", wheel, &firingOrder);
+        TestTimerTask early("early", wheel, &firingOrder);
+        TestTimerTask middle("middle", wheel, &firingOrder);
+        late.schedule(150 * VDuration::MILLISECOND());
+        early.schedule(50 * VDuration::MILLISECOND());
+        middle.schedule(100 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(wheel.getNumScheduled(), 3, "timer wheel scheduled count");
+        VThread::sleep(400 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(wheel.getNumScheduled(), 0, "timer wheel tasks all fired");
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(firingOrder.size()), 3, "timer wheel fired each task once");
+        if (firingOrder.size() == 3) {
+            VUNIT_ASSERT_EQUAL_LABELED(firingOrder[0], VString("early"), "timer wheel firing order 1");
+            VUNIT_ASSERT_EQUAL_LABELED(firingOrder[1], VString("middle"), "timer wheel firing order 2");
+            VUNIT_ASSERT_EQUAL_LABELED(firingOrder[2], VString("late"), "timer wheel firing order 3");
+        }
+        VUNIT_ASSERT_TRUE_LABELED(early.mFirstFireNanoseconds >= 50 * VTicks::kNanosecondsPerMillisecond, "timer wheel task not early");
+        VUNIT_ASSERT_TRUE_LABELED(late.mFirstFireNanoseconds >= 150 * VTicks::kNanosecondsPerMillisecond, "timer wheel later task not early");
+    }
+
+    // A delay beyond the 256 ticks of the first level is redistributed and still fires on time.
+    {
+        TestTimerTask task("level1", wheel);
+        task.schedule(300 * VDuration::MILLISECOND());
+        VThread::sleep(600 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(task.mFireCount.load(), 1, "timer wheel level 1 task fired");
+        VUNIT_ASSERT_TRUE_LABELED(task.mFirstFireNanoseconds >= 300 * VTicks::kNanosecondsPerMillisecond, "timer wheel level 1 task not early");
+    }
+
+    // Cancel removes a task before it fires; far-future tasks are held and cancelled the same way.
+    {
+        TestTimerTask task("cancelled", wheel);
+        TestTimerTask days("days", wheel);
+        TestTimerTask centuries("centuries", wheel);
+        task.schedule(100 * VDuration::MILLISECOND());
+        days.schedule(10 * VDuration::DAY());
+        centuries.schedule(1000 * 365 * VDuration::DAY()); // beyond the span of the wheel
+        VUNIT_ASSERT_TRUE_LABELED(wheel.isScheduled(&days) && wheel.isScheduled(&centuries), "timer wheel far tasks scheduled");
+        VUNIT_ASSERT_TRUE_LABELED(wheel.cancel(&task), "timer wheel cancel scheduled task");
+        VUNIT_ASSERT_FALSE_LABELED(wheel.cancel(&task), "timer wheel cancel unscheduled task");
+        VUNIT_ASSERT_TRUE_LABELED(wheel.cancel(&days) && wheel.cancel(&centuries), "timer wheel cancel far tasks");
+        VUNIT_ASSERT_EQUAL_LABELED(wheel.getNumScheduled(), 0, "timer wheel empty after cancel");
+        VThread::sleep(200 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(task.mFireCount.load(), 0, "timer wheel cancelled task did not fire");
+
+        // Rescheduling replaces the earlier schedule.
+        task.schedule(VDuration::SECOND());
+        task.schedule(20 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(wheel.getNumScheduled(), 1, "timer wheel reschedule count");
+        VThread::sleep(200 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(task.mFireCount.load(), 1, "timer wheel rescheduled task fired");
+    }
+
+    // A periodic task fires repeatedly until cancelled, here by itself from fire().
+    {
+        TestTimerTask task("periodic", wheel);
+        task.mCancelAfterCount = 5;
+        task.schedule(20 * VDuration::MILLISECOND(), 20 * VDuration::MILLISECOND());
+        VThread::sleep(500 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(task.mFireCount.load(), 5, "timer wheel periodic task fired until cancelled");
+        VUNIT_ASSERT_FALSE_LABELED(wheel.isScheduled(&task), "timer wheel periodic task cancelled itself");
+    }
+
+    // Cancelling a task while it is firing waits for fire() to return, and stops it repeating.
+    {
+        TestTimerTask task("slow", wheel);
+        task.mFireDuration = 100 * VDuration::MILLISECOND();
+        task.schedule(VDuration::ZERO(), 10 * VDuration::MILLISECOND());
+        for (int i = 0; (i < 100) && ! task.mIsFiring; ++i) {
+            VThread::sleep(5 * VDuration::MILLISECOND());
+        }
+        VUNIT_ASSERT_TRUE_LABELED(task.mIsFiring, "timer wheel slow task firing");
+        (void) wheel.cancel(&task);
+        VUNIT_ASSERT_FALSE_LABELED(task.mIsFiring, "timer wheel cancel waited for fire");
+        int fireCount = task.mFireCount.load();
+        VThread::sleep(100 * VDuration::MILLISECOND());
+        VUNIT_ASSERT_EQUAL_LABELED(task.mFireCount.load(), fireCount, "timer wheel cancelled periodic task did not repeat");
+    }
+
+    wheel.stop();
+}
+
+void VThreadsUnit::_testThreadPool() {
+    // Many tasks from a non-worker thread are spread over the workers and all run.
+    {
+        VThreadPool pool("test", 4);
+        pool.start();
+        std::atomic<int> runCount(0);
+        std::vector<VThreadPoolTaskPtr> tasks;
+        for (int i = 0; i < 100; ++i) {
+            tasks.push_back(VThreadPoolTaskPtr(new TestPoolTask(VSTRING_FORMAT("task.%d", i), VThreadPoolTask::kPriorityNormal, &runCount)));
+            pool.submit(tasks.back());
+        }
+
+        bool allCompleted = true;
+        bool anyFailed = false;
+        for (std::vector<VThreadPoolTaskPtr>::const_iterator i = tasks.begin(); i != tasks.end(); ++i) {
+            allCompleted = (*i)->waitUntilCompleted(10 * VDuration::SECOND()) && allCompleted;
+            anyFailed = (*i)->hasFailed() || anyFailed;
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED(allCompleted, "thread pool tasks completed");
+        VUNIT_ASSERT_FALSE_LABELED(anyFailed, "thread pool tasks succeeded");
+        VUNIT_ASSERT_EQUAL_LABELED(runCount.load(), 100, "thread pool tasks run count");
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(pool.getNumTasksRun()), 100, "thread pool tasks counted");
+        VUNIT_ASSERT_EQUAL_LABELED(pool.getNumQueuedTasks(), 0, "thread pool queues empty");
+        VUNIT_ASSERT_TRUE_LABELED(static_cast<TestPoolTask*>(tasks.front().get())->mCompletedCalled, "thread pool task completed() called");
+
+        // The workers appear in the threads info with their pool attributes.
+        VBentoNode threadsInfo;
+        VThread::getThreadsInfo(threadsInfo);
+        int numPoolWorkers = 0;
+        for (VBentoNodePtrVector::const_iterator i = threadsInfo.getNodes().begin(); i != threadsInfo.getNodes().end(); ++i) {
+            if ((*i)->getString("pool", VString::EMPTY()) == "test") {
+                ++numPoolWorkers;
+            }
+        }
+        VUNIT_ASSERT_EQUAL_LABELED(numPoolWorkers, 4, "thread pool workers in threads info");
+
+        // An exception thrown by a task fails the task, not the worker.
+        TestPoolTask* throwingTask = new TestPoolTask("throws", VThreadPoolTask::kPriorityNormal, &runCount);
+        throwingTask->mThrows = true;
+        VThreadPoolTaskPtr throwingTaskPtr(throwingTask);
+        pool.submit(throwingTaskPtr);
+        throwingTaskPtr->waitUntilCompleted();
+        VUNIT_ASSERT_TRUE_LABELED(throwingTaskPtr->hasFailed(), "thread pool throwing task failed");
+        VUNIT_ASSERT_TRUE_LABELED(throwingTaskPtr->getErrorMessage().contains("failed on purpose"), "thread pool throwing task error message");
+        VUNIT_ASSERT_TRUE_LABELED(throwingTask->mCompletedCalled, "thread pool throwing task completed() called");
+
+        pool.stop();
+    }
+
+    // Queued tasks run highest priority first. A single worker is held by a gate task while they are queued.
+    {
+        VThreadPool pool("priority", 1);
+        pool.start();
+        std::atomic<int> runCount(0);
+        std::vector<VString> runOrder;
+        VEvent gate;
+        TestPoolTask* gateTask = new TestPoolTask("gate", VThreadPoolTask::kPriorityNormal, &runCount);
+        gateTask->mGate = &gate;
+        VThreadPoolTaskPtr gateTaskPtr(gateTask);
+        pool.submit(gateTaskPtr);
+
+        VThreadPoolTaskPtr lowTask(new TestPoolTask("low", VThreadPoolTask::kPriorityLow, &runCount, &runOrder));
+        VThreadPoolTaskPtr normalTask(new TestPoolTask("normal", VThreadPoolTask::kPriorityNormal, &runCount, &runOrder));
+        VThreadPoolTaskPtr highTask(new TestPoolTask("high", VThreadPoolTask::kPriorityHigh, &runCount, &runOrder));
+        pool.submit(lowTask);
+        pool.submit(normalTask);
+        pool.submit(highTask);
+        gate.signal();
+
+        lowTask->waitUntilCompleted();
+        VUNIT_ASSERT_EQUAL_LABELED(static_cast<int>(runOrder.size()), 3, "thread pool priority tasks run");
+        if (runOrder.size() == 3) {
+            VUNIT_ASSERT_TRUE_LABELED(runOrder[0] == "high" && runOrder[1] == "normal" && runOrder[2] == "low", "thread pool priority order");
+        }
+
+        pool.stop();
+    }
+
+    // Completing a task wakes every thread waiting for it, not just one.
+    {
+        VThreadPool pool("waiters", 1);
+        pool.start();
+        std::atomic<int> runCount(0);
+        VEvent gate;
+        TestPoolTask* gateTask = new TestPoolTask("gate", VThreadPoolTask::kPriorityNormal, &runCount);
+        gateTask->mGate = &gate;
+        VThreadPoolTaskPtr gateTaskPtr(gateTask);
+        pool.submit(gateTaskPtr);
+
+        const int kNumWaiters = 4;
+        std::vector<TestPoolTaskWaitThread*> waiters;
+        for (int i = 0; i < kNumWaiters; ++i) {
+            waiters.push_back(new TestPoolTaskWaitThread(gateTaskPtr));
+            waiters.back()->start();
+        }
+
+        VThread::sleep(50 * VDuration::MILLISECOND()); // let the waiters block
+        const Vs64 start = VInstant::snapshot();
+        gate.signal();
+
+        bool allSawCompletion = true;
+        for (std::vector<TestPoolTaskWaitThread*>::iterator i = waiters.begin(); i != waiters.end(); ++i) {
+            (*i)->join();
+            allSawCompletion = allSawCompletion && (*i)->sawCompletion();
+            delete *i;
+        }
+
+        VUNIT_ASSERT_TRUE_LABELED(allSawCompletion, "thread pool task completion wakes all waiters");
+        VUNIT_ASSERT_TRUE_LABELED(VInstant::snapshot() - start < 5000, "thread pool task completion wakes all waiters promptly");
+        pool.stop();
+    }
+
+    // Subtasks submitted from a worker go on its own queue; while it lingers, the other worker steals them.
+    {
+        VThreadPool pool("steal", 2);
+        pool.start();
+        std::atomic<int> runCount(0);
+        TestPoolTask* parentTask = new TestPoolTask("parent", VThreadPoolTask::kPriorityNormal, &runCount);
+        parentTask->mPool = &pool;
+        parentTask->mNumSubtasks = 10;
+        parentTask->mRunDuration = 300 * VDuration::MILLISECOND();
+        VThreadPoolTaskPtr parentTaskPtr(parentTask);
+        pool.submit(parentTaskPtr);
+        parentTaskPtr->waitUntilCompleted();
+
+        for (int i = 0; (i < 100) && (runCount.load() < 11); ++i) {
+            VThread::sleep(10 * VDuration::MILLISECOND());
+        }
+
+        VUNIT_ASSERT_EQUAL_LABELED(runCount.load(), 11, "thread pool parent and subtasks run");
+        VUNIT_ASSERT_TRUE_LABELED(pool.getNumTasksStolen() > 0, "thread pool subtasks stolen");
+        pool.stop();
+    }
+
+    // Stopping the pool fails the tasks still queued, and any submitted afterwards, without running them.
+    {
+        VThreadPool pool("stop", 1);
+        pool.start();
+        std::atomic<int> runCount(0);
+        VEvent gate; // never signaled; the gate task gives up waiting after a second
+        TestPoolTask* gateTask = new TestPoolTask("gate", VThreadPoolTask::kPriorityNormal, &runCount);
+        gateTask->mGate = &gate;
+        VThreadPoolTaskPtr gateTaskPtr(gateTask);
+        VThreadPoolTaskPtr queuedTask(new TestPoolTask("queued", VThreadPoolTask::kPriorityNormal, &runCount));
+        pool.submit(gateTaskPtr);
+        pool.submit(queuedTask);
+        VUNIT_ASSERT_TRUE_LABELED(gateTask->mStarted.timedWait(5 * VDuration::SECOND()), "thread pool gate task started");
+        pool.stop();
+
+        VUNIT_ASSERT_TRUE_LABELED(gateTaskPtr->isCompleted() && ! gateTaskPtr->hasFailed(), "thread pool running task finished at stop");
+        VUNIT_ASSERT_TRUE_LABELED(queuedTask->isCompleted() && queuedTask->hasFailed(), "thread pool queued task failed at stop");
+
+        VThreadPoolTaskPtr lateTask(new TestPoolTask("late", VThreadPoolTask::kPriorityNormal, &runCount));
+        pool.submit(lateTask);
+        VUNIT_ASSERT_TRUE_LABELED(lateTask->isCompleted() && lateTask->hasFailed(), "thread pool task submitted after stop failed");
+        VUNIT_ASSERT_EQUAL_LABELED(runCount.load(), 1, "thread pool only the running task ran");
+    }
+}
+
+/**
+Reads the process's virtual and resident sizes from /proc/self/statm.
+@param  virtualSize     set to the virtual size (VSZ) in bytes
+@param  residentSize    set to the resident size (RSS) in bytes
+@return false if /proc/self/statm is not available on this platform
+*/
+static bool _getProcessMemorySizes(Vs64& virtualSize, Vs64& residentSize) {
+#ifdef VPLATFORM_WIN
+    (void) virtualSize;
+    (void) residentSize;
+    return false;
+#else
+    // Read with stdio: procfs files report a size of zero, which the Vault file streams take as empty.
+    FILE* f = ::fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return false;
+    }
+
+    long long numVirtualPages = 0;
+    long long numResidentPages = 0;
+    int numFields = ::fscanf(f, "%lld %lld", &numVirtualPages, &numResidentPages);
+    (void) ::fclose(f);
+
+    const Vs64 pageSize = static_cast<Vs64>(::sysconf(_SC_PAGESIZE)); // statm counts pages, which are not 4K everywhere
+    virtualSize = numVirtualPages * pageSize;
+    residentSize = numResidentPages * pageSize;
+    return (numFields == 2);
+#endif
+}
+
+/**
+Starts a number of idle threads with the given options, and measures how much the process's
+virtual and resident sizes grow while they are all running.
+@param  options             the thread options
+@param  numThreads          the number of threads
+@param  virtualSizeGrowth   set to the growth in VSZ in bytes
+@param  residentSizeGrowth  set to the growth in RSS in bytes
+@return false if the sizes are not available on this platform
+*/
+static bool _measureThreadMemory(const VThreadOptions& options, int numThreads, Vs64& virtualSizeGrowth, Vs64& residentSizeGrowth) {
+    Vs64 virtualSizeBefore = 0;
+    Vs64 residentSizeBefore = 0;
+    if (! _getProcessMemorySizes(virtualSizeBefore, residentSizeBefore)) {
+        return false;
+    }
+
+    std::atomic<int> numStarted(0);
+    VCountingSemaphore release(0);
+    std::vector<TestIdleThread*> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.push_back(new TestIdleThread(VSTRING_FORMAT("idle.%d", i), numStarted, release));
+        threads.back()->setOptions(options);
+        threads.back()->start();
+    }
+
+    for (int i = 0; (i < 1000) && (numStarted.load() < numThreads); ++i) {
+        VThread::sleep(10 * VDuration::MILLISECOND());
+    }
+
+    Vs64 virtualSizeDuring = 0;
+    Vs64 residentSizeDuring = 0;
+    bool measured = _getProcessMemorySizes(virtualSizeDuring, residentSizeDuring);
+    virtualSizeGrowth = virtualSizeDuring - virtualSizeBefore;
+    residentSizeGrowth = residentSizeDuring - residentSizeBefore;
+
+    for (int i = 0; i < numThreads; ++i) {
+        release.post();
+    }
+
+    for (std::vector<TestIdleThread*>::const_iterator i = threads.begin(); i != threads.end(); ++i) {
+        (*i)->join();
+        delete *i;
+    }
+
+    return measured;
+}
+
+void VThreadsUnit::_testThreadOptions() {
+    VThreadOptions options;
+    VUNIT_ASSERT_TRUE_LABELED(options.isDefault(), "thread options default");
+    options.setStackSize(128 * 1024);
+    options.setCPUAffinityMask(CONST_U64(1)); // CPU 0 always exists
+    options.setScheduling(VThreadOptions::kSchedulingBatch);
+    VUNIT_ASSERT_FALSE_LABELED(options.isDefault(), "thread options not default");
+
+    // A thread runs with all the options set; any that the platform cannot apply are only logged.
+    {
+        std::atomic<int> numStarted(0);
+        VCountingSemaphore release(1);
+        TestIdleThread thread("options", numStarted, release);
+        thread.setOptions(options);
+        VUNIT_ASSERT_EQUAL_LABELED(thread.getOptions().getStackSize(), static_cast<size_t>(128 * 1024), "thread options set");
+        thread.start();
+        thread.join();
+        VUNIT_ASSERT_EQUAL_LABELED(numStarted.load(), 1, "thread with options ran");
+    }
+
+    // A session costs the address space of its i/o threads' stacks. With many sessions, that is what
+    // a small stack size saves: compare threads with a small stack to threads with the default.
+    // The small stacks are measured first, so that they cannot reuse stacks the C library has cached.
+    const int kNumThreads = 500;
+    VThreadOptions smallStackOptions;
+    smallStackOptions.setStackSize(128 * 1024);
+    Vs64 smallStackVirtualSize = 0;
+    Vs64 smallStackResidentSize = 0;
+    Vs64 defaultStackVirtualSize = 0;
+    Vs64 defaultStackResidentSize = 0;
+    if (! _measureThreadMemory(smallStackOptions, kNumThreads, smallStackVirtualSize, smallStackResidentSize) ||
+        ! _measureThreadMemory(VThreadOptions(), kNumThreads, defaultStackVirtualSize, defaultStackResidentSize)) {
+        this->logStatus("Skipping thread stack memory test because process memory sizes are not available on this platform.");
+        return;
+    }
+
+    this->logStatus(VSTRING_FORMAT("%d threads with 128KB stacks: VSZ +" VSTRING_FORMATTER_S64 "KB, RSS +" VSTRING_FORMATTER_S64 "KB.", kNumThreads, smallStackVirtualSize / 1024, smallStackResidentSize / 1024));
+    this->logStatus(VSTRING_FORMAT("%d threads with default stacks: VSZ +" VSTRING_FORMATTER_S64 "KB, RSS +" VSTRING_FORMATTER_S64 "KB.", kNumThreads, defaultStackVirtualSize / 1024, defaultStackResidentSize / 1024));
+    VUNIT_ASSERT_TRUE_LABELED(smallStackVirtualSize < defaultStackVirtualSize / 4, "thread small stacks reduce VSZ");
+}
+
+void VThreadsUnit::_testCurrentThread() {
+    // A VThread finds itself as the current thread, by its name.
+    std::atomic<int> numStarted(0);
+    VCountingSemaphore release(1);
+    TestIdleThread thread("current", numStarted, release);
+    thread.start();
+    thread.join();
+    VUNIT_ASSERT_TRUE_LABELED(thread.mCurrentThread == &thread, "current thread is the VThread");
+    VUNIT_ASSERT_EQUAL_LABELED(thread.mCurrentThreadName, VString("current"), "current thread name is the VThread name");
+
+    // The thread running the tests is not the thread we just ran, and its name is stable from call to call.
+    VUNIT_ASSERT_TRUE_LABELED(VThread::getCurrentThread() != &thread, "current thread differs on another thread");
+    const VString& name = VThread::getCurrentThreadName();
+    VUNIT_ASSERT_TRUE_LABELED(name.isNotEmpty(), "current thread name not empty");
+    VUNIT_ASSERT_TRUE_LABELED(&VThread::getCurrentThreadName() == &name, "current thread name cached");
+}
+
+void VThreadsUnit::_testMonotonicWaits() {
+    // Timed waits are measured on a monotonic clock, so stepping the wall clock neither cuts them short
+    // nor stretches them. VInstant's simulated clock offset steps the clock as far as the Vault is concerned;
+    // waits measured from VInstant would return at once with the clock stepped forward by an hour, and
+    // not for an hour with it stepped back.
+    VMutex mutex("VThreadsUnit::_testMonotonicWaits", true/*suppress logging; held across the waits*/);
+    VSemaphore semaphore;
+    VCountingSemaphore countingSemaphore(0);
+    const Vs64 kWaitNanoseconds = 200 * VTicks::kNanosecondsPerMillisecond;
+    const Vs64 kLateNanoseconds = 2 * VTicks::kNanosecondsPerSecond; // generous, for a loaded machine
+
+    const VDuration clockSteps[] = { VDuration::HOUR(), -1 * VDuration::HOUR() };
+    const char* clockStepNames[] = { "forward", "back" };
+    for (int i = 0; i < 2; ++i) {
+        VInstant::setSimulatedClockOffset(clockSteps[i]);
+
+        VTicks start;
+        {
+            VMutexLocker locker(&mutex, "VThreadsUnit::_testMonotonicWaits");
+            semaphore.wait(&mutex, 200 * VDuration::MILLISECOND());
+        }
+        Vs64 elapsed = start.getNanosecondsSince();
+        VUNIT_ASSERT_TRUE_LABELED(elapsed >= kWaitNanoseconds - VTicks::kNanosecondsPerMillisecond, VSTRING_FORMAT("semaphore wait with clock stepped %s not early", clockStepNames[i]));
+        VUNIT_ASSERT_TRUE_LABELED(elapsed < kLateNanoseconds, VSTRING_FORMAT("semaphore wait with clock stepped %s not late", clockStepNames[i]));
+
+        start = VTicks();
+        VUNIT_ASSERT_FALSE_LABELED(countingSemaphore.timedWait(200 * VDuration::MILLISECOND()), VSTRING_FORMAT("counting semaphore wait with clock stepped %s timed out", clockStepNames[i]));
+        elapsed = start.getNanosecondsSince();
+        VUNIT_ASSERT_TRUE_LABELED(elapsed >= kWaitNanoseconds - VTicks::kNanosecondsPerMillisecond, VSTRING_FORMAT("counting semaphore wait with clock stepped %s not early", clockStepNames[i]));
+        VUNIT_ASSERT_TRUE_LABELED(elapsed < kLateNanoseconds, VSTRING_FORMAT("counting semaphore wait with clock stepped %s not late", clockStepNames[i]));
+    }
+
+    VInstant::setSimulatedClockOffset(VDuration::ZERO()); // restore the time continuum to normal
+
+    // A timeout can be finer than a millisecond.
+    VTicks start;
+    {
+        VMutexLocker locker(&mutex, "VThreadsUnit::_testMonotonicWaits");
+        semaphore.waitNanoseconds(&mutex, 300 * CONST_S64(1000)); // 300 microseconds
+    }
+    Vs64 elapsed = start.getNanosecondsSince();
+    VUNIT_ASSERT_TRUE_LABELED(elapsed >= 300 * CONST_S64(1000), "semaphore sub-millisecond wait not early");
+    VUNIT_ASSERT_TRUE_LABELED(elapsed < kLateNanoseconds, "semaphore sub-millisecond wait not late");
+}
@@ -13,7 +13,7 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vunit.h"
 
 /**
-Unit test class for validating VThread, VMutex, VMutexLocker, VSemaphore.
+Unit test class for validating VThread, VMutex, VMutexLocker, VReadWriteLock, VShardedMutex, VSemaphore, VCountingSemaphore, VEvent.
 */
 class VThreadsUnit : public VUnit {
     public:
@@ -34,6 +34,21 @@ class VThreadsUnit : public VUnit {
         */
         virtual void run();
 
+    private:
+
+        void _testMutexContention();
+        void _testReadWriteLock();
+        void _testShardedMutex();
+        void _testLockScaling();
+        void _testSemaphoreBroadcast();
+        void _testCountingSemaphore();
+        void _testEvent();
+        void _testTimerWheel();
+        void _testThreadPool();
+        void _testThreadOptions();
+        void _testCurrentThread();
+        void _testMonotonicWaits();
+
         friend class TestThreadClass; // Our test uses this thread class and it needs to log status to unit test output.
 };
 
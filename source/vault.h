@@ -18,17 +18,25 @@ This set of includes is enough to pull in all vault header files.
 #include "vassert.h"
 #include "vchar.h"
 #include "vlogger.h"
+#include "vbinarylog.h"
 #include "vsettings.h"
 #include "vclassregistry.h"
 #include "vsingleton.h"
 #include "vsemaphore.h"
+#include "vcountingsemaphore.h"
+#include "vcoarseclock.h"
 #include "vmutexlocker.h"
+#include "vreadwritelock.h"
+#include "vshardedmutex.h"
+#include "vthreadpool.h"
+#include "vtimerwheel.h"
 #include "vsocketstream.h"
 #include "vsocketfactory.h"
 #include "vsocketthread.h"
 #include "vsocketthreadfactory.h"
 #include "vbufferedfilestream.h"
 #include "vdirectiofilestream.h"
+#include "vasyncfilestream.h"
 #include "vmemorystream.h"
 #include "vbinaryiostream.h"
 #include "vtextiostream.h"
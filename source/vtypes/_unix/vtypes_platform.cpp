@@ -13,6 +13,12 @@ License: MIT. See LICENSE.md in the Vault top level directory.
 #include "vtypes_internal_platform.h"
 
 #include <errno.h>
+#include <fcntl.h>
+
+#ifdef __linux__
+    #include <sys/ioctl.h>
+    #include <linux/fs.h> // for FICLONE
+#endif
 
 Vs64 vault::VgetMemoryUsage() {
     return 0; // FIXME - find an API to use on Unix
@@ -99,6 +105,92 @@ int VPlatformAPI::stat(const VString& path, struct stat* buf) {
     return vault::stat(path, buf);
 }
 
+// static
+ssize_t VPlatformAPI::pread(int fd, void* buffer, size_t numBytes, Vs64 offset) {
+    return ::pread(fd, buffer, numBytes, static_cast<off_t>(offset));
+}
+
+// static
+ssize_t VPlatformAPI::pwrite(int fd, const void* buffer, size_t numBytes, Vs64 offset) {
+    return ::pwrite(fd, buffer, numBytes, static_cast<off_t>(offset));
+}
+
+// static
+int VPlatformAPI::fsync(int fd) {
+    return ::fsync(fd);
+}
+
+// static
+int VPlatformAPI::syncDirectory(const VString& path) {
+    int fd = vault::open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    int result = ::fsync(fd);
+    int errNo = errno;
+    (void) vault::close(fd);
+    errno = errNo;
+    return result;
+}
+
+// static
+int VPlatformAPI::openTemporary(const VString& directoryPath) {
+#if defined(__linux__) && defined(O_TMPFILE)
+    // Readable as well, so that if linkTemporary() fails, the caller can copy the data to a named file.
+    return vault::open(directoryPath, O_TMPFILE | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// static
+int VPlatformAPI::linkTemporary(int fd, const VString& path) {
+#if defined(__linux__) && defined(O_TMPFILE)
+    // linkat(AT_EMPTY_PATH) needs a capability we probably don't have; linking from /proc does not.
+    char procPath[64];
+    (void) ::snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+    return ::linkat(AT_FDCWD, procPath, AT_FDCWD, path, AT_SYMLINK_FOLLOW);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// static
+Vs64 VPlatformAPI::cloneFile(int fromFD, int toFD, Vs64 maxNumBytes) {
+#if defined(__linux__) && defined(FICLONE)
+    // A clone replaces the whole destination with the whole source, so it can only stand in
+    // for copying an entire file into an empty one.
+    struct stat fromStat;
+    struct stat toStat;
+    if ((::fstat(fromFD, &fromStat) == 0) && S_ISREG(fromStat.st_mode) && (static_cast<Vs64>(fromStat.st_size) <= maxNumBytes) &&
+            (::fstat(toFD, &toStat) == 0) && S_ISREG(toStat.st_mode) && (toStat.st_size == 0) && (vault::lseek(toFD, 0, SEEK_CUR) == 0) &&
+            (::ioctl(toFD, FICLONE, fromFD) == 0)) {
+        (void) vault::lseek(toFD, 0, SEEK_END);
+        return fromStat.st_size;
+    }
+#else
+    (void) fromFD; (void) toFD; (void) maxNumBytes;
+#endif
+    return -1;
+}
+
+// static
+ssize_t VPlatformAPI::copyFileRange(int fromFD, Vs64* fromOffset, int toFD, size_t numBytes) {
+#if defined(__linux__) && defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 27)))
+    loff_t offset = static_cast<loff_t>(*fromOffset);
+    ssize_t result = ::copy_file_range(fromFD, &offset, toFD, NULL, numBytes, 0);
+    *fromOffset = offset;
+    return result;
+#else
+    (void) fromFD; (void) fromOffset; (void) toFD; (void) numBytes;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 // VAutoreleasePool -----------------------------------------------------------
 
 // VAutoreleasePool is a no-op on Unix.
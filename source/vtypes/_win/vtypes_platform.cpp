@@ -159,6 +159,72 @@ int VPlatformAPI::stat(const VString& path, struct stat* buf) {
 	return result;
 }
 
+// Windows has no pread/pwrite, but ReadFile and WriteFile take the offset in an OVERLAPPED.
+// static
+ssize_t VPlatformAPI::pread(int fd, void* buffer, size_t numBytes, Vs64 offset) {
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD numBytesRead = 0;
+    if (! ::ReadFile(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)), buffer, static_cast<DWORD>(V_MIN(numBytes, static_cast<size_t>(0x7FFFFFFF))), &numBytesRead, &overlapped)) {
+        if (::GetLastError() != ERROR_HANDLE_EOF) {
+            errno = EIO;
+            return -1;
+        }
+    }
+
+    return static_cast<ssize_t>(numBytesRead);
+}
+
+// static
+ssize_t VPlatformAPI::pwrite(int fd, const void* buffer, size_t numBytes, Vs64 offset) {
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+    DWORD numBytesWritten = 0;
+    if (! ::WriteFile(reinterpret_cast<HANDLE>(::_get_osfhandle(fd)), buffer, static_cast<DWORD>(V_MIN(numBytes, static_cast<size_t>(0x7FFFFFFF))), &numBytesWritten, &overlapped)) {
+        errno = EIO;
+        return -1;
+    }
+
+    return static_cast<ssize_t>(numBytesWritten);
+}
+
+// static
+int VPlatformAPI::fsync(int fd) {
+    return ::_commit(fd);
+}
+
+// static
+int VPlatformAPI::syncDirectory(const VString& /*path*/) {
+    return 0; // NTFS journals directory changes itself, and a directory cannot be opened as a file descriptor.
+}
+
+// static
+int VPlatformAPI::openTemporary(const VString& /*directoryPath*/) {
+    errno = ENOSYS;
+    return -1;
+}
+
+// static
+int VPlatformAPI::linkTemporary(int /*fd*/, const VString& /*path*/) {
+    errno = ENOSYS;
+    return -1;
+}
+
+// static
+Vs64 VPlatformAPI::cloneFile(int /*fromFD*/, int /*toFD*/, Vs64 /*maxNumBytes*/) {
+    return -1;
+}
+
+// static
+ssize_t VPlatformAPI::copyFileRange(int /*fromFD*/, Vs64* /*fromOffset*/, int /*toFD*/, size_t /*numBytes*/) {
+    errno = ENOSYS;
+    return -1;
+}
+
 // miscellaneous --------------------------------------------------------------
 
 static void getCurrentTZ(VString& tz) {
@@ -175,6 +175,40 @@ ssize_t VFileSystem::write(int fd, const void* buffer, size_t numBytes) {
     return result;
 }
 
+// static
+ssize_t VFileSystem::pread(int fd, void* buffer, size_t numBytes, Vs64 offset) {
+    ssize_t result = 0;
+    bool    done = false;
+
+    while (! done) {
+        result = VPlatformAPI::pread(fd, buffer, numBytes, offset);
+
+        if ((result != (ssize_t) - 1) || (errno != EINTR))
+            done = true;
+    }
+
+    _debugCheck(result != -1);
+
+    return result;
+}
+
+// static
+ssize_t VFileSystem::pwrite(int fd, const void* buffer, size_t numBytes, Vs64 offset) {
+    ssize_t result = 0;
+    bool    done = false;
+
+    while (! done) {
+        result = VPlatformAPI::pwrite(fd, buffer, numBytes, offset);
+
+        if ((result != (ssize_t) - 1) || (errno != EINTR))
+            done = true;
+    }
+
+    _debugCheck(result != -1);
+
+    return result;
+}
+
 // static
 off_t VFileSystem::lseek(int fd, off_t offset, int whence) {
     off_t   result = 0;
@@ -209,6 +243,107 @@ int VFileSystem::close(int fd) {
     return result;
 }
 
+// static
+int VFileSystem::fsync(int fd) {
+    int     result = 0;
+    bool    done = false;
+
+    while (! done) {
+        result = VPlatformAPI::fsync(fd);
+
+        if ((result == 0) || (errno != EINTR))
+            done = true;
+    }
+
+    _debugCheck(result == 0);
+
+    return result;
+}
+
+// static
+int VFileSystem::syncDirectory(const VString& path) {
+    int     result = 0;
+    bool    done = false;
+
+    while (! done) {
+        result = VPlatformAPI::syncDirectory(path);
+
+        if ((result == 0) || (errno != EINTR))
+            done = true;
+    }
+
+    _debugCheck(result == 0);
+
+    return result;
+}
+
+// static
+int VFileSystem::openTemporary(const VString& directoryPath) {
+    int     fd = -1;
+    bool    done = false;
+
+    while (! done) {
+        fd = VPlatformAPI::openTemporary(directoryPath);
+
+        if ((fd != -1) || (errno != EINTR))
+            done = true;
+    }
+
+    // No _debugCheck: failure here just means the caller must use a named temporary file.
+
+    return fd;
+}
+
+// static
+int VFileSystem::linkTemporary(int fd, const VString& path) {
+    int     result = 0;
+    bool    done = false;
+
+    while (! done) {
+        result = VPlatformAPI::linkTemporary(fd, path);
+
+        if ((result == 0) || (errno != EINTR))
+            done = true;
+    }
+
+    _debugCheck(result == 0);
+
+    return result;
+}
+
+// static
+Vs64 VFileSystem::copyFileData(int fromFD, Vs64 fromOffset, int toFD, Vs64 numBytes) {
+    if (fromOffset == 0) {
+        Vs64 numBytesCloned = VPlatformAPI::cloneFile(fromFD, toFD, numBytes);
+        if (numBytesCloned >= 0) {
+            return numBytesCloned;
+        }
+    }
+
+    const Vs64 MAX_BYTES_PER_CALL = CONST_S64(0x40000000); // keep each request well within ssize_t on 32-bit systems
+    Vs64 nextOffset = fromOffset;
+    Vs64 numBytesCopied = 0;
+
+    while (numBytesCopied < numBytes) {
+        ssize_t result = VPlatformAPI::copyFileRange(fromFD, &nextOffset, toFD, static_cast<size_t>(V_MIN(MAX_BYTES_PER_CALL, numBytes - numBytesCopied)));
+
+        if (result > 0) {
+            numBytesCopied += result;
+        } else if (result == 0) {
+            break; // end of file
+        } else if (errno != EINTR) {
+            // Some kinds of file can't be copied this way; we can tell on the first attempt, before anything has been copied.
+            if ((numBytesCopied == 0) && ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP) || (errno == EBADF))) {
+                return -1;
+            }
+
+            throw VException(VSystemError(), VSTRING_FORMAT("VFileSystem::copyFileData failed after copying " VSTRING_FORMATTER_S64 " of " VSTRING_FORMATTER_S64 " bytes.", numBytesCopied, numBytes));
+        }
+    }
+
+    return numBytesCopied;
+}
+
 // static
 FILE* VFileSystem::fopen(const VString& nativePath, const char* mode) {
     if (nativePath.isEmpty())
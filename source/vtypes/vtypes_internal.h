@@ -38,8 +38,28 @@ class VFileSystem {
         static int      open(const VString& path, int flags);                               ///< Calls POSIX open in a way that is safe even if a signal is caught inside the function.
         static ssize_t  read(int fd, void* buffer, size_t numBytes);                        ///< Calls POSIX read in a way that is safe even if a signal is caught inside the function.
         static ssize_t  write(int fd, const void* buffer, size_t numBytes);                 ///< Calls POSIX write in a way that is safe even if a signal is caught inside the function.
+        static ssize_t  pread(int fd, void* buffer, size_t numBytes, Vs64 offset);          ///< Calls POSIX pread in a way that is safe even if a signal is caught inside the function.
+        static ssize_t  pwrite(int fd, const void* buffer, size_t numBytes, Vs64 offset);   ///< Calls POSIX pwrite in a way that is safe even if a signal is caught inside the function.
         static off_t    lseek(int fd, off_t offset, int whence);                            ///< Calls POSIX lseek in a way that is safe even if a signal is caught inside the function.
         static int      close(int fd);                                                      ///< Calls POSIX close in a way that is safe even if a signal is caught inside the function.
+        static int      fsync(int fd);                                                      ///< Calls POSIX fsync in a way that is safe even if a signal is caught inside the function.
+        static int      syncDirectory(const VString& path);                                 ///< Flushes a directory's entries (such as a file just renamed into it) to disk; does nothing where the platform cannot.
+        static int      openTemporary(const VString& directoryPath);                        ///< Creates an unnamed file in a directory, open for reading and writing, if the platform can (Linux O_TMPFILE); otherwise returns -1.
+        static int      linkTemporary(int fd, const VString& path);                         ///< Gives a file made by openTemporary() a name; the name must not exist.
+        /**
+        Copies data from one file to another without it passing through user space, if the
+        platform can: by cloning the file's blocks (a reflink, on file systems that support it)
+        when a whole file is copied into an empty one, or else with copy_file_range(). The data
+        is written at the destination's file offset, which is advanced; the source's is not used.
+        @param  fromFD      the file to copy from
+        @param  fromOffset  the offset in the source of the first byte to copy
+        @param  toFD        the file to copy to
+        @param  numBytes    the number of bytes to copy
+        @return the number of bytes copied (fewer than requested only at end of file), or -1,
+                having copied nothing, if the platform cannot copy between these files
+        @throws VException if the copy fails part way
+        */
+        static Vs64     copyFileData(int fromFD, Vs64 fromOffset, int toFD, Vs64 numBytes);
 
         static FILE*    fopen(const VString& nativePath, const char* mode);                 ///< Calls POSIX fopen in a way that is safe even if a signal is caught inside the function.
 // TO DO - local vault change
@@ -80,6 +100,14 @@ class VPlatformAPI {
         static int      unlink(const VString& path);
         static int      rename(const VString& oldName, const VString& newName);
         static int      stat(const VString& path, struct stat* buf);
+        static ssize_t  pread(int fd, void* buffer, size_t numBytes, Vs64 offset);
+        static ssize_t  pwrite(int fd, const void* buffer, size_t numBytes, Vs64 offset);
+        static int      fsync(int fd);
+        static int      syncDirectory(const VString& path);
+        static int      openTemporary(const VString& directoryPath);
+        static int      linkTemporary(int fd, const VString& path);
+        static Vs64     cloneFile(int fromFD, int toFD, Vs64 maxNumBytes);              // returns the size cloned, or -1
+        static ssize_t  copyFileRange(int fromFD, Vs64* fromOffset, int toFD, size_t numBytes);
 
     private:
         VPlatformAPI(); // static functions only; not constructable